@@ -368,6 +368,22 @@ vec4 filterOutWhiteBackground(vec4 color)
 	return (color.a==1.0) ? color : vec4((color.rgb - color.aaa) / (1.0-color.a),1.0);
 }
 
+#ifdef MATERIAL_SPECULAR
+#if MATERIAL_SPECULAR_MODEL==4
+// GGX with height-correlated Smith masking, as in RRMaterial::getResponse(), divided by NL because lightDirect already contains it
+float ggx(float NH, float NL, float NV, float roughness)
+{
+	if (NL<=0.0 || NV<=0.0)
+		return 0.0;
+	float alpha2 = sqr(max(roughness*roughness,0.0001));
+	float d = NH*NH*(alpha2-1.0)+1.0;
+	float lambdaV = (sqrt(1.0+alpha2*(1.0/(NV*NV)-1.0))-1.0)*0.5;
+	float lambdaL = (sqrt(1.0+alpha2*(1.0/(NL*NL)-1.0))-1.0)*0.5;
+	return alpha2/(d*d*4.0*NV*NL*(1.0+lambdaV+lambdaL));
+}
+#endif
+#endif
+
 vec4 toLinear()
 {
 	return vec4(0.0,0.0,0.0,0.0);
@@ -976,9 +992,12 @@ void main()
 						#elif MATERIAL_SPECULAR_MODEL==2
 							// Torrance-Sparrow (Gaussian), materialSpecularShininess=m^2=0..1
 							+ exp((1.0-1.0/(NH*NH))/materialSpecularShininess) / (4.0*materialSpecularShininess*((NH*NH)*(NH*NH))+0.0000000000001)
-						#else
+						#elif MATERIAL_SPECULAR_MODEL==3
 							// Blinn-Torrance-Sparrow, materialSpecularShininess=c3^2=0..1
 							+ sqr(materialSpecularShininess/(NH*NH*(materialSpecularShininess-1.0)+1.0))
+						#else
+							// GGX, materialSpecularShininess=roughness=0..1
+							+ ggx(NH,dot(worldNormal,worldLightDirFromPixel),dot(worldNormal,worldEyeDir),materialSpecularShininess)
 						#endif
 						* lightDirect
 						#if defined(LIGHT_INDIRECT_SIMULATED_DIRECTION)
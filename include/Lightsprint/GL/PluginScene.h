@@ -103,6 +103,16 @@ public:
 	//! When rendering mirrors, this enables occlusion query optimization. It increases fps in some situations, reduces in others.
 	bool mirrorOcclusionQuery;
 
+	//! True = objects outside camera frustum are not rendered. Hierarchy of objects is built on first use
+	//! and refitted when objects move or mesh boxes change, see rr::RRObjectBVH::update() for what is detected.
+	//! If you edit vertices of meshes other than rr::RRMeshArrays, disable it or objects may be culled by stale boxes.
+	bool frustumCulling;
+
+	//! When frustumCulling is enabled, this enables also CPU occlusion culling against the biggest visible opaque objects.
+	//! 0 = disabled, otherwise width of depth buffer used for occlusion tests, e.g. 256.
+	//! It increases fps in scenes with many objects hidden behind large occluders, reduces in open scenes.
+	unsigned occlusionCullingResolution;
+
 	//! Convenience ctor, for setting some plugin parameters. You still might want to change default values of some other parameters after ctor.
 	PluginParamsScene(const PluginParams* _next, RRSolverGL* _solver)
 	{
@@ -128,6 +138,8 @@ public:
 		clipPlanes.clipPlaneZB = 0;
 		wireframe = false;
 		mirrorOcclusionQuery = true;
+		frustumCulling = true;
+		occlusionCullingResolution = 0;
 	}
 
 	//! Access to actual plugin code, called by Renderer.
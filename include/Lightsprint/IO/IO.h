@@ -94,6 +94,7 @@ void RR_IO_API registerIO(int argc, char** argv, unsigned step = 0);
 //! Therefore you should run this function as soon in your application as possible (before all slow steps), and you should let it exit, if it needs to.
 //! Caller then imports newly created .rr3, and deletes it.
 //! If isolated process fails to import the scene or write it back as .rr3, caller tries to import the scene without isolation.
+//! If isolated process crashes or times out, scene is not imported, because import without isolation would likely crash or hang too.
 //!
 //! .rr3 fileformat is never isolated, it is used for transferring data between processes.
 //!
@@ -103,6 +104,53 @@ void RR_IO_API registerIO(int argc, char** argv, unsigned step = 0);
 //!  Copy of your main() argument. Used only on non-Windows platforms, can be nullptr otherwise.
 void RR_IO_API isolateIO(int argc, char** argv);
 
+//! Configures isolated scene import, see isolateIO().
+//
+//! \param maxProcesses
+//!  How many isolated processes may convert scenes at once, 0 = number of CPU cores.
+//! \param timeoutSeconds
+//!  Isolated process that converts scene longer is killed, 0 = no limit.
+//! \param cacheDirectory
+//!  Directory where converted scenes are cached, so that next import of the same file is fast.
+//!  Cached scene is reused if content of imported file, its directory, our executable and LightsprintIO did not change.
+//!  Files referenced from text formats are checked too: .obj materials (mtllib), .gltf buffers and images, .dae external documents.
+//!  References from binary formats (e.g. .glb or .fbx pointing to external files) are not checked,
+//!  cache is safe only for binary files that are self-contained; clean cache after editing files they reference.
+//!  Textures are not part of cached scene, they are loaded from their current version.
+//!  Empty = no cache, scenes are converted on each import (default).
+//!  Cache is not cleaned automatically.
+void RR_IO_API setIsolation(unsigned maxProcesses, float timeoutSeconds, const rr::RRString& cacheDirectory);
+
+//! Converts multiple scenes in concurrently running isolated processes and stores them in cache.
+//
+//! Use it before loading project that references many scenes, following rr::RRScene::RRScene(filename) imports load them from cache.
+//! Requires isolateIO() and cache directory set by setIsolation(), otherwise it does nothing.
+//! \param filenames
+//!  Array of scene filenames.
+//! \param numFilenames
+//!  Number of scene filenames.
+//! \param aborting
+//!  Optional, setting *aborting=true while conversion runs kills isolated processes.
+//! \return
+//!  Number of given filenames available in cache.
+unsigned RR_IO_API convertIsolated(const rr::RRString* filenames, unsigned numFilenames, bool* aborting = nullptr);
+
+//! Playback statistics of video, see getVideoStatistics().
+struct VideoStatistics
+{
+	unsigned framesDecoded; //!< Frames decoded by background thread, including frames thrown away after seek.
+	unsigned framesShown;   //!< Frames made visible by rr::RRBuffer::update().
+	unsigned framesDropped; //!< Frames skipped by rr::RRBuffer::update(), because newer frame was already due.
+	unsigned framesLate;    //!< Frames still visible when the next frame was due, but not yet decoded.
+};
+
+//! Fills playback statistics of video loaded by rr::RRBuffer::load(), returns false for buffers that don't collect them.
+//
+//! Statistics are collected by FFmpeg/libav player, since buffer was loaded.
+//! High framesDropped means that application calls update() less often than video frame rate,
+//! high framesLate means that decoding does not keep pace with playback.
+bool RR_IO_API getVideoStatistics(const rr::RRBuffer* video, VideoStatistics& statistics);
+
 
 } // namespace rr_io
 
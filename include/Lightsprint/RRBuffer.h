@@ -56,6 +56,42 @@ namespace rr
 		//! Converts to linear color.
 		virtual RRVec3 getLinear(const unsigned char color[3]) const = 0;
 
+		//! Converts array of linear intensities, in place.
+		//
+		//! Array versions of conversions are called from hot loops (lightmap export, buffer copies),
+		//! default implementations call scalar versions for each element.
+		//! Implementation may trade tiny amount of precision for speed,
+		//! built-in sRGB spaces return results within 0.0005% of scalar version.
+		virtual void fromLinear(RRReal* intensities, size_t numIntensities) const;
+		//! Converts array of linear colors, in place.
+		virtual void fromLinear(RRVec3* colors, size_t numColors) const;
+		//! Converts array of linear colors to 8bit custom colors, clamped to 0..255.
+		//
+		//! \param colors
+		//!  Input array of numColors linear colors.
+		//! \param custom
+		//!  Output array of numColors*bytesPerColor bytes.
+		//! \param bytesPerColor
+		//!  3 for RGB, 4 for RGBA (alpha byte is not written).
+		//! \param numColors
+		//!  Number of colors to convert.
+		virtual void fromLinear(const RRVec3* colors, unsigned char* custom, unsigned bytesPerColor, size_t numColors) const;
+		//! Converts array of intensities to linear, in place.
+		virtual void toLinear(RRReal* intensities, size_t numIntensities) const;
+		//! Converts array of colors to linear, in place.
+		virtual void toLinear(RRVec3* colors, size_t numColors) const;
+		//! Converts array of 8bit custom colors to linear colors.
+		//
+		//! \param custom
+		//!  Input array of numColors*bytesPerColor bytes.
+		//! \param bytesPerColor
+		//!  3 for RGB, 4 for RGBA (alpha byte is ignored).
+		//! \param linear
+		//!  Output array of numColors linear colors.
+		//! \param numColors
+		//!  Number of colors to convert.
+		virtual void getLinear(const unsigned char* custom, unsigned bytesPerColor, RRVec3* linear, size_t numColors) const;
+
 		virtual ~RRColorSpace() {}
 
 
@@ -74,6 +110,11 @@ namespace rr
 		//!  Exponent in formula.
 		//!  Use default value for typical screen colors or tweak it for different contrast.
 		static RRColorSpace* create_sRGB(RRReal power=0.45f);
+		//! Creates and returns sRGB color space with exact piecewise sRGB curve (IEC 61966-2-1).
+		//
+		//! Unlike create_sRGB(), it matches sRGB standard in dark colors too (linear segment near black),
+		//! but it does not match sRGB conversion hardcoded in OpenGL renderer shaders.
+		static RRColorSpace* create_sRGB_exact();
 	};
 
 
@@ -259,6 +300,23 @@ namespace rr
 		//! \param interpolated
 		//!  Switches from nearest element selection to linear interpolation of 4 elements.
 		virtual RRVec4 getElementAtPosition(const RRVec3& position, const RRColorSpace* colorSpace, bool interpolated) const;
+		//! Returns value addressed by given float coordinates, averaged over footprint of given size.
+		//
+		//! Faster and less aliased alternative to getElementAtPosition() for textures sampled by many rays.
+		//! Buffers in system memory read from float mipmaps in linear colors,
+		//! built on first use and kept until buffer is deleted, see setMipmapCacheBudget().
+		//! Default implementation, also used for buffers that are not 2d textures, change often or don't fit in budget,
+		//! calls getElementAtPosition().
+		//! \param position
+		//!  Coordinates are array indices in 0..1 range covering whole buffer.
+		//!  Out of range indices are wrapped to 0..1.
+		//! \param footprint
+		//!  Size of area to average, in elements (texels). 1 or less samples full resolution.
+		//! \param colorSpace
+		//!  If nullptr, color is returned in native color space. With colorSpace set, RGB is returned in linear space, alpha in native space.
+		//! \param interpolated
+		//!  Switches from nearest element selection to trilinear interpolation.
+		virtual RRVec4 getElementAtPositionMipmapped(const RRVec2& position, RRReal footprint, const RRColorSpace* colorSpace, bool interpolated) const;
 		//! Returns environment sample addressed by given direction (not necessarily normalized).
 		//
 		//! \param direction
@@ -303,6 +361,21 @@ namespace rr
 		RRBuffer();
 		virtual ~RRBuffer() {};
 
+		//! Sets memory budget for mipmaps of all buffers, built by getElementAtPositionMipmapped().
+		//
+		//! Default is 256MB. Buffers that don't fit are sampled without mipmaps, 0 disables mipmaps completely.
+		//! Lower budget does not free mipmaps already built.
+		static void setMipmapCacheBudget(size_t bytes);
+
+		//! Sets maximal cube side resolution of cache in buffers created by createEnvironmentBlend().
+		//
+		//! Cache is baked after buffer was sampled about as many times as there are texels in cache,
+		//! and rebuilt when environment contents change. Buffer keeps at most several caches, then environments are sampled directly,
+		//! except for RRSolver's environment, solver frees caches of older contents between pathtracing jobs and keeps rebuilding.
+		//! Default is 512. Cache resolution follows environments, lower values save memory and baking time but blur details,
+		//! 0 disables cache.
+		static void setEnvironmentBlendCacheSize(unsigned size);
+
 		//! Returns true if buffer is a stub. When asked to, RRBuffer::load() returns stubs instead of nullptr for missing textures.
 		//
 		//! Stubs are designed to work like other buffers, ideally you won't need this function.
@@ -377,6 +450,8 @@ namespace rr
 		//! Created buffer is suitable only for pathtracing and for createEquirectangular(),
 		//! because it has only getElementAtDirection() and some basic getWidth/Height() implemented, other functions are not available.
 		//! It is cheap to create, as it doesn't copy any data, it accesses original buffers when needed.
+		//! When sampled many times, it bakes blended environments into cube map and returns its bilinearly filtered samples,
+		//! see setEnvironmentBlendCacheSize().
 		static RRBuffer* createEnvironmentBlend(RRBuffer* environment0, RRBuffer* environment1, RRReal angleRad0, RRReal angleRad1, RRReal blendFactor);
 
 
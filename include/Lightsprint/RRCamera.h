@@ -302,6 +302,100 @@ public:
 	//!  False when given position does not contain image; some panorama modes don't cover whole viewport.
 	bool getRay(RRVec2 positionInViewport, RRVec3& rayOrigin, RRVec3& rayDirection, bool randomized=false) const;
 
+	//! Stream of random numbers for getRays(), owned by caller.
+	//
+	//! Rays generated with stream seeded by the same number are reproducible,
+	//! threads generating rays in parallel should use their own streams.
+	class RandomStream
+	{
+	public:
+		//! Streams with different seeds are not correlated.
+		RandomStream(unsigned seed)
+		{
+			state = seed*0x9e3779b9u;
+			state ^= state>>16;
+			state *= 0x85ebca6bu;
+			state ^= state>>13;
+			state *= 0xc2b2ae35u;
+			state ^= state>>16;
+			state |= 1; // xorshift needs nonzero state
+		}
+		//! Returns number in 0..1 range, 1 excluded.
+		RRReal get01()
+		{
+			state ^= state<<13;
+			state ^= state>>17;
+			state ^= state<<5;
+			return (state>>8)*(1.f/16777216);
+		}
+	private:
+		unsigned state;
+	};
+	//! Placement of samples within pixel, for getRays().
+	enum PixelSampling
+	{
+		PS_STRATIFIED =0, ///< Pixel is split to samplesPerAxis*samplesPerAxis subpixels, samples are in their centers. With 1 sample per pixel, it is in pixel center.
+		PS_JITTERED   =1, ///< Pixel is split to samplesPerAxis*samplesPerAxis subpixels, samples are at random positions in them.
+	};
+	//! Converts many positions in viewport to world space rays, results are identical to calling getRay() for each position.
+	//
+	//! It is faster than calling getRay() repeatedly, terms that don't depend on position are calculated only once.
+	//! \param positionsInViewport
+	//!  Array of numRays positions in viewport, see getRay().
+	//! \param numRays
+	//!  Number of rays to generate.
+	//! \param rayOrigins
+	//!  Array of numRays returned ray origins.
+	//! \param rayDirections
+	//!  Array of numRays returned ray directions, not normalized, see getRay().
+	//! \param rayValid
+	//!  Optional array of numRays, filled with results of getRay(); false where position does not contain image.
+	//! \param randomized
+	//!  Randomly shifts rays to create DOF effect, see getRay().
+	//! \param random
+	//!  Random numbers used for randomized rays. Rays are generated in parallel when no random numbers are needed.
+	//!  nullptr = use rand().
+	//! \return
+	//!  Number of valid rays.
+	unsigned getRays(const RRVec2* positionsInViewport, unsigned numRays, RRVec3* rayOrigins, RRVec3* rayDirections, bool* rayValid, bool randomized=false, RandomStream* random=nullptr) const;
+	//! Generates rays for rectangle of pixels in viewport, samplesPerAxis*samplesPerAxis rays per pixel.
+	//
+	//! Pixel x,y covers positions in viewport 2*x/viewportWidth-1 .. 2*(x+1)/viewportWidth-1, 2*y/viewportHeight-1 .. 2*(y+1)/viewportHeight-1,
+	//! i.e. y=0 is the bottom row.
+	//! Rays are ordered by rows, pixels in row, subpixel rows, subpixels in row, i.e.
+	//! ray of subpixel sx,sy in pixel x,y is at index ((y-rectangleY)*rectangleWidth+x-rectangleX)*samplesPerAxis*samplesPerAxis+sy*samplesPerAxis+sx.
+	//! \param viewportWidth
+	//!  Width of whole viewport in pixels.
+	//! \param viewportHeight
+	//!  Height of whole viewport in pixels.
+	//! \param rectangleX
+	//!  Left column of pixels to generate rays for.
+	//! \param rectangleY
+	//!  Bottom row of pixels to generate rays for.
+	//! \param rectangleWidth
+	//!  Number of columns to generate rays for.
+	//! \param rectangleHeight
+	//!  Number of rows to generate rays for.
+	//! \param samplesPerAxis
+	//!  Pixel is split to samplesPerAxis*samplesPerAxis subpixels, each gets one ray.
+	//! \param sampling
+	//!  Placement of rays within subpixels.
+	//! \param rayOrigins
+	//!  Array of rectangleWidth*rectangleHeight*samplesPerAxis*samplesPerAxis returned ray origins.
+	//! \param rayDirections
+	//!  Array of the same size, returned ray directions, not normalized, see getRay().
+	//! \param rayValid
+	//!  Optional array of the same size, false where position does not contain image.
+	//! \param randomized
+	//!  Randomly shifts rays to create DOF effect, see getRay().
+	//! \param random
+	//!  Random numbers used by PS_JITTERED and randomized rays. Rays are generated in parallel when no random numbers are needed.
+	//!  nullptr = use rand().
+	//! \return
+	//!  Number of valid rays.
+	unsigned getRays(unsigned viewportWidth, unsigned viewportHeight, unsigned rectangleX, unsigned rectangleY, unsigned rectangleWidth, unsigned rectangleHeight,
+		unsigned samplesPerAxis, PixelSampling sampling, RRVec3* rayOrigins, RRVec3* rayDirections, bool* rayValid, bool randomized=false, RandomStream* random=nullptr) const;
+
 	//! Assignment operator.
 	const RRCamera& operator=(const RRCamera& camera);
 	//! == operator, true when inputs without aspect are equal. Transformations like setPosition(getPosition()) preserve identity, while setDirection(getDirection()) not, due to limited float precision.
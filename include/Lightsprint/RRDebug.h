@@ -61,8 +61,8 @@ namespace rr
 	//!
 	//! Thread safe: yes with exception,
 	//!   multiple threads may report at once,
-	//!   multiple threads may create/delete reporters at once,
-	//!   but you must not create/delete reporters and report at the same time (very unlikely case).
+	//!   multiple threads may create/delete reporters at once, also while other threads report,
+	//!   see setAsynchronous() for safe deletion of custom reporters.
 	//! All new implementations must be at least this thread safe too.
 	//
 	//////////////////////////////////////////////////////////////////////////////
@@ -103,6 +103,22 @@ namespace rr
 		//! Shortcut for customReport() with vprintf syntax.
 		static void reportV(RRReportType type, const char* format, va_list& vars);
 
+		//! Enables delivery of messages to reporters from background thread.
+		//
+		//! Synchronous delivery (default) calls customReport() of all reporters before report() returns.
+		//! Asynchronous delivery only formats message and adds it to queue, so logging from many threads
+		//! doesn't wait for slow reporters (e.g. file or window). Order of messages is preserved.
+		//! Errors and assertion failures are delivered before report() returns even in asynchronous mode.
+		//! Asynchronous delivery ends automatically at exit, remaining messages are delivered.
+		//!
+		//! Reporters may be created and deleted from any thread in both modes. Reporter being deleted must not receive
+		//! messages while its destructor runs, so delete custom reporters only when no other thread reports,
+		//! or call flush() before deleting them when you know no new messages come.
+		static void setAsynchronous(bool asynchronous);
+
+		//! Waits until all messages reported so far are delivered to reporters. Does nothing in synchronous mode.
+		static void flush();
+
 		//! Modifies indentation of future reports. +1 extends whitespace size, -1 reduces whitespace.
 		static void indent(int delta);
 
@@ -115,6 +131,7 @@ namespace rr
 		//
 		//! \param warnings
 		//!  Enables processing of warning messages (WARN).
+		//!  Warning reported too many times (with the same text) within a few seconds is suppressed, so that it does not flood logs.
 		//! \param infLevel
 		//!  Enables processing of INFx messages for x<=infLevel. E.g. 1 enables only the most important INF1 messages,
 		//!  2 enables also less important INF2 messages.
@@ -167,6 +184,17 @@ namespace rr
 
 		//! Helper, converts number of bytes to human readable string, e.g. 12345678 to "12 MB".
 		static const char* bytesToString(size_t bytes);
+
+	protected:
+		//! For reporters that must not receive messages while they are constructed or destructed by other thread.
+		//
+		//! Default ctor registers reporter before derived class is constructed and base dtor unregisters it
+		//! after derived class is destructed, so customReport() called from other thread meanwhile would see incomplete object.
+		//! Ctor with registerNow=false does not register, derived class calls registerReporter() at the end of its ctor
+		//! and unregisterReporter() at the beginning of its dtor. unregisterReporter() returns when no customReport() call runs.
+		RRReporter(bool registerNow);
+		void registerReporter();
+		void unregisterReporter();
 	};
 
 	//////////////////////////////////////////////////////////////////////////////
@@ -216,6 +244,90 @@ namespace rr
 		RRTime time;
 	};
 
+	//////////////////////////////////////////////////////////////////////////////
+	//
+	//! Performance counters of bake stages
+	//
+	//! When enabled, Lightsprint internals measure time spent in stages of work
+	//! (direct illumination detection, photon shooting, form factor refresh, final gather, filtering, compression...)
+	//! and count work done in them (rays, photons...).
+	//! Stages opened inside other stages form tree, e.g. updateLightmaps/updateLightmap/gather.
+	//! Each thread counts into its own memory, counts of all threads are merged when saved.
+	//! Threads don't see stages of other threads, parallel work inherits stage explicitly:
+	//! \code
+	//! unsigned stage = RRProfiler::getStage();
+	//! #pragma omp parallel for
+	//! for (...)
+	//! {
+	//!   RR_PROFILE_PARENT(stage);
+	//!   ... // counts go to stage of thread that started loop
+	//! }
+	//! \endcode
+	//! \n Usage example: \code
+	//! RRProfiler::setEnabled(true);
+	//! solver->updateLightmaps(0,-1,-1,&params,nullptr);
+	//! RRProfiler::save("profile.json");
+	//! \endcode
+	//!
+	//! Thread safe: yes, except for reset().
+	//
+	//////////////////////////////////////////////////////////////////////////////
+
+	class RR_API RRProfiler
+	{
+	public:
+		//! Enables or disables profiling. Disabled by default, disabled profiling costs one test per stage or counter.
+		static void setEnabled(bool enabled);
+		//! Returns state set by setEnabled().
+		static bool isEnabled();
+		//! Clears times and counts of all stages. Call it when no stage runs.
+		static void reset();
+		//! Returns id of named counter, for count(). Name must exist as long as profiler, e.g. string literal.
+		static unsigned getCounterId(const char* name);
+		//! Adds value to counter in innermost stage of current thread (opened by Scope or inherited by Parent).
+		//
+		//! Threads without stage count into root, shown as "total".
+		static void count(unsigned counterId, unsigned long long value);
+		//! Returns innermost stage of current thread, for Parent in other threads.
+		static unsigned getStage();
+		//! Saves times and counts of all stages, in JSON or CSV format, depending on filename extension (.json or .csv).
+		static bool save(const char* filename);
+
+		//! Stage of work, measures time from construction to destruction.
+		class RR_API Scope
+		{
+		public:
+			//! Name must exist as long as profiler, e.g. string literal.
+			Scope(const char* name);
+			~Scope();
+		private:
+			unsigned stage;
+			unsigned previous;
+			unsigned long long start;
+		};
+
+		//! Makes stage returned by getStage() in other thread innermost stage of current thread, until destruction.
+		//
+		//! Used by workers of parallel loops, so that their counts and stages go under stage of thread that started loop.
+		class RR_API Parent
+		{
+		public:
+			Parent(unsigned stage);
+			~Parent();
+		private:
+			unsigned previous;
+		};
+	};
+
+	#define RR_PROFILE_CONCAT2(a,b) a##b
+	#define RR_PROFILE_CONCAT(a,b) RR_PROFILE_CONCAT2(a,b)
+	//! Measures time of stage from here to the end of block.
+	#define RR_PROFILE_SCOPE(name) rr::RRProfiler::Scope RR_PROFILE_CONCAT(profileScope,__LINE__)(name)
+	//! Makes stage (from RRProfiler::getStage() in thread that started parallel work) current stage from here to the end of block.
+	#define RR_PROFILE_PARENT(stage) rr::RRProfiler::Parent RR_PROFILE_CONCAT(profileParent,__LINE__)(stage)
+	//! Adds value to named counter in current stage.
+	#define RR_PROFILE_COUNT(name,value) {if (rr::RRProfiler::isEnabled()) {static unsigned counterId = rr::RRProfiler::getCounterId(name); rr::RRProfiler::count(counterId,value);}}
+
 } // namespace
 
 #endif
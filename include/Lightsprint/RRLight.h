@@ -79,6 +79,35 @@ namespace rr
 		//! Light has effect in sphere of given radius.
 		RRReal radius;
 
+		//! Shapes of light source.
+		enum AreaType
+		{
+			//! Infinitesimally small light source, hard shadows.
+			AREA_NONE = 0,
+			//! Sphere with radius areaSize.x, centered in position.
+			AREA_SPHERE,
+			//! Disk with radius areaSize.x, centered in position, perpendicular to direction.
+			AREA_DISK,
+			//! Rectangle areaSize.x*areaSize.y, centered in position, perpendicular to direction.
+			//! Side x is horizontal (perpendicular to world y axis), or parallel to world x axis if direction is vertical.
+			AREA_RECTANGLE,
+		};
+		//! Shape of light source. Relevant only for POINT and SPOT light.
+		//
+		//! Light with area casts soft shadows in offline solver and pathtracer.
+		//! Disk and rectangle behave like many point/spot lights with the same properties spread over area.
+		//! Sphere behaves like sphere of uniform radiance, far from sphere it is as bright as point light.
+		//! Realtime renderer ignores area, it renders light from position.
+		AreaType areaType;
+		//! Size of light source in world space, see AreaType.
+		RRVec2 areaSize;
+		//! Angular diameter of light source in radians. Relevant only for DIRECTIONAL light.
+		//
+		//! 0 makes all light rays parallel, shadows are hard.
+		//! More makes light come from cone of given angle around direction, shadows are soft in offline solver and pathtracer.
+		//! Sun has approximately 0.0093 (0.53 degrees).
+		RRReal angularDiameterRad;
+
 
 		//////////////////////////////////////////////////////////////////////////////
 		// Color
@@ -249,6 +278,39 @@ namespace rr
 		//!  predicts infinite number (some types of attenuation + zero distance).
 		virtual RRVec3 getIrradiance(const RRVec3& receiverPosition, const RRColorSpace* colorSpace) const;
 
+		//! Returns irradiance from one sample of light source, for soft shadows from area lights.
+		//
+		//! Sample selects point of area (see #areaType) or direction inside #angularDiameterRad.
+		//! Average of results for many well distributed samples is irradiance from whole light source.
+		//! For light without area, it returns getIrradiance() regardless of sample.
+		//! \param receiverPosition
+		//!  Position of point in world space illuminated by this light.
+		//! \param sample
+		//!  Two numbers in <0,1> range. Stratified samples give less noise than random ones.
+		//! \param colorSpace
+		//!  The same as in getIrradiance().
+		//! \param directionToLight
+		//!  Filled with normalized direction from receiver to sampled point of light source.
+		//! \param distanceToLight
+		//!  Filled with distance from receiver to sampled point of light source, 1e10 for directional light.
+		//! \return
+		//!  Irradiance at receiverPosition from sample as linear color,
+		//!  assuming that receiver is oriented towards directionToLight.
+		RRVec3 getIrradianceSample(const RRVec3& receiverPosition, const RRVec2& sample, const RRColorSpace* colorSpace, RRVec3& directionToLight, RRReal& distanceToLight) const;
+		//! Returns getIrradiance() for many receivers at once.
+		//
+		//! Results are the same as from calling getIrradiance() for each receiver, but work that does not depend
+		//! on receiver (e.g. projection of spotlight's projected texture and its conversion to linear colors)
+		//! is done only once per call, so it is much faster for many receivers.
+		//! Lights with custom getIrradiance() are evaluated by calling it.
+		void getIrradiances(const RRVec3* receiverPositions, RRVec3* irradiances, unsigned numReceivers, const RRColorSpace* colorSpace) const;
+		//! Returns getIrradianceSample() for many receivers and samples at once, faster than calling it for each.
+		void getIrradianceSamples(const RRVec3* receiverPositions, const RRVec2* samples, RRVec3* irradiances, RRVec3* directionsToLight, RRReal* distancesToLight, unsigned numReceivers, const RRColorSpace* colorSpace) const;
+		//! Returns true if light source has area or angular diameter, so that getIrradianceSample() depends on sample.
+		bool isAreaLight() const;
+		//! Returns radius of sphere around position that contains whole light source, 0 for point/spot light without area.
+		RRReal getAreaRadius() const;
+
 
 		//////////////////////////////////////////////////////////////////////////////
 		// Blending
@@ -228,6 +228,7 @@ namespace rr
 			BLINN_PHONG            = 1, ///< as in http://en.wikipedia.org/wiki/Blinn%E2%80%93Phong_shading_model (shininess in 1..inf)
 			TORRANCE_SPARROW       = 2, ///< as in Zara J.: Pocitacova grafika (1992) (roughness in 0..1)
 			BLINN_TORRANCE_SPARROW = 3, ///< as in http://www.siggraph.org/education/materials/HyperGraph/illumin/specular_highlights/blinn_model_for_specular_reflect_1.htm (roughness in 0..1)
+			GGX                    = 4, ///< GGX/Trowbridge-Reitz microfacet distribution with height-correlated Smith masking, as used by PBR metallic/roughness materials (roughness in 0..1, alpha=roughness^2)
 		};
 		//! Selects what model / distribution function to use for specular reflectance.
 		SpecularModel specularModel;
@@ -344,6 +345,11 @@ namespace rr
 		//! Calculates direction and color of light exiting surface in response to incoming white light (dirNormal, dirOut -> dirIn, colorOut, pdf, brdfType
 		void sampleResponse(Response& response, const RRVec3& randomness, BrdfType type = BRDF_ALL) const;
 
+		//! Returns probability density of sampleResponse() generating given dirIn (dirIn, dirNormal, dirOut -> pdf), e.g. for multiple importance sampling.
+		//
+		//! Result is in the same units as Response::pdf. Type must be single BRDF (BRDF_DIFFUSE, BRDF_SPECULAR or BRDF_TRANSMIT).
+		RRReal getResponsePdf(const Response& response, BrdfType type) const;
+
 
 		//////////////////////////////////////////////////////////////////////////////
 		// Loaders/Savers
@@ -361,6 +367,15 @@ namespace rr
 	//! it's just shallow copy for immediate consumption. So never manipulate textures and name in point materials.
 	struct RR_API RRPointMaterial : public RRMaterial
 	{
+		RRPointMaterial() {rayFootprint = 0;}
+		//! Optional input of RRObject::getPointMaterial(), width of ray cone at sampled point, in units of mesh.
+		//
+		//! When set, textures are sampled from mipmaps of matching resolution (see RRBuffer::getElementAtPositionMipmapped()),
+		//! which is faster and less noisy for rays that hit texture from distance.
+		//! 0 = sample textures in full resolution.
+		//! Preserved by operator =(const RRMaterial&).
+		RRReal rayFootprint;
+
 		//! Fast and thread safe copy. getPointMaterial() implementations use it to copy triangle material to point material.
 		RRPointMaterial& operator =(const RRMaterial& a);
 		//! Makes it possible to store pointmaterials in vector.
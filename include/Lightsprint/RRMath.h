@@ -54,9 +54,10 @@
 #include <cfloat>
 #include <cmath>
 
-#if __clang_major__ > 18
+#if __clang_major__ > 18 || (defined(__GNUC__) && !defined(_WIN32))
 	// clang 17 distributed as a visual studio 2022 toolset warns about strdup, use _strdup
 	// clang 19 distributed as an emsdk compiler does not know _strdup, use strdup
+	// gcc in linux does not know _strdup, use strdup
 	#define _strdup strdup
 #endif
 #if defined(__GNUC__) || defined(__clang__)
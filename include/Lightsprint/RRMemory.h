@@ -145,6 +145,59 @@ namespace rr
 	};
 
 
+	//////////////////////////////////////////////////////////////////////////////
+	//
+	//  RRArena
+	//! Fast allocator for temporary data, freed all at once.
+	//
+	//! Each thread has its own arena, allocations are not synchronized.
+	//! Memory is not freed individually, everything allocated since construction of Scope
+	//! is released when Scope is destructed. Destructors of objects placed in arena are not called.
+	//! Memory comes from big slabs (huge pages where OS supports them), slabs are reused by following scopes
+	//! and returned to OS when the outermost scope ends.
+	//! In debug build, released memory is overwritten with 0xdd.
+	//! \n Usage example: \code
+	//! RRArena::Scope scope; // releases memory at the end of block
+	//! RRVec3* tmp = RRArena::getThreadArena().allocateArray<RRVec3>(numVertices);
+	//! \endcode
+	//
+	//////////////////////////////////////////////////////////////////////////////
+
+	class RR_API RRArena : public RRUniformlyAllocatedNonCopyable
+	{
+	public:
+		//! Returns arena of current thread.
+		static RRArena& getThreadArena();
+
+		//! Returns uninitialized memory aligned to alignment (power of two), nullptr when system is out of memory.
+		void* allocate(std::size_t bytes, std::size_t alignment = 16);
+
+		//! Returns uninitialized array of n elements, nullptr when system is out of memory.
+		template <class C> C* allocateArray(std::size_t n) {return (C*)allocate(n*sizeof(C),RR_MAX(alignof(C),16));}
+
+		//! Releases memory allocated since construction of scope. Scopes of one arena must be nested.
+		class RR_API Scope
+		{
+		public:
+			Scope(RRArena& arena = getThreadArena());
+			~Scope();
+		private:
+			RRArena& arena;
+			struct Slab* slab;
+			std::size_t used;
+		};
+
+		~RRArena();
+	private:
+		RRArena();
+		void releaseSlabs();
+		struct Slab* firstSlab;
+		struct Slab* currentSlab; // slabs after this one are free
+		std::size_t used; // bytes used in currentSlab
+		unsigned numScopes;
+	};
+
+
 	//////////////////////////////////////////////////////////////////////////////
 	//
 	//! Minimalistic string, for portable API.
@@ -93,7 +93,16 @@ namespace rr
 		//
 		//! First facegroup describes first numTriangles in object, next facegroup next triangles etc.
 		//! Results are undefined if faceGroups contains nullptr materials or fewer triangles than mesh.
+		//! When you change numTriangles of existing facegroup or replace facegroups with the same number of different ones,
+		//! increment faceGroupsVersion, otherwise getTriangleMaterial() keeps using stale index and returns wrong materials.
+		//! Don't modify faceGroups while other threads use the object.
 		FaceGroups faceGroups;
+		//! Version of faceGroups, increment it when you modify faceGroups without changing their count.
+		//
+		//! Default getTriangleMaterial() uses index built from faceGroups, it is rebuilt when version or number of facegroups changes.
+		//! So after changing numTriangles of existing facegroup or after assigning different facegroups of the same count,
+		//! increment version. Changing material of existing facegroup does not need it.
+		unsigned faceGroupsVersion;
 
 		//! Returns collider of underlying mesh. It is also access to mesh itself (via getCollider()->getMesh()).
 		//! Must always return valid collider, implementation is not allowed to return nullptr.
@@ -354,6 +363,7 @@ namespace rr
 	private:
 		RRCollider* collider;
 		RRMatrix3x4Ex* worldMatrix;
+		class FaceGroupIndex* faceGroupIndex; // triangle->facegroup lookup used by getTriangleMaterial()
 	};
 
 
@@ -386,6 +396,8 @@ namespace rr
 		//! Loads illumination layer from disk.
 		//
 		//! It is shortcut for calling illumination->getLayer() = RRBuffer::load() on all elements in this container.
+		//! Files may be read and decoded in parallel (see maxThreads), RRObject::recommendLayerParameters() is called from caller's thread only.
+		//! Result does not depend on number of threads.
 		//! \param layerNumber
 		//!  Layer to load, nothing is done for negative number.
 		//! \param path
@@ -393,13 +405,21 @@ namespace rr
 		//! \param ext
 		//!  File format of maps to load, e.g. "png".
 		//!  Vertex buffers are always loaded from .rrbuffer, without regard to ext.
+		//! \param maxThreads
+		//!  Maximal number of files loaded at once. Default 1 loads files one by one.
+		//!  Other values (0 for as many as OpenMP allows) call registered loaders from several threads at once,
+		//!  use them only if all loaders are thread safe (image and .rrbuffer loaders registered by rr_io::registerIO() are).
+		//!  Keep 1 on slow media (e.g. spinning disk) where parallel reads compete for seeks.
 		//! \remark
 		//!  rr_io::registerIO() must be called for image saves/loads to work.
-		virtual unsigned loadLayer(int layerNumber, const RRString& path, const RRString& ext) const;
+		virtual unsigned loadLayer(int layerNumber, const RRString& path, const RRString& ext, unsigned maxThreads=1) const;
 
 		//! Saves illumination layer to disk.
 		//
 		//! It is shortcut for calling illumination->getLayer()->save() on all elements in this container.
+		//! Files may be encoded and written in parallel (see maxThreads), RRObject::recommendLayerParameters() is called from caller's thread only.
+		//! Buffers shared by several objects and objects saving to the same filename are saved sequentially in object order,
+		//! so files are identical to those saved by single thread.
 		//! \param layerNumber
 		//!  Layer to save, nothing is done for negative number.
 		//! \param path
@@ -407,9 +427,13 @@ namespace rr
 		//! \param ext
 		//!  File format of maps to save, e.g. "png".
 		//!  Vertex buffers are always saved to .rrbuffer, without regard to ext.
+		//! \param maxThreads
+		//!  Maximal number of files saved at once. Default 1 saves files one by one.
+		//!  Other values (0 for as many as OpenMP allows) call registered savers from several threads at once,
+		//!  use them only if all savers are thread safe (image and .rrbuffer savers registered by rr_io::registerIO() are).
 		//! \remark
 		//!  rr_io::registerIO() must be called for image saves/loads to work.
-		virtual unsigned saveLayer(int layerNumber, const RRString& path, const RRString& ext) const;
+		virtual unsigned saveLayer(int layerNumber, const RRString& path, const RRString& ext, unsigned maxThreads=1) const;
 
 		//! Returns number of buffers in memory.
 		virtual unsigned layerExistsInMemory(int layerNumber) const;
@@ -491,7 +515,8 @@ namespace rr
 		//! This is case of solver; if you build unwrap in solver <code>solver->getStaticObjects().buildUnwrap(...)</code>,
 		//! you have to resend modified objects to solver <code>solver->setStaticObjects(solver->getStaticObjects(),...)</code>.
 		//!
-		//! Currently it is implemented only for Windows platform.
+		//! On Windows, it uses D3DX UVAtlas from DirectX runtime. On other platforms, it uses built-in unwrapper
+		//! that segments mesh to charts by normals, parameterizes them by LSCM and packs them in parallel.
 		//! \param resolution
 		//!  Expected lightmap resolution, e.g. 1024 for 1024x1024.
 		//! \param minimalUvChannel
@@ -499,6 +524,7 @@ namespace rr
 		//!  So if minimalUvChannel=2, unwrap is never created to channel 0 or 1.
 		//! \param minTrianglesForFastUnwrap
 		//!  Higher quality but slower technique is used for meshes with lower number of triangles. It is too slow for large meshes, so reasonable threshold could be 25000.
+		//!  Built-in unwrapper uses planar projection of charts in fast mode.
 		//! \param aborting
 		//!  May be set asynchronously, aborts build.
 		//! \return Number of new unwrap uv channel, it's the same for all meshes. UINT_MAX in case of failure/no unwrapping.
@@ -639,6 +665,51 @@ namespace rr
 		virtual ~RRObjects() {};
 	};
 
+
+	//////////////////////////////////////////////////////////////////////////////
+	//
+	//! Bounding volume hierarchy of objects, for culling large collections of objects.
+	//
+	//! Hierarchy is built over world space bounding boxes of objects and kept between frames,
+	//! moved objects only refit boxes.
+	//! Culling does not depend on renderer, any RRCamera can be used.
+	//
+	//////////////////////////////////////////////////////////////////////////////
+
+	class RR_API RRObjectBVH : public RRUniformlyAllocatedNonCopyable
+	{
+	public:
+		//! Creates hierarchy of given objects.
+		//
+		//! Objects are not copied, they must stay alive until next update() or destruction of hierarchy.
+		static RRObjectBVH* create(const RRObjects& objects);
+
+		//! Updates hierarchy after objects moved or collection changed.
+		//
+		//! Changed world matrix, mesh, mesh's getAABB() or number of triangles is detected and bounding boxes refitted; hierarchy is rebuilt
+		//! when collection changes, when object gets its first triangles or loses all of them, or when refitted boxes make it too inefficient.
+		//! Edited vertex positions are detected only if mesh's getAABB() reflects them,
+		//! RRMeshArrays does after you increment its version. Other meshes cache their box forever,
+		//! create new hierarchy after editing them.
+		virtual void update(const RRObjects& objects) = 0;
+
+		//! Finds objects potentially visible by camera.
+		//
+		//! \param camera
+		//!  Camera to cull for. Panorama cameras don't cull.
+		//! \param occlusionResolution
+		//!  0 = frustum culling only.
+		//!  Otherwise also occlusion culling, with big opaque objects rasterized into software depth buffer of given width, e.g. 256.
+		//!  It helps in dense scenes (cities, interiors), adds CPU work in open scenes.
+		//! \param visible
+		//!  Resized to number of objects, i-th element is set to false when i-th object is culled.
+		//! \return
+		//!  Number of potentially visible objects.
+		virtual unsigned cull(const class RRCamera& camera, unsigned occlusionResolution, RRVector<bool>& visible) const = 0;
+
+		virtual ~RRObjectBVH() {};
+	};
+
 } // namespace
 
 #endif
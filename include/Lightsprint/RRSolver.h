@@ -160,6 +160,22 @@ namespace rr
 		//! Returns pointer previously passed to setDirectIllumination(), or nullptr if it was not set yet.
 		const unsigned* getDirectIllumination();
 
+		//! Detects direct illumination from lights on static triangles using CPU only, and sends it to setDirectIllumination().
+		//
+		//! This is alternative to rr_gl::RRSolverGL, which detects direct illumination on GPU,
+		//! for machines without OpenGL, e.g. headless servers.
+		//! Call it before each calculate(), it returns quickly when lights did not change.
+		//!
+		//! Irradiance is averaged from stratified samples on triangle, each sample casts shadow ray to light.
+		//! Shadows are cast by static objects, transparency of materials is respected.
+		//! Results are cached per light, only lights reported by reportDirectIlluminationChange() with dirtyGI=true
+		//! are recalculated, and only on triangles they can reach.
+		//! \param samplesPerTriangle
+		//!  Number of shadow rays per triangle and light. More = smoother shadow edges, slower.
+		//! \return
+		//!  True if direct illumination changed and setDirectIllumination() was called.
+		bool detectDirectIlluminationCPU(unsigned samplesPerTriangle = 4);
+
 
 		//! Illumination smoothing parameters.
 		struct SmoothingParameters
@@ -501,6 +517,13 @@ namespace rr
 
 			//! Use bump maps, when available. It makes lightmaps more detailed, but calculation is bit slower.
 			bool useBumpMaps;
+			//! Sample textures hit by gather rays from mipmaps matching ray footprint, instead of full resolution.
+			//
+			//! Each ray represents 2pi/quality steradians of hemisphere, distant textures are then averaged over matching area.
+			//! It reduces noise from high frequency textures and speeds up gathering in heavily textured scenes,
+			//! but it changes results slightly and mipmaps take memory, see RRBuffer::setMipmapCacheBudget().
+			//! Default false samples textures in full resolution.
+			bool useTextureMipmaps;
 
 			//! Higher value makes indirect illumination in corners darker, 0=disabled/lighter, default 1=normal, 2=darker.
 			RRReal aoIntensity;
@@ -535,6 +558,34 @@ namespace rr
 			//! outer environment/sky.)
 			RRReal locality;
 
+			//! Number of shadow rays per round shot to point and spot lights, 0 = one ray to each light.
+			//
+			//! Time spent on direct illumination grows with number of lights.
+			//! When object receives light from more than 32*lightSamples point/spot lights, baker shoots only lightSamples rays per round
+			//! to lights picked randomly, with probability proportional to their estimated contribution.
+			//! Result converges to the same illumination as with all lights, with more noise at the same quality.
+			//! Directional lights and lights without distance attenuation are not picked, they get one ray per round always.
+			//! With fewer lights, picking would take longer than shooting to all lights for the same noise, so all lights get ray.
+			//! Default 0 shoots to all lights.
+			unsigned lightSamples;
+			//! Irradiance below which point and spot lights are treated as not reaching receiver, 0 = only where they emit nothing.
+			//
+			//! Before shooting, baker skips lights that can't reach texel (or triangle cluster), e.g. receiver is beyond radius
+			//! of light with EXPONENTIAL attenuation or outside spotlight cone. Such lights would contribute exactly zero anyway.
+			//! REALISTIC and POLYNOMIAL lights reach infinitely far, with nonzero lightCutoffIrradiance they are skipped
+			//! also where irradiance estimated from their color and distance attenuation is below this value.
+			//! Small value like 0.001 saves lots of rays in scenes with many local lights, at the cost of losing light that sums up from many distant lights.
+			//! Default 0 produces the same illumination as shooting to all lights.
+			//! Negative value disables culling, rays are shot to all lights, only slower; it is meant for verifying culling.
+			RRReal lightCutoffIrradiance;
+			//! Seed for random numbers in gathering, 0 = rand() makes each bake different.
+			//
+			//! With nonzero seed, sample positions in texel (triangle in per-triangle calculation), points sampled on area lights,
+			//! lights picked with lightSamples and first directions into hemisphere depend only on seed and texel,
+			//! so repeated bakes of direct illumination from lights are identical regardless of thread scheduling.
+			//! Further bounces of hemisphere rays stay random.
+			unsigned randomSeed;
+
 			//! For internal use only, don't change default RM_IRRADIANCE_CUSTOM_INDIRECT value.
 			RRRadiometricMeasure measure_internal;
 
@@ -561,11 +612,15 @@ namespace rr
 				quality = 0;
 				qualityFactorRadiosity = 1;
 				useBumpMaps = true;
+				useTextureMipmaps = false;
 				aoIntensity = 1;
 				aoSize = 0;
 				insideObjectsThreshold = 1;
 				rugDistance = 0.001f;
 				locality = 100000;
+				lightSamples = 0;
+				lightCutoffIrradiance = 0;
+				randomSeed = 0;
 				measure_internal = RM_IRRADIANCE_CUSTOM_INDIRECT;
 				debugObject = UINT_MAX;
 				debugTexel = UINT_MAX;
@@ -579,9 +634,13 @@ namespace rr
 				quality = _quality;
 				qualityFactorRadiosity = 1;
 				useBumpMaps = true;
+				useTextureMipmaps = false;
 				insideObjectsThreshold = 1;
 				rugDistance = 0.001f;
 				locality = 100000;
+				lightSamples = 0;
+				lightCutoffIrradiance = 0;
+				randomSeed = 0;
 				aoIntensity = 1;
 				aoSize = 0;
 				measure_internal = RM_IRRADIANCE_CUSTOM_INDIRECT;
@@ -735,7 +794,32 @@ namespace rr
 		//! \remarks
 		//!  Sharing one lightmap by multiple objects is not supported out of the box. Please consult us for possible solutions.
 		virtual unsigned updateLightmaps(int layerLightmap, int layerDirectionalLightmap, int layerBentNormals, const UpdateParameters* params, const FilteringParameters* filtering);
-		
+
+		//! Calculates hashes of all inputs that affect baked illumination of static objects, for incremental baking.
+		//
+		//! Hash of n-th static object combines its own geometry, materials and transformation
+		//! with hashes of lights, environment and other static objects that can affect its illumination:
+		//! - lights whose range (see RRLight::radius) reaches the object, or reaches within params->locality if indirect light is enabled
+		//! - objects closer than params->locality (they occlude, reflect or emit light)
+		//! - objects that can cast shadow from relevant light to the object
+		//!
+		//! Store hash together with baked lightmap. After scene edit, compare new hash with stored one
+		//! and call updateLightmap()/updateLightmaps() only for objects whose hash changed.
+		//! Hashes are persistent, they don't depend on addresses or versions of objects in memory.
+		//! \param params
+		//!  Parameters you are going to bake with, they are part of hash.
+		//! \param hashes
+		//!  Array of getStaticObjects().size() hashes, filled by function.
+		//! \param influencers
+		//!  Optional array of getStaticObjects().size() vectors, filled by function.
+		//!  For each static object, it receives indices of static objects (0..numObjects-1)
+		//!  and lights (numObjects..numObjects+numLights-1) that were included into object's hash.
+		//! \remarks
+		//!  Dependencies are approximated conservatively using world space bounding boxes.
+		//!  Light bouncing more than params->locality away is not tracked, so objects that receive
+		//!  only distant secondary bounces of changed light keep their old hash.
+		void getLightmapDependencies(const UpdateParameters* params, RRHash* hashes, RRVector<unsigned>* influencers = nullptr) const;
+
 		//! Makes other solver functions abort, returning quickly with bogus results.
 		//
 		//! You may set/unset it asynchronously, from other threads.
@@ -760,8 +844,9 @@ namespace rr
 		//! dynamic objects will reflect light from previous frame, or no light at all.
 		//! If you have to update envmaps before calculate(), use RRSolverGL::updateEnvironmentMap().
 		//!
-		//! Thread safe: yes, may be called from multiple threads at the same time
-		//!  (but there's no need as it uses all cores internally)
+		//! Thread safe: yes, may be called from any number of threads at the same time, for different illuminations
+		//!  (single call already uses all cores internally, but updating many small cubes in parallel scales better).
+		//!  Result does not depend on number of threads.
 		//!
 		//! \param illumination
 		//!  Object's illumination to be updated.
@@ -1036,11 +1121,13 @@ namespace rr
 		unsigned updateVertexBufferFromPerTriangleDataPhysical(unsigned objectHandle, RRBuffer* vertexBuffer, RRVec3* perTriangleDataPhysical, unsigned stride, bool allowScaling) const;
 		void calculateCore(float improveStep, const CalculateParameters* params=nullptr);
 		unsigned updateVertexBufferFromSolver(int objectNumber, RRBuffer* vertexBuffer, const UpdateParameters* params);
+		unsigned updateVertexBuffersFromSolver(unsigned numBuffers, const int* objectNumbers, RRBuffer* const* vertexBuffers, const UpdateParameters* params);
 		void updateVertexLookupTableDynamicSolver();
 		void updateVertexLookupTablePackedSolver();
 		bool cubeMapGather(RRObjectIllumination* illumination, unsigned layerEnvironment);
 		struct Private;
 		Private* priv;
+		friend class PathtracerJob;
 		friend class PathtracerWorker;
 	};
 
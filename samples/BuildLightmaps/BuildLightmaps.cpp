@@ -50,16 +50,38 @@
 // Quality of produced maps highly depends on quality of unwrap.
 // Unwrap is imported from scene file.
 // It can also be generated by RRObjects::buildUnwrap(), but we don't do it in this tool.
+//
+// In Linux, lightmaps can be baked by multiple local worker processes (workers=N),
+// see "local bake farm" below.
+//
+// With incremental, hash of inputs is saved next to maps of each object
+// and maps whose inputs did not change are not baked again.
 // --------------------------------------------------------------------------
 
 #define SCENE_VIEWER // adds viewer option, runs scene viewer after lightmap build
 
 #include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <string>
 #include <vector>
 #ifdef _WIN32
 	#include <windows.h>
 	#include <direct.h> // _chdir
+#else
+	#include <cerrno>
+	#include <csignal> // kill
+	#include <deque>
+	#include <poll.h>
+	#include <sched.h> // sched_setaffinity
+	#include <sys/socket.h> // socketpair
+	#include <sys/stat.h> // mkdir
+	#include <sys/wait.h> // waitpid
+	#include <unistd.h> // fork
+	#define _mkdir(dir) mkdir(dir,0777)
+#endif
+#ifdef _OPENMP
+	#include <omp.h>
 #endif
 #include "Lightsprint/RRMath.h"
 #include "Lightsprint/IO/IO.h"
@@ -117,9 +139,15 @@ struct Parameters
 	const char* skyBox;
 	float emissiveMultiplier;
 	unsigned buildQuality;
+	unsigned lightSamples;
+	float lightCutoffIrradiance;
+	unsigned randomSeed;
 	float directLightMultiplier;
 	float indirectLightMultiplier;
 	bool runViewer;
+	unsigned numWorkers;
+	bool incremental;
+	const char* statsFilename;
 
 	// per object
 	bool buildDirectional;
@@ -145,6 +173,9 @@ struct Parameters
 		skyBox = nullptr;
 		emissiveMultiplier = 1;
 		buildQuality = 0;
+		lightSamples = 0;
+		lightCutoffIrradiance = 0;
+		randomSeed = 0;
 		directLightMultiplier = 1;
 		indirectLightMultiplier = 1;
 		buildDirectional = false;
@@ -152,6 +183,9 @@ struct Parameters
 		buildBentNormals = false;
 		buildNothing = false;
 		runViewer = false;
+		numWorkers = 0;
+		incremental = false;
+		statsFilename = nullptr;
 		aoIntensity = 1;
 		aoSize = 0;
 		ppSmoothing = 1;
@@ -172,6 +206,18 @@ struct Parameters
 				{
 				}
 				else
+				if (sscanf(argv[i],"lightsamples=%d",&lightSamples)==1)
+				{
+				}
+				else
+				if (sscanf(argv[i],"lightcutoff=%f",&lightCutoffIrradiance)==1)
+				{
+				}
+				else
+				if (sscanf(argv[i],"seed=%d",&randomSeed)==1)
+				{
+				}
+				else
 		 		if (!strcmp(argv[i],"occlusion"))
 				{
 					buildOcclusion = true;
@@ -268,6 +314,20 @@ struct Parameters
 					runViewer = true;
 				}
 				else
+				if (sscanf(argv[i],"workers=%u",&numWorkers)==1)
+				{
+				}
+				else
+				if (!strcmp(argv[i],"incremental"))
+				{
+					incremental = true;
+				}
+				else
+				if (!strncmp(argv[i],"stats=",6))
+				{
+					statsFilename = argv[i]+6;
+				}
+				else
 				if (!strncmp(argv[i],"outputpath=",11))
 				{
 					layerParameters.suggestedPath = argv[i]+11;
@@ -365,9 +425,11 @@ struct Parameters
 	}
 
 	// save layers of 1 object, returns number of successfully saved layers
-	unsigned layersSave(const rr::RRObjectIllumination* illumination) const
+	// (dependencies are saved only if all layers were saved, call recommendLayerParameters() first)
+	unsigned layersSave(const rr::RRObjectIllumination* illumination, const rr::RRHash* dependencies = nullptr) const
 	{
 		unsigned saved = 0;
+		unsigned failed = 0;
 		for (unsigned layerIndex = LAYER_LIGHTMAP; layerIndex<LAYER_LAST; layerIndex++)
 		{
 			rr::RRBuffer* buffer = illumination->getLayer(layerIndex);
@@ -380,12 +442,53 @@ struct Parameters
 					rr::RRReporter::report(rr::INF3,"Saved %ls\n",buffer->filename.w_str());
 				}
 				else
+				{
+					failed++;
 					rr::RRReporter::report(rr::WARN,"Failed to saved %ls\n",buffer->filename.w_str());
+				}
 			}
 		}
+		if (dependencies && saved && !failed)
+			dependenciesSave(*dependencies);
 		return saved;
 	}
 
+	// dependencies of 1 object are stored next to its maps, in actualFilename.hash
+	// (call recommendLayerParameters() first)
+	bool dependenciesMatch(const rr::RRHash& dependencies) const
+	{
+		std::ifstream f(std::filesystem::path(RR_RR2PATH(rr::RRString(0,L"%s.hash",layerParameters.actualFilename.w_str()))));
+		std::string stored;
+		return f && std::getline(f,stored) && stored==RR_RR2STD(dependencies.getFileName(0,"",nullptr));
+	}
+
+	void dependenciesSave(const rr::RRHash& dependencies) const
+	{
+		std::ofstream f(std::filesystem::path(RR_RR2PATH(rr::RRString(0,L"%s.hash",layerParameters.actualFilename.w_str()))));
+		f << RR_RR2STD(dependencies.getFileName(0,"",nullptr)) << "\n";
+		if (!f)
+			rr::RRReporter::report(rr::WARN,"Failed to save %ls.hash\n",layerParameters.actualFilename.w_str());
+	}
+
+	// load previously saved layers of 1 object, returns number of successfully loaded layers
+	unsigned layersLoad(rr::RRObjectIllumination* illumination) const
+	{
+		layersCreate(illumination);
+		unsigned loaded = 0;
+		for (unsigned layerIndex = LAYER_LIGHTMAP; layerIndex<LAYER_LAST; layerIndex++)
+		{
+			rr::RRBuffer*& buffer = illumination->getLayer(layerIndex);
+			if (buffer)
+			{
+				if (buffer->reload(buffer->filename,nullptr,nullptr))
+					loaded++;
+				else
+					RR_SAFE_DELETE(buffer);
+			}
+		}
+		return loaded;
+	}
+
 	void layersDelete(rr::RRObjectIllumination* illumination) const
 	{
 		for (unsigned layerIndex = LAYER_LIGHTMAP; layerIndex<LAYER_LAST; layerIndex++)
@@ -394,6 +497,267 @@ struct Parameters
 };
 
 
+/////////////////////////////////////////////////////////////////////////////
+//
+// local bake farm
+//
+// Coordinator (this process) loads scene, builds colliders and calculates first gather,
+// then forks N workers. Workers inherit scene, colliders and solution copy-on-write,
+// so they share them read-only without loading or calculating anything again.
+// Coordinator hands out objects one at a time, workers bake and postprocess them
+// and stream finished layers back over unix socket, coordinator saves them.
+// Messages are plain structs over stream socket, the same protocol works over TCP.
+//
+// libgomp does not survive fork() of process that already used its thread pool,
+// so each worker runs single-threaded and is pinned to its own CPU.
+// Use workers=<number of cores>.
+
+#ifndef _WIN32
+
+enum
+{
+	FARM_QUIT = UINT_MAX,        // coordinator->worker: no more objects
+	FARM_OBJECT_DONE = UINT_MAX, // worker->coordinator in layerIndex: all layers of object were sent
+};
+
+// worker->coordinator message, followed by bytes of buffer data
+struct FarmLayerHeader
+{
+	unsigned objectIndex;
+	unsigned layerIndex;
+	unsigned type;
+	unsigned width;
+	unsigned height;
+	unsigned depth;
+	unsigned format;
+	unsigned scaled;
+	unsigned long long bytes;
+};
+
+// MSG_NOSIGNAL: dead peer makes send() fail with EPIPE instead of killing us with SIGPIPE
+static bool farmWrite(int fd, const void* data, size_t size)
+{
+	const char* ptr = (const char*)data;
+	while (size)
+	{
+		ssize_t written = send(fd,ptr,size,MSG_NOSIGNAL);
+		if (written<0 && errno==EINTR) continue;
+		if (written<=0) return false;
+		ptr += written;
+		size -= written;
+	}
+	return true;
+}
+
+static bool farmRead(int fd, void* data, size_t size)
+{
+	char* ptr = (char*)data;
+	while (size)
+	{
+		ssize_t read_ = read(fd,ptr,size);
+		if (read_<0 && errno==EINTR) continue;
+		if (read_<=0) return false;
+		ptr += read_;
+		size -= read_;
+	}
+	return true;
+}
+
+// runs in forked process, never returns
+static void farmWorker(int fd, unsigned workerIndex, rr::RRSolver* solver, const rr::RRObjects& objects, const rr::RRSolver::UpdateParameters& updateParameters, bool buildOcclusion, int argc, char** argv)
+{
+#ifdef _OPENMP
+	omp_set_num_threads(1);
+#endif
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(workerIndex%RR_MAX(1,sysconf(_SC_NPROCESSORS_ONLN)),&cpus);
+	sched_setaffinity(0,sizeof(cpus),&cpus);
+
+	unsigned objectIndex;
+	while (farmRead(fd,&objectIndex,sizeof(objectIndex)) && objectIndex!=FARM_QUIT && objectIndex<objects.size())
+	{
+		// bake and postprocess
+		Parameters objectParameters(argc,argv,objectIndex);
+		objects[objectIndex]->recommendLayerParameters(objectParameters.layerParameters);
+		rr::RRObjectIllumination& illumination = objects[objectIndex]->illumination;
+		objectParameters.layersCreate(&illumination);
+		rr::RRBuffer* directionalBuffers[3];
+		directionalBuffers[0] = illumination.getLayer(LAYER_DIRECTIONAL1);
+		directionalBuffers[1] = illumination.getLayer(LAYER_DIRECTIONAL2);
+		directionalBuffers[2] = illumination.getLayer(LAYER_DIRECTIONAL3);
+		solver->updateLightmap(objectIndex,illumination.getLayer(buildOcclusion ? LAYER_OCCLUSION : LAYER_LIGHTMAP),directionalBuffers,illumination.getLayer(LAYER_BENT_NORMALS),&updateParameters,nullptr);
+		objectParameters.layersPostprocess(objects[objectIndex],solver->aborting);
+
+		// stream layers back
+		bool ok = true;
+		for (unsigned layerIndex = LAYER_LIGHTMAP; layerIndex<LAYER_LAST && ok; layerIndex++)
+		{
+			rr::RRBuffer* buffer = illumination.getLayer(layerIndex);
+			const unsigned char* data = buffer ? buffer->lock(rr::BL_READ) : nullptr;
+			if (data)
+			{
+				FarmLayerHeader header = {objectIndex,layerIndex,(unsigned)buffer->getType(),buffer->getWidth(),buffer->getHeight(),buffer->getDepth(),(unsigned)buffer->getFormat(),buffer->getScaled()?1u:0u,buffer->getBufferBytes()};
+				ok = farmWrite(fd,&header,sizeof(header)) && farmWrite(fd,data,header.bytes);
+				buffer->unlock();
+			}
+		}
+		objectParameters.layersDelete(&illumination);
+		FarmLayerHeader done = {objectIndex,FARM_OBJECT_DONE,0,0,0,0,0,0,0};
+		if (!ok || !farmWrite(fd,&done,sizeof(done)))
+			break;
+	}
+	close(fd);
+	fflush(stdout);
+	_exit(0);
+}
+
+// bakes pixel buffers of given objects in numWorkers processes, returns number of saved files
+// objects not baked because of worker failure are returned in failedObjects
+static unsigned farmCoordinator(unsigned numWorkers, rr::RRSolver* solver, const rr::RRObjects& objects, const rr::RRSolver::UpdateParameters& updateParameters, const Parameters& globalParameters, const std::vector<rr::RRHash>& dependencies, std::deque<unsigned>& objectsToBake, std::vector<unsigned>& failedObjects, int argc, char** argv)
+{
+	struct Worker
+	{
+		pid_t pid;
+		int fd;
+		unsigned objectIndex; // object being baked, FARM_QUIT if idle
+	};
+	std::vector<Worker> workers;
+
+	rr::RRReportInterval report(rr::INF1,"Baking %d objects in %d worker processes...\n",(int)objectsToBake.size(),numWorkers);
+	fflush(stdout); // don't let children inherit buffered output
+	for (unsigned i=0;i<numWorkers;i++)
+	{
+		int fds[2];
+		if (socketpair(AF_UNIX,SOCK_STREAM,0,fds))
+			break;
+		pid_t pid = fork();
+		if (!pid)
+		{
+			// close sockets of previously forked workers, so that coordinator detects their death
+			for (unsigned j=0;j<workers.size();j++)
+				close(workers[j].fd);
+			close(fds[0]);
+			farmWorker(fds[1],i,solver,objects,updateParameters,globalParameters.buildOcclusion,argc,argv);
+		}
+		close(fds[1]);
+		if (pid<0)
+		{
+			close(fds[0]);
+			break;
+		}
+		Worker worker = {pid,fds[0],FARM_QUIT};
+		workers.push_back(worker);
+	}
+	if (workers.empty())
+	{
+		rr::RRReporter::report(rr::WARN,"Failed to start workers, baking in single process.\n");
+		failedObjects.insert(failedObjects.end(),objectsToBake.begin(),objectsToBake.end());
+		objectsToBake.clear();
+		return 0;
+	}
+
+	// hands out next object to idle worker, or tells it to quit
+	auto assign = [&](Worker& worker)
+	{
+		worker.objectIndex = FARM_QUIT;
+		if (!objectsToBake.empty() && !solver->aborting)
+		{
+			worker.objectIndex = objectsToBake.front();
+			objectsToBake.pop_front();
+		}
+		if (!farmWrite(worker.fd,&worker.objectIndex,sizeof(worker.objectIndex)) && worker.objectIndex!=FARM_QUIT)
+		{
+			// worker is dead, object will be baked locally
+			failedObjects.push_back(worker.objectIndex);
+			worker.objectIndex = FARM_QUIT;
+		}
+	};
+	for (unsigned i=0;i<workers.size();i++)
+		assign(workers[i]);
+
+	unsigned saved = 0;
+	std::vector<pollfd> pollfds;
+	for (;;)
+	{
+		pollfds.clear();
+		for (unsigned i=0;i<workers.size();i++)
+		if (workers[i].objectIndex!=FARM_QUIT)
+		{
+			pollfd p = {workers[i].fd,POLLIN,0};
+			pollfds.push_back(p);
+		}
+		if (pollfds.empty())
+			break;
+		if (poll(pollfds.data(),pollfds.size(),-1)<0)
+		{
+			if (errno==EINTR) continue;
+			break;
+		}
+		for (unsigned p=0;p<pollfds.size();p++)
+		if (pollfds[p].revents)
+		{
+			Worker* worker = nullptr;
+			for (unsigned i=0;i<workers.size();i++)
+				if (workers[i].fd==pollfds[p].fd)
+					worker = &workers[i];
+
+			FarmLayerHeader header;
+			bool ok = farmRead(worker->fd,&header,sizeof(header)) && header.objectIndex==worker->objectIndex;
+			if (ok && header.layerIndex==FARM_OBJECT_DONE)
+			{
+				// all layers received, save them
+				Parameters objectParameters(argc,argv,worker->objectIndex);
+				objects[worker->objectIndex]->recommendLayerParameters(objectParameters.layerParameters);
+				saved += objectParameters.layersSave(&objects[worker->objectIndex]->illumination,dependencies.size()?&dependencies[worker->objectIndex]:nullptr);
+				if (!globalParameters.runViewer)
+					objectParameters.layersDelete(&objects[worker->objectIndex]->illumination);
+				assign(*worker);
+			}
+			else
+			if (ok && header.layerIndex<LAYER_LAST)
+			{
+				// receive layer into buffer created with the same parameters as in worker
+				rr::RRObjectIllumination& illumination = objects[worker->objectIndex]->illumination;
+				if (!illumination.getLayer(header.layerIndex))
+				{
+					Parameters objectParameters(argc,argv,worker->objectIndex);
+					objects[worker->objectIndex]->recommendLayerParameters(objectParameters.layerParameters);
+					objectParameters.layersCreate(&illumination);
+				}
+				rr::RRBuffer* buffer = illumination.getLayer(header.layerIndex);
+				std::vector<unsigned char> data(header.bytes);
+				ok = buffer && farmRead(worker->fd,data.data(),data.size())
+					&& buffer->reset((rr::RRBufferType)header.type,header.width,header.height,header.depth,(rr::RRBufferFormat)header.format,header.scaled!=0,data.data());
+			}
+			else
+				ok = false;
+			if (!ok)
+			{
+				// worker crashed or sent garbage, bake its object locally
+				rr::RRReporter::report(rr::WARN,"Worker %d failed while baking object %d.\n",(int)worker->pid,worker->objectIndex);
+				Parameters(argc,argv,worker->objectIndex).layersDelete(&objects[worker->objectIndex]->illumination);
+				failedObjects.push_back(worker->objectIndex);
+				worker->objectIndex = FARM_QUIT;
+				kill(worker->pid,SIGKILL);
+			}
+		}
+	}
+
+	// collect workers
+	for (unsigned i=0;i<workers.size();i++)
+	{
+		close(workers[i].fd);
+		waitpid(workers[i].pid,nullptr,0);
+	}
+	// objects left in queue (after abort) are not baked
+	objectsToBake.clear();
+	return saved;
+}
+
+#endif // !_WIN32
+
+
 /////////////////////////////////////////////////////////////////////////////
 //
 // main
@@ -452,6 +816,9 @@ int main(int argc, char** argv)
 			"Global arguments:\n"
 			"  scene                   (filename of scene in supported format)\n"
 			"  quality=100             (10=low, 100=medium, 1000=high)\n"
+			"  lightsamples=0          (shadow rays per round to many point/spot lights, 0=all)\n"
+			"  lightcutoff=0           (point/spot lights weaker than this don't reach receiver, 0=exact)\n"
+			"  seed=0                  (nonzero makes bakes of direct light reproducible)\n"
 			"  occlusion               (build ambient occlusion instead of lightmaps)\n"
 			"  skycolor=0.0;0.0;0.0    (color of both sky hemispheres)\n"
 			"  skyupper=0.0;0.0;0.0    (color of upper sky hemisphere)\n"
@@ -460,6 +827,11 @@ int main(int argc, char** argv)
 			"  directmultiplier=1.0    (multiplies direct effect of point/spot/dir)\n"
 			"  indirectmultiplier=1.0  (multiplies indirect effect of point/spot/dir)\n"
 			"  emissivemultiplier=1.0  (multiplies effect of emissive materials)\n"
+#ifndef _WIN32
+			"  workers=0               (bake maps in N local worker processes)\n"
+#endif
+			"  incremental             (rebake only maps affected by changes)\n"
+			"  stats=profile.json      (save time and counters of bake stages, .json or .csv)\n"
 #ifdef SCENE_VIEWER
 			"  viewer                  (run scene viewer after build)\n"
 #endif
@@ -545,6 +917,51 @@ int main(int argc, char** argv)
 	//
 	if (globalParameters.buildQuality)
 	{
+		if (globalParameters.statsFilename)
+		{
+			rr::RRProfiler::reset();
+			rr::RRProfiler::setEnabled(true);
+		}
+
+		// find objects whose maps are up to date, their inputs did not change since previous incremental build
+		std::vector<rr::RRHash> dependencies;
+		std::vector<bool> upToDate(scene.objects.size(),false);
+		unsigned numUpToDate = 0;
+		if (globalParameters.incremental)
+		{
+			rr::RRSolver::UpdateParameters dependencyParameters(globalParameters.buildQuality);
+			dependencyParameters.aoIntensity = globalParameters.aoIntensity;
+			dependencyParameters.aoSize = globalParameters.aoSize;
+			dependencyParameters.lightSamples = globalParameters.lightSamples;
+			dependencyParameters.lightCutoffIrradiance = globalParameters.lightCutoffIrradiance;
+			dependencyParameters.randomSeed = globalParameters.randomSeed;
+			dependencies.resize(scene.objects.size());
+			solver->getLightmapDependencies(&dependencyParameters,dependencies.data());
+
+			// commandline (multipliers, map sizes, postprocess) affects maps too, except for arguments that don't change results
+			std::string args;
+			for (int i=1;i<argc;i++)
+				if (strncmp(argv[i],"workers=",8) && strcmp(argv[i],"incremental") && strcmp(argv[i],"viewer") && strncmp(argv[i],"stats=",6))
+					args += std::string(argv[i]) + "\n";
+			rr::RRHash argsHash((const unsigned char*)args.c_str(),(unsigned)args.size());
+
+			for (unsigned objectIndex=0;objectIndex<scene.objects.size();objectIndex++)
+			{
+				dependencies[objectIndex] += argsHash;
+				Parameters objectParameters(argc,argv,objectIndex);
+				scene.objects[objectIndex]->recommendLayerParameters(objectParameters.layerParameters);
+				if (objectParameters.dependenciesMatch(dependencies[objectIndex]))
+				{
+					upToDate[objectIndex] = true;
+					numUpToDate++;
+					if (globalParameters.runViewer)
+						objectParameters.layersLoad(&scene.objects[objectIndex]->illumination);
+				}
+			}
+			rr::RRReporter::report(rr::INF1,"%d of %d objects are up to date.\n",numUpToDate,(int)scene.objects.size());
+		}
+		bool needsBake = numUpToDate<scene.objects.size();
+
 		// apply indirect light multiplier
 		std::vector<rr::RRVec3> lightColors;
 		for (unsigned i=0;i<solver->getLights().size();i++)
@@ -555,7 +972,11 @@ int main(int argc, char** argv)
 
 		// calculate indirect illumination in solver
 		rr::RRSolver::UpdateParameters updateParameters(globalParameters.buildQuality);
-		solver->updateLightmaps(-1,-1,-1,&updateParameters,nullptr);
+		updateParameters.lightSamples = globalParameters.lightSamples;
+		updateParameters.lightCutoffIrradiance = globalParameters.lightCutoffIrradiance;
+		updateParameters.randomSeed = globalParameters.randomSeed;
+		if (needsBake)
+			solver->updateLightmaps(-1,-1,-1,&updateParameters,nullptr);
 		updateParameters.useCurrentSolution = true;
 		updateParameters.aoIntensity = globalParameters.aoIntensity;
 		updateParameters.aoSize = globalParameters.aoSize;
@@ -573,7 +994,7 @@ int main(int argc, char** argv)
 
 		// build and save vertex buffers (all at once, it's faster)
 		unsigned saved = 0;
-		if (!solver->aborting)
+		if (needsBake && !solver->aborting)
 		{
 			// allocate layers (decide resolution, format)
 			for (unsigned objectIndex=0;objectIndex<scene.objects.size();objectIndex++)
@@ -583,7 +1004,7 @@ int main(int argc, char** argv)
 				// query size, format etc
 				scene.objects[objectIndex]->recommendLayerParameters(objectParameters.layerParameters);
 				// allocate
-				if (objectParameters.layerParameters.actualType==rr::BT_VERTEX_BUFFER)
+				if (objectParameters.layerParameters.actualType==rr::BT_VERTEX_BUFFER && !upToDate[objectIndex])
 					objectParameters.layersCreate(&scene.objects[objectIndex]->illumination);
 			}
 
@@ -596,7 +1017,7 @@ int main(int argc, char** argv)
 				nullptr);
 
 			for (unsigned objectIndex=0;objectIndex<scene.objects.size();objectIndex++)
-			if (!solver->aborting)
+			if (!upToDate[objectIndex] && !solver->aborting)
 			{
 				// take per-object parameters
 				Parameters objectParameters(argc,argv,objectIndex);
@@ -605,41 +1026,60 @@ int main(int argc, char** argv)
 				// postprocess
 				objectParameters.layersPostprocess(scene.objects[objectIndex],solver->aborting);
 				// save
-				saved += objectParameters.layersSave(&scene.objects[objectIndex]->illumination);
+				saved += objectParameters.layersSave(&scene.objects[objectIndex]->illumination,dependencies.size()?&dependencies[objectIndex]:nullptr);
 				// free
 				if (!globalParameters.runViewer)
 					objectParameters.layersDelete(&scene.objects[objectIndex]->illumination);
 			}
 		}
 
-		// build and save pixel buffers (one by one, to limit peak memory use)
+		// select objects with pixel buffers
+		std::vector<unsigned> pixelObjects;
 		for (unsigned objectIndex=0;objectIndex<scene.objects.size();objectIndex++)
+		{
+			Parameters objectParameters(argc,argv,objectIndex);
+			scene.objects[objectIndex]->recommendLayerParameters(objectParameters.layerParameters);
+			if (objectParameters.layerParameters.actualType!=rr::BT_VERTEX_BUFFER && !upToDate[objectIndex])
+				pixelObjects.push_back(objectIndex);
+		}
+
+#ifndef _WIN32
+		// build and save pixel buffers in worker processes
+		// (objects that workers fail to bake are returned back to pixelObjects)
+		if (globalParameters.numWorkers>1 && pixelObjects.size()>1 && !solver->aborting)
+		{
+			std::deque<unsigned> objectsToBake(pixelObjects.begin(),pixelObjects.end());
+			pixelObjects.clear();
+			saved += farmCoordinator(globalParameters.numWorkers,solver,scene.objects,updateParameters,globalParameters,dependencies,objectsToBake,pixelObjects,argc,argv);
+		}
+#endif
+
+		// build and save pixel buffers (one by one, to limit peak memory use)
+		for (unsigned i=0;i<pixelObjects.size();i++)
 		if (!solver->aborting)
 		{
+			unsigned objectIndex = pixelObjects[i];
 			// allocate layers (decide resolution, format)
 			// take per-object parameters
 			Parameters objectParameters(argc,argv,objectIndex);
 			// query size, format etc
 			scene.objects[objectIndex]->recommendLayerParameters(objectParameters.layerParameters);
-			if (objectParameters.layerParameters.actualType!=rr::BT_VERTEX_BUFFER)
-			{
-				rr::RRObjectIllumination& illumination = scene.objects[objectIndex]->illumination;
-				// allocate
-				objectParameters.layersCreate(&illumination);
-				rr::RRBuffer* directionalBuffers[3];
-				directionalBuffers[0] = illumination.getLayer(LAYER_DIRECTIONAL1);
-				directionalBuffers[1] = illumination.getLayer(LAYER_DIRECTIONAL2);
-				directionalBuffers[2] = illumination.getLayer(LAYER_DIRECTIONAL3);
-				// build direct illumination
-				solver->updateLightmap(objectIndex,illumination.getLayer(globalParameters.buildOcclusion ? LAYER_OCCLUSION : LAYER_LIGHTMAP),directionalBuffers,illumination.getLayer(LAYER_BENT_NORMALS),&updateParameters,nullptr);
-				// postprocess
-				objectParameters.layersPostprocess(scene.objects[objectIndex],solver->aborting);
-				// save
-				saved += objectParameters.layersSave(&scene.objects[objectIndex]->illumination);
-				// free
-				if (!globalParameters.runViewer)
-					objectParameters.layersDelete(&scene.objects[objectIndex]->illumination);
-			}
+			rr::RRObjectIllumination& illumination = scene.objects[objectIndex]->illumination;
+			// allocate
+			objectParameters.layersCreate(&illumination);
+			rr::RRBuffer* directionalBuffers[3];
+			directionalBuffers[0] = illumination.getLayer(LAYER_DIRECTIONAL1);
+			directionalBuffers[1] = illumination.getLayer(LAYER_DIRECTIONAL2);
+			directionalBuffers[2] = illumination.getLayer(LAYER_DIRECTIONAL3);
+			// build direct illumination
+			solver->updateLightmap(objectIndex,illumination.getLayer(globalParameters.buildOcclusion ? LAYER_OCCLUSION : LAYER_LIGHTMAP),directionalBuffers,illumination.getLayer(LAYER_BENT_NORMALS),&updateParameters,nullptr);
+			// postprocess
+			objectParameters.layersPostprocess(scene.objects[objectIndex],solver->aborting);
+			// save
+			saved += objectParameters.layersSave(&scene.objects[objectIndex]->illumination,dependencies.size()?&dependencies[objectIndex]:nullptr);
+			// free
+			if (!globalParameters.runViewer)
+				objectParameters.layersDelete(&scene.objects[objectIndex]->illumination);
 		}
 
 #ifdef _WIN32
@@ -654,8 +1094,15 @@ int main(int argc, char** argv)
 		}
 
 		rr::RRReporter::report(rr::INF2,"Saved %d files.\n",saved);
+		// with workers, stats cover only coordinator process
+		if (globalParameters.statsFilename)
+		{
+			rr::RRProfiler::setEnabled(false);
+			if (!rr::RRProfiler::save(globalParameters.statsFilename))
+				rr::RRReporter::report(rr::WARN,"Failed to save %s.\n",globalParameters.statsFilename);
+		}
 		// saving 0 files is strange, force user to read log and quit
-		if (!saved)
+		if (!saved && needsBake)
 			error(solver->aborting,nullptr);
 	}
 
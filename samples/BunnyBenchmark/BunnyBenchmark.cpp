@@ -3,23 +3,448 @@
 //
 // Stanford Bunny model with 69451 triangles is loaded from disk,
 // intersections with random rays are detected, speed is measured.
+//
+// Optional benchmarks of other parts of Lightsprint SDK on the same mesh:
+//  BunnyBenchmark facegroups  ... triangle->material lookup vs number of facegroups
+//  BunnyBenchmark mipmaps     ... lightmap gather time and noise with/without texture mipmaps
+//  BunnyBenchmark unwrap      ... RRObjects::buildUnwrap() time and quality (stretch, utilization, overlaps)
+//  BunnyBenchmark profiler    ... RRProfiler overhead on rays and lightmap bake, attribution of rays to stages
+//  BunnyBenchmark direct      ... detectDirectIlluminationCPU() vs brute force reference, time of full and partial update
+//  BunnyBenchmark colorspace  ... accuracy of array color conversions over all positive floats, conversions per second
+//  BunnyBenchmark culling     ... RRObjectBVH culling of synthetic city vs rays and vs no hierarchy, update after objects change
+//  BunnyBenchmark reporter    ... RRReporter stress test with 64 threads and reporters created meanwhile, cost per message
+//  BunnyBenchmark arena       ... heap allocations and time of lightmap bake at two resolutions, RRArena vs malloc
+//  BunnyBenchmark layers      ... RRObjects::saveLayer()/loadLayer() of 400 objects, parallel vs serial results and time
+//  BunnyBenchmark cubes       ... 300 environment maps updated from 1 to 64 threads at once vs serial update, scaling
+//  BunnyBenchmark area        ... area lights vs analytic irradiance, disk light vs N point lights bake time and error
+//  BunnyBenchmark lighttree   ... light tree bake converges to exhaustive bake, time to equal error vs number of lights
+//  BunnyBenchmark lightculling ... bakes with hundreds of local lights culled vs unculled, results and time
+//  BunnyBenchmark irradiance  ... RRLight batch irradiance evaluation equals per receiver evaluation, speed of both
+//  BunnyBenchmark ggx         ... GGX material furnace, chi-square and variance tests of sampling, sampling time
+//  BunnyBenchmark camerarays  ... RRCamera::getRays() equals getRay() in all projections, rays per second, setRangeDynamically() time
+//  BunnyBenchmark vertexbuffers ... realtime vertex buffers of many objects updated at once equal one by one update and reference, time
+//  BunnyBenchmark environment ... cached environment blend vs direct evaluation, color space change, sky lit bake time
+//
+// Optional benchmarks report failed checks as errors, exit code is number of errors.
 // --------------------------------------------------------------------------
 
+#include "BunnyBenchmark.h"
 #include "plymeshreader.h"
 #include "sphereunitvecpool.h"
-#include "Lightsprint/RRCollider.h"
 #include <math.h>
 #ifdef _OPENMP
 	#include <omp.h>
 #endif
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Splits triangles into random facegroups (some empty), compares RRObject::getTriangleMaterial() with linear walk
+// and measures lookups per second of both.
+static void benchmarkFaceGroups(const RRCollider* collider)
+{
+	RRReporter::report(INF1,"Triangle->material lookup (random triangles, lookups per second):\n");
+	unsigned numTriangles = collider->getMesh()->getNumTriangles();
+	std::vector<RRMaterial> materials(4096);
+	std::vector<unsigned> randomTriangles(1000000);
+	srand(1);
+	for (unsigned i=0;i<randomTriangles.size();i++)
+		randomTriangles[i] = (unsigned)(((unsigned long long)rand()*(RAND_MAX+1ull)+rand())%numTriangles);
+	for (unsigned numFaceGroups=1;numFaceGroups<=materials.size();numFaceGroups*=4)
+	{
+		RRObject object;
+		object.setCollider(const_cast<RRCollider*>(collider));
+		std::vector<unsigned> splits(numFaceGroups-1);
+		for (unsigned g=0;g+1<numFaceGroups;g++)
+			splits[g] = rand()%(numTriangles+1);
+		std::sort(splits.begin(),splits.end());
+		for (unsigned g=0,first=0;g<numFaceGroups;g++)
+		{
+			unsigned last = (g+1<numFaceGroups) ? splits[g] : numTriangles;
+			object.faceGroups.push_back(RRObject::FaceGroup(&materials[g],last-first));
+			first = last;
+		}
+		object.faceGroupsVersion++;
+
+		// linear walk, reference
+		std::vector<const RRMaterial*> reference(numTriangles);
+		RRTime time;
+		for (unsigned i=0;i<randomTriangles.size();i++)
+		{
+			unsigned t = randomTriangles[i];
+			for (unsigned g=0;g<numFaceGroups;g++)
+			{
+				if (t<object.faceGroups[g].numTriangles)
+				{
+					reference[randomTriangles[i]] = object.faceGroups[g].material;
+					break;
+				}
+				t -= object.faceGroups[g].numTriangles;
+			}
+		}
+		double linearSeconds = time.secondsPassed();
+
+		// getTriangleMaterial()
+		unsigned mismatches = 0;
+		time.setNow();
+		for (unsigned i=0;i<randomTriangles.size();i++)
+			if (object.getTriangleMaterial(randomTriangles[i],nullptr,nullptr)!=reference[randomTriangles[i]])
+				mismatches++;
+		double indexSeconds = time.secondsPassed();
 
-using namespace rr;
+		RRReporter::report(mismatches?ERRO:INF1,"  facegroups=%4d  linear walk %10.0f  getTriangleMaterial %10.0f  mismatches=%d\n",
+			numFaceGroups,randomTriangles.size()/linearSeconds,randomTriangles.size()/indexSeconds,mismatches);
+	}
+}
+
+// Bakes lightmap of room with finely textured walls and bunny inside, compares time and noise
+// of gathering with texture mipmaps (UpdateParameters::useTextureMipmaps) and without them.
+// Noise is measured as difference of two bakes with different random seeds.
+static void benchmarkMipmaps(RRMesh* bunnyMesh, const RRCollider* bunnyCollider)
+{
+	enum {LIGHTMAP_SIZE=256, QUALITY=100};
+	RRReporter::report(INF1,"Lightmap bake of textured room (quality %d, %dx%d lightmap):\n",QUALITY,LIGHTMAP_SIZE,LIGHTMAP_SIZE);
+
+	RoomScene scene(bunnyMesh,bunnyCollider);
+
+	RRBuffer* lightmaps[2][2]; // [mipmaps][seed]
+	for (unsigned mipmaps=0;mipmaps<2;mipmaps++)
+	{
+		double seconds = 0;
+		for (unsigned seed=0;seed<2;seed++)
+		{
+			scene.room->illumination.getLayer(0) = lightmaps[mipmaps][seed] = RRBuffer::create(BT_2D_TEXTURE,LIGHTMAP_SIZE,LIGHTMAP_SIZE,1,BF_RGBF,false,nullptr);
+			RRSolver::UpdateParameters params(QUALITY);
+			params.useTextureMipmaps = mipmaps!=0;
+			params.randomSeed = seed+1;
+			RRTime time;
+			RRReporter::setFilter(true,0,false);
+			scene.solver->updateLightmaps(0,-1,-1,&params,nullptr);
+			RRReporter::setFilter(true,1,false);
+			seconds += time.secondsPassed();
+			scene.room->illumination.getLayer(0) = nullptr;
+		}
+		double sum = 0, sumOfSquaredDifferences = 0;
+		for (unsigned i=0;i<LIGHTMAP_SIZE*LIGHTMAP_SIZE;i++)
+		{
+			RRVec3 a = lightmaps[mipmaps][0]->getElement(i,nullptr);
+			RRVec3 b = lightmaps[mipmaps][1]->getElement(i,nullptr);
+			sum += a.avg()+b.avg();
+			sumOfSquaredDifferences += (a-b).avg()*(a-b).avg();
+		}
+		RRReporter::report(INF1,"  mipmaps %-3s  %6.2fs per bake  noise %.2f%%\n",mipmaps?"on":"off",seconds/2,
+			100*sqrt(sumOfSquaredDifferences/2/(LIGHTMAP_SIZE*LIGHTMAP_SIZE))/(sum/(2*LIGHTMAP_SIZE*LIGHTMAP_SIZE)));
+	}
+
+	// cleanup
+	for (unsigned i=0;i<4;i++)
+		delete lightmaps[i/2][i%2];
+}
+
+// Ramp winding 3 times around vertical axis, normals of all triangles fit in narrow cone, but planar projection overlaps.
+static RRMeshArrays* createHelix(unsigned segments, unsigned width)
+{
+	RRMeshArrays* mesh = new RRMeshArrays;
+	mesh->resizeMesh(2*segments*width,(segments+1)*(width+1),nullptr,false,false);
+	for (unsigned i=0;i<=segments;i++)
+		for (unsigned j=0;j<=width;j++)
+		{
+			float angle = 6*RR_PI*i/segments;
+			float radius = 0.1f+0.1f*j/width;
+			mesh->position[i*(width+1)+j] = RRVec3(radius*cosf(angle),0.03f*angle,radius*sinf(angle));
+			mesh->normal[i*(width+1)+j] = RRVec3(0,1,0);
+		}
+	for (unsigned i=0,t=0;i<segments;i++)
+		for (unsigned j=0;j<width;j++)
+		{
+			unsigned a = i*(width+1)+j, b = a+1, c = a+width+1, d = c+1;
+			mesh->triangle[t++] = RRMeshArrays::Triangle{a,b,c};
+			mesh->triangle[t++] = RRMeshArrays::Triangle{b,d,c};
+		}
+	return mesh;
+}
+
+// Reports quality of unwrap in mesh->unwrapChannel:
+// stretch = L2 stretch (Sander et al.) normalized by total area, 1 = no stretch,
+// utilization = fraction of map covered by triangles,
+// overlaps = texels covered by more than one triangle.
+static void reportUnwrapQuality(const char* name, const RRMeshArrays* mesh, double seconds)
+{
+	unsigned mapSize = mesh->unwrapWidth;
+	const RRVec2* uv = mesh->texcoord[mesh->unwrapChannel];
+	double areaUv = 0, sumStretch = 0;
+	unsigned flips = 0;
+	for (unsigned t=0;t<mesh->numTriangles;t++)
+	{
+		const RRMesh::Triangle& triangle = mesh->triangle[t];
+		RRVec3 side1 = mesh->position[triangle[1]]-mesh->position[triangle[0]];
+		RRVec3 side2 = mesh->position[triangle[2]]-mesh->position[triangle[0]];
+		RRVec2 uv1 = uv[triangle[1]]-uv[triangle[0]];
+		RRVec2 uv2 = uv[triangle[2]]-uv[triangle[0]];
+		areaUv += fabs(uv1.x*uv2.y-uv1.y*uv2.x)/2;
+		double area = side1.cross(side2).length()/2;
+		if (area<=1e-12)
+			continue;
+		if (uv1.x*uv2.y-uv1.y*uv2.x<=0)
+			flips++;
+		// triangle in its own plane: (0,0), (s1x,0), (s2x,s2y)
+		RRVec3 axisX = side1.normalized();
+		RRVec3 axisY = side1.cross(side2).normalized().cross(axisX);
+		double s1x = side1.length(), s2x = side2.dot(axisX), s2y = side2.dot(axisY);
+		double dUds = uv1.x/s1x, dVds = uv1.y/s1x;
+		double dUdt = (uv2.x-dUds*s2x)/s2y, dVdt = (uv2.y-dVds*s2x)/s2y;
+		sumStretch += (dUds*dUds+dVds*dVds+dUdt*dUdt+dVdt*dVdt)/2*area;
+	}
+	double stretch = sqrt(sumStretch/areaUv);
+
+	std::vector<unsigned char> covered(mapSize*mapSize,0);
+	unsigned coveredTexels = 0, overlappingTexels = 0;
+	for (unsigned t=0;t<mesh->numTriangles;t++)
+	{
+		RRVec2 q[3];
+		for (unsigned j=0;j<3;j++)
+			q[j] = uv[mesh->triangle[t][j]]*(RRReal)mapSize;
+		RRReal doubleArea = (q[1].x-q[0].x)*(q[2].y-q[0].y)-(q[1].y-q[0].y)*(q[2].x-q[0].x);
+		if (doubleArea==0)
+			continue;
+		int x0 = RR_MAX(0,(int)floorf(RR_MIN3(q[0].x,q[1].x,q[2].x))), x1 = RR_MIN((int)mapSize-1,(int)ceilf(RR_MAX3(q[0].x,q[1].x,q[2].x)));
+		int y0 = RR_MAX(0,(int)floorf(RR_MIN3(q[0].y,q[1].y,q[2].y))), y1 = RR_MIN((int)mapSize-1,(int)ceilf(RR_MAX3(q[0].y,q[1].y,q[2].y)));
+		for (int y=y0;y<=y1;y++)
+			for (int x=x0;x<=x1;x++)
+			{
+				bool inside = true;
+				for (unsigned j=0;j<3;j++)
+					if (((q[(j+1)%3].x-q[j].x)*(y+0.5f-q[j].y)-(q[(j+1)%3].y-q[j].y)*(x+0.5f-q[j].x))/doubleArea<=1e-4f)
+						inside = false;
+				if (inside)
+				{
+					if (covered[y*mapSize+x])
+						overlappingTexels++;
+					else
+						coveredTexels++;
+					covered[y*mapSize+x] = 1;
+				}
+			}
+	}
+	RRReporter::report(INF1,"  %-7s %6d tris  %6.3fs  map %4d  stretch %.3f  utilization %4.1f%%  flips %d  overlapping texels %d\n",
+		name,mesh->numTriangles,seconds,mapSize,stretch,100.*coveredTexels/(mapSize*mapSize),flips,overlappingTexels);
+}
+
+// Unwraps bunny and meshes that are known to be hard for unwrappers, measures time and quality.
+static void benchmarkUnwrap(RRMesh* bunnyMesh)
+{
+	RRReporter::report(INF1,"Unwrap into 512x512 map:\n");
+	const char* names[] = {"bunny","helix"};
+	RRMeshArrays* meshes[] = {bunnyMesh->createArrays(true,RRVector<unsigned>(),false),createHelix(400,8)};
+	RRMaterial material;
+	material.reset(false);
+	for (unsigned i=0;i<2;i++)
+	{
+		bool aborting = false;
+		RRObjects objects;
+		RRObject* object = new RRObject;
+		object->setCollider(RRCollider::create(meshes[i],nullptr,RRCollider::IT_LINEAR,aborting));
+		object->faceGroups.push_back(RRObject::FaceGroup(&material,meshes[i]->numTriangles));
+		objects.push_back(object);
+		for (unsigned fast=0;fast<2;fast++)
+		{
+			RRTime time;
+			RRReporter::setFilter(true,0,false);
+			unsigned channel = objects.buildUnwrap(512,fast,fast?0:100000,aborting);
+			RRReporter::setFilter(true,1,false);
+			double seconds = time.secondsPassed();
+			if (channel==UINT_MAX)
+				RRReporter::report(ERRO,"  %s unwrap failed\n",names[i]);
+			else
+				reportUnwrapQuality(fast?"(fast)":names[i],meshes[i],seconds);
+		}
+		delete object->getCollider();
+		delete object;
+		delete meshes[i];
+	}
+}
+
+// Saves profile and returns value of counter in each stage (stage path, value), stage "total" holds counts from outside of stages.
+static std::vector<std::pair<std::string,unsigned long long> > readProfileCounter(const char* counter)
+{
+	std::vector<std::pair<std::string,unsigned long long> > result;
+	const char* filename = "BunnyBenchmark.profile.csv";
+	if (!RRProfiler::save(filename))
+		return result;
+	FILE* f = fopen(filename,"rt");
+	char line[1000];
+	int counterColumn = -1;
+	while (f && fgets(line,sizeof(line),f))
+	{
+		int column = 0;
+		std::string stage;
+		for (char* field=strtok(line,",\n");field;field=strtok(nullptr,",\n"),column++)
+		{
+			if (!column)
+				stage = field;
+			else
+			if (counterColumn<0 && !strcmp(field,counter))
+				counterColumn = column;
+			else
+			if (column==counterColumn && stage!="stage")
+				result.push_back(std::make_pair(stage,strtoull(field,nullptr,10)));
+		}
+	}
+	if (f)
+		fclose(f);
+	remove(filename);
+	return result;
+}
+
+// Measures RRProfiler overhead and checks that rays cast by OpenMP workers are counted in stage of thread that started them.
+// Overhead of bake is estimated from cost of single count (measured in tight loop) and number of counts in bake,
+// measuring it directly would need many bakes to get below noise.
+static void benchmarkProfiler(RRMesh* bunnyMesh, const RRCollider* bunnyCollider, SphereUnitVecPool& vecpool)
+{
+	RRReporter::report(INF1,"Profiler overhead:\n");
+
+	// cost of single count
+	enum {NUM_COUNTS=50000000};
+	double countSeconds[2];
+	for (unsigned enabled=0;enabled<2;enabled++)
+	{
+		RRProfiler::setEnabled(enabled!=0);
+		RR_PROFILE_SCOPE("counting");
+		RRTime time;
+		for (unsigned i=0;i<NUM_COUNTS;i++)
+			RR_PROFILE_COUNT("counts",1);
+		countSeconds[enabled] = time.secondsPassed();
+	}
+	double countNanoseconds = RR_MAX(0,countSeconds[1]-countSeconds[0])*1e9/NUM_COUNTS;
+	RRReporter::report(INF1,"  count: disabled %.2fns, enabled %.2fns\n",countSeconds[0]*1e9/NUM_COUNTS,countSeconds[1]*1e9/NUM_COUNTS);
+
+	// bare rays, the cheapest work that counts (one count per ray), alternate disabled/enabled runs, compare the fastest of each
+	enum {NUM_RAYS=2000000, NUM_REPEATS=5};
+	static const RRVec3 AABB_CENTER(-0.016840f,0.110154f,-0.001537f);
+	static const float RADIUS = 0.2f;
+	std::vector<RRVec3> origins, dirs;
+	while (origins.size()<NUM_RAYS)
+	{
+		PoolVec3 rayorigin = vecpool.getVec();
+		PoolVec3 rayend = vecpool.getVec();
+		RRVec3 dir(rayend.x-rayorigin.x,rayend.y-rayorigin.y,rayend.z-rayorigin.z);
+		if (dir.length()==0) continue;
+		origins.push_back(RRVec3(rayorigin.x,rayorigin.y,rayorigin.z)*RADIUS+AABB_CENTER);
+		dirs.push_back(dir);
+	}
+	auto castRays = [&]()
+	{
+		RRTime time;
+		unsigned profilerStage = RRProfiler::getStage();
+		#pragma omp parallel
+		{
+			RR_PROFILE_PARENT(profilerStage);
+			RRRay ray;
+			ray.rayFlags = RRRay::FILL_TRIANGLE | RRRay::FILL_DISTANCE;
+			ray.rayLengthMin = 0;
+			#pragma omp for schedule(static)
+			for (int i=0;i<NUM_RAYS;i++)
+			{
+				ray.rayOrigin = origins[i];
+				ray.rayDir = dirs[i].normalized();
+				ray.rayLengthMax = dirs[i].length();
+				bunnyCollider->intersect(ray);
+			}
+		}
+		return time.secondsPassed();
+	};
+	RRProfiler::reset();
+	double raySeconds[2] = {1e10,1e10};
+	for (unsigned r=0;r<NUM_REPEATS;r++)
+		for (unsigned enabled=0;enabled<2;enabled++)
+		{
+			RRProfiler::setEnabled(enabled!=0);
+			RR_PROFILE_SCOPE("rays");
+			double seconds = castRays();
+			raySeconds[enabled] = RR_MIN(raySeconds[enabled],seconds);
+		}
+	RRProfiler::setEnabled(false);
+	unsigned long long raysInStage = 0;
+	std::vector<std::pair<std::string,unsigned long long> > rays = readProfileCounter("rays");
+	for (size_t i=0;i<rays.size();i++)
+		if (rays[i].first=="rays")
+			raysInStage += rays[i].second;
+	RRReporter::report(INF1,"  bare rays: estimated %.2f%%, measured %.2f%% (%.0fns per ray)\n",
+		100*countNanoseconds*NUM_RAYS/(raySeconds[0]*1e9),100*(raySeconds[1]-raySeconds[0])/raySeconds[0],raySeconds[0]*1e9/NUM_RAYS);
+	RRReporter::report((raysInStage==(unsigned long long)NUM_RAYS*NUM_REPEATS)?INF1:ERRO,"  rays from workers counted in stage: %llu/%llu\n",
+		raysInStage,(unsigned long long)NUM_RAYS*NUM_REPEATS);
+
+	// lightmap bake
+	{
+		enum {LIGHTMAP_SIZE=128, QUALITY=100};
+		RoomScene scene(bunnyMesh,bunnyCollider);
+		scene.room->illumination.getLayer(0) = RRBuffer::create(BT_2D_TEXTURE,LIGHTMAP_SIZE,LIGHTMAP_SIZE,1,BF_RGBF,false,nullptr);
+		RRSolver::UpdateParameters params(QUALITY);
+		RRProfiler::reset();
+		RRProfiler::setEnabled(true);
+		RRTime time;
+		RRReporter::setFilter(true,0,false);
+		scene.solver->updateLightmaps(0,-1,-1,&params,nullptr);
+		RRReporter::setFilter(true,1,false);
+		double seconds = time.secondsPassed();
+		RRProfiler::setEnabled(false);
+		unsigned long long raysTotal = 0, raysOutside = 0;
+		rays = readProfileCounter("rays");
+		for (size_t i=0;i<rays.size();i++)
+		{
+			raysTotal += rays[i].second;
+			if (rays[i].first=="total")
+				raysOutside += rays[i].second;
+		}
+		double overhead = 100*countNanoseconds*raysTotal/(seconds*1e9);
+		RRReporter::report((overhead<1)?INF1:ERRO,"  bake: estimated %.3f%% (%llu rays in %.2fs, limit is 1%%)\n",overhead,raysTotal,seconds);
+		RRReporter::report(raysOutside?ERRO:INF1,"  bake: rays counted outside of stages: %llu\n",raysOutside);
+		delete scene.room->illumination.getLayer(0);
+		scene.room->illumination.getLayer(0) = nullptr;
+	}
+}
+
+// Counts errors reported by benchmarks and by Lightsprint internals.
+class ErrorCounter : public RRReporter
+{
+public:
+	std::atomic<unsigned> numErrors;
+	ErrorCounter() : numErrors(0) {}
+	virtual void customReport(RRReportType type, int indentation, const char* message) override
+	{
+		if (type==ERRO)
+			numErrors++;
+	}
+};
 
 int main(int argc, char** argv)
 {
 	RRReporter* reporter = RRReporter::createPrintfReporter();
+	ErrorCounter errorCounter;
+	bool facegroups = argc>1 && !strcmp(argv[1],"facegroups");
+	bool mipmaps = argc>1 && !strcmp(argv[1],"mipmaps");
+	bool unwrap = argc>1 && !strcmp(argv[1],"unwrap");
+	bool profiler = argc>1 && !strcmp(argv[1],"profiler");
+	bool direct = argc>1 && !strcmp(argv[1],"direct");
+	bool colorspace = argc>1 && !strcmp(argv[1],"colorspace");
+	bool culling = argc>1 && !strcmp(argv[1],"culling");
+	bool reporterTest = argc>1 && !strcmp(argv[1],"reporter");
+	bool arena = argc>1 && !strcmp(argv[1],"arena");
+	bool layers = argc>1 && !strcmp(argv[1],"layers");
+	bool cubes = argc>1 && !strcmp(argv[1],"cubes");
+	bool area = argc>1 && !strcmp(argv[1],"area");
+	bool lightTree = argc>1 && !strcmp(argv[1],"lighttree");
+	bool lightCulling = argc>1 && !strcmp(argv[1],"lightculling");
+	bool irradiance = argc>1 && !strcmp(argv[1],"irradiance");
+	bool ggx = argc>1 && !strcmp(argv[1],"ggx");
+	bool cameraRays = argc>1 && !strcmp(argv[1],"camerarays");
+	bool vertexBuffers = argc>1 && !strcmp(argv[1],"vertexbuffers");
+	bool environment = argc>1 && !strcmp(argv[1],"environment");
 
 	RRReporter::report(INF1,"Stanford Bunny Benchmark\n");
 
@@ -59,6 +484,53 @@ int main(int argc, char** argv)
 		collider = RRCollider::create(rrMesh,nullptr,RRCollider::IT_BVH_FAST,aborting);
 	}
 
+	// optional benchmarks
+	if (facegroups || mipmaps || unwrap || profiler || direct || colorspace || culling || reporterTest || arena || layers || cubes || area || lightTree || lightCulling || irradiance || ggx || cameraRays || vertexBuffers || environment)
+	{
+		if (facegroups)
+			benchmarkFaceGroups(collider);
+		if (mipmaps)
+			benchmarkMipmaps(rrMesh,collider);
+		if (unwrap)
+			benchmarkUnwrap(rrMesh);
+		if (profiler)
+			benchmarkProfiler(rrMesh,collider,vecpool);
+		if (direct)
+			benchmarkDirectIllumination(rrMesh,collider);
+		if (colorspace)
+			benchmarkColorSpace();
+		if (culling)
+			benchmarkCulling();
+		if (reporterTest)
+			benchmarkReporter(reporter);
+		if (arena)
+			benchmarkArena(rrMesh,collider);
+		if (layers)
+			benchmarkLayers();
+		if (cubes)
+			benchmarkCubes(rrMesh,collider);
+		if (area)
+			benchmarkAreaLights(rrMesh,collider);
+		if (lightTree)
+			benchmarkLightTree(rrMesh,collider);
+		if (lightCulling)
+			benchmarkLightCulling();
+		if (irradiance)
+			benchmarkIrradiance();
+		if (ggx)
+			benchmarkGgx();
+		if (cameraRays)
+			benchmarkCameraRays(rrMesh,collider);
+		if (vertexBuffers)
+			benchmarkVertexBuffers();
+		if (environment)
+			benchmarkEnvironment();
+		delete collider;
+		delete rrMesh;
+		delete reporter;
+		return errorCounter.numErrors;
+	}
+
 	// start watch
 	RRTime time;
 
@@ -0,0 +1,125 @@
+// --------------------------------------------------------------------------
+// Shared by BunnyBenchmark modes.
+//
+// Mode reports failed check as ERRO message, main() counts them
+// and returns their number as exit code.
+// --------------------------------------------------------------------------
+
+#ifndef BUNNYBENCHMARK_H
+#define BUNNYBENCHMARK_H
+
+#include "Lightsprint/RRCollider.h"
+#include "Lightsprint/RRObject.h"
+#include "Lightsprint/RRSolver.h"
+
+using namespace rr;
+
+// Room with finely textured walls, lit by point light, with bunny inside.
+struct RoomScene
+{
+	enum {N=8, TEXTURE_SIZE=1024};
+	RRMeshArrays* roomMesh;
+	RRObject* room;
+	RRMaterial* roomMaterial;
+	RRObject* bunny;
+	RRMaterial* bunnyMaterial;
+	RRObjects objects;
+	RRLights lights;
+	RRSolver* solver;
+
+	RoomScene(RRMesh* bunnyMesh, const RRCollider* bunnyCollider)
+	{
+		// room = inside of cube, lightmap in uv channel 0, texture tiled 8x per wall in channel 1
+		roomMesh = new RRMeshArrays;
+		RRVector<unsigned> texcoords;
+		texcoords.push_back(0);
+		texcoords.push_back(1);
+		roomMesh->resizeMesh(6*N*N*2,6*(N+1)*(N+1),&texcoords,false,false);
+		unsigned v = 0, t = 0;
+		for (unsigned side=0;side<6;side++)
+		{
+			unsigned axis = side/2;
+			float sign = (side&1) ? 1.f : -1.f;
+			unsigned first = v;
+			for (unsigned i=0;i<=N;i++)
+				for (unsigned j=0;j<=N;j++,v++)
+				{
+					RRVec3 position;
+					position[axis] = sign;
+					position[(axis+1)%3] = 2.f*i/N-1;
+					position[(axis+2)%3] = 2.f*j/N-1;
+					RRVec3 normal(0);
+					normal[axis] = -sign;
+					roomMesh->position[v] = position*0.3f+RRVec3(0,0.1f,0);
+					roomMesh->normal[v] = normal;
+					roomMesh->texcoord[0][v] = RRVec2((side%3+(float)i/N)/3*0.98f,(side/3+(float)j/N)/2*0.98f);
+					roomMesh->texcoord[1][v] = RRVec2(8.f*i/N,8.f*j/N);
+				}
+			for (unsigned i=0;i<N;i++)
+				for (unsigned j=0;j<N;j++)
+				{
+					unsigned a = first+i*(N+1)+j, b = a+1, c = a+N+1, d = c+1;
+					roomMesh->triangle[t++] = (sign>0) ? RRMeshArrays::Triangle{a,b,c} : RRMeshArrays::Triangle{a,c,b};
+					roomMesh->triangle[t++] = (sign>0) ? RRMeshArrays::Triangle{b,d,c} : RRMeshArrays::Triangle{b,c,d};
+				}
+		}
+		bool aborting = false;
+		room = new RRObject;
+		room->setCollider(RRCollider::create(roomMesh,nullptr,RRCollider::IT_BVH_FAST,aborting));
+		RRBuffer* checker = RRBuffer::create(BT_2D_TEXTURE,TEXTURE_SIZE,TEXTURE_SIZE,1,BF_RGB,true,nullptr);
+		for (unsigned i=0;i<TEXTURE_SIZE*TEXTURE_SIZE;i++)
+			checker->setElement(i,RRVec4(((i^(i/TEXTURE_SIZE))&1)?0.9f:0.1f),nullptr);
+		roomMaterial = new RRMaterial;
+		roomMaterial->reset(false);
+		roomMaterial->diffuseReflectance.texture = checker;
+		roomMaterial->diffuseReflectance.texcoord = 1;
+		roomMaterial->lightmap.texcoord = 0;
+		roomMaterial->updateColorsFromTextures(nullptr,RRMaterial::UTA_DELETE,true);
+		room->faceGroups.push_back(RRObject::FaceGroup(roomMaterial,t));
+
+		// bunny, not baked, only occludes and reflects
+		bunny = new RRObject;
+		bunny->setCollider(const_cast<RRCollider*>(bunnyCollider));
+		bunnyMaterial = new RRMaterial;
+		bunnyMaterial->reset(false);
+		bunny->faceGroups.push_back(RRObject::FaceGroup(bunnyMaterial,bunnyMesh->getNumTriangles()));
+
+		objects.push_back(room);
+		objects.push_back(bunny);
+		solver = new RRSolver;
+		solver->setStaticObjects(objects,nullptr);
+		lights.push_back(RRLight::createPointLight(RRVec3(0.1f,0.3f,0.05f),RRVec3(0.1f)));
+		solver->setLights(lights);
+	}
+
+	~RoomScene()
+	{
+		delete solver;
+		delete lights[0];
+		delete bunnyMaterial;
+		delete bunny;
+		delete roomMaterial; // deletes checker
+		delete room->getCollider();
+		delete room;
+		delete roomMesh;
+	}
+};
+
+// modes implemented in other files
+void benchmarkArena(RRMesh* bunnyMesh, const RRCollider* bunnyCollider);
+void benchmarkAreaLights(RRMesh* bunnyMesh, const RRCollider* bunnyCollider);
+void benchmarkCameraRays(RRMesh* bunnyMesh, const RRCollider* bunnyCollider);
+void benchmarkCubes(RRMesh* bunnyMesh, const RRCollider* bunnyCollider);
+void benchmarkDirectIllumination(RRMesh* bunnyMesh, const RRCollider* bunnyCollider);
+void benchmarkColorSpace();
+void benchmarkEnvironment();
+void benchmarkCulling();
+void benchmarkGgx();
+void benchmarkIrradiance();
+void benchmarkLayers();
+void benchmarkLightCulling();
+void benchmarkLightTree(RRMesh* bunnyMesh, const RRCollider* bunnyCollider);
+void benchmarkReporter(RRReporter*& printfReporter);
+void benchmarkVertexBuffers();
+
+#endif
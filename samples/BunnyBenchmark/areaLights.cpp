@@ -0,0 +1,334 @@
+// --------------------------------------------------------------------------
+// BunnyBenchmark area
+//
+// Checks area lights against analytic irradiance of unoccluded receivers:
+// averages of RRLight::getIrradianceSample() over stratified samples
+// and lightmaps baked on floor lit by sphere, disk and rectangle light.
+// Benchmarks disk light in room with bunny against N point lights spread over the same disk,
+// time and error of bake vs reference area light baked in high quality.
+// --------------------------------------------------------------------------
+
+#include "BunnyBenchmark.h"
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+enum
+{
+	SAMPLES_PER_SIDE = 64,
+	FLOOR_SIZE = 32, // quads per side of floor
+};
+
+// Irradiance of receiver from unoccluded light with colorSpace=nullptr, average of stratified samples.
+static RRVec3 getSampledIrradiance(const RRLight* light, const RRVec3& receiverPosition, const RRVec3& receiverNormal, unsigned& numSamplesOffLight)
+{
+	RRVec3 sum(0);
+	for (unsigned i=0;i<SAMPLES_PER_SIDE;i++)
+		for (unsigned j=0;j<SAMPLES_PER_SIDE;j++)
+		{
+			RRVec3 directionToLight;
+			RRReal distanceToLight;
+			RRVec3 irradiance = light->getIrradianceSample(receiverPosition,RRVec2((i+0.5f)/SAMPLES_PER_SIDE,(j+0.5f)/SAMPLES_PER_SIDE),nullptr,directionToLight,distanceToLight);
+			sum += irradiance*RR_MAX(0,receiverNormal.dot(directionToLight));
+
+			// sampled point must lie on surface of light
+			if (light->type!=RRLight::DIRECTIONAL)
+			{
+				RRVec3 offset = receiverPosition+directionToLight*distanceToLight-light->position;
+				RRReal height = offset.dot(light->direction.normalized());
+				bool onLight = (light->areaType==RRLight::AREA_SPHERE)
+					? fabs(offset.length()-light->areaSize.x)<1e-4f
+					: fabs(height)<1e-4f && ((light->areaType==RRLight::AREA_DISK)
+						? offset.length()<light->areaSize.x*1.0001f
+						: offset.length()<light->areaSize.length()/2*1.0001f);
+				if (!onLight)
+					numSamplesOffLight++;
+			}
+		}
+	return sum/(SAMPLES_PER_SIDE*SAMPLES_PER_SIDE);
+}
+
+// Irradiance of receiver at distance from center of sphere light, receiver normal forms angle with direction to center.
+// Sphere entirely above receiver's horizon gives the same irradiance as point light in its center.
+static RRReal getSphereIrradiance(RRReal color, RRReal distance, RRReal cosAngle)
+{
+	return color*cosAngle/(distance*distance);
+}
+
+// Irradiance of receiver on axis of disk light, facing it. Disk light is made of isotropic point lights,
+// irradiance is color/area times solid angle of disk.
+static RRReal getDiskIrradiance(RRReal color, RRReal radius, RRReal distance)
+{
+	return color/(RR_PI*radius*radius) * 2*RR_PI*(1-distance/sqrt(distance*distance+radius*radius));
+}
+
+// Irradiance of receiver on axis of rectangle light, facing it, color/area times solid angle of rectangle.
+static RRReal getRectangleIrradiance(RRReal color, RRVec2 size, RRReal distance)
+{
+	RRReal x = size.x/2;
+	RRReal y = size.y/2;
+	return color/(size.x*size.y) * 4*atan(x*y/(distance*sqrt(distance*distance+x*x+y*y)));
+}
+
+// Irradiance of receiver from directional light with angular diameter, each direction in cone brings full color.
+static RRReal getSunIrradiance(RRReal color, RRReal angularDiameter, RRReal cosAngle)
+{
+	return color*cosAngle*(1+cos(angularDiameter/2))/2;
+}
+
+static void reportComparison(const char* name, RRReal measured, RRReal analytic, RRReal maxRelativeError)
+{
+	RRReal error = fabs(measured-analytic)/analytic;
+	RRReporter::report((error<=maxRelativeError)?INF1:ERRO,"  %-40s %.5f vs analytic %.5f, error %.2f%%\n",name,measured,analytic,error*100);
+}
+
+static void testSamples()
+{
+	RRReporter::report(INF1,"Area lights, %dx%d stratified samples vs analytic irradiance:\n",SAMPLES_PER_SIDE,SAMPLES_PER_SIDE);
+	const RRReal MAX_ERROR = 0.005f;
+	unsigned numSamplesOffLight = 0;
+
+	RRLight* sphere = RRLight::createPointLight(RRVec3(0.3f,1,-0.2f),RRVec3(0.5f));
+	sphere->areaType = RRLight::AREA_SPHERE;
+	sphere->areaSize = RRVec2(0.25f);
+	RRVec3 receiver(0.1f,0.2f,0.1f);
+	RRVec3 toCenter = sphere->position-receiver;
+	RRReal distance = toCenter.length();
+	reportComparison("sphere, receiver facing center",getSampledIrradiance(sphere,receiver,toCenter/distance,numSamplesOffLight)[0],getSphereIrradiance(0.5f,distance,1),MAX_ERROR);
+	RRVec3 tilted = RRVec3(0,1,0);
+	reportComparison("sphere, receiver tilted",getSampledIrradiance(sphere,receiver,tilted,numSamplesOffLight)[0],getSphereIrradiance(0.5f,distance,tilted.dot(toCenter/distance)),MAX_ERROR);
+	sphere->areaSize = RRVec2(0.75f);
+	reportComparison("sphere, receiver close to surface",getSampledIrradiance(sphere,receiver,toCenter/distance,numSamplesOffLight)[0],getSphereIrradiance(0.5f,distance,1),MAX_ERROR);
+	delete sphere;
+
+	RRLight* disk = RRLight::createPointLight(RRVec3(0,1,0),RRVec3(0.5f));
+	disk->direction = RRVec3(0,-1,0);
+	disk->areaType = RRLight::AREA_DISK;
+	for (RRReal radius=0.1f;radius<2;radius*=4)
+	{
+		disk->areaSize = RRVec2(radius);
+		char name[100];
+		sprintf(name,"disk radius %.1f, receiver on axis",radius);
+		reportComparison(name,getSampledIrradiance(disk,RRVec3(0,0.5f,0),RRVec3(0,1,0),numSamplesOffLight)[0],getDiskIrradiance(0.5f,radius,0.5f),MAX_ERROR);
+	}
+	delete disk;
+
+	RRLight* rectangle = RRLight::createPointLight(RRVec3(0,1,0),RRVec3(0.5f));
+	rectangle->direction = RRVec3(1,-1,0).normalized();
+	rectangle->areaType = RRLight::AREA_RECTANGLE;
+	rectangle->areaSize = RRVec2(0.8f,0.3f);
+	reportComparison("rectangle 0.8x0.3, receiver on axis",getSampledIrradiance(rectangle,rectangle->position+rectangle->direction*0.4f,-rectangle->direction,numSamplesOffLight)[0],getRectangleIrradiance(0.5f,rectangle->areaSize,0.4f),MAX_ERROR);
+	delete rectangle;
+
+	RRLight* sun = RRLight::createDirectionalLight(RRVec3(0,-1,0),RRVec3(0.5f),true);
+	sun->angularDiameterRad = 0.5f;
+	RRVec3 normal = RRVec3(0.5f,1,0).normalized();
+	reportComparison("sun diameter 0.5 rad, receiver tilted",getSampledIrradiance(sun,RRVec3(0),normal,numSamplesOffLight)[0],getSunIrradiance(0.5f,0.5f,normal.y),MAX_ERROR);
+	delete sun;
+
+	RRReporter::report(numSamplesOffLight?ERRO:INF1,"  %d samples not on surface of light\n",numSamplesOffLight);
+}
+
+// Bakes per-vertex irradiance of 2x2 floor lit by one light, direct illumination only.
+static RRBuffer* bakeFloor(RRLight* light, unsigned quality)
+{
+	RRMeshArrays* mesh = new RRMeshArrays;
+	RRVector<unsigned> texcoords;
+	texcoords.push_back(0);
+	mesh->resizeMesh(FLOOR_SIZE*FLOOR_SIZE*2,(FLOOR_SIZE+1)*(FLOOR_SIZE+1),&texcoords,false,false);
+	for (unsigned i=0;i<=FLOOR_SIZE;i++)
+		for (unsigned j=0;j<=FLOOR_SIZE;j++)
+		{
+			unsigned v = i*(FLOOR_SIZE+1)+j;
+			mesh->position[v] = RRVec3(2.f*i/FLOOR_SIZE-1,0,2.f*j/FLOOR_SIZE-1);
+			mesh->normal[v] = RRVec3(0,1,0);
+			mesh->texcoord[0][v] = RRVec2((RRReal)i/FLOOR_SIZE,(RRReal)j/FLOOR_SIZE);
+		}
+	unsigned t = 0;
+	for (unsigned i=0;i<FLOOR_SIZE;i++)
+		for (unsigned j=0;j<FLOOR_SIZE;j++)
+		{
+			unsigned a = i*(FLOOR_SIZE+1)+j, b = a+1, c = a+FLOOR_SIZE+1, d = c+1;
+			mesh->triangle[t++] = RRMeshArrays::Triangle{a,b,c};
+			mesh->triangle[t++] = RRMeshArrays::Triangle{b,d,c};
+		}
+	bool aborting = false;
+	RRObject* floor = new RRObject;
+	floor->setCollider(RRCollider::create(mesh,nullptr,RRCollider::IT_LINEAR,aborting));
+	RRMaterial* material = new RRMaterial;
+	material->reset(false);
+	floor->faceGroups.push_back(RRObject::FaceGroup(material,t));
+	RRObjects objects;
+	objects.push_back(floor);
+	RRLights lights;
+	lights.push_back(light);
+
+	RRReporter::setFilter(true,0,false);
+	RRSolver* solver = new RRSolver;
+	solver->setStaticObjects(objects,nullptr);
+	solver->setLights(lights);
+	RRSolver::UpdateParameters params(quality);
+	params.indirect.lightMultiplier = 0;
+	params.indirect.environmentMultiplier = 0;
+	params.indirect.materialEmittanceMultiplier = 0;
+	params.randomSeed = 1;
+	RRBuffer* vertexBuffer = RRBuffer::create(BT_VERTEX_BUFFER,mesh->numVertices,1,1,BF_RGBF,false,nullptr);
+	solver->updateLightmap(0,vertexBuffer,nullptr,nullptr,&params);
+	delete solver;
+	RRReporter::setFilter(true,1,false);
+
+	delete material;
+	delete floor->getCollider();
+	delete floor;
+	delete mesh;
+	return vertexBuffer;
+}
+
+static RRVec3 getFloorVertex(unsigned v)
+{
+	return RRVec3(2.f*(v/(FLOOR_SIZE+1))/FLOOR_SIZE-1,0,2.f*(v%(FLOOR_SIZE+1))/FLOOR_SIZE-1);
+}
+
+static void testBake()
+{
+	enum {QUALITY=1000};
+	RRReporter::report(INF1,"Area lights, floor baked per-vertex in quality %d vs analytic irradiance:\n",QUALITY);
+	const RRReal MAX_ERROR = 0.025f; // vertex averages triangles around it, under light it is 1.7% below peak even with point light
+	unsigned center = FLOOR_SIZE/2*(FLOOR_SIZE+1)+FLOOR_SIZE/2;
+
+	// sphere is above horizon of all vertices, whole floor has analytic irradiance
+	RRLight* sphere = RRLight::createPointLight(RRVec3(0.1f,0.4f,0),RRVec3(0.1f));
+	sphere->areaType = RRLight::AREA_SPHERE;
+	sphere->areaSize = RRVec2(0.2f);
+	RRBuffer* baked = bakeFloor(sphere,QUALITY);
+	RRReal maxError = 0;
+	unsigned worstVertex = 0;
+	for (unsigned v=0;v<baked->getWidth();v++)
+	{
+		// border vertices average triangles on one side only, they differ from irradiance in vertex
+		if (v<=FLOOR_SIZE || v>=FLOOR_SIZE*(FLOOR_SIZE+1) || v%(FLOOR_SIZE+1)==0 || v%(FLOOR_SIZE+1)==FLOOR_SIZE)
+			continue;
+		RRVec3 toCenter = sphere->position-getFloorVertex(v);
+		RRReal analytic = getSphereIrradiance(0.1f,toCenter.length(),toCenter.normalized().y);
+		RRReal error = fabs(baked->getElement(v,nullptr)[0]-analytic)/analytic;
+		if (error>maxError)
+		{
+			maxError = error;
+			worstVertex = v;
+		}
+	}
+	RRVec3 worst = getFloorVertex(worstVertex);
+	RRReporter::report((maxError<=MAX_ERROR)?INF1:ERRO,"  %-40s max error %.2f%% at vertex %.2f %.2f %.2f\n","sphere radius 0.2, inner vertices",maxError*100,worst.x,worst.y,worst.z);
+	delete baked;
+	delete sphere;
+
+	RRLight* disk = RRLight::createPointLight(RRVec3(0,0.4f,0),RRVec3(0.1f));
+	disk->direction = RRVec3(0,-1,0);
+	disk->areaType = RRLight::AREA_DISK;
+	disk->areaSize = RRVec2(0.3f);
+	baked = bakeFloor(disk,QUALITY);
+	reportComparison("disk radius 0.3, vertex on axis",baked->getElement(center,nullptr)[0],getDiskIrradiance(0.1f,0.3f,0.4f),MAX_ERROR);
+	delete baked;
+	delete disk;
+
+	RRLight* rectangle = RRLight::createPointLight(RRVec3(0,0.4f,0),RRVec3(0.1f));
+	rectangle->direction = RRVec3(0,-1,0);
+	rectangle->areaType = RRLight::AREA_RECTANGLE;
+	rectangle->areaSize = RRVec2(0.6f,0.2f);
+	baked = bakeFloor(rectangle,QUALITY);
+	reportComparison("rectangle 0.6x0.2, vertex on axis",baked->getElement(center,nullptr)[0],getRectangleIrradiance(0.1f,rectangle->areaSize,0.4f),MAX_ERROR);
+	delete baked;
+	delete rectangle;
+}
+
+// Bakes direct illumination into room lightmap, returns seconds.
+static double bakeRoom(RoomScene& scene, unsigned quality, RRBuffer* lightmap)
+{
+	RRSolver::UpdateParameters params(quality);
+	params.indirect.lightMultiplier = 0;
+	params.indirect.environmentMultiplier = 0;
+	params.indirect.materialEmittanceMultiplier = 0;
+	params.randomSeed = 1;
+	RRReporter::setFilter(true,0,false);
+	RRTime time;
+	scene.solver->updateLightmap(0,lightmap,nullptr,nullptr,&params);
+	double seconds = time.secondsPassed();
+	RRReporter::setFilter(true,1,false);
+	return seconds;
+}
+
+// Mean absolute difference relative to mean of reference.
+static double getError(const RRBuffer* lightmap, const RRBuffer* reference)
+{
+	double sumOfDifferences = 0;
+	double sumOfReference = 0;
+	for (unsigned i=0;i<reference->getWidth()*reference->getHeight();i++)
+	{
+		sumOfDifferences += fabs(lightmap->getElement(i,nullptr)[0]-reference->getElement(i,nullptr)[0]);
+		sumOfReference += reference->getElement(i,nullptr)[0];
+	}
+	return sumOfDifferences/sumOfReference;
+}
+
+static void benchmarkBake(RRMesh* bunnyMesh, const RRCollider* bunnyCollider)
+{
+	enum {LIGHTMAP_SIZE=128, REFERENCE_QUALITY=2000};
+	RoomScene scene(bunnyMesh,bunnyCollider);
+	RRLights roomLights = scene.lights; // RoomScene deletes its light
+	RRLight* disk = RRLight::createPointLight(RRVec3(0,0.38f,0),RRVec3(0.1f));
+	disk->direction = RRVec3(0,-1,0);
+	disk->areaType = RRLight::AREA_DISK;
+	disk->areaSize = RRVec2(0.1f);
+	RRLights lights;
+	lights.push_back(disk);
+	scene.solver->setLights(lights);
+	RRReporter::report(INF1,"Disk light vs point lights spread over disk, room %dx%d lightmap, error vs area light in quality %d:\n",LIGHTMAP_SIZE,LIGHTMAP_SIZE,REFERENCE_QUALITY);
+
+	RRBuffer* reference = RRBuffer::create(BT_2D_TEXTURE,LIGHTMAP_SIZE,LIGHTMAP_SIZE,1,BF_RGBF,false,nullptr);
+	RRBuffer* lightmap = RRBuffer::create(BT_2D_TEXTURE,LIGHTMAP_SIZE,LIGHTMAP_SIZE,1,BF_RGBF,false,nullptr);
+	double referenceSeconds = bakeRoom(scene,REFERENCE_QUALITY,reference);
+	RRReporter::report(INF1,"  %-22s quality %4d  %7.3fs\n","reference area light",REFERENCE_QUALITY,referenceSeconds);
+	for (unsigned quality=25;quality<=400;quality*=4)
+	{
+		double seconds = bakeRoom(scene,quality,lightmap);
+		RRReporter::report(INF1,"  %-22s quality %4d  %7.3fs  error %5.2f%%\n","area light",quality,seconds,getError(lightmap,reference)*100);
+	}
+
+	// N point lights with color/N at stratified points of disk, as many shadow rays per round as lights
+	for (unsigned side=2;side<=8;side*=2)
+	{
+		unsigned numLights = side*side;
+		lights.clear();
+		for (unsigned i=0;i<side;i++)
+			for (unsigned j=0;j<side;j++)
+			{
+				RRVec3 directionToLight;
+				RRReal distanceToLight;
+				disk->getIrradianceSample(RRVec3(0),RRVec2((i+0.5f)/side,(j+0.5f)/side),nullptr,directionToLight,distanceToLight);
+				lights.push_back(RRLight::createPointLight(directionToLight*distanceToLight,disk->color/(RRReal)numLights));
+			}
+		scene.solver->setLights(lights);
+		char name[100];
+		sprintf(name,"%d point lights",numLights);
+		for (unsigned quality=25;quality<=100;quality*=4)
+		{
+			double seconds = bakeRoom(scene,quality,lightmap);
+			RRReporter::report(INF1,"  %-22s quality %4d  %7.3fs  error %5.2f%%\n",name,quality,seconds,getError(lightmap,reference)*100);
+		}
+		scene.solver->setLights(RRLights());
+		for (unsigned i=0;i<lights.size();i++)
+			delete lights[i];
+	}
+
+	delete lightmap;
+	delete reference;
+	delete disk;
+	scene.solver->setLights(roomLights);
+}
+
+void benchmarkAreaLights(RRMesh* bunnyMesh, const RRCollider* bunnyCollider)
+{
+	testSamples();
+	testBake();
+	benchmarkBake(bunnyMesh,bunnyCollider);
+}
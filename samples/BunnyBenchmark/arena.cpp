@@ -0,0 +1,148 @@
+// --------------------------------------------------------------------------
+// BunnyBenchmark arena
+//
+// Counts heap allocations (malloc calls in whole process) and measures time of lightmap bake
+// at two lightmap resolutions. Temporary per-texel data come from RRArena,
+// so number of allocations must not grow with number of texels.
+// Measures cost of RRArena::Scope + allocate() against malloc() + free().
+// --------------------------------------------------------------------------
+
+#include "BunnyBenchmark.h"
+#include <atomic>
+#include <stdlib.h>
+#include <omp.h>
+
+#ifdef __GLIBC__
+
+// glibc lets executable replace malloc for the whole process, including LightsprintCore and C++ runtime.
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t num, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+static std::atomic<unsigned long long> g_numMallocs(0);
+
+extern "C" void* malloc(size_t size) noexcept
+{
+	g_numMallocs.fetch_add(1,std::memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t num, size_t size) noexcept
+{
+	g_numMallocs.fetch_add(1,std::memory_order_relaxed);
+	return __libc_calloc(num,size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) noexcept
+{
+	g_numMallocs.fetch_add(1,std::memory_order_relaxed);
+	return __libc_realloc(ptr,size);
+}
+
+#define COUNT_MALLOCS
+
+#endif
+
+static unsigned long long getNumMallocs()
+{
+#ifdef COUNT_MALLOCS
+	return g_numMallocs;
+#else
+	return 0;
+#endif
+}
+
+struct BakeStatistics
+{
+	double seconds;
+	unsigned long long numMallocs;
+};
+
+static BakeStatistics bake(RoomScene& scene, unsigned lightmapSize)
+{
+	enum {QUALITY=100};
+	scene.room->illumination.getLayer(0) = RRBuffer::create(BT_2D_TEXTURE,lightmapSize,lightmapSize,1,BF_RGBF,false,nullptr);
+	RRSolver::UpdateParameters params(QUALITY);
+	RRReporter::setFilter(true,0,false);
+	BakeStatistics statistics;
+	unsigned long long numMallocs = getNumMallocs();
+	RRTime time;
+	scene.solver->updateLightmaps(0,-1,-1,&params,nullptr);
+	statistics.seconds = time.secondsPassed();
+	statistics.numMallocs = getNumMallocs()-numMallocs;
+	RRReporter::setFilter(true,1,false);
+	delete scene.room->illumination.getLayer(0);
+	scene.room->illumination.getLayer(0) = nullptr;
+	return statistics;
+}
+
+// Returns nanoseconds per allocation of 16..4111 bytes, allocations freed in groups of 8.
+static double measureAllocations(bool arena, bool allThreads)
+{
+	enum {NUM_GROUPS=200000, GROUP_SIZE=8};
+	std::atomic<unsigned> check(0);
+	RRTime time;
+	#pragma omp parallel if(allThreads)
+	{
+		// outer scope keeps slabs allocated, as during bake
+		RRArena::Scope outerScope;
+		unsigned sum = 0;
+		#pragma omp for
+		for (int i=0;i<NUM_GROUPS;i++)
+		{
+			unsigned char* memory[GROUP_SIZE];
+			if (arena)
+			{
+				RRArena::Scope scope;
+				for (unsigned j=0;j<GROUP_SIZE;j++)
+				{
+					memory[j] = RRArena::getThreadArena().allocateArray<unsigned char>(16+((i*GROUP_SIZE+j)*2654435761u>>20)%4096);
+					memory[j][0] = (unsigned char)j;
+				}
+				for (unsigned j=0;j<GROUP_SIZE;j++)
+					sum += memory[j][0];
+			}
+			else
+			{
+				for (unsigned j=0;j<GROUP_SIZE;j++)
+				{
+					memory[j] = (unsigned char*)malloc(16+((i*GROUP_SIZE+j)*2654435761u>>20)%4096);
+					memory[j][0] = (unsigned char)j;
+				}
+				for (unsigned j=0;j<GROUP_SIZE;j++)
+				{
+					sum += memory[j][0];
+					free(memory[j]);
+				}
+			}
+		}
+		check += sum;
+	}
+	double seconds = time.secondsPassed();
+	if (check!=(unsigned)NUM_GROUPS*GROUP_SIZE*(GROUP_SIZE-1)/2)
+		RRReporter::report(ERRO,"  allocated memory was overwritten\n");
+	return seconds*1e9/(NUM_GROUPS*GROUP_SIZE);
+}
+
+void benchmarkArena(RRMesh* bunnyMesh, const RRCollider* bunnyCollider)
+{
+	enum {SMALL_LIGHTMAP=128, BIG_LIGHTMAP=256};
+	RRReporter::report(INF1,"Heap allocations in lightmap bake of textured room:\n");
+	RoomScene scene(bunnyMesh,bunnyCollider);
+	bake(scene,SMALL_LIGHTMAP); // warm up caches inside solver
+	BakeStatistics small = bake(scene,SMALL_LIGHTMAP);
+	BakeStatistics big = bake(scene,BIG_LIGHTMAP);
+#ifdef COUNT_MALLOCS
+	RRReporter::report(INF1,"  %dx%d lightmap  %6.2fs  %8llu mallocs\n",SMALL_LIGHTMAP,SMALL_LIGHTMAP,small.seconds,small.numMallocs);
+	RRReporter::report(INF1,"  %dx%d lightmap  %6.2fs  %8llu mallocs\n",BIG_LIGHTMAP,BIG_LIGHTMAP,big.seconds,big.numMallocs);
+	// 4x more texels, allocations may grow only with sizes of lightmap buffers and of per-thread arrays
+	RRReporter::report((big.numMallocs*2<=small.numMallocs*3)?INF1:ERRO,"  mallocs grow %.2fx with 4x more texels (limit is 1.5x)\n",(double)big.numMallocs/small.numMallocs);
+#else
+	RRReporter::report(INF1,"  %dx%d lightmap  %6.2fs  (mallocs are counted only with glibc)\n",SMALL_LIGHTMAP,SMALL_LIGHTMAP,small.seconds);
+	RRReporter::report(INF1,"  %dx%d lightmap  %6.2fs\n",BIG_LIGHTMAP,BIG_LIGHTMAP,big.seconds);
+#endif
+
+	RRReporter::report(INF1,"Cost of allocation (16..4111 bytes, freed in groups of 8):\n");
+	for (unsigned arena=0;arena<2;arena++)
+		RRReporter::report(INF1,"  %-14s %6.1fns in 1 thread, %6.1fns in %d threads\n",arena?"RRArena":"malloc+free",measureAllocations(arena!=0,false),measureAllocations(arena!=0,true),omp_get_max_threads());
+}
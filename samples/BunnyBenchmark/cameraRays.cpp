@@ -0,0 +1,253 @@
+// --------------------------------------------------------------------------
+// BunnyBenchmark camerarays
+//
+// Checks that both RRCamera::getRays() variants return exactly the same rays as getRay()
+// called per position, for perspective and orthogonal projection, all panorama modes and coverages,
+// stereo modes, shifted screen center, and randomized (DOF) rays with rand() and with RandomStream.
+// Measures rays per second of getRay() and getRays(), and time of setRangeDynamically() in room with bunny.
+// --------------------------------------------------------------------------
+
+#include "BunnyBenchmark.h"
+#include "Lightsprint/RRCamera.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+enum
+{
+	VIEWPORT_WIDTH = 128,
+	VIEWPORT_HEIGHT = 96,
+	SAMPLES_PER_AXIS = 2, // 49152 rays, enough for getRays() to run in parallel
+	NUM_BENCHMARK_RAYS = 1000000,
+};
+
+struct Rays
+{
+	std::vector<RRVec2> positions;
+	std::vector<RRVec3> origins;
+	std::vector<RRVec3> directions;
+	std::vector<char> valid; // vector<bool> has no data()
+
+	Rays(size_t numRays) : positions(numRays), origins(numRays), directions(numRays), valid(numRays) {}
+	bool* getValid() {return (bool*)valid.data();}
+	// Returns number of rays different from other.
+	unsigned compare(const Rays& other) const
+	{
+		unsigned numDifferent = 0;
+		for (size_t i=0;i<origins.size();i++)
+			if (memcmp(&origins[i],&other.origins[i],sizeof(RRVec3)) || memcmp(&directions[i],&other.directions[i],sizeof(RRVec3)) || valid[i]!=other.valid[i])
+				numDifferent++;
+		return numDifferent;
+	}
+};
+
+// Fills positions of subpixel centers in rectangle, in order of getRays(), computed the same way.
+static void fillRectanglePositions(Rays& rays, unsigned x0, unsigned y0, unsigned w, unsigned h)
+{
+	size_t index = 0;
+	for (unsigned j=0;j<h;j++)
+	for (unsigned i=0;i<w;i++)
+	for (unsigned sy=0;sy<SAMPLES_PER_AXIS;sy++)
+	for (unsigned sx=0;sx<SAMPLES_PER_AXIS;sx++)
+	{
+		RRVec2 offsetInSubpixel(0.5f);
+		rays.positions[index++] = RRVec2(
+			2*((x0+i)+(sx+offsetInSubpixel.x)/(unsigned)SAMPLES_PER_AXIS)/(unsigned)VIEWPORT_WIDTH-1,
+			2*((y0+j)+(sy+offsetInSubpixel.y)/(unsigned)SAMPLES_PER_AXIS)/(unsigned)VIEWPORT_HEIGHT-1);
+	}
+}
+
+// Returns number of rays where getRays() differs from getRay().
+static unsigned compareDeterministic(const RRCamera& camera)
+{
+	unsigned numDifferent = 0;
+	// full viewport and rectangle inside it
+	unsigned rectangles[2][4] = {{0,0,VIEWPORT_WIDTH,VIEWPORT_HEIGHT},{10,5,40,30}};
+	for (unsigned r=0;r<2;r++)
+	{
+		unsigned x0 = rectangles[r][0], y0 = rectangles[r][1], w = rectangles[r][2], h = rectangles[r][3];
+		size_t numRays = (size_t)w*h*SAMPLES_PER_AXIS*SAMPLES_PER_AXIS;
+		Rays single(numRays), array(numRays), rectangle(numRays);
+		fillRectanglePositions(single,x0,y0,w,h);
+		for (size_t i=0;i<numRays;i++)
+			single.valid[i] = camera.getRay(single.positions[i],single.origins[i],single.directions[i]);
+		array.positions = single.positions;
+		camera.getRays(array.positions.data(),(unsigned)numRays,array.origins.data(),array.directions.data(),array.getValid());
+		camera.getRays(VIEWPORT_WIDTH,VIEWPORT_HEIGHT,x0,y0,w,h,SAMPLES_PER_AXIS,RRCamera::PS_STRATIFIED,rectangle.origins.data(),rectangle.directions.data(),rectangle.getValid());
+		numDifferent += single.compare(array) + single.compare(rectangle);
+	}
+	return numDifferent;
+}
+
+// Returns number of randomized rays where getRays() differs from getRay() with the same random numbers.
+static unsigned compareRandomized(const RRCamera& camera)
+{
+	unsigned numDifferent = 0;
+	size_t numRays = (size_t)VIEWPORT_WIDTH*VIEWPORT_HEIGHT*SAMPLES_PER_AXIS*SAMPLES_PER_AXIS;
+	Rays single(numRays), array(numRays), stream(numRays), rectangle(numRays);
+	fillRectanglePositions(single,0,0,VIEWPORT_WIDTH,VIEWPORT_HEIGHT);
+
+	// rand()
+	srand(7);
+	for (size_t i=0;i<numRays;i++)
+		single.valid[i] = camera.getRay(single.positions[i],single.origins[i],single.directions[i],true);
+	array.positions = single.positions;
+	srand(7);
+	camera.getRays(array.positions.data(),(unsigned)numRays,array.origins.data(),array.directions.data(),array.getValid(),true);
+	numDifferent += single.compare(array);
+
+	// RandomStream, jittered rectangle consumes two numbers per ray for position in subpixel, then numbers for DOF
+	RRCamera::RandomStream random1(3);
+	size_t index = 0;
+	for (unsigned j=0;j<VIEWPORT_HEIGHT;j++)
+	for (unsigned i=0;i<VIEWPORT_WIDTH;i++)
+	for (unsigned sy=0;sy<SAMPLES_PER_AXIS;sy++)
+	for (unsigned sx=0;sx<SAMPLES_PER_AXIS;sx++,index++)
+	{
+		RRVec2 offsetInSubpixel;
+		offsetInSubpixel.x = random1.get01();
+		offsetInSubpixel.y = random1.get01();
+		stream.positions[index] = RRVec2(
+			2*(i+(sx+offsetInSubpixel.x)/(unsigned)SAMPLES_PER_AXIS)/(unsigned)VIEWPORT_WIDTH-1,
+			2*(j+(sy+offsetInSubpixel.y)/(unsigned)SAMPLES_PER_AXIS)/(unsigned)VIEWPORT_HEIGHT-1);
+		camera.getRays(&stream.positions[index],1,&stream.origins[index],&stream.directions[index],stream.getValid()+index,true,&random1);
+	}
+	RRCamera::RandomStream random2(3);
+	camera.getRays(VIEWPORT_WIDTH,VIEWPORT_HEIGHT,0,0,VIEWPORT_WIDTH,VIEWPORT_HEIGHT,SAMPLES_PER_AXIS,RRCamera::PS_JITTERED,rectangle.origins.data(),rectangle.directions.data(),rectangle.getValid(),true,&random2);
+	numDifferent += stream.compare(rectangle);
+	return numDifferent;
+}
+
+static void testEquality()
+{
+	RRReporter::report(INF1,"Camera rays, getRays() vs getRay() per position, %dx%d viewport, %dx%d samples per pixel:\n",VIEWPORT_WIDTH,VIEWPORT_HEIGHT,SAMPLES_PER_AXIS,SAMPLES_PER_AXIS);
+	const char* panoramaNames[] = {"off","equirectangular","little planet","fisheye"};
+	const char* coverageNames[] = {"stretch","full","trunc bottom","trunc top","trunc top bot"};
+	const char* stereoNames[] = {"mono","side by side","top down"};
+	RRCamera::StereoMode stereoModes[] = {RRCamera::SM_MONO,RRCamera::SM_SIDE_BY_SIDE,RRCamera::SM_TOP_DOWN};
+	unsigned numCameras = 0;
+	unsigned numFailedCameras = 0;
+	for (unsigned orthogonal=0;orthogonal<2;orthogonal++)
+	for (unsigned panorama=RRCamera::PM_OFF;panorama<=RRCamera::PM_FISHEYE;panorama++)
+	for (unsigned coverage=RRCamera::PC_FULL_STRETCH;coverage<=(panorama?(unsigned)RRCamera::PC_TRUNCATE_TOP_BOT:RRCamera::PC_FULL_STRETCH);coverage++)
+	for (unsigned stereo=0;stereo<3;stereo++)
+	for (unsigned shifted=0;shifted<2;shifted++)
+	{
+		RRCamera camera(RRVec3(0.1f,0.2f,-0.3f),RRVec3(0.4f,-0.2f,0.1f),(RRReal)VIEWPORT_WIDTH/VIEWPORT_HEIGHT,70,0.1f,100);
+		camera.setProjection(orthogonal!=0,camera.getAspect(),camera.getFieldOfViewVerticalDeg(),camera.getNear(),camera.getFar(),2,shifted?RRVec2(0.3f,-0.2f):RRVec2(0));
+		camera.panoramaMode = (RRCamera::PanoramaMode)panorama;
+		camera.panoramaCoverage = (RRCamera::PanoramaCoverage)coverage;
+		camera.panoramaScale = shifted ? 1.3f : 1;
+		camera.panoramaFisheyeFovDeg = shifted ? 200.f : 360.f;
+		camera.stereoMode = stereoModes[stereo];
+		camera.stereoSwap = shifted!=0;
+		camera.eyeSeparation = 0.08f;
+		camera.displayDistance = 1.5f;
+		unsigned numDifferent = compareDeterministic(camera);
+		numCameras++;
+		if (numDifferent)
+		{
+			numFailedCameras++;
+			RRReporter::report(ERRO,"  %s, panorama %s, coverage %s, %s%s: %d rays differ\n",
+				orthogonal?"orthogonal":"perspective",panoramaNames[panorama],coverageNames[coverage],stereoNames[stereo],shifted?", shifted":"",numDifferent);
+		}
+	}
+	RRReporter::report(numFailedCameras?ERRO:INF1,"  %d cameras, %d with differences\n",numCameras,numFailedCameras);
+
+	// DOF rays use random numbers
+	for (unsigned stereo=0;stereo<3;stereo++)
+	{
+		RRCamera camera(RRVec3(0.1f,0.2f,-0.3f),RRVec3(0.4f,-0.2f,0.1f),(RRReal)VIEWPORT_WIDTH/VIEWPORT_HEIGHT,70,0.1f,100);
+		camera.stereoMode = stereoModes[stereo];
+		camera.eyeSeparation = 0.08f;
+		camera.displayDistance = 1.5f;
+		camera.apertureDiameter = 0.05f;
+		camera.dofNear = 1;
+		camera.dofFar = 2;
+		unsigned numDifferent = compareRandomized(camera);
+		RRReporter::report(numDifferent?ERRO:INF1,"  randomized (DOF), %s: %d rays differ\n",stereoNames[stereo],numDifferent);
+	}
+}
+
+// Returns millions of rays per second.
+static double measureRays(const RRCamera& camera, unsigned method)
+{
+	enum {WIDTH=1000, HEIGHT=NUM_BENCHMARK_RAYS/WIDTH};
+	Rays rays(NUM_BENCHMARK_RAYS);
+	for (unsigned j=0;j<HEIGHT;j++)
+		for (unsigned i=0;i<WIDTH;i++)
+			rays.positions[j*WIDTH+i] = RRVec2((2*i+1.f)/WIDTH-1,(2*j+1.f)/HEIGHT-1);
+	unsigned numRays = 0;
+	RRTime time;
+	do
+	{
+		if (method==0)
+		{
+			for (unsigned i=0;i<NUM_BENCHMARK_RAYS;i++)
+				rays.valid[i] = camera.getRay(rays.positions[i],rays.origins[i],rays.directions[i]);
+		}
+		else if (method==1)
+			camera.getRays(rays.positions.data(),NUM_BENCHMARK_RAYS,rays.origins.data(),rays.directions.data(),rays.getValid());
+		else
+			camera.getRays(WIDTH,HEIGHT,0,0,WIDTH,HEIGHT,1,RRCamera::PS_STRATIFIED,rays.origins.data(),rays.directions.data(),rays.getValid());
+		numRays += NUM_BENCHMARK_RAYS;
+	}
+	while (time.secondsPassed()<0.5f);
+	return numRays/time.secondsPassed()*1e-6;
+}
+
+static void benchmarkRays()
+{
+	RRReporter::report(INF1,"Camera rays per second, %d rays per call:\n",NUM_BENCHMARK_RAYS);
+	const char* names[] = {"perspective","orthogonal","equirectangular","fisheye, side by side"};
+	for (unsigned c=0;c<4;c++)
+	{
+		RRCamera camera(RRVec3(0.1f,0.2f,-0.3f),RRVec3(0.4f,-0.2f,0.1f),1,70,0.1f,100);
+		if (c==1)
+			camera.setOrthogonal(true);
+		if (c==2)
+			camera.panoramaMode = RRCamera::PM_EQUIRECTANGULAR;
+		if (c==3)
+		{
+			camera.panoramaMode = RRCamera::PM_FISHEYE;
+			camera.stereoMode = RRCamera::SM_SIDE_BY_SIDE;
+		}
+		double single = measureRays(camera,0);
+		double array = measureRays(camera,1);
+		double rectangle = measureRays(camera,2);
+		RRReporter::report(INF1,"  %-22s getRay %6.1f M/s  getRays(positions) %6.1f M/s %4.1fx  getRays(rectangle) %6.1f M/s %4.1fx\n",names[c],single,array,array/single,rectangle,rectangle/single);
+	}
+}
+
+static void benchmarkRange(RRMesh* bunnyMesh, const RRCollider* bunnyCollider)
+{
+	RRReporter::report(INF1,"RRCamera::setRangeDynamically() in room with bunny, time per call:\n");
+	RoomScene scene(bunnyMesh,bunnyCollider);
+	unsigned numRaysList[] = {0,1000,10000};
+	for (unsigned panorama=0;panorama<2;panorama++)
+	for (unsigned n=0;n<3;n++)
+	{
+		RRCamera camera(RRVec3(0.15f,0.15f,-0.15f),RRVec3(0.8f,0.2f,0),1,70,0.1f,100);
+		camera.panoramaMode = panorama ? RRCamera::PM_EQUIRECTANGULAR : RRCamera::PM_OFF;
+		unsigned numCalls = 0;
+		RRReporter::setFilter(true,0,false);
+		RRTime time;
+		do
+		{
+			camera.setRangeDynamically(scene.solver,false,numRaysList[n]);
+			numCalls++;
+		}
+		while (time.secondsPassed()<0.2f);
+		double ms = time.secondsPassed()*1000/numCalls;
+		RRReporter::setFilter(true,1,false);
+		bool ok = camera.getNear()>0 && camera.getNear()<camera.getFar();
+		RRReporter::report(ok?INF1:ERRO,"  %-15s %5d rays  %7.3f ms  near %.4f far %.3f\n",panorama?"equirectangular":"perspective",numRaysList[n],ms,camera.getNear(),camera.getFar());
+	}
+}
+
+void benchmarkCameraRays(RRMesh* bunnyMesh, const RRCollider* bunnyCollider)
+{
+	testEquality();
+	benchmarkRays();
+	benchmarkRange(bunnyMesh,bunnyCollider);
+}
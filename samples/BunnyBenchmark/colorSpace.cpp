@@ -0,0 +1,204 @@
+// --------------------------------------------------------------------------
+// BunnyBenchmark colorspace
+//
+// Checks array conversions of built-in color spaces (fast pow, SSE2 where available)
+// against conversion computed in double, over whole range of positive floats,
+// in SSE2 path (long arrays) and scalar path (arrays of 1 element).
+// Measures conversions per second of array and scalar versions.
+// --------------------------------------------------------------------------
+
+#include "BunnyBenchmark.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Documented limit, array conversions are within 0.0005% of scalar version.
+static const double MAX_RELATIVE_ERROR = 5e-6;
+
+// Linear to custom or back, reference computed in double.
+struct ColorSpaceConversion
+{
+	const char* name;
+	const RRColorSpace* colorSpace;
+	bool toLinear;
+	double (*reference)(double);
+
+	void convertArray(RRReal* data, size_t n) const
+	{
+		if (toLinear)
+			colorSpace->toLinear(data,n);
+		else
+			colorSpace->fromLinear(data,n);
+	}
+	void convertScalar(RRReal& a) const
+	{
+		if (toLinear)
+			colorSpace->toLinear(a);
+		else
+			colorSpace->fromLinear(a);
+	}
+};
+
+// exponents are rounded to float like in color spaces, difference would show up as error in results near FLT_MAX
+static double gammaEncode(double a) {return pow(a,(double)0.45f);}
+static double gammaDecode(double a) {return pow(a,(double)(1/0.45f));}
+static double sRGBEncode(double a) {return (a<=0.0031308) ? a*12.92 : 1.055*pow(a,(double)(1/2.4f))-0.055;}
+static double sRGBDecode(double a) {return (a<=0.04045) ? a/12.92 : pow((a+0.055)/1.055,(double)2.4f);}
+
+// Accuracy of converted values, results below FLT_MIN may be flushed to 0 or FLT_MIN, results above FLT_MAX may saturate.
+struct ConversionErrors
+{
+	double maxRelativeError;
+	float maxRelativeErrorInput;
+	unsigned long long numChecked;
+	unsigned long long numWrong; // wrong underflow, overflow, sign, NaN
+
+	ConversionErrors() : maxRelativeError(0), maxRelativeErrorInput(0), numChecked(0), numWrong(0) {}
+
+	void check(float input, float output, double reference)
+	{
+		numChecked++;
+		if (reference<FLT_MIN)
+			numWrong += !(output>=0 && output<=2*FLT_MIN);
+		else
+		if (reference>FLT_MAX)
+			numWrong += !(output>=FLT_MAX/2);
+		else
+		{
+			double relativeError = fabs(output-reference)/reference;
+			if (!(relativeError<=maxRelativeError)) // NaN goes here
+			{
+				maxRelativeError = relativeError;
+				maxRelativeErrorInput = input;
+			}
+		}
+	}
+};
+
+// Converts all positive floats (every STEP-th bit pattern) in long arrays and one by one, compares with reference.
+static void checkConversion(const ColorSpaceConversion& conversion)
+{
+	enum {CHUNK=1<<20, STEP=61, NUM_SCALARS=4096};
+	std::vector<float> inputs, outputs;
+	inputs.reserve(CHUNK);
+	ConversionErrors arrayErrors, scalarErrors;
+	unsigned numMirrorErrors = 0;
+	for (unsigned bits=0;bits<0x7f800000;)
+	{
+		inputs.clear();
+		for (;bits<0x7f800000 && inputs.size()<CHUNK;bits+=STEP)
+		{
+			float input;
+			memcpy(&input,&bits,4);
+			inputs.push_back(input);
+		}
+		outputs = inputs;
+		conversion.convertArray(outputs.data(),outputs.size());
+		for (size_t i=0;i<inputs.size();i++)
+			arrayErrors.check(inputs[i],outputs[i],conversion.reference(inputs[i]));
+
+		// the same inputs in arrays of 1 element go through scalar path
+		for (size_t i=0;i<inputs.size() && i<NUM_SCALARS;i++)
+		{
+			float output = inputs[i];
+			conversion.convertArray(&output,1);
+			scalarErrors.check(inputs[i],output,conversion.reference(inputs[i]));
+		}
+
+		// negative inputs are mirrored
+		std::vector<float> negated(inputs.begin(),inputs.begin()+RR_MIN(inputs.size(),(size_t)NUM_SCALARS));
+		for (size_t i=0;i<negated.size();i++)
+			negated[i] = -negated[i];
+		conversion.convertArray(negated.data(),negated.size());
+		for (size_t i=0;i<negated.size();i++)
+			numMirrorErrors += negated[i]!=-outputs[i];
+	}
+	bool ok = arrayErrors.maxRelativeError<=MAX_RELATIVE_ERROR && scalarErrors.maxRelativeError<=MAX_RELATIVE_ERROR
+		&& !arrayErrors.numWrong && !scalarErrors.numWrong && !numMirrorErrors;
+	RRReporter::report(ok?INF1:ERRO,"  %-14s array: max error %.2e (at %g) of %llu, wrong %llu   scalar: max error %.2e (at %g) of %llu, wrong %llu   mirror errors %d\n",
+		conversion.name,
+		arrayErrors.maxRelativeError,arrayErrors.maxRelativeErrorInput,arrayErrors.numChecked,arrayErrors.numWrong,
+		scalarErrors.maxRelativeError,scalarErrors.maxRelativeErrorInput,scalarErrors.numChecked,scalarErrors.numWrong,
+		numMirrorErrors);
+}
+
+// Converts the same values by array version, scalar version and by powf(), reports millions of conversions per second.
+static void benchmarkConversion(const ColorSpaceConversion& conversion)
+{
+	enum {NUM_VALUES=1<<22, NUM_REPEATS=4};
+	std::vector<float> values(NUM_VALUES);
+	for (unsigned i=0;i<NUM_VALUES;i++)
+		values[i] = 2.f*i/NUM_VALUES;
+	double seconds[3] = {1e10,1e10,1e10};
+	for (unsigned r=0;r<NUM_REPEATS;r++)
+	{
+		std::vector<float> converted = values;
+		RRTime time;
+		conversion.convertArray(converted.data(),converted.size());
+		seconds[0] = RR_MIN(seconds[0],time.secondsPassed());
+
+		converted = values;
+		time.setNow();
+		for (unsigned i=0;i<NUM_VALUES;i++)
+			conversion.convertScalar(converted[i]);
+		seconds[1] = RR_MIN(seconds[1],time.secondsPassed());
+
+		converted = values;
+		float exponent = (float)(conversion.toLinear ? 1/0.45 : 0.45);
+		time.setNow();
+		for (unsigned i=0;i<NUM_VALUES;i++)
+			converted[i] = powf(converted[i],exponent);
+		seconds[2] = RR_MIN(seconds[2],time.secondsPassed());
+	}
+	RRReporter::report(INF1,"  %-14s array %7.1f   scalar %7.1f   powf loop %7.1f  (millions per second)\n",
+		conversion.name,NUM_VALUES/seconds[0]/1e6,NUM_VALUES/seconds[1]/1e6,NUM_VALUES/seconds[2]/1e6);
+}
+
+// Checks that 8bit array conversion rounds like scalar conversion followed by RR_FLOAT2BYTE, within one level.
+static void checkByteConversion(const char* name, const RRColorSpace* colorSpace)
+{
+	enum {NUM_COLORS=100003};
+	std::vector<RRVec3> colors(NUM_COLORS);
+	for (unsigned i=0;i<NUM_COLORS;i++)
+		colors[i] = RRVec3(1.1f*i/NUM_COLORS,0.5f*i/NUM_COLORS,-0.1f*i/NUM_COLORS);
+	std::vector<unsigned char> bytes(NUM_COLORS*4);
+	colorSpace->fromLinear(colors.data(),bytes.data(),4,NUM_COLORS);
+	unsigned numDifferent = 0, numWrong = 0;
+	for (unsigned i=0;i<NUM_COLORS;i++)
+	{
+		RRVec3 color = colors[i];
+		colorSpace->fromLinear(color);
+		for (unsigned c=0;c<3;c++)
+		{
+			int difference = abs((int)RR_FLOAT2BYTE(color[c])-(int)bytes[i*4+c]);
+			numDifferent += difference!=0;
+			numWrong += difference>1;
+		}
+	}
+	RRReporter::report(numWrong?ERRO:INF1,"  %-14s 8bit: %d of %d channels rounded differently, %d differ by more than 1\n",name,numDifferent,NUM_COLORS*3,numWrong);
+}
+
+void benchmarkColorSpace()
+{
+	RRColorSpace* gamma = RRColorSpace::create_sRGB();
+	RRColorSpace* sRGB = RRColorSpace::create_sRGB_exact();
+	ColorSpaceConversion conversions[] =
+	{
+		{"gamma encode",gamma,false,gammaEncode},
+		{"gamma decode",gamma,true,gammaDecode},
+		{"sRGB encode",sRGB,false,sRGBEncode},
+		{"sRGB decode",sRGB,true,sRGBDecode},
+	};
+	RRReporter::report(INF1,"Color space array conversions vs reference in double, all positive floats (limit %.1e):\n",MAX_RELATIVE_ERROR);
+	for (unsigned i=0;i<4;i++)
+		checkConversion(conversions[i]);
+	checkByteConversion("gamma",gamma);
+	checkByteConversion("sRGB",sRGB);
+	RRReporter::report(INF1,"Color space conversion speed:\n");
+	for (unsigned i=0;i<4;i++)
+		benchmarkConversion(conversions[i]);
+	delete sRGB;
+	delete gamma;
+}
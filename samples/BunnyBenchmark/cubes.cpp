@@ -0,0 +1,102 @@
+// --------------------------------------------------------------------------
+// BunnyBenchmark cubes
+//
+// Updates hundreds of small environment maps in textured room with RRSolver::updateEnvironmentMap(),
+// from 1 to 64 threads at once. Checks that every cube matches cube updated serially, texel for texel,
+// and measures how updates scale with number of threads.
+// --------------------------------------------------------------------------
+
+#include "BunnyBenchmark.h"
+#include "Lightsprint/RRIllumination.h"
+#include <omp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+enum
+{
+	NUM_CUBES = 300,
+	CUBE_SIZE = 16,
+	LAYER_ENVIRONMENT = 0,
+};
+
+// Illuminations with cubes not yet updated, at random positions inside room.
+static std::vector<RRObjectIllumination*> createIlluminations()
+{
+	srand(1);
+	std::vector<RRObjectIllumination*> illuminations;
+	for (unsigned i=0;i<NUM_CUBES;i++)
+	{
+		RRObjectIllumination* illumination = new RRObjectIllumination;
+		illumination->getLayer(LAYER_ENVIRONMENT) = RRBuffer::create(BT_CUBE_TEXTURE,CUBE_SIZE,CUBE_SIZE,6,BF_RGBF,true,nullptr);
+		illumination->envMapWorldCenter = RRVec3(rand()*0.5f/RAND_MAX-0.25f,rand()*0.5f/RAND_MAX-0.15f,rand()*0.5f/RAND_MAX-0.25f);
+		illuminations.push_back(illumination);
+	}
+	return illuminations;
+}
+
+static void deleteIlluminations(std::vector<RRObjectIllumination*>& illuminations)
+{
+	for (unsigned i=0;i<illuminations.size();i++)
+		delete illuminations[i]; // deletes its layers
+	illuminations.clear();
+}
+
+// Updates all cubes, numThreads cubes at once. Returns seconds.
+static double updateCubes(RRSolver* solver, std::vector<RRObjectIllumination*>& illuminations, int numThreads)
+{
+	RRTime time;
+	unsigned numUpdated = 0;
+	#pragma omp parallel for schedule(dynamic) num_threads(numThreads) reduction(+:numUpdated)
+	for (int i=0;i<(int)illuminations.size();i++)
+		numUpdated += solver->updateEnvironmentMap(illuminations[i],LAYER_ENVIRONMENT,UINT_MAX,UINT_MAX);
+	double seconds = time.secondsPassed();
+	if (numUpdated!=illuminations.size())
+		RRReporter::report(ERRO,"  only %d/%d cubes updated\n",numUpdated,(unsigned)illuminations.size());
+	return seconds;
+}
+
+void benchmarkCubes(RRMesh* bunnyMesh, const RRCollider* bunnyCollider)
+{
+	RRReporter::report(INF1,"Environment maps %dx%dx6, %d at random positions in textured room:\n",CUBE_SIZE,CUBE_SIZE,NUM_CUBES);
+	RoomScene scene(bunnyMesh,bunnyCollider);
+	RRReporter::setFilter(true,0,false);
+	scene.solver->detectDirectIlluminationCPU(64);
+	scene.solver->calculate();
+	RRReporter::setFilter(true,1,false);
+
+	// reference, one cube at a time, each update parallel inside
+	std::vector<RRObjectIllumination*> reference = createIlluminations();
+	double serialSeconds = updateCubes(scene.solver,reference,1);
+	RRReporter::report(INF1,"  %2d cube at once   %7.3fs\n",1,serialSeconds);
+
+	// the same cubes updated concurrently, each update serial inside
+	bool nested = omp_get_nested()!=0;
+	omp_set_nested(0);
+	for (int numThreads=2;numThreads<=64;numThreads*=2)
+	{
+		std::vector<RRObjectIllumination*> illuminations = createIlluminations();
+		double seconds = updateCubes(scene.solver,illuminations,numThreads);
+		unsigned numDifferent = 0;
+		for (unsigned i=0;i<NUM_CUBES;i++)
+		{
+			RRBuffer* a = reference[i]->getLayer(LAYER_ENVIRONMENT);
+			RRBuffer* b = illuminations[i]->getLayer(LAYER_ENVIRONMENT);
+			if (memcmp(a->lock(BL_READ),b->lock(BL_READ),a->getBufferBytes()))
+				numDifferent++;
+			a->unlock();
+			b->unlock();
+		}
+		RRReporter::report(numDifferent?ERRO:INF1,"  %2d cubes at once  %7.3fs  speedup %.2fx  %d cubes differ from serial update\n",numThreads,seconds,serialSeconds/seconds,numDifferent);
+		deleteIlluminations(illuminations);
+	}
+	omp_set_nested(nested);
+
+	// cubes must not be black
+	RRVec3 sum(0);
+	for (unsigned i=0;i<NUM_CUBES;i++)
+		for (unsigned j=0;j<CUBE_SIZE*CUBE_SIZE*6;j++)
+			sum += reference[i]->getLayer(LAYER_ENVIRONMENT)->getElement(j,nullptr);
+	RRReporter::report((sum.sum()>0)?INF1:ERRO,"  average texel %f %f %f\n",sum.x/(NUM_CUBES*CUBE_SIZE*CUBE_SIZE*6),sum.y/(NUM_CUBES*CUBE_SIZE*CUBE_SIZE*6),sum.z/(NUM_CUBES*CUBE_SIZE*CUBE_SIZE*6));
+	deleteIlluminations(reference);
+}
@@ -0,0 +1,303 @@
+// --------------------------------------------------------------------------
+// BunnyBenchmark culling
+//
+// RRObjectBVH culls synthetic city of box buildings on ground plane
+// for cameras in streets and above roofs.
+// Checks that culling is conservative: no object hit by primary ray
+// (traced through multiobject of whole city) is culled, with frustum culling only
+// and with occlusion culling.
+// Checks that update() follows objects that move, get their first triangles or lose all of them.
+// Measures time of cull() and update(), compares with frustum test of each object's box.
+// --------------------------------------------------------------------------
+
+#include "BunnyBenchmark.h"
+#include "Lightsprint/RRCamera.h"
+#include <algorithm>
+#include <climits>
+#include <stdlib.h>
+#include <vector>
+
+// Fills mesh with cube -1..1 with triangles facing out, or with nothing.
+static void makeBox(RRMeshArrays* mesh, bool empty)
+{
+	mesh->resizeMesh(empty?0:12,empty?0:8,nullptr,false,false);
+	mesh->version++;
+	if (empty)
+		return;
+	for (unsigned v=0;v<8;v++)
+	{
+		mesh->position[v] = RRVec3((v&1)?1.f:-1.f,(v&2)?1.f:-1.f,(v&4)?1.f:-1.f);
+		mesh->normal[v] = mesh->position[v].normalized();
+	}
+	static const unsigned quads[6][4] = {{0,2,3,1},{4,5,7,6},{0,1,5,4},{2,6,7,3},{0,4,6,2},{1,3,7,5}};
+	for (unsigned q=0;q<6;q++)
+		for (unsigned t=0;t<2;t++)
+		{
+			unsigned a = quads[q][0], b = quads[q][t+1], c = quads[q][t+2];
+			const RRVec3* position = mesh->position;
+			if ((position[b]-position[a]).cross(position[c]-position[a]).dot(position[a]+position[b]+position[c])<0)
+				std::swap(b,c);
+			mesh->triangle[2*q+t] = RRMeshArrays::Triangle{a,b,c};
+		}
+}
+
+// Objects sharing one opaque material, each with its own mesh and collider.
+struct BoxScene
+{
+	RRMaterial material;
+	RRObjects objects;
+
+	BoxScene()
+	{
+		material.reset(false);
+	}
+	RRObject* addBox(const RRVec3& center, const RRVec3& halfSize)
+	{
+		bool aborting = false;
+		RRMeshArrays* mesh = new RRMeshArrays;
+		makeBox(mesh,false);
+		RRObject* object = new RRObject;
+		object->setCollider(RRCollider::create(mesh,nullptr,RRCollider::IT_LINEAR,aborting));
+		object->faceGroups.push_back(RRObject::FaceGroup(&material,12));
+		RRMatrix3x4 matrix = RRMatrix3x4::translation(center)*RRMatrix3x4::scale(halfSize);
+		object->setWorldMatrix(&matrix);
+		objects.push_back(object);
+		return object;
+	}
+	static RRMeshArrays* getMesh(RRObject* object)
+	{
+		return const_cast<RRMeshArrays*>(static_cast<const RRMeshArrays*>(object->getCollider()->getMesh()));
+	}
+	~BoxScene()
+	{
+		for (unsigned i=0;i<objects.size();i++)
+		{
+			delete objects[i]->getCollider()->getMesh();
+			delete objects[i]->getCollider();
+			delete objects[i];
+		}
+	}
+};
+
+static void reportCheck(bool ok, const char* what)
+{
+	RRReporter::report(ok?INF1:ERRO,"  %-60s %s\n",what,ok?"ok":"FAILED");
+}
+
+// Small scenes where correct result is known.
+static void testObjectBVH()
+{
+	RRReporter::report(INF1,"RRObjectBVH update and cull:\n");
+	BoxScene scene;
+	scene.addBox(RRVec3(0,0,-10),RRVec3(10,10,0.5f));
+	scene.addBox(RRVec3(5,-5,-20),RRVec3(1)); // away from wall's diagonal, texels along edges shared by two triangles are not written to occlusion buffer
+	scene.addBox(RRVec3(-2,0,-5),RRVec3(1));
+	RRObject* behindCamera = scene.addBox(RRVec3(0,0,5),RRVec3(1));
+	RRObject* changing = scene.addBox(RRVec3(2,0,-5),RRVec3(1));
+	enum {WALL,BEHIND_WALL,IN_FRONT,BEHIND_CAMERA,CHANGING};
+	RRCamera camera(RRVec3(0),RRVec3(0),1,60,0.1f,100);
+	camera.setDirection(RRVec3(0,0,-1));
+	RRVector<bool> visible, visibleOcclusion;
+
+	makeBox(BoxScene::getMesh(changing),true);
+	RRObjectBVH* bvh = RRObjectBVH::create(scene.objects);
+	bvh->cull(camera,0,visible);
+	bvh->cull(camera,256,visibleOcclusion);
+	reportCheck(visible.size()==5 && visible[WALL] && visible[BEHIND_WALL] && visible[IN_FRONT] && !visible[BEHIND_CAMERA],"frustum culling");
+	reportCheck(visibleOcclusion[WALL] && !visibleOcclusion[BEHIND_WALL] && visibleOcclusion[IN_FRONT],"occlusion culling");
+	reportCheck(!visible[CHANGING],"object without triangles is culled");
+
+	makeBox(BoxScene::getMesh(changing),false);
+	bvh->update(scene.objects);
+	bvh->cull(camera,0,visible);
+	reportCheck(visible[CHANGING],"object that got triangles is visible");
+
+	RRMatrix3x4 away = RRMatrix3x4::translation(RRVec3(1000,0,0));
+	changing->setWorldMatrix(&away);
+	bvh->update(scene.objects);
+	bvh->cull(camera,0,visible);
+	reportCheck(!visible[CHANGING],"object moved out of view is culled");
+
+	RRMatrix3x4 back = RRMatrix3x4::translation(RRVec3(2,0,-5));
+	changing->setWorldMatrix(&back);
+	bvh->update(scene.objects);
+	bvh->cull(camera,0,visible);
+	reportCheck(visible[CHANGING],"object moved back is visible");
+
+	makeBox(BoxScene::getMesh(changing),true);
+	bvh->update(scene.objects);
+	bvh->cull(camera,0,visible);
+	reportCheck(!visible[CHANGING] && visible[IN_FRONT],"object that lost triangles is culled");
+
+	makeBox(BoxScene::getMesh(changing),false);
+	RRObjects fewer;
+	fewer.push_back(changing);
+	fewer.push_back(behindCamera);
+	bvh->update(fewer);
+	bvh->cull(camera,0,visible);
+	reportCheck(visible.size()==2 && visible[0] && !visible[1],"collection changed");
+
+	RRCamera panorama(camera);
+	panorama.panoramaMode = RRCamera::PM_EQUIRECTANGULAR;
+	bvh->cull(panorama,0,visible);
+	reportCheck(visible[0] && visible[1],"panorama camera does not cull");
+	delete bvh;
+}
+
+// Grid of buildings with random heights, streets between them, ground plane under all.
+struct City : public BoxScene
+{
+	enum {SIZE=64, BLOCK=3}; // buildings in row, distance of building centers (building is 2 wide, street 1)
+
+	City()
+	{
+		srand(1);
+		addBox(RRVec3(SIZE*BLOCK*0.5f,-0.5f,SIZE*BLOCK*0.5f),RRVec3(SIZE*BLOCK*0.5f+10,0.5f,SIZE*BLOCK*0.5f+10));
+		for (unsigned i=0;i<SIZE;i++)
+			for (unsigned j=0;j<SIZE;j++)
+			{
+				RRReal height = 2+rand()%20;
+				addBox(RRVec3(i*BLOCK+1.5f,height/2,j*BLOCK+1.5f),RRVec3(1,height/2,1));
+			}
+	}
+};
+
+// Casts ray through each pixel, returns indices of objects hit.
+static std::vector<unsigned> getObjectsHitByRays(const RRObject* multiObject, const RRCamera& camera, unsigned width, unsigned height)
+{
+	std::vector<unsigned> result;
+	const RRMesh* multiMesh = multiObject->getCollider()->getMesh();
+	std::vector<unsigned> objects(width*height,UINT_MAX);
+	#pragma omp parallel for schedule(dynamic)
+	for (int y=0;y<(int)height;y++)
+	{
+		RRRay ray;
+		ray.rayFlags = RRRay::FILL_TRIANGLE|RRRay::FILL_DISTANCE;
+		for (unsigned x=0;x<width;x++)
+		{
+			RRVec3 dir;
+			camera.getRay(RRVec2((x+0.5f)/width*2-1,(y+0.5f)/height*2-1),ray.rayOrigin,dir);
+			ray.rayDir = dir.normalized();
+			ray.rayLengthMin = camera.getNear()*dir.length();
+			ray.rayLengthMax = camera.getFar()*dir.length();
+			if (multiObject->getCollider()->intersect(ray))
+				objects[y*width+x] = multiMesh->getPreImportTriangle(ray.hitTriangle).object;
+		}
+	}
+	std::sort(objects.begin(),objects.end());
+	for (size_t i=0;i<objects.size();i++)
+		if (objects[i]!=UINT_MAX && (result.empty() || result.back()!=objects[i]))
+			result.push_back(objects[i]);
+	return result;
+}
+
+// Frustum test of each object's box, baseline for cull() without hierarchy.
+static unsigned cullBruteForce(const RRObjects& objects, const RRCamera& camera, RRVector<bool>& visible)
+{
+	visible.resize(objects.size());
+	unsigned numVisible = 0;
+	for (unsigned i=0;i<objects.size();i++)
+	{
+		RRVec3 mini,maxi;
+		objects[i]->getCollider()->getMesh()->getAABB(&mini,&maxi,nullptr);
+		const RRMatrix3x4* matrix = objects[i]->getWorldMatrix();
+		unsigned outside[6] = {0,0,0,0,0,0}; // number of corners outside each clip plane
+		for (unsigned c=0;c<8;c++)
+		{
+			RRVec3 corner((c&1)?maxi.x:mini.x,(c&2)?maxi.y:mini.y,(c&4)?maxi.z:mini.z);
+			if (matrix)
+				matrix->transformPosition(corner);
+			RRVec4 clip = camera.getPositionInClipSpace(corner);
+			for (unsigned a=0;a<3;a++)
+			{
+				outside[2*a] += clip[a]<-clip.w;
+				outside[2*a+1] += clip[a]>clip.w;
+			}
+		}
+		visible[i] = true;
+		for (unsigned p=0;p<6;p++)
+			if (outside[p]==8)
+				visible[i] = false;
+		numVisible += visible[i];
+	}
+	return numVisible;
+}
+
+void benchmarkCulling()
+{
+	testObjectBVH();
+
+	enum {NUM_STREET_CAMERAS=20, NUM_AERIAL_CAMERAS=4, RAYS_WIDTH=320, RAYS_HEIGHT=180, OCCLUSION_RESOLUTION=256, NUM_REPEATS=5};
+	City city;
+	RRReporter::report(INF1,"Culling city of %d buildings (frustum, frustum+occlusion %d, rays %dx%d):\n",(int)city.objects.size()-1,OCCLUSION_RESOLUTION,RAYS_WIDTH,RAYS_HEIGHT);
+	bool aborting = false;
+	RRReporter::setFilter(true,0,false);
+	RRObject* multiObject = city.objects.createMultiObject(RRCollider::IT_BVH_FAST,aborting,-1,-1,false,0,nullptr);
+	RRReporter::setFilter(true,1,false);
+
+	RRTime time;
+	RRObjectBVH* bvh = RRObjectBVH::create(city.objects);
+	double buildSeconds = time.secondsPassed();
+
+	// cameras at eye level in streets looking along street or diagonally, and above city looking down
+	std::vector<RRCamera> cameras;
+	for (unsigned i=0;i<NUM_STREET_CAMERAS+NUM_AERIAL_CAMERAS;i++)
+	{
+		bool aerial = i>=NUM_STREET_CAMERAS;
+		RRVec3 position = aerial
+			? RRVec3(rand()%(City::SIZE*City::BLOCK),60,rand()%(City::SIZE*City::BLOCK))
+			: RRVec3((rand()%City::SIZE)*City::BLOCK,1.7f,rand()%(City::SIZE*City::BLOCK));
+		RRVec3 yawPitchRoll(rand()*RR_PI*2/RAND_MAX,aerial?-0.8f:0.f,0);
+		cameras.push_back(RRCamera(position,yawPitchRoll,16.f/9,60,0.1f,1000));
+	}
+
+	unsigned sumVisible[3] = {0,0,0}, sumHit = 0, notVisible[2] = {0,0};
+	double cullSeconds[3] = {0,0,0};
+	for (unsigned c=0;c<cameras.size();c++)
+	{
+		RRVector<bool> visible[3]; // frustum, frustum+occlusion, brute force frustum
+		for (unsigned method=0;method<3;method++)
+		{
+			double seconds = 1e10;
+			for (unsigned r=0;r<NUM_REPEATS;r++)
+			{
+				time.setNow();
+				sumVisible[method] += (r==0) * ((method<2)
+					? bvh->cull(cameras[c],method?OCCLUSION_RESOLUTION:0,visible[method])
+					: cullBruteForce(city.objects,cameras[c],visible[method]));
+				seconds = RR_MIN(seconds,time.secondsPassed());
+			}
+			cullSeconds[method] += seconds;
+		}
+		std::vector<unsigned> hit = getObjectsHitByRays(multiObject,cameras[c],RAYS_WIDTH,RAYS_HEIGHT);
+		sumHit += (unsigned)hit.size();
+		for (size_t i=0;i<hit.size();i++)
+			for (unsigned method=0;method<2;method++)
+				notVisible[method] += !visible[method][hit[i]];
+	}
+	unsigned numCameras = (unsigned)cameras.size();
+	RRReporter::report(INF1,"  build %.2fms\n",buildSeconds*1000);
+	const char* names[3] = {"frustum","frustum+occlusion","frustum, no hierarchy"};
+	for (unsigned method=0;method<3;method++)
+		RRReporter::report(INF1,"  %-22s %8.3fms per cull, %6.1f objects visible\n",names[method],cullSeconds[method]*1000/numCameras,(float)sumVisible[method]/numCameras);
+	RRReporter::report(INF1,"  %-22s %6.1f objects hit\n","rays",(float)sumHit/numCameras);
+	for (unsigned method=0;method<2;method++)
+		RRReporter::report(notVisible[method]?ERRO:INF1,"  %-22s culled %d objects hit by rays\n",names[method],notVisible[method]);
+
+	// update after 10% of buildings move a bit (refit) and without change
+	for (unsigned i=1;i<city.objects.size();i+=10)
+	{
+		RRMatrix3x4 matrix = *city.objects[i]->getWorldMatrix();
+		matrix.m[0][3] += 0.1f;
+		city.objects[i]->setWorldMatrix(&matrix);
+	}
+	time.setNow();
+	bvh->update(city.objects);
+	double refitSeconds = time.secondsPassed();
+	time.setNow();
+	bvh->update(city.objects);
+	RRReporter::report(INF1,"  update %.2fms after 10%% of objects moved, %.2fms without change\n",refitSeconds*1000,time.secondsPassed()*1000);
+
+	delete bvh;
+	delete multiObject;
+}
@@ -0,0 +1,182 @@
+// --------------------------------------------------------------------------
+// BunnyBenchmark direct
+//
+// Compares RRSolver::detectDirectIlluminationCPU() with reference computed here
+// by brute force from public RRLight API: many random points per triangle,
+// random points of area light, shadow ray from each.
+// Room with bunny is lit by spot light and spherical area light, results are compared
+// after first detection, after disabling, moving and enabling lights and in sRGB.
+// --------------------------------------------------------------------------
+
+#include "BunnyBenchmark.h"
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+// Accepts all hits except receiver triangle, shadow rays start on it.
+class SkipTriangle : public RRCollisionHandler
+{
+public:
+	unsigned skippedTriangle;
+	bool hit;
+	virtual void init(RRRay& ray) override {hit = false;}
+	virtual bool collides(const RRRay& ray) override {return hit |= ray.hitTriangle!=skippedTriangle;}
+	virtual bool done() override {return hit;}
+};
+
+// Reference direct irradiance from one light on one triangle, in physical scale.
+// Positions are jittered in samplesPerSide^2 cells of triangle, light is sampled randomly.
+static RRVec3 getReferenceIrradiance(const RRLight* light, unsigned t, const RRObject* multiObject, const RRColorSpace* colorSpace, unsigned samplesPerSide)
+{
+	RRMesh::TriangleBody body;
+	multiObject->getCollider()->getMesh()->getTriangleBody(t,body);
+	RRVec3 normal = body.side1.cross(body.side2).normalized();
+	SkipTriangle skipTriangle;
+	skipTriangle.skippedTriangle = t;
+	RRRay ray;
+	ray.rayFlags = RRRay::FILL_TRIANGLE|RRRay::FILL_DISTANCE;
+	ray.rayLengthMin = 1e-6f;
+	ray.collisionHandler = &skipTriangle;
+	RRVec3 sum(0);
+	for (unsigned k=0;k<samplesPerSide*samplesPerSide;k++)
+	{
+		RRReal u = (k/samplesPerSide+rand()/(RAND_MAX+1.f))/samplesPerSide;
+		RRReal v = (k%samplesPerSide+rand()/(RAND_MAX+1.f))/samplesPerSide;
+		if (u+v>1)
+		{
+			u = 1-u;
+			v = 1-v;
+		}
+		RRVec2 lightSample(rand()/(RAND_MAX+1.f),rand()/(RAND_MAX+1.f));
+		ray.rayOrigin = body.vertex0+body.side1*u+body.side2*v;
+		RRVec3 irradiance = light->getIrradianceSample(ray.rayOrigin,lightSample,colorSpace,ray.rayDir,ray.rayLengthMax);
+		RRReal cosine = ray.rayDir.dot(normal);
+		if (cosine<=0 || irradiance==RRVec3(0))
+			continue;
+		if (light->castShadows && multiObject->getCollider()->intersect(ray))
+			continue;
+		if (colorSpace && light->directLambertScaled)
+			colorSpace->toLinear(cosine);
+		sum += irradiance*cosine;
+	}
+	return sum/(samplesPerSide*samplesPerSide);
+}
+
+struct DirectIlluminationTest
+{
+	RoomScene& scene;
+	std::vector<unsigned> triangles; // triangles compared, all room triangles and sparse subset of bunny
+	std::vector<std::vector<RRVec3> > reference; // [light][i] irradiance of triangles[i] in physical scale
+
+	DirectIlluminationTest(RoomScene& _scene) : scene(_scene)
+	{
+		unsigned numRoomTriangles = scene.room->getCollider()->getMesh()->getNumTriangles();
+		unsigned numTriangles = scene.solver->getMultiObject()->getCollider()->getMesh()->getNumTriangles();
+		for (unsigned t=0;t<numTriangles;t+=(t<numRoomTriangles)?1:16)
+			triangles.push_back(t);
+		reference.resize(scene.lights.size());
+	}
+
+	// Calculates reference for one light, large room triangles get more samples.
+	void updateReference(unsigned l)
+	{
+		srand(l+1);
+		unsigned numRoomTriangles = scene.room->getCollider()->getMesh()->getNumTriangles();
+		reference[l].resize(triangles.size());
+		for (unsigned i=0;i<triangles.size();i++)
+			reference[l][i] = getReferenceIrradiance(scene.lights[l],triangles[i],scene.solver->getMultiObject(),scene.solver->getColorSpace(),(triangles[i]<numRoomTriangles)?64:16);
+	}
+
+	// Runs detection and compares its result with reference of enabled lights, in 8bit custom scale of setDirectIllumination().
+	void detectAndCompare(const char* name, bool expectChange)
+	{
+		RRTime time;
+		bool changed = scene.solver->detectDirectIlluminationCPU(64);
+		double seconds = time.secondsPassed();
+		const unsigned* rgba = scene.solver->getDirectIllumination();
+		if (changed!=expectChange || !rgba)
+		{
+			RRReporter::report(ERRO,"  %-24s detectDirectIlluminationCPU() returned %s\n",name,changed?"true":"false");
+			return;
+		}
+		const RRColorSpace* colorSpace = scene.solver->getColorSpace();
+		std::vector<float> errors;
+		double sumOfErrors = 0;
+		for (unsigned i=0;i<triangles.size();i++)
+		{
+			RRVec3 irradiance(0);
+			for (unsigned l=0;l<scene.lights.size();l++)
+				if (scene.lights[l]->enabled)
+					irradiance += reference[l][i];
+			if (colorSpace)
+				colorSpace->fromLinear(irradiance);
+			for (unsigned c=0;c<3;c++)
+			{
+				float error = fabsf(RR_CLAMPED(irradiance[c]*255,0,255)-((rgba[triangles[i]]>>(8*c))&255));
+				errors.push_back(error);
+				sumOfErrors += error;
+			}
+		}
+		std::sort(errors.begin(),errors.end());
+		double meanError = sumOfErrors/errors.size();
+		float error99 = errors[errors.size()*99/100];
+		bool ok = meanError<MAX_MEAN_ERROR && error99<MAX_ERROR_99;
+		RRReporter::report(ok?INF1:ERRO,"  %-24s %7.3fs  error (in 1/255) mean %.2f  99%% %.1f  max %.1f\n",name,seconds,meanError,error99,errors.back());
+	}
+
+	// Tolerances. Detection takes 64 stratified samples per triangle, small triangles crossed by shadow edge
+	// differ by up to 10%, mean and all but 1% of triangles must be close.
+	static constexpr double MAX_MEAN_ERROR = 0.5;
+	static constexpr float MAX_ERROR_99 = 4;
+};
+
+// Checks detectDirectIlluminationCPU() against reference, measures time of full and partial updates.
+void benchmarkDirectIllumination(RRMesh* bunnyMesh, const RRCollider* bunnyCollider)
+{
+	RRReporter::report(INF1,"Direct illumination detected on CPU vs reference:\n");
+	RoomScene scene(bunnyMesh,bunnyCollider);
+	delete scene.lights[0];
+	scene.lights.clear();
+	scene.lights.push_back(RRLight::createSpotLight(RRVec3(0,0.38f,0),RRVec3(0.2f,0.15f,0.1f),RRVec3(0,-1,0),0.8f,0.3f));
+	scene.lights.push_back(RRLight::createPointLight(RRVec3(-0.1f,0.25f,0.15f),RRVec3(0.005f,0.01f,0.01f)));
+	scene.lights[1]->areaType = RRLight::AREA_SPHERE;
+	scene.lights[1]->areaSize = RRVec2(0.04f);
+	scene.solver->setLights(scene.lights);
+
+	DirectIlluminationTest test(scene);
+	for (unsigned l=0;l<scene.lights.size();l++)
+		test.updateReference(l);
+	test.detectAndCompare("all lights",true);
+	test.detectAndCompare("nothing changed",false);
+
+	// disabled light must not contribute, light changed while disabled must be recalculated when enabled
+	scene.lights[1]->enabled = false;
+	test.detectAndCompare("area light disabled",true);
+	scene.lights[1]->position = RRVec3(0.15f,0.2f,-0.1f);
+	scene.solver->reportDirectIlluminationChange(1,true,true,false);
+	test.detectAndCompare("area light moved",false);
+	scene.lights[1]->enabled = true;
+	test.updateReference(1);
+	test.detectAndCompare("area light enabled",true);
+
+	// only moved light is recalculated
+	scene.lights[0]->position = RRVec3(-0.15f,0.38f,0.1f);
+	scene.lights[0]->direction = RRVec3(0.3f,-1,0).normalized();
+	scene.solver->reportDirectIlluminationChange(0,true,true,false);
+	test.updateReference(0);
+	test.detectAndCompare("spot light moved",true);
+
+	// colorSpace change recalculates all lights
+	RRColorSpace* sRGB = RRColorSpace::create_sRGB();
+	scene.solver->setColorSpace(sRGB);
+	for (unsigned l=0;l<scene.lights.size();l++)
+		test.updateReference(l);
+	test.detectAndCompare("sRGB",true);
+	scene.solver->setColorSpace(nullptr);
+	delete sRGB;
+
+	// RoomScene deletes lights[0]
+	scene.solver->setLights(RRLights());
+	delete scene.lights[1];
+}
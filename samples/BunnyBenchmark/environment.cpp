@@ -0,0 +1,288 @@
+// --------------------------------------------------------------------------
+// BunnyBenchmark environment
+//
+// Checks that blend of two rotated environments created by RRBuffer::createEnvironmentBlend(),
+// once its cube map cache is baked, stays close to direct evaluation of both environments, in linear and sRGB.
+// Checks that RRSolver::setColorSpace() drops cache baked for previous state of the same color space.
+// Measures lookups per second of both and time of sky-lit lightmap bakes with and without cache.
+// --------------------------------------------------------------------------
+
+#include "BunnyBenchmark.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+enum
+{
+	NUM_DIRECTIONS = 1000000,
+	FLOOR_QUADS = 16,
+	LIGHTMAP_SIZE = 64,
+	DEFAULT_CACHE_SIZE = 512, // see RRBuffer::setEnvironmentBlendCacheSize()
+};
+
+const RRReal MAX_AVERAGE_ERROR = 0.01f; // average relative error of lookup
+const RRReal MAX_SUM_ERROR = 0.001f; // relative error of sum of all lookups
+
+// Color space with gamma that can be changed later.
+class GammaColorSpace : public RRColorSpace
+{
+public:
+	RRReal gamma;
+
+	GammaColorSpace(RRReal _gamma) : gamma(_gamma) {}
+	virtual void fromLinear(RRReal& intensity) const override {intensity = (intensity>0) ? pow(intensity,1/gamma) : 0;}
+	virtual void fromLinear(RRVec3& color) const override {for (unsigned i=0;i<3;i++) fromLinear(color[i]);}
+	virtual void toLinear(RRReal& intensity) const override {intensity = (intensity>0) ? pow(intensity,gamma) : 0;}
+	virtual void toLinear(RRVec3& color) const override {for (unsigned i=0;i<3;i++) toLinear(color[i]);}
+	virtual RRVec3 getLinear(const unsigned char color[3]) const override {RRVec3 c(color[0]/255.f,color[1]/255.f,color[2]/255.f); toLinear(c); return c;}
+};
+
+// Float equirectangular sky with horizon gradient, sun and clouds.
+static RRBuffer* createEquirectangularSky()
+{
+	enum {W=1024, H=512};
+	RRBuffer* sky = RRBuffer::create(BT_2D_TEXTURE,W,H,1,BF_RGBF,false,nullptr);
+	for (unsigned j=0;j<H;j++)
+		for (unsigned i=0;i<W;i++)
+		{
+			RRReal elevation = (j+0.5f)/H-0.5f; // -0.5..0.5
+			RRVec3 color = (elevation>0) ? RRVec3(0.3f,0.5f,1)*(0.5f+elevation) : RRVec3(0.2f,0.15f,0.1f);
+			RRReal dx = (RRReal)i-W/3, dy = (RRReal)j-H*3/4;
+			if (dx*dx+dy*dy<100)
+				color = RRVec3(20,18,15); // sun
+			if (elevation>0.1f)
+				color += RRVec3(0.5f)*RR_MAX(0,sin(i*0.05f)*sin(j*0.09f)); // clouds
+			sky->setElement(j*W+i,RRVec4(color,1),nullptr);
+		}
+	return sky;
+}
+
+// Byte cube sky in custom color space, smooth colors with sharp edges between faces.
+static RRBuffer* createCubeSky()
+{
+	enum {SIZE=128};
+	RRBuffer* sky = RRBuffer::create(BT_CUBE_TEXTURE,SIZE,SIZE,6,BF_RGB,true,nullptr);
+	for (unsigned side=0;side<6;side++)
+		for (unsigned j=0;j<SIZE;j++)
+			for (unsigned i=0;i<SIZE;i++)
+			{
+				RRVec3 color((side&1)?0.9f:0.3f,(side&2)?0.8f:0.2f,(side&4)?0.7f:0.4f);
+				color *= 0.6f+0.4f*sin(i*0.1f)*cos(j*0.07f);
+				sky->setElement((side*SIZE+j)*SIZE+i,RRVec4(color,1),nullptr);
+			}
+	return sky;
+}
+
+static std::vector<RRVec3> createDirections()
+{
+	std::vector<RRVec3> directions(NUM_DIRECTIONS);
+	srand(2);
+	for (unsigned i=0;i<NUM_DIRECTIONS;i++)
+	{
+		do directions[i] = RRVec3(rand()/(RRReal)RAND_MAX-0.5f,rand()/(RRReal)RAND_MAX-0.5f,rand()/(RRReal)RAND_MAX-0.5f);
+		while (directions[i].length2()>0.25f || directions[i].length2()<0.0001f);
+		directions[i].normalize();
+	}
+	return directions;
+}
+
+// Returns seconds.
+static double lookup(const RRBuffer* blend, const std::vector<RRVec3>& directions, const RRColorSpace* colorSpace, std::vector<RRVec3>& colors)
+{
+	colors.resize(directions.size());
+	RRTime time;
+	for (unsigned i=0;i<directions.size();i++)
+		colors[i] = blend->getElementAtDirection(directions[i],colorSpace);
+	return time.secondsPassed();
+}
+
+static void testLookups(RRBuffer* sky0, RRBuffer* sky1)
+{
+	RRReporter::report(INF1,"Environment blend, cached vs direct lookups, %d random directions:\n",NUM_DIRECTIONS);
+	std::vector<RRVec3> directions = createDirections();
+	RRColorSpace* sRGB = RRColorSpace::create_sRGB();
+	for (unsigned c=0;c<2;c++)
+	{
+		const RRColorSpace* colorSpace = c ? sRGB : nullptr;
+		std::vector<RRVec3> direct, cached;
+		RRBuffer::setEnvironmentBlendCacheSize(0);
+		RRBuffer* directBlend = RRBuffer::createEnvironmentBlend(sky0,sky1,0.7f,2.1f,0.35f);
+		double directSeconds = lookup(directBlend,directions,colorSpace,direct);
+		RRBuffer::setEnvironmentBlendCacheSize(DEFAULT_CACHE_SIZE);
+		RRBuffer* cachedBlend = RRBuffer::createEnvironmentBlend(sky0,sky1,0.7f,2.1f,0.35f);
+		lookup(cachedBlend,directions,colorSpace,cached); // bakes cache
+		double cachedSeconds = lookup(cachedBlend,directions,colorSpace,cached);
+
+		double sumError = 0, sumDirect = 0, sumCached = 0;
+		for (unsigned i=0;i<NUM_DIRECTIONS;i++)
+		{
+			sumError += (cached[i]-direct[i]).abs().sum()/RR_MAX(direct[i].sum(),1e-6f);
+			sumDirect += direct[i].sum();
+			sumCached += cached[i].sum();
+		}
+		double averageError = sumError/NUM_DIRECTIONS;
+		double totalError = fabs(sumCached-sumDirect)/sumDirect;
+		bool ok = averageError<MAX_AVERAGE_ERROR && totalError<MAX_SUM_ERROR;
+		RRReporter::report(ok?INF1:ERRO,"  %-6s  average error %.3f%%  error of sum %.4f%%  direct %5.1f M/s  cached %5.1f M/s  %.1fx\n",
+			c?"sRGB":"linear",averageError*100,totalError*100,NUM_DIRECTIONS/directSeconds*1e-6,NUM_DIRECTIONS/cachedSeconds*1e-6,directSeconds/cachedSeconds);
+		delete cachedBlend;
+		delete directBlend;
+	}
+	delete sRGB;
+}
+
+// Floor under open sky.
+struct SkyScene
+{
+	RRMeshArrays* mesh;
+	RRObject* floor;
+	RRMaterial* material;
+	RRObjects objects;
+	RRSolver* solver;
+
+	SkyScene(RRBuffer* sky0, RRBuffer* sky1)
+	{
+		mesh = new RRMeshArrays;
+		RRVector<unsigned> texcoords;
+		texcoords.push_back(0);
+		mesh->resizeMesh(FLOOR_QUADS*FLOOR_QUADS*2,(FLOOR_QUADS+1)*(FLOOR_QUADS+1),&texcoords,false,false);
+		for (unsigned i=0;i<=FLOOR_QUADS;i++)
+			for (unsigned j=0;j<=FLOOR_QUADS;j++)
+			{
+				unsigned v = i*(FLOOR_QUADS+1)+j;
+				mesh->position[v] = RRVec3((RRReal)i/FLOOR_QUADS-0.5f,0,(RRReal)j/FLOOR_QUADS-0.5f);
+				mesh->normal[v] = RRVec3(0,1,0);
+				mesh->texcoord[0][v] = RRVec2((RRReal)i/FLOOR_QUADS,(RRReal)j/FLOOR_QUADS);
+			}
+		unsigned t = 0;
+		for (unsigned i=0;i<FLOOR_QUADS;i++)
+			for (unsigned j=0;j<FLOOR_QUADS;j++)
+			{
+				unsigned a = i*(FLOOR_QUADS+1)+j, b = a+1, c = a+FLOOR_QUADS+1, d = c+1;
+				mesh->triangle[t++] = RRMeshArrays::Triangle{a,b,c};
+				mesh->triangle[t++] = RRMeshArrays::Triangle{b,d,c};
+			}
+		bool aborting = false;
+		floor = new RRObject;
+		floor->setCollider(RRCollider::create(mesh,nullptr,RRCollider::IT_BVH_FAST,aborting));
+		material = new RRMaterial;
+		material->reset(false);
+		material->lightmap.texcoord = 0;
+		floor->faceGroups.push_back(RRObject::FaceGroup(material,t));
+		objects.push_back(floor);
+		RRReporter::setFilter(true,0,false);
+		solver = new RRSolver;
+		solver->setStaticObjects(objects,nullptr);
+		solver->setEnvironment(sky0,sky1,0.7f,2.1f);
+		solver->setEnvironmentBlendFactor(0.35f);
+		RRReporter::setFilter(true,1,false);
+	}
+
+	// Bakes sky illumination into buffer, returns seconds.
+	double bake(RRBuffer* buffer, unsigned quality)
+	{
+		RRSolver::UpdateParameters params(quality);
+		params.indirect.lightMultiplier = 0; // sky reaches final gather via indirect.environmentMultiplier
+		params.indirect.materialEmittanceMultiplier = 0;
+		params.randomSeed = 1;
+		RRReporter::setFilter(true,0,false);
+		RRTime time;
+		solver->updateLightmap(0,buffer,nullptr,nullptr,&params);
+		double seconds = time.secondsPassed();
+		RRReporter::setFilter(true,1,false);
+		return seconds;
+	}
+
+	~SkyScene()
+	{
+		delete solver; // releases skies
+		delete material;
+		delete floor->getCollider();
+		delete floor;
+		delete mesh;
+	}
+};
+
+// Returns average relative difference of buffers.
+static RRReal getDifference(const RRBuffer* a, const RRBuffer* b)
+{
+	RRReal sum = 0;
+	for (unsigned i=0;i<a->getNumElements();i++)
+	{
+		RRVec3 ea = a->getElement(i,nullptr);
+		RRVec3 eb = b->getElement(i,nullptr);
+		sum += (ea-eb).abs().sum()/RR_MAX(eb.sum(),1e-6f);
+	}
+	return sum/a->getNumElements();
+}
+
+static RRReal getSum(const RRBuffer* buffer)
+{
+	RRReal sum = 0;
+	for (unsigned i=0;i<buffer->getNumElements();i++)
+		sum += RRVec3(buffer->getElement(i,nullptr)).sum();
+	return sum;
+}
+
+// Color space is changed in place and set again, solver must not reuse cache baked for its previous state.
+static void testColorSpaceChange(RRBuffer* sky0, RRBuffer* sky1)
+{
+	enum {QUALITY=1000}; // enough lookups to bake cache in first bake
+	unsigned numVertices = (FLOOR_QUADS+1)*(FLOOR_QUADS+1);
+	GammaColorSpace colorSpace(2.2f);
+	SkyScene scene(sky0,sky1);
+	scene.solver->setColorSpace(&colorSpace);
+	RRBuffer* before = RRBuffer::create(BT_VERTEX_BUFFER,numVertices,1,1,BF_RGBF,false,nullptr);
+	scene.bake(before,QUALITY);
+	colorSpace.gamma = 1;
+	scene.solver->setColorSpace(&colorSpace);
+	RRBuffer* after = RRBuffer::create(BT_VERTEX_BUFFER,numVertices,1,1,BF_RGBF,false,nullptr);
+	scene.bake(after,QUALITY);
+
+	GammaColorSpace referenceColorSpace(1);
+	SkyScene reference(sky0,sky1);
+	reference.solver->setColorSpace(&referenceColorSpace);
+	RRBuffer* expected = RRBuffer::create(BT_VERTEX_BUFFER,numVertices,1,1,BF_RGBF,false,nullptr);
+	reference.bake(expected,QUALITY);
+
+	RRReal change = getDifference(before,expected);
+	RRReal error = getDifference(after,expected);
+	RRReporter::report((error<MAX_AVERAGE_ERROR && change>10*MAX_AVERAGE_ERROR)?INF1:ERRO,"Color space changed in place: bake differs from fresh solver by %.3f%% (gamma change alone %.1f%%)\n",error*100,change*100);
+	delete expected;
+	delete after;
+	delete before;
+}
+
+static void benchmarkBake(RRBuffer* sky0, RRBuffer* sky1)
+{
+	enum {QUALITY=300};
+	RRReporter::report(INF1,"Sky lit floor, %dx%d lightmap, quality %d, consecutive bakes:\n",LIGHTMAP_SIZE,LIGHTMAP_SIZE,QUALITY);
+	RRReal sums[2] = {0,0};
+	for (unsigned cached=0;cached<2;cached++)
+	{
+		RRBuffer::setEnvironmentBlendCacheSize(cached?DEFAULT_CACHE_SIZE:0);
+		SkyScene scene(sky0,sky1);
+		RRBuffer* lightmap = RRBuffer::create(BT_2D_TEXTURE,LIGHTMAP_SIZE,LIGHTMAP_SIZE,1,BF_RGBF,false,nullptr);
+		double seconds[3];
+		for (unsigned i=0;i<3;i++)
+			seconds[i] = scene.bake(lightmap,QUALITY);
+		sums[cached] = getSum(lightmap);
+		RRReporter::report(INF1,"  %-8s  %.3fs  %.3fs  %.3fs\n",cached?"cached":"direct",seconds[0],seconds[1],seconds[2]);
+		delete lightmap;
+	}
+	RRBuffer::setEnvironmentBlendCacheSize(DEFAULT_CACHE_SIZE);
+	RRReal sumError = fabs(sums[1]-sums[0])/sums[0];
+	RRReporter::report((sumError<MAX_SUM_ERROR)?INF1:ERRO,"  lightmap sum differs by %.4f%%\n",sumError*100);
+}
+
+void benchmarkEnvironment()
+{
+	RRBuffer* sky0 = createEquirectangularSky();
+	RRBuffer* sky1 = createCubeSky();
+	testLookups(sky0,sky1);
+	testColorSpaceChange(sky0,sky1);
+	benchmarkBake(sky0,sky1);
+	delete sky1;
+	delete sky0;
+}
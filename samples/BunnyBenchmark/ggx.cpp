@@ -0,0 +1,222 @@
+// --------------------------------------------------------------------------
+// BunnyBenchmark ggx
+//
+// Checks GGX specular reflection of RRMaterial, for several roughnesses and view angles:
+// - white furnace: albedo estimated from sampleResponse() matches albedo integrated from getResponse(),
+//   sample weights never exceed 1 (visible normal sampling weights are G2/G1)
+// - chi-square: directions generated by sampleResponse() follow density returned by getResponsePdf()
+// - variance: for roughness up to 0.5, sample weights vary less than with cosine weighted sampling of the same brdf
+//   (very rough GGX is close to diffuse, and visible normals reflect 40% of samples below surface)
+// Measures time of sampleResponse() for GGX and Phong.
+// --------------------------------------------------------------------------
+
+#include "BunnyBenchmark.h"
+#include "Lightsprint/RRMaterial.h"
+#include <math.h>
+#include <vector>
+
+enum
+{
+	NUM_SAMPLES = 1000000,
+	THETA_BINS = 32, // chi-square histogram of directions to light in upper hemisphere
+	PHI_BINS = 64,
+	SUBSAMPLES = 16, // per bin side when integrating pdf and response over bin, lobe of roughness 0.2 spans only few bins
+	MIN_EXPECTED = 5, // bins with fewer expected samples are merged
+};
+
+// Deterministic uniform random numbers in 0..1 (1 excluded).
+class Random
+{
+public:
+	Random() : state(88172645463325252ull) {}
+	RRReal get()
+	{
+		state ^= state<<13;
+		state ^= state>>7;
+		state ^= state<<17;
+		return (state>>40)*(1.f/16777216);
+	}
+private:
+	unsigned long long state;
+};
+
+static RRMaterial* createGgxMaterial(RRReal roughness)
+{
+	RRMaterial* material = new RRMaterial;
+	material->reset(false);
+	material->diffuseReflectance.colorLinear = RRVec3(0);
+	material->specularReflectance.colorLinear = RRVec3(1);
+	material->specularTransmittance.colorLinear = RRVec3(0);
+	material->refractionIndex = 1;
+	material->specularModel = RRMaterial::GGX;
+	material->specularShininess = roughness;
+	return material;
+}
+
+// Response with dirIn coming from direction toLight.
+static RRMaterial::Response getResponse(const RRMaterial* material, const RRVec3& dirOut, const RRVec3& toLight, RRReal& pdf)
+{
+	RRMaterial::Response response;
+	response.dirNormal = RRVec3(0,0,1);
+	response.dirOut = dirOut;
+	response.dirIn = -toLight;
+	material->getResponse(response,RRMaterial::BRDF_SPECULAR);
+	pdf = material->getResponsePdf(response,RRMaterial::BRDF_SPECULAR);
+	return response;
+}
+
+struct GgxResults
+{
+	double albedoIntegrated; // integral of getResponse()/pi over hemisphere
+	double pdfIntegral; // integral of getResponsePdf()/pi over hemisphere, the rest goes below surface
+	double albedoSampled; // mean of colorOut/pdf of sampleResponse()
+	double maxWeight;
+	double varianceSampled; // variance of colorOut/pdf
+	double varianceCosine; // variance of the same with cosine weighted sampling
+	double chi2;
+	unsigned dof;
+};
+
+static GgxResults testGgx(RRReal roughness, RRReal viewAngle)
+{
+	RRMaterial* material = createGgxMaterial(roughness);
+	RRVec3 dirOut(sin(viewAngle),0,cos(viewAngle));
+	GgxResults results;
+
+	// integrate response and pdf over bins of upper hemisphere
+	std::vector<double> expected(THETA_BINS*PHI_BINS+1); // last bin is below surface
+	results.albedoIntegrated = 0;
+	results.pdfIntegral = 0;
+	for (unsigned t=0;t<THETA_BINS*SUBSAMPLES;t++)
+	{
+		double theta = (t+0.5)*(RR_PI/2)/(THETA_BINS*SUBSAMPLES);
+		for (unsigned p=0;p<PHI_BINS*SUBSAMPLES;p++)
+		{
+			double phi = (p+0.5)*(2*RR_PI)/(PHI_BINS*SUBSAMPLES)-RR_PI;
+			double solidAngle = sin(theta)*(RR_PI/2)/(THETA_BINS*SUBSAMPLES)*(2*RR_PI)/(PHI_BINS*SUBSAMPLES);
+			RRVec3 toLight((RRReal)(sin(theta)*cos(phi)),(RRReal)(sin(theta)*sin(phi)),(RRReal)cos(theta));
+			RRReal pdf;
+			RRMaterial::Response response = getResponse(material,dirOut,toLight,pdf);
+			results.albedoIntegrated += response.colorOut.x/RR_PI*solidAngle;
+			results.pdfIntegral += pdf/RR_PI*solidAngle;
+			expected[t/SUBSAMPLES*PHI_BINS+p/SUBSAMPLES] += pdf/RR_PI*solidAngle*NUM_SAMPLES;
+		}
+	}
+	expected[THETA_BINS*PHI_BINS] = RR_MAX(0,1-results.pdfIntegral)*NUM_SAMPLES;
+
+	// sample
+	std::vector<double> observed(THETA_BINS*PHI_BINS+1);
+	Random random;
+	double sumOfWeights = 0;
+	double sumOfWeights2 = 0;
+	double sumOfCosineWeights = 0;
+	double sumOfCosineWeights2 = 0;
+	results.maxWeight = 0;
+	for (unsigned i=0;i<NUM_SAMPLES;i++)
+	{
+		RRMaterial::Response response;
+		response.dirNormal = RRVec3(0,0,1);
+		response.dirOut = dirOut;
+		RRVec3 randomness(random.get(),random.get(),random.get());
+		material->sampleResponse(response,randomness,RRMaterial::BRDF_SPECULAR);
+		RRReal weight = (response.pdf>0) ? response.colorOut.x/response.pdf : 0;
+		sumOfWeights += weight;
+		sumOfWeights2 += weight*weight;
+		results.maxWeight = RR_MAX(results.maxWeight,weight);
+		RRVec3 toLight = -response.dirIn;
+		unsigned bin = THETA_BINS*PHI_BINS;
+		if (toLight.z>0)
+		{
+			double theta = acos(RR_MIN(toLight.z,1));
+			double phi = atan2(toLight.y,toLight.x);
+			unsigned t = RR_MIN((unsigned)(theta/(RR_PI/2)*THETA_BINS),THETA_BINS-1);
+			unsigned p = RR_MIN((unsigned)((phi+RR_PI)/(2*RR_PI)*PHI_BINS),PHI_BINS-1);
+			bin = t*PHI_BINS+p;
+		}
+		observed[bin]++;
+
+		// the same brdf sampled by cosine weighted hemisphere (pdf=cos), weight = colorOut/cos
+		material->sampleResponse(response,randomness,RRMaterial::BRDF_DIFFUSE);
+		RRReal cosine = response.pdf;
+		material->getResponse(response,RRMaterial::BRDF_SPECULAR);
+		RRReal cosineWeight = (cosine>0) ? response.colorOut.x/cosine : 0;
+		sumOfCosineWeights += cosineWeight;
+		sumOfCosineWeights2 += cosineWeight*cosineWeight;
+	}
+	results.albedoSampled = sumOfWeights/NUM_SAMPLES;
+	results.varianceSampled = sumOfWeights2/NUM_SAMPLES-results.albedoSampled*results.albedoSampled;
+	double albedoCosine = sumOfCosineWeights/NUM_SAMPLES;
+	results.varianceCosine = sumOfCosineWeights2/NUM_SAMPLES-albedoCosine*albedoCosine;
+
+	// chi-square, bins with low expectation merged in order
+	results.chi2 = 0;
+	results.dof = 0;
+	double mergedExpected = 0;
+	double mergedObserved = 0;
+	for (unsigned i=0;i<expected.size();i++)
+	{
+		mergedExpected += expected[i];
+		mergedObserved += observed[i];
+		if (mergedExpected>=MIN_EXPECTED || i+1==expected.size())
+		{
+			if (mergedExpected>0)
+			{
+				results.chi2 += (mergedObserved-mergedExpected)*(mergedObserved-mergedExpected)/mergedExpected;
+				results.dof++;
+			}
+			else
+			if (mergedObserved>0)
+				results.chi2 += 1e10; // sampled where pdf is zero
+			mergedExpected = 0;
+			mergedObserved = 0;
+		}
+	}
+	results.dof--;
+
+	delete material;
+	return results;
+}
+
+// Returns nanoseconds per sampleResponse().
+static double measureSampling(RRMaterial::SpecularModel specularModel, RRReal shininess)
+{
+	RRMaterial* material = createGgxMaterial(shininess);
+	material->specularModel = specularModel;
+	Random random;
+	RRReal sum = 0;
+	RRTime time;
+	for (unsigned i=0;i<NUM_SAMPLES;i++)
+	{
+		RRMaterial::Response response;
+		response.dirNormal = RRVec3(0,0,1);
+		response.dirOut = RRVec3(0.6f,0,0.8f);
+		material->sampleResponse(response,RRVec3(random.get(),random.get(),random.get()),RRMaterial::BRDF_SPECULAR);
+		sum += response.pdf;
+	}
+	double ns = time.secondsPassed()*1e9/NUM_SAMPLES;
+	delete material;
+	return (sum>=0) ? ns : 0; // sum keeps loop from being optimized away
+}
+
+void benchmarkGgx()
+{
+	RRReporter::report(INF1,"GGX specular reflection, %d samples per case:\n",NUM_SAMPLES);
+	RRReal roughnesses[] = {0.2f,0.5f,0.9f};
+	RRReal viewAngles[] = {0,45,80};
+	for (unsigned r=0;r<3;r++)
+		for (unsigned v=0;v<3;v++)
+		{
+			GgxResults results = testGgx(roughnesses[r],RR_DEG2RAD(viewAngles[v]));
+			// furnace: sampled albedo is noisy mean of weights, integrated albedo is precise within 0.5%
+			bool furnaceOk = fabs(results.albedoSampled-results.albedoIntegrated)<=0.005*results.albedoIntegrated+3*sqrt(results.varianceSampled/NUM_SAMPLES)
+				&& results.albedoIntegrated<=1.001 && results.maxWeight<=1.0001;
+			// chi-square far above degrees of freedom means sampled directions don't follow pdf
+			bool chi2Ok = results.chi2<results.dof+5*sqrt(2.*results.dof);
+			bool varianceOk = roughnesses[r]>0.5f || results.varianceSampled<results.varianceCosine;
+			RRReporter::report(furnaceOk?INF1:ERRO,"  roughness %.1f, view %2.0f deg: albedo integrated %.4f, sampled %.4f, max weight %.4f, pdf above surface %.4f\n",
+				roughnesses[r],viewAngles[v],results.albedoIntegrated,results.albedoSampled,results.maxWeight,results.pdfIntegral);
+			RRReporter::report(chi2Ok?INF1:ERRO,"    chi-square %.0f, degrees of freedom %d\n",results.chi2,results.dof);
+			RRReporter::report(varianceOk?INF1:ERRO,"    variance of weights %.5f, with cosine weighted sampling %.5f (%.0fx)\n",results.varianceSampled,results.varianceCosine,results.varianceCosine/RR_MAX(results.varianceSampled,1e-20));
+		}
+	RRReporter::report(INF1,"  sampleResponse() GGX roughness 0.3 %.0fns, PHONG shininess 100 %.0fns\n",measureSampling(RRMaterial::GGX,0.3f),measureSampling(RRMaterial::PHONG,100));
+}
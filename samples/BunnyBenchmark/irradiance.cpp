@@ -0,0 +1,173 @@
+// --------------------------------------------------------------------------
+// BunnyBenchmark irradiance
+//
+// Checks that batch evaluation RRLight::getIrradiances() and getIrradianceSamples()
+// returns exactly the same results as getIrradiance() and getIrradianceSample() called per receiver,
+// for all light types, distance attenuation types, spot cones, projected textures, area lights,
+// custom light, in linear and sRGB color space.
+// Measures evaluations per second of both.
+// --------------------------------------------------------------------------
+
+#include "BunnyBenchmark.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+enum
+{
+	NUM_RECEIVERS = 20480, // multiple of BATCH_SIZE
+	BATCH_SIZE = 256, // bakers evaluate lights for tens to hundreds of receivers at once
+};
+
+// Light with custom irradiance, batch evaluation must call it.
+class CustomLight : public RRLight
+{
+public:
+	CustomLight()
+	{
+		type = POINT;
+		position = RRVec3(0.1f,0.2f,0.3f);
+		color = RRVec3(0.5f);
+		distanceAttenuationType = REALISTIC;
+	}
+	virtual RRVec3 getIrradiance(const RRVec3& receiverPosition, const RRColorSpace* colorSpace) const override
+	{
+		return RRVec3(receiverPosition.x>0 ? 1.f : 0.f,0.5f,(receiverPosition-position).length());
+	}
+};
+
+static RRBuffer* createNoiseTexture(unsigned size)
+{
+	srand(size);
+	RRBuffer* texture = RRBuffer::create(BT_2D_TEXTURE,size,size,1,BF_RGB,true,nullptr);
+	for (unsigned i=0;i<size*size;i++)
+		texture->setElement(i,RRVec4(rand()/(RRReal)RAND_MAX,rand()/(RRReal)RAND_MAX,rand()/(RRReal)RAND_MAX,1),nullptr);
+	return texture;
+}
+
+// Lights of all kinds, with names for report.
+static void createLights(RRLights& lights, std::vector<const char*>& names)
+{
+	RRVec3 position(0,0.5f,0);
+	RRVec3 direction = RRVec3(0.3f,-1,0.2f).normalized();
+	RRVec3 color(0.8f,0.5f,0.3f);
+	RRVec4 polynom(0.2f,0.5f,1,0.1f);
+	#define ADD(light,name) {lights.push_back(light); names.push_back(name);}
+	ADD(RRLight::createDirectionalLight(direction,color,true),"directional");
+	ADD(RRLight::createDirectionalLight(direction,color,false),"directional, custom scale");
+	ADD(RRLight::createPointLightNoAtt(position,color),"point NONE");
+	ADD(RRLight::createPointLight(position,color),"point REALISTIC");
+	ADD(RRLight::createPointLightPoly(position,color,polynom),"point POLYNOMIAL");
+	ADD(RRLight::createPointLightRadiusExp(position,color,1,2),"point EXPONENTIAL");
+	ADD(RRLight::createPointLightRadiusExp(position,color,1,0),"point EXPONENTIAL, exponent 0");
+	ADD(RRLight::createSpotLightNoAtt(position,color,direction,0.7f,0.3f),"spot NONE");
+	ADD(RRLight::createSpotLight(position,color,direction,0.7f,0.3f),"spot REALISTIC");
+	ADD(RRLight::createSpotLightPoly(position,color,polynom,direction,0.7f,0.3f,2),"spot POLYNOMIAL");
+	ADD(RRLight::createSpotLightPoly(position,color,polynom,direction,0.7f,0,1),"spot POLYNOMIAL, no falloff");
+	ADD(RRLight::createSpotLightRadiusExp(position,color,1,2,direction,0.7f,0.3f),"spot EXPONENTIAL");
+	ADD(RRLight::createSpotLight(position,color,direction,1.5f,1.5f),"spot REALISTIC, wide");
+	ADD(RRLight::createSpotLight(position,color,direction,0.7f,0.3f),"spot, projected texture 64x64");
+	lights[lights.size()-1]->projectedTexture = createNoiseTexture(64);
+	ADD(RRLight::createSpotLightPoly(position,color,polynom,direction,0.4f,0.1f,1),"spot POLYNOMIAL, projected texture 64x64");
+	lights[lights.size()-1]->projectedTexture = createNoiseTexture(64);
+	ADD(RRLight::createSpotLight(position,color,direction,0.7f,0.3f),"spot, projected texture 1100x1100");
+	lights[lights.size()-1]->projectedTexture = createNoiseTexture(1100); // too big to be cached
+	ADD(RRLight::createPointLight(position,color),"point, sphere area");
+	lights[lights.size()-1]->areaType = RRLight::AREA_SPHERE;
+	ADD(RRLight::createSpotLight(position,color,direction,0.7f,0.3f),"spot, disk area");
+	lights[lights.size()-1]->areaType = RRLight::AREA_DISK;
+	ADD(RRLight::createSpotLight(position,color,direction,0.7f,0.3f),"spot, rectangle area, projected texture");
+	lights[lights.size()-1]->areaType = RRLight::AREA_RECTANGLE;
+	lights[lights.size()-1]->areaSize = RRVec2(0.3f,0.1f);
+	lights[lights.size()-1]->projectedTexture = createNoiseTexture(64);
+	ADD(RRLight::createDirectionalLight(direction,color,true),"directional, angular diameter");
+	lights[lights.size()-1]->angularDiameterRad = 0.1f;
+	ADD(new CustomLight,"custom");
+	#undef ADD
+}
+
+// Compares batch and per receiver evaluation, returns number of receivers with different result.
+static unsigned compare(const RRLight* light, const RRColorSpace* colorSpace, const std::vector<RRVec3>& receivers, const std::vector<RRVec2>& samples)
+{
+	unsigned numDifferent = 0;
+	std::vector<RRVec3> irradiances(BATCH_SIZE);
+	std::vector<RRVec3> directions(BATCH_SIZE);
+	std::vector<RRReal> distances(BATCH_SIZE);
+	for (unsigned i=0;i<NUM_RECEIVERS;i+=BATCH_SIZE)
+	{
+		light->getIrradiances(&receivers[i],&irradiances[0],BATCH_SIZE,colorSpace);
+		for (unsigned j=0;j<BATCH_SIZE;j++)
+		{
+			RRVec3 irradiance = light->getIrradiance(receivers[i+j],colorSpace);
+			if (memcmp(&irradiance,&irradiances[j],sizeof(irradiance)))
+				numDifferent++;
+		}
+		light->getIrradianceSamples(&receivers[i],&samples[i],&irradiances[0],&directions[0],&distances[0],BATCH_SIZE,colorSpace);
+		for (unsigned j=0;j<BATCH_SIZE;j++)
+		{
+			RRVec3 direction;
+			RRReal distance;
+			RRVec3 irradiance = light->getIrradianceSample(receivers[i+j],samples[i+j],colorSpace,direction,distance);
+			if (memcmp(&irradiance,&irradiances[j],sizeof(irradiance)) || memcmp(&direction,&directions[j],sizeof(direction)) || memcmp(&distance,&distances[j],sizeof(distance)))
+				numDifferent++;
+		}
+	}
+	return numDifferent;
+}
+
+// Returns millions of evaluations per second.
+static double measure(const RRLight* light, const std::vector<RRVec3>& receivers, bool batch)
+{
+	std::vector<RRVec3> irradiances(NUM_RECEIVERS);
+	unsigned numEvaluations = 0;
+	RRTime time;
+	do
+	{
+		if (batch)
+		{
+			for (unsigned i=0;i<NUM_RECEIVERS;i+=BATCH_SIZE)
+				light->getIrradiances(&receivers[i],&irradiances[i],BATCH_SIZE,nullptr);
+		}
+		else
+		{
+			for (unsigned i=0;i<NUM_RECEIVERS;i++)
+				irradiances[i] = light->getIrradiance(receivers[i],nullptr);
+		}
+		numEvaluations += NUM_RECEIVERS;
+	}
+	while (time.secondsPassed()<0.1f);
+	return numEvaluations/time.secondsPassed()*1e-6;
+}
+
+void benchmarkIrradiance()
+{
+	RRReporter::report(INF1,"Light irradiance, batch vs per receiver, %d receivers, batches of %d:\n",NUM_RECEIVERS,BATCH_SIZE);
+	RRLights lights;
+	std::vector<const char*> names;
+	createLights(lights,names);
+
+	// receivers all around lights, including light position and distant points
+	srand(1);
+	std::vector<RRVec3> receivers(NUM_RECEIVERS);
+	std::vector<RRVec2> samples(NUM_RECEIVERS);
+	for (unsigned i=0;i<NUM_RECEIVERS;i++)
+	{
+		RRReal scale = (i%10==0) ? 100.f : 2.f;
+		receivers[i] = RRVec3(rand()/(RRReal)RAND_MAX-0.5f,rand()/(RRReal)RAND_MAX-0.5f,rand()/(RRReal)RAND_MAX-0.5f)*scale;
+		samples[i] = RRVec2(rand()/(RAND_MAX+1.f),rand()/(RAND_MAX+1.f));
+	}
+	receivers[0] = lights[2]->position;
+
+	RRColorSpace* sRGB = RRColorSpace::create_sRGB();
+	for (unsigned l=0;l<lights.size();l++)
+	{
+		unsigned numDifferentLinear = compare(lights[l],nullptr,receivers,samples);
+		unsigned numDifferentSRGB = compare(lights[l],sRGB,receivers,samples);
+		double single = measure(lights[l],receivers,false);
+		double batch = measure(lights[l],receivers,true);
+		RRReporter::report((numDifferentLinear||numDifferentSRGB)?ERRO:INF1,"  %-44s %d+%d differences  %6.1f vs %6.1f M/s  %5.1fx\n",names[l],numDifferentLinear,numDifferentSRGB,single,batch,batch/single);
+	}
+	delete sRGB;
+	for (unsigned l=0;l<lights.size();l++)
+		delete lights[l]; // deletes projected textures
+}
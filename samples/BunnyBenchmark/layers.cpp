@@ -0,0 +1,177 @@
+// --------------------------------------------------------------------------
+// BunnyBenchmark layers
+//
+// Saves and loads illumination layer of hundreds of objects with RRObjects::saveLayer()/loadLayer(),
+// one by one and in parallel (maxThreads=0), using simple thread safe file format registered here.
+// Checks that parallel save writes the same files as serial one, including buffer shared by two objects
+// and two objects saving to the same filename, and that parallel load gives the same buffers.
+// Measures time of serial and parallel save and load.
+// --------------------------------------------------------------------------
+
+#include "BunnyBenchmark.h"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace bf = std::filesystem;
+
+enum
+{
+	NUM_OBJECTS = 400,
+	LAYER = 0,
+	LAYER_SIZE = 128, // 192KB per file
+};
+
+// Header and RGBF pixels, no compression.
+
+static RRBuffer* loadRawLayer(const RRString& filename)
+{
+	std::ifstream ifs(bf::path(RR_RR2PATH(filename)),std::ios::in|std::ios::binary);
+	unsigned size[2];
+	if (!ifs.read((char*)size,sizeof(size)) || !size[0] || !size[1] || size[0]>65536 || size[1]>65536)
+		return nullptr;
+	RRBuffer* buffer = RRBuffer::create(BT_2D_TEXTURE,size[0],size[1],1,BF_RGBF,false,nullptr);
+	unsigned char* data = buffer->lock(BL_DISCARD_AND_WRITE);
+	bool ok = data && ifs.read((char*)data,buffer->getBufferBytes());
+	buffer->unlock();
+	if (!ok)
+		RR_SAFE_DELETE(buffer);
+	return buffer;
+}
+
+static bool saveRawLayer(RRBuffer* buffer, const RRString& filename, const RRBuffer::SaveParameters* parameters)
+{
+	if (buffer->getType()!=BT_2D_TEXTURE || buffer->getFormat()!=BF_RGBF)
+		return false;
+	std::ofstream ofs(bf::path(RR_RR2PATH(filename)),std::ios::out|std::ios::binary|std::ios::trunc);
+	unsigned size[2] = {buffer->getWidth(),buffer->getHeight()};
+	const unsigned char* data = buffer->lock(BL_READ);
+	bool ok = data && ofs.write((const char*)size,sizeof(size)) && ofs.write((const char*)data,buffer->getBufferBytes());
+	buffer->unlock();
+	return ok;
+}
+
+static std::string readFile(const bf::path& path)
+{
+	std::ifstream ifs(path,std::ios::in|std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(ifs),std::istreambuf_iterator<char>());
+}
+
+static bool equal(const RRBuffer* a, const RRBuffer* b)
+{
+	if (!a || !b)
+		return a==b;
+	if (a->getWidth()!=b->getWidth() || a->getHeight()!=b->getHeight())
+		return false;
+	for (unsigned i=0;i<a->getNumElements();i++)
+		if (a->getElement(i,nullptr)!=b->getElement(i,nullptr))
+			return false;
+	return true;
+}
+
+void benchmarkLayers()
+{
+	RRBuffer::registerLoader("*.rawlayer",loadRawLayer);
+	RRBuffer::registerSaver("*.rawlayer",saveRawLayer);
+	bf::path directory = bf::temp_directory_path()/"BunnyBenchmarkLayers";
+	std::error_code ec;
+	bf::remove_all(directory,ec);
+	RRString paths[2] = {RR_PATH2RR(directory/"serial/"),RR_PATH2RR(directory/"parallel/")};
+	RRReporter::report(INF1,"Illumination layer of %d objects, %dx%d float maps, in %ls:\n",NUM_OBJECTS,LAYER_SIZE,LAYER_SIZE,directory.wstring().c_str());
+
+	// objects with unique content, object 1 saves to the same file as object 0, object 3 shares buffer with object 2
+	bool aborting = false;
+	RRMeshArrays mesh;
+	mesh.resizeMesh(1,3,nullptr,false,false);
+	mesh.triangle[0] = RRMeshArrays::Triangle{0,1,2};
+	mesh.position[0] = RRVec3(0,0,0);
+	mesh.position[1] = RRVec3(1,0,0);
+	mesh.position[2] = RRVec3(0,1,0);
+	RRCollider* collider = RRCollider::create(&mesh,nullptr,RRCollider::IT_LINEAR,aborting);
+	RRObjects objects;
+	std::vector<RRBuffer*> originals(NUM_OBJECTS);
+	for (unsigned i=0;i<NUM_OBJECTS;i++)
+	{
+		RRObject* object = new RRObject;
+		object->setCollider(collider);
+		object->name.format(L"object%d",(i==1)?0:i);
+		if (i==3)
+			originals[i] = originals[2];
+		else
+		{
+			originals[i] = RRBuffer::create(BT_2D_TEXTURE,LAYER_SIZE,LAYER_SIZE,1,BF_RGBF,false,nullptr);
+			for (unsigned j=0;j<LAYER_SIZE*LAYER_SIZE;j++)
+				originals[i]->setElement(j,RRVec4((float)i,(float)j,(float)(i^j),0),nullptr);
+		}
+		object->illumination.getLayer(LAYER) = originals[i];
+		objects.push_back(object);
+	}
+
+	// save
+	double saveSeconds[2];
+	unsigned numSaved[2];
+	for (unsigned parallel=0;parallel<2;parallel++)
+	{
+		RRReporter::setFilter(true,0,false);
+		RRTime time;
+		numSaved[parallel] = objects.saveLayer(LAYER,paths[parallel],"rawlayer",parallel?0:1);
+		saveSeconds[parallel] = time.secondsPassed();
+		RRReporter::setFilter(true,1,false);
+	}
+	unsigned numDifferentFiles = 0;
+	for (unsigned i=0;i<NUM_OBJECTS;i++)
+	{
+		bf::path filename = bf::path(RR_RR2PATH(objects[i]->name)).concat(".rawlayer");
+		if (readFile(directory/"serial"/filename)!=readFile(directory/"parallel"/filename))
+			numDifferentFiles++;
+	}
+	RRReporter::report((numSaved[0]==NUM_OBJECTS && numSaved[1]==NUM_OBJECTS && !numDifferentFiles)?INF1:ERRO,"  saved %d and %d files, %d differ between serial and parallel save\n",numSaved[0],numSaved[1],numDifferentFiles);
+
+	// load, with one file missing
+	bf::remove(directory/"serial/object5.rawlayer",ec);
+	bf::remove(directory/"parallel/object5.rawlayer",ec);
+	for (unsigned i=0;i<NUM_OBJECTS;i++)
+		objects[i]->illumination.getLayer(LAYER) = nullptr;
+	double loadSeconds[2];
+	unsigned numLoaded[2];
+	std::vector<RRBuffer*> loaded[2];
+	for (unsigned parallel=0;parallel<2;parallel++)
+	{
+		RRReporter::setFilter(true,0,false);
+		RRTime time;
+		numLoaded[parallel] = objects.loadLayer(LAYER,paths[parallel],"rawlayer",parallel?0:1);
+		loadSeconds[parallel] = time.secondsPassed();
+		RRReporter::setFilter(true,1,false);
+		for (unsigned i=0;i<NUM_OBJECTS;i++)
+		{
+			loaded[parallel].push_back(objects[i]->illumination.getLayer(LAYER));
+			objects[i]->illumination.getLayer(LAYER) = nullptr;
+		}
+	}
+	unsigned numWrong = 0;
+	for (unsigned i=0;i<NUM_OBJECTS;i++)
+	{
+		// object 0 loads file written by object 1
+		const RRBuffer* expected = (i==5) ? nullptr : originals[i ? i : 1];
+		for (unsigned parallel=0;parallel<2;parallel++)
+			if (!equal(loaded[parallel][i],expected))
+				numWrong++;
+	}
+	RRReporter::report((numLoaded[0]==NUM_OBJECTS-1 && numLoaded[1]==NUM_OBJECTS-1 && !numWrong)?INF1:ERRO,"  loaded %d and %d buffers, %d differ from saved data\n",numLoaded[0],numLoaded[1],numWrong);
+	RRReporter::report(INF1,"  save %6.3fs serial, %6.3fs parallel\n",saveSeconds[0],saveSeconds[1]);
+	RRReporter::report(INF1,"  load %6.3fs serial, %6.3fs parallel\n",loadSeconds[0],loadSeconds[1]);
+
+	// cleanup
+	for (unsigned i=0;i<NUM_OBJECTS;i++)
+	{
+		if (i!=3)
+			delete originals[i];
+		delete loaded[0][i];
+		delete loaded[1][i];
+		delete objects[i];
+	}
+	delete collider;
+	bf::remove_all(directory,ec);
+}
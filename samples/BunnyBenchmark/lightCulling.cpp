@@ -0,0 +1,178 @@
+// --------------------------------------------------------------------------
+// BunnyBenchmark lightculling
+//
+// Hall floor lit by hundreds of local lights, direct illumination baked
+// per-pixel and per-vertex with light culling (default) and without it
+// (negative UpdateParameters::lightCutoffIrradiance).
+// Checks that culled bakes match unculled ones: exactly for lights with limited reach,
+// within sum of cut off irradiances for lights culled by lightCutoffIrradiance.
+// Measures time of both.
+// --------------------------------------------------------------------------
+
+#include "BunnyBenchmark.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+enum
+{
+	HALL_SIZE = 10, // in meters
+	FLOOR_QUADS = 40, // per side
+	LIGHTMAP_SIZE = 128,
+	QUALITY = 20,
+};
+
+struct Hall
+{
+	RRMeshArrays* mesh;
+	RRObject* floor;
+	RRMaterial* material;
+	RRObjects objects;
+	RRSolver* solver;
+
+	Hall()
+	{
+		mesh = new RRMeshArrays;
+		RRVector<unsigned> texcoords;
+		texcoords.push_back(0);
+		mesh->resizeMesh(FLOOR_QUADS*FLOOR_QUADS*2,(FLOOR_QUADS+1)*(FLOOR_QUADS+1),&texcoords,false,false);
+		for (unsigned i=0;i<=FLOOR_QUADS;i++)
+			for (unsigned j=0;j<=FLOOR_QUADS;j++)
+			{
+				unsigned v = i*(FLOOR_QUADS+1)+j;
+				mesh->position[v] = RRVec3((RRReal)i/FLOOR_QUADS-0.5f,0,(RRReal)j/FLOOR_QUADS-0.5f)*HALL_SIZE;
+				mesh->normal[v] = RRVec3(0,1,0);
+				mesh->texcoord[0][v] = RRVec2((RRReal)i/FLOOR_QUADS,(RRReal)j/FLOOR_QUADS);
+			}
+		unsigned t = 0;
+		for (unsigned i=0;i<FLOOR_QUADS;i++)
+			for (unsigned j=0;j<FLOOR_QUADS;j++)
+			{
+				unsigned a = i*(FLOOR_QUADS+1)+j, b = a+1, c = a+FLOOR_QUADS+1, d = c+1;
+				mesh->triangle[t++] = RRMeshArrays::Triangle{a,b,c};
+				mesh->triangle[t++] = RRMeshArrays::Triangle{b,d,c};
+			}
+		bool aborting = false;
+		floor = new RRObject;
+		floor->setCollider(RRCollider::create(mesh,nullptr,RRCollider::IT_BVH_FAST,aborting));
+		material = new RRMaterial;
+		material->reset(false);
+		material->lightmap.texcoord = 0;
+		floor->faceGroups.push_back(RRObject::FaceGroup(material,t));
+		objects.push_back(floor);
+		RRReporter::setFilter(true,0,false);
+		solver = new RRSolver;
+		solver->setStaticObjects(objects,nullptr);
+		RRReporter::setFilter(true,1,false);
+	}
+
+	// Bakes direct illumination into lightmap or vertex buffer, returns seconds.
+	double bake(RRBuffer* buffer, RRReal lightCutoffIrradiance)
+	{
+		RRSolver::UpdateParameters params(QUALITY);
+		params.indirect.lightMultiplier = 0;
+		params.indirect.environmentMultiplier = 0;
+		params.indirect.materialEmittanceMultiplier = 0;
+		params.lightCutoffIrradiance = lightCutoffIrradiance;
+		params.randomSeed = 1;
+		RRReporter::setFilter(true,0,false);
+		RRTime time;
+		solver->updateLightmap(0,buffer,nullptr,nullptr,&params);
+		double seconds = time.secondsPassed();
+		RRReporter::setFilter(true,1,false);
+		return seconds;
+	}
+
+	~Hall()
+	{
+		delete solver;
+		delete material;
+		delete floor->getCollider();
+		delete floor;
+		delete mesh;
+	}
+};
+
+// Random lights above floor, half of them spot lights pointing down.
+static RRLights createLights(unsigned numLights, bool exponential)
+{
+	srand(numLights);
+	RRLights lights;
+	for (unsigned i=0;i<numLights;i++)
+	{
+		RRVec3 position((rand()/(RRReal)RAND_MAX-0.5f)*HALL_SIZE,rand()/(RRReal)RAND_MAX+0.5f,(rand()/(RRReal)RAND_MAX-0.5f)*HALL_SIZE);
+		RRVec3 direction = RRVec3(rand()/(RRReal)RAND_MAX-0.5f,-1,rand()/(RRReal)RAND_MAX-0.5f).normalized();
+		RRReal radius = rand()/(RRReal)RAND_MAX+1;
+		if (exponential)
+			lights.push_back((i%2) ? RRLight::createSpotLightRadiusExp(position,RRVec3(1),radius,1,direction,0.6f,0.2f) : RRLight::createPointLightRadiusExp(position,RRVec3(1),radius,1));
+		else
+			lights.push_back((i%2) ? RRLight::createSpotLight(position,RRVec3(0.05f),direction,0.6f,0.2f) : RRLight::createPointLight(position,RRVec3(0.05f)));
+	}
+	return lights;
+}
+
+// Bakes with culling and without it, reports times and checks that results differ at most by maxError.
+static void compare(Hall& hall, RRBuffer* buffer, const char* name, RRReal lightCutoffIrradiance, RRReal maxError)
+{
+	RRBuffer* culled = buffer->createCopy();
+	double unculledSeconds = hall.bake(buffer,-1);
+	double culledSeconds = hall.bake(culled,lightCutoffIrradiance);
+	RRReal maxDifference = 0;
+	double sumOfDifferences = 0;
+	double sumOfIrradiances = 0;
+	for (unsigned i=0;i<buffer->getNumElements();i++)
+	{
+		RRVec3 a = buffer->getElement(i,nullptr);
+		RRVec3 b = culled->getElement(i,nullptr);
+		maxDifference = RR_MAX(maxDifference,(a-b).abs().maxi());
+		sumOfDifferences += (a-b).abs().avg();
+		sumOfIrradiances += a.avg();
+	}
+	delete culled;
+	RRReporter::report((maxDifference<=maxError)?INF1:ERRO,"  %-44s unculled %7.3fs  culled %7.3fs  speedup %5.1fx  difference max %.6f (limit %.6f) mean %.4f%%\n",
+		name,unculledSeconds,culledSeconds,unculledSeconds/culledSeconds,maxDifference,maxError,sumOfDifferences/sumOfIrradiances*100);
+}
+
+void benchmarkLightCulling()
+{
+	RRReporter::report(INF1,"Light culling, %dx%dm floor, quality %d, culled vs unculled bake:\n",HALL_SIZE,HALL_SIZE,QUALITY);
+	Hall hall;
+	RRBuffer* lightmap = RRBuffer::create(BT_2D_TEXTURE,LIGHTMAP_SIZE,LIGHTMAP_SIZE,1,BF_RGBF,false,nullptr);
+	RRBuffer* vertexBuffer = RRBuffer::create(BT_VERTEX_BUFFER,hall.mesh->numVertices,1,1,BF_RGBF,false,nullptr);
+
+	// exponential lights are culled exactly where they don't reach, results are identical
+	for (unsigned numLights=100;numLights<=400;numLights*=4)
+	{
+		RRLights lights = createLights(numLights,true);
+		hall.solver->setLights(lights);
+		char name[100];
+		sprintf(name,"%d exponential lights, %dx%d lightmap",numLights,LIGHTMAP_SIZE,LIGHTMAP_SIZE);
+		compare(hall,lightmap,name,0,0);
+		sprintf(name,"%d exponential lights, per-vertex",numLights);
+		compare(hall,vertexBuffer,name,0,0);
+		hall.solver->setLights(RRLights());
+		for (unsigned i=0;i<lights.size();i++)
+			delete lights[i];
+	}
+
+	// realistic lights reach everywhere, cutoff skips lights below cutoff irradiance,
+	// each skipped light changes result at most by cutoff
+	{
+		enum {NUM_LIGHTS=200};
+		RRLights lights = createLights(NUM_LIGHTS,false);
+		hall.solver->setLights(lights);
+		compare(hall,lightmap,"200 realistic lights, cutoff 0",0,0);
+		for (RRReal cutoff=0.001f;cutoff<0.02f;cutoff*=10)
+		{
+			char name[100];
+			sprintf(name,"200 realistic lights, cutoff %g",cutoff);
+			compare(hall,lightmap,name,cutoff,NUM_LIGHTS*cutoff);
+		}
+		hall.solver->setLights(RRLights());
+		for (unsigned i=0;i<lights.size();i++)
+			delete lights[i];
+	}
+
+	delete vertexBuffer;
+	delete lightmap;
+}
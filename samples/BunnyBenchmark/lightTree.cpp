@@ -0,0 +1,125 @@
+// --------------------------------------------------------------------------
+// BunnyBenchmark lighttree
+//
+// Room with bunny lit by 16 to 1024 point lights, direct illumination baked into room lightmap.
+// Checks that bake with UpdateParameters::lightSamples (lights picked from light tree)
+// converges to exhaustive bake that shoots to all lights.
+// Measures time to reach error of exhaustive bake, for growing number of lights.
+// --------------------------------------------------------------------------
+
+#include "BunnyBenchmark.h"
+#include <math.h>
+#include <stdlib.h>
+
+enum
+{
+	LIGHTMAP_SIZE = 64,
+	LIGHT_SAMPLES = 4,
+	REFERENCE_QUALITY = 200,
+};
+
+// Bakes direct illumination into room lightmap, returns seconds.
+static double bakeRoom(RoomScene& scene, unsigned quality, unsigned lightSamples, RRBuffer* lightmap)
+{
+	RRSolver::UpdateParameters params(quality);
+	params.indirect.lightMultiplier = 0;
+	params.indirect.environmentMultiplier = 0;
+	params.indirect.materialEmittanceMultiplier = 0;
+	params.lightSamples = lightSamples;
+	params.randomSeed = 1;
+	RRReporter::setFilter(true,0,false);
+	RRTime time;
+	scene.solver->updateLightmap(0,lightmap,nullptr,nullptr,&params);
+	double seconds = time.secondsPassed();
+	RRReporter::setFilter(true,1,false);
+	return seconds;
+}
+
+// Mean absolute difference relative to mean of reference.
+static double getError(const RRBuffer* lightmap, const RRBuffer* reference)
+{
+	double sumOfDifferences = 0;
+	double sumOfReference = 0;
+	for (unsigned i=0;i<reference->getWidth()*reference->getHeight();i++)
+	{
+		sumOfDifferences += fabs(lightmap->getElement(i,nullptr)[0]-reference->getElement(i,nullptr)[0]);
+		sumOfReference += reference->getElement(i,nullptr)[0];
+	}
+	return sumOfDifferences/sumOfReference;
+}
+
+// Point lights at random positions in upper half of room, together as bright as one light of RoomScene.
+static RRLights createLights(unsigned numLights)
+{
+	srand(numLights);
+	RRLights lights;
+	for (unsigned i=0;i<numLights;i++)
+	{
+		RRVec3 position(rand()*0.5f/RAND_MAX-0.25f,rand()*0.15f/RAND_MAX+0.2f,rand()*0.5f/RAND_MAX-0.25f);
+		lights.push_back(RRLight::createPointLight(position,RRVec3(0.1f/numLights)));
+	}
+	return lights;
+}
+
+void benchmarkLightTree(RRMesh* bunnyMesh, const RRCollider* bunnyCollider)
+{
+	RoomScene scene(bunnyMesh,bunnyCollider);
+	RRLights roomLights = scene.lights; // RoomScene deletes its light
+	RRBuffer* reference = RRBuffer::create(BT_2D_TEXTURE,LIGHTMAP_SIZE,LIGHTMAP_SIZE,1,BF_RGBF,false,nullptr);
+	RRBuffer* lightmap = RRBuffer::create(BT_2D_TEXTURE,LIGHTMAP_SIZE,LIGHTMAP_SIZE,1,BF_RGBF,false,nullptr);
+
+	// estimator converges to exhaustive result, error drops with quality
+	{
+		enum {NUM_LIGHTS=256};
+		RRLights lights = createLights(NUM_LIGHTS);
+		scene.solver->setLights(lights);
+		RRReporter::report(INF1,"Light tree, %d point lights, %d samples per round, error vs exhaustive bake in quality %d:\n",NUM_LIGHTS,LIGHT_SAMPLES,REFERENCE_QUALITY*4);
+		bakeRoom(scene,REFERENCE_QUALITY*4,0,reference);
+		double previousError = 1;
+		for (unsigned quality=50;quality<=3200;quality*=4)
+		{
+			double seconds = bakeRoom(scene,quality,LIGHT_SAMPLES,lightmap);
+			double error = getError(lightmap,reference);
+			// 4x more rays should halve noise, converging estimator must get at least 1.5x closer
+			bool ok = error*1.5<previousError;
+			RRReporter::report(ok?INF1:ERRO,"  quality %4d  %7.3fs  error %5.2f%%\n",quality,seconds,error*100);
+			previousError = error;
+		}
+		RRReporter::report((previousError<0.02)?INF1:ERRO,"  final error %.2f%%, limit 2%%\n",previousError*100);
+		scene.solver->setLights(RRLights());
+		for (unsigned i=0;i<lights.size();i++)
+			delete lights[i];
+	}
+
+	// time to reach error of exhaustive bake in low quality
+	RRReporter::report(INF1,"Light tree, time to reach error of exhaustive bake in quality 20, %d samples per round:\n",LIGHT_SAMPLES);
+	for (unsigned numLights=16;numLights<=1024;numLights*=4)
+	{
+		RRLights lights = createLights(numLights);
+		scene.solver->setLights(lights);
+		bakeRoom(scene,REFERENCE_QUALITY,0,reference);
+		double exhaustiveSeconds = bakeRoom(scene,20,0,lightmap);
+		double targetError = getError(lightmap,reference);
+		double treeSeconds = 0;
+		double error = 1;
+		unsigned quality;
+		for (quality=20;quality<=REFERENCE_QUALITY*8;quality*=2)
+		{
+			treeSeconds = bakeRoom(scene,quality,LIGHT_SAMPLES,lightmap);
+			error = getError(lightmap,reference);
+			if (error<=targetError)
+				break;
+		}
+		if (error<=targetError)
+			RRReporter::report(INF1,"  %4d lights  error %5.2f%%  exhaustive %7.3fs  tree %7.3fs in quality %4d  speedup %.2fx\n",numLights,targetError*100,exhaustiveSeconds,treeSeconds,quality,exhaustiveSeconds/treeSeconds);
+		else
+			RRReporter::report(INF1,"  %4d lights  error %5.2f%%  exhaustive %7.3fs  tree did not reach it, %.2f%% in quality %d\n",numLights,targetError*100,exhaustiveSeconds,error*100,quality/2);
+		scene.solver->setLights(RRLights());
+		for (unsigned i=0;i<lights.size();i++)
+			delete lights[i];
+	}
+
+	delete lightmap;
+	delete reference;
+	scene.solver->setLights(roomLights);
+}
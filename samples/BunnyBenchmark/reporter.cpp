@@ -0,0 +1,199 @@
+// --------------------------------------------------------------------------
+// BunnyBenchmark reporter
+//
+// Stress test of RRReporter: many threads report while other thread creates and deletes reporters.
+// Checks that reporter registered for whole test receives every message after flush(),
+// that no reporter receives messages of one thread out of order,
+// and that repeated warning is suppressed after limit.
+// Measures cost of report() per message, synchronous and asynchronous,
+// in one thread and in all threads, and cost of filtered out message.
+// --------------------------------------------------------------------------
+
+#include "BunnyBenchmark.h"
+#include <atomic>
+#include <climits>
+#include <omp.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+enum
+{
+	NUM_THREADS = 64,
+	MESSAGES_PER_THREAD = 10000,
+	WARNINGS_PER_THREAD = 10,
+	MAX_REPEATED_WARNINGS = 100, // RRReporter reports the same warning at most this many times per few seconds
+	NUM_BENCHMARK_MESSAGES = 200000,
+};
+
+struct MessageCounters
+{
+	std::atomic<unsigned> numMessages;
+	std::atomic<unsigned> numOutOfOrder;
+	std::atomic<unsigned> numWarnings;
+	std::atomic<unsigned> numSuppressionNotices;
+	MessageCounters() : numMessages(0), numOutOfOrder(0), numWarnings(0), numSuppressionNotices(0) {}
+};
+
+// Counts messages "stress <thread> <sequence>" and checks that sequence of each thread grows.
+// Registers only when constructed and unregisters before destruction, so it can be created and deleted while other threads report.
+class CheckingReporter : public RRReporter
+{
+public:
+	CheckingReporter(MessageCounters& _counters) : RRReporter(false), counters(_counters)
+	{
+		for (unsigned i=0;i<NUM_THREADS;i++)
+			last[i] = UINT_MAX;
+		registerReporter();
+	}
+	virtual void customReport(RRReportType type, int indentation, const char* message) override
+	{
+		unsigned thread, sequence;
+		if (type==INF3 && sscanf(message,"stress %u %u",&thread,&sequence)==2 && thread<NUM_THREADS)
+		{
+			counters.numMessages++;
+			unsigned previous = last[thread].exchange(sequence);
+			if (previous!=UINT_MAX && sequence<=previous)
+				counters.numOutOfOrder++;
+		}
+		if (type==WARN && !strncmp(message,"stress warning",14))
+			counters.numWarnings++;
+		if (type==WARN && strstr(message,"repeated too many times"))
+			counters.numSuppressionNotices++;
+	}
+	virtual ~CheckingReporter()
+	{
+		unregisterReporter();
+	}
+private:
+	MessageCounters& counters;
+	std::atomic<unsigned> last[NUM_THREADS];
+};
+
+// Receives messages and does nothing, cost of delivery is cost of RRReporter.
+class NullReporter : public RRReporter
+{
+public:
+	virtual void customReport(RRReportType type, int indentation, const char* message) override
+	{
+	}
+};
+
+struct StressTestResult
+{
+	double seconds;
+	unsigned numMessages, numOutOfOrder, numWarnings, numSuppressionNotices;
+	unsigned numTemporary, numTemporaryMessages;
+};
+
+static StressTestResult stressTest(bool asynchronous)
+{
+	MessageCounters persistentCounters, temporaryCounters;
+	CheckingReporter* persistent = new CheckingReporter(persistentCounters);
+	StressTestResult result = {0,0,0,0,0,0,0};
+	std::atomic<unsigned> numRunning(NUM_THREADS);
+	RRTime time;
+
+	std::vector<std::thread> threads;
+	for (unsigned t=0;t<NUM_THREADS;t++)
+		threads.push_back(std::thread([t,asynchronous,&numRunning]()
+		{
+			for (unsigned i=0;i<MESSAGES_PER_THREAD;i++)
+			{
+				RRReporter::report(INF3,"stress %d %d\n",t,i);
+				if (i%(MESSAGES_PER_THREAD/WARNINGS_PER_THREAD)==0)
+					RRReporter::report(WARN,"stress warning, %s\n",asynchronous?"asynchronous":"synchronous");
+				if (i%100==0)
+					std::this_thread::yield(); // let reporters be created and deleted even on single core
+			}
+			numRunning--;
+		}));
+	// meanwhile create and delete reporters
+	while (numRunning)
+	{
+		CheckingReporter* temporary = new CheckingReporter(temporaryCounters);
+		std::this_thread::yield();
+		delete temporary;
+		result.numTemporary++;
+	}
+	for (unsigned t=0;t<NUM_THREADS;t++)
+		threads[t].join();
+	result.seconds = time.secondsPassed();
+	RRReporter::flush();
+	delete persistent;
+	result.numMessages = persistentCounters.numMessages;
+	result.numOutOfOrder = persistentCounters.numOutOfOrder+temporaryCounters.numOutOfOrder;
+	result.numWarnings = persistentCounters.numWarnings;
+	result.numSuppressionNotices = persistentCounters.numSuppressionNotices;
+	result.numTemporaryMessages = temporaryCounters.numMessages;
+	return result;
+}
+
+// Returns nanoseconds per report() call, including flush() when asynchronous.
+static double measureReport(RRReportType type, bool allThreads)
+{
+	RRTime time;
+	if (allThreads)
+	{
+		#pragma omp parallel for
+		for (int i=0;i<NUM_BENCHMARK_MESSAGES;i++)
+			RRReporter::report(type,"benchmark message %d, %f\n",i,i*0.5f);
+	}
+	else
+	{
+		for (int i=0;i<NUM_BENCHMARK_MESSAGES;i++)
+			RRReporter::report(type,"benchmark message %d, %f\n",i,i*0.5f);
+	}
+	RRReporter::flush();
+	return time.secondsPassed()*1e9/NUM_BENCHMARK_MESSAGES;
+}
+
+void benchmarkReporter(RRReporter*& printfReporter)
+{
+	bool warnings, timing;
+	unsigned infLevel;
+	RRReporter::getFilter(warnings,infLevel,timing);
+	RRReporter::report(INF1,"RRReporter stress test, console output is off meanwhile:\n");
+
+	// messages of stress test are not printed, reporter is recreated for results
+	RRReporter::setFilter(true,3,timing);
+	delete printfReporter;
+	StressTestResult results[2];
+	for (unsigned asynchronous=0;asynchronous<2;asynchronous++)
+	{
+		RRReporter::setAsynchronous(asynchronous!=0);
+		results[asynchronous] = stressTest(asynchronous!=0);
+	}
+	RRReporter::setAsynchronous(false);
+	printfReporter = RRReporter::createPrintfReporter();
+	for (unsigned asynchronous=0;asynchronous<2;asynchronous++)
+	{
+		const StressTestResult& r = results[asynchronous];
+		RRReporter::report(INF1,"  %-12s %d threads, %d messages in %.2fs, %d reporters created and deleted meanwhile, they received %d messages\n",asynchronous?"asynchronous":"synchronous",NUM_THREADS,NUM_THREADS*MESSAGES_PER_THREAD,r.seconds,r.numTemporary,r.numTemporaryMessages);
+		RRReporter::report((r.numMessages==NUM_THREADS*MESSAGES_PER_THREAD)?INF1:ERRO,"    messages received after flush  %d/%d\n",r.numMessages,NUM_THREADS*MESSAGES_PER_THREAD);
+		RRReporter::report(r.numOutOfOrder?ERRO:INF1,"    messages out of order          %d\n",r.numOutOfOrder);
+		RRReporter::report((r.numWarnings==MAX_REPEATED_WARNINGS && r.numSuppressionNotices==1)?INF1:ERRO,"    repeated warning               %d of %d delivered, %d suppression notices\n",r.numWarnings,NUM_THREADS*WARNINGS_PER_THREAD,r.numSuppressionNotices);
+	}
+	RRReporter::report(INF1,"RRReporter cost per message:\n");
+	delete printfReporter;
+
+	// cost is measured with one reporter that does nothing (plus error counter)
+	double ns[2][3];
+	{
+		NullReporter nullReporter;
+		for (unsigned asynchronous=0;asynchronous<2;asynchronous++)
+		{
+			RRReporter::setAsynchronous(asynchronous!=0);
+			ns[asynchronous][0] = measureReport(INF3,false);
+			ns[asynchronous][1] = measureReport(INF3,true);
+		}
+		RRReporter::setAsynchronous(false);
+		RRReporter::setFilter(warnings,infLevel,timing);
+		ns[0][2] = measureReport(INF3,false);
+	}
+	printfReporter = RRReporter::createPrintfReporter();
+	for (unsigned asynchronous=0;asynchronous<2;asynchronous++)
+		RRReporter::report(INF1,"  %-12s %6.0fns in 1 thread, %6.0fns in %d threads\n",asynchronous?"asynchronous":"synchronous",ns[asynchronous][0],ns[asynchronous][1],omp_get_max_threads());
+	RRReporter::report(INF1,"  %-12s %6.0fns\n","filtered out",ns[0][2]);
+}
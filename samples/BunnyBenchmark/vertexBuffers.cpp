@@ -0,0 +1,244 @@
+// --------------------------------------------------------------------------
+// BunnyBenchmark vertexbuffers
+//
+// Realtime per-vertex indirect illumination of scene with many small objects,
+// vertex buffers of all objects updated at once by updateLightmaps() vs one by one by updateLightmap()
+// vs reference built from public API the way it was built before buffers were updated at once
+// (serial walk over multiobject triangles, last triangle of vertex wins, solver's getTriangleMeasure()).
+// All three must be identical, with default solver and with Fireball, in float and byte buffers.
+// Measures update time of both with 100 to 20000 objects.
+// --------------------------------------------------------------------------
+
+#include "BunnyBenchmark.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+enum
+{
+	LAYER_REALTIME = 0,
+	BIG_TILE_QUADS = 64, // 4225 vertices, more than one chunk of flattened range
+};
+
+// Floor and ceiling of small tiles, each tile is separate object with its own grid of quads, lit by point light.
+struct TileScene
+{
+	std::vector<RRMeshArrays*> meshes;
+	RRObjects objects;
+	RRMaterial* material;
+	RRLights lights;
+	RRSolver* solver;
+
+	// bigTiles adds big tile every 50 objects, otherwise tiles have 1..maxQuads quads per side
+	TileScene(unsigned numObjects, unsigned maxQuads, bool bigTiles, bool fireball)
+	{
+		material = new RRMaterial;
+		material->reset(false);
+		unsigned tilesPerSide = (unsigned)ceil(sqrt(numObjects/2.));
+		RRReal tileSize = 4.f/tilesPerSide;
+		srand(numObjects);
+		RRReporter::setFilter(true,0,false);
+		bool aborting = false;
+		for (unsigned o=0;o<numObjects;o++)
+		{
+			bool ceiling = o&1;
+			unsigned tile = o/2;
+			unsigned quads = (bigTiles && o%50==25) ? BIG_TILE_QUADS : 1+rand()%maxQuads;
+			RRMeshArrays* mesh = new RRMeshArrays;
+			RRVector<unsigned> texcoords;
+			texcoords.push_back(0);
+			mesh->resizeMesh(quads*quads*2,(quads+1)*(quads+1),&texcoords,false,false);
+			for (unsigned i=0;i<=quads;i++)
+				for (unsigned j=0;j<=quads;j++)
+				{
+					unsigned v = i*(quads+1)+j;
+					mesh->position[v] = RRVec3((tile%tilesPerSide+(RRReal)i/quads)*tileSize,ceiling?1.f:0.f,(tile/tilesPerSide+(RRReal)j/quads)*tileSize);
+					mesh->normal[v] = RRVec3(0,ceiling?-1.f:1.f,0);
+					mesh->texcoord[0][v] = RRVec2((RRReal)i/quads,(RRReal)j/quads);
+				}
+			unsigned t = 0;
+			for (unsigned i=0;i<quads;i++)
+				for (unsigned j=0;j<quads;j++)
+				{
+					unsigned a = i*(quads+1)+j, b = a+1, c = a+quads+1, d = c+1;
+					mesh->triangle[t++] = ceiling ? RRMeshArrays::Triangle{a,c,b} : RRMeshArrays::Triangle{a,b,c};
+					mesh->triangle[t++] = ceiling ? RRMeshArrays::Triangle{b,c,d} : RRMeshArrays::Triangle{b,d,c};
+				}
+			RRObject* object = new RRObject;
+			object->setCollider(RRCollider::create(mesh,nullptr,RRCollider::IT_BVH_FAST,aborting));
+			object->faceGroups.push_back(RRObject::FaceGroup(material,t));
+			meshes.push_back(mesh);
+			objects.push_back(object);
+		}
+		lights.push_back(RRLight::createPointLight(RRVec3(1.5f,0.5f,2.5f),RRVec3(1)));
+		solver = new RRSolver;
+		solver->setStaticObjects(objects,nullptr);
+		solver->setLights(lights);
+		if (fireball)
+			solver->buildFireball(100,"");
+		solver->detectDirectIlluminationCPU();
+		for (unsigned i=0;i<5;i++)
+			solver->calculate();
+		RRReporter::setFilter(true,1,false);
+	}
+
+	// Creates vertex buffers in realtime layer of all objects.
+	void allocateBuffers(RRBufferFormat format)
+	{
+		for (unsigned o=0;o<objects.size();o++)
+		{
+			delete objects[o]->illumination.getLayer(LAYER_REALTIME);
+			objects[o]->illumination.getLayer(LAYER_REALTIME) = RRBuffer::create(BT_VERTEX_BUFFER,meshes[o]->numVertices,1,1,format,format!=BF_RGBF,nullptr);
+		}
+	}
+
+	// Updates realtime layer of all objects at once, returns seconds.
+	double updateAtOnce()
+	{
+		RRReporter::setFilter(true,0,false);
+		RRTime time;
+		solver->updateLightmaps(LAYER_REALTIME,-1,-1,nullptr,nullptr);
+		double seconds = time.secondsPassed();
+		RRReporter::setFilter(true,1,false);
+		return seconds;
+	}
+
+	// Updates realtime layer of objects one by one, returns seconds.
+	double updateOneByOne()
+	{
+		RRReporter::setFilter(true,0,false);
+		RRTime time;
+		for (unsigned o=0;o<objects.size();o++)
+			solver->updateLightmap(o,objects[o]->illumination.getLayer(LAYER_REALTIME),nullptr,nullptr,nullptr);
+		double seconds = time.secondsPassed();
+		RRReporter::setFilter(true,1,false);
+		return seconds;
+	}
+
+	~TileScene()
+	{
+		delete solver;
+		delete lights[0];
+		for (unsigned o=0;o<objects.size();o++)
+		{
+			delete objects[o]->getCollider();
+			delete objects[o]; // deletes realtime layer
+			delete meshes[o];
+		}
+		delete material;
+	}
+};
+
+// Fills buffers of the same format as realtime layers with values looked up the way they were before update at once.
+static std::vector<RRBuffer*> createReference(const TileScene& scene)
+{
+	struct TriangleVertex
+	{
+		unsigned triangle;
+		unsigned vertex;
+	};
+	std::vector<std::vector<TriangleVertex> > lookup(scene.objects.size());
+	for (unsigned o=0;o<scene.objects.size();o++)
+		lookup[o].resize(scene.meshes[o]->numVertices,TriangleVertex{RRMesh::UNDEFINED,RRMesh::UNDEFINED});
+	const RRMesh* multiMesh = scene.solver->getMultiObject()->getCollider()->getMesh();
+	for (unsigned t=0;t<multiMesh->getNumTriangles();t++)
+	{
+		RRMesh::Triangle triangle;
+		multiMesh->getTriangle(t,triangle);
+		for (unsigned v=0;v<3;v++)
+		{
+			RRMesh::PreImportNumber preImportVertex = multiMesh->getPreImportVertex(triangle[v],t);
+			lookup[preImportVertex.object][preImportVertex.index] = TriangleVertex{t,v};
+		}
+	}
+	std::vector<RRBuffer*> reference;
+	for (unsigned o=0;o<scene.objects.size();o++)
+	{
+		const RRBuffer* layer = scene.objects[o]->illumination.getLayer(LAYER_REALTIME);
+		RRBuffer* buffer = RRBuffer::create(BT_VERTEX_BUFFER,layer->getWidth(),1,1,layer->getFormat(),layer->getScaled(),nullptr);
+		RRRadiometricMeasure measure = RM_IRRADIANCE_CUSTOM_INDIRECT;
+		measure.scaled = buffer->getScaled();
+		for (unsigned i=0;i<lookup[o].size();i++)
+		{
+			RRVec3 irradiance(0);
+			if (lookup[o][i].triangle!=RRMesh::UNDEFINED)
+				scene.solver->getTriangleMeasure(lookup[o][i].triangle,lookup[o][i].vertex,measure,irradiance);
+			buffer->setElement(i,RRVec4(irradiance,0),nullptr);
+		}
+		reference.push_back(buffer);
+	}
+	return reference;
+}
+
+// Returns number of objects whose realtime layer differs from reference.
+static unsigned compare(const TileScene& scene, const std::vector<RRBuffer*>& reference)
+{
+	unsigned numDifferent = 0;
+	for (unsigned o=0;o<scene.objects.size();o++)
+	{
+		RRBuffer* a = scene.objects[o]->illumination.getLayer(LAYER_REALTIME);
+		RRBuffer* b = reference[o];
+		if (memcmp(a->lock(BL_READ),b->lock(BL_READ),a->getBufferBytes()))
+			numDifferent++;
+		a->unlock();
+		b->unlock();
+	}
+	return numDifferent;
+}
+
+static void testEquality()
+{
+	RRReporter::report(INF1,"Realtime vertex buffers at once vs one by one vs reference, 1000 tiles, big tile every 50:\n");
+	for (unsigned fireball=0;fireball<2;fireball++)
+	{
+		TileScene scene(1000,6,true,fireball!=0);
+		RRBufferFormat formats[] = {BF_RGBF,BF_RGB};
+		for (unsigned f=0;f<2;f++)
+		{
+			scene.allocateBuffers(formats[f]);
+			scene.updateAtOnce();
+			std::vector<RRBuffer*> reference = createReference(scene);
+			unsigned numDifferentAtOnce = compare(scene,reference);
+			scene.allocateBuffers(formats[f]);
+			scene.updateOneByOne();
+			unsigned numDifferentOneByOne = compare(scene,reference);
+			RRVec3 sum(0);
+			unsigned numVertices = 0;
+			for (unsigned o=0;o<reference.size();o++)
+			{
+				for (unsigned i=0;i<reference[o]->getWidth();i++)
+					sum += reference[o]->getElement(i,nullptr);
+				numVertices += reference[o]->getWidth();
+				delete reference[o];
+			}
+			bool ok = !numDifferentAtOnce && !numDifferentOneByOne && sum.sum()>0;
+			RRReporter::report(ok?INF1:ERRO,"  %-8s %s  %d vertices  %d objects differ at once, %d one by one  average %f\n",
+				fireball?"fireball":"default",(f==0)?"RGBF":"RGB ",numVertices,numDifferentAtOnce,numDifferentOneByOne,sum.avg()/numVertices);
+		}
+	}
+}
+
+static void benchmarkUpdate()
+{
+	RRReporter::report(INF1,"Realtime vertex buffers update time, tiles with 1..2 quads per side:\n");
+	for (unsigned fireball=0;fireball<2;fireball++)
+	for (unsigned numObjects=100;numObjects<=20000;numObjects=(numObjects==10000)?20000:numObjects*10)
+	{
+		TileScene scene(numObjects,2,false,fireball!=0);
+		scene.allocateBuffers(BF_RGBF);
+		double oneByOne = 1e10, atOnce = 1e10;
+		for (unsigned i=0;i<5;i++)
+		{
+			oneByOne = RR_MIN(oneByOne,scene.updateOneByOne());
+			atOnce = RR_MIN(atOnce,scene.updateAtOnce());
+		}
+		RRReporter::report(INF1,"  %-8s %5d objects  one by one %8.3f ms  at once %8.3f ms  speedup %.2fx\n",fireball?"fireball":"default",numObjects,oneByOne*1000,atOnce*1000,oneByOne/atOnce);
+	}
+}
+
+void benchmarkVertexBuffers()
+{
+	testEquality();
+	benchmarkUpdate();
+}
@@ -86,11 +86,12 @@ int main(int argc, char** argv)
 	solver->updateLightmaps(0,1,4,&params,nullptr);
 
 	// save GI lightmaps, bent normals
-	solver->getStaticObjects().saveLayer(0,"../../data/scenes/koupelna/koupelna4-windows_precalculated/","png");
-	solver->getStaticObjects().saveLayer(1,"../../data/scenes/koupelna/koupelna4-windows_precalculated/","directional1.png");
-	solver->getStaticObjects().saveLayer(2,"../../data/scenes/koupelna/koupelna4-windows_precalculated/","directional2.png");
-	solver->getStaticObjects().saveLayer(3,"../../data/scenes/koupelna/koupelna4-windows_precalculated/","directional3.png");
-	solver->getStaticObjects().saveLayer(4,"../../data/scenes/koupelna/koupelna4-windows_precalculated/","bentnormals.png");
+	// (0 = all threads, savers registered by rr_io::registerIO() are thread safe)
+	solver->getStaticObjects().saveLayer(0,"../../data/scenes/koupelna/koupelna4-windows_precalculated/","png",0);
+	solver->getStaticObjects().saveLayer(1,"../../data/scenes/koupelna/koupelna4-windows_precalculated/","directional1.png",0);
+	solver->getStaticObjects().saveLayer(2,"../../data/scenes/koupelna/koupelna4-windows_precalculated/","directional2.png",0);
+	solver->getStaticObjects().saveLayer(3,"../../data/scenes/koupelna/koupelna4-windows_precalculated/","directional3.png",0);
+	solver->getStaticObjects().saveLayer(4,"../../data/scenes/koupelna/koupelna4-windows_precalculated/","bentnormals.png",0);
 
 	// release memory
 	delete solver;
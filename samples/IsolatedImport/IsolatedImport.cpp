@@ -0,0 +1,171 @@
+// --------------------------------------------------------------------------
+// IsolatedImport sample
+//
+// Imports scenes in isolated processes (see rr_io::isolateIO()).
+// Bundled scenes are converted at once by rr_io::convertIsolated() into cache,
+// then it checks that
+// - second import uses cache instead of converting again
+// - editing file referenced by scene (.obj material library) makes it convert again
+// - converter that crashes or hangs does not bring our process down
+//
+// This program is also its own isolated converter. To test crashes,
+// it crashes when converting file named crash.*, and hangs on file named hang.*.
+//
+// Prints result of each check, exit code is number of failed checks.
+// --------------------------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include "Lightsprint/RRScene.h"
+#include "Lightsprint/IO/IO.h"
+
+namespace bf = std::filesystem;
+
+enum
+{
+	TIMEOUT_SECONDS = 5,
+};
+
+static unsigned s_numFailed = 0;
+
+static void check(bool ok, const char* what)
+{
+	printf("%s %s\n",ok?"ok    ":"FAILED",what);
+	if (!ok)
+		s_numFailed++;
+}
+
+// Stand-in for buggy importer, runs in isolated process.
+static void simulateBuggyConverter(int argc, char** argv)
+{
+	if (argc==4 && !strcmp(argv[1],"-isolated-conversion"))
+	{
+		std::string name = bf::path(argv[2]).stem().string();
+		if (name=="crash")
+			*(volatile int*)nullptr = 0;
+		if (name=="hang")
+			std::this_thread::sleep_for(std::chrono::hours(1));
+	}
+}
+
+static unsigned getNumFiles(const bf::path& directory)
+{
+	std::error_code ec;
+	unsigned numFiles = 0;
+	for (bf::directory_iterator i(directory,ec),end;!ec && i!=end;i.increment(ec))
+		numFiles++;
+	return numFiles;
+}
+
+static unsigned getNumTriangles(const rr::RRScene& scene)
+{
+	unsigned numTriangles = 0;
+	for (unsigned i=0;i<scene.objects.size();i++)
+		numTriangles += scene.objects[i]->getCollider()->getMesh()->getNumTriangles();
+	return numTriangles;
+}
+
+int main(int argc, char** argv)
+{
+	simulateBuggyConverter(argc,argv);
+
+	// check for version mismatch
+	if (!RR_INTERFACE_OK)
+	{
+		printf(RR_INTERFACE_MISMATCH_MSG);
+		return 1;
+	}
+	// log messages to console
+	rr::RRReporter* reporter = rr::RRReporter::createPrintfReporter();
+
+	rr_io::registerIO(argc,argv);
+	// when we run as isolated converter, this converts scene and exits
+	rr_io::isolateIO(argc,argv);
+
+	// start with empty cache
+	bf::path data = "../../data/scenes";
+	bf::path work = bf::temp_directory_path() / "IsolatedImport";
+	bf::path cache = work / "cache";
+	std::error_code ec;
+	bf::remove_all(work,ec);
+	bf::create_directories(work,ec);
+	rr_io::setIsolation(0,TIMEOUT_SECONDS,RR_PATH2RR(cache));
+
+	// convert bundled scenes at once
+	const char* scenes[] = {"koupelna/koupelna4.dae","koupelna/koupelna4.3DS","koupelna/koupelna5.3DS","sponza/sponza.3DS"};
+	const unsigned numScenes = sizeof(scenes)/sizeof(scenes[0]);
+	rr::RRString filenames[numScenes];
+	for (unsigned i=0;i<numScenes;i++)
+		filenames[i] = RR_PATH2RR(data/scenes[i]);
+	rr::RRTime time;
+	unsigned numConverted = rr_io::convertIsolated(filenames,numScenes);
+	float conversionSeconds = time.secondsPassed();
+	printf("%d bundled scenes converted in %.2fs.\n",numConverted,conversionSeconds);
+	check(numConverted==numScenes,"bundled scenes converted in isolated processes");
+
+	// convert again, everything is in cache
+	time.setNow();
+	check(rr_io::convertIsolated(filenames,numScenes)==numConverted && time.secondsPassed()<conversionSeconds/2,"second conversion finds scenes in cache");
+	check(getNumFiles(cache)==numConverted,"cache contains one file per scene");
+	for (unsigned i=0;i<numScenes;i++)
+	{
+		time.setNow();
+		rr::RRScene scene(filenames[i]);
+		printf("%s: %d objects, %d triangles, loaded in %.2fs.\n",scenes[i],(int)scene.objects.size(),getNumTriangles(scene),time.secondsPassed());
+		check(getNumTriangles(scene)>0,"scene loaded from cache");
+	}
+	check(getNumFiles(cache)==numConverted,"loading scenes did not convert them again");
+
+	// edit material library of .obj, conversion from cache must not be used
+	bf::path obj = work / "triangle.obj";
+	std::ofstream(work/"triangle.mtl") << "newmtl red\nKd 1 0 0\n";
+	std::ofstream(obj) << "mtllib triangle.mtl\nusemtl red\nv 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n";
+	rr::RRString objFilename = RR_PATH2RR(obj);
+	if (!rr_io::convertIsolated(&objFilename,1))
+		printf("skipped .obj test, .obj is not supported.\n");
+	else
+	{
+		unsigned numCached = getNumFiles(cache);
+		std::ofstream(work/"triangle.mtl") << "newmtl red\nKd 0 1 0\n";
+		check(rr_io::convertIsolated(&objFilename,1)==1 && getNumFiles(cache)==numCached+1,"editing .mtl converts .obj again");
+	}
+
+	// crashing converter
+	bf::copy_file(data/scenes[1],work/"crash.3ds",ec);
+	rr::RRString crashFilename = RR_PATH2RR(work/"crash.3ds");
+	{
+		rr::RRScene scene(crashFilename);
+		check(!scene.objects.size(),"scene with crashing converter is not imported");
+	}
+	{
+		time.setNow();
+		rr::RRScene scene(crashFilename);
+		check(!scene.objects.size() && time.secondsPassed()<1,"converter that crashed is not run again");
+	}
+
+	// hanging converter (cache is content addressed, file must differ from crash.3ds)
+	bf::copy_file(data/scenes[2],work/"hang.3ds",ec);
+	{
+		time.setNow();
+		rr::RRScene scene(RR_PATH2RR(work/"hang.3ds"));
+		float seconds = time.secondsPassed();
+		check(!scene.objects.size() && seconds>=TIMEOUT_SECONDS && seconds<TIMEOUT_SECONDS+5,"hanging converter is killed after timeout");
+	}
+
+	// good scenes still convert next to crashing one
+	bf::copy_file(data/scenes[3],work/"copy.3ds",ec);
+	rr::RRString mixedFilenames[2] = {crashFilename,RR_PATH2RR(work/"copy.3ds")};
+	check(rr_io::convertIsolated(mixedFilenames,2)==1,"crashing converter does not stop other conversions");
+
+	bf::remove_all(work,ec);
+	if (s_numFailed)
+		printf("%d checks failed.\n",s_numFailed);
+	else
+		printf("All checks passed.\n");
+	delete reporter;
+	return s_numFailed;
+}
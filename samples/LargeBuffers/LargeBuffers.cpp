@@ -0,0 +1,94 @@
+// --------------------------------------------------------------------------
+// LargeBuffers sample
+//
+// Creates buffers bigger than 4GiB and checks that elements past 4GiB
+// round-trip through setElement()/getElement() and land at the right
+// place in memory, and that buffer with too many elements is refused.
+//
+// New buffers are zeroed by OS, pages that are never written take no
+// physical memory, so it runs on machines with less than 4GiB of free RAM
+// (with overcommit enabled, default on Linux).
+//
+// Prints result of each check, exit code is number of failed checks.
+// --------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstring>
+#include "Lightsprint/RRBuffer.h"
+#include "Lightsprint/RRDebug.h"
+
+using namespace rr;
+
+static unsigned s_numFailed = 0;
+
+static void check(bool ok, const char* what)
+{
+	printf("%s %s\n",ok?"ok    ":"FAILED",what);
+	if (!ok)
+		s_numFailed++;
+}
+
+// Writes distinct values to first element, element right after 4GiB and last element, reads them back.
+static void checkRoundTrip(RRBufferType type, unsigned width, unsigned height, unsigned depth, RRBufferFormat format, const char* name)
+{
+	char what[200];
+	RRBuffer* buffer = RRBuffer::create(type,width,height,depth,format,false,nullptr);
+	sprintf(what,"%s %ux%ux%u created",name,width,height,depth);
+	check(buffer!=nullptr,what);
+	if (!buffer)
+		return;
+
+	size_t elementBytes = buffer->getElementBits()/8;
+	unsigned numElements = width*height*depth;
+	sprintf(what,"%s has %s",name,RRReporter::bytesToString(buffer->getBufferBytes()));
+	check(buffer->getBufferBytes()==numElements*elementBytes && buffer->getBufferBytes()>((size_t)1<<32),what);
+
+	unsigned indices[3] = {0, (unsigned)((((size_t)1<<32)+elementBytes-1)/elementBytes), numElements-1};
+	RRVec4 values[3] = {RRVec4(1,2,3,4), RRVec4(5,6,7,8), RRVec4(9,10,11,12)};
+	for (unsigned i=0;i<3;i++)
+		buffer->setElement(indices[i],values[i],nullptr);
+	bool ok = true;
+	for (unsigned i=0;i<3;i++)
+	{
+		RRVec4 element = buffer->getElement(indices[i],nullptr);
+		for (unsigned c=0;c<3;c++)
+			ok &= element[c]==values[i][c];
+	}
+	sprintf(what,"%s elements past 4GiB round-trip",name);
+	check(ok,what);
+
+	// float formats store elements as floats, check their location in memory
+	const unsigned char* data = buffer->lock(BL_READ);
+	ok = data!=nullptr;
+	for (unsigned i=0;data && i<3;i++)
+		ok &= !memcmp(data+indices[i]*elementBytes,&values[i],elementBytes);
+	buffer->unlock();
+	sprintf(what,"%s elements past 4GiB stored at 64bit offsets",name);
+	check(ok,what);
+
+	delete buffer;
+}
+
+int main()
+{
+	RRReporter* reporter = RRReporter::createPrintfReporter();
+
+	if (sizeof(size_t)<8)
+	{
+		printf("Buffers over 4GiB need 64bit build, skipped.\n");
+		delete reporter;
+		return 0;
+	}
+
+	checkRoundTrip(BT_2D_TEXTURE,16448,16448,1,BF_RGBAF,"2d texture");
+	checkRoundTrip(BT_CUBE_TEXTURE,8192,8192,6,BF_RGBF,"cube texture");
+	checkRoundTrip(BT_VERTEX_BUFFER,400000000,1,1,BF_RGBF,"vertex buffer");
+
+	// 4G elements don't fit in 32bit element index
+	RRBuffer* tooBig = RRBuffer::create(BT_2D_TEXTURE,65536,65536,1,BF_LUMINANCE,false,nullptr);
+	check(tooBig==nullptr,"buffer with 4G elements refused");
+	delete tooBig;
+
+	delete reporter;
+	return s_numFailed;
+}
@@ -219,8 +219,9 @@ void character_callback(GLFWwindow* window, unsigned int codepoint)
 
 		case 's':
 			// save current indirect illumination (static snapshot) to disk
-			solver->getStaticObjects().saveLayer(LAYER_OFFLINE_PIXEL,"../../data/scenes/koupelna/koupelna4_precalculated/","png");
-			solver->getStaticObjects().saveLayer(LAYER_OFFLINE_VERTEX,"../../data/scenes/koupelna/koupelna4_precalculated/","rrbuffer");
+			// (0 = all threads, savers registered by rr_io::registerIO() are thread safe)
+			solver->getStaticObjects().saveLayer(LAYER_OFFLINE_PIXEL,"../../data/scenes/koupelna/koupelna4_precalculated/","png",0);
+			solver->getStaticObjects().saveLayer(LAYER_OFFLINE_VERTEX,"../../data/scenes/koupelna/koupelna4_precalculated/","rrbuffer",0);
 			if (lightField)
 				lightField->save("../../data/scenes/koupelna/koupelna4_precalculated/lightfield.lf");
 			break;
@@ -228,8 +229,8 @@ void character_callback(GLFWwindow* window, unsigned int codepoint)
 		case 'l':
 			// load static snapshot of indirect illumination from disk, stop realtime updates
 			{
-				solver->getStaticObjects().loadLayer(LAYER_OFFLINE_PIXEL,"../../data/scenes/koupelna/koupelna4_precalculated/","png");
-				solver->getStaticObjects().loadLayer(LAYER_OFFLINE_VERTEX,"../../data/scenes/koupelna/koupelna4_precalculated/","rrbuffer");
+				solver->getStaticObjects().loadLayer(LAYER_OFFLINE_PIXEL,"../../data/scenes/koupelna/koupelna4_precalculated/","png",0);
+				solver->getStaticObjects().loadLayer(LAYER_OFFLINE_VERTEX,"../../data/scenes/koupelna/koupelna4_precalculated/","rrbuffer",0);
 				delete lightField;
 				lightField = rr::RRLightField::load("../../data/scenes/koupelna/koupelna4_precalculated/lightfield.lf");
 				// start rendering loaded maps
@@ -0,0 +1,295 @@
+// --------------------------------------------------------------------------
+// VideoDecode sample
+//
+// Encodes synthetic clips with FFmpeg, each frame shows its number in binary,
+// then plays them through rr::RRBuffer::load() (FFmpeg/libav player in LightsprintIO)
+// and checks that
+// - frames are shown in order, up to the last frame (with frame threading,
+//   decoder holds last frames until it is drained), then playback loops to frame 0
+// - seeks back and forth while paused show the requested frame
+// - both work with single threaded decoder and with decoder threads
+// It also measures decode throughput on clip with more frames per second
+// than decoder can deliver.
+//
+// Bands of frame are converted to RGB in parallel by OpenMP threads,
+// run with OMP_NUM_THREADS=4 on machines with less cores to test it.
+//
+// Prints result of each check, exit code is number of failed checks.
+// --------------------------------------------------------------------------
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+#include "Lightsprint/RRBuffer.h"
+#include "Lightsprint/IO/IO.h"
+
+// clips are encoded by FFmpeg directly, it needs FFmpeg 3.1 or newer
+extern "C"
+{
+	#include <libavcodec/avcodec.h>
+	#include <libavformat/avformat.h>
+	#include <libavutil/cpu.h>
+}
+#pragma comment(lib,"avcodec.lib")
+#pragma comment(lib,"avformat.lib")
+#pragma comment(lib,"avutil.lib")
+
+namespace bf = std::filesystem;
+
+enum
+{
+	NUM_BITS = 12, // frame number has up to 12 bits
+	CELL = 32, // size of cell with one bit, aligned to macroblocks
+	TIMEOUT_SECONDS = 5,
+};
+
+static unsigned s_numFailed = 0;
+
+static void check(bool ok, const char* what)
+{
+	printf("%s %s\n",ok?"ok    ":"FAILED",what);
+	if (!ok)
+		s_numFailed++;
+}
+
+// Sends frame to encoder (nullptr flushes it), writes packets it returns.
+static void encode(AVFormatContext* avFormatContext, AVStream* avStream, AVCodecContext* avCodecContext, AVFrame* avFrame, AVPacket* avPacket)
+{
+	avcodec_send_frame(avCodecContext,avFrame);
+	while (!avcodec_receive_packet(avCodecContext,avPacket))
+	{
+		av_packet_rescale_ts(avPacket,avCodecContext->time_base,avStream->time_base);
+		avPacket->stream_index = avStream->index;
+		av_interleaved_write_frame(avFormatContext,avPacket);
+	}
+}
+
+// Encodes MPEG-4 clip with B-frames. Top row of frame i shows i in binary (white cell = 1),
+// followed by white and black cell that mark valid frame. The rest is moving pattern, so that decoder has work to do.
+static bool writeClip(const bf::path& filename, unsigned width, unsigned height, unsigned fps, unsigned numFrames)
+{
+	const AVCodec* avCodec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+	AVFormatContext* avFormatContext = nullptr;
+	if (!avCodec || avformat_alloc_output_context2(&avFormatContext,nullptr,nullptr,filename.string().c_str())<0)
+		return false;
+	AVStream* avStream = avformat_new_stream(avFormatContext,nullptr);
+	AVCodecContext* avCodecContext = avcodec_alloc_context3(avCodec);
+	avCodecContext->width = width;
+	avCodecContext->height = height;
+	avCodecContext->pix_fmt = AV_PIX_FMT_YUV420P;
+	avCodecContext->time_base = av_make_q(1,fps);
+	avCodecContext->gop_size = 12;
+	avCodecContext->max_b_frames = 2;
+	avCodecContext->bit_rate = (int64_t)width*height*fps/2;
+	avCodecContext->qmax = 8;
+	if (avFormatContext->oformat->flags & AVFMT_GLOBALHEADER)
+		avCodecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+	bool ok = avStream && !avcodec_open2(avCodecContext,avCodec,nullptr)
+		&& avcodec_parameters_from_context(avStream->codecpar,avCodecContext)>=0
+		&& avio_open(&avFormatContext->pb,filename.string().c_str(),AVIO_FLAG_WRITE)>=0;
+	if (ok)
+	{
+		avStream->time_base = avCodecContext->time_base;
+		ok = avformat_write_header(avFormatContext,nullptr)>=0;
+	}
+	if (ok)
+	{
+		AVFrame* avFrame = av_frame_alloc();
+		avFrame->format = AV_PIX_FMT_YUV420P;
+		avFrame->width = width;
+		avFrame->height = height;
+		av_frame_get_buffer(avFrame,0);
+		AVPacket* avPacket = av_packet_alloc();
+		for (unsigned i=0;i<numFrames;i++)
+		{
+			av_frame_make_writable(avFrame);
+			for (unsigned y=0;y<height;y++)
+				for (unsigned x=0;x<width;x++)
+				{
+					unsigned cell = x/CELL;
+					avFrame->data[0][y*avFrame->linesize[0]+x] = (y>=CELL || cell>NUM_BITS+1)
+						? (uint8_t)(((x^y)+4*i)&255)
+						: ((cell<NUM_BITS) ? ((i>>cell)&1) : (cell==NUM_BITS)) ? 235 : 16;
+				}
+			for (unsigned p=1;p<3;p++)
+				for (unsigned y=0;y<height/2;y++)
+					for (unsigned x=0;x<width/2;x++)
+						avFrame->data[p][y*avFrame->linesize[p]+x] = (y>=CELL/2) ? (uint8_t)(128+((x+y+i)&63)-32) : 128;
+			avFrame->pts = i;
+			encode(avFormatContext,avStream,avCodecContext,avFrame,avPacket);
+		}
+		encode(avFormatContext,avStream,avCodecContext,nullptr,avPacket);
+		av_write_trailer(avFormatContext);
+		av_packet_free(&avPacket);
+		av_frame_free(&avFrame);
+	}
+	avio_closep(&avFormatContext->pb);
+	avcodec_free_context(&avCodecContext);
+	avformat_free_context(avFormatContext);
+	return ok;
+}
+
+// Returns number of visible frame, -1 if no frame is visible. Video buffer is upside down.
+static int getFrameNumber(rr::RRBuffer* video)
+{
+	unsigned width = video->getWidth();
+	unsigned rowStart = width*(video->getHeight()-1-CELL/2);
+	if (video->getElement(rowStart+NUM_BITS*CELL+CELL/2,nullptr)[1]<0.5f || video->getElement(rowStart+(NUM_BITS+1)*CELL+CELL/2,nullptr)[1]>0.5f)
+		return -1;
+	int number = 0;
+	for (unsigned b=0;b<NUM_BITS;b++)
+		if (video->getElement(rowStart+b*CELL+CELL/2,nullptr)[1]>0.5f)
+			number |= 1<<b;
+	return number;
+}
+
+// Plays video until it loops. Frames must come in order up to the last one, then from frame 0.
+static void checkPlayback(rr::RRBuffer* video, unsigned fps, unsigned numFrames, const char* name)
+{
+	char what[200];
+	int previous = -1;
+	int lastBeforeLoop = -1;
+	int firstAfterLoop = -1;
+	bool inOrder = true;
+	double decodedFps = 0;
+	rr::RRTime time;
+	video->play();
+	while (time.secondsPassed()<(float)numFrames/fps+TIMEOUT_SECONDS)
+	{
+		video->update();
+		int frame = getFrameNumber(video);
+		if (frame>=0 && frame!=previous)
+		{
+			if (frame<previous && lastBeforeLoop<0)
+			{
+				lastBeforeLoop = previous;
+				firstAfterLoop = frame;
+			}
+			else if (frame<previous)
+				inOrder = false;
+			if (frame==(int)numFrames-1 && lastBeforeLoop<0)
+			{
+				rr_io::VideoStatistics statistics;
+				if (rr_io::getVideoStatistics(video,statistics))
+					decodedFps = statistics.framesDecoded/time.secondsPassed();
+			}
+			previous = frame;
+			if (lastBeforeLoop>=0 && frame>=3)
+				break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	video->pause();
+	rr_io::VideoStatistics statistics;
+	if (rr_io::getVideoStatistics(video,statistics))
+		printf("%s: %d decoded, %d shown, %d dropped, %d late, decoded %.0f frames/s until last frame, clip has %d\n",
+			name,statistics.framesDecoded,statistics.framesShown,statistics.framesDropped,statistics.framesLate,decodedFps,fps);
+	sprintf(what,"%s frames shown in order",name);
+	check(inOrder && previous>=0,what);
+	sprintf(what,"%s last frame shown (%d of %d)",name,lastBeforeLoop,numFrames-1);
+	check(lastBeforeLoop==(int)numFrames-1,what);
+	sprintf(what,"%s loops to first frame (%d)",name,firstAfterLoop);
+	check(firstAfterLoop==0,what);
+}
+
+// Seeks paused video back and forth, requested frame must become visible and stay.
+static void checkSeeks(rr::RRBuffer* video, unsigned fps, unsigned numFrames, const char* name)
+{
+	unsigned targets[] = {numFrames/2, 3, numFrames-2, numFrames/4, numFrames/4+5, numFrames/4+4, 0};
+	for (unsigned i=0;i<sizeof(targets)/sizeof(targets[0]);i++)
+	{
+		// middle of frame, frames are shown when their time starts
+		video->seek((targets[i]+0.5f)/fps);
+		rr::RRTime time;
+		int frame = -1;
+		while (frame!=(int)targets[i] && time.secondsPassed()<TIMEOUT_SECONDS)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			video->update();
+			frame = getFrameNumber(video);
+		}
+		float seconds = time.secondsPassed();
+		for (unsigned j=0;j<50;j++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			video->update();
+		}
+		char what[200];
+		sprintf(what,"%s seek to frame %d shows frame %d (after %.3fs)",name,targets[i],getFrameNumber(video),seconds);
+		check(getFrameNumber(video)==(int)targets[i],what);
+	}
+}
+
+static void checkClip(const bf::path& filename, unsigned width, unsigned height, unsigned fps, unsigned numFrames, bool seeks)
+{
+	char name[100];
+	sprintf(name,"%s %dx%d %dfps",filename.filename().string().c_str(),width,height,fps);
+	check(writeClip(filename,width,height,fps,numFrames),name);
+	rr::RRBuffer* video = rr::RRBuffer::load(RR_PATH2RR(filename));
+	char what[200];
+	sprintf(what,"%s loaded, %.2fs",name,video?video->getDuration():0);
+	check(video && video->getWidth()==width && video->getHeight()==height && fabs(video->getDuration()-(float)numFrames/fps)<0.1f,what);
+	if (!video)
+		return;
+	checkPlayback(video,fps,numFrames,name);
+	if (seeks)
+		checkSeeks(video,fps,numFrames,name);
+	video->stop();
+	delete video;
+}
+
+int main(int argc, char** argv)
+{
+	// check for version mismatch
+	if (!RR_INTERFACE_OK)
+	{
+		printf(RR_INTERFACE_MISMATCH_MSG);
+		return 1;
+	}
+	// log messages to console
+	rr::RRReporter* reporter = rr::RRReporter::createPrintfReporter();
+
+	rr_io::registerIO(argc,argv);
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58,9,100)
+	av_register_all();
+#endif
+
+	bf::path work = bf::temp_directory_path() / "VideoDecode";
+	std::error_code ec;
+	bf::remove_all(work,ec);
+	bf::create_directories(work,ec);
+
+	// player lets FFmpeg pick number of decoder threads, it depends on number of cores
+	// (clips have different names in each pass, loaded videos stay cached with their decoder)
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57,0,100)
+	int numCores[] = {1, 4};
+#else
+	int numCores[] = {0};
+#endif
+	for (unsigned i=0;i<sizeof(numCores)/sizeof(numCores[0]);i++)
+	{
+		char prefix[20];
+		if (numCores[i])
+		{
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57,0,100)
+			av_cpu_force_count(numCores[i]);
+#endif
+			sprintf(prefix,"cores%d_",numCores[i]);
+			printf("Decoder threads for %d cores:\n",numCores[i]);
+		}
+		else
+			prefix[0] = 0;
+		checkClip(work/(std::string(prefix)+"order.mkv"),640,360,25,75,true);
+		checkClip(work/(std::string(prefix)+"throughput.mkv"),1280,720,1000,500,false);
+	}
+
+	bf::remove_all(work,ec);
+	if (s_numFailed)
+		printf("%d checks failed.\n",s_numFailed);
+	else
+		printf("All checks passed.\n");
+	delete reporter;
+	return s_numFailed;
+}
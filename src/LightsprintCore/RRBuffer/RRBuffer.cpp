@@ -11,6 +11,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <mutex>
 #include <string>
 #include <vector>
 #include "Lightsprint/RRBuffer.h"
@@ -65,6 +66,11 @@ RRVec4 RRBuffer::getElementAtPosition(const RRVec3& coord, const RRColorSpace* c
 	return RRVec4(0);
 }
 
+RRVec4 RRBuffer::getElementAtPositionMipmapped(const RRVec2& position, RRReal footprint, const RRColorSpace* colorSpace, bool interpolated) const
+{
+	return getElementAtPosition(RRVec3(position[0],position[1],0),colorSpace,interpolated);
+}
+
 RRVec4 RRBuffer::getElementAtDirection(const RRVec3& dir, const RRColorSpace* colorSpace) const
 {
 	RR_LIMITED_TIMES(1,RRReporter::report(WARN,"Default empty RRBuffer::getElementAtDirection() called.\n"));
@@ -121,12 +127,29 @@ bool RRBuffer::copyElementsTo(RRBuffer* destination, const RRColorSpace* colorSp
 	unsigned size = w*h*d;
 	const RRColorSpace* toCust = (!source->getScaled() && destination->getScaled()) ? colorSpace : nullptr;
 	const RRColorSpace* toPhys = (source->getScaled() && !destination->getScaled()) ? colorSpace : nullptr;
-	for (unsigned i=0;i<size;i++)
+	if (!toCust && !toPhys)
 	{
-		RRVec4 color = source->getElement(i,nullptr);
-		if (toCust) toCust->fromLinear(color); else
-		if (toPhys) toPhys->toLinear(color);
-		destination->setElement(i,color,nullptr);
+		for (unsigned i=0;i<size;i++)
+			destination->setElement(i,source->getElement(i,nullptr),nullptr);
+		return true;
+	}
+	// convert in chunks, array conversion is much faster than one color at a time
+	enum {CHUNK=256};
+	RRVec3 colors[CHUNK];
+	RRReal alphas[CHUNK];
+	for (unsigned i=0;i<size;i+=CHUNK)
+	{
+		unsigned num = RR_MIN(size-i,(unsigned)CHUNK);
+		for (unsigned j=0;j<num;j++)
+		{
+			RRVec4 color = source->getElement(i+j,nullptr);
+			colors[j] = color;
+			alphas[j] = color.w;
+		}
+		if (toCust) toCust->fromLinear(colors,num); else
+		toPhys->toLinear(colors,num);
+		for (unsigned j=0;j<num;j++)
+			destination->setElement(i+j,RRVec4(colors[j],alphas[j]),nullptr);
 	}
 	return true;
 }
@@ -235,6 +258,7 @@ void RRBuffer::setFormat(RRBufferFormat newFormat)
 			default:      flags = 0; break;
 		};
 		// uncompressed copy -> compressed this
+		RR_PROFILE_SCOPE("compression");
 		squish::CompressImage(copy->lock(BL_READ),getWidth(),getHeight(),lock(BL_DISCARD_AND_WRITE),flags);
 		unlock();
 		copy->unlock();
@@ -563,18 +587,41 @@ public:
 		}
 
 		// find triangles in vertices
+		// triangles in vertex v are trianglesInVertex[firstTriangleInVertex[v]..firstTriangleInVertex[v+1]-1], sorted
 		unsigned numVertices = mesh->getNumVertices();
 		unsigned numTriangles = mesh->getNumTriangles();
-		std::vector<std::vector<unsigned> > trianglesInVertex;
+		RRArena::Scope scope;
+		unsigned* firstTriangleInVertex = RRArena::getThreadArena().allocateArray<unsigned>(numVertices+1);
+		unsigned* trianglesInVertex = RRArena::getThreadArena().allocateArray<unsigned>(3*(size_t)numTriangles);
+		if (!firstTriangleInVertex || !trianglesInVertex)
+		{
+			RR_LIMITED_TIMES(10,RRReporter::report(WARN,"Unwrap seams won't be filtered.\n"));
+			if (mesh!=mesh0)
+				delete mesh;
+			return;
+		}
 		{
-			trianglesInVertex.resize(numVertices);
+			memset(firstTriangleInVertex,0,(numVertices+1)*sizeof(unsigned));
+			for (unsigned t=0;t<numTriangles;t++)
+			{
+				RRMesh::Triangle tri;
+				mesh->getTriangle(t,tri);
+				for (unsigned v=0;v<3;v++)
+					firstTriangleInVertex[tri[v]+1]++;
+			}
+			for (unsigned v=0;v<numVertices;v++)
+				firstTriangleInVertex[v+1] += firstTriangleInVertex[v];
 			for (unsigned t=0;t<numTriangles;t++)
 			{
 				RRMesh::Triangle tri;
 				mesh->getTriangle(t,tri);
 				for (unsigned v=0;v<3;v++)
-					trianglesInVertex[tri[v]].push_back(t);
+					trianglesInVertex[firstTriangleInVertex[tri[v]]++] = t;
 			}
+			// filling moved each first to next vertex's first, shift back
+			for (unsigned v=numVertices;v>0;v--)
+				firstTriangleInVertex[v] = firstTriangleInVertex[v-1];
+			firstTriangleInVertex[0] = 0;
 		}
 
 		// find v1-v2 edges shared by t1,t2 triangles, where both triangles have different unwrap
@@ -596,15 +643,19 @@ public:
 				seam.edge1[0] = tm1.uv[e];
 				seam.edge1[1] = tm1.uv[(e+1)%3];
 				// is there triangle t2 sharing edge v1-v2?
+				const unsigned* trianglesInV1 = trianglesInVertex+firstTriangleInVertex[v1];
+				const unsigned* trianglesInV2 = trianglesInVertex+firstTriangleInVertex[v2];
+				unsigned numTrianglesInV1 = firstTriangleInVertex[v1+1]-firstTriangleInVertex[v1];
+				unsigned numTrianglesInV2 = firstTriangleInVertex[v2+1]-firstTriangleInVertex[v2];
 				unsigned i1=0;
-				for (unsigned i2=0;i2<trianglesInVertex[v2].size();i2++)
-					if (trianglesInVertex[v2][i2]>t1) // t2>t1 ensures that edge is not processed twice
+				for (unsigned i2=0;i2<numTrianglesInV2;i2++)
+					if (trianglesInV2[i2]>t1) // t2>t1 ensures that edge is not processed twice
 					{
-						while (i1+1<trianglesInVertex[v1].size() && trianglesInVertex[v1][i1]<trianglesInVertex[v2][i2]) i1++;
-						if (trianglesInVertex[v1][i1]==trianglesInVertex[v2][i2])
+						while (i1+1<numTrianglesInV1 && trianglesInV1[i1]<trianglesInV2[i2]) i1++;
+						if (trianglesInV1[i1]==trianglesInV2[i2])
 						{
 							// we found t2
-							unsigned t2 = trianglesInVertex[v1][i1];
+							unsigned t2 = trianglesInV1[i1];
 							// get second edge coords in texture space
 							RRMesh::Triangle tv2;
 							mesh->getTriangle(t2,tv2);
@@ -884,10 +935,10 @@ bool RRBuffer::lightmapGrow(unsigned _numSteps, bool _wrap, bool& _aborting)
 	unsigned height = getHeight();
 	unsigned size = width*height;
 	RRVec4* buf;
-	buf = new (std::nothrow) RRVec4[size*2];
+	buf = new (std::nothrow) RRVec4[(size_t)size*2];
 	if (!buf)
 	{
-		RR_LIMITED_TIMES(10,RRReporter::report(WARN,"Allocation of %s failed in lightmapGrow().\n",RRReporter::bytesToString(size*2*sizeof(RRVec4))));
+		RR_LIMITED_TIMES(10,RRReporter::report(WARN,"Allocation of %s failed in lightmapGrow().\n",RRReporter::bytesToString(size*sizeof(RRVec4)*2)));
 		return false;
 	}
 	RRVec4* source = buf;
@@ -981,7 +1032,8 @@ bool RRBuffer::lightmapFillBackground(RRVec4 backgroundColor)
 
 extern RRBuffer* load_noncached(const RRString& _filename, const char* _cubeSideName[6]);
 
-
+// Can be used from multiple threads, e.g. by parallel RRObjects::loadLayer().
+// Lock protects only the map, images are loaded and deleted outside lock.
 class ImageCache
 {
 public:
@@ -991,6 +1043,7 @@ public:
 		std::error_code ec;
 		bool exists = !sixfiles && bf::exists(RR_RR2PATH(filename),ec);
 
+		std::unique_lock<std::mutex> lock(mutex);
 		Cache::iterator i = cache.find(RR_RR2STDW(filename));
 		if (i!=cache.end())
 		{
@@ -1015,22 +1068,43 @@ public:
 				return i->second.buffer->createReference(); // add one ref for user
 			}
 			// modified (in memory or on disk) after load, delete it from cache, we can't use it anymore
-			deleteFromCache(i);
+			RRBuffer* modified = eraseFromCache(i);
+			lock.unlock();
+			delete modified;
+		}
+		else
+			lock.unlock();
+
+		// load new file, other threads may load other files meanwhile
+		Value loaded;
+		loaded.buffer = load_noncached(filename,cubeSideName);
+		if (loaded.buffer)
+		{
+			loaded.bufferVersionWhenLoaded = loaded.buffer->version;
+			loaded.fileTimeWhenLoaded = exists ? bf::last_write_time(filename.w_str(),ec) : bf::file_time_type::min();
+			loaded.fileSizeWhenLoaded = exists ? bf::file_size(filename.w_str(),ec) : 0;
 		}
-		// load new file into cache
+
+		// insert it into cache
+		lock.lock();
 		Value& value = cache[RR_RR2STDW(filename)];
-		value.buffer = load_noncached(filename,cubeSideName);
-		if (value.buffer)
+		if (value.buffer && loaded.buffer)
 		{
-			value.buffer->createReference(); // keep initial ref for us, add one ref for user
-			value.bufferVersionWhenLoaded = value.buffer->version;
-			value.fileTimeWhenLoaded = exists ? bf::last_write_time(filename.w_str(),ec) : bf::file_time_type::min();
-			value.fileSizeWhenLoaded = exists ? bf::file_size(filename.w_str(),ec) : 0;
+			// other thread loaded the same file meanwhile, use its copy
+			RRBuffer* result = value.buffer->createReference();
+			lock.unlock();
+			delete loaded.buffer;
+			return result;
 		}
+		if (!loaded.buffer)
+			return value.buffer ? value.buffer->createReference() : nullptr;
+		value = loaded;
+		value.buffer->createReference(); // keep initial ref for us, add one ref for user
 		return value.buffer;
 	}
 	size_t getMemoryOccupied()
 	{
+		std::lock_guard<std::mutex> lock(mutex);
 		size_t memoryOccupied = 0;
 		for (Cache::iterator i=cache.begin();i!=cache.end();i++)
 		{
@@ -1042,7 +1116,18 @@ public:
 	void deleteFromCache(RRBuffer* b)
 	{
 		if (b)
-			deleteFromCache(cache.find(RR_RR2STDW(b->filename)));
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			Cache::iterator i = cache.find(RR_RR2STDW(b->filename));
+			// other thread might have taken new reference or replaced cached image meanwhile
+			if (i!=cache.end() && i->second.buffer==b && b->getReferenceCount()==1)
+			{
+				eraseFromCache(i);
+				lock.unlock();
+				// delete calls deleteFromCache(), but we have just erased it from cache, so it won't find it, it won't delete it again
+				delete b;
+			}
+		}
 	}
 	~ImageCache()
 	{
@@ -1055,7 +1140,7 @@ public:
 			if (b && b->getReferenceCount()!=1)
 				RRReporter::report(WARN,"Memory leak, image %ls not deleted (%dx).\n",b->filename.w_str(),b->getReferenceCount()-1);
 #endif
-			deleteFromCache(cache.begin());
+			delete eraseFromCache(cache.begin());
 		}
 	}
 protected:
@@ -1069,16 +1154,14 @@ protected:
 	};
 	typedef std::unordered_map<std::wstring,Value> Cache;
 	Cache cache;
+	std::mutex mutex;
 
-	void deleteFromCache(Cache::iterator i)
+	// Called with mutex locked. Returns buffer that caller should delete after unlocking.
+	RRBuffer* eraseFromCache(Cache::iterator i)
 	{
-		if (i!=cache.end())
-		{
-			RRBuffer* b = i->second.buffer;
-			cache.erase(i);
-			// delete calls deleteFromCache(), but we have just erased it from cache, so it won't find it, it won't delete it again
-			delete b;
-		}
+		RRBuffer* b = i->second.buffer;
+		cache.erase(i);
+		return b;
 	}
 };
 
@@ -1259,14 +1342,14 @@ static void shuffleBlock(unsigned char*& dst, const unsigned char* pixelsOld, un
 		{
 			for (unsigned i = blockWidth; i--;)
 			{
-				memcpy(dst, pixelsOld + ((jofs + j) * widthOld + iofs + i) * bytesPerPixel, bytesPerPixel);
+				memcpy(dst, pixelsOld + ((size_t)(jofs + j) * widthOld + iofs + i) * bytesPerPixel, bytesPerPixel);
 				dst += bytesPerPixel;
 			}
 		}
 	else
 		for (unsigned j = 0; j < blockHeight; j++)
 		{
-			memcpy(dst, pixelsOld + ((jofs + j) * widthOld + iofs) * bytesPerPixel, blockWidth * bytesPerPixel);
+			memcpy(dst, pixelsOld + ((size_t)(jofs + j) * widthOld + iofs) * bytesPerPixel, blockWidth * bytesPerPixel);
 			dst += blockWidth * bytesPerPixel;
 		}
 }
@@ -1283,8 +1366,9 @@ static bool shuffleCrossToCube(unsigned char*& pixelsOld, unsigned& widthOld, un
 
 	// quit when unused area in cross shape is not all the same color
 	bool cornersIdentical = true;
+	size_t rowBytes = (size_t)widthOld * bytesPerPixel;
 	for (unsigned i = 0; i < bytesPerPixel; i++)
-		if (pixelsOld[i] != pixelsOld[widthOld * bytesPerPixel - bytesPerPixel + i] || pixelsOld[i] != pixelsOld[widthOld * (heightOld - 1) * bytesPerPixel + i] || pixelsOld[i] != pixelsOld[widthOld * heightOld * bytesPerPixel - bytesPerPixel + i])
+		if (pixelsOld[i] != pixelsOld[rowBytes - bytesPerPixel + i] || pixelsOld[i] != pixelsOld[rowBytes * (heightOld - 1) + i] || pixelsOld[i] != pixelsOld[rowBytes * heightOld - bytesPerPixel + i])
 			cornersIdentical = false;
 	if (!cornersIdentical)
 	{
@@ -1294,7 +1378,7 @@ static bool shuffleCrossToCube(unsigned char*& pixelsOld, unsigned& widthOld, un
 	// alloc new
 	unsigned widthNew = RR_MIN(widthOld, heightOld) / 3;
 	unsigned heightNew = RR_MAX(widthOld, heightOld) / 4;
-	unsigned char* pixelsNew = new unsigned char[widthNew * heightNew * bytesPerPixel * 6];
+	unsigned char* pixelsNew = new unsigned char[(size_t)widthNew * heightNew * bytesPerPixel * 6];
 
 	// shuffle from old to new
 	bool wide = widthOld > heightOld;
@@ -1427,10 +1511,11 @@ bool reloadCube(RRBuffer* texture, const RRString& filenameMask, const char* cub
 
 		// pack 6 images into 1 array
 		// RGBA is expected here - warning: not satisfied when loading cube with 6 files and 96bit pixels
-		pixels = new unsigned char[width * height * getBytesPerPixel(format) * 6];
+		size_t sideBytes = (size_t)width * height * getBytesPerPixel(format);
+		pixels = new unsigned char[sideBytes * 6];
 		for (unsigned side = 0; side < 6; side++)
 		{
-			memcpy(pixels + width * height * getBytesPerPixel(format) * side, buffer[side]->lock(BL_READ), width * height * getBytesPerPixel(format));
+			memcpy(pixels + sideBytes * side, buffer[side]->lock(BL_READ), sideBytes);
 			RR_SAFE_DELETE(buffer[side]);
 		}
 	}
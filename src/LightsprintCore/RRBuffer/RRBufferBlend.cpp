@@ -7,12 +7,26 @@
 // Blend of two buffers.
 // --------------------------------------------------------------------------
 
+#include <cmath>
 #include "RRBufferBlend.h"
 #include "Lightsprint/RRDebug.h"
 
 namespace rr
 {
 
+enum
+{
+	MAX_BUILDS = 4, // until freeSupersededCubes(), environment that changes more often (e.g. video) is sampled directly
+};
+
+static unsigned s_blendedCubeMaxSize = 512;
+
+void RRBuffer::setEnvironmentBlendCacheSize(unsigned size)
+{
+	s_blendedCubeMaxSize = size;
+}
+
+
 
 /////////////////////////////////////////////////////////////////////////////
 //
@@ -44,9 +58,18 @@ RRBufferBlend::RRBufferBlend(RRBuffer* _environment0, RRBuffer* _environment1, R
 	rotation0 = RRMatrix3x4::rotationByYawPitchRoll(RRVec3(_angleRad0,0,0));
 	rotation1 = RRMatrix3x4::rotationByYawPitchRoll(RRVec3(_angleRad1,0,0));
 	blendFactor = _blendFactor;
+	newestCube = nullptr;
+	numUncachedLookups = 0;
+	numBuilds = 0;
 }
 
 RRVec4 RRBufferBlend::getElementAtDirection(const RRVec3& direction, const RRColorSpace* colorSpace) const
+{
+	const BlendedCube* cube = getBlendedCube(colorSpace);
+	return cube ? cube->sample(direction) : getElementAtDirectionUncached(direction,colorSpace);
+}
+
+RRVec4 RRBufferBlend::getElementAtDirectionUncached(const RRVec3& direction, const RRColorSpace* colorSpace) const
 {
 	RRVec3 direction0 = direction;
 	RRVec3 direction1 = direction;
@@ -65,10 +88,156 @@ RRVec4 RRBufferBlend::getElementAtDirection(const RRVec3& direction, const RRCol
 	return color0*(1-blendFactor) + color1*blendFactor;
 }
 
+void RRBufferBlend::freeSupersededCubes()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	BlendedCube* newest = const_cast<BlendedCube*>(newestCube.load(std::memory_order_relaxed));
+	if (newest)
+	{
+		for (const BlendedCube* cube=newest->next;cube;)
+		{
+			const BlendedCube* next = cube->next;
+			delete cube;
+			cube = next;
+		}
+		newest->next = nullptr;
+	}
+	numBuilds = 0;
+}
+
 RRBufferBlend::~RRBufferBlend()
 {
+	for (const BlendedCube* cube=newestCube;cube;)
+	{
+		const BlendedCube* next = cube->next;
+		delete cube;
+		cube = next;
+	}
 	delete environment0;
 	delete environment1;
 }
 
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// BlendedCube
+
+// the same cube layout as in RRBufferInMemory::getElementAtDirection()
+static const int s_sx[6] = {-1,-1,+1,-1,+1,+1};
+static const int  s_x[6] = { 2, 2, 0, 0, 0, 0};
+static const int  s_y[6] = { 1, 1, 2, 2, 1, 1};
+static const int s_sy[6] = {-1,+1,+1,+1,-1,+1};
+
+// Returns cube side and texel coordinates in 0..size range.
+static unsigned getCubeCoords(const RRVec3& direction, unsigned size, RRReal& x, RRReal& y)
+{
+	RRVec3 d = direction.abs();
+	unsigned axis = (d[0]>=d[1] && d[0]>=d[2]) ? 0 : ( (d[1]>=d[0] && d[1]>=d[2]) ? 1 : 2 );
+	unsigned side = 2*axis + ((direction[axis]<0)?1:0);
+	x = (s_sx[side]*direction[s_x[side]]/direction[axis]+1)*(0.5f*size);
+	y = (s_sy[side]*direction[s_y[side]]/direction[axis]+1)*(0.5f*size);
+	return side;
+}
+
+// Inverse of getCubeCoords().
+static RRVec3 getCubeDirection(unsigned side, unsigned size, RRReal x, RRReal y)
+{
+	RRReal major = (side&1) ? -1.f : 1.f;
+	RRVec3 direction;
+	direction[side/2] = major;
+	direction[s_x[side]] = (x*2/size-1)*major*s_sx[side];
+	direction[s_y[side]] = (y*2/size-1)*major*s_sy[side];
+	return direction;
+}
+
+RRVec4 BlendedCube::sample(const RRVec3& direction) const
+{
+	RRReal x,y;
+	unsigned side = getCubeCoords(direction,size,x,y);
+	if (!std::isfinite(x) || !std::isfinite(y))
+		return texels[0];
+	x = RR_CLAMPED(x-0.5f,0,(RRReal)(size-1));
+	y = RR_CLAMPED(y-0.5f,0,(RRReal)(size-1));
+	unsigned x0 = (unsigned)x;
+	unsigned y0 = (unsigned)y;
+	unsigned x1 = RR_MIN(x0+1,size-1);
+	unsigned y1 = RR_MIN(y0+1,size-1);
+	RRReal fx = x-x0;
+	RRReal fy = y-y0;
+	const RRVec4* sideTexels = texels+side*size*size;
+	return (sideTexels[x0+y0*size]*(1-fx) + sideTexels[x1+y0*size]*fx)*(1-fy)
+		+ (sideTexels[x0+y1*size]*(1-fx) + sideTexels[x1+y1*size]*fx)*fy;
+}
+
+BlendedCube::~BlendedCube()
+{
+	delete[] texels;
+}
+
+// Cube side resolution that preserves detail of both environments, 0 for no cube.
+unsigned RRBufferBlend::getBlendedCubeSize() const
+{
+	unsigned size = 0;
+	for (unsigned i=0;i<2;i++)
+	{
+		const RRBuffer* environment = i ? environment1 : environment0;
+		if (environment)
+			size = RR_MAX(size,(environment->getType()==BT_CUBE_TEXTURE) ? environment->getWidth() : environment->getWidth()/4);
+	}
+	return RR_MIN(RR_MAX(size,1),s_blendedCubeMaxSize);
+}
+
+const BlendedCube* RRBufferBlend::getBlendedCube(const RRColorSpace* colorSpace) const
+{
+	unsigned version0 = environment0 ? environment0->version : 0;
+	unsigned version1 = environment1 ? environment1->version : 0;
+	for (const BlendedCube* cube=newestCube.load(std::memory_order_acquire);cube;cube=cube->next)
+		if (cube->colorSpace==colorSpace && cube->version0==version0 && cube->version1==version1)
+			return cube;
+	if (numBuilds>=MAX_BUILDS)
+		return nullptr;
+
+	// bake only after direct lookups took about as long as baking
+	unsigned size = getBlendedCubeSize();
+	if (!size || numUncachedLookups.fetch_add(1,std::memory_order_relaxed)<6*size*size)
+		return nullptr;
+	std::unique_lock<std::mutex> lock(mutex,std::try_to_lock);
+	if (!lock.owns_lock())
+		return nullptr; // other thread is baking, don't wait for it
+	for (const BlendedCube* cube=newestCube.load(std::memory_order_relaxed);cube;cube=cube->next)
+		if (cube->colorSpace==colorSpace && cube->version0==version0 && cube->version1==version1)
+			return cube; // other thread was faster
+	if (numBuilds>=MAX_BUILDS)
+		return nullptr;
+	numBuilds++;
+	numUncachedLookups = 0;
+
+	BlendedCube* cube = new BlendedCube;
+	cube->colorSpace = colorSpace;
+	cube->version0 = version0;
+	cube->version1 = version1;
+	cube->size = size;
+	cube->texels = new (std::nothrow) RRVec4[6*size*size];
+	cube->next = nullptr;
+	if (!cube->texels)
+	{
+		// don't retry on each lookup
+		numBuilds = MAX_BUILDS;
+		delete cube;
+		return nullptr;
+	}
+	// parallel when called from serial code, lookups from parallel workers bake in one thread while others continue with direct lookups
+	#pragma omp parallel for schedule(static)
+	for (int i=0;i<(int)(6*size*size);i++)
+	{
+		unsigned side = i/(size*size);
+		unsigned x = i%size;
+		unsigned y = (i/size)%size;
+		cube->texels[i] = getElementAtDirectionUncached(getCubeDirection(side,size,x+0.5f,y+0.5f),colorSpace);
+	}
+	cube->next = newestCube.load(std::memory_order_relaxed);
+	newestCube.store(cube,std::memory_order_release);
+	return cube;
+}
+
 }; // namespace
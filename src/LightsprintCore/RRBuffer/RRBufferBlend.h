@@ -10,6 +10,8 @@
 #ifndef BUFFERBLEND_H
 #define BUFFERBLEND_H
 
+#include <atomic>
+#include <mutex>
 #include "Lightsprint/RRBuffer.h"
 #include "Lightsprint/RRDebug.h"
 #include "Lightsprint/RRLight.h" // colorSpace
@@ -17,6 +19,26 @@
 namespace rr
 {
 
+/////////////////////////////////////////////////////////////////////////////
+//
+// BlendedCube
+//
+// Blend of rotated environments baked into cube map, valid for one colorSpace and versions of both environments.
+
+struct BlendedCube
+{
+	const RRColorSpace* colorSpace;
+	unsigned version0;
+	unsigned version1;
+	unsigned size; // of cube side
+	RRVec4* texels; // 6*size*size
+	const BlendedCube* next; // older cube in RRBufferBlend
+
+	//! Bilinearly filtered lookup, texels are not interpolated across cube edges.
+	RRVec4 sample(const RRVec3& direction) const;
+	~BlendedCube();
+};
+
 /////////////////////////////////////////////////////////////////////////////
 //
 // RRBufferBlend
@@ -47,6 +69,7 @@ public:
 	virtual RRVec4 getElement(unsigned index, const RRColorSpace* colorSpace)const {report("getElement");return RRVec4(0);}
 	virtual RRVec4 getElementAtPosition(const RRVec3& position, const RRColorSpace* colorSpace, bool interpolated) const {report("getElementAtPosition");return RRVec4(0);}
 	virtual RRVec4 getElementAtDirection(const RRVec3& direction, const RRColorSpace* colorSpace) const;
+	RRVec4 getElementAtDirectionUncached(const RRVec3& direction, const RRColorSpace* colorSpace) const;
 	virtual unsigned char* lock(RRBufferLock lock)                         {report("lock");return nullptr;}
 	virtual void unlock()                                                  {report("unlock");}
 	virtual bool isStub()                                                  {return false;}
@@ -55,12 +78,24 @@ public:
 	virtual RRBuffer* createReference()                                    {report("createReference");return nullptr;}
 	virtual unsigned getReferenceCount()                                   {report("getReferenceCount");return 1;}
 
+	// Deletes cubes baked for older environment versions and allows new builds.
+	// Must not be called while buffer is sampled, RRSolver calls it when no PathtracerJob runs.
+	void freeSupersededCubes();
+
 protected:
 	RRBuffer* environment0;
 	RRBuffer* environment1;
 	RRMatrix3x4 rotation0;
 	RRMatrix3x4 rotation1;
 	RRReal blendFactor;
+
+	// cube with blended environments, baked when lookups would take more time than baking
+	const BlendedCube* getBlendedCube(const RRColorSpace* colorSpace) const;
+	unsigned getBlendedCubeSize() const;
+	mutable std::atomic<const BlendedCube*> newestCube;
+	mutable std::atomic<unsigned> numUncachedLookups;
+	mutable std::atomic<unsigned> numBuilds;
+	mutable std::mutex mutex;
 };
 
 }; // namespace
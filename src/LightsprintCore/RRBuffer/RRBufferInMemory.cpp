@@ -9,10 +9,12 @@
 
 #include <cmath>
 #include <climits> // UINT_MAX
+#include <cstdint> // SIZE_MAX
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include "RRBufferInMemory.h"
+#include "RRBufferMipmaps.h"
 #include "Lightsprint/RRDebug.h"
 
 namespace rr
@@ -57,10 +59,7 @@ static size_t getBufferSize(RRBufferFormat _format, unsigned _width, unsigned _h
 			// no alignment
 			break;
 	}
-	size_t result = size_t(_width) * _height * _depth * getBitsPerPixel(_format) / 8;
-	if (result>UINT_MAX)
-		RR_LIMITED_TIMES(1,RRReporter::report(WARN,"Huge buffer (over 4GiB).\n"));
-	return result;
+	return size_t(_width) * _height * _depth * getBitsPerPixel(_format) / 8;
 }
 
 unsigned RRBuffer::getElementBits() const
@@ -94,6 +93,7 @@ RRBufferInMemory::RRBufferInMemory()
 	scaled = false;
 	stub = false;
 	data = nullptr;
+	mipmaps = nullptr;
 	version = rand();
 }
 
@@ -123,7 +123,8 @@ RRBufferInMemory::~RRBufferInMemory()
 			RRReporter::report(WARN,"Deleting buffer with non-nullptr customData, memory leak? If it links to Texture, delete the Texture first.\n");
 		}
 		// destruct
-		delete[] data;
+		delete mipmaps.load();
+		free(data);
 	}
 }
 
@@ -189,21 +190,32 @@ bool RRBufferInMemory::reset(RRBufferType _type, unsigned _width, unsigned _heig
 //		RR_LIMITED_TIMES(1,RRReporter::report(WARN,"Float buffer used for data in custom scale (screen colors). Maybe you can save space by using integer buffer.\n"));
 	}
 
+	// element index is 32bit, bytes are 64bit (buffers over 4GiB are ok, but not on 32bit platforms)
+	unsigned long long numElements = (unsigned long long)_width * _height * _depth;
+	if (numElements>UINT_MAX || numElements*getBitsPerPixel(_format)/8>SIZE_MAX)
+	{
+		RRReporter::report(ERRO,"Buffer %dx%dx%d too big, not created.\n",_width,_height,_depth);
+		return false;
+	}
 	size_t bytesTotal = getBufferSize(_format,_width,_height,_depth);
 
 	// alloc/free data
+	bool zeroed = false;
 	if (!data || !_data || _data==RR_GHOST_BUFFER || width!=_width || height!=_height || depth!=_depth || format!=_format)
 	{
-		RR_SAFE_DELETE_ARRAY(data);
+		RR_SAFE_FREE(data);
 		// pointer value 1 = don't allocate buffer, caller promises he will never use it
 		if ((_data || _format!=BF_DEPTH) && _data!=RR_GHOST_BUFFER)
 		{
-			data = new (std::nothrow) unsigned char[bytesTotal];
+			// calloc gets big blocks from OS already zeroed, pages don't take physical memory until written
+			// (clearing them with memset would make every buffer resident, including huge sparsely used ones)
+			data = (unsigned char*)(_data ? malloc(bytesTotal) : calloc(bytesTotal,1));
 			if (!data)
 			{
 				RRReporter::report(ERRO,"Not enough memory, %s buffer not created.\n",RRReporter::bytesToString(bytesTotal));
 				return false;
 			}
+			zeroed = !_data;
 		}
 	}
 	// copy data
@@ -211,7 +223,7 @@ bool RRBufferInMemory::reset(RRBufferType _type, unsigned _width, unsigned _heig
 	{
 		if (_data)
 			memcpy(data,_data,bytesTotal);
-		else
+		else if (!zeroed)
 			memset(data,0,bytesTotal);
 	}
 
@@ -235,9 +247,10 @@ void RRBufferInMemory::setElement(unsigned index, const RRVec4& _element, const
 	}
 	if (index>=width*height*depth)
 	{
-		RRReporter::report(WARN,"setElement(%d) out of range, buffer size %d*%d*%d=%d.\n",index,width,height,depth,width*height*depth);
+		RRReporter::report(WARN,"setElement(%u) out of range, buffer size %d*%d*%d=%u.\n",index,width,height,depth,width*height*depth);
 		return;
 	}
+	size_t i = index; // byte offsets may exceed 4GiB
 	RRVec4 element = _element;
 	if (colorSpace && scaled)
 		colorSpace->fromLinear(element);
@@ -245,26 +258,26 @@ void RRBufferInMemory::setElement(unsigned index, const RRVec4& _element, const
 	switch(format)
 	{
 		case BF_RGB:
-			data[3*index+0] = RR_FLOAT2BYTE(element[0]);
-			data[3*index+1] = RR_FLOAT2BYTE(element[1]);
-			data[3*index+2] = RR_FLOAT2BYTE(element[2]);
+			data[3*i+0] = RR_FLOAT2BYTE(element[0]);
+			data[3*i+1] = RR_FLOAT2BYTE(element[1]);
+			data[3*i+2] = RR_FLOAT2BYTE(element[2]);
 			break;
 		case BF_BGR:
-			data[3*index+0] = RR_FLOAT2BYTE(element[2]);
-			data[3*index+1] = RR_FLOAT2BYTE(element[1]);
-			data[3*index+2] = RR_FLOAT2BYTE(element[0]);
+			data[3*i+0] = RR_FLOAT2BYTE(element[2]);
+			data[3*i+1] = RR_FLOAT2BYTE(element[1]);
+			data[3*i+2] = RR_FLOAT2BYTE(element[0]);
 			break;
 		case BF_RGBA:
-			data[4*index+0] = RR_FLOAT2BYTE(element[0]);
-			data[4*index+1] = RR_FLOAT2BYTE(element[1]);
-			data[4*index+2] = RR_FLOAT2BYTE(element[2]);
-			data[4*index+3] = RR_FLOAT2BYTE(element[3]);
+			data[4*i+0] = RR_FLOAT2BYTE(element[0]);
+			data[4*i+1] = RR_FLOAT2BYTE(element[1]);
+			data[4*i+2] = RR_FLOAT2BYTE(element[2]);
+			data[4*i+3] = RR_FLOAT2BYTE(element[3]);
 			break;
 		case BF_RGBF:
-			((RRVec3*)data)[index] = element;
+			((RRVec3*)data)[i] = element;
 			break;
 		case BF_RGBAF:
-			((RRVec4*)data)[index] = element;
+			((RRVec4*)data)[i] = element;
 			break;
 		case BF_DXT1:
 		case BF_DXT3:
@@ -272,10 +285,10 @@ void RRBufferInMemory::setElement(unsigned index, const RRVec4& _element, const
 			RR_LIMITED_TIMES(1,RRReporter::report(WARN,"setElement() not supported for compressed formats.\n"));
 			break;
 		case BF_LUMINANCE:
-			data[index] = RR_FLOAT2BYTE(element.RRVec3::avg());
+			data[i] = RR_FLOAT2BYTE(element.RRVec3::avg());
 			break;
 		case BF_LUMINANCEF:
-			((float*)data)[index] = element.RRVec3::avg();
+			((float*)data)[i] = element.RRVec3::avg();
 			break;
 		default:
 			RRReporter::report(WARN,"Unexpected buffer format.\n");
@@ -293,10 +306,10 @@ RRVec4 RRBufferInMemory::getElement(unsigned index, const RRColorSpace* colorSpa
 	}
 	if (index>=width*height*depth)
 	{
-		RR_LIMITED_TIMES(1,RRReporter::report(WARN,"getElement(%d) out of range, buffer size %d*%d*%d=%d.\n",index,width,height,depth,width*height*depth));
+		RR_LIMITED_TIMES(1,RRReporter::report(WARN,"getElement(%u) out of range, buffer size %d*%d*%d=%u.\n",index,width,height,depth,width*height*depth));
 		return RRVec4(0);
 	}
-	unsigned ofs = index * getElementBits()/8;
+	size_t ofs = (size_t)index * getElementBits()/8;
 	RRVec4 result;
 	if (scaled && colorSpace && (format==BF_RGB || format==BF_RGBA))
 	{
@@ -407,6 +420,23 @@ RRVec4 RRBufferInMemory::getElementAtPosition(const RRVec3& _position, const RRC
 	}
 }
 
+RRVec4 RRBufferInMemory::getElementAtPositionMipmapped(const RRVec2& position, RRReal footprint, const RRColorSpace* colorSpace, bool interpolated) const
+{
+	MipmapCache* cache = mipmaps.load(std::memory_order_acquire);
+	if (!cache)
+	{
+		MipmapCache* newCache = new MipmapCache;
+		if (mipmaps.compare_exchange_strong(cache,newCache))
+			cache = newCache;
+		else
+			delete newCache; // other thread was faster, cache now points to its instance
+	}
+	const MipPyramid* pyramid = cache->get(this,colorSpace);
+	return pyramid
+		? pyramid->sample(position,footprint,interpolated)
+		: getElementAtPosition(RRVec3(position[0],position[1],0),colorSpace,interpolated);
+}
+
 RRVec4 RRBufferInMemory::getElementAtDirection(const RRVec3& direction, const RRColorSpace* colorSpace) const
 {
 	unsigned coord[3];
@@ -37,6 +37,7 @@ public:
 	virtual size_t getBufferBytes() const override;
 	virtual RRVec4 getElement(unsigned index, const RRColorSpace* colorSpace) const override;
 	virtual RRVec4 getElementAtPosition(const RRVec3& position, const RRColorSpace* colorSpace, bool interpolated) const override;
+	virtual RRVec4 getElementAtPositionMipmapped(const RRVec2& position, RRReal footprint, const RRColorSpace* colorSpace, bool interpolated) const override;
 	virtual RRVec4 getElementAtDirection(const RRVec3& direction, const RRColorSpace* colorSpace) const override;
 	virtual unsigned char* lock(RRBufferLock lock) override {if (lock!=BL_READ)version++;return data;}
 	virtual void unlock() override {}
@@ -62,6 +63,7 @@ public: // for RRBuffer::load()
 	bool stub;
 protected:
 	unsigned char* data;
+	mutable std::atomic<class MipmapCache*> mipmaps; // created by first getElementAtPositionMipmapped()
 };
 
 }; // namespace
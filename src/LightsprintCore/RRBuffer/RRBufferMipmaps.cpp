@@ -0,0 +1,221 @@
+//----------------------------------------------------------------------------
+// Copyright (C) 1999-2021 Stepan Hrbek
+// This file is part of Lightsprint SDK, you can use and/or redistribute it
+// only under terms of Lightsprint SDK license agreement. A copy of the agreement
+// is available by contacting Lightsprint at http://lightsprint.com
+//
+// Mipmaps cached for RRBuffer::getElementAtPositionMipmapped().
+// --------------------------------------------------------------------------
+
+#include <cmath>
+#include <vector>
+#include "Lightsprint/RRDebug.h"
+#include "RRBufferMipmaps.h"
+
+namespace rr
+{
+
+static size_t s_mipmapBudget = 256*1024*1024;
+static std::atomic<size_t> s_mipmapBytes(0);
+
+void RRBuffer::setMipmapCacheBudget(size_t bytes)
+{
+	s_mipmapBudget = bytes;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// MipPyramid
+
+MipPyramid* MipPyramid::create(const RRBuffer* buffer, const RRColorSpace* colorSpace)
+{
+	if (!buffer || buffer->getType()!=BT_2D_TEXTURE || buffer->getDepth()!=1 || !buffer->getWidth() || !buffer->getHeight())
+		return nullptr;
+
+	// plan levels
+	MipPyramid* pyramid = new MipPyramid;
+	pyramid->colorSpace = colorSpace;
+	pyramid->version = buffer->version;
+	pyramid->next = nullptr;
+	pyramid->numLevels = 0;
+	size_t numTexels = 0;
+	for (unsigned w=buffer->getWidth(),h=buffer->getHeight();;w=RR_MAX(w/2,1),h=RR_MAX(h/2,1))
+	{
+		Level& level = pyramid->level[pyramid->numLevels++];
+		level.width = w;
+		level.height = h;
+		level.tilesX = (w+TILE_SIZE-1)/TILE_SIZE;
+		numTexels += (size_t)level.tilesX*((h+TILE_SIZE-1)/TILE_SIZE)*TILE_SIZE*TILE_SIZE;
+		if (w==1 && h==1)
+			break;
+	}
+	pyramid->bytes = numTexels*sizeof(RRVec4);
+
+	// reserve memory in budget
+	if (s_mipmapBytes.fetch_add(pyramid->bytes)+pyramid->bytes>s_mipmapBudget)
+	{
+		s_mipmapBytes -= pyramid->bytes;
+		pyramid->texels = nullptr;
+		pyramid->bytes = 0;
+		delete pyramid;
+		return nullptr;
+	}
+	try
+	{
+		pyramid->texels = new RRVec4[numTexels];
+	}
+	catch(...)
+	{
+		s_mipmapBytes -= pyramid->bytes;
+		pyramid->texels = nullptr;
+		pyramid->bytes = 0;
+		delete pyramid;
+		return nullptr;
+	}
+	numTexels = 0;
+	for (unsigned l=0;l<pyramid->numLevels;l++)
+	{
+		Level& level = pyramid->level[l];
+		level.texels = pyramid->texels+numTexels;
+		numTexels += (size_t)level.tilesX*((level.height+TILE_SIZE-1)/TILE_SIZE)*TILE_SIZE*TILE_SIZE;
+	}
+
+	// level 0, converted to linear colors
+	const RRColorSpace* toLinear = buffer->getScaled() ? colorSpace : nullptr;
+	Level& level0 = pyramid->level[0];
+	#pragma omp parallel for schedule(dynamic) if(level0.width*level0.height>RR_OMP_MIN_ELEMENTS/10)
+	for (int y=0;y<(int)level0.height;y++)
+	{
+		std::vector<RRVec3> colors(level0.width);
+		std::vector<RRReal> alphas(level0.width);
+		for (unsigned x=0;x<level0.width;x++)
+		{
+			RRVec4 element = buffer->getElement(x+y*level0.width,nullptr);
+			colors[x] = element;
+			alphas[x] = element.w;
+		}
+		if (toLinear)
+			toLinear->toLinear(colors.data(),level0.width);
+		for (unsigned x=0;x<level0.width;x++)
+			level0.getTexel(x,y) = RRVec4(colors[x],alphas[x]);
+	}
+
+	// other levels, box filter
+	for (unsigned l=1;l<pyramid->numLevels;l++)
+	{
+		const Level& src = pyramid->level[l-1];
+		Level& dst = pyramid->level[l];
+		#pragma omp parallel for schedule(static) if(dst.width*dst.height>RR_OMP_MIN_ELEMENTS/10)
+		for (int y=0;y<(int)dst.height;y++)
+		{
+			unsigned y0 = RR_MIN(2*(unsigned)y,src.height-1);
+			unsigned y1 = RR_MIN(2*(unsigned)y+1,src.height-1);
+			for (unsigned x=0;x<dst.width;x++)
+			{
+				unsigned x0 = RR_MIN(2*x,src.width-1);
+				unsigned x1 = RR_MIN(2*x+1,src.width-1);
+				dst.getTexel(x,y) = (src.getTexel(x0,y0)+src.getTexel(x1,y0)+src.getTexel(x0,y1)+src.getTexel(x1,y1))*0.25f;
+			}
+		}
+	}
+	return pyramid;
+}
+
+MipPyramid::~MipPyramid()
+{
+	delete[] texels;
+	s_mipmapBytes -= bytes;
+}
+
+// Wraps like RRBufferInMemory::getElementAtPosition().
+RRVec4 MipPyramid::Level::sample(const RRVec2& uv, bool interpolated) const
+{
+	if (!interpolated)
+	{
+		unsigned x = (unsigned)((fmodf(uv[0],1)+2)*width) % width;
+		unsigned y = (unsigned)((fmodf(uv[1],1)+2)*height) % height;
+		return getTexel(x,y);
+	}
+	RRVec2 position((fmodf(uv[0],1)+2)*width-0.5f,(fmodf(uv[1],1)+2)*height-0.5f);
+	unsigned x0 = (unsigned)position[0];
+	unsigned y0 = (unsigned)position[1];
+	RRVec2 remainder(position[0]-x0,position[1]-y0);
+	unsigned x1 = (x0+1)%width;
+	unsigned y1 = (y0+1)%height;
+	x0 %= width;
+	y0 %= height;
+	return getTexel(x0,y0)*((1-remainder[0])*(1-remainder[1]))
+		+ getTexel(x0,y1)*((1-remainder[0])*remainder[1])
+		+ getTexel(x1,y0)*(remainder[0]*(1-remainder[1]))
+		+ getTexel(x1,y1)*(remainder[0]*remainder[1]);
+}
+
+RRVec4 MipPyramid::sample(const RRVec2& uv, RRReal footprint, bool interpolated) const
+{
+	if (!(footprint>1))
+		return level[0].sample(uv,interpolated);
+	RRReal lod = RR_MIN(log2f(footprint),(RRReal)(numLevels-1));
+	if (!interpolated)
+		return level[(unsigned)(lod+0.5f)].sample(uv,false);
+	// trilinear
+	unsigned l = (unsigned)lod;
+	if (l+1>=numLevels)
+		return level[numLevels-1].sample(uv,true);
+	RRReal blend = lod-l;
+	return level[l].sample(uv,true)*(1-blend) + level[l+1].sample(uv,true)*blend;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// MipmapCache
+
+enum
+{
+	MAX_BUILDS = 4, // buffer that changes more often (e.g. video) is sampled directly
+};
+
+MipmapCache::MipmapCache()
+{
+	newest = nullptr;
+	numBuilds = 0;
+}
+
+const MipPyramid* MipmapCache::get(const RRBuffer* buffer, const RRColorSpace* colorSpace)
+{
+	for (const MipPyramid* pyramid=newest.load(std::memory_order_acquire);pyramid;pyramid=pyramid->next)
+		if (pyramid->version==buffer->version && pyramid->colorSpace==colorSpace)
+			return pyramid;
+	if (numBuilds>=MAX_BUILDS)
+		return nullptr;
+	std::lock_guard<std::mutex> lock(mutex);
+	for (const MipPyramid* pyramid=newest.load(std::memory_order_relaxed);pyramid;pyramid=pyramid->next)
+		if (pyramid->version==buffer->version && pyramid->colorSpace==colorSpace)
+			return pyramid; // other thread was faster
+	if (numBuilds>=MAX_BUILDS)
+		return nullptr;
+	MipPyramid* pyramid = MipPyramid::create(buffer,colorSpace);
+	if (!pyramid)
+	{
+		// don't retry on each sample
+		numBuilds = MAX_BUILDS;
+		return nullptr;
+	}
+	numBuilds++;
+	pyramid->next = newest.load(std::memory_order_relaxed);
+	newest.store(pyramid,std::memory_order_release);
+	return pyramid;
+}
+
+MipmapCache::~MipmapCache()
+{
+	for (const MipPyramid* pyramid=newest;pyramid;)
+	{
+		const MipPyramid* next = pyramid->next;
+		delete pyramid;
+		pyramid = next;
+	}
+}
+
+}; // namespace
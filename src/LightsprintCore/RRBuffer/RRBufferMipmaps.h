@@ -0,0 +1,89 @@
+//----------------------------------------------------------------------------
+// Copyright (C) 1999-2021 Stepan Hrbek
+// This file is part of Lightsprint SDK, you can use and/or redistribute it
+// only under terms of Lightsprint SDK license agreement. A copy of the agreement
+// is available by contacting Lightsprint at http://lightsprint.com
+//
+// Mipmaps cached for RRBuffer::getElementAtPositionMipmapped().
+// --------------------------------------------------------------------------
+
+#ifndef BUFFERMIPMAPS_H
+#define BUFFERMIPMAPS_H
+
+#include <atomic>
+#include <mutex>
+#include "Lightsprint/RRBuffer.h"
+
+namespace rr
+{
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// MipPyramid
+//
+// Float RGBA mipmaps of 2d texture in linear colors, each level stored in 8x8 tiles.
+// Never modified after construction, so it can be read by many threads.
+
+class MipPyramid
+{
+public:
+	// Returns nullptr if buffer is not 2d texture or mipmaps don't fit in budget.
+	static MipPyramid* create(const RRBuffer* buffer, const RRColorSpace* colorSpace);
+	~MipPyramid();
+
+	// footprint = size of sampled area in texels of level 0
+	RRVec4 sample(const RRVec2& uv, RRReal footprint, bool interpolated) const;
+
+	const RRColorSpace* colorSpace; // color space used when building mipmaps
+	unsigned version; // buffer version used when building mipmaps
+	const MipPyramid* next; // older mipmaps of the same buffer
+
+private:
+	enum {TILE_BITS=3, TILE_SIZE=1<<TILE_BITS, MAX_LEVELS=32};
+	struct Level
+	{
+		unsigned width;
+		unsigned height;
+		unsigned tilesX;
+		RRVec4* texels;
+		RRVec4 getTexel(unsigned x, unsigned y) const
+		{
+			return texels[(((y>>TILE_BITS)*tilesX+(x>>TILE_BITS))<<(2*TILE_BITS)) + ((y&(TILE_SIZE-1))<<TILE_BITS) + (x&(TILE_SIZE-1))];
+		}
+		RRVec4& getTexel(unsigned x, unsigned y)
+		{
+			return texels[(((y>>TILE_BITS)*tilesX+(x>>TILE_BITS))<<(2*TILE_BITS)) + ((y&(TILE_SIZE-1))<<TILE_BITS) + (x&(TILE_SIZE-1))];
+		}
+		RRVec4 sample(const RRVec2& uv, bool interpolated) const;
+	};
+	MipPyramid() {}
+	unsigned numLevels;
+	Level level[MAX_LEVELS];
+	RRVec4* texels;
+	size_t bytes;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// MipmapCache
+//
+// Mipmaps of one buffer, built on first use.
+// Published mipmaps are never modified or deleted while buffer exists, so readers need no lock.
+
+class MipmapCache
+{
+public:
+	MipmapCache();
+	~MipmapCache();
+	// Returns mipmaps for current buffer version and given colorSpace, nullptr if they can't be built.
+	const MipPyramid* get(const RRBuffer* buffer, const RRColorSpace* colorSpace);
+private:
+	std::atomic<const MipPyramid*> newest;
+	std::mutex mutex;
+	std::atomic<unsigned> numBuilds;
+};
+
+}; // namespace
+
+#endif
@@ -657,6 +657,9 @@ void RRLight::blendLinear(const RRLight& sample0, const RRLight& sample1, RRReal
 	direction = blendNormal(sample0.direction,sample1.direction,blend);
 	outerAngleRad = blendNormal(sample0.outerAngleRad,sample1.outerAngleRad,blend);
 	radius = blendNormal(sample0.radius,sample1.radius,blend);
+	areaType = sample0.areaType;
+	areaSize = blendNormal(sample0.areaSize,sample1.areaSize,blend);
+	angularDiameterRad = blendNormal(sample0.angularDiameterRad,sample1.angularDiameterRad,blend);
 	color = blendNormal(sample0.color,sample1.color,blend);
 	distanceAttenuationType = sample0.distanceAttenuationType;
 	polynom = blendNormal(sample0.polynom,sample1.polynom,blend);
@@ -878,6 +881,7 @@ void RRLight::blendAkima(unsigned numSamples, const RRLight** samples, const RRR
 	BLEND_RRVEC3(color);
 	BLEND_4FLOATS(polynom.x,polynom.y,polynom.z,outerAngleRad);
 	BLEND_4FLOATS(radius,fallOffExponent,spotExponent,fallOffAngleRad);
+	BLEND_3FLOATS(areaSize.x,areaSize.y,angularDiameterRad);
 }
 
 void RRCamera::blendAkima(unsigned numSamples, const RRCamera** samples, float* times, float time)
@@ -994,23 +998,74 @@ RRVec3 RRCamera::getPositionInViewport(RRVec3 worldPosition) const
 	return RRVec3(posInWindow.x,posInWindow.y,1);
 }
 
-bool RRCamera::getRay(RRVec2 posInWindow, RRVec3& rayOrigin, RRVec3& rayDir, bool randomized) const
+static RRReal getRandom01(RRCamera::RandomStream* random)
 {
-	// de-stereo-ize posInWindow
-	bool left = true;
-	RRVec3 pos = this->pos;
-	RRVec2 screenCenter = this->screenCenter;
-	RRReal aspect = this->aspect;
-	if (stereoMode==SM_MONO || stereoMode==SM_INTERLACED || stereoMode==SM_OCULUS_RIFT || stereoMode==SM_OPENVR || stereoMode==SM_QUAD_BUFFERED)
+	return random ? random->get01() : RR_RAND01;
+}
+
+// Terms of getRay() that don't depend on position in viewport, calculated once for many rays.
+// getRay() and getRays() share this code, so they return identical rays.
+class RayGenerator
+{
+public:
+	RayGenerator(const RRCamera& _camera) : camera(_camera), view(_camera.getViewMatrix(),false)
+	{
+		orthogonal = camera.isOrthogonal();
+		aspect = camera.getAspect();
+		right = camera.getRight();
+		up = camera.getUp();
+		direction = camera.getDirection();
+		split = SPLIT_NONE;
+		swap = false;
+		for (unsigned e=0;e<2;e++)
+		{
+			eye[e].pos = camera.getPosition();
+			eye[e].screenCenter = camera.getScreenCenter();
+		}
+		RRCamera::StereoMode stereoMode = camera.stereoMode;
+		if (stereoMode==RRCamera::SM_MONO || stereoMode==RRCamera::SM_INTERLACED || stereoMode==RRCamera::SM_OCULUS_RIFT || stereoMode==RRCamera::SM_OPENVR || stereoMode==RRCamera::SM_QUAD_BUFFERED)
+		{
+			// done
+		}
+		else
+		{
+			// posInWindow will be split to two halves
+			if (stereoMode==RRCamera::SM_SIDE_BY_SIDE)
+			{
+				aspect *= 0.5f;
+				split = SPLIT_X;
+			}
+			else if (stereoMode==RRCamera::SM_TOP_DOWN)
+			{
+				aspect *= 2;
+				split = SPLIT_Y;
+			}
+			// emulate getStereoCameras() within our local variables
+			swap = camera.stereoSwap;
+			eye[0].pos -= right*(camera.eyeSeparation/2);
+			eye[0].screenCenter.x -= camera.eyeSeparation/(2*tan(camera.getFieldOfViewVerticalRad()*0.5f)*aspect*camera.displayDistance);
+			eye[1].pos += right*(camera.eyeSeparation/2);
+			eye[1].screenCenter.x += camera.eyeSeparation/(2*tan(camera.getFieldOfViewVerticalRad()*0.5f)*aspect*camera.displayDistance);
+		}
+		orthoSize = camera.getOrthoSize();
+		tanHalfFovH = tan(camera.getFieldOfViewHorizontalRad()/2);
+		tanHalfFovV = tan(camera.getFieldOfViewVerticalRad()  /2);
+		dofDistance = (camera.dofFar+camera.dofNear)/2;
+		panoramaScale = (camera.panoramaMode==RRCamera::PM_FISHEYE) ? camera.panoramaScale * 360/camera.panoramaFisheyeFovDeg : camera.panoramaScale;
+	}
+
+	// True if getRay() consumes random numbers, rays can't be generated in parallel from one stream.
+	bool isRandomized(bool randomized) const
 	{
-		// done
+		return randomized && camera.apertureDiameter && !orthogonal && camera.panoramaMode==RRCamera::PM_OFF;
 	}
-	else
+
+	bool getRay(RRVec2 posInWindow, RRVec3& rayOrigin, RRVec3& rayDir, bool randomized, RRCamera::RandomStream* random) const
 	{
-		// modify posInWindow
-		if (stereoMode==SM_SIDE_BY_SIDE)
+		// de-stereo-ize posInWindow
+		bool left = true;
+		if (split==SPLIT_X)
 		{
-			aspect *= 0.5f;
 			if (posInWindow.x<0)
 			{
 				left = true;
@@ -1022,9 +1077,8 @@ bool RRCamera::getRay(RRVec2 posInWindow, RRVec3& rayOrigin, RRVec3& rayDir, boo
 				posInWindow.x = posInWindow.x*2 - 1;
 			}
 		}
-		else if (stereoMode==SM_TOP_DOWN)
+		else if (split==SPLIT_Y)
 		{
-			aspect *= 2;
 			if (posInWindow.y<0)
 			{
 				left = true;
@@ -1036,132 +1090,205 @@ bool RRCamera::getRay(RRVec2 posInWindow, RRVec3& rayOrigin, RRVec3& rayDir, boo
 				posInWindow.y = posInWindow.y*2 - 1;
 			}
 		}
-		// emulate getStereoCameras() within our local variables
-		if (stereoSwap)
-			left = !left;
-		if (!left)
+		const Eye& e = eye[(left!=swap)?0:1];
+
+		// orthogonal
+		if (orthogonal)
 		{
-			pos += getRight()*(eyeSeparation/2);
-			screenCenter.x += eyeSeparation/(2*tan(getFieldOfViewVerticalRad()*0.5f)*aspect*displayDistance);
+			rayOrigin = e.pos
+				+ right * (posInWindow[0]+e.screenCenter[0]) * orthoSize * aspect
+				+ up    * (posInWindow[1]+e.screenCenter[1]) * orthoSize
+				;
+			rayDir = direction;
+			return true;
 		}
-		else
+
+		// perspective
+		rayOrigin = e.pos;
+		if (camera.panoramaMode==RRCamera::PM_OFF)
 		{
-			pos -= getRight()*(eyeSeparation/2);
-			screenCenter.x -= eyeSeparation/(2*tan(getFieldOfViewVerticalRad()*0.5f)*aspect*displayDistance);
+			rr::RRVec2 localScreenCenter = e.screenCenter;
+			if (randomized && camera.apertureDiameter)
+			{
+				// randomize ray according to apertureDiameter and default bokeh shape [#48]
+			more_samples_needed:
+				RRReal randomX = getRandom01(random);
+				RRReal randomY = getRandom01(random);
+				rr::RRVec3 offsetInBuffer = rr::RRVec3(randomX,randomY,0); // 0..1
+				rr::RRVec2 a(offsetInBuffer.x*2-1,offsetInBuffer.y*2-1);
+				if (a.length2()>1) // sample is not inside default bokeh shape (circle)
+					goto more_samples_needed;
+				rr::RRVec2 offsetInMeters = rr::RRVec2(offsetInBuffer.x-0.5f,offsetInBuffer.y-0.5f)*camera.apertureDiameter; // how far do we move camera in right,up directions, -apertureDiameter/2..apertureDiameter/2 (m)
+				rayOrigin += right*offsetInMeters.x+up*offsetInMeters.y;
+				rr::RRVec2 visibleMetersAtFocusedDistance(tanHalfFovH*dofDistance,tanHalfFovV*dofDistance); // from center to edge (m)
+				rr::RRVec2 offsetOnScreen = offsetInMeters/visibleMetersAtFocusedDistance; // how far do we move camera in -1..1 screen space 
+				localScreenCenter -= offsetOnScreen;
+			}
+
+			rayDir = direction
+				+ right * ( (posInWindow[0]+localScreenCenter[0]) * tanHalfFovH )
+				+ up    * ( (posInWindow[1]+localScreenCenter[1]) * tanHalfFovV )
+				;
+			// CameraObjectDistance uses length of our result, don't normalize
+			return true;
 		}
-	}
 
+		// panoramaCoverage [#44]
+		if (camera.panoramaMode!=RRCamera::PM_EQUIRECTANGULAR)
+		switch (camera.panoramaCoverage)
+		{
+			case RRCamera::PC_FULL_STRETCH:
+				break;
+			case RRCamera::PC_FULL:
+				if (aspect>1)
+					posInWindow.x *= aspect;
+				else
+					posInWindow.y /= aspect;
+				break;
+			case RRCamera::PC_TRUNCATE_BOTTOM:
+				posInWindow.y = (posInWindow.y-(1-aspect))/aspect;
+				break;
+			case RRCamera::PC_TRUNCATE_TOP:
+				posInWindow.y = (posInWindow.y+(1-aspect))/aspect;
+				break;
+			case RRCamera::PC_TRUNCATE_TOP_BOT:
+				posInWindow.y = posInWindow.y/aspect;
+				break;
+		}
 
-	// orthogonal
-	if (orthogonal)
-	{
-		rayOrigin = pos
-			+ getRight() * (posInWindow[0]+screenCenter[0]) * orthoSize * aspect
-			+ getUp()    * (posInWindow[1]+screenCenter[1]) * orthoSize
-			;
-		rayDir = getDirection();
-		return true;
-	}
+		// panoramaScale [#43]
+		posInWindow /= panoramaScale;
 
-	// perspective
-	rayOrigin = pos;
-	if (panoramaMode==PM_OFF)
-	{
-		rr::RRVec2 localScreenCenter = screenCenter;
-		if (randomized && apertureDiameter)
+		// panoramaMode [#42]
+		// (response to apertureDiameter, dofNear, dofFar not implemented yet)
+		bool result = false;
+		if (camera.panoramaMode==RRCamera::PM_EQUIRECTANGULAR)
 		{
-			// randomize ray according to apertureDiameter and default bokeh shape [#48]
-		more_samples_needed:
-			rr::RRVec3 offsetInBuffer = rr::RRVec3(RR_RAND01,RR_RAND01,0); // 0..1
-			rr::RRVec2 a(offsetInBuffer.x*2-1,offsetInBuffer.y*2-1);
-			if (a.length2()>1) // sample is not inside default bokeh shape (circle)
-				goto more_samples_needed;
-			rr::RRReal dofDistance = (dofFar+dofNear)/2;
-			rr::RRVec2 offsetInMeters = rr::RRVec2(offsetInBuffer.x-0.5f,offsetInBuffer.y-0.5f)*apertureDiameter; // how far do we move camera in right,up directions, -apertureDiameter/2..apertureDiameter/2 (m)
-			rayOrigin += getRight()*offsetInMeters.x+getUp()*offsetInMeters.y;
-			rr::RRVec2 visibleMetersAtFocusedDistance(tan(getFieldOfViewHorizontalRad()/2)*dofDistance,tan(getFieldOfViewVerticalRad()/2)*dofDistance); // from center to edge (m)
-			rr::RRVec2 offsetOnScreen = offsetInMeters/visibleMetersAtFocusedDistance; // how far do we move camera in -1..1 screen space 
-			localScreenCenter -= offsetOnScreen;
+			// [#64] getRay (called from CPU pathtracer) should match getPositionInViewport (selection) and texture.fs (rasterizer)
+			RRVec3 direction;
+			direction.y = sin(RR_PI/2*posInWindow.y);
+			direction.x = sin(RR_PI*(-posInWindow.x+1)) * sqrt(1-direction.y*direction.y);
+			direction.z = 1-direction.x*direction.x-direction.y*direction.y;
+			direction.z = sqrt(RR_MAX(0,direction.z));
+			if (posInWindow.x<0.5f && posInWindow.x>-0.5f)
+				direction.z = -direction.z;
+			rayDir = direction;
+			result = true;
 		}
-
-		rayDir = getDirection()
-			+ getRight() * ( (posInWindow[0]+localScreenCenter[0]) * tan(getFieldOfViewHorizontalRad()/2) )
-			+ getUp()    * ( (posInWindow[1]+localScreenCenter[1]) * tan(getFieldOfViewVerticalRad()  /2) )
-			;
-		// CameraObjectDistance uses length of our result, don't normalize
-		return true;
+		if (camera.panoramaMode==RRCamera::PM_LITTLE_PLANET)
+		{
+			RRVec3 direction;
+			direction.x = posInWindow.x*0.5f;
+			direction.z = -posInWindow.y*0.5f;
+			float r = (posInWindow*0.5f).length()+0.000001f; // +epsilon fixes center pixel on intel
+			direction.x /= r; // /r instead of normalize() fixes noise on intel
+			direction.z /= r;
+			direction.y = tan(RR_PI*2*(r-0.25f)); // r=0 -> y=-inf, r=0.5 -> y=+inf
+			rayDir = direction;
+			result = r<0.5f;
+		}
+		if (camera.panoramaMode==RRCamera::PM_FISHEYE)
+		{
+			RRVec3 direction;
+			direction.x = posInWindow.x*0.5f;
+			direction.y = posInWindow.y*0.5f;
+			float r = (posInWindow*0.5f).length()+0.000001f; // +epsilon fixes center pixel on intel
+			direction.x /= r; // /r instead of normalize() fixes noise on intel
+			direction.y /= r;
+			direction.z = tan(RR_PI*2*(r-0.25f)); // r=0 -> y=-inf, r=0.5 -> y=+inf
+			rayDir = direction;
+			result = r*360/camera.panoramaFisheyeFovDeg<0.5f;
+		}
+		view.transformDirection(rayDir);
+		return result;
 	}
 
-	// panoramaCoverage [#44]
-	if (panoramaMode!=PM_EQUIRECTANGULAR)
-	switch (panoramaCoverage)
+private:
+	enum Split
 	{
-		case PC_FULL_STRETCH:
-			break;
-		case PC_FULL:
-			if (aspect>1)
-				posInWindow.x *= aspect;
-			else
-				posInWindow.y /= aspect;
-			break;
-		case PC_TRUNCATE_BOTTOM:
-			posInWindow.y = (posInWindow.y-(1-aspect))/aspect;
-			break;
-		case PC_TRUNCATE_TOP:
-			posInWindow.y = (posInWindow.y+(1-aspect))/aspect;
-			break;
-		case PC_TRUNCATE_TOP_BOT:
-			posInWindow.y = posInWindow.y/aspect;
-			break;
-	}
+		SPLIT_NONE, // mono, or stereo mode that renders eyes to separate viewports
+		SPLIT_X,    // left half of viewport is left eye
+		SPLIT_Y,    // bottom half of viewport is left eye
+	};
+	struct Eye
+	{
+		RRVec3 pos;
+		RRVec2 screenCenter;
+	};
+	const RRCamera& camera;
+	bool orthogonal;
+	Split split;
+	bool swap;
+	Eye eye[2]; // left, right
+	RRReal aspect; // aspect of one eye
+	RRVec3 right;
+	RRVec3 up;
+	RRVec3 direction;
+	RRReal orthoSize;
+	double tanHalfFovH; // tan() result is not rounded to float before use
+	double tanHalfFovV;
+	RRReal dofDistance;
+	RRReal panoramaScale; // fisheye fov included
+	RRMatrix3x4 view;
+};
 
-	// panoramaScale [#43]
-	float scale = (panoramaMode==rr::RRCamera::PM_FISHEYE) ? panoramaScale * 360/panoramaFisheyeFovDeg : panoramaScale;
-	posInWindow /= scale;
+bool RRCamera::getRay(RRVec2 posInWindow, RRVec3& rayOrigin, RRVec3& rayDir, bool randomized) const
+{
+	return RayGenerator(*this).getRay(posInWindow,rayOrigin,rayDir,randomized,nullptr);
+}
 
-	// panoramaMode [#42]
-	// (response to apertureDiameter, dofNear, dofFar not implemented yet)
-	bool result = false;
-	if (panoramaMode==PM_EQUIRECTANGULAR)
-	{
-		// [#64] getRay (called from CPU pathtracer) should match getPositionInViewport (selection) and texture.fs (rasterizer)
-		RRVec3 direction;
-		direction.y = sin(RR_PI/2*posInWindow.y);
-		direction.x = sin(RR_PI*(-posInWindow.x+1)) * sqrt(1-direction.y*direction.y);
-		direction.z = 1-direction.x*direction.x-direction.y*direction.y;
-		direction.z = sqrt(RR_MAX(0,direction.z));
-		if (posInWindow.x<0.5f && posInWindow.x>-0.5f)
-			direction.z = -direction.z;
-		rayDir = direction;
-		result = true;
-	}
-	if (panoramaMode==PM_LITTLE_PLANET)
+unsigned RRCamera::getRays(const RRVec2* positionsInViewport, unsigned numRays, RRVec3* rayOrigins, RRVec3* rayDirections, bool* rayValid, bool randomized, RandomStream* random) const
+{
+	if (!positionsInViewport || !rayOrigins || !rayDirections)
+		return 0;
+	RayGenerator generator(*this);
+	bool parallel = !generator.isRandomized(randomized) && numRays>RR_OMP_MIN_ELEMENTS/10;
+	int numValid = 0;
+	#pragma omp parallel for schedule(static) reduction(+:numValid) if(parallel)
+	for (int i=0;i<(int)numRays;i++)
 	{
-		RRVec3 direction;
-		direction.x = posInWindow.x*0.5f;
-		direction.z = -posInWindow.y*0.5f;
-		float r = (posInWindow*0.5f).length()+0.000001f; // +epsilon fixes center pixel on intel
-		direction.x /= r; // /r instead of normalize() fixes noise on intel
-		direction.z /= r;
-		direction.y = tan(RR_PI*2*(r-0.25f)); // r=0 -> y=-inf, r=0.5 -> y=+inf
-		rayDir = direction;
-		result = r<0.5f;
+		bool valid = generator.getRay(positionsInViewport[i],rayOrigins[i],rayDirections[i],randomized,random);
+		if (rayValid)
+			rayValid[i] = valid;
+		numValid += valid;
 	}
-	if (panoramaMode==PM_FISHEYE)
+	return numValid;
+}
+
+unsigned RRCamera::getRays(unsigned viewportWidth, unsigned viewportHeight, unsigned rectangleX, unsigned rectangleY, unsigned rectangleWidth, unsigned rectangleHeight,
+	unsigned samplesPerAxis, PixelSampling sampling, RRVec3* rayOrigins, RRVec3* rayDirections, bool* rayValid, bool randomized, RandomStream* random) const
+{
+	if (!viewportWidth || !viewportHeight || !samplesPerAxis || !rayOrigins || !rayDirections)
+		return 0;
+	RayGenerator generator(*this);
+	size_t raysPerRow = (size_t)rectangleWidth*samplesPerAxis*samplesPerAxis;
+	bool parallel = sampling!=PS_JITTERED && !generator.isRandomized(randomized) && raysPerRow*rectangleHeight>RR_OMP_MIN_ELEMENTS/10;
+	int numValid = 0;
+	#pragma omp parallel for schedule(static) reduction(+:numValid) if(parallel)
+	for (int j=0;j<(int)rectangleHeight;j++)
 	{
-		RRVec3 direction;
-		direction.x = posInWindow.x*0.5f;
-		direction.y = posInWindow.y*0.5f;
-		float r = (posInWindow*0.5f).length()+0.000001f; // +epsilon fixes center pixel on intel
-		direction.x /= r; // /r instead of normalize() fixes noise on intel
-		direction.y /= r;
-		direction.z = tan(RR_PI*2*(r-0.25f)); // r=0 -> y=-inf, r=0.5 -> y=+inf
-		rayDir = direction;
-		result = r*360/panoramaFisheyeFovDeg<0.5f;
+		size_t index = j*raysPerRow;
+		for (unsigned i=0;i<rectangleWidth;i++)
+		for (unsigned sy=0;sy<samplesPerAxis;sy++)
+		for (unsigned sx=0;sx<samplesPerAxis;sx++)
+		{
+			RRVec2 offsetInSubpixel(0.5f);
+			if (sampling==PS_JITTERED)
+			{
+				offsetInSubpixel.x = getRandom01(random);
+				offsetInSubpixel.y = getRandom01(random);
+			}
+			RRVec2 positionInViewport(
+				2*((rectangleX+i)+(sx+offsetInSubpixel.x)/samplesPerAxis)/viewportWidth-1,
+				2*((rectangleY+j)+(sy+offsetInSubpixel.y)/samplesPerAxis)/viewportHeight-1);
+			bool valid = generator.getRay(positionInViewport,rayOrigins[index],rayDirections[index],randomized,random);
+			if (rayValid)
+				rayValid[index] = valid;
+			numValid += valid;
+			index++;
+		}
 	}
-	rr::RRMatrix3x4 view(viewMatrix,false);
-	view.transformDirection(rayDir);
-	return result;
+	return numValid;
 }
 
 const RRCamera& RRCamera::operator=(const RRCamera& a)
@@ -337,6 +337,7 @@ public:
 
 	virtual bool intersect(RRRay& rrRay) const
 	{
+		RR_PROFILE_COUNT("rays",1);
 		if (rrRay.collisionHandler)
 			rrRay.collisionHandler->init(rrRay);
 		RTCRayHit rtcRayHit;
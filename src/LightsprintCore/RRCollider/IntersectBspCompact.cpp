@@ -325,6 +325,7 @@ bool IntersectBspCompact IBP2::intersect(RRRay& ray) const
 {
 	RR_ASSERT(tree);
 	FILL_STATISTIC(intersectStats.intersect_mesh++);
+	RR_PROFILE_COUNT("rays",1);
 	bool hit = false;
 
 #ifdef COLLISION_HANDLER
@@ -802,6 +802,7 @@ bool IntersectBspFast IBP2::intersect(RRRay& ray) const
 #endif
 
 	FILL_STATISTIC(intersectStats.intersect_mesh++);
+	RR_PROFILE_COUNT("rays",1);
 
 	bool hit = false;
 	RR_ASSERT(tree);
@@ -162,6 +162,7 @@ bool IntersectLinear::intersect(RRRay& ray) const
 {
 	DBG(printf("\n"));
 	FILL_STATISTIC(intersectStats.intersect_mesh++);
+	RR_PROFILE_COUNT("rays",1);
 	bool hit = false;
 
 	// linear is slow, warn if used too often
@@ -8,6 +8,7 @@
 // --------------------------------------------------------------------------
 
 #include <map>
+#include <vector>
 #include "RRCollisionHandler.h"
 #include "IntersectBspCompact.h"
 #include "IntersectBspFast.h"
@@ -258,59 +259,76 @@ static void addRay(const RRCollider* collider, RRRay& ray, RRVec3 dir, RRVec2& d
 	}
 }
 
+// Shoots rays in parallel. rayOrigins=nullptr shoots all rays from point.
+static void addRays(const RRCollider* collider, const RRObject* object, bool shadowRays, const RRVec3& point, const RRVec3* rayOrigins, const RRVec3* rayDirections, unsigned numRays, RRVec2& distanceMinMax)
+{
+	#pragma omp parallel
+	{
+		RRRay ray;
+		RRCollisionHandlerFirstVisible collisionHandler(object,shadowRays);
+		ray.rayOrigin = point;
+		ray.rayLengthMax = 1e12f;
+		ray.rayFlags = RRRay::FILL_DISTANCE;
+		ray.collisionHandler = &collisionHandler;
+		RRVec2 threadDistanceMinMax = distanceMinMax;
+		#pragma omp for schedule(dynamic,8)
+		for (int i=0;i<(int)numRays;i++)
+		{
+			if (rayOrigins)
+				ray.rayOrigin = rayOrigins[i];
+			ray.hitObject = object;
+			addRay(collider,ray,rayDirections[i],threadDistanceMinMax);
+		}
+		#pragma omp critical(distanceMinMax)
+		{
+			distanceMinMax[0] = RR_MIN(distanceMinMax[0],threadDistanceMinMax[0]);
+			distanceMinMax[1] = RR_MAX(distanceMinMax[1],threadDistanceMinMax[1]);
+		}
+	}
+}
+
 void RRCollider::getDistancesFromPoint(const RRVec3& point, const RRObject* object, bool shadowRays, RRVec2& distanceMinMax, unsigned numRays) const
 {
-	RRRay ray;
-	RRCollisionHandlerFirstVisible collisionHandler(object,shadowRays);
-	ray.rayOrigin = point;
-	ray.rayLengthMax = 1e12f;
-	ray.rayFlags = RRRay::FILL_DISTANCE;
-	ray.hitObject = object;
-	ray.collisionHandler = &collisionHandler;
 	int RAYS = (int)((sqrtf(numRays/6.f)-1)/2); // numRays ~= (2*RAYS+1)^2 * 6
 	int nr0 = (2*RAYS+1)*(2*RAYS+1)*6;
 	int nr1 = (2*(RAYS+1)+1)*(2*(RAYS+1)+1)*6;
 	if (numRays-nr0>nr1-numRays)
 		RAYS++;
+	std::vector<RRVec3> rayDirections;
+	rayDirections.reserve((2*RAYS+1)*(2*RAYS+1)*6);
 	for (int i=-RAYS;i<=RAYS;i++)
 	{
 		for (int j=-RAYS;j<=RAYS;j++)
 		{
 			float u = i/(RAYS+0.5f);
 			float v = j/(RAYS+0.5f);
-			addRay(this,ray,RRVec3(u,v,+1),distanceMinMax);
-			addRay(this,ray,RRVec3(u,v,-1),distanceMinMax);
-			addRay(this,ray,RRVec3(u,+1,v),distanceMinMax);
-			addRay(this,ray,RRVec3(u,-1,v),distanceMinMax);
-			addRay(this,ray,RRVec3(+1,u,v),distanceMinMax);
-			addRay(this,ray,RRVec3(-1,u,v),distanceMinMax);
+			rayDirections.push_back(RRVec3(u,v,+1));
+			rayDirections.push_back(RRVec3(u,v,-1));
+			rayDirections.push_back(RRVec3(u,+1,v));
+			rayDirections.push_back(RRVec3(u,-1,v));
+			rayDirections.push_back(RRVec3(+1,u,v));
+			rayDirections.push_back(RRVec3(-1,u,v));
 		}
 	}
+	addRays(this,object,shadowRays,point,nullptr,rayDirections.data(),(unsigned)rayDirections.size(),distanceMinMax);
 }
 
 void RRCollider::getDistancesFromCamera(const RRCamera& camera, const RRObject* object, bool shadowRays, RRVec2& distanceMinMax, unsigned numRays) const
 {
-	RRRay ray;
-	RRCollisionHandlerFirstVisible collisionHandler(object,shadowRays);
-	ray.rayLengthMax = 1e12f;
-	ray.rayFlags = RRRay::FILL_DISTANCE;
-	ray.hitObject = object;
-	ray.collisionHandler = &collisionHandler;
 	int RAYS = (int)((sqrtf((float)numRays)-1)/2); // numRays ~= (2*RAYS+1)^2
 	int nr0 = (2*RAYS+1)*(2*RAYS+1);
 	int nr1 = (2*(RAYS+1)+1)*(2*(RAYS+1)+1);
 	if (numRays-nr0>nr1-numRays)
 		RAYS++;
+	std::vector<RRVec2> positionsInViewport;
+	positionsInViewport.reserve((2*RAYS+1)*(2*RAYS+1));
 	for (int i=-RAYS;i<=RAYS;i++)
-	{
 		for (int j=-RAYS;j<=RAYS;j++)
-		{
-			RRVec2 posInWindow(i/float(RAYS),j/float(RAYS));
-			rr::RRVec3 dir;
-			camera.getRay(posInWindow,ray.rayOrigin,dir);
-			addRay(this,ray,dir,distanceMinMax);
-		}
-	}
+			positionsInViewport.push_back(RRVec2(i/float(RAYS),j/float(RAYS)));
+	std::vector<RRVec3> rayOrigins(positionsInViewport.size());
+	std::vector<RRVec3> rayDirections(positionsInViewport.size());
+	camera.getRays(positionsInViewport.data(),(unsigned)positionsInViewport.size(),rayOrigins.data(),rayDirections.data(),nullptr);
+	addRays(this,object,shadowRays,camera.getPosition(),rayOrigins.data(),rayDirections.data(),(unsigned)rayDirections.size(),distanceMinMax);
 }
 
 
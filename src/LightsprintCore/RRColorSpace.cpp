@@ -9,12 +9,207 @@
 
 #include <cfloat>
 #include <cmath>
+#include <cstring>
 #include "Lightsprint/RRLight.h"
 #include "Lightsprint/RRDebug.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+	#define RR_COLORSPACE_SSE2
+	#include <emmintrin.h>
+#endif
+
 namespace rr
 {
 
+static_assert(sizeof(RRVec3)==3*sizeof(RRReal),"array of RRVec3 is processed as array of RRReal");
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// fast pow
+//
+// Used by array conversions. pow(x,e)=exp2(e*log2(x)),
+// log2 of mantissa from atanh series, exp2 of fraction from Taylor series.
+// Relative error is below 0.0005% for all positive floats including denormals
+// (measured max 5.6e-7 for e=0.45, 1/0.45, 1/2.4, 2.4 by BunnyBenchmark colorspace),
+// results out of float range become 0 or inf, inputs <=0 and NaN return 0.
+//
+// Integer part of e*log2(x) is up to 127/e, float product would round away fraction bits,
+// so exponent is split to exponentHi with 12 bit mantissa (exact product with exponent of x) and small exponentLo.
+// Result exponent is applied in two halves, so that results near FLT_MAX and denormals don't overflow scale.
+
+// 2/ln(2)/(2k+1)
+#define LOG2_C1 2.8853900817779268f
+#define LOG2_C3 0.9617966939259756f
+#define LOG2_C5 0.5770780163555854f
+#define LOG2_C7 0.4121985831111324f
+#define LOG2_C9 0.3205988979753252f
+// ln(2)^k/k!
+#define EXP2_C1 0.6931471805599453f
+#define EXP2_C2 0.2402265069591007f
+#define EXP2_C3 0.0555041086648216f
+#define EXP2_C4 0.0096181291076285f
+#define EXP2_C5 0.0013333558146428f
+#define EXP2_C6 0.0001540353039338f
+
+#define TWO_POW_64 18446744073709551616.f
+
+// exponent>0
+static inline float fastPow(float x, float exponent)
+{
+	if (!(x>0))
+		return 0;
+	int bits;
+	memcpy(&bits,&x,4);
+	int e = (bits>>23)-127;
+	if (e==-127)
+	{
+		// denormal, scale to normal
+		x *= TWO_POW_64;
+		memcpy(&bits,&x,4);
+		e = (bits>>23)-127-64;
+	}
+	bits = (bits&0x007fffff)|0x3f800000;
+	float m;
+	memcpy(&m,&bits,4);
+	if (m>1.41421356f)
+	{
+		m *= 0.5f;
+		e++;
+	}
+	float t = (m-1)/(m+1);
+	float t2 = t*t;
+	float log2m = t*(LOG2_C1+t2*(LOG2_C3+t2*(LOG2_C5+t2*(LOG2_C7+t2*LOG2_C9))));
+	int exponentBits;
+	memcpy(&exponentBits,&exponent,4);
+	exponentBits &= 0xfffff000;
+	float exponentHi;
+	memcpy(&exponentHi,&exponentBits,4);
+	float yHi = exponentHi*e;
+	float i = floorf(yHi+0.5f);
+	float f = (yHi-i)+(exponent-exponentHi)*e+exponent*log2m;
+	float i2 = floorf(f+0.5f);
+	i += i2;
+	f -= i2;
+	float p = 1+f*(EXP2_C1+f*(EXP2_C2+f*(EXP2_C3+f*(EXP2_C4+f*(EXP2_C5+f*EXP2_C6)))));
+	int n = (int)RR_CLAMPED(i,-252.f,254.f);
+	int n1 = n>>1;
+	bits = (n1+127)<<23;
+	float scale1;
+	memcpy(&scale1,&bits,4);
+	bits = (n-n1+127)<<23;
+	float scale2;
+	memcpy(&scale2,&bits,4);
+	return p*scale1*scale2;
+}
+
+#ifdef RR_COLORSPACE_SSE2
+
+// the same as fastPow(), 4 at once
+static inline __m128 fastPow(__m128 x, __m128 exponent)
+{
+	__m128 valid = _mm_cmpgt_ps(x,_mm_setzero_ps());
+	__m128 denormal = _mm_cmplt_ps(x,_mm_set1_ps(FLT_MIN));
+	x = _mm_or_ps(_mm_and_ps(denormal,_mm_mul_ps(x,_mm_set1_ps(TWO_POW_64))),_mm_andnot_ps(denormal,x));
+	__m128i bits = _mm_castps_si128(x);
+	__m128i e = _mm_sub_epi32(_mm_srli_epi32(bits,23),_mm_set1_epi32(127));
+	e = _mm_sub_epi32(e,_mm_and_si128(_mm_castps_si128(denormal),_mm_set1_epi32(64)));
+	__m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits,_mm_set1_epi32(0x007fffff)),_mm_set1_epi32(0x3f800000)));
+	__m128 big = _mm_cmpgt_ps(m,_mm_set1_ps(1.41421356f));
+	m = _mm_mul_ps(m,_mm_or_ps(_mm_and_ps(big,_mm_set1_ps(0.5f)),_mm_andnot_ps(big,_mm_set1_ps(1))));
+	e = _mm_sub_epi32(e,_mm_castps_si128(big)); // big is -1 where true
+	__m128 one = _mm_set1_ps(1);
+	__m128 t = _mm_div_ps(_mm_sub_ps(m,one),_mm_add_ps(m,one));
+	__m128 t2 = _mm_mul_ps(t,t);
+	__m128 poly = _mm_add_ps(_mm_set1_ps(LOG2_C7),_mm_mul_ps(t2,_mm_set1_ps(LOG2_C9)));
+	poly = _mm_add_ps(_mm_set1_ps(LOG2_C5),_mm_mul_ps(t2,poly));
+	poly = _mm_add_ps(_mm_set1_ps(LOG2_C3),_mm_mul_ps(t2,poly));
+	poly = _mm_add_ps(_mm_set1_ps(LOG2_C1),_mm_mul_ps(t2,poly));
+	__m128 log2m = _mm_mul_ps(t,poly);
+	__m128 exponentHi = _mm_and_ps(exponent,_mm_castsi128_ps(_mm_set1_epi32(0xfffff000)));
+	__m128 eFloat = _mm_cvtepi32_ps(e);
+	__m128 yHi = _mm_mul_ps(exponentHi,eFloat);
+	__m128 i = _mm_cvtepi32_ps(_mm_cvtps_epi32(yHi)); // round to nearest
+	__m128 f = _mm_add_ps(_mm_add_ps(_mm_sub_ps(yHi,i),_mm_mul_ps(_mm_sub_ps(exponent,exponentHi),eFloat)),_mm_mul_ps(exponent,log2m));
+	__m128 i2 = _mm_cvtepi32_ps(_mm_cvtps_epi32(f));
+	i = _mm_add_ps(i,i2);
+	f = _mm_sub_ps(f,i2);
+	__m128 p = _mm_add_ps(_mm_set1_ps(EXP2_C5),_mm_mul_ps(f,_mm_set1_ps(EXP2_C6)));
+	p = _mm_add_ps(_mm_set1_ps(EXP2_C4),_mm_mul_ps(f,p));
+	p = _mm_add_ps(_mm_set1_ps(EXP2_C3),_mm_mul_ps(f,p));
+	p = _mm_add_ps(_mm_set1_ps(EXP2_C2),_mm_mul_ps(f,p));
+	p = _mm_add_ps(_mm_set1_ps(EXP2_C1),_mm_mul_ps(f,p));
+	p = _mm_add_ps(one,_mm_mul_ps(f,p));
+	__m128i n = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(i,_mm_set1_ps(-252)),_mm_set1_ps(254)));
+	__m128i n1 = _mm_srai_epi32(n,1);
+	__m128 scale1 = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n1,_mm_set1_epi32(127)),23));
+	__m128 scale2 = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_sub_epi32(n,n1),_mm_set1_epi32(127)),23));
+	return _mm_and_ps(valid,_mm_mul_ps(_mm_mul_ps(p,scale1),scale2));
+}
+
+static inline __m128 select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask,a),_mm_andnot_ps(mask,b));
+}
+
+#endif // RR_COLORSPACE_SSE2
+
+// Applies curve to all elements of array. Curve is odd function (negative inputs are mirrored).
+template <class Curve>
+static void convertArray(RRReal* data, size_t n, const Curve& curve)
+{
+	size_t i = 0;
+#ifdef RR_COLORSPACE_SSE2
+	__m128 signMask = _mm_set1_ps(-0.f);
+	for (;i+4<=n;i+=4)
+	{
+		__m128 a = _mm_loadu_ps(data+i);
+		__m128 sign = _mm_and_ps(a,signMask);
+		__m128 abs = _mm_andnot_ps(signMask,a);
+		_mm_storeu_ps(data+i,_mm_or_ps(curve(abs),sign));
+	}
+#endif
+	for (;i<n;i++)
+		data[i] = (data[i]>=0) ? curve(data[i]) : -curve(-data[i]);
+}
+
+// x^exponent
+struct PowCurve
+{
+	float exponent;
+	PowCurve(float _exponent) {exponent = _exponent;}
+	float operator ()(float x) const {return fastPow(x,exponent);}
+#ifdef RR_COLORSPACE_SSE2
+	__m128 operator ()(__m128 x) const {return fastPow(x,_mm_set1_ps(exponent));}
+#endif
+};
+
+// linear -> sRGB
+struct SRGBEncodeCurve
+{
+	float operator ()(float x) const {return (x<=0.0031308f) ? x*12.92f : 1.055f*fastPow(x,1/2.4f)-0.055f;}
+#ifdef RR_COLORSPACE_SSE2
+	__m128 operator ()(__m128 x) const
+	{
+		__m128 curve = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(1.055f),fastPow(x,_mm_set1_ps(1/2.4f))),_mm_set1_ps(0.055f));
+		return select(_mm_cmple_ps(x,_mm_set1_ps(0.0031308f)),_mm_mul_ps(x,_mm_set1_ps(12.92f)),curve);
+	}
+#endif
+};
+
+// sRGB -> linear
+struct SRGBDecodeCurve
+{
+	float operator ()(float x) const {return (x<=0.04045f) ? x*(1/12.92f) : fastPow((x+0.055f)*(1/1.055f),2.4f);}
+#ifdef RR_COLORSPACE_SSE2
+	__m128 operator ()(__m128 x) const
+	{
+		__m128 curve = fastPow(_mm_mul_ps(_mm_add_ps(x,_mm_set1_ps(0.055f)),_mm_set1_ps(1/1.055f)),_mm_set1_ps(2.4f));
+		return select(_mm_cmple_ps(x,_mm_set1_ps(0.04045f)),_mm_mul_ps(x,_mm_set1_ps(1/12.92f)),curve);
+	}
+#endif
+};
+
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // RRGammaScaler
@@ -76,20 +271,176 @@ public:
 		return RRVec3(byteToLinear[rgb[0]],byteToLinear[rgb[1]],byteToLinear[rgb[2]]);
 	}
 
+	// arrays
+	virtual void fromLinear(RRReal* intensities, size_t numIntensities) const
+	{
+		convertArray(intensities,numIntensities,PowCurve(gamma));
+	}
+	virtual void fromLinear(RRVec3* colors, size_t numColors) const
+	{
+		convertArray(&colors->x,numColors*3,PowCurve(gamma));
+	}
+	virtual void toLinear(RRReal* intensities, size_t numIntensities) const
+	{
+		convertArray(intensities,numIntensities,PowCurve(invGamma));
+	}
+	virtual void toLinear(RRVec3* colors, size_t numColors) const
+	{
+		convertArray(&colors->x,numColors*3,PowCurve(invGamma));
+	}
+	virtual void getLinear(const unsigned char* custom, unsigned bytesPerColor, RRVec3* linear, size_t numColors) const
+	{
+		for (size_t i=0;i<numColors;i++,custom+=bytesPerColor)
+			linear[i] = RRVec3(byteToLinear[custom[0]],byteToLinear[custom[1]],byteToLinear[custom[2]]);
+	}
+
 protected:
 	RRReal gamma;
 	RRReal invGamma;
 	RRReal byteToLinear[256];
 };
 
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// RRsRGBScaler
+//
+// Transforms colors with piecewise sRGB curve.
+
+class RRsRGBScaler : public RRColorSpace
+{
+public:
+	RRsRGBScaler()
+	{
+		for (unsigned i=0;i<256;i++)
+		{
+			byteToLinear[i] = float(i)/255;
+			RRsRGBScaler::toLinear(byteToLinear[i]);
+		}
+	}
+	static RRReal encode(RRReal a)
+	{
+		return (a<=0.0031308f) ? a*12.92f : 1.055f*pow(a,1/2.4f)-0.055f;
+	}
+	static RRReal decode(RRReal a)
+	{
+		return (a<=0.04045f) ? a/12.92f : pow((a+0.055f)/1.055f,2.4f);
+	}
+	virtual void fromLinear(RRReal& a) const
+	{
+		RR_ASSERT(std::isfinite(a));
+		a = (a>=0)?encode(a):-encode(-a);
+	}
+	virtual void toLinear(RRReal& a) const
+	{
+		RR_ASSERT(std::isfinite(a));
+		a = (a>=0)?decode(a):-decode(-a);
+	}
+	virtual void fromLinear(RRVec3& color) const
+	{
+		for (unsigned i=0;i<3;i++)
+			RRsRGBScaler::fromLinear(color[i]);
+	}
+	virtual void toLinear(RRVec3& color) const
+	{
+		for (unsigned i=0;i<3;i++)
+			RRsRGBScaler::toLinear(color[i]);
+	}
+	virtual RRVec3 getLinear(const unsigned char rgb[3]) const
+	{
+		return RRVec3(byteToLinear[rgb[0]],byteToLinear[rgb[1]],byteToLinear[rgb[2]]);
+	}
+
+	// arrays
+	virtual void fromLinear(RRReal* intensities, size_t numIntensities) const
+	{
+		convertArray(intensities,numIntensities,SRGBEncodeCurve());
+	}
+	virtual void fromLinear(RRVec3* colors, size_t numColors) const
+	{
+		convertArray(&colors->x,numColors*3,SRGBEncodeCurve());
+	}
+	virtual void toLinear(RRReal* intensities, size_t numIntensities) const
+	{
+		convertArray(intensities,numIntensities,SRGBDecodeCurve());
+	}
+	virtual void toLinear(RRVec3* colors, size_t numColors) const
+	{
+		convertArray(&colors->x,numColors*3,SRGBDecodeCurve());
+	}
+	virtual void getLinear(const unsigned char* custom, unsigned bytesPerColor, RRVec3* linear, size_t numColors) const
+	{
+		for (size_t i=0;i<numColors;i++,custom+=bytesPerColor)
+			linear[i] = RRVec3(byteToLinear[custom[0]],byteToLinear[custom[1]],byteToLinear[custom[2]]);
+	}
+
+protected:
+	RRReal byteToLinear[256];
+};
+
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // RRColorSpace
 
+void RRColorSpace::fromLinear(RRReal* intensities, size_t numIntensities) const
+{
+	for (size_t i=0;i<numIntensities;i++)
+		fromLinear(intensities[i]);
+}
+
+void RRColorSpace::fromLinear(RRVec3* colors, size_t numColors) const
+{
+	for (size_t i=0;i<numColors;i++)
+		fromLinear(colors[i]);
+}
+
+void RRColorSpace::fromLinear(const RRVec3* colors, unsigned char* custom, unsigned bytesPerColor, size_t numColors) const
+{
+	// convert in small chunks on stack, so that array version of fromLinear() is used
+	enum {CHUNK=256};
+	RRVec3 chunk[CHUNK];
+	for (size_t i=0;i<numColors;i+=CHUNK)
+	{
+		size_t num = RR_MIN(numColors-i,(size_t)CHUNK);
+		memcpy(chunk,colors+i,num*sizeof(RRVec3));
+		fromLinear(chunk,num);
+		for (size_t j=0;j<num;j++,custom+=bytesPerColor)
+		{
+			custom[0] = RR_FLOAT2BYTE(chunk[j][0]);
+			custom[1] = RR_FLOAT2BYTE(chunk[j][1]);
+			custom[2] = RR_FLOAT2BYTE(chunk[j][2]);
+		}
+	}
+}
+
+void RRColorSpace::toLinear(RRReal* intensities, size_t numIntensities) const
+{
+	for (size_t i=0;i<numIntensities;i++)
+		toLinear(intensities[i]);
+}
+
+void RRColorSpace::toLinear(RRVec3* colors, size_t numColors) const
+{
+	for (size_t i=0;i<numColors;i++)
+		toLinear(colors[i]);
+}
+
+void RRColorSpace::getLinear(const unsigned char* custom, unsigned bytesPerColor, RRVec3* linear, size_t numColors) const
+{
+	for (size_t i=0;i<numColors;i++,custom+=bytesPerColor)
+		linear[i] = getLinear(custom);
+}
+
 RRColorSpace* RRColorSpace::create_sRGB(RRReal power)
 {
 	return new RRGammaScaler(power);
 }
 
+RRColorSpace* RRColorSpace::create_sRGB_exact()
+{
+	return new RRsRGBScaler();
+}
+
 
 } // namespace
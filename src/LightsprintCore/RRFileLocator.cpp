@@ -11,8 +11,12 @@
 #include "Lightsprint/RRDebug.h"
 
 // helper for rr_io,
-// single global variable shared by all libraries that include RRSerialization.h
-RR_API class SerializationRuntime* g_serializationRuntime = nullptr;
+// single variable per thread shared by all libraries that include RRSerialization.h
+RR_API class SerializationRuntime*& getSerializationRuntime()
+{
+	static thread_local class SerializationRuntime* serializationRuntime = nullptr;
+	return serializationRuntime;
+}
 
 #include <vector>
 #include <map>
@@ -11,6 +11,10 @@
 #include "Lightsprint/RRDebug.h"
 #include "Lightsprint/RRCamera.h"
 #include "RRMathPrivate.h"
+#include "RRLightPrivate.h"
+#include "RRBuffer/RRBufferInMemory.h"
+#include <cstring> // memcpy
+#include <typeinfo>
 
 #define PHYS2SRGB 0.45f
 #define SRGB2PHYS 2.22222222f
@@ -262,6 +266,9 @@ RRLight::RRLight()
 	direction = RRVec3(0);
 	outerAngleRad = 1;
 	radius = 1;
+	areaType = AREA_NONE;
+	areaSize = RRVec2(0.1f);
+	angularDiameterRad = 0;
 	color = RRVec3(1);
 	distanceAttenuationType = NONE;
 	polynom = RRVec4(0,0,0,1);
@@ -289,6 +296,9 @@ RRLight::RRLight(const RRLight& a)
 	direction = a.direction;
 	outerAngleRad = a.outerAngleRad;
 	radius = a.radius;
+	areaType = a.areaType;
+	areaSize = a.areaSize;
+	angularDiameterRad = a.angularDiameterRad;
 	color = a.color;
 	distanceAttenuationType = a.distanceAttenuationType;
 	polynom = a.polynom;
@@ -316,6 +326,9 @@ const RRLight& RRLight::operator=(const RRLight& a)
 	direction = a.direction;
 	outerAngleRad = a.outerAngleRad;
 	radius = a.radius;
+	areaType = a.areaType;
+	areaSize = a.areaSize;
+	angularDiameterRad = a.angularDiameterRad;
 	color = a.color;
 	distanceAttenuationType = a.distanceAttenuationType;
 	polynom = a.polynom;
@@ -415,6 +428,141 @@ RRVec3 RRLight::getIrradiance(const RRVec3& receiverPosition, const RRColorSpace
 	return result;
 }
 
+// Orthonormal basis of plane perpendicular to normal, tangent is horizontal if possible.
+static void getAreaBasis(const RRVec3& normal, RRVec3& tangent, RRVec3& bitangent)
+{
+	RRVec3 n = (normal.length2()>0) ? normal.normalized() : RRVec3(0,-1,0); // point lights often have direction unset, face down
+	tangent = (fabs(n.y)<0.999f) ? RRVec3(n.z,0,-n.x).normalized() : RRVec3(1,0,0);
+	bitangent = n.cross(tangent);
+}
+
+// Uniformly distributed direction in cone around axis, cone covers given part of sphere (oneMinusCosMax=1-cos(half angle)).
+static RRVec3 getConeSample(const RRVec3& axis, RRReal oneMinusCosMax, const RRVec2& sample)
+{
+	RRVec3 tangent, bitangent;
+	getAreaBasis(axis,tangent,bitangent);
+	RRReal cosTheta = 1-sample[0]*oneMinusCosMax;
+	RRReal sinTheta = sqrt(RR_MAX(0,1-cosTheta*cosTheta));
+	RRReal phi = 2*RR_PI*sample[1];
+	return axis*cosTheta + tangent*(sinTheta*cos(phi)) + bitangent*(sinTheta*sin(phi));
+}
+
+// Samples point of light source for getIrradianceSample().
+// Returns position where getIrradiance() should be evaluated (receiver moved as if light moved to sampled point)
+// and multiplier of irradiance.
+static RRVec3 sampleLightArea(const RRLight& light, const RRVec3& receiverPosition, const RRVec2& sample, RRVec3& directionToLight, RRReal& distanceToLight, RRReal& multiplier)
+{
+	distanceToLight = 1e10f;
+	multiplier = 1;
+	if (light.type==RRLight::DIRECTIONAL)
+	{
+		directionToLight = (light.angularDiameterRad>0) ? getConeSample(-light.direction,1-cos(light.angularDiameterRad*0.5f),sample) : -light.direction;
+		return receiverPosition;
+	}
+
+	RRVec3 samplePosition = light.position;
+	switch (light.areaType)
+	{
+		case RRLight::AREA_SPHERE:
+		{
+			RRVec3 toCenter = light.position-receiverPosition;
+			RRReal distance2 = toCenter.length2();
+			RRReal radius2 = light.areaSize.x*light.areaSize.x;
+			if (radius2>0 && distance2>radius2)
+			{
+				// sampled by solid angle, uniformly in cone that sphere occupies
+				RRReal distance = sqrt(distance2);
+				RRReal cosMax = sqrt(1-radius2/distance2);
+				RRReal oneMinusCosMax = radius2/distance2/(1+cosMax); // precise even for distant sphere
+				directionToLight = getConeSample(toCenter/distance,oneMinusCosMax,sample);
+				RRReal b = distance*dot(directionToLight,toCenter/distance);
+				distanceToLight = b-sqrt(RR_MAX(0,radius2-distance2+b*b));
+				// sphere of uniform radiance with intensity of point light: irradiance = intensity*solidAngle/(pi*r^2),
+				// point light would give intensity/distance^2, ratio is solidAngle*distance^2/(pi*r^2) = 2/(1+cosMax)
+				multiplier = 2/(1+cosMax);
+				return receiverPosition;
+			}
+			// receiver inside sphere, light it from center
+			break;
+		}
+		case RRLight::AREA_DISK:
+		{
+			// concentric mapping keeps samples stratified
+			RRReal a = 2*sample[0]-1;
+			RRReal b = 2*sample[1]-1;
+			RRReal r = 0;
+			RRReal phi = 0;
+			if (fabs(a)>fabs(b))
+			{
+				r = a;
+				phi = (RR_PI/4)*(b/a);
+			}
+			else
+			if (b!=0)
+			{
+				r = b;
+				phi = RR_PI/2-(RR_PI/4)*(a/b);
+			}
+			RRVec3 tangent, bitangent;
+			getAreaBasis(light.direction,tangent,bitangent);
+			samplePosition += (tangent*cos(phi)+bitangent*sin(phi))*(r*light.areaSize.x);
+			break;
+		}
+		case RRLight::AREA_RECTANGLE:
+		{
+			RRVec3 tangent, bitangent;
+			getAreaBasis(light.direction,tangent,bitangent);
+			samplePosition += tangent*((sample[0]-0.5f)*light.areaSize.x) + bitangent*((sample[1]-0.5f)*light.areaSize.y);
+			break;
+		}
+		case RRLight::AREA_NONE:
+			break;
+	}
+
+	// light moved to samplePosition
+	RRVec3 toLight = samplePosition-receiverPosition;
+	distanceToLight = toLight.length();
+	directionToLight = toLight/distanceToLight;
+	return receiverPosition-(samplePosition-light.position);
+}
+
+RRVec3 RRLight::getIrradianceSample(const RRVec3& receiverPosition, const RRVec2& sample, const RRColorSpace* colorSpace, RRVec3& directionToLight, RRReal& distanceToLight) const
+{
+	RRReal multiplier;
+	RRVec3 position = sampleLightArea(*this,receiverPosition,sample,directionToLight,distanceToLight,multiplier);
+	return getIrradiance(position,colorSpace)*multiplier;
+}
+
+void RRLight::getIrradiances(const RRVec3* receiverPositions, RRVec3* irradiances, unsigned numReceivers, const RRColorSpace* colorSpace) const
+{
+	LightEvaluator evaluator(this,colorSpace,numReceivers);
+	evaluator.getIrradiance(receiverPositions,irradiances,numReceivers);
+}
+
+void RRLight::getIrradianceSamples(const RRVec3* receiverPositions, const RRVec2* samples, RRVec3* irradiances, RRVec3* directionsToLight, RRReal* distancesToLight, unsigned numReceivers, const RRColorSpace* colorSpace) const
+{
+	LightEvaluator evaluator(this,colorSpace,numReceivers);
+	evaluator.getIrradianceSamples(receiverPositions,samples,irradiances,directionsToLight,distancesToLight,numReceivers);
+}
+
+bool RRLight::isAreaLight() const
+{
+	return (type==DIRECTIONAL) ? angularDiameterRad>0 : (areaType!=AREA_NONE && areaSize.x>0);
+}
+
+RRReal RRLight::getAreaRadius() const
+{
+	if (type==DIRECTIONAL)
+		return 0;
+	switch (areaType)
+	{
+		case AREA_SPHERE:
+		case AREA_DISK: return areaSize.x;
+		case AREA_RECTANGLE: return areaSize.length()/2;
+		default: return 0;
+	}
+}
+
 bool RRLight::operator ==(const RRLight& a) const
 {
 	// Q: should we ignore unused variables (like position in directional light)?
@@ -426,6 +574,9 @@ bool RRLight::operator ==(const RRLight& a) const
 		&& a.direction==direction
 		&& a.outerAngleRad==outerAngleRad
 		&& a.radius==radius
+		&& a.areaType==areaType
+		&& a.areaSize==areaSize
+		&& a.angularDiameterRad==angularDiameterRad
 		&& a.color==color
 		&& a.distanceAttenuationType==distanceAttenuationType
 		&& a.polynom==polynom
@@ -522,6 +673,13 @@ void RRLight::fixInvalidValues()
 	#define DELTA 0.0001f
 	RR_CLAMP(outerAngleRad,DELTA,RR_PI*0.5f-DELTA);
 	RR_CLAMP(radius,0,1e20f);
+	RR_CLAMP(areaType,AREA_NONE,AREA_RECTANGLE);
+	makeFinite(areaSize[0],0);
+	makeFinite(areaSize[1],0);
+	RR_CLAMP(areaSize[0],0,1e20f);
+	RR_CLAMP(areaSize[1],0,1e20f);
+	makeFinite(angularDiameterRad,0);
+	RR_CLAMP(angularDiameterRad,0,RR_PI-DELTA);
 
 	// color
 	makeFinite(color,RRVec3(0));
@@ -532,4 +690,304 @@ void RRLight::fixInvalidValues()
 	RR_CLAMP(fallOffAngleRad,0,outerAngleRad);
 }
 
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// LightEvaluator
+
+// spot attenuation is computed exactly only in this distance from inner and outer angle, it's 1 or 0 elsewhere
+// (covers rounding errors of cos() and acos(), they reach 0.0004 rad near zero angle)
+#define SPOT_ANGLE_MARGIN 0.001f
+
+// projected textures up to this size are cached in linear colors
+#define MAX_CACHED_TEXELS (1024*1024)
+
+// Returns true for plain RRLight and lights created by RRLight::createXxx(), they don't override getIrradiance().
+static bool hasBuiltinIrradiance(const RRLight* light)
+{
+	const std::type_info& type = typeid(*light);
+	return type==typeid(RRLight)
+		|| type==typeid(DirectionalLight)
+		|| type==typeid(PointLightPhys)
+		|| type==typeid(PointLightNoAtt)
+		|| type==typeid(PointLightRadiusExp)
+		|| type==typeid(PointLightPoly)
+		|| type==typeid(SpotLightPhys)
+		|| type==typeid(SpotLightNoAtt)
+		|| type==typeid(SpotLightRadiusExp)
+		|| type==typeid(SpotLightPoly);
+}
+
+LightEvaluator::LightEvaluator(const RRLight* _light, const RRColorSpace* _colorSpace, size_t expectedEvaluations)
+{
+	light = _light;
+	colorSpace = _colorSpace;
+	type = light->type;
+	enabled = light->enabled;
+	position = light->position;
+	direction = light->direction;
+	outerAngleRad = light->outerAngleRad;
+	fallOffAngleRad = light->fallOffAngleRad;
+	spotExponent = light->spotExponent;
+	projectedTexture = light->projectedTexture;
+	projectedTextureVersion = projectedTexture ? projectedTexture->version : 0;
+	builtin = hasBuiltinIrradiance(light);
+	cosFullyLit = 2;
+	cosUnlit = -2;
+	texels = nullptr;
+	textureWidth = 0;
+	textureHeight = 0;
+	if (!builtin || light->type!=RRLight::SPOT)
+		return;
+	if (light->projectedTexture)
+	{
+		// the same projection as in RRLight::getIrradiance()
+		RRCamera camera(light->position,RRVec3(0),1,RR_CLAMPED(RR_RAD2DEG(light->outerAngleRad)*2,0.0000001f,179.9f),0.01f,1000);
+		camera.setDirection(light->direction);
+		memcpy(viewMatrix,camera.getViewMatrix(),sizeof(viewMatrix));
+		memcpy(projectionMatrix,camera.getProjectionMatrix(),sizeof(projectionMatrix));
+
+		// texture in memory is converted to linear colors once, instead of on each lookup
+		// (unless there are fewer lookups than texels)
+		const RRBuffer* texture = light->projectedTexture;
+		if (light->enabled && typeid(*texture)==typeid(RRBufferInMemory) && texture->getType()==BT_2D_TEXTURE
+			&& texture->getWidth() && texture->getHeight() && (size_t)texture->getWidth()*texture->getHeight()<=RR_MIN((size_t)MAX_CACHED_TEXELS,expectedEvaluations))
+		{
+			textureWidth = texture->getWidth();
+			textureHeight = texture->getHeight();
+			texels = new RRVec3[textureWidth*textureHeight];
+			for (unsigned i=0;i<textureWidth*textureHeight;i++)
+				texels[i] = texture->getElement(i,colorSpace);
+		}
+	}
+	else
+	if (light->fallOffAngleRad>=0 && std::isfinite(light->outerAngleRad) && std::isfinite(light->spotExponent))
+	{
+		// attenuation is exactly 1 inside inner cone, exactly 0 outside outer cone
+		RRReal fullyLitAngle = light->outerAngleRad-light->fallOffAngleRad-SPOT_ANGLE_MARGIN;
+		RRReal unlitAngle = light->outerAngleRad+SPOT_ANGLE_MARGIN;
+		if (fullyLitAngle>0)
+			cosFullyLit = cos(fullyLitAngle);
+		if (unlitAngle<RR_PI)
+			cosUnlit = cos(unlitAngle);
+	}
+}
+
+LightEvaluator::~LightEvaluator()
+{
+	delete[] texels;
+}
+
+bool LightEvaluator::isUpToDate() const
+{
+	// other parameters are read from light on each evaluation, only spot caches something derived from them
+	return light->type==type
+		&& light->enabled==enabled
+		&& light->projectedTexture==projectedTexture
+		&& (!projectedTexture || projectedTexture->version==projectedTextureVersion)
+		&& (type!=RRLight::SPOT || (light->position==position
+			&& light->direction==direction
+			&& light->outerAngleRad==outerAngleRad
+			&& light->fallOffAngleRad==fallOffAngleRad
+			&& light->spotExponent==spotExponent));
+}
+
+RRReal LightEvaluator::getSpotAttenuation(const RRVec3& receiverPosition) const
+{
+	// the same as in RRLight::getIrradiance(), with shortcuts for receivers inside inner cone and outside outer cone
+	float angleCos = dot(light->direction,(receiverPosition-light->position+RRVec3(PREVENT_INF)).normalized());
+	if (angleCos>cosFullyLit)
+		return 1;
+	if (angleCos<cosUnlit)
+		return 0;
+	float angleRad = acos(RR_CLAMPED(angleCos,-1,1));
+	float angleAttenuation = (light->outerAngleRad-angleRad)/light->fallOffAngleRad;
+	return pow(RR_CLAMPED(angleAttenuation,0,1),((light->distanceAttenuationType!=RRLight::POLYNOMIAL)?SRGB2PHYS:1)*RR_MAX(light->spotExponent,1e-10f));
+}
+
+RRVec3 LightEvaluator::getProjectedTexture(const RRVec3& receiverPosition) const
+{
+	// the same as RRCamera::getPositionInViewport()
+	double tmp[4],out[4];
+	for (int i=0; i<4; i++) tmp[i] = receiverPosition[0] * viewMatrix[0*4+i] + receiverPosition[1] * viewMatrix[1*4+i] + receiverPosition[2] * viewMatrix[2*4+i] + viewMatrix[3*4+i];
+	for (int i=0; i<4; i++) out[i] = tmp[0] * projectionMatrix[0*4+i] + tmp[1] * projectionMatrix[1*4+i] + tmp[2] * projectionMatrix[2*4+i] + tmp[3] * projectionMatrix[3*4+i];
+	RRVec3 piw((RRReal)(out[0]/out[3]),(RRReal)(out[1]/out[3]),(RRReal)(out[2]/out[3]));
+	if (!(piw.x>-1 && piw.x<1 && piw.y>-1 && piw.y<1 && piw.z>-1 && piw.z<1))
+		return RRVec3(0);
+	RRVec3 position(piw.x*0.5f+0.5f,piw.y*0.5f+0.5f,0);
+	if (!texels)
+		return light->projectedTexture->getElementAtPosition(position,colorSpace,false);
+	// the same as RRBufferInMemory::getElementAtPosition()
+	unsigned x = (unsigned)((fmodf(position[0],1)+2) * textureWidth) % textureWidth;
+	unsigned y = (unsigned)((fmodf(position[1],1)+2) * textureHeight) % textureHeight;
+	return texels[x+y*textureWidth];
+}
+
+RRVec3 LightEvaluator::getIrradiance(const RRVec3& receiverPosition) const
+{
+	RRVec3 irradiance;
+	getIrradiance(&receiverPosition,&irradiance,1);
+	return irradiance;
+}
+
+void LightEvaluator::getIrradiance(const RRVec3* receiverPositions, RRVec3* irradiances, size_t numReceivers) const
+{
+	if (!builtin)
+	{
+		for (size_t i=0;i<numReceivers;i++)
+			irradiances[i] = light->getIrradiance(receiverPositions[i],colorSpace);
+		return;
+	}
+	const RRVec3& color = light->color;
+	if (light->type==RRLight::DIRECTIONAL)
+	{
+		for (size_t i=0;i<numReceivers;i++)
+			irradiances[i] = color;
+		return;
+	}
+
+	// the same as RRLight::getIrradiance(), but each step is done for all receivers, with switches outside loops
+	const RRVec3& position = light->position;
+	switch (light->distanceAttenuationType)
+	{
+		case RRLight::REALISTIC:
+			for (size_t i=0;i<numReceivers;i++)
+			{
+				float distanceAttenuation = 1/(PREVENT_INF+(receiverPositions[i]-position).length2());
+				irradiances[i] = color * distanceAttenuation;
+			}
+			break;
+		case RRLight::POLYNOMIAL:
+		{
+			const RRVec4& polynom = light->polynom;
+			for (size_t i=0;i<numReceivers;i++)
+			{
+				float distanceAttenuation = 1/RR_MAX(polynom[0]+polynom[1]*(receiverPositions[i]-position).length()+polynom[2]*(receiverPositions[i]-position).length2(),polynom[3]);
+				irradiances[i] = color * distanceAttenuation;
+			}
+			break;
+		}
+		case RRLight::EXPONENTIAL:
+		{
+			RRReal radius = light->radius;
+			RRReal fallOffExponent = light->fallOffExponent;
+			for (size_t i=0;i<numReceivers;i++)
+			{
+				float distanceAttenuation = pow(RR_MAX(0,1-(receiverPositions[i]-position).length2()/(radius*radius)),fallOffExponent);
+				irradiances[i] = color * distanceAttenuation;
+			}
+			break;
+		}
+		case RRLight::NONE:
+			for (size_t i=0;i<numReceivers;i++)
+				irradiances[i] = color;
+			break;
+	}
+
+	if (light->type==RRLight::SPOT)
+	{
+		if (light->projectedTexture)
+		{
+			for (size_t i=0;i<numReceivers;i++)
+				irradiances[i] *= getProjectedTexture(receiverPositions[i]);
+		}
+		else
+		{
+			for (size_t i=0;i<numReceivers;i++)
+				irradiances[i] *= getSpotAttenuation(receiverPositions[i]);
+		}
+	}
+
+	if (colorSpace && light->distanceAttenuationType==RRLight::POLYNOMIAL)
+		for (size_t i=0;i<numReceivers;i++)
+			colorSpace->toLinear(irradiances[i]);
+}
+
+RRVec3 LightEvaluator::getIrradianceSample(const RRVec3& receiverPosition, const RRVec2& sample, RRVec3& directionToLight, RRReal& distanceToLight) const
+{
+	RRReal multiplier;
+	RRVec3 position = sampleLightArea(*light,receiverPosition,sample,directionToLight,distanceToLight,multiplier);
+	return getIrradiance(position)*multiplier;
+}
+
+void LightEvaluator::getIrradianceSamples(const RRVec3* receiverPositions, const RRVec2* samples, RRVec3* irradiances, RRVec3* directionsToLight, RRReal* distancesToLight, size_t numReceivers) const
+{
+	enum {CHUNK=64};
+	RRVec3 positions[CHUNK];
+	RRReal multipliers[CHUNK];
+	for (size_t first=0;first<numReceivers;first+=CHUNK)
+	{
+		size_t num = RR_MIN((size_t)CHUNK,numReceivers-first);
+		for (size_t i=0;i<num;i++)
+			positions[i] = sampleLightArea(*light,receiverPositions[first+i],samples[first+i],directionsToLight[first+i],distancesToLight[first+i],multipliers[i]);
+		getIrradiance(positions,irradiances+first,num);
+		for (size_t i=0;i<num;i++)
+			irradiances[first+i] *= multipliers[i];
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// LightEvaluators
+
+static size_t getLightHash(const RRLight* light)
+{
+	return ((size_t)light>>4)*2654435761u;
+}
+
+LightEvaluators::LightEvaluators(const RRLights& lights, const RRColorSpace* colorSpace)
+{
+	size_t tableSize = 1;
+	while (tableSize<2*lights.size())
+		tableSize *= 2;
+	table.resize(tableSize,nullptr);
+	for (unsigned i=0;i<lights.size();i++)
+	{
+		LightEvaluator* evaluator = lights[i] ? new LightEvaluator(lights[i],colorSpace) : nullptr;
+		evaluators.push_back(evaluator);
+		if (evaluator)
+			for (size_t slot=getLightHash(lights[i]);;slot++)
+			{
+				slot &= tableSize-1;
+				if (!table[slot])
+				{
+					table[slot] = evaluator;
+					break;
+				}
+				if (table[slot]->light==lights[i])
+					break; // light is in list twice, the first evaluator is found
+			}
+	}
+}
+
+LightEvaluators::~LightEvaluators()
+{
+	for (unsigned i=0;i<evaluators.size();i++)
+		delete evaluators[i];
+}
+
+const LightEvaluator* LightEvaluators::find(const RRLight* light) const
+{
+	for (size_t slot=getLightHash(light);;slot++)
+	{
+		slot &= table.size()-1;
+		if (!table[slot] || table[slot]->light==light)
+			return table[slot];
+	}
+}
+
+bool LightEvaluators::isUpToDate(const RRLights& lights, const RRColorSpace* colorSpace) const
+{
+	if (lights.size()!=evaluators.size())
+		return false;
+	for (unsigned i=0;i<lights.size();i++)
+	{
+		const LightEvaluator* evaluator = evaluators[i];
+		if (evaluator ? evaluator->light!=lights[i] || evaluator->colorSpace!=colorSpace || !evaluator->isUpToDate() : lights[i]!=nullptr)
+			return false;
+	}
+	return true;
+}
+
 } // namespace
@@ -43,13 +43,13 @@ struct LightFieldParameters
 	{
 		return version==LIGHTFIELD_STRUCTURE_VERSION && fieldSize() && aabbSize[0]>=0 && aabbSize[1]>=0 && aabbSize[2]>=0 && aabbSize[3]>=0 && (aabbSize[0]>0 || aabbSize[1]>0 || aabbSize[2]>0 || aabbSize[3]>0);
 	}
-	unsigned cellSize() const
+	size_t cellSize() const
 	{
-		return (envMapSize*envMapSize*6)*3;
+		return ((size_t)envMapSize*envMapSize*6)*3;
 	}
-	unsigned fieldSize() const
+	size_t fieldSize() const
 	{
-		return gridSize[0]*gridSize[1]*gridSize[2]*gridSize[3]*cellSize();
+		return (size_t)gridSize[0]*gridSize[1]*gridSize[2]*gridSize[3]*cellSize();
 	}
 };
 
@@ -101,8 +101,8 @@ public:
 			unsigned cellIndex = i+header.gridSize[0]*(j+header.gridSize[1]*(k+timeSlot*header.gridSize[2]));
 			if (reflectionEnvMap)
 			{
-				memcpy(rawField+cellIndex*header.envMapSize*header.envMapSize*6*3,
-					reflectionEnvMap->lock(BL_READ),header.envMapSize*header.envMapSize*6*3);
+				memcpy(rawField+cellIndex*header.cellSize(),
+					reflectionEnvMap->lock(BL_READ),header.cellSize());
 				reflectionEnvMap->unlock();
 			}
 			// report progress
@@ -136,10 +136,10 @@ public:
 		if (header.gridSize[3]==1)
 		{
 			// faster 3D blend
-			unsigned cellSize = header.cellSize();
+			size_t cellSize = header.cellSize();
 			unsigned numFields = header.gridSize[0]*header.gridSize[1]*header.gridSize[2];
 			unsigned cellIndex = cellCoordInt[0]+cellCoordInt[1]*header.gridSize[0]+cellCoordInt[2]*header.gridSize[0]*header.gridSize[1];
-			unsigned cellOffset[8];
+			size_t cellOffset[8];
 			unsigned cellWeight[8];
 			for (unsigned i=0;i<8;i++)
 			{
@@ -162,10 +162,10 @@ public:
 		else
 		{
 			// slower 4D blend
-			unsigned cellSize = header.cellSize();
+			size_t cellSize = header.cellSize();
 			unsigned numFields = header.gridSize[0]*header.gridSize[1]*header.gridSize[2]*header.gridSize[3];
 			unsigned cellIndex = cellCoordInt[0]+header.gridSize[0]*(cellCoordInt[1]+header.gridSize[1]*(cellCoordInt[2]+header.gridSize[2]*cellCoordInt[3]));
-			unsigned cellOffset[16];
+			size_t cellOffset[16];
 			unsigned cellWeight[16];
 			for (unsigned i=0;i<16;i++)
 			{
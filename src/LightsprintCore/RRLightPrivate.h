@@ -0,0 +1,110 @@
+// --------------------------------------------------------------------------
+// Copyright (C) 1999-2021 Stepan Hrbek
+// This file is part of Lightsprint SDK, you can use and/or redistribute it
+// only under terms of Lightsprint SDK license agreement. A copy of the agreement
+// is available by contacting Lightsprint at http://lightsprint.com
+//
+// Light evaluation for local use.
+// --------------------------------------------------------------------------
+
+#ifndef RRLIGHTPRIVATE_H
+#define RRLIGHTPRIVATE_H
+
+#include <cstdint>
+#include <vector>
+#include "Lightsprint/RRLight.h"
+
+namespace rr
+{
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// LightEvaluator
+//
+// Light prepared for evaluating irradiance many times, e.g. once per bake.
+// Results are the same as from RRLight::getIrradiance() and RRLight::getIrradianceSample(),
+// but work that does not depend on receiver is done only once in constructor
+// (projection of spotlight's projected texture, conversion of texture to linear colors, spot cone angles).
+// Changed light needs new evaluator, isUpToDate() detects changes made since construction.
+// Lights with custom getIrradiance() are evaluated by calling it.
+// Never modified after construction, so it can be read by many threads.
+
+class LightEvaluator
+{
+public:
+	// expectedEvaluations is number of receivers evaluator will be used for, projected texture is not converted when it has more texels.
+	LightEvaluator(const RRLight* light, const RRColorSpace* colorSpace, size_t expectedEvaluations = SIZE_MAX);
+	~LightEvaluator();
+
+	// The same as light->getIrradiance().
+	RRVec3 getIrradiance(const RRVec3& receiverPosition) const;
+	// The same as light->getIrradiance() for each receiver, faster than calling it in loop.
+	void getIrradiance(const RRVec3* receiverPositions, RRVec3* irradiances, size_t numReceivers) const;
+	// The same as light->getIrradianceSample().
+	RRVec3 getIrradianceSample(const RRVec3& receiverPosition, const RRVec2& sample, RRVec3& directionToLight, RRReal& distanceToLight) const;
+	// The same as light->getIrradianceSample() for each receiver and sample.
+	void getIrradianceSamples(const RRVec3* receiverPositions, const RRVec2* samples, RRVec3* irradiances, RRVec3* directionsToLight, RRReal* distancesToLight, size_t numReceivers) const;
+	// Returns false if light changed in a way that makes evaluator return wrong results.
+	bool isUpToDate() const;
+
+	const RRLight* light;
+	const RRColorSpace* colorSpace;
+
+private:
+	LightEvaluator(const LightEvaluator&);
+	void operator=(const LightEvaluator&);
+	RRReal getSpotAttenuation(const RRVec3& receiverPosition) const;
+	RRVec3 getProjectedTexture(const RRVec3& receiverPosition) const;
+
+	bool builtin; // light does not override getIrradiance(), evaluator computes it
+	// spot without projected texture, cosines of angles where attenuation is exactly 1 and exactly 0
+	// (with small margin for rounding errors, attenuation between them is computed with acos() and pow())
+	RRReal cosFullyLit;
+	RRReal cosUnlit;
+	// spot with projected texture
+	double viewMatrix[16];
+	double projectionMatrix[16];
+	RRVec3* texels; // projected texture in linear colors, nullptr if it is not cached and must be sampled by virtual call
+	unsigned textureWidth;
+	unsigned textureHeight;
+	// light parameters used in constructor, for isUpToDate()
+	RRLight::Type type;
+	bool enabled;
+	RRVec3 position;
+	RRVec3 direction;
+	RRReal outerAngleRad;
+	RRReal fallOffAngleRad;
+	RRReal spotExponent;
+	const RRBuffer* projectedTexture;
+	unsigned projectedTextureVersion;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// LightEvaluators
+//
+// Evaluators for all lights in list, in the same order.
+
+class LightEvaluators
+{
+public:
+	LightEvaluators(const RRLights& lights, const RRColorSpace* colorSpace);
+	~LightEvaluators();
+
+	// Returns evaluator of i-th light in list, nullptr for nullptr light.
+	const LightEvaluator* operator[](unsigned index) const {return evaluators[index];}
+	// Returns evaluator of light, nullptr if light is not in list.
+	const LightEvaluator* find(const RRLight* light) const;
+	unsigned size() const {return (unsigned)evaluators.size();}
+	// Returns false if evaluators were created for different lights or colorSpace, or if any light changed.
+	bool isUpToDate(const RRLights& lights, const RRColorSpace* colorSpace) const;
+
+private:
+	std::vector<LightEvaluator*> evaluators;
+	std::vector<const LightEvaluator*> table; // open addressing hash table for find()
+};
+
+}; // namespace
+
+#endif
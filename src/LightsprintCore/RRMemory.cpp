@@ -15,6 +15,11 @@
 #include <cstring> // memcpy, memset
 #include <errno.h> // errno
 #include <wchar.h>
+#ifdef _WIN32
+	#include <windows.h> // VirtualAlloc
+#else
+	#include <sys/mman.h> // mmap
+#endif
 
 
 namespace rr
@@ -88,6 +93,154 @@ void RRAligned::operator delete[](void* p, std::size_t n)
 };
 
 
+/////////////////////////////////////////////////////////////////////////////
+//
+// RRArena
+
+enum
+{
+	SLAB_SIZE = 2*1024*1024, // size of huge page on x86
+};
+
+struct Slab
+{
+	Slab* next;
+	size_t size; // bytes in data
+	char* data;
+
+	static Slab* create(size_t size)
+	{
+		size_t bytes = (sizeof(Slab)+size+SLAB_SIZE-1)/SLAB_SIZE*SLAB_SIZE;
+#ifdef _WIN32
+		void* memory = VirtualAlloc(nullptr,bytes,MEM_RESERVE|MEM_COMMIT,PAGE_READWRITE);
+		if (!memory)
+			return nullptr;
+#else
+		void* memory = mmap(nullptr,bytes,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+		if (memory==MAP_FAILED)
+			return nullptr;
+	#ifdef MADV_HUGEPAGE
+		madvise(memory,bytes,MADV_HUGEPAGE);
+	#endif
+#endif
+		Slab* slab = (Slab*)memory;
+		slab->next = nullptr;
+		slab->data = (char*)(slab+1);
+		slab->size = bytes-sizeof(Slab);
+		return slab;
+	}
+
+	void destroy()
+	{
+#ifdef _WIN32
+		VirtualFree(this,0,MEM_RELEASE);
+#else
+		munmap(this,size+sizeof(Slab));
+#endif
+	}
+};
+
+RRArena::RRArena()
+{
+	firstSlab = nullptr;
+	currentSlab = nullptr;
+	used = 0;
+	numScopes = 0;
+}
+
+RRArena& RRArena::getThreadArena()
+{
+	static thread_local RRArena arena;
+	return arena;
+}
+
+void* RRArena::allocate(size_t bytes, size_t alignment)
+{
+	for (;;)
+	{
+		if (currentSlab)
+		{
+			size_t start = ((size_t)currentSlab->data+used+alignment-1) & ~(alignment-1);
+			if (start+bytes<=(size_t)currentSlab->data+currentSlab->size)
+			{
+				used = start+bytes-(size_t)currentSlab->data;
+				return (void*)start;
+			}
+		}
+		// continue in next free slab if it's big enough, otherwise insert new slab
+		Slab* next = currentSlab ? currentSlab->next : firstSlab;
+		if (!next || next->size<bytes+alignment)
+		{
+			Slab* slab = Slab::create(RR_MAX(bytes+alignment,SLAB_SIZE-sizeof(Slab)));
+			if (!slab)
+				return nullptr;
+			slab->next = next;
+			next = slab;
+			if (currentSlab)
+				currentSlab->next = slab;
+			else
+				firstSlab = slab;
+		}
+		currentSlab = next;
+		used = 0;
+	}
+}
+
+// Returns free slabs to OS, keeps one slab of default size for next scope.
+void RRArena::releaseSlabs()
+{
+	Slab* kept = currentSlab ? currentSlab : firstSlab;
+	if (kept)
+		while (kept->next)
+		{
+			Slab* slab = kept->next;
+			kept->next = slab->next;
+			slab->destroy();
+		}
+	if (!currentSlab && firstSlab && firstSlab->size+sizeof(Slab)>SLAB_SIZE)
+	{
+		firstSlab->destroy();
+		firstSlab = nullptr;
+	}
+}
+
+RRArena::~RRArena()
+{
+	RR_ASSERT(!numScopes);
+	currentSlab = nullptr;
+	releaseSlabs();
+	if (firstSlab)
+		firstSlab->destroy();
+}
+
+RRArena::Scope::Scope(RRArena& _arena) : arena(_arena)
+{
+	slab = arena.currentSlab;
+	used = arena.used;
+	arena.numScopes++;
+}
+
+RRArena::Scope::~Scope()
+{
+#ifdef _DEBUG
+	// poison released memory
+	for (Slab* s=slab?slab:arena.firstSlab;s;s=s->next)
+	{
+		size_t begin = (s==slab) ? used : 0;
+		size_t end = (s==arena.currentSlab) ? arena.used : s->size;
+		if (end>begin)
+			memset(s->data+begin,0xdd,end-begin);
+		if (s==arena.currentSlab)
+			break;
+	}
+#endif
+	arena.currentSlab = slab;
+	arena.used = used;
+	if (!--arena.numScopes)
+		arena.releaseSlabs();
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 //
 // RRString
@@ -25,6 +25,8 @@
 					// prevents errors from limited float precision:
 					// - BLINN_TORRANCE_SPARROW  - generates #IND if roughness<1/100'000'000
 					// - test\cuberefl-car.rr3   - car reflection is too bright if roughness<1/2'000'000
+#define MIN_GGX_ALPHA 0.0001f
+					// GGX alpha=roughness^2, smaller alpha would make alpha^2 denormal
 #define MAX_EMITTANCE 1e6f
 //#define BACKSIDE_ILLEGAL // sets 'illegal' flag on invisible backsides. no longer used, but LDM generator in Lightsmark still needs it
 
@@ -489,7 +491,7 @@ bool RRMaterial::validate(RRReal redistributedPhotonsLimit)
 
 	if (specularModel==PHONG || specularModel==BLINN_PHONG)
 		if (clamp1(specularShininess,0,MAX_SHININESS)) changed = true;
-	if (specularModel==TORRANCE_SPARROW || specularModel==BLINN_TORRANCE_SPARROW)
+	if (specularModel==TORRANCE_SPARROW || specularModel==BLINN_TORRANCE_SPARROW || specularModel==GGX)
 		if (clamp1(specularShininess,MIN_ROUGHNESS,1)) changed = true;
 
 	RRVec3 sum = diffuseReflectance.colorLinear+specularTransmittance.colorLinear+specularReflectance.colorLinear;
@@ -637,6 +639,86 @@ static RRReal specularResponse(RRMaterial::SpecularModel specularModel, RRReal s
 	return spec;
 }
 
+// Roughness -> GGX alpha.
+static RRReal getGgxAlpha(RRReal roughness)
+{
+	return RR_MAX(roughness*roughness,MIN_GGX_ALPHA);
+}
+
+// We have importance sampling of other models only for PHONG, so they are temporarily converted to PHONG.
+// (GGX reflection is sampled by sampleGgxReflection(), GGX transmission still uses PHONG)
+static RRReal getPhongShininess(RRMaterial::SpecularModel specularModel, RRReal specularShininess)
+{
+	if (specularModel==RRMaterial::PHONG || specularModel==RRMaterial::BLINN_PHONG)
+		return RR_MIN(specularShininess,MAX_SHININESS);
+	if (specularModel==RRMaterial::GGX)
+	{
+		RRReal alpha = getGgxAlpha(specularShininess);
+		return RR_MIN(2/(alpha*alpha)-2,MAX_SHININESS);
+	}
+	return 1/RR_MAX(specularShininess,MIN_ROUGHNESS)-1;
+}
+
+// Smith Lambda for GGX, cosTheta is cosine of angle between direction and normal.
+static RRReal getGgxLambda(RRReal cosTheta, RRReal alpha2)
+{
+	return (sqrt(1+alpha2*(1/(cosTheta*cosTheta)-1))-1)*0.5f;
+}
+
+// dirIn,dirNormal,dirOut -> result, pdf
+// Result is pi*brdf*cos(dirIn,normal), the same scale as other brdfs, for white specular color.
+// Pdf is probability density of sampleGgxReflection() generating dirIn, in the same scale.
+static RRReal ggxResponse(RRReal alpha, const RRMaterial::Response& response, RRReal& pdf)
+{
+	pdf = 0;
+	RRReal NV = response.dirOut.dot(response.dirNormal);
+	RRReal NL = -response.dirIn.dot(response.dirNormal);
+	if (!(NV>0 && NL>0))
+		return 0;
+	RRReal NH = RR_MAX(0,response.dirNormal.dot((response.dirOut-response.dirIn).normalized()));
+	RRReal alpha2 = alpha*alpha;
+	RRReal d = NH*NH*(alpha2-1)+1;
+	RRReal piD4NV = alpha2/(d*d*4*NV); // pi*D/(4*NV)
+	RRReal lambdaV = getGgxLambda(NV,alpha2);
+	RRReal lambdaL = getGgxLambda(NL,alpha2);
+	// distribution of visible normals: pdf = G1(V)*D/(4*NV)
+	pdf = piD4NV/(1+lambdaV);
+	// brdf*NL = F*D*G2/(4*NV), height-correlated G2 = 1/(1+lambdaV+lambdaL)
+	RRReal spec = piD4NV/(1+lambdaV+lambdaL);
+	if (!std::isfinite(spec) || !std::isfinite(pdf))
+	{
+		pdf = 0;
+		return 0;
+	}
+	return spec;
+}
+
+// Samples direction of incoming light by sampling distribution of visible GGX normals (Heitz 2018).
+// Returns dirIn, it may be below surface, in such case ggxResponse() returns 0.
+static RRVec3 sampleGgxReflection(const RRVec2& uv, const RRVec3& dirOut, const RRVec3& normal, RRReal alpha)
+{
+	RRMesh::TangentBasis basisOrthonormal;
+	basisOrthonormal.normal = normal;
+	basisOrthonormal.buildBasisFromNormal();
+	// view direction in hemisphere configuration (alpha=1)
+	RRVec3 v = RRVec3(alpha*dirOut.dot(basisOrthonormal.tangent),alpha*dirOut.dot(basisOrthonormal.bitangent),dirOut.dot(normal)).normalized();
+	RRReal lensq = v.x*v.x+v.y*v.y;
+	RRVec3 t1 = (lensq>0) ? RRVec3(-v.y,v.x,0)/sqrt(lensq) : RRVec3(1,0,0);
+	RRVec3 t2 = v.cross(t1);
+	// uniform point on projected disk
+	RRReal r = sqrt(uv[0]);
+	RRReal phi = 2*RR_PI*uv[1];
+	RRReal p1 = r*cos(phi);
+	RRReal p2 = r*sin(phi);
+	RRReal s = 0.5f*(1+v.z);
+	p2 = (1-s)*sqrt(RR_MAX(0,1-p1*p1))+s*p2;
+	// back to ellipsoid configuration
+	RRVec3 h = t1*p1+t2*p2+v*sqrt(RR_MAX(0,1-p1*p1-p2*p2));
+	RRVec3 hLocal = RRVec3(alpha*h.x,alpha*h.y,RR_MAX(0,h.z)).normalized();
+	RRVec3 microNormal = basisOrthonormal.tangent*hLocal.x + basisOrthonormal.bitangent*hLocal.y + normal*hLocal.z;
+	return -reflect(-dirOut,microNormal);
+}
+
 // 0..1, fraction of specularTransmittance that is turned into specularReflectance
 float getFresnelReflectance(float cos_theta1, bool twosided, bool hitFrontSide, float materialRefractionIndex)
 {
@@ -700,11 +782,18 @@ void RRMaterial::getResponse(Response& response, BrdfType type) const
 					specularTransmittance_colorLinear *= 1-fresnelReflectance;
 				}
 
-				RRVec3 dirInMajor = (type==BRDF_SPECULAR) ? reflect(response.dirOut,response.dirNormal) : refract(response.dirOut,response.dirNormal,this);
-				// we have importance sampling implemented only for PHONG, so other models are temporarily converted to PHONG
-				RRReal phongShininess = (specularModel==PHONG || specularModel==BLINN_PHONG) ? RR_MIN(specularShininess,MAX_SHININESS) : (1/RR_MAX(specularShininess,MIN_ROUGHNESS)-1);
-				RRReal spec = specularResponse(PHONG,phongShininess,response,dirInMajor);
-				//RRReal spec = specularResponse(specularModel,specularShininess,response,dirInMajor);
+				RRReal spec;
+				if (type==BRDF_SPECULAR && specularModel==GGX)
+				{
+					RRReal pdf;
+					spec = ggxResponse(getGgxAlpha(specularShininess),response,pdf);
+				}
+				else
+				{
+					RRVec3 dirInMajor = (type==BRDF_SPECULAR) ? reflect(response.dirOut,response.dirNormal) : refract(response.dirOut,response.dirNormal,this);
+					spec = specularResponse(PHONG,getPhongShininess(specularModel,specularShininess),response,dirInMajor);
+					//spec = specularResponse(specularModel,specularShininess,response,dirInMajor);
+				}
 				response.colorOut = ((type==BRDF_SPECULAR) ? specularReflectance_colorLinear : specularTransmittance_colorLinear) * spec;
 				RR_ASSERT(response.colorOut.finite());
 			}
@@ -780,10 +869,23 @@ void RRMaterial::sampleResponse(Response& response, const RRVec3& randomness, Br
 				}
 				[[fallthrough]];
 		case BRDF_SPECULAR:
+			if (type==BRDF_SPECULAR && specularModel==GGX)
+			{
+				response.dirIn = sampleGgxReflection(randomness,response.dirOut,response.dirNormal,getGgxAlpha(specularShininess));
+				response.brdfType = type;
+				getResponse(response,type);
+				response.pdf = getResponsePdf(response,type);
+				if (!(response.pdf>0))
+				{
+					// sampled direction is below surface, light is lost (GGX without multiple scattering)
+					response.colorOut = RRVec3(0);
+					response.pdf = 0;
+				}
+			}
+			else
 			{
 				RRVec3 dirInMajor = (type==BRDF_SPECULAR) ? reflect(response.dirOut,response.dirNormal) : refract(response.dirOut,response.dirNormal,this);
-				// we have importance sampling implemented only for PHONG, so other models are temporarily converted to PHONG
-				RRReal phongShininess = (specularModel==PHONG || specularModel==BLINN_PHONG) ? RR_MIN(specularShininess,MAX_SHININESS) : (1/RR_MAX(specularShininess,MIN_ROUGHNESS)-1);
+				RRReal phongShininess = getPhongShininess(specularModel,specularShininess);
 				RRVec4 sample = sampleHemisphereSpecular(randomness,dirInMajor,phongShininess);
 				response.dirIn = sample;
 				response.pdf = sample.w;
@@ -847,6 +949,43 @@ void RRMaterial::sampleResponse(Response& response, const RRVec3& randomness, Br
 	}
 }
 
+// dirIn, dirNormal, dirOut -> pdf
+RRReal RRMaterial::getResponsePdf(const Response& response, BrdfType type) const
+{
+	switch (type)
+	{
+		case BRDF_DIFFUSE:
+			// the same as in sampleHemisphereDiffuse()
+			return RR_MAX(0,-response.dirIn.dot(response.dirNormal));
+		case BRDF_TRANSMIT:
+			if (specularTransmittance.texture && specularTransmittance.colorLinear==RRVec3(1))
+			{
+				// hole in transparency texture, pass through without shininess and refraction
+				return (response.dirIn==response.dirOut) ? 1.f : 0.f;
+			}
+			[[fallthrough]];
+		case BRDF_SPECULAR:
+			if (type==BRDF_SPECULAR && specularModel==GGX)
+			{
+				RRReal pdf;
+				ggxResponse(getGgxAlpha(specularShininess),response,pdf);
+				return pdf;
+			}
+			else
+			{
+				// the same as in sampleHemisphereSpecular()
+				RRVec3 dirInMajor = (type==BRDF_SPECULAR) ? reflect(response.dirOut,response.dirNormal) : refract(response.dirOut,response.dirNormal,this);
+				RRReal phongShininess = getPhongShininess(specularModel,specularShininess);
+				RRReal cosTheta = response.dirIn.dot(dirInMajor.normalized());
+				return (phongShininess+1)*pow(RR_CLAMPED(cosTheta,0,1),phongShininess);
+			}
+		default:
+			// pdf of combined brdfs depends on colors of individual samples, see sampleResponse()
+			RR_ASSERT(0);
+			return 0;
+	}
+}
+
 
 //////////////////////////////////////////////////////////////////////////////
 //
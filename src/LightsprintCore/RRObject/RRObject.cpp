@@ -13,7 +13,12 @@
 #include "RRObjectFilter.h"
 #include "RRObjectFilterTransformed.h"
 #include "../NumReports.h"
+#include <algorithm> // upper_bound
+#include <atomic>
+#include <climits> // UINT_MAX
 #include <cstdio> // vsnprintf
+#include <mutex>
+#include <vector>
 
 namespace rr
 {
@@ -122,16 +127,106 @@ bool RRObject::FaceGroups::containsEmittance() const
 //
 // RRObject
 
+//////////////////////////////////////////////////////////////////////////////
+//
+// FaceGroupIndex
+//
+// Triangle->facegroup lookup for default getTriangleMaterial(), built lazily from faceGroups.
+// Built index is never modified, so concurrent readers need no lock.
+// Rebuild (only after faceGroups change) takes lock. faceGroups must not change while other threads read them,
+// so nobody reads index older than previous one; previous is kept for readers that loaded it just before rebuild,
+// older ones are deleted.
+
+class FaceGroupIndex
+{
+public:
+	struct Index
+	{
+		unsigned version;
+		unsigned numFaceGroups;
+		const RRObject::FaceGroup* faceGroupsData;
+		std::vector<unsigned> firstTriangle; // numFaceGroups+1 elements, firstTriangle[g] = number of triangles in facegroups 0..g-1
+		std::vector<unsigned short> faceGroupOfTriangle; // per triangle, only for objects with many facegroups and not too many triangles
+
+		Index(const RRObject::FaceGroups& faceGroups, unsigned _version)
+		{
+			version = _version;
+			numFaceGroups = faceGroups.size();
+			faceGroupsData = numFaceGroups ? &faceGroups[0] : nullptr;
+			firstTriangle.resize(numFaceGroups+1);
+			firstTriangle[0] = 0;
+			for (unsigned g=0;g<numFaceGroups;g++)
+				firstTriangle[g+1] = firstTriangle[g]+faceGroups[g].numTriangles;
+			// 2 bytes per triangle are not worth it for huge meshes, binary search is used there
+			if (numFaceGroups<=USHRT_MAX && firstTriangle[numFaceGroups]<=4*1024*1024)
+			{
+				faceGroupOfTriangle.resize(firstTriangle[numFaceGroups]);
+				for (unsigned g=0;g<numFaceGroups;g++)
+					std::fill(faceGroupOfTriangle.begin()+firstTriangle[g],faceGroupOfTriangle.begin()+firstTriangle[g+1],(unsigned short)g);
+			}
+		}
+		bool isValid(const RRObject::FaceGroups& faceGroups, unsigned _version) const
+		{
+			return version==_version && numFaceGroups==faceGroups.size() && faceGroupsData==(numFaceGroups?&faceGroups[0]:nullptr);
+		}
+		// Returns facegroup that contains triangle t, UINT_MAX if facegroups contain less than t+1 triangles.
+		unsigned getFaceGroup(unsigned t) const
+		{
+			if (t>=firstTriangle[numFaceGroups])
+				return UINT_MAX;
+			if (faceGroupOfTriangle.size())
+				return faceGroupOfTriangle[t];
+			// skips empty facegroups, the same as linear walk in faceGroups
+			return (unsigned)(std::upper_bound(firstTriangle.begin(),firstTriangle.end(),t)-firstTriangle.begin())-1;
+		}
+	};
+
+	FaceGroupIndex()
+	{
+		current = nullptr;
+		previous = nullptr;
+	}
+	const Index* getIndex(const RRObject::FaceGroups& faceGroups, unsigned version)
+	{
+		const Index* index = current.load(std::memory_order_acquire);
+		if (index && index->isValid(faceGroups,version))
+			return index;
+		std::lock_guard<std::mutex> lock(mutex);
+		index = current.load(std::memory_order_relaxed);
+		if (index && index->isValid(faceGroups,version))
+			return index; // other thread was faster
+		Index* newIndex = new Index(faceGroups,version);
+		delete previous;
+		previous = index;
+		current.store(newIndex,std::memory_order_release);
+		return newIndex;
+	}
+	~FaceGroupIndex()
+	{
+		delete previous;
+		delete current.load();
+	}
+
+private:
+	std::atomic<const Index*> current;
+	const Index* previous; // protected by mutex
+	std::mutex mutex;
+};
+
+
 RRObject::RRObject()
 {
 	collider = nullptr;
 	worldMatrix = nullptr;
+	faceGroupIndex = new FaceGroupIndex;
+	faceGroupsVersion = 0;
 	enabled = true;
 	isDynamic = false;
 }
 
 RRObject::~RRObject()
 {
+	delete faceGroupIndex;
 	delete worldMatrix;
 }
 
@@ -144,6 +239,13 @@ void RRObject::setCollider(RRCollider* _collider)
 
 RRMaterial* RRObject::getTriangleMaterial(unsigned t, const class RRLight* light, const RRObject* receiver) const
 {
+	// linear walk is faster for few facegroups, index for many
+	if (faceGroups.size()>8)
+	{
+		unsigned g = faceGroupIndex->getIndex(faceGroups,faceGroupsVersion)->getFaceGroup(t);
+		if (g!=UINT_MAX)
+			return faceGroups[g].material;
+	}
 	unsigned tt = t;
 	for (unsigned g=0;g<faceGroups.size();g++)
 	{
@@ -191,26 +293,64 @@ void RRObject::updateFaceGroupsFromTriangleMaterials()
 			faceGroups[faceGroups.size()-1].numTriangles++;
 		}
 	}
+	faceGroupsVersion++;
 }
 
+// Samples texture at triangle point, from mipmaps if material.rayFootprint is set.
+class PointTextureSampler
+{
+public:
+	PointTextureSampler(const rr::RRMesh* _mesh, unsigned _t, RRVec2 _uv, bool _interpolated, RRReal _rayFootprint)
+		: mesh(_mesh), t(_t), uv(_uv), interpolated(_interpolated), rayFootprint(_rayFootprint), triangleArea(-1)
+	{
+	}
+	RRVec4 sample(const RRMaterial::Property& property, const RRColorSpace* colorSpace)
+	{
+		RRMesh::TriangleMapping triangleMapping;
+		mesh->getTriangleMapping(t,triangleMapping,property.texcoord);
+		RRVec2 materialUv = triangleMapping.uv[0]*(1-uv[0]-uv[1]) + triangleMapping.uv[1]*uv[0] + triangleMapping.uv[2]*uv[1];
+		if (rayFootprint>0)
+		{
+			if (triangleArea<0)
+			{
+				RRMesh::TriangleBody body;
+				mesh->getTriangleBody(t,body);
+				triangleArea = body.side1.cross(body.side2).length();
+			}
+			RRVec2 side1 = triangleMapping.uv[1]-triangleMapping.uv[0];
+			RRVec2 side2 = triangleMapping.uv[2]-triangleMapping.uv[0];
+			RRReal mappingArea = fabs(side1[0]*side2[1]-side1[1]*side2[0]);
+			if (triangleArea>0 && mappingArea>0)
+			{
+				// footprint in texels = footprint in mesh units * texels per mesh unit
+				RRReal footprint = rayFootprint*sqrt(mappingArea*property.texture->getWidth()*property.texture->getHeight()/triangleArea);
+				return property.texture->getElementAtPositionMipmapped(materialUv,footprint,colorSpace,interpolated);
+			}
+		}
+		return property.texture->getElementAtPosition(RRVec3(materialUv[0],materialUv[1],0),colorSpace,interpolated);
+	}
+private:
+	const rr::RRMesh* mesh;
+	unsigned t;
+	RRVec2 uv;
+	bool interpolated;
+	RRReal rayFootprint;
+	RRReal triangleArea; // -1 = not calculated yet
+};
+
 // Expects material prefilled with getTriangleMaterial(), both color and colorLinear.
 // Updates color and (if colorSpace!=nullptr) colorLinear for properties with texture.
 static void updatePointMaterial(const rr::RRMesh* mesh, unsigned t, RRVec2 uv, const RRColorSpace* colorSpace, bool interpolated, RRPointMaterial& material)
 {
 	// Make color (and possibly also colorLinear) more accurate using textures.
+	PointTextureSampler sampler(mesh,t,uv,interpolated,material.rayFootprint);
 	if (material.diffuseEmittance.texture)
 	{
-		RRMesh::TriangleMapping triangleMapping;
-		mesh->getTriangleMapping(t,triangleMapping,material.diffuseEmittance.texcoord);
-		RRVec2 materialUv = triangleMapping.uv[0]*(1-uv[0]-uv[1]) + triangleMapping.uv[1]*uv[0] + triangleMapping.uv[2]*uv[1];
-		material.diffuseEmittance.colorLinear = material.diffuseEmittance.texture->getElementAtPosition(RRVec3(materialUv[0],materialUv[1],0),colorSpace,interpolated);
+		material.diffuseEmittance.colorLinear = sampler.sample(material.diffuseEmittance,colorSpace);
 	}
 	if (material.specularReflectance.texture)
 	{
-		RRMesh::TriangleMapping triangleMapping;
-		mesh->getTriangleMapping(t,triangleMapping,material.specularReflectance.texcoord);
-		RRVec2 materialUv = triangleMapping.uv[0]*(1-uv[0]-uv[1]) + triangleMapping.uv[1]*uv[0] + triangleMapping.uv[2]*uv[1];
-		RRVec4 specColor = material.specularReflectance.texture->getElementAtPosition(RRVec3(materialUv[0],materialUv[1],0),colorSpace,interpolated);
+		RRVec4 specColor = sampler.sample(material.specularReflectance,colorSpace);
 		material.specularReflectance.colorLinear = specColor;
 		// shininess is modulated by specular map alpha. does nothing if specular map is RGB only [#18]
 		if (material.specularModel==RRMaterial::PHONG || material.specularModel==RRMaterial::BLINN_PHONG)
@@ -225,10 +365,7 @@ static void updatePointMaterial(const rr::RRMesh* mesh, unsigned t, RRVec2 uv, c
 	if (material.diffuseReflectance.texture && material.specularTransmittance.texture==material.diffuseReflectance.texture && material.specularTransmittanceInAlpha)
 	{
 		// optional optimized path: transmittance in diffuse map alpha
-		RRMesh::TriangleMapping triangleMapping;
-		mesh->getTriangleMapping(t,triangleMapping,material.diffuseReflectance.texcoord);
-		RRVec2 materialUv= triangleMapping.uv[0]*(1-uv[0]-uv[1]) + triangleMapping.uv[1]*uv[0] + triangleMapping.uv[2]*uv[1];
-		RRVec4 rgba = material.diffuseReflectance.texture->getElementAtPosition(RRVec3(materialUv[0],materialUv[1],0),nullptr,interpolated);
+		RRVec4 rgba = sampler.sample(material.diffuseReflectance,nullptr);
 		RRReal specularTransmittance = 1-rgba[3];
 		if (material.specularTransmittanceMapInverted)
 			specularTransmittance = 1-specularTransmittance;
@@ -253,17 +390,11 @@ static void updatePointMaterial(const rr::RRMesh* mesh, unsigned t, RRVec2 uv, c
 		// generic path
 		if (material.diffuseReflectance.texture)
 		{
-			RRMesh::TriangleMapping triangleMapping;
-			mesh->getTriangleMapping(t,triangleMapping,material.diffuseReflectance.texcoord);
-			RRVec2 materialUv = triangleMapping.uv[0]*(1-uv[0]-uv[1]) + triangleMapping.uv[1]*uv[0] + triangleMapping.uv[2]*uv[1];
-			material.diffuseReflectance.colorLinear = material.diffuseReflectance.texture->getElementAtPosition(RRVec3(materialUv[0],materialUv[1],0),colorSpace,interpolated);
+			material.diffuseReflectance.colorLinear = sampler.sample(material.diffuseReflectance,colorSpace);
 		}
 		if (material.specularTransmittance.texture)
 		{
-			RRMesh::TriangleMapping triangleMapping;
-			mesh->getTriangleMapping(t,triangleMapping,material.specularTransmittance.texcoord);
-			RRVec2 materialUv = triangleMapping.uv[0]*(1-uv[0]-uv[1]) + triangleMapping.uv[1]*uv[0] + triangleMapping.uv[2]*uv[1];
-			RRVec4 rgba = material.specularTransmittance.texture->getElementAtPosition(RRVec3(materialUv[0],materialUv[1],0),nullptr,interpolated);
+			RRVec4 rgba = sampler.sample(material.specularTransmittance,nullptr);
 			material.specularTransmittance.color = material.specularTransmittanceInAlpha ? RRVec3(1-rgba[3]) : rgba;
 			if (material.specularTransmittanceMapInverted)
 				material.specularTransmittance.color = RRVec3(1)-material.specularTransmittance.color;
@@ -0,0 +1,632 @@
+// --------------------------------------------------------------------------
+// Copyright (C) 1999-2021 Stepan Hrbek
+// This file is part of Lightsprint SDK, you can use and/or redistribute it
+// only under terms of Lightsprint SDK license agreement. A copy of the agreement
+// is available by contacting Lightsprint at http://lightsprint.com
+//
+// Hierarchy of objects, frustum and occlusion culling.
+// --------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "Lightsprint/RRObject.h"
+#include "Lightsprint/RRCamera.h"
+
+namespace rr
+{
+
+enum
+{
+	MAX_OBJECTS_IN_LEAF = 4,
+	MIN_PARALLEL_TASKS = 64, // frustum traversal splits hierarchy to at least this many subtrees
+	MAX_OCCLUDER_TRIANGLES = 65536, // triangles rasterized into occlusion depth buffer per cull()
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// BVHBox
+
+struct BVHBox
+{
+	RRVec3 mini;
+	RRVec3 maxi;
+
+	void reset()
+	{
+		mini = RRVec3(1e35f);
+		maxi = RRVec3(-1e35f);
+	}
+	// False after reset(), for objects without triangles.
+	bool isValid() const
+	{
+		return mini.x<=maxi.x;
+	}
+	void add(const BVHBox& a)
+	{
+		for (unsigned i=0;i<3;i++)
+		{
+			mini[i] = RR_MIN(mini[i],a.mini[i]);
+			maxi[i] = RR_MAX(maxi[i],a.maxi[i]);
+		}
+	}
+	RRReal getSurface() const
+	{
+		RRVec3 size = maxi-mini;
+		return (size.x<0) ? 0 : size.x*size.y+size.y*size.z+size.z*size.x;
+	}
+	RRVec3 getCenter() const
+	{
+		return (mini+maxi)*0.5f;
+	}
+	RRVec3 getCorner(unsigned i) const
+	{
+		return RRVec3((i&1)?maxi.x:mini.x,(i&2)?maxi.y:mini.y,(i&4)?maxi.z:mini.z);
+	}
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// Frustum
+
+struct Frustum
+{
+	RRVec4 plane[6]; // inside when dot(plane.xyz,position)+plane.w>=0
+
+	Frustum(const RRCamera& camera)
+	{
+		// planes of clip space transformed back to world space
+		const double* view = camera.getViewMatrix();
+		const double* projection = camera.getProjectionMatrix();
+		double m[16];
+		for (unsigned j=0;j<4;j++)
+			for (unsigned i=0;i<4;i++)
+				m[j*4+i] = view[j*4+0]*projection[0*4+i] + view[j*4+1]*projection[1*4+i] + view[j*4+2]*projection[2*4+i] + view[j*4+3]*projection[3*4+i];
+		for (unsigned p=0;p<6;p++)
+		{
+			unsigned axis = p/2;
+			double sign = (p&1) ? -1 : 1;
+			plane[p] = RRVec4((RRReal)(m[0*4+3]+sign*m[0*4+axis]),(RRReal)(m[1*4+3]+sign*m[1*4+axis]),(RRReal)(m[2*4+3]+sign*m[2*4+axis]),(RRReal)(m[3*4+3]+sign*m[3*4+axis]));
+		}
+	}
+
+	// Returns false if box is outside. Clears bits of planes that have box completely inside.
+	bool test(const BVHBox& box, unsigned& planeMask) const
+	{
+		for (unsigned p=0;p<6;p++)
+			if (planeMask&(1<<p))
+			{
+				const RRVec4& pl = plane[p];
+				RRVec3 farthest((pl.x>0)?box.maxi.x:box.mini.x,(pl.y>0)?box.maxi.y:box.mini.y,(pl.z>0)?box.maxi.z:box.mini.z);
+				if (pl.x*farthest.x+pl.y*farthest.y+pl.z*farthest.z+pl.w<0)
+					return false;
+				RRVec3 nearest((pl.x>0)?box.mini.x:box.maxi.x,(pl.y>0)?box.mini.y:box.maxi.y,(pl.z>0)?box.mini.z:box.maxi.z);
+				if (pl.x*nearest.x+pl.y*nearest.y+pl.z*nearest.z+pl.w>=0)
+					planeMask &= ~(1<<p);
+			}
+		return true;
+	}
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// OcclusionBuffer
+//
+// Low resolution depth buffer with max-depth mip pyramid (hierarchical Z).
+// Only texels completely covered by occluder triangle are written, with triangle's farthest depth,
+// so test against it is conservative.
+
+class OcclusionBuffer
+{
+public:
+	OcclusionBuffer(const RRCamera& _camera, unsigned _width, unsigned _height) : camera(_camera)
+	{
+		for (unsigned w=_width,h=_height;;w=(w+1)/2,h=(h+1)/2)
+		{
+			Level level;
+			level.width = w;
+			level.height = h;
+			level.depth.resize(w*h,1);
+			levels.push_back(level);
+			if (w==1 && h==1)
+				break;
+		}
+	}
+
+	// Adds triangles of object with opaque materials.
+	// Triangles that cross near or far plane are skipped, GPU would clip them.
+	void addOccluder(const RRObject* object, const RRMesh* mesh)
+	{
+		const RRMatrix3x4Ex* world = object->getWorldMatrix();
+		const RRObject::FaceGroups& faceGroups = object->faceGroups;
+		unsigned t = 0;
+		for (unsigned g=0;g<faceGroups.size();g++)
+		{
+			const RRMaterial* material = faceGroups[g].material;
+			bool opaque = material && !material->specularTransmittance.texture && material->specularTransmittance.color==RRVec3(0);
+			for (unsigned i=0;i<faceGroups[g].numTriangles;i++,t++)
+			{
+				if (!opaque)
+					continue;
+				RRMesh::Triangle triangle;
+				mesh->getTriangle(t,triangle);
+				Triangle screen;
+				bool valid = true;
+				for (unsigned v=0;v<3;v++)
+				{
+					RRMesh::Vertex vertex;
+					mesh->getVertex(triangle[v],vertex);
+					if (world)
+						world->transformPosition(vertex);
+					RRVec4 clip = camera.getPositionInClipSpace(vertex);
+					if (!(clip.w>0) || clip.z<-clip.w || clip.z>clip.w)
+					{
+						valid = false;
+						break;
+					}
+					screen.x[v] = (clip.x/clip.w*0.5f+0.5f)*levels[0].width;
+					screen.y[v] = (clip.y/clip.w*0.5f+0.5f)*levels[0].height;
+					screen.depth = v ? RR_MAX(screen.depth,clip.z/clip.w) : clip.z/clip.w;
+				}
+				if (!valid)
+					continue;
+				// GPU renders front side (counterclockwise) and back side only if material says so
+				RRReal area2 = (screen.x[1]-screen.x[0])*(screen.y[2]-screen.y[0])-(screen.y[1]-screen.y[0])*(screen.x[2]-screen.x[0]);
+				if (!material->sideBits[(area2>0)?0:1].renderFrom || area2==0)
+					continue;
+				if (area2<0)
+				{
+					std::swap(screen.x[1],screen.x[2]);
+					std::swap(screen.y[1],screen.y[2]);
+				}
+				triangles.push_back(screen);
+			}
+		}
+	}
+
+	// Rasterizes occluders and builds pyramid.
+	void rasterize()
+	{
+		Level& level0 = levels[0];
+		enum {ROWS_PER_TASK=8};
+		int numTasks = (int)(level0.height+ROWS_PER_TASK-1)/ROWS_PER_TASK;
+		#pragma omp parallel for schedule(dynamic) if(triangles.size()>1000)
+		for (int task=0;task<numTasks;task++)
+		{
+			int taskMinY = task*ROWS_PER_TASK;
+			int taskMaxY = RR_MIN(taskMinY+ROWS_PER_TASK,(int)level0.height)-1;
+			for (size_t i=0;i<triangles.size();i++)
+			{
+				const Triangle& tri = triangles[i];
+				int minX = RR_MAX(0,(int)floorf(RR_MIN3(tri.x[0],tri.x[1],tri.x[2])));
+				int maxX = RR_MIN((int)level0.width-1,(int)ceilf(RR_MAX3(tri.x[0],tri.x[1],tri.x[2]))-1);
+				int minY = RR_MAX(taskMinY,(int)floorf(RR_MIN3(tri.y[0],tri.y[1],tri.y[2])));
+				int maxY = RR_MIN(taskMaxY,(int)ceilf(RR_MAX3(tri.y[0],tri.y[1],tri.y[2]))-1);
+				if (minX>maxX || minY>maxY)
+					continue;
+				// edge functions, texel is inside when all three are above half of texel's extent
+				RRReal a[3], b[3], c[3];
+				for (unsigned e=0;e<3;e++)
+				{
+					unsigned f = (e+1)%3;
+					a[e] = tri.y[e]-tri.y[f];
+					b[e] = tri.x[f]-tri.x[e];
+					c[e] = -a[e]*tri.x[e]-b[e]*tri.y[e] - 0.5f*(fabs(a[e])+fabs(b[e]));
+				}
+				for (int y=minY;y<=maxY;y++)
+				{
+					RRReal* row = &level0.depth[y*level0.width];
+					for (int x=minX;x<=maxX;x++)
+					{
+						RRReal cx = x+0.5f;
+						RRReal cy = y+0.5f;
+						if (a[0]*cx+b[0]*cy+c[0]>=0 && a[1]*cx+b[1]*cy+c[1]>=0 && a[2]*cx+b[2]*cy+c[2]>=0)
+							row[x] = RR_MIN(row[x],tri.depth);
+					}
+				}
+			}
+		}
+		for (unsigned l=1;l<levels.size();l++)
+		{
+			const Level& src = levels[l-1];
+			Level& dst = levels[l];
+			for (unsigned y=0;y<dst.height;y++)
+				for (unsigned x=0;x<dst.width;x++)
+				{
+					unsigned x1 = RR_MIN(2*x+1,src.width-1);
+					unsigned y1 = RR_MIN(2*y+1,src.height-1);
+					dst.depth[y*dst.width+x] = RR_MAX(
+						RR_MAX(src.depth[2*y*src.width+2*x],src.depth[2*y*src.width+x1]),
+						RR_MAX(src.depth[y1*src.width+2*x],src.depth[y1*src.width+x1]));
+				}
+		}
+	}
+
+	// Returns true if box is surely hidden behind occluders.
+	bool isOccluded(const BVHBox& box) const
+	{
+		RRReal minX = 1e35f, maxX = -1e35f, minY = 1e35f, maxY = -1e35f, minDepth = 1e35f;
+		for (unsigned i=0;i<8;i++)
+		{
+			RRVec4 clip = camera.getPositionInClipSpace(box.getCorner(i));
+			if (!(clip.w>0) || clip.z<-clip.w)
+				return false; // box crosses near plane
+			RRReal x = (clip.x/clip.w*0.5f+0.5f)*levels[0].width;
+			RRReal y = (clip.y/clip.w*0.5f+0.5f)*levels[0].height;
+			minX = RR_MIN(minX,x);
+			maxX = RR_MAX(maxX,x);
+			minY = RR_MIN(minY,y);
+			maxY = RR_MAX(maxY,y);
+			minDepth = RR_MIN(minDepth,clip.z/clip.w);
+		}
+		int x0 = RR_MAX(0,(int)floorf(minX));
+		int x1 = RR_MIN((int)levels[0].width-1,(int)floorf(maxX));
+		int y0 = RR_MAX(0,(int)floorf(minY));
+		int y1 = RR_MIN((int)levels[0].height-1,(int)floorf(maxY));
+		if (x0>x1 || y0>y1)
+			return false; // outside viewport, frustum culling decides
+		// level where box covers at most 4x4 texels
+		unsigned l = 0;
+		while (l+1<levels.size() && ((x1>>l)-(x0>>l)>3 || (y1>>l)-(y0>>l)>3))
+			l++;
+		const Level& level = levels[l];
+		for (int y=y0>>l;y<=(y1>>l);y++)
+			for (int x=x0>>l;x<=(x1>>l);x++)
+				if (level.depth[y*level.width+x]>=minDepth)
+					return false;
+		return true;
+	}
+
+private:
+	struct Triangle
+	{
+		RRReal x[3];
+		RRReal y[3];
+		RRReal depth; // the farthest vertex
+	};
+	struct Level
+	{
+		unsigned width;
+		unsigned height;
+		std::vector<RRReal> depth; // in normalized device coordinates, 1 = far plane
+	};
+	const RRCamera& camera;
+	std::vector<Triangle> triangles;
+	std::vector<Level> levels;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// ObjectBVH
+
+class ObjectBVH : public RRObjectBVH
+{
+public:
+	ObjectBVH(const RRObjects& _objects)
+	{
+		update(_objects);
+	}
+
+	virtual void update(const RRObjects& _objects) override
+	{
+		bool rebuild = _objects.size()!=objects.size();
+		if (!rebuild)
+			for (unsigned i=0;i<objects.size();i++)
+				if (_objects[i]!=objects[i].object)
+				{
+					rebuild = true;
+					break;
+				}
+		if (rebuild)
+		{
+			objects.resize(_objects.size());
+			#pragma omp parallel for schedule(static) if(objects.size()>RR_OMP_MIN_ELEMENTS)
+			for (int i=0;i<(int)objects.size();i++)
+				objects[i].update(_objects[i]);
+			build();
+			return;
+		}
+
+		// refit, objects that got or lost box are added to or removed from hierarchy by build
+		unsigned numChanged = 0, numValidityChanged = 0;
+		#pragma omp parallel for schedule(static) reduction(+:numChanged,numValidityChanged) if(objects.size()>RR_OMP_MIN_ELEMENTS)
+		for (int i=0;i<(int)objects.size();i++)
+			if (objects[i].hasChanged())
+			{
+				bool wasValid = objects[i].box.isValid();
+				objects[i].update(objects[i].object);
+				numChanged++;
+				if (objects[i].box.isValid()!=wasValid)
+					numValidityChanged++;
+			}
+		if (numValidityChanged)
+			build();
+		else
+		if (numChanged)
+		{
+			refit();
+			if (getCost()>2*builtCost)
+				build();
+		}
+	}
+
+	virtual unsigned cull(const RRCamera& camera, unsigned occlusionResolution, RRVector<bool>& visible) const override
+	{
+		unsigned numObjects = (unsigned)objects.size();
+		visible.resize(numObjects);
+		if (camera.panoramaMode!=RRCamera::PM_OFF || nodes.empty())
+		{
+			for (unsigned i=0;i<numObjects;i++)
+				visible[i] = objects[i].object!=nullptr;
+			return numObjects;
+		}
+		for (unsigned i=0;i<numObjects;i++)
+			visible[i] = false;
+
+		// frustum culling, top of hierarchy is split to tasks processed in parallel
+		Frustum frustum(camera);
+		std::vector<Task> tasks;
+		tasks.push_back(Task{0,63});
+		for (size_t i=0;i<tasks.size() && tasks.size()<MIN_PARALLEL_TASKS;)
+		{
+			Task task = tasks[i];
+			const Node& node = nodes[task.node];
+			if (node.numObjects || !frustum.test(node.box,task.planeMask))
+			{
+				i++;
+				continue;
+			}
+			tasks[i] = Task{task.node+1,task.planeMask};
+			tasks.push_back(Task{node.right,task.planeMask});
+		}
+		#pragma omp parallel for schedule(dynamic)
+		for (int i=0;i<(int)tasks.size();i++)
+			traverse(frustum,tasks[i].node,tasks[i].planeMask,visible);
+
+		// occlusion culling
+		if (occlusionResolution)
+		{
+			unsigned width = occlusionResolution;
+			unsigned height = RR_CLAMPED((unsigned)(occlusionResolution/camera.getAspect()),1,4*occlusionResolution);
+			OcclusionBuffer occlusionBuffer(camera,width,height);
+			selectOccluders(camera,visible,occlusionBuffer);
+			occlusionBuffer.rasterize();
+			#pragma omp parallel for schedule(static) if(numObjects>RR_OMP_MIN_ELEMENTS)
+			for (int i=0;i<(int)numObjects;i++)
+				if (visible[i] && occlusionBuffer.isOccluded(objects[i].box))
+					visible[i] = false;
+		}
+
+		unsigned numVisible = 0;
+		for (unsigned i=0;i<numObjects;i++)
+			if (visible[i])
+				numVisible++;
+		return numVisible;
+	}
+
+private:
+	struct ObjectInfo
+	{
+		const RRObject* object;
+		const RRMesh* mesh;
+		unsigned numTriangles; // of mesh, object without triangles has invalid box
+		RRVec3 meshMini,meshMaxi; // local space box of mesh, detects edited vertices (RRMeshArrays recalculates box after version++)
+		RRMatrix3x4 worldMatrix;
+		BVHBox box; // in world space
+
+		bool hasChanged() const
+		{
+			if (!object)
+				return false;
+			const RRMatrix3x4Ex* matrix = object->getWorldMatrix();
+			if (mesh!=(object->getCollider()?object->getCollider()->getMesh():nullptr))
+				return true;
+			if (mesh)
+			{
+				if (mesh->getNumTriangles()!=numTriangles)
+					return true;
+				RRVec3 mini,maxi;
+				mesh->getAABB(&mini,&maxi,nullptr);
+				if (mini!=meshMini || maxi!=meshMaxi)
+					return true;
+			}
+			return matrix ? worldMatrix!=*matrix : worldMatrix!=RRMatrix3x4::identity();
+		}
+		void update(const RRObject* _object)
+		{
+			object = _object;
+			mesh = (object && object->getCollider()) ? object->getCollider()->getMesh() : nullptr;
+			const RRMatrix3x4Ex* matrix = object ? object->getWorldMatrix() : nullptr;
+			if (matrix)
+				worldMatrix = *matrix;
+			else
+				worldMatrix = RRMatrix3x4::identity();
+			box.reset();
+			numTriangles = mesh ? mesh->getNumTriangles() : 0;
+			meshMini = meshMaxi = RRVec3(0);
+			if (mesh)
+				mesh->getAABB(&meshMini,&meshMaxi,nullptr);
+			if (numTriangles)
+			{
+				// transformed box of mesh
+				RRVec3 center = worldMatrix.getTransformedPosition((meshMini+meshMaxi)*0.5f);
+				RRVec3 extent = (meshMaxi-meshMini)*0.5f;
+				RRVec3 worldExtent;
+				for (unsigned i=0;i<3;i++)
+					worldExtent[i] = fabs(worldMatrix.m[i][0])*extent.x+fabs(worldMatrix.m[i][1])*extent.y+fabs(worldMatrix.m[i][2])*extent.z;
+				box.mini = center-worldExtent;
+				box.maxi = center+worldExtent;
+			}
+		}
+	};
+
+	// Nodes are stored in depth first order, left child follows its parent.
+	struct Node
+	{
+		BVHBox box;
+		unsigned right; // index of right child
+		unsigned firstObject; // index into order
+		unsigned numObjects; // 0 = inner node
+	};
+
+	struct Task
+	{
+		unsigned node;
+		unsigned planeMask;
+	};
+
+	std::vector<ObjectInfo> objects;
+	std::vector<unsigned> order; // object indices, leaves point to ranges in it
+	std::vector<Node> nodes;
+	RRReal builtCost; // getCost() after build
+
+	void build()
+	{
+		nodes.clear();
+		order.clear();
+		for (unsigned i=0;i<objects.size();i++)
+			if (objects[i].box.isValid())
+				order.push_back(i);
+		if (!order.empty())
+			buildNode(0,(unsigned)order.size());
+		builtCost = getCost();
+	}
+
+	// Median split along the longest axis of centers.
+	void buildNode(unsigned first, unsigned count)
+	{
+		unsigned index = (unsigned)nodes.size();
+		nodes.push_back(Node());
+		BVHBox box, centers;
+		box.reset();
+		centers.reset();
+		for (unsigned i=first;i<first+count;i++)
+		{
+			const BVHBox& objectBox = objects[order[i]].box;
+			box.add(objectBox);
+			BVHBox center = {objectBox.getCenter(),objectBox.getCenter()};
+			centers.add(center);
+		}
+		nodes[index].box = box;
+		if (count<=MAX_OBJECTS_IN_LEAF)
+		{
+			nodes[index].right = 0;
+			nodes[index].firstObject = first;
+			nodes[index].numObjects = count;
+			return;
+		}
+		RRVec3 size = centers.maxi-centers.mini;
+		unsigned axis = (size.x>=size.y && size.x>=size.z) ? 0 : ((size.y>=size.z) ? 1 : 2);
+		unsigned half = count/2;
+		std::nth_element(order.begin()+first,order.begin()+first+half,order.begin()+first+count,
+			[this,axis](unsigned a, unsigned b) {return objects[a].box.mini[axis]+objects[a].box.maxi[axis]<objects[b].box.mini[axis]+objects[b].box.maxi[axis];});
+		nodes[index].firstObject = first;
+		nodes[index].numObjects = 0;
+		buildNode(first,half);
+		nodes[index].right = (unsigned)nodes.size();
+		buildNode(first+half,count-half);
+	}
+
+	void refit()
+	{
+		for (size_t n=nodes.size();n--;)
+		{
+			Node& node = nodes[n];
+			node.box.reset();
+			if (node.numObjects)
+				for (unsigned i=node.firstObject;i<node.firstObject+node.numObjects;i++)
+					node.box.add(objects[order[i]].box);
+			else
+			{
+				node.box.add(nodes[n+1].box);
+				node.box.add(nodes[node.right].box);
+			}
+		}
+	}
+
+	// Sum of node surfaces, estimates cost of traversal.
+	RRReal getCost() const
+	{
+		RRReal cost = 0;
+		for (size_t n=0;n<nodes.size();n++)
+			cost += nodes[n].box.getSurface();
+		return cost;
+	}
+
+	void traverse(const Frustum& frustum, unsigned n, unsigned planeMask, RRVector<bool>& visible) const
+	{
+		const Node& node = nodes[n];
+		if (planeMask && !frustum.test(node.box,planeMask))
+			return;
+		if (node.numObjects)
+		{
+			for (unsigned i=node.firstObject;i<node.firstObject+node.numObjects;i++)
+			{
+				unsigned objectPlaneMask = planeMask;
+				if (!planeMask || frustum.test(objects[order[i]].box,objectPlaneMask))
+					visible[order[i]] = true;
+			}
+			return;
+		}
+		traverse(frustum,n+1,planeMask,visible);
+		traverse(frustum,node.right,planeMask,visible);
+	}
+
+	// Adds the biggest visible opaque objects to occlusion buffer.
+	void selectOccluders(const RRCamera& camera, const RRVector<bool>& visible, OcclusionBuffer& occlusionBuffer) const
+	{
+		struct Occluder
+		{
+			RRReal size;
+			unsigned object;
+			bool operator <(const Occluder& a) const {return size>a.size;}
+		};
+		std::vector<Occluder> occluders;
+		for (unsigned i=0;i<objects.size();i++)
+			if (visible[i] && objects[i].object->enabled)
+			{
+				// size of box in viewport, boxes that cross near plane are treated as big
+				Occluder occluder = {4,i};
+				RRVec2 mini(1e35f), maxi(-1e35f);
+				for (unsigned c=0;c<8;c++)
+				{
+					RRVec4 clip = camera.getPositionInClipSpace(objects[i].box.getCorner(c));
+					if (!(clip.w>0))
+						break;
+					RRVec2 position(RR_CLAMPED(clip.x/clip.w,-1,1),RR_CLAMPED(clip.y/clip.w,-1,1));
+					mini.x = RR_MIN(mini.x,position.x); mini.y = RR_MIN(mini.y,position.y);
+					maxi.x = RR_MAX(maxi.x,position.x); maxi.y = RR_MAX(maxi.y,position.y);
+					if (c==7)
+						occluder.size = (maxi.x-mini.x)*(maxi.y-mini.y);
+				}
+				if (occluder.size>0.01f) // at least 1/400 of viewport
+					occluders.push_back(occluder);
+			}
+		std::sort(occluders.begin(),occluders.end());
+		unsigned budget = MAX_OCCLUDER_TRIANGLES;
+		for (unsigned i=0;i<occluders.size();i++)
+		{
+			unsigned numTriangles = objects[occluders[i].object].mesh->getNumTriangles();
+			if (numTriangles<=budget)
+			{
+				occlusionBuffer.addOccluder(objects[occluders[i].object].object,objects[occluders[i].object].mesh);
+				budget -= numTriangles;
+			}
+		}
+	}
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// RRObjectBVH
+
+RRObjectBVH* RRObjectBVH::create(const RRObjects& objects)
+{
+	return new ObjectBVH(objects);
+}
+
+}; // namespace
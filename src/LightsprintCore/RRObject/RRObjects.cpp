@@ -13,6 +13,7 @@
 #include "RRObjectMulti.h"
 #include <unordered_set>
 #include <unordered_map>
+#include <omp.h>
 #include <filesystem>
 namespace bf = std::filesystem;
 
@@ -315,6 +316,7 @@ unsigned RRObjects::optimizeFaceGroups(RRObject* object) const
 					// copy tmp to object
 					memcpy(mesh->triangle,tmpTriangles,mesh->numTriangles*sizeof(RRMesh::Triangle));
 					object->faceGroups = tmpFaceGroups;
+					object->faceGroupsVersion++;
 					// delete tmp
 					delete[] tmpTriangles;
 				}
@@ -607,6 +609,7 @@ void RRObjects::smoothAndStitch(bool splitVertices, bool mergeVertices, bool rem
 					}
 				}
 				objects[j]->faceGroups = faceGroups;
+				objects[j]->faceGroupsVersion++;
 			}
 		}
 
@@ -972,32 +975,81 @@ again:
 }
 
 
-unsigned RRObjects::loadLayer(int layerNumber, const RRString& path, const RRString& ext) const
+static int getLayerThreads(unsigned maxThreads, size_t numJobs)
+{
+	int numThreads = omp_get_max_threads();
+	if (maxThreads && (int)maxThreads<numThreads)
+		numThreads = (int)maxThreads;
+	if ((size_t)numThreads>numJobs)
+		numThreads = (int)RR_MAX(numJobs,1);
+	return numThreads;
+}
+
+unsigned RRObjects::loadLayer(int layerNumber, const RRString& path, const RRString& ext, unsigned maxThreads) const
 {
 	unsigned result = 0;
 	if (layerNumber>=0)
 	{
+		// filenames are recommended by virtual function implemented by user, call it from this thread only
+		struct LoadJob
+		{
+			RRString pixelFilename;
+			RRString vertexFilename;
+			RRBuffer* buffer;
+			bool perVertex;
+		};
+		std::vector<LoadJob> jobs(size());
+		std::vector<RRObject::LayerParameters> layerParameters(size());
 		for (unsigned objectIndex=0;objectIndex<size();objectIndex++)
 		{
-			RRObject* object = (*this)[objectIndex];
-			// first try to load per-pixel format
-			RRBuffer* buffer = nullptr;
-			RRObject::LayerParameters layerParameters;
-			layerParameters.suggestedPath = path;
-			layerParameters.suggestedExt = ext;
-			object->recommendLayerParameters(layerParameters);
+			layerParameters[objectIndex].suggestedPath = path;
+			layerParameters[objectIndex].suggestedExt = ext;
+			(*this)[objectIndex]->recommendLayerParameters(layerParameters[objectIndex]);
+			jobs[objectIndex].pixelFilename = layerParameters[objectIndex].actualFilename;
+			jobs[objectIndex].buffer = nullptr;
+			jobs[objectIndex].perVertex = false;
+		}
+
+		// first try to load per-pixel format, read and decode files in parallel
+		#pragma omp parallel for schedule(dynamic) num_threads(getLayerThreads(maxThreads,jobs.size()))
+		for (int objectIndex=0;objectIndex<(int)jobs.size();objectIndex++)
+		{
+			LoadJob& job = jobs[objectIndex];
 			std::error_code ec;
-			if ( !bf::exists(RR_RR2PATH(layerParameters.actualFilename),ec) || !(buffer=RRBuffer::load(layerParameters.actualFilename,nullptr)) )
+			if (bf::exists(RR_RR2PATH(job.pixelFilename),ec))
+				job.buffer = RRBuffer::load(job.pixelFilename,nullptr);
+		}
+
+		// if it fails, try to load per-vertex format
+		// only objects without map need second recommendation, with parameters updated by the first one
+		std::vector<unsigned> vertexJobs;
+		for (unsigned objectIndex=0;objectIndex<size();objectIndex++)
+			if (!jobs[objectIndex].buffer)
 			{
-				// if it fails, try to load per-vertex format
-				layerParameters.suggestedMapWidth = layerParameters.suggestedMapHeight = 0;
-				object->recommendLayerParameters(layerParameters);
-				if (bf::exists(RR_RR2PATH(layerParameters.actualFilename),ec))
-					buffer = RRBuffer::load(layerParameters.actualFilename.c_str());
+				layerParameters[objectIndex].suggestedMapWidth = layerParameters[objectIndex].suggestedMapHeight = 0;
+				(*this)[objectIndex]->recommendLayerParameters(layerParameters[objectIndex]);
+				jobs[objectIndex].vertexFilename = layerParameters[objectIndex].actualFilename;
+				jobs[objectIndex].perVertex = true;
+				vertexJobs.push_back(objectIndex);
 			}
+		#pragma omp parallel for schedule(dynamic) num_threads(getLayerThreads(maxThreads,vertexJobs.size()))
+		for (int i=0;i<(int)vertexJobs.size();i++)
+		{
+			LoadJob& job = jobs[vertexJobs[i]];
+			std::error_code ec;
+			if (bf::exists(RR_RR2PATH(job.vertexFilename),ec))
+				job.buffer = RRBuffer::load(job.vertexFilename);
+		}
+
+		// assign buffers in object order
+		for (unsigned objectIndex=0;objectIndex<size();objectIndex++)
+		{
+			RRObject* object = (*this)[objectIndex];
+			RRBuffer* buffer = jobs[objectIndex].buffer;
+			const RRString& filename = jobs[objectIndex].perVertex ? jobs[objectIndex].vertexFilename : jobs[objectIndex].pixelFilename;
 			if (buffer && buffer->getType()==BT_VERTEX_BUFFER && buffer->getWidth()!=object->getCollider()->getMesh()->getNumVertices())
 			{
-				RR_LIMITED_TIMES(5,RRReporter::report(ERRO,"%ls has wrong size.\n",layerParameters.actualFilename.w_str()));
+				RR_LIMITED_TIMES(5,RRReporter::report(ERRO,"%ls has wrong size.\n",filename.w_str()));
 				RR_SAFE_DELETE(buffer);
 			}
 			if (buffer)
@@ -1005,11 +1057,11 @@ unsigned RRObjects::loadLayer(int layerNumber, const RRString& path, const RRStr
 				delete object->illumination.getLayer(layerNumber);
 				object->illumination.getLayer(layerNumber) = buffer;
 				result++;
-				RRReporter::report(INF3,"Loaded %ls.\n",layerParameters.actualFilename.w_str());
+				RRReporter::report(INF3,"Loaded %ls.\n",filename.w_str());
 			}
 			else
 			{
-				RRReporter::report(INF3,"Not loaded %ls.\n",layerParameters.actualFilename.w_str());
+				RRReporter::report(INF3,"Not loaded %ls.\n",filename.w_str());
 			}
 		}
 		RRReporter::report(INF2,"Loaded %d/%" RR_SIZE_T "d buffers from %ls<object name>%ls to layer %d.\n",result,size(),path.w_str(),ext.w_str(),layerNumber);
@@ -1017,13 +1069,22 @@ unsigned RRObjects::loadLayer(int layerNumber, const RRString& path, const RRStr
 	return result;
 }
 
-unsigned RRObjects::saveLayer(int layerNumber, const RRString& path, const RRString& ext) const
+unsigned RRObjects::saveLayer(int layerNumber, const RRString& path, const RRString& ext, unsigned maxThreads) const
 {
 	bool directoryCreated = false;
 	unsigned numBuffers = 0;
 	unsigned numSaved = 0;
 	if (layerNumber>=0)
 	{
+		// filenames are recommended by virtual function implemented by user, call it from this thread only
+		struct SaveJob
+		{
+			RRBuffer* buffer;
+			RRString filename;
+			unsigned group; // jobs that share buffer or filename are saved by one thread, in object order
+			bool saved;
+		};
+		std::vector<SaveJob> jobs;
 		for (unsigned objectIndex=0;objectIndex<size();objectIndex++)
 		{
 			RRObject* object = (*this)[objectIndex];
@@ -1040,21 +1101,67 @@ unsigned RRObjects::saveLayer(int layerNumber, const RRString& path, const RRStr
 					directoryCreated = true;
 				}
 
-				numBuffers++;
 				RRObject::LayerParameters layerParameters;
 				layerParameters.suggestedPath = path;
 				layerParameters.suggestedExt = ext;
 				layerParameters.suggestedMapWidth = layerParameters.suggestedMapHeight = (buffer->getType()==BT_VERTEX_BUFFER) ? 0 : 256;
 				object->recommendLayerParameters(layerParameters);
-				if (buffer->save(layerParameters.actualFilename))
-				{
-					numSaved++;
-					RRReporter::report(INF3,"Saved %ls.\n",layerParameters.actualFilename.w_str());
-				}
-				else
-				if (!layerParameters.actualFilename.empty())
-					RRReporter::report(WARN,"Not saved %ls.\n",layerParameters.actualFilename.w_str());
+				SaveJob job;
+				job.buffer = buffer;
+				job.filename = layerParameters.actualFilename;
+				job.group = (unsigned)jobs.size();
+				job.saved = false;
+				jobs.push_back(job);
+			}
+		}
+		numBuffers = (unsigned)jobs.size();
+
+		// group jobs that must not run in parallel (union-find, groups are identified by their first job)
+		{
+			std::vector<unsigned> parent(jobs.size());
+			for (unsigned i=0;i<jobs.size();i++)
+				parent[i] = i;
+			auto find = [&parent](unsigned i) {while (parent[i]!=i) i = parent[i] = parent[parent[i]]; return i;};
+			auto join = [&parent,&find](unsigned i, unsigned j) {i = find(i); j = find(j); if (i<j) parent[j] = i; else parent[i] = j;};
+			std::unordered_map<const RRBuffer*,unsigned> firstWithBuffer;
+			std::unordered_map<std::wstring,unsigned> firstWithFilename;
+			for (unsigned i=0;i<jobs.size();i++)
+			{
+				auto b = firstWithBuffer.insert({jobs[i].buffer,i});
+				if (!b.second)
+					join(b.first->second,i);
+				auto f = firstWithFilename.insert({RR_RR2STDW(jobs[i].filename),i});
+				if (!f.second)
+					join(f.first->second,i);
 			}
+			for (unsigned i=0;i<jobs.size();i++)
+				jobs[i].group = find(i);
+		}
+		std::vector<unsigned> groups;
+		for (unsigned i=0;i<jobs.size();i++)
+			if (jobs[i].group==i)
+				groups.push_back(i);
+
+		// encode and write files in parallel, one file's encoding overlaps with other file's I/O
+		#pragma omp parallel for schedule(dynamic) num_threads(getLayerThreads(maxThreads,groups.size()))
+		for (int g=0;g<(int)groups.size();g++)
+		{
+			for (unsigned i=groups[g];i<jobs.size();i++)
+				if (jobs[i].group==groups[g])
+					jobs[i].saved = jobs[i].buffer->save(jobs[i].filename);
+		}
+
+		// report in object order
+		for (unsigned i=0;i<jobs.size();i++)
+		{
+			if (jobs[i].saved)
+			{
+				numSaved++;
+				RRReporter::report(INF3,"Saved %ls.\n",jobs[i].filename.w_str());
+			}
+			else
+			if (!jobs[i].filename.empty())
+				RRReporter::report(WARN,"Not saved %ls.\n",jobs[i].filename.w_str());
 		}
 		if (!numBuffers)
 			; // don't report saving empty layer
@@ -125,11 +125,10 @@ PackedSolverFile* Scene::packSolver(unsigned avgRaysFromTriangle, float importan
 	{
 		// write factors
 		packedSolverFile->packedFactors->newC1(i);
-		for (ChunkList<Factor>::const_iterator j=object->triangle[i].factors.begin(); *j; ++j)
+		for (const Factor* j=factorStorage.begin(object->triangle[i].factors); j<factorStorage.end(object->triangle[i].factors); j++)
 		{
-			unsigned destinationTriangle = (unsigned)( (*j)->destination-object->triangle );
-			RR_ASSERT(destinationTriangle<object->triangles);
-			packedSolverFile->packedFactors->newC2()->set((*j)->power,destinationTriangle);
+			RR_ASSERT(j->destination<object->triangles);
+			packedSolverFile->packedFactors->newC2()->set(j->power,j->destination);
 		}
 	}
 	packedSolverFile->packedFactors->newC1(object->triangles);
@@ -0,0 +1,406 @@
+// --------------------------------------------------------------------------
+// Copyright (C) 1999-2021 Stepan Hrbek
+// This file is part of Lightsprint SDK, you can use and/or redistribute it
+// only under terms of Lightsprint SDK license agreement. A copy of the agreement
+// is available by contacting Lightsprint at http://lightsprint.com
+//
+// Performance counters of bake stages.
+// --------------------------------------------------------------------------
+
+#include "Lightsprint/RRDebug.h"
+#include <atomic>
+#include <chrono>
+#include <climits> // UINT_MAX
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace rr
+{
+
+enum
+{
+	MAX_STAGES = 128, // stage 0 is root, it collects counts from outside of all stages
+	MAX_COUNTERS = 32,
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// stages and counters
+//
+// Stage is identified by name and parent, names are compared only when stage is entered.
+// Stages and counters are never deleted, so readers don't lock.
+// Each thread has its own innermost stage, workers of parallel loops get it from RRProfiler::Parent.
+
+struct Stage
+{
+	const char* name;
+	unsigned parent;
+};
+
+static std::atomic<bool>       g_enabled(false);
+static Stage                   g_stages[MAX_STAGES] = {{"",0}};
+static std::atomic<unsigned>   g_numStages(1);
+static const char*             g_counters[MAX_COUNTERS];
+static std::atomic<unsigned>   g_numCounters(0);
+
+// Serializes creation of stages, counters and thread data. Never destructed.
+static std::mutex& getMutex()
+{
+	static std::mutex* mutex = new std::mutex;
+	return *mutex;
+}
+
+static bool namesMatch(const char* a, const char* b)
+{
+	return a==b || !strcmp(a,b);
+}
+
+static unsigned findStage(unsigned parent, const char* name)
+{
+	for (unsigned i=1,n=g_numStages.load(std::memory_order_acquire);i<n;i++)
+		if (g_stages[i].parent==parent && namesMatch(g_stages[i].name,name))
+			return i;
+	std::lock_guard<std::mutex> lock(getMutex());
+	unsigned n = g_numStages.load();
+	for (unsigned i=1;i<n;i++)
+		if (g_stages[i].parent==parent && namesMatch(g_stages[i].name,name))
+			return i;
+	if (n==MAX_STAGES)
+	{
+		RR_LIMITED_TIMES(1,RRReporter::report(WARN,"Too many profiler stages, %s not measured separately.\n",name));
+		return parent;
+	}
+	g_stages[n].name = name;
+	g_stages[n].parent = parent;
+	g_numStages.store(n+1,std::memory_order_release);
+	return n;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// per-thread data
+//
+// Only owning thread writes, any thread reads when merging.
+// When thread ends, its data are reused by next new thread, counts keep accumulating (only sums are reported).
+
+struct ThreadData
+{
+	std::atomic<unsigned long long> calls[MAX_STAGES];
+	std::atomic<unsigned long long> nanoseconds[MAX_STAGES];
+	std::atomic<unsigned long long> counts[MAX_STAGES][MAX_COUNTERS];
+	bool inUse;
+
+	ThreadData()
+	{
+		clear();
+	}
+	void clear()
+	{
+		for (unsigned s=0;s<MAX_STAGES;s++)
+		{
+			calls[s] = 0;
+			nanoseconds[s] = 0;
+			for (unsigned c=0;c<MAX_COUNTERS;c++)
+				counts[s][c] = 0;
+		}
+	}
+	static void add(std::atomic<unsigned long long>& a, unsigned long long value)
+	{
+		a.store(a.load(std::memory_order_relaxed)+value,std::memory_order_relaxed);
+	}
+};
+
+static std::vector<ThreadData*>* g_threads = new std::vector<ThreadData*>; // never destructed, threads may end after static destruction
+
+// Trivially destructible, so that access does not go through initialization wrapper, counting rays is sensitive to it.
+struct ThreadLocal
+{
+	ThreadData* data;
+	unsigned stage; // innermost stage opened by this thread, 0 if none
+};
+
+static thread_local ThreadLocal t_local = {nullptr,0};
+
+// Returns thread's data to pool when thread ends.
+struct ThreadDataOwner
+{
+	ThreadData* data;
+	~ThreadDataOwner()
+	{
+		std::lock_guard<std::mutex> lock(getMutex());
+		data->inUse = false;
+		t_local.data = nullptr;
+	}
+};
+
+static ThreadData* acquireThreadData()
+{
+	ThreadData* data = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(getMutex());
+		for (size_t i=0;i<g_threads->size() && !data;i++)
+			if (!(*g_threads)[i]->inUse)
+				data = (*g_threads)[i];
+		if (!data)
+		{
+			data = new ThreadData;
+			g_threads->push_back(data);
+		}
+		data->inUse = true;
+	}
+	static thread_local ThreadDataOwner owner;
+	owner.data = data;
+	t_local.data = data;
+	return data;
+}
+
+static ThreadData* getThreadData(ThreadLocal& local)
+{
+	return local.data ? local.data : acquireThreadData();
+}
+
+static unsigned long long getNanoseconds()
+{
+	return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// RRProfiler
+
+void RRProfiler::setEnabled(bool enabled)
+{
+	g_enabled = enabled;
+}
+
+bool RRProfiler::isEnabled()
+{
+	return g_enabled.load(std::memory_order_relaxed);
+}
+
+void RRProfiler::reset()
+{
+	std::lock_guard<std::mutex> lock(getMutex());
+	for (size_t i=0;i<g_threads->size();i++)
+		(*g_threads)[i]->clear();
+}
+
+unsigned RRProfiler::getCounterId(const char* name)
+{
+	if (!name)
+		return UINT_MAX;
+	std::lock_guard<std::mutex> lock(getMutex());
+	unsigned n = g_numCounters.load();
+	for (unsigned i=0;i<n;i++)
+		if (namesMatch(g_counters[i],name))
+			return i;
+	if (n==MAX_COUNTERS)
+	{
+		RR_LIMITED_TIMES(1,RRReporter::report(WARN,"Too many profiler counters, %s not counted.\n",name));
+		return UINT_MAX;
+	}
+	g_counters[n] = name;
+	g_numCounters.store(n+1,std::memory_order_release);
+	return n;
+}
+
+void RRProfiler::count(unsigned counterId, unsigned long long value)
+{
+	if (!g_enabled.load(std::memory_order_relaxed) || counterId>=MAX_COUNTERS)
+		return;
+	ThreadLocal& local = t_local;
+	unsigned stage = local.stage; // read before getThreadData(), so that compiler doesn't look up thread local twice
+	ThreadData::add(getThreadData(local)->counts[stage][counterId],value);
+}
+
+unsigned RRProfiler::getStage()
+{
+	return t_local.stage;
+}
+
+RRProfiler::Parent::Parent(unsigned stage)
+{
+	ThreadLocal& local = t_local;
+	previous = local.stage;
+	local.stage = stage;
+}
+
+RRProfiler::Parent::~Parent()
+{
+	t_local.stage = previous;
+}
+
+RRProfiler::Scope::Scope(const char* name)
+{
+	stage = UINT_MAX;
+	if (!g_enabled.load(std::memory_order_relaxed) || !name)
+		return;
+	ThreadLocal& local = t_local;
+	previous = local.stage;
+	stage = findStage(local.stage,name);
+	local.stage = stage;
+	start = getNanoseconds();
+}
+
+RRProfiler::Scope::~Scope()
+{
+	if (stage==UINT_MAX)
+		return;
+	unsigned long long nanoseconds = getNanoseconds()-start;
+	ThreadLocal& local = t_local;
+	ThreadData* data = getThreadData(local);
+	ThreadData::add(data->calls[stage],1);
+	ThreadData::add(data->nanoseconds[stage],nanoseconds);
+	local.stage = previous;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// save
+
+struct MergedStage
+{
+	unsigned long long calls;
+	unsigned long long nanoseconds;
+	unsigned long long counts[MAX_COUNTERS];
+	bool used; // stage or any of its children has data
+};
+
+static void writeJsonString(FILE* f, const char* s)
+{
+	fputc('"',f);
+	for (;*s;s++)
+	{
+		if (*s=='"' || *s=='\\')
+			fputc('\\',f);
+		if ((unsigned char)*s>=32)
+			fputc(*s,f);
+	}
+	fputc('"',f);
+}
+
+static void writeJsonStage(FILE* f, unsigned s, const std::vector<MergedStage>& merged, unsigned numStages, unsigned numCounters, int indentation)
+{
+	fprintf(f,"%*s{\"name\": ",indentation,"");
+	writeJsonString(f,s?g_stages[s].name:"total");
+	fprintf(f,", \"calls\": %llu, \"seconds\": %.6f, \"counters\": {",merged[s].calls,merged[s].nanoseconds*1e-9);
+	bool first = true;
+	for (unsigned c=0;c<numCounters;c++)
+		if (merged[s].counts[c])
+		{
+			fprintf(f,first?"":", ");
+			writeJsonString(f,g_counters[c]);
+			fprintf(f,": %llu",merged[s].counts[c]);
+			first = false;
+		}
+	fprintf(f,"}, \"stages\": [");
+	first = true;
+	for (unsigned child=1;child<numStages;child++)
+		if (g_stages[child].parent==s && merged[child].used)
+		{
+			fprintf(f,first?"\n":",\n");
+			writeJsonStage(f,child,merged,numStages,numCounters,indentation+2);
+			first = false;
+		}
+	if (!first)
+		fprintf(f,"\n%*s",indentation,"");
+	fprintf(f,"]}");
+}
+
+static void writeCsvPath(FILE* f, unsigned s)
+{
+	if (g_stages[s].parent)
+	{
+		writeCsvPath(f,g_stages[s].parent);
+		fputc('/',f);
+	}
+	fputs(g_stages[s].name,f);
+}
+
+bool RRProfiler::save(const char* filename)
+{
+	if (!filename)
+		return false;
+	const char* ext = strrchr(filename,'.');
+	bool csv = ext && (!strcmp(ext,".csv") || !strcmp(ext,".CSV"));
+
+	// merge threads
+	std::vector<MergedStage> merged;
+	unsigned numStages;
+	unsigned numCounters;
+	{
+		std::lock_guard<std::mutex> lock(getMutex());
+		numStages = g_numStages.load();
+		numCounters = g_numCounters.load();
+		merged.resize(numStages);
+		memset(merged.data(),0,numStages*sizeof(MergedStage));
+		for (size_t t=0;t<g_threads->size();t++)
+		{
+			const ThreadData* data = (*g_threads)[t];
+			for (unsigned s=0;s<numStages;s++)
+			{
+				merged[s].calls += data->calls[s].load(std::memory_order_relaxed);
+				merged[s].nanoseconds += data->nanoseconds[s].load(std::memory_order_relaxed);
+				for (unsigned c=0;c<numCounters;c++)
+					merged[s].counts[c] += data->counts[s][c].load(std::memory_order_relaxed);
+			}
+		}
+	}
+	// children are always created after parents, so going backwards propagates 'used' up to root
+	for (unsigned s=numStages;s--;)
+	{
+		for (unsigned c=0;c<numCounters;c++)
+			merged[s].used |= merged[s].counts[c]!=0;
+		merged[s].used |= merged[s].calls!=0;
+		if (s && merged[s].used)
+			merged[g_stages[s].parent].used = true;
+	}
+	// root has no time of its own, show sum of top level stages
+	for (unsigned s=1;s<numStages;s++)
+		if (!g_stages[s].parent)
+		{
+			merged[0].calls += merged[s].calls;
+			merged[0].nanoseconds += merged[s].nanoseconds;
+		}
+
+	FILE* f = fopen(filename,"wt");
+	if (!f)
+	{
+		RRReporter::report(WARN,"Failed to save profile to %s.\n",filename);
+		return false;
+	}
+	if (csv)
+	{
+		fprintf(f,"stage,calls,seconds");
+		for (unsigned c=0;c<numCounters;c++)
+			fprintf(f,",%s",g_counters[c]);
+		fprintf(f,"\n");
+		for (unsigned s=0;s<numStages;s++)
+			if (merged[s].used)
+			{
+				if (s)
+					writeCsvPath(f,s);
+				else
+					fputs("total",f);
+				fprintf(f,",%llu,%.6f",merged[s].calls,merged[s].nanoseconds*1e-9);
+				for (unsigned c=0;c<numCounters;c++)
+					fprintf(f,",%llu",merged[s].counts[c]);
+				fprintf(f,"\n");
+			}
+	}
+	else
+	{
+		writeJsonStage(f,0,merged,numStages,numCounters,0);
+		fprintf(f,"\n");
+	}
+	bool ok = !ferror(f);
+	fclose(f);
+	return ok;
+}
+
+} //namespace
@@ -8,65 +8,329 @@
 // --------------------------------------------------------------------------
 
 #include "Lightsprint/RRDebug.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
 #include <cstdio>
-#include <set>
-#include <typeinfo>
+#include <cstdlib> // atexit
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 
 namespace rr
 {
 
+enum
+{
+	MAX_REPORT_SIZE = 1000,
+	QUEUE_SIZE = 1024, // messages waiting for asynchronous delivery, 1MB
+	MAX_REPEATED_WARNINGS = 100, // warning with the same text is reported at most this many times per window
+	REPEATED_WARNING_SECONDS = 10, // window length, after it the same warning is reported again
+	REPEATED_WARNING_SLOTS = 1024,
+};
+
 /////////////////////////////////////////////////////////////////////////////
 //
 // Reporters
 //
-// This is temporary workaround for our static_initialization_order_fiasco.
-// The workaround is still technically undefined behavior, but it works.
-// I quickly commit this workaround before working on actual API breaking solution.
-// 
-// We have at least two static objects that interact at destruction time,
-// s_imageCache dtor may warn about memory leak using g_reporters (which might have been
-// already destructed, order is not guaranteed).
-// It took two decades before I finally hit this error. One sample crashed on exit(),
-// because exit() calls destructors of static objects and with unusual combination
-// of linker and build system, static objects destructed in unexpected order.
-// This is also a reminder that we should avoid static objects.
-
-class Reporters : public std::set<RRReporter*>
+// List of reporters is immutable once published. Register/unregister copies it,
+// publishes new one and waits until no thread reads the old one (read-copy-update).
+// Readers only increment/decrement counter of current epoch, they never wait.
+//
+// All globals here are constant initialized and have no destructors,
+// so reporting works even when called from destructors of other static objects
+// (there used to be static_initialization_order_fiasco, s_imageCache dtor warned
+// about leaks using already destructed reporters).
+
+typedef std::vector<RRReporter*> ReporterList;
+
+static std::atomic<const ReporterList*> g_reporters(nullptr);
+static std::atomic<unsigned>            g_epoch(0);
+static std::atomic<unsigned>            g_readers[2]; // number of readers in even/odd epoch
+
+// Serializes writers, readers don't lock. Never destructed.
+static std::mutex& getWriterMutex()
+{
+	static std::mutex* mutex = new std::mutex;
+	return *mutex;
+}
+
+class ReadLock
 {
 public:
-	bool valid = false;
-	Reporters()
+	ReadLock()
+	{
+		for (;;)
+		{
+			epoch = g_epoch.load();
+			g_readers[epoch&1]++;
+			if (g_epoch.load()==epoch)
+				break;
+			// writer flipped epoch meanwhile, it might not see us
+			g_readers[epoch&1]--;
+		}
+	}
+	~ReadLock()
+	{
+		g_readers[epoch&1]--;
+	}
+private:
+	unsigned epoch;
+};
+
+// Waits until all readers that could see previous state finish. Called by writer with getWriterMutex() locked.
+static void synchronize()
+{
+	unsigned epoch = g_epoch.load();
+	g_epoch.store(epoch+1);
+	while (g_readers[epoch&1].load())
+		std::this_thread::yield();
+}
+
+static void changeReporters(RRReporter* add, RRReporter* remove)
+{
+	std::lock_guard<std::mutex> lock(getWriterMutex());
+	const ReporterList* oldList = g_reporters.load();
+	ReporterList* newList = oldList ? new ReporterList(*oldList) : new ReporterList;
+	if (add && std::find(newList->begin(),newList->end(),add)==newList->end())
+		newList->push_back(add);
+	if (remove)
+		newList->erase(std::remove(newList->begin(),newList->end(),remove),newList->end());
+	if (newList->empty())
+		RR_SAFE_DELETE(newList);
+	g_reporters.store(newList);
+	synchronize();
+	delete oldList;
+}
+
+static void deliver(RRReportType type, int indentation, const char* message)
+{
+	ReadLock lock;
+	const ReporterList* list = g_reporters.load();
+	if (list)
+		for (size_t i=0;i<list->size();i++)
+			(*list)[i]->customReport(type,indentation,message);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// MessageQueue
+//
+// Bounded multi-producer queue with single consumer thread that delivers messages to reporters.
+// Producers don't lock, they wait only when queue is full.
+// Consumer sleeps on condition variable when queue is empty, producer locks only to wake it up.
+
+class MessageQueue
+{
+public:
+	MessageQueue()
+	{
+		for (size_t i=0;i<QUEUE_SIZE;i++)
+			messages[i].sequence = i;
+		enqueued = 0;
+		delivered = 0;
+		stopping = false;
+		sleeping = false;
+		thread = std::thread(&MessageQueue::run,this);
+	}
+
+	// Returns position of message in queue, flush(position) waits until it's delivered.
+	size_t push(RRReportType type, int indentation, const char* text)
+	{
+		size_t position = enqueued.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Message& message = messages[position%QUEUE_SIZE];
+			size_t sequence = message.sequence.load(std::memory_order_acquire);
+			if (sequence==position)
+			{
+				if (enqueued.compare_exchange_weak(position,position+1,std::memory_order_relaxed))
+					break;
+			}
+			else
+			if (sequence<position)
+			{
+				// full, wait for consumer
+				std::this_thread::yield();
+				position = enqueued.load(std::memory_order_relaxed);
+			}
+			else
+				position = enqueued.load(std::memory_order_relaxed);
+		}
+		Message& message = messages[position%QUEUE_SIZE];
+		message.type = type;
+		message.indentation = indentation;
+		size_t length = strnlen(text,MAX_REPORT_SIZE-1);
+		memcpy(message.text,text,length);
+		message.text[length] = 0;
+		// seq_cst store and load pair with consumer's store to sleeping and load of sequence,
+		// at least one of us sees the other, so consumer doesn't sleep over this message
+		message.sequence.store(position+1);
+		if (sleeping.load())
+			wakeUp();
+		return position;
+	}
+
+	void flush(size_t position)
+	{
+		while (delivered.load(std::memory_order_acquire)<=position)
+			std::this_thread::yield();
+	}
+
+	void flush()
+	{
+		size_t position = enqueued.load();
+		if (position)
+			flush(position-1);
+	}
+
+	bool isConsumerThread() const
+	{
+		return std::this_thread::get_id()==thread.get_id();
+	}
+
+	~MessageQueue()
 	{
-		valid = true;
+		stopping = true;
+		wakeUp();
+		thread.join();
 	}
-	~Reporters()
+
+private:
+	void wakeUp()
 	{
-		valid = false;
-		// when someone accesses destructed g_reporters, it sees valid == false
-		// (as long as no one overwrites the memory)
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wakeUpCondition.notify_one();
 	}
+
+	void run()
+	{
+		for (;;)
+		{
+			size_t position = delivered.load(std::memory_order_relaxed);
+			Message& message = messages[position%QUEUE_SIZE];
+			if (message.sequence.load(std::memory_order_acquire)==position+1)
+			{
+				deliver(message.type,message.indentation,message.text);
+				message.sequence.store(position+QUEUE_SIZE,std::memory_order_release);
+				delivered.store(position+1,std::memory_order_release);
+			}
+			else
+			if (stopping && enqueued.load()==position)
+				break;
+			else
+			{
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				sleeping.store(true);
+				wakeUpCondition.wait(lock,[&]{return message.sequence.load()==position+1 || stopping;});
+				sleeping.store(false);
+			}
+		}
+	}
+
+	struct Message
+	{
+		std::atomic<size_t> sequence;
+		RRReportType type;
+		int indentation;
+		char text[MAX_REPORT_SIZE];
+	};
+	Message messages[QUEUE_SIZE];
+	std::atomic<size_t> enqueued; // position of the next message
+	std::atomic<size_t> delivered; // position of the next message to deliver, written only by consumer
+	std::atomic<bool> stopping;
+	std::atomic<bool> sleeping; // consumer waits (or is about to wait) for wakeUpCondition
+	std::mutex sleepMutex;
+	std::condition_variable wakeUpCondition;
+	std::thread thread;
 };
 
+static std::atomic<MessageQueue*> g_queue(nullptr); // protected by the same read-copy-update as g_reporters
+
+static void stopAsynchronousDelivery()
+{
+	RRReporter::setAsynchronous(false);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// repeated warnings
+
+// Warnings are identified by hash of formatted text, so different messages from the same format string
+// are counted separately. Counting is approximate when threads race for slot, it's only for flood protection.
+
+static std::atomic<size_t>   g_warningHash[REPEATED_WARNING_SLOTS];
+static std::atomic<unsigned> g_warningWindow[REPEATED_WARNING_SLOTS]; // 1+index of window when slot was counted last time
+static std::atomic<unsigned> g_warningCount[REPEATED_WARNING_SLOTS]; // number of reports in that window
+
+// Returns number of times this warning was reported in current window, including this time.
+static unsigned countWarning(const char* text)
+{
+	size_t hash = 14695981039346656037ull;
+	for (const char* c=text;*c;c++)
+		hash = (hash^(unsigned char)*c)*1099511628211ull;
+	hash |= 1; // 0 marks empty slot
+	unsigned window = 1+(unsigned)(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count()/REPEATED_WARNING_SECONDS);
+	unsigned slot = UINT_MAX;
+	for (unsigned probe=0;probe<8 && slot==UINT_MAX;probe++)
+	{
+		unsigned s = (unsigned)(hash+probe)%REPEATED_WARNING_SLOTS;
+		size_t slotHash = g_warningHash[s].load(std::memory_order_relaxed);
+		// take our slot, empty slot or slot not used in current window
+		if (slotHash==hash
+			|| ((!slotHash || g_warningWindow[s].load(std::memory_order_relaxed)!=window) && (g_warningHash[s].compare_exchange_strong(slotHash,hash) || slotHash==hash)))
+			slot = s;
+	}
+	if (slot==UINT_MAX)
+	{
+		// all slots are used by other warnings in current window, evict the first one
+		slot = (unsigned)hash%REPEATED_WARNING_SLOTS;
+		g_warningHash[slot] = hash;
+		g_warningWindow[slot] = 0;
+	}
+	if (g_warningWindow[slot].exchange(window)!=window)
+		g_warningCount[slot] = 0;
+	return ++g_warningCount[slot];
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 //
 // RRReporter
 
-static int                   g_indentation = 0;
-//static std::set<RRReporter*> g_reporters;
-static Reporters             g_reporters;
+static std::atomic<int>      g_indentation(0);
 bool                         g_typeEnabled[TIMI+1] = {1,1,1,1,1,0,0,1};
 
 RRReporter::RRReporter()
 {
-#pragma omp critical(reporter)
-	g_reporters.insert(this);
+	changeReporters(this,nullptr);
+}
+
+RRReporter::RRReporter(bool registerNow)
+{
+	if (registerNow)
+		changeReporters(this,nullptr);
+}
+
+void RRReporter::registerReporter()
+{
+	changeReporters(this,nullptr);
+}
+
+void RRReporter::unregisterReporter()
+{
+	changeReporters(nullptr,this);
 }
 
 RRReporter::~RRReporter()
 {
-#pragma omp critical(reporter)
-	g_reporters.erase(this);
+	changeReporters(nullptr,this);
 }
 
 void RRReporter::setFilter(bool warnings, unsigned infLevel, bool timing)
@@ -90,17 +354,66 @@ void RRReporter::indent(int delta)
 	g_indentation += delta;
 }
 
+void RRReporter::setAsynchronous(bool asynchronous)
+{
+	std::lock_guard<std::mutex> lock(getWriterMutex());
+	MessageQueue* queue = g_queue.load();
+	if (asynchronous && !queue)
+	{
+		static bool registered = false;
+		if (!registered)
+		{
+			registered = true;
+			atexit(stopAsynchronousDelivery);
+		}
+		g_queue.store(new MessageQueue);
+	}
+	if (!asynchronous && queue)
+	{
+		RR_ASSERT(!queue->isConsumerThread());
+		g_queue.store(nullptr);
+		synchronize(); // no producer adds to old queue
+		delete queue; // delivers remaining messages
+	}
+}
+
+void RRReporter::flush()
+{
+	ReadLock lock;
+	MessageQueue* queue = g_queue.load();
+	if (queue && !queue->isConsumerThread())
+		queue->flush();
+}
+
 void RRReporter::reportV(RRReportType type, const char* format, va_list& vars)
 {
-	if (g_reporters.size() && g_reporters.valid && type>=ERRO && type<=TIMI && g_typeEnabled[type])
+	if (g_reporters.load(std::memory_order_relaxed) && type>=ERRO && type<=TIMI && g_typeEnabled[type])
 	{
-		enum {MAX_REPORT_SIZE=1000};
 		char msg[MAX_REPORT_SIZE];
 		if (vsnprintf(msg, MAX_REPORT_SIZE, format, vars) >= 0)
 		{
+			unsigned repeats = (type==WARN) ? countWarning(msg) : 0;
+			if (repeats>MAX_REPEATED_WARNINGS)
+				return;
 			// report complete or partial (if buffer is not large enough) message
-			for (std::set<RRReporter*>::iterator i = g_reporters.begin(); i != g_reporters.end(); ++i)
-				(*i)->customReport(type, g_indentation, msg);
+			int indentation = g_indentation;
+			ReadLock lock;
+			MessageQueue* queue = g_queue.load();
+			if (queue && !queue->isConsumerThread())
+			{
+				size_t position = queue->push(type,indentation,msg);
+				if (repeats==MAX_REPEATED_WARNINGS)
+					position = queue->push(WARN,indentation,"Warning repeated too many times, further occurrences in the next few seconds are not reported.\n");
+				// errors and assertions are delivered before we return, process might not survive them
+				if (type==ERRO || type==ASSE)
+					queue->flush(position);
+			}
+			else
+			{
+				deliver(type,indentation,msg);
+				if (repeats==MAX_REPEATED_WARNINGS)
+					deliver(WARN,indentation,"Warning repeated too many times, further occurrences in the next few seconds are not reported.\n");
+			}
 		}
 		else
 		{
@@ -120,7 +433,7 @@ void RRReporter::report(RRReportType type, const char* format, ...)
 
 void RRReporter::assertionFailed(const char* expression, const char* func, const char* file, unsigned line)
 {
-	if (g_reporters.size())
+	if (g_reporters.load())
 	{
 		report(ASSE,"%s in %s, file %s, line %d.\n",expression,func,file,line);
 #if defined(_DEBUG) && defined(RR_STATIC) && defined(_MSC_VER)
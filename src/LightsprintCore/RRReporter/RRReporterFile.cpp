@@ -47,17 +47,20 @@ public:
 	}
 	~RRReporterFile()
 	{
+		unregisterReporter();
 		if (file) fclose(file);
 		free(filename);
 	}
 private:
-	RRReporterFile(const char* _filename, bool _flush)
+	RRReporterFile(const char* _filename, bool _flush) : RRReporter(false)
 	{
 		filename = _strdup(_filename);
 		file = fopen(filename,"wt");
 		flush = _flush;
 		if (file && flush)
 			fclose(file);
+		if (file)
+			registerReporter();
 	}
 	char* filename;
 	FILE* file;
@@ -23,6 +23,14 @@ namespace rr
 class RRReporterOutputDebugString : public RRReporter
 {
 public:
+	RRReporterOutputDebugString() : RRReporter(false)
+	{
+		registerReporter();
+	}
+	~RRReporterOutputDebugString()
+	{
+		unregisterReporter();
+	}
 	virtual void customReport(RRReportType type, int indentation, const char* message)
 	{
 		// indentation
@@ -26,10 +26,15 @@ namespace rr
 class RRReporterPrintf : public RRReporter
 {
 public:
-	RRReporterPrintf()
+	RRReporterPrintf() : RRReporter(false)
 	{
 		hconsole = GetStdHandle (STD_OUTPUT_HANDLE);
 		currentColor = 7;
+		registerReporter();
+	}
+	~RRReporterPrintf()
+	{
+		unregisterReporter();
 	}
 	virtual void customReport(RRReportType type, int indentation, const char* message)
 	{
@@ -49,6 +54,14 @@ public:
 class RRReporterPrintf : public RRReporter
 {
 public:
+	RRReporterPrintf() : RRReporter(false)
+	{
+		registerReporter();
+	}
+	~RRReporterPrintf()
+	{
+		unregisterReporter();
+	}
 	virtual void customReport(RRReportType type, int indentation, const char* message)
 	{
 		// indentation
@@ -64,7 +64,7 @@ class RRReporterWindow : public RRReporter
 	};
 
 public:
-	RRReporterWindow(RRCallback* _abortCallback, const char* _caption, bool _closeWhenDone)
+	RRReporterWindow(RRCallback* _abortCallback, const char* _caption, bool _closeWhenDone) : RRReporter(false)
 	{
 		// necessary for changing text color
 		LoadLibraryA("riched20.dll");
@@ -84,6 +84,7 @@ public:
 		while (!instanceData->shown) Sleep(1);
 		time_t t = time(nullptr);
 		localReport(INF1,"STARTED %s",asctime(localtime(&t)));
+		registerReporter();
 	}
 
 	virtual void customReport(RRReportType type, int indentation, const char* message)
@@ -180,6 +181,7 @@ public:
 
 	virtual ~RRReporterWindow()
 	{
+		unregisterReporter();
 		time_t t = time(nullptr);
 		localReport(INF1,"FINISHED %s",asctime(localtime(&t)));
 		SendDlgItemMessageA(hWnd,IDC_BUTTON_ABORT_CLOSE,WM_SETTEXT,0,(LPARAM)"Close");
@@ -13,6 +13,10 @@
 #include "private.h"
 #include "../RRStaticSolver/rrcore.h" // build of packed factors
 #include "../RRStaticSolver/pathtracer.h" // pathTraceFrame()
+#include "../RRLightPrivate.h"
+#include "../RRBuffer/RRBufferBlend.h"
+#include <memory>
+#include <typeinfo>
 #include <unordered_set>
 
 namespace rr
@@ -92,9 +96,13 @@ bool RRSolver::UpdateParameters::operator ==(const RRSolver::UpdateParameters& a
 		&& a.useCurrentSolution==useCurrentSolution
 		&& a.quality==quality
 		&& a.qualityFactorRadiosity==qualityFactorRadiosity
+		&& a.useTextureMipmaps==useTextureMipmaps
 		&& a.insideObjectsThreshold==insideObjectsThreshold
 		&& a.rugDistance==rugDistance
 		&& a.locality==locality
+		&& a.lightSamples==lightSamples
+		&& a.lightCutoffIrradiance==lightCutoffIrradiance
+		&& a.randomSeed==randomSeed
 		&& a.aoIntensity==aoIntensity
 		&& a.aoSize==aoSize
 		&& a.measure_internal==measure_internal
@@ -119,6 +127,64 @@ bool RRSolver::FilteringParameters::operator ==(const RRSolver::FilteringParamet
 		;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+//
+// RRSolver::Private
+
+void RRSolver::Private::startJob(const LightEvaluators*& _lightEvaluators, const RRBuffer*& _environment)
+{
+	std::lock_guard<std::mutex> lock(jobMutex);
+	// lights are often edited without reportDirectIlluminationChange(), so evaluators are checked against lights
+	// (cheap, evaluators of unchanged lights are reused by all pathTraceFrame() and updateLightmaps() calls)
+	if (lightEvaluators && !lightEvaluators->isUpToDate(lights,colorSpace))
+		retireLightEvaluators();
+	if (!lightEvaluators)
+		lightEvaluators = new LightEvaluators(lights,colorSpace);
+	// blend is kept between jobs, so that its cache survives
+	if (!environmentBlend)
+		environmentBlend = RRBuffer::createEnvironmentBlend(environment0,environment1,environmentAngleRad0,environmentAngleRad1,environmentBlendFactor);
+	numJobs++;
+	_lightEvaluators = lightEvaluators;
+	_environment = environmentBlend;
+}
+
+void RRSolver::Private::endJob()
+{
+	std::lock_guard<std::mutex> lock(jobMutex);
+	RR_ASSERT(numJobs);
+	if (!--numJobs)
+	{
+		for (unsigned i=0;i<retiredLightEvaluators.size();i++)
+			delete retiredLightEvaluators[i];
+		retiredLightEvaluators.clear();
+		for (unsigned i=0;i<retiredEnvironmentBlends.size();i++)
+			delete retiredEnvironmentBlends[i];
+		retiredEnvironmentBlends.clear();
+		// no one samples blend now, caches of older environment contents (e.g. previous video frames) can be freed
+		if (environmentBlend && typeid(*environmentBlend)==typeid(RRBufferBlend))
+			static_cast<RRBufferBlend*>(environmentBlend)->freeSupersededCubes();
+	}
+}
+
+void RRSolver::Private::retireLightEvaluators()
+{
+	if (numJobs)
+		retiredLightEvaluators.push_back(lightEvaluators);
+	else
+		delete lightEvaluators;
+	lightEvaluators = nullptr;
+}
+
+void RRSolver::Private::retireEnvironmentBlend()
+{
+	if (numJobs && environmentBlend)
+		retiredEnvironmentBlends.push_back(environmentBlend);
+	else
+		delete environmentBlend;
+	environmentBlend = nullptr;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 //
 // RRSolver
@@ -149,6 +215,10 @@ void RRSolver::setColorSpace(const RRColorSpace* _colorSpace)
 	}
 	// tell realtime solver to update GI (=re-run DDI with new colorSpace)
 	reportDirectIlluminationChange(-1,false,true,false);
+	// light evaluators convert projected textures to linear colors, blend caches cubes keyed by color space pointer
+	std::lock_guard<std::mutex> lock(priv->jobMutex);
+	priv->retireLightEvaluators();
+	priv->retireEnvironmentBlend();
 }
 
 const RRColorSpace* RRSolver::getColorSpace() const
@@ -160,6 +230,11 @@ void RRSolver::setEnvironment(RRBuffer* _environment0, RRBuffer* _environment1,
 {
 	// [#23] inc/dec refcount of environments entering/leaving solver
 	// (so that later we can delete env from slot0, forget about it, and then move env from slot0 to slot1 for fadeout)
+	if (priv->environment0!=_environment0 || priv->environment1!=_environment1 || priv->environmentAngleRad0!=_environmentAngleRad0 || priv->environmentAngleRad1!=_environmentAngleRad1)
+	{
+		std::lock_guard<std::mutex> lock(priv->jobMutex);
+		priv->retireEnvironmentBlend();
+	}
 	if (_environment0 && _environment0!=priv->environment0) _environment0->createReference();
 	if (_environment1 && _environment1!=priv->environment1) _environment1->createReference();
 	if (priv->environment0 && _environment0!=priv->environment0) delete priv->environment0;
@@ -188,6 +263,10 @@ void RRSolver::setEnvironmentBlendFactor(float _blendFactor)
 	if (priv->environmentBlendFactor!=_blendFactor)
 	{
 		priv->environmentBlendFactor = _blendFactor;
+		{
+			std::lock_guard<std::mutex> lock(priv->jobMutex);
+			priv->retireEnvironmentBlend();
+		}
 		// affects specular cubemaps
 		priv->solutionVersion++;
 	}
@@ -209,6 +288,8 @@ void RRSolver::setLights(const RRLights& _lights)
 		}
 	}
 	priv->lights = _lights;
+	std::lock_guard<std::mutex> lock(priv->jobMutex);
+	priv->retireLightEvaluators();
 }
 
 const RRLights& RRSolver::getLights() const
@@ -680,6 +761,11 @@ void RRSolver::reportDirectIlluminationChange(int lightIndex, bool dirtyShadows,
 	//if (lightIndex==-1) // (-1=geometry change)
 	//	priv->superColliderDirty = true;
 	priv->superColliderDirtySmall = true;
+	// detectDirectIlluminationCPU() will recalculate these lights
+	if (dirtyGI)
+		for (unsigned i=0;i<priv->ddiDirty.size();i++)
+			if (lightIndex==(int)i || lightIndex==-1)
+				priv->ddiDirty[i] = 1;
 }
 
 void RRSolver::reportInteraction()
@@ -1154,6 +1240,19 @@ void RRSolver::pathTraceFrame(const RRCamera& _camera, RRBuffer* _frame, unsigne
 		PathtracerWorker pathtracerWorker(ptj,_parameters,false,UINT_MAX,_accumulated?UINT_MAX:0);
 		pathtracerWorker.ray.rayLengthMin = _camera.getFar()*1e-6f; // [#38] must be !0. priv->minimalSafeDistance is 0 in fully dynamic scenes
 		pathtracerWorker.ray.rayLengthMax = _camera.getFar()*2;
+		// generate rays for whole row at once
+		std::vector<RRVec2> positionsInWindow(w);
+		std::vector<RRVec3> rayOrigins(w);
+		std::vector<RRVec3> rayDirs(w);
+		std::unique_ptr<bool[]> rayValid(new bool[w]);
+		for (unsigned i=0;i<w;i++)
+		{
+			float r1=2*RR_RAND01, dx=r1<1 ? sqrtf(r1)-1: 1-sqrtf(2-r1);
+			float r2=2*RR_RAND01, dy=r2<1 ? sqrtf(r2)-1: 1-sqrtf(2-r2);
+			//RRVec2 positionInWindow((sx+.5+dx+2*i)/w-1,1-(sy+.5+dy+2*j)/h);
+			positionsInWindow[i] = RRVec2(2*(dx+i)/w-1,2*(dy+j)/h-1);
+		}
+		_camera.getRays(positionsInWindow.data(),w,rayOrigins.data(),rayDirs.data(),rayValid.get(),true);
 		for (unsigned i=0;i<w;i++)
 		{
 			unsigned index = i+j*w;
@@ -1162,13 +1261,8 @@ void RRSolver::pathTraceFrame(const RRCamera& _camera, RRBuffer* _frame, unsigne
 			//for (int sx=0; sx<2; sx++)
 			//for (int s=0; s<2; s++)
 			{
-				float r1=2*RR_RAND01, dx=r1<1 ? sqrtf(r1)-1: 1-sqrtf(2-r1);
-				float r2=2*RR_RAND01, dy=r2<1 ? sqrtf(r2)-1: 1-sqrtf(2-r2);
-				//RRVec2 positionInWindow((sx+.5+dx+2*i)/w-1,1-(sy+.5+dy+2*j)/h);
-				RRVec2 positionInWindow(2*(dx+i)/w-1,2*(dy+j)/h-1);
-				RRVec3 rayOrigin, rayDir;
-				RRVec3 color = _camera.getRay(positionInWindow,rayOrigin,rayDir,true)
-					? pathtracerWorker.getIncidentRadiance(rayOrigin+rayDir*_camera.getNear(),rayDir.normalized(),nullptr,UINT_MAX)
+				RRVec3 color = rayValid[i]
+					? pathtracerWorker.getIncidentRadiance(rayOrigins[i]+rayDirs[i]*_camera.getNear(),rayDirs[i].normalized(),nullptr,UINT_MAX)
 					: RRVec3(0);
 				c = (c*RRReal(_accumulated)+RRVec4(color,0))/(_accumulated+1);
 			}
@@ -0,0 +1,228 @@
+// --------------------------------------------------------------------------
+// Copyright (C) 1999-2021 Stepan Hrbek
+// This file is part of Lightsprint SDK, you can use and/or redistribute it
+// only under terms of Lightsprint SDK license agreement. A copy of the agreement
+// is available by contacting Lightsprint at http://lightsprint.com
+//
+// Detection of direct illumination on CPU.
+// --------------------------------------------------------------------------
+
+#include <cmath>
+#include <vector>
+#include "Lightsprint/RRSolver.h"
+#include "../RRMathPrivate.h"
+#include "../RRLightPrivate.h"
+#include "../RRStaticSolver/pathtracer.h" // RRCollisionHandlerFinalGathering
+#include "private.h"
+
+namespace rr
+{
+
+// Returns false if light can't reach sphere, e.g. it's out of light's radius.
+static bool lightReachesSphere(const RRLight* light, const RRVec3& center, RRReal radius)
+{
+	if (light->type==RRLight::DIRECTIONAL || light->distanceAttenuationType!=RRLight::EXPONENTIAL)
+		return true;
+	return (light->position-center).length()<light->radius+light->getAreaRadius()+radius;
+}
+
+// Samples of one triangle, reused for all triangles processed by one thread.
+struct TriangleSamples
+{
+	std::vector<RRVec3> positions;
+	std::vector<RRVec2> lightSamples;
+	std::vector<RRVec3> irradiances;
+	std::vector<RRVec3> dirs;
+	std::vector<RRReal> dirsizes;
+};
+
+// Calculates average direct irradiance from one light on one triangle, in physical scale.
+static RRVec3 getTriangleIrradiance(const LightEvaluator* lightEvaluator, const RRMesh::TriangleBody& body, const RRVec3& normal, unsigned samplesPerSide, const RRCollider* collider, RRRay& ray, RRCollisionHandlerFinalGathering& collisionHandler, TriangleSamples& samples)
+{
+	const RRLight* light = lightEvaluator->light;
+	const RRColorSpace* colorSpace = lightEvaluator->colorSpace;
+	unsigned numSamples = samplesPerSide*samplesPerSide;
+	samples.positions.resize(numSamples);
+	samples.lightSamples.resize(numSamples);
+	samples.irradiances.resize(numSamples);
+	samples.dirs.resize(numSamples);
+	samples.dirsizes.resize(numSamples);
+	for (unsigned i=0;i<samplesPerSide;i++)
+	for (unsigned j=0;j<samplesPerSide;j++)
+	{
+		// stratified position in triangle, the same in each frame, so that static shadows don't flicker
+		RRReal u = (i+0.5f)/samplesPerSide;
+		RRReal v = (j+0.5f)/samplesPerSide;
+		if (u+v>1)
+		{
+			u = 1-u;
+			v = 1-v;
+		}
+		unsigned k = i*samplesPerSide+j;
+		samples.positions[k] = body.vertex0+body.side1*u+body.side2*v;
+
+		// area lights are sampled at different point for each position (Fibonacci lattice)
+		RRReal golden = k*0.618034f;
+		samples.lightSamples[k] = RRVec2((k+0.5f)/numSamples,golden-floor(golden));
+	}
+
+	// unoccluded irradiance and direction to light, all samples at once
+	lightEvaluator->getIrradianceSamples(samples.positions.data(),samples.lightSamples.data(),samples.irradiances.data(),samples.dirs.data(),samples.dirsizes.data(),numSamples);
+
+	RRVec3 sum(0);
+	for (unsigned k=0;k<numSamples;k++)
+	{
+		const RRVec3& position = samples.positions[k];
+		RRVec3 dir = samples.dirs[k];
+		RRReal dirsize = samples.dirsizes[k];
+		RRVec3 irradiance = samples.irradiances[k];
+		if (light->type==RRLight::DIRECTIONAL)
+		{
+			dirsize = dir.length();
+			dir /= dirsize;
+		}
+		RRReal normalIncidence = dot(dir,normal);
+		if (normalIncidence<=0 || !std::isfinite(normalIncidence))
+			continue;
+		if (irradiance==RRVec3(0))
+			continue;
+
+		// shadow
+		if (light->castShadows)
+		{
+			ray.rayOrigin = position;
+			ray.rayDir = dir;
+			ray.rayLengthMax = (light->type==RRLight::DIRECTIONAL) ? 1e10f : dirsize;
+			collisionHandler.setLight(light,nullptr);
+			if (collider->intersect(ray))
+				continue;
+			irradiance *= collisionHandler.getVisibility();
+		}
+		if (colorSpace && light->directLambertScaled)
+			colorSpace->toLinear(normalIncidence);
+		sum += irradiance*normalIncidence;
+	}
+	return sum/numSamples;
+}
+
+bool RRSolver::detectDirectIlluminationCPU(unsigned _samplesPerTriangle)
+{
+	const RRObject* multiObject = getMultiObject();
+	const RRMesh* multiMesh = multiObject ? multiObject->getCollider()->getMesh() : nullptr;
+	unsigned numTriangles = multiMesh ? multiMesh->getNumTriangles() : 0;
+	const RRLights& lights = getLights();
+	unsigned numLights = (unsigned)lights.size();
+
+	// invalidate cache when scene or lights change
+	bool changed = false;
+	if (priv->ddiMultiObject!=multiObject || priv->ddiIrradianceRGBA8.size()!=numTriangles)
+	{
+		priv->ddiMultiObject = multiObject;
+		priv->ddiLights.clear();
+		priv->ddiIrradianceRGBA8.resize(numTriangles);
+		changed = true;
+	}
+	priv->ddiLights.resize(numLights,nullptr);
+	priv->ddiIrradiancePhysical.resize(numLights);
+	priv->ddiDirty.resize(numLights,1);
+	priv->ddiEnabled.resize(numLights,0);
+	std::vector<unsigned> dirtyLights;
+	for (unsigned l=0;l<numLights;l++)
+	{
+		if (priv->ddiLights[l]!=lights[l])
+		{
+			priv->ddiLights[l] = lights[l];
+			priv->ddiDirty[l] = 1;
+		}
+		bool enabled = lights[l] && lights[l]->enabled;
+		if (enabled!=(priv->ddiEnabled[l]!=0))
+		{
+			priv->ddiEnabled[l] = enabled;
+			changed = true;
+		}
+		if (enabled && priv->ddiDirty[l])
+		{
+			priv->ddiDirty[l] = 0;
+			priv->ddiIrradiancePhysical[l].resize(numTriangles);
+			dirtyLights.push_back(l);
+		}
+	}
+	if (!changed && dirtyLights.empty())
+		return false;
+
+	// recalculate dirty lights
+	if (dirtyLights.size())
+	{
+		RRReportInterval report(INF3,"Detecting direct illumination on CPU (%d lights)...\n",(int)dirtyLights.size());
+		RR_PROFILE_SCOPE("directDetection");
+		unsigned samplesPerSide = RR_MAX(1,(unsigned)(sqrtf((float)_samplesPerTriangle)+0.5f));
+		const RRCollider* collider = multiObject->getCollider();
+		RRReal minimalSafeDistance = priv->minimalSafeDistance;
+		bool staticSceneContainsLods = priv->staticSceneContainsLods;
+		const RRColorSpace* colorSpace = getColorSpace();
+		std::vector<LightEvaluator*> lightEvaluators(dirtyLights.size());
+		for (unsigned i=0;i<dirtyLights.size();i++)
+			lightEvaluators[i] = new LightEvaluator(lights[dirtyLights[i]],colorSpace);
+		unsigned profilerStage = RRProfiler::getStage();
+		#pragma omp parallel
+		{
+			RR_PROFILE_PARENT(profilerStage);
+			RRRay ray;
+			ray.rayLengthMin = minimalSafeDistance;
+			ray.rayFlags = RRRay::FILL_TRIANGLE|RRRay::FILL_SIDE|RRRay::FILL_DISTANCE|RRRay::FILL_POINT2D;
+			ray.hitObject = multiObject;
+			RRCollisionHandlerFinalGathering collisionHandler(colorSpace,UINT_MAX,UINT_MAX,staticSceneContainsLods);
+			ray.collisionHandler = &collisionHandler;
+			TriangleSamples samples;
+			#pragma omp for schedule(dynamic,64)
+			for (int t=0;t<(int)numTriangles;t++)
+			{
+				RRMesh::TriangleBody body;
+				multiMesh->getTriangleBody(t,body);
+				RRVec3 normal = orthogonalTo(body.side1,body.side2).normalized();
+				RRVec3 center = body.vertex0+(body.side1+body.side2)/3;
+				RRReal radius = RR_MAX3((body.vertex0-center).length(),(body.vertex0+body.side1-center).length(),(body.vertex0+body.side2-center).length());
+				collisionHandler.setShooterTriangle(multiObject,t);
+				for (unsigned i=0;i<dirtyLights.size();i++)
+				{
+					const RRLight* light = lights[dirtyLights[i]];
+					priv->ddiIrradiancePhysical[dirtyLights[i]][t] = (body.isNotDegenerated() && std::isfinite(normal.x) && lightReachesSphere(light,center,radius))
+						? getTriangleIrradiance(lightEvaluators[i],body,normal,samplesPerSide,collider,ray,collisionHandler,samples)
+						: RRVec3(0);
+				}
+			}
+		}
+		for (unsigned i=0;i<lightEvaluators.size();i++)
+			delete lightEvaluators[i];
+	}
+
+	// sum enabled lights, convert to custom scale expected by setDirectIllumination()
+	bool anyEnabled = false;
+	for (unsigned l=0;l<numLights;l++)
+		anyEnabled |= priv->ddiEnabled[l]!=0;
+	if (!anyEnabled || !numTriangles)
+	{
+		setDirectIllumination(nullptr);
+		return true;
+	}
+	RRReal multiplier = priv->lightMultiplier;
+	if (priv->colorSpace) priv->colorSpace->fromLinear(multiplier);
+	#pragma omp parallel for schedule(static) if(numTriangles>RR_OMP_MIN_ELEMENTS)
+	for (int t=0;t<(int)numTriangles;t++)
+	{
+		RRVec3 irradiance(0);
+		for (unsigned l=0;l<numLights;l++)
+			if (priv->ddiEnabled[l])
+				irradiance += priv->ddiIrradiancePhysical[l][t];
+		if (priv->colorSpace)
+			priv->colorSpace->fromLinear(irradiance);
+		unsigned rgba = 0;
+		for (unsigned c=0;c<3;c++)
+			rgba |= (unsigned)RR_CLAMPED(irradiance[c]/multiplier*255+0.5f,0,255) << (8*c);
+		priv->ddiIrradianceRGBA8[t] = rgba;
+	}
+	setDirectIllumination(priv->ddiIrradianceRGBA8.data());
+	return true;
+}
+
+} // namespace
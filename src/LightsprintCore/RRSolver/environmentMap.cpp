@@ -13,6 +13,7 @@
 #include "private.h"
 
 #define CENTER_GRANULARITY 0.01f // if envmap center moves less than granularity, it is considered unchanged. prevents updates when dynamic object rotates (=position slightly fluctuates)
+#define GATHER_TILE_SIZE   8     // cube side is gathered in tiles of 8x8 texels, so that even single small cube keeps many threads busy
 
 namespace rr
 {
@@ -139,26 +140,6 @@ private:
 };
 
 
-/////////////////////////////////////////////////////////////////////////////
-//
-// gathering kit
-
-CubeGatheringKit::CubeGatheringKit()
-{
-	inUse = false;
-	ray6 = RRRay::create(6);
-	handler6 = new ReflectionCubeCollisionHandler[6];
-	for (unsigned i=0;i<6;i++)
-		ray6[i].collisionHandler = handler6+i;
-}
-
-CubeGatheringKit::~CubeGatheringKit()
-{
-	delete[] handler6;
-	delete[] ray6;
-}
-
-
 /////////////////////////////////////////////////////////////////////////////
 //
 // gather
@@ -212,25 +193,6 @@ bool RRSolver::cubeMapGather(RRObjectIllumination* illumination, unsigned layerE
 	// simplify tests for blending from if(env1 && blendFactor) to if(env1)
 	if (!blendFactor) environment1 = nullptr;
 
-	// rather than adding 1 kit to every RRObjectIllumination, we added 10 to solver and pick one of them
-	// if user doesn't call updateEnvironmentMap() in parallel, we always use the same first kit
-	CubeGatheringKit* kit = nullptr;
-	#pragma omp critical(cubeGatheringKits)
-	{
-		for (unsigned i=0;i<10;i++)
-			if (!priv->cubeGatheringKits[i].inUse)
-				{
-					kit = priv->cubeGatheringKits+i;
-					kit->inUse = true;
-					break;
-				}
-	}
-	if (!kit)
-	{
-		RRReporter::report(ERRO,"Why are you calling cubeMapGather() for single solver 11 times in parallel? 11th call ignored.\n");
-		return false;
-	}
-
 	// find out our object number
 	unsigned objectNumber;
 	{
@@ -238,13 +200,22 @@ bool RRSolver::cubeMapGather(RRObjectIllumination* illumination, unsigned layerE
 		for (objectNumber=0;objectNumber<staticObjects.size() && &staticObjects[objectNumber]->illumination!=illumination;objectNumber++) ;
 	}
 
+	// each tile has its own ray and handler on stack, so any number of cubes can be gathered in parallel, without locks
+	// each texel is written by one tile only, so result does not depend on number of threads
+	unsigned tilesPerRow = (gatherSize+GATHER_TILE_SIZE-1)/GATHER_TILE_SIZE;
+	unsigned tilesPerSide = tilesPerRow*tilesPerRow;
 	#pragma omp parallel for schedule(dynamic) if(gatherSize*gatherSize*6>=RR_OMP_MIN_ELEMENTS/10)
-	for (int side=0;side<6;side++)
+	for (int tile=0;tile<(int)(6*tilesPerSide);tile++)
 	{
-		kit->handler6[side].setup(multiObject,objectNumber,illumination->envMapWorldRadius);
-		RRRay& ray = kit->ray6[side];
-		for (unsigned j=0;j<gatherSize;j++)
-			for (unsigned i=0;i<gatherSize;i++)
+		unsigned side = tile/tilesPerSide;
+		unsigned i0 = (tile%tilesPerRow)*GATHER_TILE_SIZE;
+		unsigned j0 = ((tile%tilesPerSide)/tilesPerRow)*GATHER_TILE_SIZE;
+		ReflectionCubeCollisionHandler handler;
+		handler.setup(multiObject,objectNumber,illumination->envMapWorldRadius);
+		RRRay ray;
+		ray.collisionHandler = &handler;
+		for (unsigned j=j0;j<RR_MIN(j0+GATHER_TILE_SIZE,gatherSize);j++)
+			for (unsigned i=i0;i<RR_MIN(i0+GATHER_TILE_SIZE,gatherSize);i++)
 			{
 				unsigned ofs = i+(j+side*gatherSize)*gatherSize;
 				RRVec3 dir = cubeSide[side].getTexelDir(gatherSize,i,j);
@@ -260,7 +231,7 @@ bool RRSolver::cubeMapGather(RRObjectIllumination* illumination, unsigned layerE
 					ray.hitObject = multiObject;
 					if (ray.hitObject->getCollider()->intersect(ray))
 					{
-						face = kit->handler6[side].gethHitTriangle(); //ray.hitTriangle;
+						face = handler.gethHitTriangle(); //ray.hitTriangle;
 						if (face>=numTriangles)
 						{
 							RR_ASSERT(0);
@@ -329,7 +300,6 @@ bool RRSolver::cubeMapGather(RRObjectIllumination* illumination, unsigned layerE
 				}
 			}
 	}
-	kit->inUse = false;
 	illumination->cachedGatherSize = gatherSize;
 	illumination->cachedNumTriangles = numTriangles;
 	illumination->cachedCenter = illumination->envMapWorldCenter;
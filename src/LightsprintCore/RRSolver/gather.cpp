@@ -8,6 +8,7 @@
 // --------------------------------------------------------------------------
 
 
+#include <algorithm>
 #include <cfloat>
 #ifdef _OPENMP
 #include <omp.h>
@@ -16,6 +17,8 @@
 #include "../RRMathPrivate.h"
 #include "private.h"
 #include "gather.h"
+#include "lightCulling.h"
+#include "../RRLightPrivate.h"
 #include "../RRStaticSolver/pathtracer.h" //!!! vola neverejny interface static solveru
 
 #define HOMOGENOUS_FILL // enables homogenous rather than random(noisy) shooting, improves baking quality as long as randomnes is provided via [#15]
@@ -147,7 +150,7 @@ public:
 	{
 		collider = pti.context.solver->getMultiObject()->getCollider();
 		environment = pti.context.params.indirect.environmentMultiplier ? pti.context.solver->getEnvironment() : nullptr;
-		fillerPos.Reset(pti.resetFiller);
+		fillerPos.Reset(pti.getResetFiller());
 	}
 
 	const RRCollider* collider;
@@ -196,6 +199,9 @@ public:
 		reliabilityHemisphere = 0;
 		rays = (tools.environment || pti.context.params.indirect.materialEmittanceMultiplier!=0 || pti.context.params.useCurrentSolution) ? RR_MAX(1,pti.context.params.quality) : 0;
 		pathtracerWorker.ray.rayLengthMin = pti.rayLengthMin;
+		// each ray represents 2pi/rays steradians of hemisphere, distant textures are sampled from mipmaps of matching resolution
+		if (rays && pti.context.params.useTextureMipmaps)
+			pathtracerWorker.setRayCone(sqrtf(2*RR_PI/rays));
 	}
 
 	// once before shooting (full init)
@@ -207,7 +213,7 @@ public:
 		//if (!rays) return;
 
 		// prepare homogenous filler
-		fillerDir.Reset(pti.resetFiller);
+		fillerDir.Reset(pti.getResetFiller());
 		// init counters
 		hitsReliable = 0;
 		hitsUnreliable = 0;
@@ -363,6 +369,7 @@ public:
 	GatheredIrradianceLights(const GatheringTools& _tools, const ProcessTexelParams& _pti)
 		: tools(_tools),
 		pti(_pti),
+		random(_pti,1),
 		collisionHandlerGatherLight(
 			_pti.context.colorSpace,
 			_pti.context.params.quality*2, // when gathering lights (possibly rendering direct shadows), make point details 2* more important
@@ -393,8 +400,15 @@ public:
 			irradiancePhysicalLights[i] = RRVec3(0);
 		bentNormalLights = RRVec3(0);
 		reliabilityLights = 0;
-		rounds = (pti.context.params.direct.lightMultiplier && numRelevantLights) ? pti.context.params.quality/10+1 : 0;
-		rays = numRelevantLights*rounds;
+		lightTree = pti.relevantLightsFilled ? pti.lightTree : nullptr;
+		numCulledLights = pti.relevantLightsFilled ? pti.numCulledLights : 0;
+		// culled lights still count, so that culling doesn't change number of rounds and reliability
+		rounds = (pti.context.params.direct.lightMultiplier && numRelevantLights+numCulledLights) ? pti.context.params.quality/10+1 : 0;
+		rays = (lightTree ? (unsigned)lightTree->otherLights.size()+pti.context.params.lightSamples : numRelevantLights+numCulledLights)*rounds;
+		areaLights = false;
+		for (unsigned i=0;i<numRelevantLights;i++)
+			areaLights |= pti.relevantLights[i]->isAreaLight();
+		fillerLight.Reset(pti.getResetFiller());
 		ray.hitObject = pti.context.solver->getMultiObject();
 		ray.rayLengthMin = pti.rayLengthMin;
 	}
@@ -418,14 +432,24 @@ public:
 	// inputs:
 	// - pti.rays[1].rayOrigin
 	// _basisSkewed is derived from RRMesh basis, not orthogonal, not normalized
-	void shotRay(const RRLight* _light, const RRMesh::TangentBasis& _basisSkewedNormalized)
+	// _sample selects point on area light, rounds are stratified by fillerLight
+	// _weight multiplies irradiance of light picked randomly from lightTree
+	void shotRay(const RRLight* _light, const RRMesh::TangentBasis& _basisSkewedNormalized, const RRVec2& _sample, RRReal _weight)
 	{
 		if (!_light) return;
 		// set dir to light
-		RRVec3 dir = (_light->type==RRLight::DIRECTIONAL)?-_light->direction:(_light->position-ray.rayOrigin);
-		RRReal dirsize = dir.length();
-		dir /= dirsize;
-		if (_light->type==RRLight::DIRECTIONAL) dirsize *= pti.context.params.locality;
+		RRVec3 dir;
+		RRReal dirsize;
+		const LightEvaluator* lightEvaluator = pti.context.lightEvaluators->find(_light);
+		RRVec3 irradSample = lightEvaluator
+			? lightEvaluator->getIrradianceSample(ray.rayOrigin,_sample,dir,dirsize)
+			: _light->getIrradianceSample(ray.rayOrigin,_sample,pti.context.colorSpace,dir,dirsize);
+		if (_light->type==RRLight::DIRECTIONAL)
+		{
+			dirsize = dir.length();
+			dir /= dirsize;
+			dirsize *= pti.context.params.locality;
+		}
 		float normalIncidence1 = dot(dir,_basisSkewedNormalized.normal);
 		if (normalIncidence1<=0 || !std::isfinite(normalIncidence1))
 		{
@@ -448,7 +472,7 @@ public:
 			{
 				// direct visibility found (at least partial), add irradiance from light
 				// !_light->castShadows -> direct visibility guaranteed even without raycast
-				RRVec3 irrad = _light->getIrradiance(ray.rayOrigin,pti.context.colorSpace) * pti.context.params.direct.lightMultiplier;
+				RRVec3 irrad = irradSample * (pti.context.params.direct.lightMultiplier*_weight);
 				RR_ASSERT(IS_VEC3(irrad)); // getIrradiance() must return finite number
 				if (_light->castShadows)
 				{
@@ -518,8 +542,38 @@ public:
 	{
 		ray.rayOrigin = _rayOrigin;
 		collisionHandlerGatherLight.setShooterTriangle(pti.context.solver->getMultiObject(),_skipTriangleIndex);
-		for (unsigned i=0;i<numRelevantLights;i++)
-			shotRay(pti.relevantLights[i],_basisSkewedNormalized);
+		RRVec2 sample(0.5f);
+		if (areaLights)
+			fillerLight.GetSquare01Point(&sample[0],&sample[1]);
+		if (lightTree)
+		{
+			for (unsigned i=0;i<lightTree->otherLights.size();i++)
+				shotRay(lightTree->otherLights[i],_basisSkewedNormalized,sample,1);
+			unsigned lightSamples = pti.context.params.lightSamples;
+			for (unsigned i=0;i<lightSamples;i++)
+			{
+				// stratified, each sample picks from different part of tree
+				RRReal probability;
+				const RRLight* light = lightTree->pickLight(_rayOrigin,_basisSkewedNormalized.normal,(i+random.get()*(1.f/(RAND_MAX+1.f)))/lightSamples,probability);
+				if (light)
+					shotRay(light,_basisSkewedNormalized,sample,1/(probability*lightSamples));
+				else
+				{
+					// no light can reach receiver -> reliable black
+					hitsScene++;
+					hitsReliable++;
+				}
+			}
+		}
+		else
+		{
+			for (unsigned i=0;i<numRelevantLights;i++)
+				shotRay(pti.relevantLights[i],_basisSkewedNormalized,sample,1);
+			// lights that can't reach texel -> reliable black, without shooting
+			hitsScene += numCulledLights;
+			hitsReliable += numCulledLights;
+			RR_PROFILE_COUNT("culled rays",numCulledLights);
+		}
 		shotRounds++;
 	}
 
@@ -576,11 +630,16 @@ protected:
 	const GatheringTools& tools;
 	const ProcessTexelParams& pti;
 	unsigned numRelevantLights; // lights are in pti.relevantLights
+	unsigned numCulledLights; // lights that can't reach texel, not shot
 	unsigned hitsLight;
 	unsigned hitsInside;
 	unsigned hitsRug;
 	unsigned hitsScene;
 	unsigned shotRounds;
+	bool areaLights; // at least one relevant light has area, rounds sample different points of it
+	HomogenousFiller2 fillerLight;
+	const LightTree* lightTree; // when set, point/spot lights are picked from tree
+	TexelRandom random;
 	// collision handler
 	RRCollisionHandlerFinalGathering collisionHandlerGatherLight;
 };
@@ -614,6 +673,7 @@ ProcessTexelResult processTexel(const ProcessTexelParams& pti)
 	// prepare irradiance accumulators, set .rays properly (0 when shooting is disabled for any reason)
 	GatheredIrradianceHemisphere hemisphere(tools,pti);
 	GatheredIrradianceLights gilights(tools,pti);
+	TexelRandom random(pti,0);
 
 	// bail out if no work here
 	if (!hemisphere.rays && !gilights.rays)
@@ -739,8 +799,8 @@ ProcessTexelResult processTexel(const ProcessTexelParams& pti)
 			}
 
 			// random 2d pos in subtexel
-			unsigned u=rand();
-			unsigned v=rand();
+			unsigned u=random.get();
+			unsigned v=random.get();
 			if (u+v>RAND_MAX)
 			{
 				u=RAND_MAX-u;
@@ -866,6 +926,8 @@ bool RRSolver::gatherPerTrianglePhysical(const UpdateParameters* _params, const
 	optimizeMultipliers(params,false);
 
 	RRReportInterval report(INF2,"Gathering(%ls) ...\n",getIndirectParamsAsString(params).w_str());
+	RR_PROFILE_SCOPE("gather");
+	RR_PROFILE_COUNT("triangles",numPostImportTriangles);
 	LightmapperJob lmj(this,params);
 	lmj.gatherAllDirections = resultsPhysical->data[LS_DIRECTION1]||resultsPhysical->data[LS_DIRECTION2]||resultsPhysical->data[LS_DIRECTION3];
 	lmj.staticSceneContainsLods = priv->staticSceneContainsLods;
@@ -877,7 +939,13 @@ bool RRSolver::gatherPerTrianglePhysical(const UpdateParameters* _params, const
 #else
 	int numThreads = 1;
 #endif
-	TexelSubTexels* subTexels = new TexelSubTexels[numThreads];
+	RRArena::Scope scope; // subtexels and relevant lights are freed at the end of function
+	TexelSubTexels* subTexels = RRArena::getThreadArena().allocateArray<TexelSubTexels>(numThreads);
+	if (!subTexels)
+	{
+		RRReporter::report(ERRO,"Not enough memory, illumination not updated.\n");
+		return false;
+	}
 	SubTexel subTexel;
 	subTexel.areaInMapSpace = 1; // absolute value of area is not important because subtexel is only one
 	subTexel.uvInTriangleSpace[0] = RRVec2(0,0);
@@ -885,69 +953,173 @@ bool RRSolver::gatherPerTrianglePhysical(const UpdateParameters* _params, const
 	subTexel.uvInTriangleSpace[2] = RRVec2(0,1);
 	TexelSubTexels::Allocator subTexelAllocator;
 	for (int i=0;i<numThreads;i++)
+	{
+		new(subTexels+i) TexelSubTexels;
 		subTexels[i].push_back(subTexel,subTexelAllocator);
+	}
 
 	// preallocate empty relevantLights
 	//unsigned numAllLights = getLights().size();
 	//const RRLight** emptyRelevantLights = new const RRLight*[numAllLights*numThreads];
 	// preallocate filled per-object relevantLights
+	// lights of object i are relevantLights[relevantLightsBegin[i]..relevantLightsBegin[i+1]-1]
 	unsigned numAllLights = getLights().size();
 	unsigned numObjects = getStaticObjects().size();
-	std::vector<const RRLight*>* relevantLightsPerObject = new std::vector<const RRLight*>[numObjects];
-	for (unsigned objectNumber=0;objectNumber<numObjects;objectNumber++)
+	unsigned* relevantLightsBegin = RRArena::getThreadArena().allocateArray<unsigned>(numObjects+1);
+	const RRLight** relevantLights = nullptr;
+	if (!relevantLightsBegin)
 	{
-		RRMesh::PreImportNumber preImportTriangleNumber;
-		preImportTriangleNumber.object = objectNumber;
-		preImportTriangleNumber.index = getStaticObjects()[objectNumber]->getCollider()->getMesh()->getPreImportTriangle(0).index; // we assume object's triangle 0 made it into multiobject
-		unsigned postImportTriangleNumber = multiMesh->getPostImportTriangle(preImportTriangleNumber);
-		for (unsigned lightNumber=0;lightNumber<numAllLights;lightNumber++)
+		RRReporter::report(ERRO,"Not enough memory, illumination not updated.\n");
+		return false;
+	}
+	for (unsigned pass=0;pass<2;pass++) // 0=count, 1=fill
+	{
+		unsigned numRelevantLights = 0;
+		for (unsigned objectNumber=0;objectNumber<numObjects;objectNumber++)
+		{
+			relevantLightsBegin[objectNumber] = numRelevantLights;
+			RRMesh::PreImportNumber preImportTriangleNumber;
+			preImportTriangleNumber.object = objectNumber;
+			preImportTriangleNumber.index = getStaticObjects()[objectNumber]->getCollider()->getMesh()->getPreImportTriangle(0).index; // we assume object's triangle 0 made it into multiobject
+			unsigned postImportTriangleNumber = multiMesh->getPostImportTriangle(preImportTriangleNumber);
+			for (unsigned lightNumber=0;lightNumber<numAllLights;lightNumber++)
+			{
+				const RRLight* light = getLights()[lightNumber];
+				if (light && light->enabled)
+					if (// make all lights relevant in rare case we picked invalid triangle
+						// - UINT_MAX is returned if triangle 0 is not in multiobject, this happens when opening kalasatama.dae in MovingSun, koupelna3.3ds+1light in SceneViewer
+						// - out of range number is returned if object has 0 triangles, this happens when building lmaps in koupelna3 with inserted light
+						postImportTriangleNumber>=numPostImportTriangles
+
+						|| multiObject->getTriangleMaterial(postImportTriangleNumber,light,0))
+					{
+						if (pass)
+							relevantLights[numRelevantLights] = light;
+						numRelevantLights++;
+					}
+			}
+		}
+		relevantLightsBegin[numObjects] = numRelevantLights;
+		if (!pass)
 		{
-			const RRLight* light = getLights()[lightNumber];
-			if (light && light->enabled)
-				if (// make all lights relevant in rare case we picked invalid triangle
-					// - UINT_MAX is returned if triangle 0 is not in multiobject, this happens when opening kalasatama.dae in MovingSun, koupelna3.3ds+1light in SceneViewer
-					// - out of range number is returned if object has 0 triangles, this happens when building lmaps in koupelna3 with inserted light
-					postImportTriangleNumber>=numPostImportTriangles
-
-					|| multiObject->getTriangleMaterial(postImportTriangleNumber,light,0))
-					relevantLightsPerObject[objectNumber].push_back(light);
+			relevantLights = RRArena::getThreadArena().allocateArray<const RRLight*>(numRelevantLights);
+			if (!relevantLights)
+			{
+				RRReporter::report(ERRO,"Not enough memory, illumination not updated.\n");
+				return false;
+			}
 		}
 	}
 
+	// light trees, objects with the same relevant lights as previous object share its tree
+	auto hasLightsOfPreviousObject = [&](unsigned objectNumber)
+	{
+		unsigned numLights = relevantLightsBegin[objectNumber+1]-relevantLightsBegin[objectNumber];
+		return objectNumber && numLights==relevantLightsBegin[objectNumber]-relevantLightsBegin[objectNumber-1]
+			&& std::equal(relevantLights+relevantLightsBegin[objectNumber],relevantLights+relevantLightsBegin[objectNumber]+numLights,relevantLights+relevantLightsBegin[objectNumber-1]);
+	};
+	std::vector<LightTree*> lightTrees(numObjects,nullptr);
+	if (params.lightSamples)
+	{
+		#pragma omp parallel for schedule(dynamic)
+		for (int objectNumber=0;objectNumber<(int)numObjects;objectNumber++)
+			if (!hasLightsOfPreviousObject(objectNumber))
+				lightTrees[objectNumber] = LightTree::create(relevantLights+relevantLightsBegin[objectNumber],relevantLightsBegin[objectNumber+1]-relevantLightsBegin[objectNumber],params.lightSamples);
+		for (unsigned objectNumber=1;objectNumber<numObjects;objectNumber++)
+			if (hasLightsOfPreviousObject(objectNumber))
+				lightTrees[objectNumber] = lightTrees[objectNumber-1];
+	}
+
+	// lights that reach cluster of triangles, per thread
+	const RRLight** clusterLights = RRArena::getThreadArena().allocateArray<const RRLight*>(numAllLights*numThreads);
+	if (!clusterLights)
+	{
+		RRReporter::report(ERRO,"Not enough memory, illumination not updated.\n");
+		return false;
+	}
+
+	// triangles are processed in clusters of consecutive triangles (mostly neighbours in the same object),
+	// lights of object are culled against bounding box of its triangles in cluster
+	enum {CLUSTER_SIZE=64};
+	unsigned numClusters = (numPostImportTriangles+CLUSTER_SIZE-1)/CLUSTER_SIZE;
+	unsigned profilerStage = RRProfiler::getStage();
 	#pragma omp parallel for schedule(dynamic)
-	for (int t=0;t<(int)numPostImportTriangles;t++)
+	for (int c=0;c<(int)numClusters;c++)
 	{
-		if ((t%10000)==0) RRReporter::report(INF3,"step %d/%d\n",t/10000,(numPostImportTriangles+10000-1)/10000);
-		if ((params.debugTriangle==UINT_MAX || params.debugTriangle==t) && !aborting) // skip other triangles when debugging one
-		{
+		RR_PROFILE_PARENT(profilerStage);
 #ifdef _OPENMP
-			int threadNum = omp_get_thread_num();
+		int threadNum = omp_get_thread_num();
 #else
-			int threadNum = 0;
+		int threadNum = 0;
 #endif
-			unsigned objectNumber = multiMesh->getPreImportTriangle(t).object;
-			lmj.singleObjectReceiver = getStaticObjects()[objectNumber];
-			ProcessTexelParams ptp(lmj);
-			ptp.subTexels = subTexels+threadNum;
-			ptp.subTexels->begin()->multiObjPostImportTriIndex = t;
-			ptp.rayLengthMin = priv->minimalSafeDistance;
-
-			// pass empty array (is filled by processTexel for each triangle separately)
-			//ptp.relevantLights = emptyRelevantLights+numAllLights*threadNum;
-			//ptp.numRelevantLights = 0;
-			//ptp.relevantLightsFilled = false;
-			// pass filled array (is common for all triangles in singleobject)
-			ptp.numRelevantLights = (unsigned)relevantLightsPerObject[objectNumber].size();
-			ptp.relevantLights = ptp.numRelevantLights ? &(relevantLightsPerObject[objectNumber][0]) : nullptr; // dirty conversion, from std::vector to array
-			ptp.relevantLightsFilled = true;
-
-			resultsPhysical->store(t,processTexel(ptp));
+		unsigned clusterEnd = RR_MIN((unsigned)(c+1)*CLUSTER_SIZE,numPostImportTriangles);
+		unsigned clusterObjectNumber = UINT_MAX;
+		const RRLight** clusterRelevantLights = nullptr;
+		unsigned clusterNumRelevantLights = 0;
+		unsigned clusterNumCulledLights = 0;
+		for (unsigned t=c*CLUSTER_SIZE;t<clusterEnd;t++)
+		{
+			if ((t%10000)==0) RRReporter::report(INF3,"step %d/%d\n",t/10000,(numPostImportTriangles+10000-1)/10000);
+			if ((params.debugTriangle==UINT_MAX || params.debugTriangle==t) && !aborting) // skip other triangles when debugging one
+			{
+				unsigned objectNumber = multiMesh->getPreImportTriangle(t).object;
+				if (objectNumber!=clusterObjectNumber)
+				{
+					// pass filled array (is common for all triangles in singleobject)
+					clusterObjectNumber = objectNumber;
+					clusterNumRelevantLights = relevantLightsBegin[objectNumber+1]-relevantLightsBegin[objectNumber];
+					clusterRelevantLights = clusterNumRelevantLights ? relevantLights+relevantLightsBegin[objectNumber] : nullptr;
+					clusterNumCulledLights = 0;
+					if (clusterNumRelevantLights && !lightTrees[objectNumber] && params.lightCutoffIrradiance>=0)
+					{
+						// remove lights that can't reach triangles of this object in cluster
+						RRVec3 mini(FLT_MAX);
+						RRVec3 maxi(-FLT_MAX);
+						for (unsigned u=t;u<clusterEnd && multiMesh->getPreImportTriangle(u).object==objectNumber;u++)
+						{
+							RRMesh::TriangleBody body;
+							multiMesh->getTriangleBody(u,body);
+							RRVec3 vertex[3] = {body.vertex0,body.vertex0+body.side1,body.vertex0+body.side2};
+							for (unsigned v=0;v<3;v++)
+								for (unsigned a=0;a<3;a++)
+								{
+									mini[a] = RR_MIN(mini[a],vertex[v][a]);
+									maxi[a] = RR_MAX(maxi[a],vertex[v][a]);
+								}
+						}
+						const RRLight** reachingLights = clusterLights+numAllLights*threadNum;
+						unsigned numReachingLights = cullLights(clusterRelevantLights,clusterNumRelevantLights,mini,maxi,params.lightCutoffIrradiance,reachingLights);
+						clusterNumCulledLights = clusterNumRelevantLights-numReachingLights;
+						clusterNumRelevantLights = numReachingLights;
+						clusterRelevantLights = numReachingLights ? reachingLights : nullptr;
+					}
+				}
+				lmj.singleObjectReceiver = getStaticObjects()[objectNumber];
+				ProcessTexelParams ptp(lmj);
+				ptp.subTexels = subTexels+threadNum;
+				ptp.subTexels->begin()->multiObjPostImportTriIndex = t;
+				ptp.rayLengthMin = priv->minimalSafeDistance;
+
+				// pass empty array (is filled by processTexel for each triangle separately)
+				//ptp.relevantLights = emptyRelevantLights+numAllLights*threadNum;
+				//ptp.numRelevantLights = 0;
+				//ptp.relevantLightsFilled = false;
+				ptp.numRelevantLights = clusterNumRelevantLights;
+				ptp.relevantLights = clusterRelevantLights;
+				ptp.numCulledLights = clusterNumCulledLights;
+				ptp.relevantLightsFilled = true;
+				ptp.lightTree = lightTrees[objectNumber];
+
+				resultsPhysical->store(t,processTexel(ptp));
+			}
 		}
 	}
 
+	for (unsigned objectNumber=0;objectNumber<numObjects;objectNumber++)
+		if (!hasLightsOfPreviousObject(objectNumber))
+			delete lightTrees[objectNumber];
+
 	//delete[] emptyRelevantLights;
-	delete[] relevantLightsPerObject;
-	delete[] subTexels;
 	return !aborting;
 }
 
@@ -959,6 +1131,7 @@ bool RRSolver::gatherPerTrianglePhysical(const UpdateParameters* _params, const
 bool RRSolver::updateSolverDirectIllumination(const UpdateParameters* _params)
 {
 	RRReportInterval report(INF2,"Updating solver direct ...\n");
+	RR_PROFILE_SCOPE("firstGather");
 
 	if (!getMultiObject() || !priv->scene || !getMultiObject()->getCollider()->getMesh()->getNumTriangles())
 	{
@@ -1068,6 +1241,7 @@ bool RRSolver::updateSolverIndirectIllumination(const UpdateParameters* _paramsI
 	}
 
 	RRReportInterval report(INF2,"Updating solver indirect(%ls).\n",getIndirectParamsAsString(paramsIndirect).w_str());
+	RR_PROFILE_SCOPE("indirect");
 
 	// fix all dirty flags, so next calculateCore doesn't call detectDirectIllumination etc
 	calculateCore(0,&priv->previousCalculateParameters);
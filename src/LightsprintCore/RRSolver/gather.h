@@ -14,6 +14,7 @@
 
 #include "Lightsprint/RRSolver.h"
 #include "../RRStaticSolver/pathtracer.h" // PathtracerJob
+#include "lightTree.h"
 	#include "../RRStaticSolver/ChunkList.h"
 
 namespace rr
@@ -100,8 +101,12 @@ struct ProcessTexelParams
 		// warning: for very high quality, we could end up with neighbouring texels shooting nearly the same rays, e.g. 0..100000 and 1000..101000
 		//          ideally we should set higher random numbers when higher quality is set
 		resetFiller = rand()&0xffff;
+		uv[0] = 0;
+		uv[1] = 0;
 		rayLengthMin = 0;
 		relevantLights = nullptr;
+		numCulledLights = 0;
+		lightTree = nullptr;
 	}
 	const LightmapperJob& context;
 	TexelSubTexels* subTexels;
@@ -111,6 +116,49 @@ struct ProcessTexelParams
 	const RRLight** relevantLights; // pointer to sufficiently big array of RRLight*
 	unsigned numRelevantLights; // number of valid relevant lights in array
 	bool relevantLightsFilled; // true when relevantLights are already filled, false when array is uninitialized
+	unsigned numCulledLights; // number of lights removed from relevantLights because they can't reach texel, they count as reliable black
+	const LightTree* lightTree; // nullptr or tree built from relevantLights, when set, lights are picked from tree (params.lightSamples)
+
+	// Returns seed of homogenous fillers, it depends only on texel when params.randomSeed is set.
+	unsigned getResetFiller() const
+	{
+		return context.params.randomSeed ? getTexelSeed()&0xffff : resetFiller;
+	}
+	unsigned getTexelSeed() const
+	{
+		return context.params.randomSeed*2654435761u ^ uv[0]*73856093u ^ uv[1]*19349663u ^ subTexels->begin()->multiObjPostImportTriIndex*83492791u;
+	}
+};
+
+// Random numbers of one texel, reproducible when params.randomSeed is set, rand() otherwise.
+class TexelRandom
+{
+public:
+	// Different streams of the same texel are not correlated.
+	TexelRandom(const ProcessTexelParams& pti, unsigned stream)
+	{
+		seeded = pti.context.params.randomSeed!=0;
+		state = pti.getTexelSeed()+stream*0x9e3779b9u;
+		state ^= state>>16;
+		state *= 0x85ebca6bu;
+		state ^= state>>13;
+		state *= 0xc2b2ae35u;
+		state ^= state>>16;
+		state |= 1; // xorshift needs nonzero state
+	}
+	// Returns number in 0..RAND_MAX range.
+	unsigned get()
+	{
+		if (!seeded)
+			return rand();
+		state ^= state<<13;
+		state ^= state>>17;
+		state ^= state<<5;
+		return state&RAND_MAX;
+	}
+private:
+	bool seeded;
+	unsigned state;
 };
 
 struct ProcessTexelResult
@@ -0,0 +1,109 @@
+// --------------------------------------------------------------------------
+// Copyright (C) 1999-2021 Stepan Hrbek
+// This file is part of Lightsprint SDK, you can use and/or redistribute it
+// only under terms of Lightsprint SDK license agreement. A copy of the agreement
+// is available by contacting Lightsprint at http://lightsprint.com
+//
+// Spatial light culling, which lights can illuminate given box.
+// --------------------------------------------------------------------------
+
+#include <cfloat>
+#include <cmath>
+#include "../RRMathPrivate.h"
+#include "lightCulling.h"
+
+namespace rr
+{
+
+// spot cone is enlarged by this angle, so that rounding errors don't cull receivers exactly at cone boundary
+#define CONE_MARGIN 0.001f
+
+RRReal getLightReach(const RRLight* light, RRReal cutoffIrradiance)
+{
+	if (!light || light->type==RRLight::DIRECTIONAL)
+		return FLT_MAX;
+	RRReal reach = FLT_MAX;
+	RRReal intensity = light->color.abs().maxi();
+	switch (light->distanceAttenuationType)
+	{
+		case RRLight::EXPONENTIAL:
+			// pow(0,0)=1, light with zero exponent reaches everywhere
+			if (light->fallOffExponent>0)
+				reach = light->radius;
+			break;
+		case RRLight::REALISTIC:
+			// irradiance = intensity/distance^2
+			if (cutoffIrradiance>0)
+				reach = sqrt(intensity/cutoffIrradiance);
+			break;
+		case RRLight::POLYNOMIAL:
+			// irradiance = intensity/max(polynom[0]+polynom[1]*distance+polynom[2]*distance^2,polynom[3]), before conversion to linear colors
+			if (cutoffIrradiance>0 && light->polynom[0]>=0 && light->polynom[1]>=0 && light->polynom[2]>=0)
+			{
+				RRReal c = light->polynom[0]-intensity/cutoffIrradiance;
+				if (light->polynom[3]>0 && intensity<=cutoffIrradiance*light->polynom[3])
+					reach = 0; // too weak even at its maximum
+				else
+				if (light->polynom[2]>0)
+					reach = (-light->polynom[1]+sqrt(RR_MAX(0,light->polynom[1]*light->polynom[1]-4*light->polynom[2]*c)))/(2*light->polynom[2]);
+				else
+				if (light->polynom[1]>0)
+					reach = -c/light->polynom[1];
+				reach = RR_MAX(reach,0);
+			}
+			break;
+		case RRLight::NONE:
+			break;
+	}
+	return reach;
+}
+
+bool lightReachesBox(const RRLight* light, const RRVec3& mini, const RRVec3& maxi, RRReal cutoffIrradiance)
+{
+	if (!light || light->type==RRLight::DIRECTIONAL)
+		return true;
+	RRReal areaRadius = light->getAreaRadius();
+
+	// distance
+	RRReal reach = getLightReach(light,cutoffIrradiance);
+	if (reach<FLT_MAX)
+	{
+		RRVec3 gap(
+			RR_MAX3(0,mini.x-light->position.x,light->position.x-maxi.x),
+			RR_MAX3(0,mini.y-light->position.y,light->position.y-maxi.y),
+			RR_MAX3(0,mini.z-light->position.z,light->position.z-maxi.z));
+		if (gap.length()>reach+areaRadius)
+			return false;
+	}
+
+	// cone, tested against bounding sphere of box
+	if (light->type==RRLight::SPOT && light->direction.length2()>0)
+	{
+		// projected texture is square frustum, it reaches out of cone in corners
+		RRReal coneAngle = light->projectedTexture ? atan(tan(RR_CLAMPED(light->outerAngleRad,0,RR_PI/2))*1.4142136f) : light->outerAngleRad;
+		if (coneAngle>=0 && coneAngle<RR_PI/2)
+		{
+			RRVec3 toCenter = (mini+maxi)*0.5f-light->position;
+			RRReal radius = (maxi-mini).length()*0.5f+areaRadius;
+			RRReal distance = toCenter.length();
+			if (distance>radius)
+			{
+				RRReal angle = acos(RR_CLAMPED(dot(light->direction.normalized(),toCenter/distance),-1,1));
+				if (angle-asin(radius/distance)>coneAngle+CONE_MARGIN)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+unsigned cullLights(const RRLight** lights, unsigned numLights, const RRVec3& mini, const RRVec3& maxi, RRReal cutoffIrradiance, const RRLight** reachingLights)
+{
+	unsigned numReachingLights = 0;
+	for (unsigned i=0;i<numLights;i++)
+		if (lightReachesBox(lights[i],mini,maxi,cutoffIrradiance))
+			reachingLights[numReachingLights++] = lights[i];
+	return numReachingLights;
+}
+
+}; // namespace
@@ -0,0 +1,33 @@
+// --------------------------------------------------------------------------
+// Copyright (C) 1999-2021 Stepan Hrbek
+// This file is part of Lightsprint SDK, you can use and/or redistribute it
+// only under terms of Lightsprint SDK license agreement. A copy of the agreement
+// is available by contacting Lightsprint at http://lightsprint.com
+//
+// Spatial light culling, which lights can illuminate given box.
+// --------------------------------------------------------------------------
+
+#ifndef LIGHTCULLING_H
+#define LIGHTCULLING_H
+
+#include "Lightsprint/RRLight.h"
+
+namespace rr
+{
+
+// Returns distance from light position (or area) where light's irradiance drops to zero
+// or below cutoffIrradiance, FLT_MAX if light reaches everywhere.
+// cutoffIrradiance=0 accepts only distances where irradiance is exactly zero.
+RRReal getLightReach(const RRLight* light, RRReal cutoffIrradiance);
+
+// Returns false only if light can't illuminate (or illuminates below cutoffIrradiance) any point in box.
+// Tests distance attenuation and spot cone, area of light is taken into account.
+bool lightReachesBox(const RRLight* light, const RRVec3& mini, const RRVec3& maxi, RRReal cutoffIrradiance);
+
+// Copies lights that reach box to reachingLights (array of at least numLights), returns number of copied lights.
+// Order of lights is preserved.
+unsigned cullLights(const RRLight** lights, unsigned numLights, const RRVec3& mini, const RRVec3& maxi, RRReal cutoffIrradiance, const RRLight** reachingLights);
+
+}; // namespace
+
+#endif
@@ -0,0 +1,267 @@
+// --------------------------------------------------------------------------
+// Copyright (C) 1999-2021 Stepan Hrbek
+// This file is part of Lightsprint SDK, you can use and/or redistribute it
+// only under terms of Lightsprint SDK license agreement. A copy of the agreement
+// is available by contacting Lightsprint at http://lightsprint.com
+//
+// Light tree, importance sampling of many lights.
+// --------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include "../RRMathPrivate.h"
+#include "lightCulling.h"
+#include "lightTree.h"
+
+namespace rr
+{
+
+// Angle between normalized vectors.
+static RRReal getAngle(const RRVec3& a, const RRVec3& b)
+{
+	return acos(RR_CLAMPED(dot(a,b),-1,1));
+}
+
+// Extends cone a so that it contains cone b (Conty, Kulla: Importance Sampling of Many Lights with Adaptive Tree Splitting).
+static void mergeCones(RRVec3& axisA, RRReal& thetaOA, RRReal& thetaEA, RRVec3 axisB, RRReal thetaOB, RRReal thetaEB)
+{
+	RRReal thetaE = RR_MAX(thetaEA,thetaEB);
+	if (thetaOB>thetaOA)
+	{
+		std::swap(axisA,axisB);
+		std::swap(thetaOA,thetaOB);
+	}
+	RRReal thetaD = getAngle(axisA,axisB);
+	thetaEA = thetaE;
+	if (RR_MIN(thetaD+thetaOB,RR_PI)<=thetaOA)
+		return;
+	RRReal thetaO = (thetaOA+thetaD+thetaOB)/2;
+	if (thetaO>=RR_PI)
+	{
+		thetaOA = RR_PI;
+		return;
+	}
+	// rotate axisA towards axisB
+	RRVec3 ortho = axisB-axisA*dot(axisA,axisB);
+	RRReal orthoLength = ortho.length();
+	if (orthoLength>0)
+	{
+		RRReal thetaR = thetaO-thetaOA;
+		axisA = axisA*cos(thetaR)+ortho*(sin(thetaR)/orthoLength);
+		axisA.normalizeSafe();
+	}
+	thetaOA = thetaO;
+}
+
+LightTree* LightTree::create(const RRLight** lights, unsigned numLights, unsigned lightSamples)
+{
+	LightTree* tree = new LightTree;
+	std::vector<Node> leaves;
+	for (unsigned i=0;i<numLights;i++)
+	{
+		const RRLight* light = lights[i];
+		if (light->type==RRLight::DIRECTIONAL || light->distanceAttenuationType==RRLight::NONE)
+		{
+			tree->otherLights.push_back(light);
+			continue;
+		}
+		Node leaf;
+		RRReal areaRadius = light->getAreaRadius();
+		leaf.mini = light->position-RRVec3(areaRadius);
+		leaf.maxi = light->position+RRVec3(areaRadius);
+		if (light->type==RRLight::SPOT)
+		{
+			leaf.axis = light->direction;
+			leaf.thetaO = 0;
+			leaf.thetaE = light->projectedTexture ? RR_PI/2 : light->outerAngleRad; // square frustum reaches out of cone in corners
+		}
+		else
+		{
+			leaf.axis = RRVec3(0,0,1);
+			leaf.thetaO = RR_PI;
+			leaf.thetaE = RR_PI/2;
+		}
+		leaf.intensity = light->color.abs().avg();
+		if (light->distanceAttenuationType==RRLight::POLYNOMIAL)
+			leaf.intensity /= RR_MAX(RR_MAX(light->polynom[0]+light->polynom[1]+light->polynom[2],light->polynom[3]),1e-10f);
+		leaf.reach = getLightReach(light,0);
+		leaf.child = UINT_MAX;
+		leaf.light = light;
+		if (!(leaf.intensity>=0 && leaf.intensity<FLT_MAX && IS_VEC3(leaf.mini) && IS_VEC3(leaf.maxi) && IS_VEC3(leaf.axis)))
+		{
+			// invalid light, importance could not be estimated
+			tree->otherLights.push_back(light);
+			continue;
+		}
+		leaves.push_back(leaf);
+	}
+	for (unsigned i=0;i<leaves.size();i++)
+		setAngles(leaves[i]);
+	// with few lights per sample, picking costs more than it saves
+	// (BunnyBenchmark lighttree, 4 samples: 64 lights 0.7x speed of exhaustive bake at equal error, 256 lights 1.3x, 1024 lights 4x)
+	if (leaves.size()<=lightSamples*MIN_LIGHTS_PER_SAMPLE)
+	{
+		delete tree;
+		return nullptr;
+	}
+	tree->nodes.reserve(2*leaves.size()-1);
+	tree->nodes.resize(1);
+	tree->build(leaves,0,(unsigned)leaves.size(),0);
+	return tree;
+}
+
+// Builds subtree from leaves[begin..end-1] into nodes[index].
+void LightTree::build(std::vector<Node>& leaves, unsigned begin, unsigned end, unsigned index)
+{
+	if (end-begin==1)
+	{
+		nodes[index] = leaves[begin];
+		return;
+	}
+
+	// split in median of the longest axis of centers
+	RRVec3 centerMini(FLT_MAX);
+	RRVec3 centerMaxi(-FLT_MAX);
+	for (unsigned i=begin;i<end;i++)
+	{
+		RRVec3 center = leaves[i].mini+leaves[i].maxi;
+		for (unsigned a=0;a<3;a++)
+		{
+			centerMini[a] = RR_MIN(centerMini[a],center[a]);
+			centerMaxi[a] = RR_MAX(centerMaxi[a],center[a]);
+		}
+	}
+	RRVec3 size = centerMaxi-centerMini;
+	unsigned axis = (size.x>=size.y && size.x>=size.z) ? 0 : ((size.y>=size.z) ? 1 : 2);
+	unsigned middle = (begin+end)/2;
+	std::nth_element(leaves.begin()+begin,leaves.begin()+middle,leaves.begin()+end,[axis](const Node& a, const Node& b){return a.mini[axis]+a.maxi[axis]<b.mini[axis]+b.maxi[axis];});
+
+	// children
+	unsigned child = (unsigned)nodes.size();
+	nodes.resize(child+2);
+	build(leaves,begin,middle,child);
+	build(leaves,middle,end,child+1);
+
+	// node contains both children
+	Node node = nodes[child];
+	const Node& child1 = nodes[child+1];
+	for (unsigned a=0;a<3;a++)
+	{
+		node.mini[a] = RR_MIN(node.mini[a],child1.mini[a]);
+		node.maxi[a] = RR_MAX(node.maxi[a],child1.maxi[a]);
+	}
+	mergeCones(node.axis,node.thetaO,node.thetaE,child1.axis,child1.thetaO,child1.thetaE);
+	node.intensity += child1.intensity;
+	node.reach = RR_MAX(node.reach,child1.reach);
+	node.child = child;
+	node.light = nullptr;
+	setAngles(node);
+	nodes[index] = node;
+}
+
+void LightTree::setAngles(Node& node)
+{
+	node.cosThetaO = cos(node.thetaO);
+	node.sinThetaO = sin(node.thetaO);
+	node.cosThetaE = cos(node.thetaE);
+}
+
+// Estimates contribution of node's lights to receiver, never returns 0 if some light can contribute.
+// Angles are not calculated, only their sines and cosines.
+RRReal LightTree::getImportance(const Node& node, const RRVec3& receiverPosition, const RRVec3& receiverNormal) const
+{
+	if (node.intensity<=0)
+		return 0;
+
+	// distance
+	if (node.reach<FLT_MAX)
+	{
+		RRVec3 gap(
+			RR_MAX3(0,node.mini.x-receiverPosition.x,receiverPosition.x-node.maxi.x),
+			RR_MAX3(0,node.mini.y-receiverPosition.y,receiverPosition.y-node.maxi.y),
+			RR_MAX3(0,node.mini.z-receiverPosition.z,receiverPosition.z-node.maxi.z));
+		if (gap.length2()>=node.reach*node.reach)
+			return 0;
+	}
+	RRVec3 toCenter = (node.mini+node.maxi)/2-receiverPosition;
+	RRReal distance2 = toCenter.length2();
+	RRReal radius2 = (node.maxi-node.mini).length2()/4;
+	if (distance2<=radius2)
+	{
+		// receiver inside bounding sphere, any direction is possible
+		return node.intensity/RR_MAX(radius2,1e-10f);
+	}
+
+	// angles are reduced by angle of bounding sphere (thetaU), so that they are conservative
+	RRReal distance = sqrt(distance2);
+	RRVec3 direction = toCenter/distance;
+	RRReal sinU = sqrt(radius2/distance2);
+	RRReal cosU = sqrt(1-radius2/distance2);
+
+	// incident angle, cos(max(0,thetaI-thetaU))
+	RRReal cosI = RR_CLAMPED(dot(receiverNormal,direction),-1,1);
+	if (cosI<cosU)
+	{
+		RRReal sinI = sqrt(1-cosI*cosI);
+		cosI = cosI*cosU+sinI*sinU;
+		if (cosI<=0)
+			return 0;
+	}
+	else
+		cosI = 1;
+
+	// emission angle, cos(max(0,theta-thetaO-thetaU))
+	RRReal cosE = RR_CLAMPED(-dot(node.axis,direction),-1,1);
+	if (cosE<node.cosThetaO)
+	{
+		RRReal sinE = sqrt(1-cosE*cosE);
+		RRReal cosEO = cosE*node.cosThetaO+sinE*node.sinThetaO;
+		RRReal sinEO = sinE*node.cosThetaO-cosE*node.sinThetaO;
+		cosE = (cosEO<cosU) ? cosEO*cosU+sinEO*sinU : 1;
+		if (cosE<=node.cosThetaE)
+			return 0;
+	}
+	else
+		cosE = 1;
+
+	return node.intensity*cosI*cosE/RR_MAX(distance2,1e-10f);
+}
+
+const RRLight* LightTree::pickLight(const RRVec3& receiverPosition, const RRVec3& receiverNormal, RRReal random, RRReal& probability) const
+{
+	probability = 1;
+	if (getImportance(nodes[0],receiverPosition,receiverNormal)<=0)
+		return nullptr;
+	random = RR_CLAMPED(random,0,0.99999994f); // float rounding of caller's random can produce 1
+	unsigned index = 0;
+	while (nodes[index].child!=UINT_MAX)
+	{
+		unsigned child = nodes[index].child;
+		RRReal importance0 = getImportance(nodes[child],receiverPosition,receiverNormal);
+		RRReal importance1 = getImportance(nodes[child+1],receiverPosition,receiverNormal);
+		if (!(importance0+importance1>0))
+			return nullptr; // parent's estimate was less strict
+		RRReal probability0 = importance0/(importance0+importance1);
+		// never descend into child with zero importance, it would return probability 0 (infinite weight)
+		if (importance1<=0 || (importance0>0 && random<probability0))
+		{
+			index = child;
+			probability *= probability0;
+			random /= probability0;
+		}
+		else
+		{
+			index = child+1;
+			probability *= 1-probability0;
+			random = (random-probability0)/(1-probability0);
+		}
+		if (!(probability>0))
+			return nullptr; // underflow in deep tree, treat as miss
+		random = RR_CLAMPED(random,0,0.99999994f); // reused for next level, rounding could push it out of range
+	}
+	return nodes[index].light;
+}
+
+}; // namespace
@@ -0,0 +1,72 @@
+// --------------------------------------------------------------------------
+// Copyright (C) 1999-2021 Stepan Hrbek
+// This file is part of Lightsprint SDK, you can use and/or redistribute it
+// only under terms of Lightsprint SDK license agreement. A copy of the agreement
+// is available by contacting Lightsprint at http://lightsprint.com
+//
+// Light tree, importance sampling of many lights.
+// --------------------------------------------------------------------------
+
+#ifndef LIGHTTREE_H
+#define LIGHTTREE_H
+
+#include <vector>
+#include "Lightsprint/RRLight.h"
+
+namespace rr
+{
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// LightTree
+//
+// Bounding volume hierarchy over point and spot lights, each node knows
+// total intensity and cone of directions its lights emit to.
+// Baker picks few lights per round instead of shooting to all of them,
+// light is picked with probability roughly proportional to its contribution to receiver.
+// Lights that can't be estimated (directional, no distance attenuation) stay outside tree,
+// caller shoots to them always.
+// Never modified after construction, so it can be read by many threads.
+
+class LightTree
+{
+public:
+	enum {MIN_LIGHTS_PER_SAMPLE=32};
+
+	// Returns nullptr if there are not more than lightSamples*MIN_LIGHTS_PER_SAMPLE lights to put in tree, shooting to all of them is faster.
+	static LightTree* create(const RRLight** lights, unsigned numLights, unsigned lightSamples);
+
+	// Picks light for receiver, random is in 0..1 range (1 excluded, larger values are clamped).
+	// Returns nullptr if no light in tree can illuminate receiver.
+	// Contribution of picked light must be divided by probability.
+	const RRLight* pickLight(const RRVec3& receiverPosition, const RRVec3& receiverNormal, RRReal random, RRReal& probability) const;
+
+	// Lights not in tree.
+	std::vector<const RRLight*> otherLights;
+
+private:
+	struct Node
+	{
+		RRVec3 mini; // bounding box of lights, including their area
+		RRVec3 maxi;
+		RRVec3 axis; // cone of directions lights emit to, axis and spread of light axes (thetaO) plus emission angle (thetaE)
+		RRReal thetaO;
+		RRReal thetaE;
+		RRReal cosThetaO; // precalculated for getImportance()
+		RRReal sinThetaO;
+		RRReal cosThetaE;
+		RRReal intensity; // sum of light intensities, irradiance in distance 1
+		RRReal reach; // lights don't illuminate receivers farther from box
+		unsigned child; // index of the first child, the second one follows, or UINT_MAX in leaf
+		const RRLight* light; // only in leaf
+	};
+	LightTree() {}
+	void build(std::vector<Node>& leaves, unsigned begin, unsigned end, unsigned index);
+	static void setAngles(Node& node);
+	RRReal getImportance(const Node& node, const RRVec3& receiverPosition, const RRVec3& receiverNormal) const;
+	std::vector<Node> nodes; // nodes[0] is root
+};
+
+}; // namespace
+
+#endif
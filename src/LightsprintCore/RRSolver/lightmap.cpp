@@ -13,6 +13,7 @@
 #include <cstdio> // sprintf
 #include <vector>
 #include <algorithm>
+#include <type_traits> // is_pointer
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -20,6 +21,8 @@
 #include "../RRMathPrivate.h"
 #include "private.h"
 #include "gather.h"
+#include "lightCulling.h"
+#include "../RRHash/sha1.h"
 
 //#define ITERATE_MULTIMESH // older version with very small inefficiency
 
@@ -80,6 +83,32 @@ struct UnwrapStatistics
 	}		
 };
 
+// Bounding box of subtexels in world space.
+static void getTexelBox(const RRMesh* multiMesh, const TexelSubTexels& subTexels, RRVec3& mini, RRVec3& maxi)
+{
+	mini = RRVec3(FLT_MAX);
+	maxi = RRVec3(-FLT_MAX);
+	unsigned triangleIndex = UINT_MAX;
+	RRMesh::TriangleBody body;
+	for (TexelSubTexels::const_iterator i=subTexels.begin();i!=subTexels.end();++i)
+	{
+		if (i->multiObjPostImportTriIndex!=triangleIndex)
+		{
+			triangleIndex = i->multiObjPostImportTriIndex;
+			multiMesh->getTriangleBody(triangleIndex,body);
+		}
+		for (unsigned v=0;v<3;v++)
+		{
+			RRVec3 position = body.vertex0 + body.side1*i->uvInTriangleSpace[v][0] + body.side2*i->uvInTriangleSpace[v][1];
+			for (unsigned a=0;a<3;a++)
+			{
+				mini[a] = RR_MIN(mini[a],position[a]);
+				maxi[a] = RR_MAX(maxi[a],position[a]);
+			}
+		}
+	}
+}
+
 bool enumerateTexelsPartial(const RRObject* multiObject, unsigned objectNumber,
 		unsigned mapWidth, unsigned mapHeight,
 		unsigned rectXMin, unsigned rectYMin, unsigned rectXMaxPlus1, unsigned rectYMaxPlus1, 
@@ -94,17 +123,16 @@ bool enumerateTexelsPartial(const RRObject* multiObject, unsigned objectNumber,
 	const RRMesh* multiMesh = multiObject->getCollider()->getMesh();
 
 	// 1. preallocate texels
+	RRArena::Scope scope; // texels and relevant lights are freed at the end of function
 	unsigned numTexelsInRect = (rectXMaxPlus1-rectXMin)*(rectYMaxPlus1-rectYMin);
-	TexelSubTexels* texelsRect = nullptr;
-	try
-	{
-		texelsRect = new TexelSubTexels[numTexelsInRect];
-	}
-	catch(std::bad_alloc e)
+	TexelSubTexels* texelsRect = RRArena::getThreadArena().allocateArray<TexelSubTexels>(numTexelsInRect);
+	if (!texelsRect)
 	{
 		RRReporter::report(ERRO,"Not enough memory, lightmap not updated(1).\n");
 		return false;
 	}
+	for (unsigned i=0;i<numTexelsInRect;i++)
+		new(texelsRect+i) TexelSubTexels;
 	TexelSubTexels::Allocator subTexelAllocator; // pool, memory is freed when it gets out of scope
 	unsigned multiPostImportTriangleNumber = 0; // filled in next step
 
@@ -339,7 +367,6 @@ bool enumerateTexelsPartial(const RRObject* multiObject, unsigned objectNumber,
 	catch(std::bad_alloc e)
 	{
 		RRReporter::report(ERRO,"Not enough memory, lightmap not updated(2).\n");
-		delete[] texelsRect;
 		return false;
 	}
 
@@ -351,7 +378,12 @@ bool enumerateTexelsPartial(const RRObject* multiObject, unsigned objectNumber,
 #endif
 	unsigned numAllLights = lmj.solver ? lmj.solver->getLights().size() : 0;
 	unsigned numRelevantLights = 0;
-	const RRLight** relevantLightsForObject = new const RRLight*[numAllLights*numThreads];
+	const RRLight** relevantLightsForObject = RRArena::getThreadArena().allocateArray<const RRLight*>(numAllLights*numThreads);
+	if (!relevantLightsForObject)
+	{
+		RRReporter::report(ERRO,"Not enough memory, lightmap not updated(3).\n");
+		return false;
+	}
 	for (unsigned i=0;i<numAllLights;i++)
 	{
 		RRLight* light = lmj.solver->getLights()[i];
@@ -362,12 +394,25 @@ bool enumerateTexelsPartial(const RRObject* multiObject, unsigned objectNumber,
 			numRelevantLights++;
 		}
 	}
+	LightTree* lightTree = lmj.params.lightSamples ? LightTree::create(relevantLightsForObject,numRelevantLights,lmj.params.lightSamples) : nullptr;
+	// lights that reach texel, per thread
+	// (subtexels in map space are for statistics only, they can't be culled in 3d)
+	bool cullLightsPerTexel = numRelevantLights && !lightTree && !unwrapStatistics.subtexelsInMapSpace && lmj.params.lightCutoffIrradiance>=0;
+	const RRLight** relevantLightsForTexel = cullLightsPerTexel ? RRArena::getThreadArena().allocateArray<const RRLight*>(numAllLights*numThreads) : nullptr;
+	if (cullLightsPerTexel && !relevantLightsForTexel)
+	{
+		delete lightTree;
+		RRReporter::report(ERRO,"Not enough memory, lightmap not updated(4).\n");
+		return false;
+	}
 
 	// 5. gather, shoot rays from texels
 	unsigned numTexelsProcessed = 0;
+	unsigned profilerStage = RRProfiler::getStage();
 	#pragma omp parallel for schedule(dynamic) reduction(+:numTexelsProcessed)
 	for (int j=(int)rectYMin;j<(int)rectYMaxPlus1;j++)
 	{
+		RR_PROFILE_PARENT(profilerStage);
 #ifdef _OPENMP
 		int threadNum = omp_get_thread_num();
 #else
@@ -387,7 +432,17 @@ bool enumerateTexelsPartial(const RRObject* multiObject, unsigned objectNumber,
 					ptp.rayLengthMin = minimalSafeDistance;
 					ptp.relevantLights = relevantLightsForObject+numAllLights*threadNum;
 					ptp.numRelevantLights = numRelevantLights;
+					if (cullLightsPerTexel)
+					{
+						// remove lights that can't reach texel
+						RRVec3 mini, maxi;
+						getTexelBox(multiMesh,texelsRect[indexInRect],mini,maxi);
+						ptp.relevantLights = relevantLightsForTexel+numAllLights*threadNum;
+						ptp.numRelevantLights = cullLights(relevantLightsForObject+numAllLights*threadNum,numRelevantLights,mini,maxi,lmj.params.lightCutoffIrradiance,ptp.relevantLights);
+						ptp.numCulledLights = numRelevantLights-ptp.numRelevantLights;
+					}
 					ptp.relevantLightsFilled = true;
+					ptp.lightTree = lightTree;
 					callback(ptp);
 					numTexelsProcessed++;
 				}
@@ -395,10 +450,7 @@ bool enumerateTexelsPartial(const RRObject* multiObject, unsigned objectNumber,
 		}
 	}
 	unwrapStatistics.numTexelsProcessed += numTexelsProcessed;
-
-	// 6. cleanup
-	delete[] relevantLightsForObject;
-	delete[] texelsRect;
+	delete lightTree;
 
 	return true;
 }
@@ -663,6 +715,7 @@ unsigned RRSolver::updateLightmap(int objectNumber, RRBuffer* buffer, RRBuffer*
 		//(directionalLightmaps&&directionalLightmaps[2])?directionalLightmaps[2]->getWidth():0,
 		//(directionalLightmaps&&directionalLightmaps[2])?directionalLightmaps[2]->getHeight():0,
 		bentNormals?bentNormals->getWidth():0,bentNormals?bentNormals->getHeight():0);
+	RR_PROFILE_SCOPE("updateLightmap");
 	
 	// init params
 	UpdateParameters params;
@@ -820,7 +873,12 @@ unsigned RRSolver::updateLightmap(int objectNumber, RRBuffer* buffer, RRBuffer*
 		lmj.gatherAllDirections = allPixelBuffers[LS_DIRECTION1] || allPixelBuffers[LS_DIRECTION2] || allPixelBuffers[LS_DIRECTION3];
 		lmj.staticSceneContainsLods = priv->staticSceneContainsLods;
 		UnwrapStatistics us;
-		bool gathered = enumerateTexelsFull(getMultiObject(),objectNumber,pixelBufferWidth,pixelBufferHeight,processTexel,lmj,priv->minimalSafeDistance,us);
+		bool gathered;
+		{
+			RR_PROFILE_SCOPE("gather");
+			RR_PROFILE_COUNT("texels",pixelBufferWidth*pixelBufferHeight);
+			gathered = enumerateTexelsFull(getMultiObject(),objectNumber,pixelBufferWidth,pixelBufferHeight,processTexel,lmj,priv->minimalSafeDistance,us);
+		}
 
 		// report unwrap errors
 		if (gathered && (us.numTrianglesWithoutUnwrap || us.numTrianglesWithUnwrapOutOfRange))
@@ -854,6 +912,7 @@ unsigned RRSolver::updateLightmap(int objectNumber, RRBuffer* buffer, RRBuffer*
 			_filtering = &filteringLocal;
 		unsigned numBuffersEmpty = 0;
 		unsigned numBuffersFull = 0;
+		RR_PROFILE_SCOPE("filtering");
 		for (unsigned b=0;b<NUM_BUFFERS;b++)
 		{
 			if (lmj.pixelBuffers[b])
@@ -979,7 +1038,7 @@ unsigned RRSolver::updateLightmaps(int layerLightmap, int layerDirectionalLightm
 	bool containsVertexBuffers = false;
 	bool containsPixelBuffers = false;
 	bool containsVertexBuffer[NUM_BUFFERS] = {0,0,0,0,0};
-	unsigned sizeOfAllBuffers = 0;
+	size_t sizeOfAllBuffers = 0;
 	for (unsigned object=0;object<getStaticObjects().size();object++)
 	{
 		for (unsigned i=0;i<NUM_BUFFERS;i++)
@@ -1028,9 +1087,10 @@ unsigned RRSolver::updateLightmaps(int layerLightmap, int layerDirectionalLightm
 		layerLightmap,layerDirectionalLightmap,layerBentNormals,
 		getParamsAsString(params).w_str(),
 		getStaticObjects().size(),getLights().size());
+	RR_PROFILE_SCOPE("updateLightmaps");
 	
 	if (sizeOfAllBuffers>10000000 && (containsFirstGather||containsPixelBuffers||!containsRealtime))
-		RRReporter::report(INF1,"Memory taken by lightmaps: %dMB\n",sizeOfAllBuffers/1024/1024);
+		RRReporter::report(INF1,"Memory taken by lightmaps: %s\n",RRReporter::bytesToString(sizeOfAllBuffers));
 
 	// split parameters to slightly different direct and indirect ones
 	RRSolver::UpdateParameters paramsIndirect(params);
@@ -1068,6 +1128,9 @@ unsigned RRSolver::updateLightmaps(int layerLightmap, int layerDirectionalLightm
 	// 3. vertex: realtime copy into buffers (solver not modified)
 	if (containsVertexBuffers && containsRealtime)
 	{
+		// collect buffers of all objects, they are updated at once (many small objects are updated in parallel)
+		std::vector<int> objectHandles;
+		std::vector<RRBuffer*> vertexBuffers;
 		for (int objectHandle=0;objectHandle<(int)getStaticObjects().size();objectHandle++) if (!aborting)
 		{
 			for (unsigned i=0;i<NUM_BUFFERS;i++)
@@ -1079,7 +1142,8 @@ unsigned RRSolver::updateLightmaps(int layerLightmap, int layerDirectionalLightm
 					{
 						if (i==LS_LIGHTMAP)
 						{
-							updatedBuffers += updateVertexBufferFromSolver(objectHandle,vertexBuffer,&paramsDirect);
+							objectHandles.push_back(objectHandle);
+							vertexBuffers.push_back(vertexBuffer);
 						}
 						else
 						{
@@ -1089,6 +1153,8 @@ unsigned RRSolver::updateLightmaps(int layerLightmap, int layerDirectionalLightm
 				}
 			}
 		}
+		if (!vertexBuffers.empty())
+			updatedBuffers += updateVertexBuffersFromSolver((unsigned)vertexBuffers.size(),&objectHandles[0],&vertexBuffers[0],&paramsDirect);
 	}
 
 	// 4+5. vertex: final gather into vertex buffers (solver not modified)
@@ -1162,5 +1228,295 @@ unsigned RRSolver::updateLightmaps(int layerLightmap, int layerDirectionalLightm
 	return updatedBuffers;
 }
 
-} // namespace
+/////////////////////////////////////////////////////////////////////////////
+//
+// dependencies for incremental bake
 
+// hashes data that affect illumination, skipping runtime-only data (addresses, versions)
+class DependencyHasher
+{
+public:
+	template<class C>
+	void add(const C& a)
+	{
+		static_assert(!std::is_pointer<C>::value,"address is not persistent, add overload that hashes pointed data");
+		sha1.Update((const unsigned char*)&a,sizeof(a));
+	}
+	void add(const RRString& a)
+	{
+		const char* str = a.c_str();
+		sha1.Update((const unsigned char*)str,(unsigned)strlen(str)+1);
+	}
+	void add(RRBuffer* buffer)
+	{
+		add((const RRBuffer*)buffer);
+	}
+	void add(const RRBuffer* buffer)
+	{
+		add(buffer!=nullptr);
+		if (buffer)
+		{
+			add(buffer->getType());
+			add(buffer->getWidth());
+			add(buffer->getHeight());
+			add(buffer->getDepth());
+			add(buffer->getFormat());
+			add(buffer->getScaled());
+			// contents are hashed only when available in system memory, otherwise filename represents them
+			const unsigned char* data = const_cast<RRBuffer*>(buffer)->lock(BL_READ);
+			if (data)
+			{
+				size_t bytes = buffer->getBufferBytes();
+				for (size_t i=0;i<bytes;i+=UINT_MAX/2)
+					sha1.Update(data+i,(unsigned)RR_MIN(bytes-i,(size_t)UINT_MAX/2));
+				const_cast<RRBuffer*>(buffer)->unlock();
+			}
+			else
+				add(buffer->filename);
+		}
+	}
+	void add(const RRMaterial::Property& a)
+	{
+		add(a.color);
+		add(a.texcoord);
+		add(a.texture);
+	}
+	RRHash final()
+	{
+		RRHash hash;
+		sha1.Final();
+		sha1.GetHash(hash.value);
+		return hash;
+	}
+private:
+	CSHA1 sha1;
+};
+
+static RRHash getObjectHash(const RRObject* object)
+{
+	DependencyHasher hasher;
+	RRHash geometry = object->getHash();
+	hasher.add(geometry.value);
+	hasher.add(object->getWorldMatrixRef().m);
+	for (unsigned g=0;g<object->faceGroups.size();g++)
+	{
+		const RRMaterial* material = object->faceGroups[g].material;
+		hasher.add(object->faceGroups[g].numTriangles);
+		hasher.add(material!=nullptr);
+		if (material)
+		{
+			// colors and sidebits are already part of RRObject::getHash(), textures are not
+			hasher.add(material->diffuseReflectance);
+			hasher.add(material->diffuseEmittance);
+			hasher.add(material->specularReflectance);
+			hasher.add(material->specularTransmittance);
+			hasher.add(material->bumpMap);
+			hasher.add(material->lightmap.texcoord);
+			hasher.add(material->specularModel);
+			hasher.add(material->specularShininess);
+			hasher.add(material->specularTransmittanceKeyed);
+			hasher.add(material->refractionIndex);
+		}
+	}
+	return hasher.final();
+}
+
+static RRHash getLightHash(const RRLight* light)
+{
+	DependencyHasher hasher;
+	hasher.add(light->type);
+	hasher.add(light->position);
+	hasher.add(light->direction);
+	hasher.add(light->outerAngleRad);
+	hasher.add(light->fallOffAngleRad);
+	hasher.add(light->radius);
+	hasher.add(light->color);
+	hasher.add(light->distanceAttenuationType);
+	hasher.add(light->polynom);
+	hasher.add(light->fallOffExponent);
+	hasher.add(light->spotExponent);
+	hasher.add(light->castShadows);
+	hasher.add(light->directLambertScaled);
+	hasher.add(light->projectedTexture);
+	if (light->isAreaLight())
+	{
+		// added only for area lights, so that hashes of older point lights don't change
+		hasher.add(light->areaType);
+		hasher.add(light->areaSize);
+		hasher.add(light->angularDiameterRad);
+	}
+	return hasher.final();
+}
+
+static RRReal getDistance(const RRVec3& mini1, const RRVec3& maxi1, const RRVec3& mini2, const RRVec3& maxi2)
+{
+	RRVec3 gap(
+		RR_MAX3(0,mini1.x-maxi2.x,mini2.x-maxi1.x),
+		RR_MAX3(0,mini1.y-maxi2.y,mini2.y-maxi1.y),
+		RR_MAX3(0,mini1.z-maxi2.z,mini2.z-maxi1.z));
+	return gap.length();
+}
+
+void RRSolver::getLightmapDependencies(const UpdateParameters* _params, RRHash* _hashes, RRVector<unsigned>* _influencers) const
+{
+	if (!_hashes)
+	{
+		RR_ASSERT(0);
+		return;
+	}
+	UpdateParameters params;
+	if (_params) params = *_params;
+
+	const RRObjects& objects = getStaticObjects();
+	const RRLights& lights = getLights();
+	unsigned numObjects = (unsigned)objects.size();
+	unsigned numLights = (unsigned)lights.size();
+
+	// world space AABBs and hashes of objects
+	std::vector<RRVec3> mini(numObjects), maxi(numObjects);
+	std::vector<RRHash> objectHashes(numObjects);
+	RRVec3 sceneMini(FLT_MAX), sceneMaxi(-FLT_MAX);
+	#pragma omp parallel for schedule(dynamic)
+	for (int i=0;i<(int)numObjects;i++)
+	{
+		const RRObject* object = objects[i];
+		RRVec3 localMini, localMaxi;
+		object->getCollider()->getMesh()->getAABB(&localMini,&localMaxi,nullptr);
+		const RRMatrix3x4Ex* world = object->getWorldMatrix();
+		mini[i] = RRVec3(FLT_MAX);
+		maxi[i] = RRVec3(-FLT_MAX);
+		for (unsigned c=0;c<8;c++)
+		{
+			RRVec3 corner((c&1)?localMaxi.x:localMini.x,(c&2)?localMaxi.y:localMini.y,(c&4)?localMaxi.z:localMini.z);
+			if (world)
+				corner = world->getTransformedPosition(corner);
+			for (unsigned a=0;a<3;a++)
+			{
+				mini[i][a] = RR_MIN(mini[i][a],corner[a]);
+				maxi[i][a] = RR_MAX(maxi[i][a],corner[a]);
+			}
+		}
+		objectHashes[i] = getObjectHash(object);
+	}
+	for (unsigned i=0;i<numObjects;i++)
+	{
+		for (unsigned a=0;a<3;a++)
+		{
+			sceneMini[a] = RR_MIN(sceneMini[a],mini[i][a]);
+			sceneMaxi[a] = RR_MAX(sceneMaxi[a],maxi[i][a]);
+		}
+	}
+	RRReal sceneSize = numObjects ? (sceneMaxi-sceneMini).length() : 0;
+
+	// reach of lights, infinite for lights without range
+	bool indirectEnabled = params.indirect.lightMultiplier!=0 && params.quality;
+	std::vector<RRHash> lightHashes(numLights);
+	std::vector<RRVec3> lightMini(numLights), lightMaxi(numLights);
+	std::vector<bool> lightEnabled(numLights);
+	for (unsigned l=0;l<numLights;l++)
+	{
+		const RRLight* light = lights[l];
+		lightEnabled[l] = light && light->enabled && light->color!=RRVec3(0) && (params.direct.lightMultiplier || params.indirect.lightMultiplier);
+		if (!lightEnabled[l])
+			continue;
+		lightHashes[l] = getLightHash(light);
+		if (light->type!=RRLight::DIRECTIONAL && light->distanceAttenuationType==RRLight::EXPONENTIAL)
+		{
+			lightMini[l] = light->position-RRVec3(light->radius+light->getAreaRadius());
+			lightMaxi[l] = light->position+RRVec3(light->radius+light->getAreaRadius());
+		}
+		else
+		{
+			lightMini[l] = RRVec3(-FLT_MAX);
+			lightMaxi[l] = RRVec3(FLT_MAX);
+		}
+	}
+
+	// global inputs shared by all objects
+	DependencyHasher globalHasher;
+	globalHasher.add(params.direct);
+	globalHasher.add(params.indirect);
+	globalHasher.add(params.quality);
+	globalHasher.add(params.qualityFactorRadiosity);
+	globalHasher.add(params.useBumpMaps);
+	globalHasher.add(params.useTextureMipmaps);
+	globalHasher.add(params.aoIntensity);
+	globalHasher.add(params.aoSize);
+	globalHasher.add(params.insideObjectsThreshold);
+	globalHasher.add(params.rugDistance);
+	globalHasher.add(params.locality);
+	globalHasher.add((bool)params.measure_internal.scaled); // bitfield, padding bits are undefined
+	if (params.lightSamples || params.randomSeed)
+	{
+		// added only when set, so that older hashes don't change
+		globalHasher.add(params.lightSamples);
+		globalHasher.add(params.randomSeed);
+	}
+	if (params.lightCutoffIrradiance>0) // negative only disables culling, results are the same as with 0
+		globalHasher.add(params.lightCutoffIrradiance);
+	if (params.direct.environmentMultiplier || params.indirect.environmentMultiplier)
+	{
+		globalHasher.add(getEnvironment(0));
+		globalHasher.add(getEnvironment(1));
+		globalHasher.add(getEnvironmentBlendFactor());
+	}
+	RRHash globalHash = globalHasher.final();
+
+	// combine dependencies of each object
+	RRReal locality = params.locality;
+	#pragma omp parallel for schedule(dynamic)
+	for (int i=0;i<(int)numObjects;i++)
+	{
+		std::vector<unsigned> relevantLights;
+		DependencyHasher hasher;
+		hasher.add(globalHash.value);
+		hasher.add(objectHashes[i].value);
+		if (_influencers)
+			_influencers[i].clear();
+		for (unsigned l=0;l<numLights;l++)
+		{
+			if (!lightEnabled[l])
+				continue;
+			RRReal distance = getDistance(mini[i],maxi[i],lightMini[l],lightMaxi[l]);
+			if (distance==0 || (indirectEnabled && distance<=locality))
+			{
+				relevantLights.push_back(l);
+				hasher.add(lightHashes[l].value);
+				if (_influencers)
+					_influencers[i].push_back(numObjects+l);
+			}
+		}
+		for (unsigned j=0;j<numObjects;j++)
+		{
+			if (j==(unsigned)i)
+				continue;
+			bool relevant = getDistance(mini[i],maxi[i],mini[j],maxi[j])<=locality;
+			for (unsigned k=0;!relevant && k<relevantLights.size();k++)
+			{
+				// j can cast shadow on i if it intersects box spanning i and light source
+				const RRLight* light = lights[relevantLights[k]];
+				if (!light->castShadows)
+					continue;
+				RRVec3 shadowMini = mini[i];
+				RRVec3 shadowMaxi = maxi[i];
+				RRVec3 source = (light->type==RRLight::DIRECTIONAL) ? (mini[i]+maxi[i])/2-light->direction*sceneSize : light->position;
+				RRVec3 sourceExtent = (light->type==RRLight::DIRECTIONAL) ? (maxi[i]-mini[i])/2+RRVec3(sceneSize*tan(light->angularDiameterRad/2)) : RRVec3(light->getAreaRadius());
+				for (unsigned a=0;a<3;a++)
+				{
+					shadowMini[a] = RR_MIN(shadowMini[a],source[a]-sourceExtent[a]);
+					shadowMaxi[a] = RR_MAX(shadowMaxi[a],source[a]+sourceExtent[a]);
+				}
+				relevant = getDistance(shadowMini,shadowMaxi,mini[j],maxi[j])==0;
+			}
+			if (relevant)
+			{
+				hasher.add(objectHashes[j].value);
+				if (_influencers)
+					_influencers[i].push_back(j);
+			}
+		}
+		_hashes[i] = hasher.final();
+	}
+}
+
+} // namespace
@@ -10,21 +10,14 @@
 #ifndef PRIVATE_H
 #define PRIVATE_H
 
+#include <mutex>
 #include <vector>
 #include "../RRStaticSolver/RRStaticSolver.h"
 #include "../RRPackedSolver/RRPackedSolver.h"
 
 namespace rr
 {
-	class CubeGatheringKit
-	{
-	public:
-		bool inUse;
-		RRRay* ray6;
-		class ReflectionCubeCollisionHandler* handler6;
-		CubeGatheringKit();
-		~CubeGatheringKit();
-	};
+	class LightEvaluators;
 
 	struct RRSolver::Private
 	{
@@ -63,6 +56,22 @@ namespace rr
 		float      environmentBlendFactor;
 		const unsigned* customIrradianceRGBA8; // nullptr or array of getMultiObject()->getCollider()->getMesh()->getNumTriangles() elements
 
+		// PathtracerJob: data shared by jobs, kept between jobs
+		std::mutex jobMutex;
+		unsigned   numJobs; // jobs alive, data they use must not be deleted
+		LightEvaluators* lightEvaluators; // evaluators of lights, created on demand, replaced when lights change
+		std::vector<LightEvaluators*> retiredLightEvaluators; // replaced while jobs were alive, deleted when the last job ends
+		RRBuffer*  environmentBlend; // blend of rotated environments, created on demand, replaced when environments change
+		std::vector<RRBuffer*> retiredEnvironmentBlends; // replaced while jobs were alive, deleted when the last job ends
+
+		// detectDirectIlluminationCPU: cache of per-light results, so that only dirty lights are recalculated
+		const RRObject* ddiMultiObject; // multiObject that cached results belong to
+		std::vector<const RRLight*> ddiLights; // lights that cached results belong to
+		std::vector<std::vector<RRVec3> > ddiIrradiancePhysical; // per light, per triangle
+		std::vector<char> ddiDirty; // per light
+		std::vector<char> ddiEnabled; // per light, enabled flags used in ddiIrradianceRGBA8
+		std::vector<unsigned> ddiIrradianceRGBA8; // sum of enabled lights, passed to setDirectIllumination()
+
 		// scale: inputs
 		const RRColorSpace*  colorSpace;
 		RRReal     lightMultiplier;
@@ -93,7 +102,6 @@ namespace rr
 		struct TriangleVertexPair {unsigned triangleIndex:30;unsigned vertex012:2;TriangleVertexPair(unsigned _triangleIndex,unsigned _vertex012):triangleIndex(_triangleIndex),vertex012(_vertex012){}}; // packed as 30+2 bits is much faster than 32+32 bits
 		std::vector<std::vector<TriangleVertexPair> > postVertex2PostTriangleVertex; ///< readResults lookup table for RRSolver. indexed by objectNumber. depends on static objects, must be updated when they change
 		std::vector<std::vector<const RRVec3*> > postVertex2Ivertex; ///< readResults lookup table for RRPackedSolver. indexed by 1+objectNumber, 0 is multiObject. depends on static objects and packed solver, must be updated when they change
-		CubeGatheringKit cubeGatheringKits[10];
 
 		Private()
 		{
@@ -113,6 +121,10 @@ namespace rr
 			superColliderMeshVersion = 0;
 			// lights
 			customIrradianceRGBA8 = nullptr;
+			numJobs = 0;
+			lightEvaluators = nullptr;
+			environmentBlend = nullptr;
+			ddiMultiObject = nullptr;
 
 			// scale: inputs
 			colorSpace = nullptr;
@@ -147,11 +159,21 @@ namespace rr
 		~Private()
 		{
 			deleteScene();
+			retireLightEvaluators();
+			retireEnvironmentBlend();
 
 			// [#23] inc/dec refcount of environments entering/leaving solver
 			RR_SAFE_DELETE(environment0);
 			RR_SAFE_DELETE(environment1);
 		}
+		// Called by PathtracerJob constructor, returns evaluators of current lights and blend of current environments.
+		// Creates them if necessary, so that const solver can be used by jobs.
+		void startJob(const LightEvaluators*& lightEvaluators, const RRBuffer*& environment);
+		// Called by PathtracerJob destructor.
+		void endJob();
+		// Delete lightEvaluators or environmentBlend, or postpone deletion until the last job ends. Caller locks jobMutex.
+		void retireLightEvaluators();
+		void retireEnvironmentBlend();
 		void deleteScene()
 		{
 			RR_SAFE_DELETE(packedSolver);
@@ -7,7 +7,10 @@
 // Offline and realtime per-vertex lightmaps.
 // --------------------------------------------------------------------------
 
+#include <algorithm>
 #include <cfloat>
+#include <unordered_set>
+#include <vector>
 #include "Lightsprint/RRSolver.h"
 #include "report.h"
 #include "private.h"
@@ -17,6 +20,12 @@
 namespace rr
 {
 
+enum
+{
+	TABLE_BLOCK_TRIANGLES = 65536, // lookup tables are filled in blocks, preimport numbers of block are calculated in parallel
+	UPDATE_CHUNK_VERTICES = 4096, // flattened range of all updated vertex buffers is split to chunks of this size
+};
+
 void RRSolver::updateVertexLookupTableDynamicSolver()
 // prepare lookup tables postImportVertex -> [postImportTriangle,vertex012] for all objects
 // depends on static objects (needs update when they change)
@@ -41,37 +50,53 @@ void RRSolver::updateVertexLookupTableDynamicSolver()
 		priv->postVertex2PostTriangleVertex[objectHandle].resize(numPostImportSingleVertices,Private::TriangleVertexPair(RRMesh::UNDEFINED,RRMesh::UNDEFINED));
 	}
 	// fill table
+	// slow getPreImportVertex() runs in parallel, writes are serial in triangle order,
+	// so vertex shared by more triangles ends up with the same (last) triangle as in serial loop
 	const RRMesh* multiMesh = getMultiObject()->getCollider()->getMesh();
 	unsigned numPostImportMultiVertices = multiMesh->getNumVertices();
 	unsigned numPostImportMultiTriangles = multiMesh->getNumTriangles();
-	for (unsigned postImportMultiTriangle=0;postImportMultiTriangle<numPostImportMultiTriangles;postImportMultiTriangle++)
+	std::vector<RRMesh::PreImportNumber> postVerticesMulti(3*RR_MIN(numPostImportMultiTriangles,(unsigned)TABLE_BLOCK_TRIANGLES));
+	for (unsigned blockStart=0;blockStart<numPostImportMultiTriangles;blockStart+=TABLE_BLOCK_TRIANGLES)
 	{
-		RRMesh::Triangle postImportMultiTriangleVertices;
-		multiMesh->getTriangle(postImportMultiTriangle,postImportMultiTriangleVertices);
-		for (unsigned v=0;v<3;v++)
+		unsigned blockSize = RR_MIN(numPostImportMultiTriangles-blockStart,(unsigned)TABLE_BLOCK_TRIANGLES);
+		#pragma omp parallel for schedule(static)
+		for (int i=0;i<(int)blockSize;i++)
 		{
-			unsigned postImportMultiVertex = postImportMultiTriangleVertices[v];
-			if (postImportMultiVertex<numPostImportMultiVertices)
+			unsigned postImportMultiTriangle = blockStart+i;
+			RRMesh::Triangle postImportMultiTriangleVertices;
+			multiMesh->getTriangle(postImportMultiTriangle,postImportMultiTriangleVertices);
+			for (unsigned v=0;v<3;v++)
 			{
-				RRMesh::PreImportNumber postVertexMulti =
-					//!!! here we calculate preimport data
-					//    for postimport 1obj data, multiobj would have to remove preimport numbering
-					multiMesh->getPreImportVertex(postImportMultiVertex,postImportMultiTriangle);
-				if (priv->scene && !priv->scene->scene->object->triangle[postImportMultiTriangle].topivertex[v])
+				unsigned postImportMultiVertex = postImportMultiTriangleVertices[v];
+				RRMesh::PreImportNumber& postVertexMulti = postVerticesMulti[3*i+v];
+				postVertexMulti = RRMesh::PreImportNumber(RRMesh::UNDEFINED,RRMesh::UNDEFINED);
+				if (postImportMultiVertex<numPostImportMultiVertices)
 				{
-					// static solver doesn't like this triangle and set surface nullptr, probably because it is a needle
-					// let it UNDEFINED
+					if (priv->scene && !priv->scene->scene->object->triangle[postImportMultiTriangle].topivertex[v])
+					{
+						// static solver doesn't like this triangle and set surface nullptr, probably because it is a needle
+						// let it UNDEFINED
+					}
+					else
+					{
+						postVertexMulti =
+							//!!! here we calculate preimport data
+							//    for postimport 1obj data, multiobj would have to remove preimport numbering
+							multiMesh->getPreImportVertex(postImportMultiVertex,postImportMultiTriangle);
+					}
 				}
 				else
 				{
-					priv->postVertex2PostTriangleVertex[postVertexMulti.object][postVertexMulti.index] = Private::TriangleVertexPair(postImportMultiTriangle,v);
+					// should not get here. let it UNDEFINED
+					RR_ASSERT(0);
 				}
 			}
-			else
-			{
-				// should not get here. let it UNDEFINED
-				RR_ASSERT(0);
-			}
+		}
+		for (unsigned i=0;i<3*blockSize;i++)
+		{
+			const RRMesh::PreImportNumber& postVertexMulti = postVerticesMulti[i];
+			if (postVertexMulti.object<priv->postVertex2PostTriangleVertex.size())
+				priv->postVertex2PostTriangleVertex[postVertexMulti.object][postVertexMulti.index] = Private::TriangleVertexPair(blockStart+i/3,i%3);
 		}
 	}
 }
@@ -105,32 +130,55 @@ void RRSolver::updateVertexLookupTablePackedSolver()
 	}
 	
 	// fill tables
-	for (unsigned postImportMultiTriangle=0;postImportMultiTriangle<numPostImportMultiTriangles;postImportMultiTriangle++)
+	// slow lookups run in parallel, writes are serial in triangle order (as in updateVertexLookupTableDynamicSolver)
+	struct Ivertex
+	{
+		unsigned postImportMultiVertex;
+		RRMesh::PreImportNumber postVertexMulti;
+		const RRVec3* irrad;
+	};
+	std::vector<Ivertex> ivertices(3*RR_MIN(numPostImportMultiTriangles,(unsigned)TABLE_BLOCK_TRIANGLES));
+	for (unsigned blockStart=0;blockStart<numPostImportMultiTriangles;blockStart+=TABLE_BLOCK_TRIANGLES)
 	{
-		RRMesh::Triangle postImportMultiTriangleVertices;
-		multiMesh->getTriangle(postImportMultiTriangle,postImportMultiTriangleVertices);
-		for (unsigned v=0;v<3;v++)
+		unsigned blockSize = RR_MIN(numPostImportMultiTriangles-blockStart,(unsigned)TABLE_BLOCK_TRIANGLES);
+		#pragma omp parallel for schedule(static)
+		for (int i=0;i<(int)blockSize;i++)
 		{
-			unsigned postImportMultiVertex = postImportMultiTriangleVertices[v];
-			if (postImportMultiVertex<numPostImportMultiVertices)
+			unsigned postImportMultiTriangle = blockStart+i;
+			RRMesh::Triangle postImportMultiTriangleVertices;
+			multiMesh->getTriangle(postImportMultiTriangle,postImportMultiTriangleVertices);
+			for (unsigned v=0;v<3;v++)
 			{
-				const RRVec3* irrad = priv->packedSolver->getTriangleIrradianceIndirect(postImportMultiTriangle,v);
-				if (irrad)
+				Ivertex& ivertex = ivertices[3*i+v];
+				ivertex.postImportMultiVertex = postImportMultiTriangleVertices[v];
+				ivertex.irrad = nullptr;
+				if (ivertex.postImportMultiVertex<numPostImportMultiVertices)
 				{
-					// for multiobject
-					priv->postVertex2Ivertex[0][postImportMultiVertex] = irrad; // [multiobj indir is indexed]
-					// for singleobjects
-					RRMesh::PreImportNumber postVertexMulti =
-						//!!! here we calculate preimport data
-						//    for postimport 1obj data, multiobj has to remove preimport numbering from 1objs
-						multiMesh->getPreImportVertex(postImportMultiVertex,postImportMultiTriangle);
-					priv->postVertex2Ivertex[1+postVertexMulti.object][postVertexMulti.index] = irrad;
+					ivertex.irrad = priv->packedSolver->getTriangleIrradianceIndirect(postImportMultiTriangle,v);
+					if (ivertex.irrad)
+					{
+						ivertex.postVertexMulti =
+							//!!! here we calculate preimport data
+							//    for postimport 1obj data, multiobj has to remove preimport numbering from 1objs
+							multiMesh->getPreImportVertex(ivertex.postImportMultiVertex,postImportMultiTriangle);
+					}
+				}
+				else
+				{
+					// should not get here. let it pink
+					RR_ASSERT(0);
 				}
 			}
-			else
+		}
+		for (unsigned i=0;i<3*blockSize;i++)
+		{
+			const Ivertex& ivertex = ivertices[i];
+			if (ivertex.irrad)
 			{
-				// should not get here. let it pink
-				RR_ASSERT(0);
+				// for multiobject
+				priv->postVertex2Ivertex[0][ivertex.postImportMultiVertex] = ivertex.irrad; // [multiobj indir is indexed]
+				// for singleobjects
+				priv->postVertex2Ivertex[1+ivertex.postVertexMulti.object][ivertex.postVertexMulti.index] = ivertex.irrad;
 			}
 		}
 	}
@@ -165,55 +213,71 @@ void RRSolver::updateVertexLookupTablePackedSolver()
 //!  For higher quality final gathered results, use updateLightmaps().
 unsigned RRSolver::updateVertexBufferFromSolver(int objectNumber, RRBuffer* vertexBuffer, const UpdateParameters* params)
 {
-	if (objectNumber<10 || (objectNumber<100 && !(objectNumber%10)) || (objectNumber<1000 && !(objectNumber%100)) || !(objectNumber%1000))
-		RRReporter::report(INF3,"Updating vertex buffer for object %d/%" RR_SIZE_T "d.\n",objectNumber,getStaticObjects().size());
+	return updateVertexBuffersFromSolver(1,&objectNumber,&vertexBuffer,params);
+}
 
-	if (!vertexBuffer || objectNumber>=(int)getStaticObjects().size() || objectNumber<-1)
+// Updates vertex buffers of many objects at once, see updateVertexBufferFromSolver().
+// All vertices of all buffers form single flattened range that is processed in parallel,
+// so scenes with thousands of small objects are updated in parallel too.
+// When the same buffer is passed more times, only its last occurrence is updated.
+unsigned RRSolver::updateVertexBuffersFromSolver(unsigned numBuffers, const int* objectNumbers, RRBuffer* const* vertexBuffers, const UpdateParameters* params)
+{
+	struct Job
 	{
-		RR_ASSERT(0);
-		return 0;
-	}
-	unsigned numPostImportVertices = (objectNumber>=0)
-		? getStaticObjects()[objectNumber]->getCollider()->getMesh()->getNumVertices() // elements in 1object vertex buffer
-		: getMultiObject()->getCollider()->getMesh()->getNumVertices(); // elements in multiobject vertex buffer [multiobj indir is indexed]
-	if (vertexBuffer->getType()!=BT_VERTEX_BUFFER || vertexBuffer->getWidth()<numPostImportVertices)
+		int objectNumber;
+		RRBuffer* vertexBuffer;
+		unsigned firstVertex; // position of buffer in flattened range
+		unsigned numVertices;
+		RRVec3* lock;
+		RRRadiometricMeasure measure;
+	};
+	std::vector<Job> jobs;
+	unsigned updatedBuffers = 0;
+	for (unsigned i=0;i<numBuffers;i++)
 	{
-		RR_ASSERT(0);
-		return 0;
-	}
+		int objectNumber = objectNumbers[i];
+		RRBuffer* vertexBuffer = vertexBuffers[i];
+		if (objectNumber<10 || (objectNumber<100 && !(objectNumber%10)) || (objectNumber<1000 && !(objectNumber%100)) || !(objectNumber%1000))
+			RRReporter::report(INF3,"Updating vertex buffer for object %d/%" RR_SIZE_T "d.\n",objectNumber,getStaticObjects().size());
 
-	// packed solver
-	if (priv->packedSolver)
-	{
-		RR_ASSERT(priv->postVertex2Ivertex.size()==1+getStaticObjects().size());
-		priv->packedSolver->getTriangleIrradianceIndirectUpdate();
-		const std::vector<const RRVec3*>& postVertex2Ivertex = priv->postVertex2Ivertex[1+objectNumber];
-		RR_ASSERT(postVertex2Ivertex.size()==numPostImportVertices); // [multiobj indir is indexed]
-		RRVec3* lock = vertexBuffer->getFormat()==BF_RGBF ? (RRVec3*)(vertexBuffer->lock(BL_DISCARD_AND_WRITE)) : nullptr;
-		if (lock)
+		if (!vertexBuffer || objectNumber>=(int)getStaticObjects().size() || objectNumber<-1)
 		{
-			#pragma omp parallel for schedule(static) if(numPostImportVertices>RR_OMP_MIN_ELEMENTS)
-			for (int postImportVertex=0;(unsigned)postImportVertex<numPostImportVertices;postImportVertex++)
-			{
-				lock[postImportVertex] = *postVertex2Ivertex[postImportVertex];
-			}
-			vertexBuffer->unlock();
+			RR_ASSERT(0);
+			continue;
 		}
-		else
+		unsigned numPostImportVertices = (objectNumber>=0)
+			? getStaticObjects()[objectNumber]->getCollider()->getMesh()->getNumVertices() // elements in 1object vertex buffer
+			: getMultiObject()->getCollider()->getMesh()->getNumVertices(); // elements in multiobject vertex buffer [multiobj indir is indexed]
+		if (vertexBuffer->getType()!=BT_VERTEX_BUFFER || vertexBuffer->getWidth()<numPostImportVertices)
 		{
-			for (int postImportVertex=0;(unsigned)postImportVertex<numPostImportVertices;postImportVertex++)
-			{
-				RRVec4 tmp;
-				tmp = *postVertex2Ivertex[postImportVertex];
-				vertexBuffer->setElement(postImportVertex,tmp,nullptr);
-			}
+			RR_ASSERT(0);
+			continue;
 		}
-		vertexBuffer->version = getSolutionVersion();
-		return 1;
+		Job job;
+		job.objectNumber = objectNumber;
+		job.vertexBuffer = vertexBuffer;
+		job.firstVertex = 0;
+		job.numVertices = numPostImportVertices;
+		job.lock = nullptr;
+		jobs.push_back(job);
+		updatedBuffers++;
 	}
 
+	// buffer updated more times would be written concurrently, keep only its last update
+	if (jobs.size()>1)
+	{
+		std::unordered_set<RRBuffer*> laterBuffers;
+		unsigned numUnique = 0;
+		for (unsigned i=(unsigned)jobs.size();i--;)
+			if (laterBuffers.insert(jobs[i].vertexBuffer).second)
+				jobs[jobs.size()-1-numUnique++] = jobs[i];
+		jobs.erase(jobs.begin(),jobs.end()-numUnique);
+	}
+	if (jobs.empty())
+		return 0;
+
 	// dynamic solver
-	if (!priv->scene)
+	if (!priv->packedSolver && !priv->scene)
 	{
 		calculateCore(0,&priv->previousCalculateParameters); // create missing solver
 		if (!priv->scene)
@@ -223,32 +287,88 @@ unsigned RRSolver::updateVertexBufferFromSolver(int objectNumber, RRBuffer* vert
 			return 0;
 		}
 	}
-	RRRadiometricMeasure measure = params ? params->measure_internal : RM_IRRADIANCE_CUSTOM_INDIRECT;
-	measure.scaled = vertexBuffer->getScaled();
+
+	if (priv->packedSolver)
+		priv->packedSolver->getTriangleIrradianceIndirectUpdate();
+
+	// prepare flattened range (prefix sum of vertex counts)
+	unsigned numVertices = 0;
+	for (unsigned i=0;i<jobs.size();i++)
+	{
+		Job& job = jobs[i];
+		job.firstVertex = numVertices;
+		numVertices += job.numVertices;
+		if (priv->packedSolver)
+		{
+			RR_ASSERT(priv->postVertex2Ivertex.size()==1+getStaticObjects().size());
+			RR_ASSERT(priv->postVertex2Ivertex[1+job.objectNumber].size()==job.numVertices); // [multiobj indir is indexed]
+			job.lock = job.vertexBuffer->getFormat()==BF_RGBF ? (RRVec3*)(job.vertexBuffer->lock(BL_DISCARD_AND_WRITE)) : nullptr;
+		}
+		else
+		{
+			job.measure = params ? params->measure_internal : RM_IRRADIANCE_CUSTOM_INDIRECT;
+			job.measure.scaled = job.vertexBuffer->getScaled();
+		}
+	}
 
 	// load measure into each preImportVertex
-	#pragma omp parallel for schedule(static) if(numPostImportVertices>RR_OMP_MIN_ELEMENTS)
-	for (int postImportVertex=0;(unsigned)postImportVertex<numPostImportVertices;postImportVertex++)
+	unsigned numChunks = (numVertices+UPDATE_CHUNK_VERTICES-1)/UPDATE_CHUNK_VERTICES;
+	#pragma omp parallel for schedule(dynamic) if(numVertices>RR_OMP_MIN_ELEMENTS)
+	for (int chunk=0;chunk<(int)numChunks;chunk++)
 	{
-		unsigned t = (objectNumber<0)?postImportVertex/3:priv->postVertex2PostTriangleVertex[objectNumber][postImportVertex].triangleIndex;
-		unsigned v = (objectNumber<0)?postImportVertex%3:priv->postVertex2PostTriangleVertex[objectNumber][postImportVertex].vertex012;
-		RRVec4 indirect = RRVec4(0);
-		if (t<0x3fffffff) // UNDEFINED clamped to 30bit
+		unsigned chunkBegin = chunk*UPDATE_CHUNK_VERTICES;
+		unsigned chunkEnd = RR_MIN(chunkBegin+UPDATE_CHUNK_VERTICES,numVertices);
+		// find first job in chunk, then walk jobs until chunk ends
+		unsigned jobIndex = (unsigned)(std::upper_bound(jobs.begin(),jobs.end(),chunkBegin,[](unsigned vertex, const Job& job) {return vertex<job.firstVertex;})-jobs.begin())-1;
+		for (unsigned vertex=chunkBegin;vertex<chunkEnd;jobIndex++)
 		{
-			priv->scene->getTriangleMeasure(t,v,measure,priv->colorSpace,indirect);
-			// make it optional when negative values are supported
-			//for (unsigned i=0;i<3;i++)
-			//	indirect[i] = RR_MAX(0,indirect[i]);
-			for (unsigned i=0;i<3;i++)
+			const Job& job = jobs[jobIndex];
+			unsigned jobEnd = RR_MIN(job.firstVertex+job.numVertices,chunkEnd);
+			if (priv->packedSolver)
 			{
-				RR_ASSERT(std::isfinite(indirect[i]));
-				RR_ASSERT(indirect[i]<1500000);
+				const std::vector<const RRVec3*>& postVertex2Ivertex = priv->postVertex2Ivertex[1+job.objectNumber];
+				for (;vertex<jobEnd;vertex++)
+				{
+					unsigned postImportVertex = vertex-job.firstVertex;
+					if (job.lock)
+						job.lock[postImportVertex] = *postVertex2Ivertex[postImportVertex];
+					else
+						job.vertexBuffer->setElement(postImportVertex,RRVec4(*postVertex2Ivertex[postImportVertex],0),nullptr);
+				}
+			}
+			else
+			{
+				for (;vertex<jobEnd;vertex++)
+				{
+					unsigned postImportVertex = vertex-job.firstVertex;
+					unsigned t = (job.objectNumber<0)?postImportVertex/3:priv->postVertex2PostTriangleVertex[job.objectNumber][postImportVertex].triangleIndex;
+					unsigned v = (job.objectNumber<0)?postImportVertex%3:priv->postVertex2PostTriangleVertex[job.objectNumber][postImportVertex].vertex012;
+					RRVec4 indirect = RRVec4(0);
+					if (t<0x3fffffff) // UNDEFINED clamped to 30bit
+					{
+						priv->scene->getTriangleMeasure(t,v,job.measure,priv->colorSpace,indirect);
+						// make it optional when negative values are supported
+						//for (unsigned i=0;i<3;i++)
+						//	indirect[i] = RR_MAX(0,indirect[i]);
+						for (unsigned i=0;i<3;i++)
+						{
+							RR_ASSERT(std::isfinite(indirect[i]));
+							RR_ASSERT(indirect[i]<1500000);
+						}
+					}
+					job.vertexBuffer->setElement(postImportVertex,indirect,nullptr);
+				}
 			}
 		}
-		vertexBuffer->setElement(postImportVertex,indirect,nullptr);
 	}
-	vertexBuffer->version = getSolutionVersion();
-	return 1;
+
+	for (unsigned i=0;i<jobs.size();i++)
+	{
+		if (jobs[i].lock)
+			jobs[i].vertexBuffer->unlock();
+		jobs[i].vertexBuffer->version = getSolutionVersion();
+	}
+	return updatedBuffers;
 }
 
 // Converts data from input array [post import triangles of whole scene]
@@ -11,6 +11,7 @@
 #include "pathtracer.h"
 #include "rrcore.h"
 #include "../RRSolver/private.h"
+#include "../RRLightPrivate.h"
 
 namespace rr
 {
@@ -26,13 +27,11 @@ PathtracerJob::PathtracerJob(const RRSolver* _solver, bool _dynamic)
 {
 	solver = _solver;
 	colorSpace = solver ? solver->getColorSpace() : nullptr;
-	RRReal angleRad0 = 0;
-	RRReal angleRad1 = 0;
-	RRReal blendFactor = solver ? solver->getEnvironmentBlendFactor() : 0;
-	RRBuffer* environment0 = solver ? solver->getEnvironment(0,&angleRad0) : nullptr;
-	RRBuffer* environment1 = solver ? solver->getEnvironment(1,&angleRad1) : nullptr;
-	environment = RRBuffer::createEnvironmentBlend(environment0,environment1,angleRad0,angleRad1,blendFactor);
+	environment = nullptr;
 	collider = solver ? ( _dynamic ? solver->getCollider() : solver->getMultiObject()->getCollider() ) : nullptr;
+	lightEvaluators = nullptr;
+	if (solver)
+		solver->priv->startJob(lightEvaluators,environment);
 
 #ifdef MATERIAL_BACKGROUND_HACK
 	environmentAveragePhysical = RRVec3(0);
@@ -50,7 +49,8 @@ PathtracerJob::PathtracerJob(const RRSolver* _solver, bool _dynamic)
 
 PathtracerJob::~PathtracerJob()
 {
-	delete environment;
+	if (solver)
+		solver->priv->endJob();
 }
 
 
@@ -272,6 +272,14 @@ RRVec3 PathtracerWorker::getIncidentRadiance(const RRVec3& eye, const RRVec3& di
 				RRLight* light = (*lights)[i];
 				if (light->enabled)
 				{
+					const LightEvaluator* lightEvaluator = (*ptj.lightEvaluators)[i];
+					RRVec3 unobstructedLight;
+					if (light->isAreaLight())
+					{
+						// random point on light, many paths per pixel make soft shadow
+						unobstructedLight = lightEvaluator->getIrradianceSample(shadowRay.rayOrigin,RRVec2(RR_RAND01,RR_RAND01),shadowRay.rayDir,shadowRay.rayLengthMax);
+					}
+					else
 					if (light->type==RRLight::DIRECTIONAL)
 					{
 						shadowRay.rayDir = -light->direction;
@@ -285,7 +293,8 @@ RRVec3 PathtracerWorker::getIncidentRadiance(const RRVec3& eye, const RRVec3& di
 					if (pixelNormal.dot(shadowRay.rayDir)>0 && faceNormal.dot(shadowRay.rayDir)>0) // bad normalmap -> some rays are terminated here
 					{
 						collisionHandlerGatherLights.setLight(light,nullptr);
-						RRVec3 unobstructedLight = light->getIrradiance(shadowRay.rayOrigin,ptj.colorSpace);
+						if (!light->isAreaLight())
+							unobstructedLight = lightEvaluator->getIrradiance(shadowRay.rayOrigin);
 						response.dirIn = -shadowRay.rayDir;
 						material.getResponse(response,parameters.brdfTypes);
 						RRVec3 totalContribution = unobstructedLight * response.colorOut;
@@ -23,6 +23,8 @@ COLLISION_LOG(#include <sstream>)
 namespace rr
 {
 
+class LightEvaluators;
+
 
 //////////////////////////////////////////////////////////////////////////////
 //
@@ -44,6 +46,7 @@ public:
 		qualityForPointMaterials = _qualityForPointMaterials;
 		qualityForInterpolation = _qualityForInterpolation;
 		staticSceneContainsLods = _staticSceneContainsLods;
+		rayConeSpread = 0;
 		shooterObject = nullptr;
 		shooterTriangleIndex = UINT_MAX; // set manually before intersect
 
@@ -70,6 +73,14 @@ public:
 		}
 	}
 
+	//! Sets angle (in radians) covered by single ray, point materials are then sampled from mipmaps of matching resolution.
+	//
+	//! 0 = sample textures in full resolution.
+	void setRayCone(RRReal _spreadAngle)
+	{
+		rayConeSpread = _spreadAngle;
+	}
+
 	//! Configures handler for gathering illumination from hemisphere (collides when hitSide has renderFrom).
 	//
 	//! When _staticSolver is set, handler finds closest receiver for given emitor.
@@ -194,6 +205,7 @@ public:
 			if (qualityForPointMaterials>triangleMaterial->minimalQualityForPointMaterials)
 			{
 				unsigned pmi = (firstContactMaterial==pointMaterial)?1:0; // index into pointMaterial[], one that is not occupied by firstContactMaterial
+				pointMaterial[pmi].rayFootprint = rayConeSpread*ray.hitDistance;
 				hitObject->getPointMaterial(ray.hitTriangle,ray.hitPoint2d,colorSpace,qualityForInterpolation>triangleMaterial->minimalQualityForPointMaterials,pointMaterial[pmi]);
 				if (TEST_BIT(&pointMaterial[pmi]))
 				{
@@ -292,6 +304,7 @@ private:
 	Triangle* triangle; // shortcut, direct access to materials in rrcore
 	const RRMaterial* firstContactMaterial; // when collision is found, contact material is stored here:
 	RRPointMaterial pointMaterial[2]; // helper for storing contact material. one slot for old accepted contact, one slot for new not-yet-accepted contact
+	RRReal rayConeSpread; // angle covered by single ray, 0 = point materials in full resolution
 
 	// gathering light
 	const RRObject* singleObjectReceiver;
@@ -315,8 +328,9 @@ public:
 	
 	const RRSolver* solver;
 	const RRColorSpace* colorSpace;
-	const RRBuffer* environment; // blend of two rotated solver environments
+	const RRBuffer* environment; // blend of two rotated solver environments, owned by solver (so its cache survives between jobs)
 	const RRCollider* collider;
+	const LightEvaluators* lightEvaluators; // evaluators of solver->getLights(), in the same order, owned by solver (reused by following jobs)
 
 #ifdef MATERIAL_BACKGROUND_HACK
 	RRVec3 environmentAveragePhysical;
@@ -360,6 +374,12 @@ public:
 	//!  Current recursion depth.
 	RRVec3 getIncidentRadiance(const RRVec3& eye, const RRVec3& direction, const RRObject* shooterObject, unsigned shooterTriangle, RRVec3 visibility = RRVec3(1), unsigned numBounces = 0);
 
+	//! Sets angle (in radians) covered by single gathered ray, textures hit in distance are then sampled from mipmaps.
+	void setRayCone(RRReal spreadAngle)
+	{
+		collisionHandlerGatherHemisphere.setRayCone(spreadAngle);
+	}
+
 	RRRay ray; // aligned, better keep it first
 protected:
 	const PathtracerJob& ptj;
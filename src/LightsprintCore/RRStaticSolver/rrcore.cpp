@@ -12,6 +12,7 @@
 #include <cstdio>    // printf
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
 #include "rrcore.h"
 #ifdef _OPENMP
 	#include <omp.h>
@@ -64,6 +65,92 @@ void* realloc(void* p,size_t oldsize,size_t newsize)
 
 unsigned  __frameNumber=1; // frame number increased after each draw
 
+//////////////////////////////////////////////////////////////////////////////
+//
+// form factors from all sources
+
+FactorStorage::FactorStorage()
+{
+	factor = nullptr;
+	factorsUsed = 0;
+	factorsAllocated = 0;
+	factorsGarbage = 0;
+}
+
+void FactorStorage::reset()
+{
+	free(factor);
+	factor = nullptr;
+	factorsUsed = 0;
+	factorsAllocated = 0;
+	factorsGarbage = 0;
+}
+
+void FactorStorage::compact(Triangle* triangles, unsigned numTriangles)
+{
+	// sort ranges by position in storage, so that moving them down never overwrites range not yet moved
+	std::vector<unsigned> order;
+	for (unsigned t=0;t<numTriangles;t++)
+		if (triangles[t].factors.num)
+			order.push_back(t);
+	std::sort(order.begin(),order.end(),[triangles](unsigned a, unsigned b) {return triangles[a].factors.first<triangles[b].factors.first;});
+	size_t used = 0;
+	for (unsigned i=0;i<order.size();i++)
+	{
+		FactorRange& range = triangles[order[i]].factors;
+		if (range.first!=used)
+			memmove(factor+used,factor+range.first,range.num*sizeof(Factor));
+		range.first = used;
+		used += range.num;
+	}
+	factorsUsed = used;
+	factorsGarbage = 0;
+}
+
+bool FactorStorage::reserve(unsigned numFactors, Triangle* triangles, unsigned numTriangles)
+{
+	if (factorsUsed+numFactors<=factorsAllocated)
+		return true;
+	// reclaim space taken by replaced factors
+	if (factorsGarbage>factorsUsed/4)
+	{
+		compact(triangles,numTriangles);
+		if (factorsUsed+numFactors<=factorsAllocated)
+			return true;
+	}
+	size_t newAllocated = RR_MAX(RR_MAX(factorsAllocated*2,factorsUsed+numFactors),(size_t)(1000000/sizeof(Factor)));
+	Factor* newFactor = (Factor*)::realloc(factor,newAllocated*sizeof(Factor));
+	if (!newFactor)
+	{
+#if defined(_M_X64) || defined(_LP64)
+		RR_LIMITED_TIMES(1,RRReporter::report(ERRO,"Not enough memory, radiosity job interrupted.\n"));
+#else
+		RR_LIMITED_TIMES(1,RRReporter::report(ERRO,"Out of address space, radiosity job interrupted. Use 64bit version.\n"));
+#endif
+		return false;
+	}
+	factor = newFactor;
+	factorsAllocated = newAllocated;
+	return true;
+}
+
+bool FactorStorage::set(FactorRange& range, const Factor* factors, unsigned numFactors, Triangle* triangles, unsigned numTriangles)
+{
+	if (!reserve(numFactors,triangles,numTriangles))
+		return false;
+	factorsGarbage += range.num;
+	range.first = factorsUsed;
+	range.num = numFactors;
+	memcpy(factor+factorsUsed,factors,numFactors*sizeof(Factor));
+	factorsUsed += numFactors;
+	return true;
+}
+
+FactorStorage::~FactorStorage()
+{
+	free(factor);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // triangle
@@ -515,6 +602,19 @@ BestInfo Reflectors::best(real allEnergyInScene)
 
 #endif // NEW_BEST
 
+BestInfo Reflectors::bestDistributor()
+{
+	if (!bests || bestNode[0].needsRefresh() || !bestNode[0].node->factors.size())
+	{
+		BestInfo result = {nullptr,0};
+		return result;
+	}
+	BestInfo result = bestNode[0];
+	bests--;
+	for (unsigned i=0;i<bests;i++) bestNode[i] = bestNode[i+1];
+	return result;
+}
+
 struct NodeQ 
 {
 	Triangle* node; 
@@ -820,7 +920,7 @@ RRStaticSolver::Improvement Scene::resetStaticIllumination(bool resetFactors, bo
 		for (int t=0;(unsigned)t<object->triangles;t++)
 			object->triangle[t].factors.clear();
 		// deallocate all factors
-		factorAllocator.reset();
+		factorStorage.reset();
 
 		if (!resetPropagation)
 		{
@@ -1009,8 +1109,8 @@ void Scene::shotFromToHalfspace(ShootingKernel* shootingKernel,Triangle* sourceN
 	#ifdef max
 		#undef max
 	#endif
-	constexpr unsigned RMAX = ShootingKernel::rand_t::max();
-	constexpr float INVRMAX = 1. / RMAX;
+	const unsigned RMAX = ShootingKernel::rand_t::max(); // not constexpr, boost::rand48::max() is not constexpr in older boost
+	const float INVRMAX = 1.f / RMAX;
 	#define RAND shootingKernel->rand()
 
 	// select random point in source subtriangle
@@ -1049,12 +1149,13 @@ void Scene::shotFromToHalfspace(ShootingKernel* shootingKernel,Triangle* sourceN
 //
 // distribute energy via one factor
 
-static void distributeEnergyViaFactor(const Factor& factor, Channels energy, Reflectors* staticReflectors)
+// returns true if destination may need to be inserted to reflectors
+static bool distributeEnergyViaFactor(const Factor& factor, Channels energy, Triangle* triangles)
 {
 	RR_ASSERT(IS_VEC3(energy));
 	RR_ASSERT(factor.power>=0);
 
-	Triangle* destination = factor.destination;
+	Triangle* destination = triangles+factor.destination;
 	RR_ASSERT(destination);
 	RR_ASSERT(destination->surface);
 	RR_ASSERT(IS_VEC3(destination->totalIncidentFlux));
@@ -1077,7 +1178,79 @@ static void distributeEnergyViaFactor(const Factor& factor, Channels energy, Ref
 	destination->totalExitingFluxToDiffuse += energy;
 	RR_ASSERT(IS_VEC3(destination->totalExitingFluxToDiffuse));
 
-	staticReflectors->insert(destination);
+	return !destination->isReflector;
+}
+
+void Scene::distributeEnergyViaFactors(const FactorRange& factors, Channels energy)
+{
+	for (const Factor* i=factorStorage.begin(factors);i<factorStorage.end(factors);i++)
+		if (distributeEnergyViaFactor(*i,energy,object->triangle))
+			staticReflectors.insert(object->triangle+i->destination);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// distribute all unshot energy from multiple sources
+//
+// sources don't receive energy from each other in this step, it stays in them for later distribution
+
+void Scene::distributeEnergyFrom(Triangle** sources, unsigned numSources)
+{
+	RR_PROFILE_SCOPE("distribution");
+	RR_ASSERT(numSources<=DISTRIB_BATCH);
+	Channels energy[DISTRIB_BATCH];
+	size_t numFactors = 0;
+	for (unsigned s=0;s<numSources;s++)
+	{
+		energy[s] = sources[s]->totalExitingFluxToDiffuse;
+		sources[s]->totalExitingFluxToDiffuse = Channels(0);
+		numFactors += sources[s]->factors.size();
+	}
+	RR_PROFILE_COUNT("factors",numFactors);
+
+#ifdef _OPENMP
+	int numParts = omp_get_max_threads()*4;
+	if (numFactors>RR_OMP_MIN_ELEMENTS/10 && numParts>4)
+	{
+		// each part of destinations is updated by single thread, no synchronization needed
+		// each destination receives energy in the same order as in serial code, results don't depend on number of threads
+		Triangle* triangles = object->triangle;
+		unsigned numTriangles = object->triangles;
+		newReflectors.resize(numParts);
+		newReflectorsEnds.resize(numParts);
+		#pragma omp parallel for schedule(dynamic)
+		for (int p=0;p<numParts;p++)
+		{
+			unsigned destinationLo = (unsigned)((unsigned long long)numTriangles*p/numParts);
+			unsigned destinationHi = (unsigned)((unsigned long long)numTriangles*(p+1)/numParts);
+			newReflectors[p].clear();
+			newReflectorsEnds[p].resize(numSources);
+			for (unsigned s=0;s<numSources;s++)
+			{
+				const Factor* end = factorStorage.end(sources[s]->factors);
+				const Factor* i = std::lower_bound(factorStorage.begin(sources[s]->factors),end,destinationLo,[](const Factor& f, unsigned destination) {return f.destination<destination;});
+				for (;i<end && i->destination<destinationHi;i++)
+					if (distributeEnergyViaFactor(*i,energy[s],triangles))
+					{
+						// serial code inserts destination after the first source that makes its flux nonzero, remember that source
+						const Triangle& destination = triangles[i->destination];
+						if (!(destination.totalExitingFlux==Channels(0) && destination.totalExitingFluxToDiffuse==Channels(0)))
+							newReflectors[p].push_back(i->destination);
+					}
+				newReflectorsEnds[p][s] = newReflectors[p].size();
+			}
+		}
+		// insert in serial order (by source, then by destination), so that Reflectors::best() breaks ties the same way
+		for (unsigned s=0;s<numSources;s++)
+			for (int p=0;p<numParts;p++)
+				for (size_t i=s?newReflectorsEnds[p][s-1]:0;i<newReflectorsEnds[p][s];i++)
+					staticReflectors.insert(triangles+newReflectors[p][i]);
+		return;
+	}
+#endif
+
+	for (unsigned s=0;s<numSources;s++)
+		distributeEnergyViaFactors(sources[s]->factors,energy[s]);
 }
 
 
@@ -1087,6 +1260,7 @@ static void distributeEnergyViaFactor(const Factor& factor, Channels energy, Ref
 
 void Scene::refreshFormFactorsFromUntil(BestInfo source,RRStaticSolver::EndFunc& endfunc)
 {
+	RR_PROFILE_SCOPE("factorRefresh");
 	if (phase==0)
 	{
 		// prepare shooting
@@ -1110,18 +1284,22 @@ void Scene::refreshFormFactorsFromUntil(BestInfo source,RRStaticSolver::EndFunc&
 		while (shotsAccumulated<shotsForNewFactors)
 		{
 			int shotsTodo = RR_MIN(shotsForNewFactors-shotsAccumulated,100000);
-			#pragma omp parallel for schedule(dynamic) if(shotsTodo>RR_OMP_MIN_ELEMENTS/30)
-			for (int i=0;i<shotsTodo;i++)
+			unsigned profilerStage = RRProfiler::getStage();
+			#pragma omp parallel if(shotsTodo>RR_OMP_MIN_ELEMENTS/30)
 			{
+				RR_PROFILE_PARENT(profilerStage);
 				#ifdef _OPENMP
 					int threadNum = omp_get_thread_num();
 				#else
 					int threadNum = 0;
 				#endif
-				shotFromToHalfspace(shootingKernels.shootingKernel+threadNum,source.node);
+				#pragma omp for schedule(dynamic)
+				for (int i=0;i<shotsTodo;i++)
+					shotFromToHalfspace(shootingKernels.shootingKernel+threadNum,source.node);
 			}
 			shotsAccumulated += shotsTodo;
 			shotsTotal += shotsTodo;
+			RR_PROFILE_COUNT("photons",shotsTodo);
 /*			
 			static unsigned s_batches = 0; s_batches++;
 			static unsigned s_batchexits = 0;
@@ -1150,7 +1328,7 @@ void Scene::refreshFormFactorsFromUntil(BestInfo source,RRStaticSolver::EndFunc&
 			{
 				numFactorsToInsert += shootingKernels.shootingKernel[kernelNum].hitTriangles.size();
 			}
-			if (!factorAllocator.reserve(numFactorsToInsert))
+			if (!factorStorage.reserve(numFactorsToInsert,object->triangle,object->triangles))
 			{
 				// alloc failed, keep old factors
 				return;
@@ -1160,29 +1338,31 @@ void Scene::refreshFormFactorsFromUntil(BestInfo source,RRStaticSolver::EndFunc&
 		// remove old factors
 		shotsForFactorsTotal-=source.node->shotsForFactors;
 		Channels ch(source.node->totalExitingFluxToDiffuse-source.node->totalExitingFlux);
-		for (ChunkList<Factor>::const_iterator i=source.node->factors.begin(); *i; ++i)
-			distributeEnergyViaFactor(**i, ch, &staticReflectors);
-		source.node->factors.clear();
+		distributeEnergyViaFactors(source.node->factors,ch);
 
-		// insert new factors
-		ChunkList<Factor>::InsertIterator i(source.node->factors,factorAllocator);
+		// insert new factors, sorted by destination
+		newFactors.clear();
 		Factor f;
+		Triangle* hitTriangle;
 		for (unsigned kernelNum=0;kernelNum<shootingKernels.numKernels;kernelNum++)
 		{
-			while ((f.destination=shootingKernels.shootingKernel[kernelNum].hitTriangles.get()))
+			while ((hitTriangle=shootingKernels.shootingKernel[kernelNum].hitTriangles.get()))
 			{
-				f.power = f.destination->hits/shotsAccumulated;
+				f.destination = ARRAY_ELEMENT_TO_INDEX(object->triangle,hitTriangle);
+				f.power = hitTriangle->hits/shotsAccumulated;
 				RR_ASSERT(f.power>0);
 				//RR_ASSERT(f.power<=1); above 1 is ok in presence of specular reflectance/transmittance
-				f.destination->hits = 0;
-				if (!i.insert(f))
-				{
-					shotsForFactorsTotal = UINT_MAX-1; // stop improving, avgAccuracy() will return number high enough for everyone
-					break;
-				}
+				hitTriangle->hits = 0;
+				newFactors.push_back(f);
 			}
 			shootingKernels.shootingKernel[kernelNum].hitTriangles.reset();
 		}
+		std::sort(newFactors.begin(),newFactors.end(),[](const Factor& a, const Factor& b) {return a.destination<b.destination;});
+		if (!factorStorage.set(source.node->factors,newFactors.data(),(unsigned)newFactors.size(),object->triangle,object->triangles))
+		{
+			source.node->factors.clear();
+			shotsForFactorsTotal = UINT_MAX-1; // stop improving, avgAccuracy() will return number high enough for everyone
+		}
 		source.node->totalExitingFluxToDiffuse=source.node->totalExitingFlux;
 		source.node->shotsForFactors=shotsAccumulated;
 		shotsAccumulated=0;
@@ -1225,14 +1405,17 @@ bool Scene::energyFromDistributedUntil(BestInfo source,RRStaticSolver::EndFunc&
 		double t0 = omp_get_wtime();
 #endif
 		// distribute energy via form factors
-		for (ChunkList<Factor>::const_iterator i=source.node->factors.begin(); *i; ++i)
-			distributeEnergyViaFactor(**i, source.node->totalExitingFluxToDiffuse, &staticReflectors);
+		// (together with following best distributors, if there are any in cache)
+		Triangle* sources[DISTRIB_BATCH];
+		unsigned numSources = 0;
+		sources[numSources++] = source.node;
+		for (BestInfo next; numSources<DISTRIB_BATCH && (next=staticReflectors.bestDistributor()).node; )
+			sources[numSources++] = next.node;
+		distributeEnergyFrom(sources,numSources);
 #ifdef VERIFY_TIME_ESIMATES
 		if (!source.needsRefresh())
 			secondsDistributing += omp_get_wtime()-t0;
 #endif
-
-		source.node->totalExitingFluxToDiffuse=Channels(0);
 		return true;
 	}
 	return false;
@@ -1253,11 +1436,19 @@ bool Scene::distribute(int minSteps, real maxError, real maxSeconds)
 		BestInfo source=staticReflectors.best(sum(abs(staticSourceExitingFlux)));
 		if (!source.node || ( steps>minSteps && sum(abs(source.node->totalExitingFluxToDiffuse))<sum(abs(staticSourceExitingFlux*maxError)) && !rezerva--) || start.secondsPassed()>maxSeconds) break;
 
-		for (ChunkList<Factor>::const_iterator i=source.node->factors.begin(); *i; ++i)
-			distributeEnergyViaFactor(**i, source.node->totalExitingFluxToDiffuse, &staticReflectors);
+		// distribute together with following best distributors that are still above error threshold
+		Triangle* sources[DISTRIB_BATCH];
+		unsigned numSources = 0;
+		sources[numSources++] = source.node;
+		for (BestInfo next; numSources<DISTRIB_BATCH && (next=staticReflectors.bestDistributor()).node; )
+		{
+			sources[numSources++] = next.node;
+			if (sum(abs(next.node->totalExitingFluxToDiffuse))<sum(abs(staticSourceExitingFlux*maxError)))
+				break;
+		}
+		distributeEnergyFrom(sources,numSources);
 
-		source.node->totalExitingFluxToDiffuse=Channels(0);
-		steps++;
+		steps += numSources;
 		distributed=true;
 	}
 	return distributed;
@@ -1269,6 +1460,7 @@ bool Scene::distribute(int minSteps, real maxError, real maxSeconds)
 
 RRStaticSolver::Improvement Scene::improveStatic(RRStaticSolver::EndFunc& endfunc)
 {
+	RR_PROFILE_SCOPE("propagation");
 	if (!IS_CHANNELS(staticSourceExitingFlux))
 		return RRStaticSolver::INTERNAL_ERROR; // invalid internal data
 	RRStaticSolver::Improvement improved=RRStaticSolver::NOT_IMPROVED;
@@ -12,6 +12,7 @@
 
 //#define SUPPORT_INTERPOL // support interpolation, +20% memory required
 #define BESTS           400 // how many best shooters to precalculate in one pass. more=faster best() but less accurate
+#define DISTRIB_BATCH    64 // how many best distributors to distribute at once, in parallel
 
 #define CHANNELS         3
 #define HITCHANNELS      1 // 1 (CHANNELS only if we support specular reflection that changes light color (e.g. polished steel) or specular transmittance that changes light color (e.g. colored glass))
@@ -42,11 +43,11 @@
 #endif
 
 #include <stdarg.h>
+#include <vector>
 
 #include "geometry_v.h"
 #include "../RRStaticSolver/RRStaticSolver.h"
 #include "interpol.h"
-#include "ChunkList.h"
 #include "../RRPackedSolver/PackedSolverFile.h"
 #include <boost/random/linear_congruential.hpp>
 //#include <boost/random/mersenne_twister.hpp>
@@ -82,7 +83,7 @@ extern unsigned __frameNumber; // frame number increased after each draw
 class Factor
 {
 public:
-	class Triangle* destination;
+	unsigned destination; // index of destination triangle in Object::triangle
 	// Extended form factor.
 	// Fraction of emited energy that reaches destination's diffuse component.
 	// It is not modulated by destination diffuse color,
@@ -92,6 +93,55 @@ public:
 	FactorChannels power;
 };
 
+//////////////////////////////////////////////////////////////////////////////
+//
+// form factors from one source, range in FactorStorage
+
+class FactorRange
+{
+public:
+	FactorRange() {first=0;num=0;}
+	unsigned size() const {return num;}
+	void clear() {num=0;}
+
+	size_t first;
+	unsigned num;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// form factors from all sources
+//
+// CSR-like layout, factors from one source are contiguous and sorted by destination.
+// Distribution reads them sequentially, parallel distribution finds range of destinations by binary search.
+// Replaced factors stay in storage as garbage until compaction.
+
+class FactorStorage
+{
+public:
+	FactorStorage();
+	~FactorStorage();
+	void    reset(); // frees all factors, caller must clear all ranges
+
+	// preallocates space, ensures that next set() of numFactors won't fail
+	// true = ok
+	bool    reserve(unsigned numFactors, class Triangle* triangles, unsigned numTriangles);
+	// replaces factors from one source, factors must be sorted by destination
+	// false = allocation failed, range was not changed
+	bool    set(FactorRange& range, const Factor* factors, unsigned numFactors, class Triangle* triangles, unsigned numTriangles);
+
+	const Factor* begin(const FactorRange& range) const {return factor+range.first;}
+	const Factor* end(const FactorRange& range) const {return factor+range.first+range.num;}
+
+private:
+	void    compact(class Triangle* triangles, unsigned numTriangles);
+
+	Factor* factor;
+	size_t  factorsUsed; // including garbage
+	size_t  factorsAllocated;
+	size_t  factorsGarbage;
+};
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // triangle
@@ -104,14 +154,7 @@ public:
 
 	void    reset(bool resetFactors);
 
-	// form factors
-	ChunkList<Factor> factors;
-
-	// shooting
-	real    hits; // accumulates hits from current shooter
-	unsigned shotsForFactors:30; // number of shots used for current ff
-	unsigned isLod0:1; // triangle is in lod0. constant for whole triangle lifetime
-	unsigned isReflector:1; // triangle (is in lod0 and) has some energy accumulated to reflect
+	// data read by best() and distribution are kept together at the beginning, to touch single cache line per triangle
 
 	// light acumulators
 	//  exitingXxx includes emittance
@@ -119,6 +162,24 @@ public:
 	RRVec3  totalExitingFluxToDiffuse;
 	RRVec3  totalExitingFlux;
 	RRVec3  totalIncidentFlux;
+
+	// precalc for best()
+	real    precalcDistributing;
+	real    precalcRefreshing;
+	void    updatePrecalc(unsigned numTrianglesTotal);
+
+	// material
+	const RRMaterial* surface;     // material at outer and inner side of Triangle
+
+	// shooting
+	unsigned shotsForFactors:30; // number of shots used for current ff
+	unsigned isLod0:1; // triangle is in lod0. constant for whole triangle lifetime
+	unsigned isReflector:1; // triangle (is in lod0 and) has some energy accumulated to reflect
+	real    hits; // accumulates hits from current shooter
+
+	// form factors, stored in Scene::factorStorage
+	FactorRange factors;
+
 	RRVec3  directIncidentFlux;  // backup of direct incident flux in time 0. Set only by setSurface(). Read only by getSourceXxx().
 
 	// get direct light (entered by client, not calculated)
@@ -149,18 +210,12 @@ public:
 	RRVec3  getMeasure(RRRadiometricMeasure measure, RRReal emissiveMultiplier) const;
 	RRVec3  getPointMeasure(RRRadiometricMeasure measure, const RRVec2& uv) const; // supports only RM_IRRADIANCE_LINEAR, RM_IRRADIANCE_LINEAR_DIRECT, RM_IRRADIANCE_LINEAR_INDIRECT
 
-	// precalc for best()
-	real    precalcDistributing;
-	real    precalcRefreshing;
-	void    updatePrecalc(unsigned numTrianglesTotal);
-
 	// geometry
 	real    area;
 	S8      setGeometry(const RRMesh::TriangleBody& body,float ignoreSmallerAngle,float ignoreSmallerArea);
 
 	// material
 	Channels setSurface(const RRMaterial *s,const RRVec3& sourceIrradiance, bool resetPropagation, RRReal emissiveMultiplier); // sets direct(source) lighting. emittance comes with material. irradiance comes from detectDirectIllumination [realtime] or from first gather [offline]
-	const RRMaterial* surface;     // material at outer and inner side of Triangle
 
 	// smoothing
 	IVertex* topivertex[3]; // 3x ivertex
@@ -216,6 +271,7 @@ public:
 	void    insertObject(class Object *o);
 
 	BestInfo best(real allEnergyInScene);
+	BestInfo bestDistributor(); // returns next best from cache only if it is ready for distribution (needs no refresh), does not fill cache
 
 	private:
 		unsigned nodesAllocated;
@@ -345,6 +401,8 @@ public:
 		void    shotFromToHalfspace(ShootingKernel* shootingKernel,Triangle* sourceNode);
 		void    refreshFormFactorsFromUntil(BestInfo source,RRStaticSolver::EndFunc& endfunc);
 		bool    energyFromDistributedUntil(BestInfo source,RRStaticSolver::EndFunc& endfunc);
+		void    distributeEnergyViaFactors(const FactorRange& factors, Channels energy);
+		void    distributeEnergyFrom(Triangle** sources, unsigned numSources);
 
 		Channels staticSourceExitingFlux; // primary source exiting radiant flux in Watts, sum of absolute values
 		unsigned shotsForNewFactors;
@@ -358,7 +416,10 @@ public:
 
 		// all factors allocated by this scene
 		// deallocated only in scene destructor or when factors are reset
-		ChunkList<Factor>::Allocator factorAllocator;
+		FactorStorage factorStorage;
+		std::vector<Factor> newFactors; // temporary, used when refreshing factors
+		std::vector<std::vector<unsigned> > newReflectors; // temporary, per part of destinations, used by parallel distribution
+		std::vector<std::vector<size_t> > newReflectorsEnds; // temporary, per part of destinations and source, end of source's newReflectors
 
 		// used only during fireball build to gather sky hits
 		PackedSkyTriangleFactor::UnpackedFactor* skyPatchHitsForAllTriangles;
@@ -7,6 +7,14 @@
 // Building unwrap.
 // --------------------------------------------------------------------------
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
 #ifdef _WIN32
 
 // with settings below, Lightsprint SDK builds and runs without DirectX SDK or DirectX runtime, we only attempt to locate DirectX runtime at runtime
@@ -18,18 +26,17 @@
 	#define ABORTABLE // makes unwrapping abortable, uses boost::thread and boost::chrono
 #endif
 
-#include <algorithm>
-#include <cstdio>
-#include <string>
-#include <vector>
-#include <unordered_map>
-#include <unordered_set>
 #ifdef ABORTABLE
 	#include <boost/thread.hpp>
 #endif
 #include "Windows/d3dx9/D3DX9Mesh.h" // here we include our copy of Direct3DX9 headers, so that installing legacy packages (DirectX SDK) is not necessary
+
+#endif // _WIN32
+
 #include "Lightsprint/RRObject.h"
 
+#ifdef _WIN32
+
 #ifndef DYNAMIC_LOAD
 	#pragma comment(lib,"D3d9.lib")
 	#pragma comment(lib,"D3dx9.lib")
@@ -47,6 +54,8 @@
 	}
 #endif
 
+#endif // _WIN32
+
 namespace rr
 {
 
@@ -58,6 +67,8 @@ struct UvChannels : public std::unordered_set<unsigned>
 	RRString objectName; // only for reporting
 };
 
+#ifdef _WIN32
+
 class Unwrapper
 {
 public:
@@ -65,6 +76,9 @@ public:
 	bool buildUnwrap(RRMeshArrays* rrMesh, unsigned unwrapChannel, const UvChannels& keepChannels, unsigned mapSize, float gutter, float pixelsPerWorldUnit, unsigned minTrianglesForFastUnwrap, bool& aborting);
 	~Unwrapper();
 
+	// D3DX processes single mesh in single thread, so we unwrap all meshes in parallel.
+	static bool unwrapsInParallel(const RRMeshArrays* rrMesh) {return false;}
+
 	// stats updated by buildUnwrap()
 	// not thread safe, it's just stats used for reporting
 	unsigned sumMeshesFailed;
@@ -675,6 +689,786 @@ Unwrapper::~Unwrapper()
 #endif
 }
 
+#else // !_WIN32
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// Unwrapper, native implementation
+//
+// 1. charts are grown from the biggest triangles over smooth edges, while normals stay in cone around seed normal
+// 2. charts are parameterized by LSCM (least squares conformal maps) solved by conjugate gradient,
+//    starting from planar projection; projection is kept where LSCM would flip triangles
+// 3. charts that overlap themselves in uv (e.g. spiral staircase fits in normal cone, but its projection overlaps)
+//    are split in two and parameterized again, until they don't overlap
+// 4. charts are packed by skyline packer into map of requested resolution, with gutter between charts
+
+enum
+{
+	MIN_TRIANGLES_FOR_PARALLEL_CHARTS = 10000, // bigger meshes are unwrapped one by one, with charts in parallel
+	OVERLAP_SAMPLES_PER_TRIANGLE = 4, // density of grid that detects overlaps
+	MAX_OVERLAP_SAMPLES = 16*1024*1024, // limits memory used by overlap detection in huge charts
+};
+
+// Mesh with vertices stitched over smooth edges.
+struct UnwrapTopology
+{
+	std::vector<RRMesh::Triangle> triangle;
+	std::vector<RRVec3> position;
+	std::vector<RRVec3> normal; // per triangle, 0 in degenerated triangle
+	std::vector<RRReal> area; // per triangle
+	std::vector<unsigned> neighbor; // 3 per triangle, UINT_MAX at border or hard edge
+
+	void build(const RRMeshArrays* mesh)
+	{
+		// stitch only (nearly) identical positions, bigger distance would collapse small triangles
+		unsigned numTriangles = mesh->numTriangles;
+		RRVec3 mini,maxi;
+		mesh->getAABB(&mini,&maxi,nullptr);
+		const RRMesh* stitched = mesh->createOptimizedVertices((maxi-mini).length()*1e-6f,RR_DEG2RAD(3),0,nullptr);
+		position.resize(stitched->getNumVertices());
+		for (unsigned v=0;v<position.size();v++)
+			stitched->getVertex(v,position[v]);
+		triangle.resize(numTriangles);
+		normal.resize(numTriangles);
+		area.resize(numTriangles);
+		for (unsigned t=0;t<numTriangles;t++)
+		{
+			stitched->getTriangle(t,triangle[t]);
+			RRVec3 n = (position[triangle[t][1]]-position[triangle[t][0]]).cross(position[triangle[t][2]]-position[triangle[t][0]]);
+			area[t] = n.length()/2;
+			normal[t] = (area[t]>0) ? n/(2*area[t]) : RRVec3(0);
+		}
+		if (stitched!=mesh)
+			delete stitched;
+
+		// connect triangles that share edge, edges shared by more than two triangles stay unconnected
+		neighbor.assign(3*numTriangles,UINT_MAX);
+		std::unordered_map<unsigned long long,unsigned> edges; // edge -> 3*triangle+side of first triangle, UINT_MAX when already connected
+		edges.reserve(3*numTriangles);
+		for (unsigned t=0;t<numTriangles;t++)
+			for (unsigned s=0;s<3;s++)
+			{
+				unsigned a = triangle[t][s];
+				unsigned b = triangle[t][(s+1)%3];
+				if (a==b)
+					continue;
+				unsigned long long key = ((unsigned long long)RR_MIN(a,b)<<32) + RR_MAX(a,b);
+				std::pair<std::unordered_map<unsigned long long,unsigned>::iterator,bool> inserted = edges.insert(std::make_pair(key,3*t+s));
+				if (!inserted.second && inserted.first->second!=UINT_MAX)
+				{
+					neighbor[inserted.first->second] = t;
+					neighbor[3*t+s] = inserted.first->second/3;
+					inserted.first->second = UINT_MAX;
+				}
+			}
+	}
+};
+
+// Part of mesh unwrapped to single island in map.
+struct UnwrapChart
+{
+	std::vector<unsigned> triangles; // indices into mesh
+	std::vector<RRMesh::Triangle> localTriangles; // indices into vertices
+	std::vector<unsigned> vertices; // indices into stitched vertices
+	std::vector<RRVec2> uv; // per vertex, in world units, min at 0,0
+	RRVec3 axis; // projection axis, normal of seed triangle
+	RRVec2 size; // max uv
+	unsigned x,y; // position in map in texels, gutter included
+
+	UnwrapChart() : axis(0,0,1), size(0), x(0), y(0)
+	{
+	}
+
+	// Fills localTriangles, vertices, uv, size.
+	void parameterize(const UnwrapTopology& topology, bool conformal)
+	{
+		std::unordered_map<unsigned,unsigned> localVertex;
+		localTriangles.resize(triangles.size());
+		RRReal area = 0;
+		for (unsigned i=0;i<triangles.size();i++)
+		{
+			area += topology.area[triangles[i]];
+			for (unsigned c=0;c<3;c++)
+			{
+				unsigned v = topology.triangle[triangles[i]][c];
+				std::pair<std::unordered_map<unsigned,unsigned>::iterator,bool> inserted = localVertex.insert(std::make_pair(v,(unsigned)vertices.size()));
+				if (inserted.second)
+					vertices.push_back(v);
+				localTriangles[i][c] = inserted.first->second;
+			}
+		}
+
+		// planar projection, doesn't flip triangles because all normals are in cone around axis
+		RRVec3 axisU = axis.cross((fabs(axis.x)<0.6f)?RRVec3(1,0,0):RRVec3(0,1,0)).normalized();
+		RRVec3 axisV = axis.cross(axisU);
+		uv.resize(vertices.size());
+		for (unsigned v=0;v<vertices.size();v++)
+			uv[v] = RRVec2(topology.position[vertices[v]].dot(axisU),topology.position[vertices[v]].dot(axisV));
+
+		if (conformal && triangles.size()>1)
+			conformalMap(topology);
+
+		// scale to world units
+		RRReal uvArea = 0;
+		for (unsigned i=0;i<localTriangles.size();i++)
+			uvArea += getUvArea(i);
+		if (uvArea>0 && area>0)
+		{
+			RRReal scale = sqrtf(area/uvArea);
+			for (unsigned v=0;v<uv.size();v++)
+				uv[v] *= scale;
+		}
+
+		// rotate to minimal bounding box
+		RRReal bestArea = 1e30f;
+		RRReal bestAngle = 0;
+		enum {ANGLES=32};
+		for (unsigned a=0;a<ANGLES;a++)
+		{
+			RRReal angle = RR_PI/2*a/ANGLES;
+			RRVec2 mini(1e30f), maxi(-1e30f);
+			for (unsigned v=0;v<uv.size();v++)
+			{
+				RRVec2 rotated = rotate(uv[v],angle);
+				mini.x = RR_MIN(mini.x,rotated.x); mini.y = RR_MIN(mini.y,rotated.y);
+				maxi.x = RR_MAX(maxi.x,rotated.x); maxi.y = RR_MAX(maxi.y,rotated.y);
+			}
+			RRReal boxArea = (maxi.x-mini.x)*(maxi.y-mini.y);
+			if (boxArea<bestArea)
+			{
+				bestArea = boxArea;
+				bestAngle = angle;
+			}
+		}
+		RRVec2 mini(1e30f), maxi(-1e30f);
+		for (unsigned v=0;v<uv.size();v++)
+		{
+			uv[v] = rotate(uv[v],bestAngle);
+			mini.x = RR_MIN(mini.x,uv[v].x); mini.y = RR_MIN(mini.y,uv[v].y);
+			maxi.x = RR_MAX(maxi.x,uv[v].x); maxi.y = RR_MAX(maxi.y,uv[v].y);
+		}
+		size = maxi-mini;
+		for (unsigned v=0;v<uv.size();v++)
+			uv[v] -= mini;
+
+		// make it wider than taller, packer prefers it
+		if (size.y>size.x)
+		{
+			for (unsigned v=0;v<uv.size();v++)
+				uv[v] = RRVec2(uv[v].y,size.x-uv[v].x);
+			size = RRVec2(size.y,size.x);
+		}
+	}
+
+	// True if parameterized chart flips or overlaps triangles in uv.
+	// Overlaps are detected by sampling uv in grid of cells approximately 4x smaller than average triangle.
+	bool overlaps(const UnwrapTopology& topology) const
+	{
+		unsigned numTriangles = (unsigned)localTriangles.size();
+		if (numTriangles<2)
+			return false;
+		RRReal uvArea = 0;
+		for (unsigned i=0;i<numTriangles;i++)
+		{
+			RRReal triangleUvArea = getUvArea(i);
+			if (topology.area[triangles[i]]>0 && !(triangleUvArea>0))
+				return true;
+			uvArea += triangleUvArea;
+		}
+		if (!(uvArea>0))
+			return false;
+		RRReal cell = RR_MAX(sqrtf(uvArea/(OVERLAP_SAMPLES_PER_TRIANGLE*numTriangles)),sqrtf(size.x*size.y/MAX_OVERLAP_SAMPLES));
+		unsigned width = (unsigned)(size.x/cell)+1;
+		unsigned height = (unsigned)(size.y/cell)+1;
+		std::vector<unsigned char> covered((size_t)width*height,0);
+		for (unsigned i=0;i<numTriangles;i++)
+		{
+			RRVec2 q[3] = {uv[localTriangles[i][0]]/cell,uv[localTriangles[i][1]]/cell,uv[localTriangles[i][2]]/cell};
+			RRReal doubleArea = 2*getUvArea(i)/(cell*cell);
+			if (!(doubleArea>0))
+				continue;
+			unsigned x0 = (unsigned)RR_CLAMPED((int)RR_MIN3(q[0].x,q[1].x,q[2].x),0,(int)width-1);
+			unsigned x1 = (unsigned)RR_CLAMPED((int)RR_MAX3(q[0].x,q[1].x,q[2].x),0,(int)width-1);
+			unsigned y0 = (unsigned)RR_CLAMPED((int)RR_MIN3(q[0].y,q[1].y,q[2].y),0,(int)height-1);
+			unsigned y1 = (unsigned)RR_CLAMPED((int)RR_MAX3(q[0].y,q[1].y,q[2].y),0,(int)height-1);
+			for (unsigned y=y0;y<=y1;y++)
+				for (unsigned x=x0;x<=x1;x++)
+				{
+					// sample is inside when all barycentric coordinates are positive, samples on shared edges are in none
+					RRVec2 p(x+0.5f,y+0.5f);
+					bool inside = true;
+					for (unsigned j=0;j<3 && inside;j++)
+					{
+						RRVec2 side = q[(j+1)%3]-q[j];
+						RRVec2 toP = p-q[j];
+						inside = (side.x*toP.y-side.y*toP.x)/doubleArea>1e-4f;
+					}
+					if (inside)
+					{
+						unsigned char& c = covered[(size_t)y*width+x];
+						if (c)
+							return true;
+						c = 1;
+					}
+				}
+		}
+		return false;
+	}
+
+	// Splits triangles between two new charts grown from opposite ends of this one, with the same axis.
+	// Returns false if chart can't be split.
+	bool split(const UnwrapTopology& topology, UnwrapChart& half0, UnwrapChart& half1) const
+	{
+		unsigned numTriangles = (unsigned)triangles.size();
+		if (numTriangles<2)
+			return false;
+		std::unordered_map<unsigned,unsigned> localTriangle; // mesh triangle -> index in triangles
+		for (unsigned i=0;i<numTriangles;i++)
+			localTriangle[triangles[i]] = i;
+
+		// breadth first search over triangles of chart, from given seeds
+		// returns triangle visited last (the farthest one)
+		std::vector<unsigned> label(numTriangles);
+		std::vector<unsigned> queue;
+		auto grow = [&](unsigned seed0, unsigned seed1)
+		{
+			std::fill(label.begin(),label.end(),UINT_MAX);
+			queue.clear();
+			queue.push_back(seed0);
+			label[seed0] = 0;
+			if (seed1!=UINT_MAX)
+			{
+				queue.push_back(seed1);
+				label[seed1] = 1;
+			}
+			for (unsigned j=0;j<queue.size();j++)
+			{
+				unsigned t = triangles[queue[j]];
+				for (unsigned s=0;s<3;s++)
+				{
+					std::unordered_map<unsigned,unsigned>::const_iterator n = localTriangle.find(topology.neighbor[3*t+s]);
+					if (n!=localTriangle.end() && label[n->second]==UINT_MAX)
+					{
+						label[n->second] = label[queue[j]];
+						queue.push_back(n->second);
+					}
+				}
+			}
+			return queue.back();
+		};
+		unsigned end0 = grow(0,UINT_MAX);
+		unsigned end1 = grow(end0,UINT_MAX);
+		grow(end0,end1);
+
+		half0 = UnwrapChart();
+		half1 = UnwrapChart();
+		half0.axis = half1.axis = axis; // all normals are still in cone around axis, projection doesn't flip
+		for (unsigned i=0;i<numTriangles;i++)
+			((label[i]==1)?half1:half0).triangles.push_back(triangles[i]);
+		return half0.triangles.size() && half1.triangles.size();
+	}
+
+private:
+	static RRVec2 rotate(const RRVec2& a, RRReal angle)
+	{
+		RRReal c = cosf(angle);
+		RRReal s = sinf(angle);
+		return RRVec2(a.x*c-a.y*s,a.x*s+a.y*c);
+	}
+
+	// Signed area of triangle in uv, negative when flipped.
+	RRReal getUvArea(unsigned i) const
+	{
+		RRVec2 side1 = uv[localTriangles[i][1]]-uv[localTriangles[i][0]];
+		RRVec2 side2 = uv[localTriangles[i][2]]-uv[localTriangles[i][0]];
+		return (side1.x*side2.y-side1.y*side2.x)/2;
+	}
+
+	// Replaces uv by LSCM, starting from current uv, two vertices at extremes stay pinned.
+	// Keeps uv unchanged if solution flips triangles.
+	void conformalMap(const UnwrapTopology& topology)
+	{
+		unsigned numVertices = (unsigned)vertices.size();
+		unsigned numTriangles = (unsigned)triangles.size();
+
+		// sparse matrix A, each triangle adds two rows (real and imaginary part of sum W[j]*uv[j])
+		struct Rows {double re[3]; double im[3];};
+		std::vector<Rows> rows(numTriangles);
+		for (unsigned i=0;i<numTriangles;i++)
+		{
+			unsigned t = triangles[i];
+			if (!(topology.area[t]>0))
+			{
+				memset(&rows[i],0,sizeof(Rows));
+				continue;
+			}
+			RRVec3 side1 = topology.position[topology.triangle[t][1]]-topology.position[topology.triangle[t][0]];
+			RRVec3 side2 = topology.position[topology.triangle[t][2]]-topology.position[topology.triangle[t][0]];
+			RRVec3 axisX = side1.normalized();
+			RRVec3 axisY = topology.normal[t].cross(axisX);
+			double z[3][2] = {{0,0},{side1.length(),0},{side2.dot(axisX),side2.dot(axisY)}}; // triangle in its own plane
+			double weight = 1/sqrt(2*topology.area[t]);
+			for (unsigned j=0;j<3;j++)
+			{
+				rows[i].re[j] = (z[(j+2)%3][0]-z[(j+1)%3][0])*weight;
+				rows[i].im[j] = (z[(j+2)%3][1]-z[(j+1)%3][1])*weight;
+			}
+		}
+
+		// pin vertices at extremes of projection
+		unsigned pin0 = 0;
+		unsigned pin1 = 0;
+		for (unsigned v=1;v<numVertices;v++)
+		{
+			if (uv[v].x<uv[pin0].x) pin0 = v;
+			if (uv[v].x>uv[pin1].x) pin1 = v;
+		}
+		if (pin0==pin1)
+			return;
+
+		auto multiplyA = [&](const std::vector<double>& x, std::vector<double>& out)
+		{
+			for (unsigned i=0;i<numTriangles;i++)
+			{
+				double re = 0;
+				double im = 0;
+				for (unsigned j=0;j<3;j++)
+				{
+					unsigned v = localTriangles[i][j];
+					re += rows[i].re[j]*x[2*v] - rows[i].im[j]*x[2*v+1];
+					im += rows[i].im[j]*x[2*v] + rows[i].re[j]*x[2*v+1];
+				}
+				out[2*i] = re;
+				out[2*i+1] = im;
+			}
+		};
+		auto multiplyAt = [&](const std::vector<double>& r, std::vector<double>& out)
+		{
+			std::fill(out.begin(),out.end(),0.);
+			for (unsigned i=0;i<numTriangles;i++)
+				for (unsigned j=0;j<3;j++)
+				{
+					unsigned v = localTriangles[i][j];
+					out[2*v] += rows[i].re[j]*r[2*i] + rows[i].im[j]*r[2*i+1];
+					out[2*v+1] += rows[i].re[j]*r[2*i+1] - rows[i].im[j]*r[2*i];
+				}
+			out[2*pin0] = out[2*pin0+1] = out[2*pin1] = out[2*pin1+1] = 0;
+		};
+		auto dot = [](const std::vector<double>& a, const std::vector<double>& b)
+		{
+			double sum = 0;
+			for (size_t i=0;i<a.size();i++)
+				sum += a[i]*b[i];
+			return sum;
+		};
+
+		// conjugate gradient on normal equations (CGLS), minimizes |A*x|^2 with pinned vertices fixed
+		std::vector<double> x(2*numVertices);
+		for (unsigned v=0;v<numVertices;v++)
+		{
+			x[2*v] = uv[v].x;
+			x[2*v+1] = uv[v].y;
+		}
+		std::vector<double> r(2*numTriangles);
+		std::vector<double> q(2*numTriangles);
+		std::vector<double> s(2*numVertices);
+		multiplyA(x,r);
+		for (size_t i=0;i<r.size();i++)
+			r[i] = -r[i];
+		multiplyAt(r,s);
+		std::vector<double> p(s);
+		double gamma = dot(s,s);
+		double gammaEnd = gamma*1e-12;
+		unsigned maxIterations = RR_CLAMPED(numVertices,50,1000);
+		for (unsigned iteration=0;iteration<maxIterations && gamma>gammaEnd;iteration++)
+		{
+			multiplyA(p,q);
+			double qq = dot(q,q);
+			if (!(qq>0))
+				break;
+			double alpha = gamma/qq;
+			for (size_t i=0;i<x.size();i++)
+				x[i] += alpha*p[i];
+			for (size_t i=0;i<r.size();i++)
+				r[i] -= alpha*q[i];
+			multiplyAt(r,s);
+			double gammaNew = dot(s,s);
+			double beta = gammaNew/gamma;
+			gamma = gammaNew;
+			for (size_t i=0;i<p.size();i++)
+				p[i] = s[i]+beta*p[i];
+		}
+
+		// accept solution only if it doesn't flip triangles
+		std::vector<RRVec2> projection(uv);
+		for (unsigned v=0;v<numVertices;v++)
+			uv[v] = RRVec2((RRReal)x[2*v],(RRReal)x[2*v+1]);
+		for (unsigned i=0;i<numTriangles;i++)
+			if (topology.area[triangles[i]]>0 && !(getUvArea(i)>0))
+			{
+				uv = projection;
+				return;
+			}
+	}
+};
+
+// Places rectangles into square, each one at the lowest possible position.
+class SkylinePacker
+{
+public:
+	SkylinePacker(unsigned _size)
+	{
+		size = _size;
+		Segment segment = {0,0,_size};
+		skyline.push_back(segment);
+	}
+
+	bool insert(unsigned width, unsigned height, unsigned& outX, unsigned& outY)
+	{
+		size_t best = SIZE_MAX;
+		unsigned bestY = UINT_MAX;
+		for (size_t i=0;i<skyline.size() && skyline[i].x+width<=size;i++)
+		{
+			unsigned y = 0;
+			for (size_t j=i;j<skyline.size() && skyline[j].x<skyline[i].x+width;j++)
+				y = RR_MAX(y,skyline[j].y);
+			if (y+height<=size && y<bestY)
+			{
+				best = i;
+				bestY = y;
+			}
+		}
+		if (best==SIZE_MAX)
+			return false;
+		outX = skyline[best].x;
+		outY = bestY;
+
+		// replace covered segments with new one
+		Segment segment = {outX,bestY+height,width};
+		size_t end = best;
+		while (end<skyline.size() && skyline[end].x+skyline[end].width<=outX+width)
+			end++;
+		if (end<skyline.size() && skyline[end].x<outX+width)
+		{
+			skyline[end].width -= outX+width-skyline[end].x;
+			skyline[end].x = outX+width;
+		}
+		skyline.erase(skyline.begin()+best,skyline.begin()+end);
+		skyline.insert(skyline.begin()+best,segment);
+
+		// merge neighbors of the same height
+		if (best+1<skyline.size() && skyline[best+1].y==segment.y)
+		{
+			skyline[best].width += skyline[best+1].width;
+			skyline.erase(skyline.begin()+best+1);
+		}
+		if (best>0 && skyline[best-1].y==segment.y)
+		{
+			skyline[best-1].width += skyline[best].width;
+			skyline.erase(skyline.begin()+best);
+		}
+		return true;
+	}
+
+private:
+	struct Segment
+	{
+		unsigned x;
+		unsigned y;
+		unsigned width;
+	};
+	std::vector<Segment> skyline; // sorted by x, covers whole width
+	unsigned size;
+};
+
+class Unwrapper
+{
+public:
+	Unwrapper();
+	bool buildUnwrap(RRMeshArrays* rrMesh, unsigned unwrapChannel, const UvChannels& keepChannels, unsigned mapSize, float gutter, float pixelsPerWorldUnit, unsigned minTrianglesForFastUnwrap, bool& aborting);
+
+	// True = charts of mesh are processed in parallel, so it should not be unwrapped in parallel with other meshes.
+	static bool unwrapsInParallel(const RRMeshArrays* rrMesh) {return rrMesh->numTriangles>=MIN_TRIANGLES_FOR_PARALLEL_CHARTS;}
+
+	// stats updated by buildUnwrap()
+	// not thread safe, it's just stats used for reporting
+	unsigned sumMeshesFailed;
+	unsigned sumMeshesUnwrapped;
+	unsigned sumCharts; // in sumMeshesUnwrapped
+	unsigned sumVerticesOld; // in sumMeshesUnwrapped
+	unsigned sumVerticesNew; // in sumMeshesUnwrapped
+	float getVertexOverhead() const {return float(sumVerticesNew-sumVerticesOld)/sumVerticesOld;}
+
+private:
+	static void buildCharts(const UnwrapTopology& topology, std::vector<UnwrapChart>& charts);
+	static bool packCharts(std::vector<UnwrapChart>& charts, const std::vector<unsigned>& order, unsigned mapSize, float gutter, RRReal scale);
+};
+
+Unwrapper::Unwrapper()
+{
+	sumMeshesFailed = 0;
+	sumMeshesUnwrapped = 0;
+	sumCharts = 0;
+	sumVerticesOld = 0;
+	sumVerticesNew = 0;
+}
+
+// Grows charts from the biggest triangles.
+void Unwrapper::buildCharts(const UnwrapTopology& topology, std::vector<UnwrapChart>& charts)
+{
+	const RRReal minCos = cosf(RR_DEG2RAD(60)); // max angle between seed normal and chart normals, must be below 90 to avoid flips in projection
+	unsigned numTriangles = (unsigned)topology.triangle.size();
+	std::vector<unsigned> seeds(numTriangles);
+	for (unsigned t=0;t<numTriangles;t++)
+		seeds[t] = t;
+	std::stable_sort(seeds.begin(),seeds.end(),[&topology](unsigned a, unsigned b) {return topology.area[a]>topology.area[b];});
+	std::vector<unsigned> triangleChart(numTriangles,UINT_MAX);
+	for (unsigned i=0;i<numTriangles;i++)
+	{
+		unsigned seed = seeds[i];
+		if (triangleChart[seed]!=UINT_MAX)
+			continue;
+		unsigned c = (unsigned)charts.size();
+		charts.push_back(UnwrapChart());
+		UnwrapChart& chart = charts.back();
+		chart.axis = (topology.area[seed]>0) ? topology.normal[seed] : RRVec3(0,0,1);
+		chart.triangles.push_back(seed);
+		triangleChart[seed] = c;
+		for (unsigned j=0;j<chart.triangles.size();j++)
+		{
+			unsigned t = chart.triangles[j];
+			for (unsigned s=0;s<3;s++)
+			{
+				unsigned n = topology.neighbor[3*t+s];
+				// degenerated triangles join any chart
+				if (n!=UINT_MAX && triangleChart[n]==UINT_MAX && (!(topology.area[n]>0) || topology.normal[n].dot(chart.axis)>=minCos))
+				{
+					triangleChart[n] = c;
+					chart.triangles.push_back(n);
+				}
+			}
+		}
+	}
+}
+
+// Packs charts in given order, scale converts world units to texels. Returns false if they don't fit.
+bool Unwrapper::packCharts(std::vector<UnwrapChart>& charts, const std::vector<unsigned>& order, unsigned mapSize, float gutter, RRReal scale)
+{
+	SkylinePacker packer(mapSize);
+	for (unsigned i=0;i<order.size();i++)
+	{
+		UnwrapChart& chart = charts[order[i]];
+		if (!packer.insert((unsigned)ceilf(chart.size.x*scale+gutter),(unsigned)ceilf(chart.size.y*scale+gutter),chart.x,chart.y))
+			return false;
+	}
+	return true;
+}
+
+bool Unwrapper::buildUnwrap(RRMeshArrays* rrMesh, unsigned unwrapChannel, const UvChannels& keepChannels, unsigned mapSize, float gutter, float pixelsPerWorldUnit, unsigned minTrianglesForFastUnwrap, bool& aborting)
+{
+	// keepChannels must contain only existing channels
+	for (UvChannels::const_iterator i=keepChannels.begin();i!=keepChannels.end();++i)
+	{
+		if (!rrMesh || *i>=rrMesh->texcoord.size() || !rrMesh->texcoord[*i])
+		{
+			RR_ASSERT(0);
+			sumMeshesFailed++;
+			return false;
+		}
+	}
+	unsigned numTriangles = rrMesh->numTriangles;
+	unsigned numVertices = rrMesh->numVertices;
+	if (aborting || !numTriangles || !numVertices)
+	{
+		sumMeshesFailed++;
+		return false;
+	}
+
+	// segment
+	UnwrapTopology topology;
+	topology.build(rrMesh);
+	std::vector<UnwrapChart> charts;
+	buildCharts(topology,charts);
+
+	// parameterize
+	bool conformal = numTriangles<minTrianglesForFastUnwrap; // fast unwrap is planar projection only
+	#pragma omp parallel for schedule(dynamic) if(unwrapsInParallel(rrMesh))
+	for (int c=0;c<(int)charts.size();c++)
+	{
+		if (!aborting)
+			charts[c].parameterize(topology,conformal);
+	}
+
+	// split charts that overlap themselves, parameterize halves, repeat until nothing overlaps
+	std::vector<unsigned> check(charts.size());
+	for (unsigned c=0;c<charts.size();c++)
+		check[c] = c;
+	while (check.size() && !aborting)
+	{
+		std::vector<unsigned char> overlapping(check.size());
+		#pragma omp parallel for schedule(dynamic) if(unwrapsInParallel(rrMesh))
+		for (int i=0;i<(int)check.size();i++)
+			overlapping[i] = charts[check[i]].overlaps(topology);
+		std::vector<unsigned> split;
+		for (unsigned i=0;i<check.size();i++)
+		{
+			UnwrapChart half0, half1;
+			if (overlapping[i] && charts[check[i]].split(topology,half0,half1))
+			{
+				charts[check[i]] = std::move(half0);
+				charts.push_back(std::move(half1));
+				split.push_back(check[i]);
+				split.push_back((unsigned)charts.size()-1);
+			}
+		}
+		#pragma omp parallel for schedule(dynamic) if(unwrapsInParallel(rrMesh))
+		for (int i=0;i<(int)split.size();i++)
+		{
+			if (!aborting)
+				charts[split[i]].parameterize(topology,conformal);
+		}
+		check.swap(split);
+	}
+	if (aborting)
+	{
+		sumMeshesFailed++;
+		return false;
+	}
+
+	// pack, the tallest charts first
+	std::vector<unsigned> order(charts.size());
+	RRReal sumBoxes = 0;
+	RRReal maxSize = 0;
+	for (unsigned c=0;c<charts.size();c++)
+	{
+		order[c] = c;
+		sumBoxes += charts[c].size.x*charts[c].size.y;
+		maxSize = RR_MAX(maxSize,charts[c].size.x);
+	}
+	std::stable_sort(order.begin(),order.end(),[&charts](unsigned a, unsigned b) {return charts[a].size.y>charts[b].size.y;});
+	unsigned trySize = mapSize;
+	RRReal scale = 0;
+	while (!aborting)
+	{
+		// even minimal charts (single texel plus gutter) don't fit? try bigger map
+		if (!packCharts(charts,order,trySize,gutter,0))
+		{
+			if (trySize>=8*1024)
+			{
+				RRReporter::report(WARN,"Packing failed for mesh %ls, even resolution %d too low for %d charts?\n",keepChannels.objectName.w_str(),trySize,(unsigned)charts.size());
+				sumMeshesFailed++;
+				return false;
+			}
+			trySize *= 2;
+			continue;
+		}
+		// binary search for the biggest scale that fits
+		RRReal minScale = 0;
+		RRReal maxScale = (maxSize>0) ? (trySize-gutter)/maxSize : 1;
+		if (sumBoxes>0)
+			maxScale = RR_MIN(maxScale,trySize/sqrtf(sumBoxes));
+		for (unsigned i=0;i<16 && !aborting;i++)
+		{
+			RRReal midScale = (i==0) ? maxScale : (minScale+maxScale)/2;
+			if (packCharts(charts,order,trySize,gutter,midScale))
+			{
+				minScale = midScale;
+				if (i==0)
+					break;
+			}
+			else
+				maxScale = midScale;
+		}
+		scale = minScale;
+		packCharts(charts,order,trySize,gutter,scale);
+		break;
+	}
+	if (aborting)
+	{
+		sumMeshesFailed++;
+		return false;
+	}
+
+	// write mesh, vertices are split at chart borders
+	RRVector<unsigned> texcoords;
+	for (UvChannels::const_iterator i=keepChannels.begin();i!=keepChannels.end();++i)
+		texcoords.push_back(*i);
+	bool tangents = rrMesh->tangent!=nullptr;
+	RRMeshArrays* original = rrMesh->createArrays(true,texcoords,tangents);
+	if (!original)
+	{
+		sumMeshesFailed++;
+		return false;
+	}
+	std::vector<unsigned> newToOriginal;
+	std::vector<RRVec2> newUv;
+	std::vector<RRMesh::Triangle> newTriangles(numTriangles);
+	std::vector<unsigned> vertexChart(numVertices,UINT_MAX);
+	std::vector<unsigned> vertexNew(numVertices);
+	for (unsigned c=0;c<charts.size();c++)
+	{
+		const UnwrapChart& chart = charts[c];
+		RRVec2 offset(chart.x+gutter/2,chart.y+gutter/2);
+		for (unsigned i=0;i<chart.triangles.size();i++)
+		{
+			unsigned t = chart.triangles[i];
+			for (unsigned j=0;j<3;j++)
+			{
+				unsigned v = original->triangle[t][j];
+				if (vertexChart[v]!=c)
+				{
+					vertexChart[v] = c;
+					vertexNew[v] = (unsigned)newToOriginal.size();
+					newToOriginal.push_back(v);
+					newUv.push_back((offset+chart.uv[chart.localTriangles[i][j]]*scale)/(RRReal)trySize);
+				}
+				newTriangles[t][j] = vertexNew[v];
+			}
+		}
+	}
+	texcoords.push_back(unwrapChannel);
+	unsigned numVerticesNew = (unsigned)newToOriginal.size();
+	if (!rrMesh->resizeMesh(numTriangles,numVerticesNew,&texcoords,tangents,false))
+	{
+		// resizeMesh() emptied mesh, put original back
+		texcoords.pop_back();
+		rrMesh->reload(original,true,texcoords,tangents);
+		delete original;
+		sumMeshesFailed++;
+		return false;
+	}
+	memcpy(rrMesh->triangle,newTriangles.data(),numTriangles*sizeof(RRMesh::Triangle));
+	for (unsigned v=0;v<numVerticesNew;v++)
+	{
+		unsigned o = newToOriginal[v];
+		rrMesh->position[v] = original->position[o];
+		rrMesh->normal[v] = original->normal[o];
+		if (tangents)
+		{
+			rrMesh->tangent[v] = original->tangent[o];
+			rrMesh->bitangent[v] = original->bitangent[o];
+		}
+		for (UvChannels::const_iterator i=keepChannels.begin();i!=keepChannels.end();++i)
+			rrMesh->texcoord[*i][v] = original->texcoord[*i][o];
+		rrMesh->texcoord[unwrapChannel][v] = newUv[v];
+	}
+	rrMesh->unwrapChannel = unwrapChannel;
+	rrMesh->unwrapWidth = trySize;
+	rrMesh->unwrapHeight = trySize;
+	delete original;
+
+	// update stats
+	sumMeshesUnwrapped++;
+	sumCharts += (unsigned)charts.size();
+	sumVerticesOld += numVertices;
+	sumVerticesNew += numVerticesNew;
+	if (trySize>mapSize)
+		RRReporter::report(WARN,"Mesh %ls needs resolution at least %d (%d charts).\n",keepChannels.objectName.w_str(),trySize,(unsigned)charts.size());
+	return true;
+}
+
+#endif // !_WIN32
+
 unsigned RRObjects::buildUnwrap(unsigned resolution, unsigned minimalUvChannel, unsigned minTrianglesForFastUnwrap, bool& aborting) const
 {
 	RRReportInterval report(INF2,"Building unwrap...\n");
@@ -744,7 +1538,7 @@ try_next_channel:
 
 	// 4. generate unwraps
 	Unwrapper unwrapper;
-#if _MSC_VER<1400 // VS2003
+#if defined(_MSC_VER) && _MSC_VER<1400 // VS2003
 	// serial
 	for (Meshes::const_iterator i=meshes.begin();i!=meshes.end();++i)
 	{
@@ -771,10 +1565,16 @@ try_next_channel:
 		meshesIterators.push_back(iter);
 	}
 	std::sort(meshesIterators.begin(),meshesIterators.end());
+	// meshes that unwrapper splits to parallel tasks go one by one
+	for (unsigned i=0;i<meshesIterators.size();i++)
+	{
+		if (!aborting && unwrapper.unwrapsInParallel(meshesIterators[i].iter->first))
+			unwrapper.buildUnwrap(meshesIterators[i].iter->first,unwrapChannel,meshesIterators[i].iter->second,resolution,2.5f,1,minTrianglesForFastUnwrap,aborting);
+	}
 	#pragma omp parallel for schedule(dynamic)
 	for (int i=0;i<(int)meshesIterators.size();i++)
 	{
-		if (!aborting)
+		if (!aborting && !unwrapper.unwrapsInParallel(meshesIterators[i].iter->first))
 			unwrapper.buildUnwrap(meshesIterators[i].iter->first,unwrapChannel,meshesIterators[i].iter->second,resolution,2.5f,1,minTrianglesForFastUnwrap,aborting);
 	}
 #endif // !VS2003
@@ -790,20 +1590,3 @@ try_next_channel:
 }
 
 } // namespace
-
-#else // !_WIN32
-
-#include "Lightsprint/RRObject.h"
-
-namespace rr
-{
-
-unsigned RRObjects::buildUnwrap(unsigned resolution, unsigned minimalUvChannel, unsigned minTrianglesForFastUnwrap, bool& aborting) const
-{
-	RRReporter::report(WARN,"buildUnwrap() not supported on this platform.\n");
-	return UINT_MAX;
-}
-
-} // namespace
-
-#endif // !_WIN32
@@ -380,20 +380,20 @@ void SVCanvas::createContextCore()
 
 	// try to load lightmaps
 	if (!allObjects.layerExistsInMemory(svs.layerBakedLightmap))
-		allObjects.loadLayer(svs.layerBakedLightmap,LAYER_PREFIX,LMAP_POSTFIX);
+		allObjects.loadLayer(svs.layerBakedLightmap,LAYER_PREFIX,LMAP_POSTFIX,LAYER_THREADS);
 
 	// try to load ambient maps
 	if (!allObjects.layerExistsInMemory(svs.layerBakedAmbient))
-		allObjects.loadLayer(svs.layerBakedAmbient,LAYER_PREFIX,AMBIENT_POSTFIX);
+		allObjects.loadLayer(svs.layerBakedAmbient,LAYER_PREFIX,AMBIENT_POSTFIX,LAYER_THREADS);
 
 	// try to load LDM. if not found, disable it
 	if (!allObjects.layerExistsInMemory(svs.layerBakedLDM))
-		if (!allObjects.loadLayer(svs.layerBakedLDM,LAYER_PREFIX,LDM_POSTFIX))
+		if (!allObjects.loadLayer(svs.layerBakedLDM,LAYER_PREFIX,LDM_POSTFIX,LAYER_THREADS))
 			svs.renderLDM = false;
 
 	// try to load cubemaps
 	if (!allObjects.layerExistsInMemory(svs.layerBakedEnvironment))
-		allObjects.loadLayer(svs.layerBakedEnvironment,LAYER_PREFIX,ENV_POSTFIX);
+		allObjects.loadLayer(svs.layerBakedEnvironment,LAYER_PREFIX,ENV_POSTFIX,LAYER_THREADS);
 
 	// init rest
 	rr::RRReportInterval report(rr::INF3,"Initializing the rest...\n");
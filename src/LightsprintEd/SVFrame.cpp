@@ -958,10 +958,10 @@ void SVFrame::saveBakedLayers()
 {
 	// resave baked layers under new name's directory
 	rr::RRObjects allObjects = m_canvas->solver->getObjects();
-	allObjects.saveLayer(svs.layerBakedLightmap,LAYER_PREFIX,LMAP_POSTFIX);
-	allObjects.saveLayer(svs.layerBakedAmbient,LAYER_PREFIX,AMBIENT_POSTFIX);
-	allObjects.saveLayer(svs.layerBakedEnvironment,LAYER_PREFIX,ENV_POSTFIX);
-	allObjects.saveLayer(svs.layerBakedLDM,LAYER_PREFIX,LDM_POSTFIX);
+	allObjects.saveLayer(svs.layerBakedLightmap,LAYER_PREFIX,LMAP_POSTFIX,LAYER_THREADS);
+	allObjects.saveLayer(svs.layerBakedAmbient,LAYER_PREFIX,AMBIENT_POSTFIX,LAYER_THREADS);
+	allObjects.saveLayer(svs.layerBakedEnvironment,LAYER_PREFIX,ENV_POSTFIX,LAYER_THREADS);
+	allObjects.saveLayer(svs.layerBakedLDM,LAYER_PREFIX,LDM_POSTFIX,LAYER_THREADS);
 }
 
 bool SVFrame::chooseSceneFilename(wxString fileSelectorCaption, wxString& selectedFilename)
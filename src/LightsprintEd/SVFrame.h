@@ -234,6 +234,8 @@ namespace rr_ed
 #define AMBIENT_POSTFIX (svs.lightmapFloats?"indirect.exr":"indirect.png")
 #define LDM_POSTFIX "ldm.png"
 #define ENV_POSTFIX "cube.rrbuffer"
+// maxThreads for loadLayer()/saveLayer(), 0 = parallel, loaders and savers registered by rr_io::registerIO() are thread safe
+#define LAYER_THREADS 0
 
 }; // namespace
 
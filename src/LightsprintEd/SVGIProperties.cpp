@@ -479,9 +479,9 @@ void SVGIProperties::OnPropertyChange(wxPropertyGridEvent& event)
 		// (when user starts SV in LDR mode, only LDR maps are loaded if found, HDR are loaded after checking HDR here)
 		rr::RRObjects allObjects = svframe->m_canvas->solver->getObjects();
 		allObjects.layerDeleteFromMemory(svs.layerBakedLightmap);
-		allObjects.loadLayer(svs.layerBakedLightmap,LAYER_PREFIX,LMAP_POSTFIX);
+		allObjects.loadLayer(svs.layerBakedLightmap,LAYER_PREFIX,LMAP_POSTFIX,LAYER_THREADS);
 		allObjects.layerDeleteFromMemory(svs.layerBakedAmbient);
-		allObjects.loadLayer(svs.layerBakedAmbient,LAYER_PREFIX,AMBIENT_POSTFIX);
+		allObjects.loadLayer(svs.layerBakedAmbient,LAYER_PREFIX,AMBIENT_POSTFIX,LAYER_THREADS);
 	}
 	else
 	if (property==propGILightmapAOIntensity)
@@ -66,8 +66,8 @@ SVMaterialProperties::SVMaterialProperties(SVFrame* _svframe)
 	AppendIn(propSpecular,new wxIntProperty(_("uv")));
 	AppendIn(propSpecular,new ImageFileProperty(_("texture or video"),_("Specular texture or video. Type in c@pture to use live video input. Alpha (if present) modulates shininess/roughness.")));
 	{
-		const wxChar* strings[] = {wxT("Phong"),wxT("Blinn-Phong"),wxT("Torrance-Sparrow (Gaussian)"),wxT("Blinn-Torrance-Sparrow"),nullptr};
-		const long values[] = {rr::RRMaterial::PHONG,rr::RRMaterial::BLINN_PHONG,rr::RRMaterial::TORRANCE_SPARROW,rr::RRMaterial::BLINN_TORRANCE_SPARROW};
+		const wxChar* strings[] = {wxT("Phong"),wxT("Blinn-Phong"),wxT("Torrance-Sparrow (Gaussian)"),wxT("Blinn-Torrance-Sparrow"),wxT("GGX"),nullptr};
+		const long values[] = {rr::RRMaterial::PHONG,rr::RRMaterial::BLINN_PHONG,rr::RRMaterial::TORRANCE_SPARROW,rr::RRMaterial::BLINN_TORRANCE_SPARROW,rr::RRMaterial::GGX};
 		propSpecularModel = new wxEnumProperty(_("model"),wxPG_LABEL,strings,values);
 		propSpecularModel->SetHelpString(_("Changes shape and intensity of specular highlights."));
 		AppendIn(propSpecular,propSpecularModel);
@@ -181,7 +181,7 @@ void SVMaterialProperties::updateHide()
 		HideProperty(propBack,!material);
 		HideProperty(propDiffuse,!material);
 		HideProperty(propSpecular,!material);
-		HideProperty(propSpecularShininess,!material || material->specularModel==rr::RRMaterial::TORRANCE_SPARROW || material->specularModel==rr::RRMaterial::BLINN_TORRANCE_SPARROW);
+		HideProperty(propSpecularShininess,!material || material->specularModel==rr::RRMaterial::TORRANCE_SPARROW || material->specularModel==rr::RRMaterial::BLINN_TORRANCE_SPARROW || material->specularModel==rr::RRMaterial::GGX);
 		HideProperty(propSpecularRoughness,!material || material->specularModel==rr::RRMaterial::PHONG || material->specularModel==rr::RRMaterial::BLINN_PHONG);
 		HideProperty(propEmissive,!material);
 		HideProperty(propTransparent,!material);
@@ -453,6 +453,7 @@ void SVMaterialProperties::OnPropertyChange(wxPropertyGridEvent& event)
 				break;
 			case rr::RRMaterial::TORRANCE_SPARROW:
 			case rr::RRMaterial::BLINN_TORRANCE_SPARROW:
+			case rr::RRMaterial::GGX:
 				if (wasShininess)
 					material->specularShininess = 1/(material->specularShininess+1);
 				RR_CLAMP(material->specularShininess,0,1);
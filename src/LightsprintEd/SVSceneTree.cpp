@@ -840,7 +840,7 @@ void SVSceneTree::runContextMenuAction(unsigned actionCode, const EntityIds cont
 						// delete old .exr files that would obscure new .rrbuffer files
 						selectedObjects.layerDeleteFromDisk(LAYER_PREFIX,ambient?AMBIENT_POSTFIX:LMAP_POSTFIX);
 						// save temp layer to .exr/.rrbuffer
-						selectedObjects.saveLayer(tmpLayer,LAYER_PREFIX,ambient?AMBIENT_POSTFIX:LMAP_POSTFIX);
+						selectedObjects.saveLayer(tmpLayer,LAYER_PREFIX,ambient?AMBIENT_POSTFIX:LMAP_POSTFIX,LAYER_THREADS);
 
 						// delete vertex buffers from memory (otherwise we would convert them to 8bit and save over .rrbuffer)
 						for (unsigned objectIndex=0;objectIndex<selectedObjects.size();objectIndex++)
@@ -856,7 +856,7 @@ void SVSceneTree::runContextMenuAction(unsigned actionCode, const EntityIds cont
 						// delete old .png files that would obscure new .rrbuffer files
 						selectedObjects.layerDeleteFromDisk(LAYER_PREFIX,ambient?AMBIENT_POSTFIX:LMAP_POSTFIX);
 						// save temp layer to .png
-						selectedObjects.saveLayer(tmpLayer,LAYER_PREFIX,ambient?AMBIENT_POSTFIX:LMAP_POSTFIX);
+						selectedObjects.saveLayer(tmpLayer,LAYER_PREFIX,ambient?AMBIENT_POSTFIX:LMAP_POSTFIX,LAYER_THREADS);
 						
 						// switch to original mode
 						svs.lightmapFloats = hdr;
@@ -866,7 +866,7 @@ void SVSceneTree::runContextMenuAction(unsigned actionCode, const EntityIds cont
 
 						// load final layer from disk
 						// (this can be optimized away if we create copy of HDR)
-						selectedObjects.loadLayer(ambient?svs.layerBakedAmbient:svs.layerBakedLightmap,LAYER_PREFIX,ambient?AMBIENT_POSTFIX:LMAP_POSTFIX);
+						selectedObjects.loadLayer(ambient?svs.layerBakedAmbient:svs.layerBakedLightmap,LAYER_PREFIX,ambient?AMBIENT_POSTFIX:LMAP_POSTFIX,LAYER_THREADS);
 
 						// make results visible
 						svs.renderLightIndirect = ambient?LI_AMBIENTMAPS:LI_LIGHTMAPS;
@@ -905,7 +905,7 @@ void SVSceneTree::runContextMenuAction(unsigned actionCode, const EntityIds cont
 						delete newEnv;
 
 						// save temp layer
-						allObjects.saveLayer(tmpLayer,LAYER_PREFIX,LDM_POSTFIX);
+						allObjects.saveLayer(tmpLayer,LAYER_PREFIX,LDM_POSTFIX,LAYER_THREADS);
 
 						// move buffers from temp to final layer
 						for (unsigned i=0;i<selectedObjects.size();i++)
@@ -968,7 +968,7 @@ void SVSceneTree::runContextMenuAction(unsigned actionCode, const EntityIds cont
 				}
 
 				// save cubes
-				selectedObjects.saveLayer(svs.layerBakedEnvironment,LAYER_PREFIX,ENV_POSTFIX);
+				selectedObjects.saveLayer(svs.layerBakedEnvironment,LAYER_PREFIX,ENV_POSTFIX,LAYER_THREADS);
 			}
 			break;
 
@@ -990,6 +990,7 @@ void SVSceneTree::runContextMenuAction(unsigned actionCode, const EntityIds cont
 					selectedObjects[i]->faceGroups.resize(1);
 					selectedObjects[i]->faceGroups[0].numTriangles = selectedObjects[i]->getCollider()->getMesh()->getNumTriangles();
 					selectedObjects[i]->faceGroups[0].material = selectedObjects[0]->faceGroups[0].material;
+					selectedObjects[i]->faceGroupsVersion++;
 				}
 			}
 			break;
@@ -14,9 +14,7 @@
 #include <algorithm> // sort
 #include <map>
 #include <cstdio>
-#ifndef SORT_MATERIALS
-	#include <unordered_map>
-#endif
+#include <unordered_map>
 #include "Lightsprint/GL/PluginScene.h"
 #include "Lightsprint/GL/PreserveState.h"
 #include "Lightsprint/GL/RRSolverGL.h"
@@ -137,9 +135,25 @@ class PluginRuntimeScene : public PluginRuntime
 	ShaderFaceGroups nonBlendedFaceGroupsMap[MAX_RECURSION_DEPTH]; // used in whole render(), indexed by [recursionDepth]
 	//! Gathered blended object information.
 	rr::RRVector<FaceGroupRange> blendedFaceGroups[MAX_RECURSION_DEPTH]; // used in whole render(), indexed by [recursionDepth]
+	//! Gathered visibility of objects in current pass.
+	rr::RRVector<bool> visibleObjects[MAX_RECURSION_DEPTH]; // used in first half of render(), indexed by [recursionDepth]
 	//! usually 0, can grow to 1 or even 2 when render() calls render() because of mirror or updateEnvironmentMap()
 	int recursionDepth;
 
+	// PERMANENT ALLOCATION, PERMANENT CONTENT
+	//! Hierarchy of object collection we render, for frustum and occlusion culling.
+	struct ObjectBVH
+	{
+		rr::RRObjectBVH* bvh;
+		const rr::RRSolver* solver; // collection address is trusted only while it belongs to the same solver
+		unsigned lastRender; // numRenders when it was used last time
+	};
+	//! Hierarchies are found by address of collection, entries not used for a while are deleted,
+	//! so address of deleted collection reused by new one is not mistaken for old one.
+	std::unordered_map<const rr::RRObjects*,ObjectBVH> objectBVHs;
+	enum { MAX_UNUSED_BVH_RENDERS = 100 }; // hierarchy not used in this number of renders is deleted
+	unsigned numRenders;
+
 	NamedCounter countScene;
 	NamedCounter countSceneMirror;
 	NamedCounter countSceneMirrorPlane;
@@ -162,6 +176,7 @@ public:
 		mirrorMaskMap = rr::RRBuffer::create(rr::BT_2D_TEXTURE,16,16,1,rr::BF_RGB,true,RR_GHOST_BUFFER);
 #endif
 		recursionDepth = -1;
+		numRenders = 0;
 		params.counters =
 			countScene.init("scene",
 			countSceneMirror.init("scene.mirror",
@@ -194,6 +209,20 @@ public:
 
 		recursionDepth++; // no "return" or throw from this function allowed, we must reach recursionDepth-- at the end
 
+		numRenders++;
+		if (!recursionDepth)
+		{
+			for (auto i=objectBVHs.begin();i!=objectBVHs.end();)
+				if (numRenders-i->second.lastRender>MAX_UNUSED_BVH_RENDERS)
+				{
+					// collection was probably deleted, forget it before its address is reused
+					delete i->second.bvh;
+					i = objectBVHs.erase(i);
+				}
+				else
+					++i;
+		}
+
 		// copy, so that we can modify some parameters
 		PluginParamsScene _ = pp;
 		PluginParamsShared sp = _sp;
@@ -301,10 +330,28 @@ public:
 					objects = &_.solver->getDynamicObjects();
 					break;
 			}
+			// multiObject is always visible, other collections are culled by hierarchy
+			const rr::RRVector<bool>* visible = nullptr;
+			if (pass && _.frustumCulling && !_.uberProgramSetup.FORCE_2D_POSITION)
+			{
+				ObjectBVH& objectBVH = objectBVHs[objects];
+				if (objectBVH.bvh && objectBVH.solver==_.solver)
+					objectBVH.bvh->update(*objects);
+				else
+				{
+					// new collection, or old address reused by different solver or collection
+					delete objectBVH.bvh;
+					objectBVH.bvh = rr::RRObjectBVH::create(*objects);
+					objectBVH.solver = _.solver;
+				}
+				objectBVH.lastRender = numRenders;
+				objectBVH.bvh->cull(*sp.camera,_.occlusionCullingResolution,visibleObjects[recursionDepth]);
+				visible = &visibleObjects[recursionDepth];
+			}
 			for (unsigned i=0;i<objects->size();i++)
 			{
 				rr::RRObject* object = (*objects)[i];
-				if (object && object->enabled)// && !_camera->frustumCull(object))
+				if (object && object->enabled && (!visible || (*visible)[i]))
 				{
 					const rr::RRMesh* mesh = object->getCollider()->getMesh();
 					rr::RRObjectIllumination& illumination = object->illumination;
@@ -925,6 +972,8 @@ public:
 #endif
 
 		delete uberProgram;
+		for (auto& objectBVH : objectBVHs)
+			delete objectBVH.second.bvh;
 		for (recursionDepth=0;recursionDepth<MAX_RECURSION_DEPTH;recursionDepth++)
 			for (ShaderFaceGroups::iterator i=nonBlendedFaceGroupsMap[recursionDepth].begin();i!=nonBlendedFaceGroupsMap[recursionDepth].end();++i)
 				delete i->second;
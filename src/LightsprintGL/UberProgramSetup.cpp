@@ -826,6 +826,7 @@ float getMipLevel(const rr::RRMaterial* material)
 				return -log(shininess)*0.4f;
 			}
 		case rr::RRMaterial::BLINN_TORRANCE_SPARROW:
+		case rr::RRMaterial::GGX:
 			{
 				float shininess = RR_CLAMPED(material->specularShininess*material->specularShininess,1e-10f,1);
 				return -log(shininess)*0.4f;
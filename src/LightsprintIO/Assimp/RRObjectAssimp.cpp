@@ -167,6 +167,24 @@ public:
 				}
 			}
 
+#ifdef AI_MATKEY_ROUGHNESS_FACTOR
+			// PBR metallic/roughness (glTF etc., assimp 5.1+)
+			{
+				float roughness;
+				if (model!=aiShadingMode_NoShading && aimaterial->Get(AI_MATKEY_ROUGHNESS_FACTOR,roughness)==AI_SUCCESS)
+				{
+					float metallic = 0;
+					aimaterial->Get(AI_MATKEY_METALLIC_FACTOR,metallic);
+					material.specularModel = RRMaterial::GGX;
+					material.specularShininess = roughness;
+					// dielectric reflects 4% at normal incidence, metal reflects its base color and has no diffuse reflection
+					material.specularReflectance.color = RRVec3(0.04f)*(1-metallic) + material.diffuseReflectance.color*metallic;
+					if (!material.diffuseReflectance.texture)
+						material.diffuseReflectance.color *= 1-metallic;
+				}
+			}
+#endif
+
 			// diffuseEmittance
 			convertMaterialProperty(aimaterial,aiTextureType_EMISSIVE,AI_MATKEY_COLOR_EMISSIVE,material,material.diffuseEmittance);
 
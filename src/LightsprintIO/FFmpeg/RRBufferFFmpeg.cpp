@@ -40,6 +40,10 @@
 #include <cstdio>
 #include <cstdlib>
 #include <queue>
+#include <vector>
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
 
 // audio (by portaudio)
 #include "portaudio.h"
@@ -67,10 +71,24 @@ extern "C"
 #pragma comment(lib,"avutil.lib")
 #pragma comment(lib,"swscale.lib")
 
+// FFmpeg 5 removed avcodec_decode_video2/audio4() and AVStream::codec, replacements exist since FFmpeg 3.1
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57,37,100)
+	#define RR_AV_SEND_RECEIVE
+#endif
+// FFmpeg 5.1 replaced channels with ch_layout
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(59,24,100)
+	#define RR_AV_CH_LAYOUT
+#endif
+// SUPPORT_LIBAV is often satisfied by FFmpeg (micro version 100+), only libav itself lacks best effort timestamp
+#if defined(SUPPORT_LIBAV) && LIBAVCODEC_VERSION_MICRO<100
+	#define RR_LIBAV_PTS_CORRECTION
+#endif
+
 using namespace rr;
 
-#define MAX_IMAGE_QUEUE_LENGTH 30
+#define FRAME_RING_SIZE 16 // converted frames waiting for update(), power of two
 #define MAX_PACKET_QUEUE_LENGTH 30
+#define MIN_SWS_BAND_HEIGHT 64 // frame is converted in horizontal bands in parallel, bands are not thinner than this
 #define SEEK_SECONDS_BACK 0 // it seems that seek(x) goes to first keyframe after x, so after seek(x) we might be at x+2. if we want x exactly, we can try seek(x-few seconds), then video_proc automatically decodes until reaching x
 #define SKIP_SEEK_SECONDS_FORWARD 2 // when stopped and seek(x) means going little bit forward, do nothing, video_proc automatically decodes until reaching x
 
@@ -94,34 +112,71 @@ struct AVPacketWrapper : public AVPacket
 	}
 	virtual ~AVPacketWrapper()
 	{
+#ifdef RR_AV_SEND_RECEIVE
+		av_packet_unref(this);
+#else
 		av_free_packet(this);
+#endif
 	}
 };
 
 //! Optional extension, for debugging.
 
 //! demux_proc can send nullptr or SeekPacket to tell audio/video_proc to seek, both work.
-//! SeekPacket holds extra data for debugging.
+//! SeekPacket holds extra data for debugging and seekGeneration of frames that follow.
 struct SeekPacket : public AVPacketWrapper
 {
-	SeekPacket(double _seekSeconds)
+	SeekPacket(double _seekSeconds, unsigned _seekGeneration)
 	{
 		seekSeconds = _seekSeconds;
+		seekGeneration = _seekGeneration;
 	}
 	double seekSeconds;
+	unsigned seekGeneration;
+};
+
+//! demux_proc sends DrainPacket at the end of stream, video_proc then takes frames that decoder still holds.
+//! With frame threading, decoder outputs frames several packets later.
+struct DrainPacket : public AVPacketWrapper
+{
+	DrainPacket()
+	{
+		data = nullptr;
+		size = 0;
+	}
 };
 
+//! Decodes next frame of packet to avFrame, returns false when packet has no more frames.
+//! Call it with first=true for new packet, then with first=false until it returns false.
+static bool decodeFrame(AVCodecContext* avCodecContext, AVPacket* avPacket, bool first, AVFrame* avFrame)
+{
+#ifdef RR_AV_SEND_RECEIVE
+	if (first && avcodec_send_packet(avCodecContext, avPacket)<0)
+		return false;
+	return !avcodec_receive_frame(avCodecContext, avFrame);
+#else
+	// one frame per packet, only DrainPacket is decoded repeatedly
+	if (!first && avPacket->data)
+		return false;
+	int got_frame = 0;
+	if (avCodecContext->codec_type==AVMEDIA_TYPE_AUDIO)
+		avcodec_decode_audio4(avCodecContext, avFrame, &got_frame, avPacket);
+	else
+		avcodec_decode_video2(avCodecContext, avFrame, &got_frame, avPacket);
+	return got_frame!=0;
+#endif
+}
+
 
 //////////////////////////////////////////////////////////////////////////////
 //
 // Queue
 
-//! Generic thread safe queue.
+//! Generic thread safe queue, pop is blocking.
 template<class C>
 class Queue
 {
 public:
-	// for packet queues, pop is blocking
 	void push(C c)
 	{
 		std::lock_guard<std::mutex> lock(mutex);
@@ -144,30 +199,6 @@ public:
 		return nullptr;
 	}
 
-	// for image queue, push is blocking
-	void blocking_push(C c, bool& aborting)
-	{
-		std::unique_lock<std::mutex> lock(mutex);
-		while (!aborting && queue.size()>=MAX_IMAGE_QUEUE_LENGTH)
-			cond.wait(lock); // blocking [#50]
-		queue.push(c);
-	}
-	// pop all older elements, return the newest one of them (delete others)
-	C pop_older(double seconds)
-	{
-		C result = nullptr;
-		std::lock_guard<std::mutex> lock(mutex);
-		while (!queue.empty() && (queue.front()->pts<seconds || !queue.front()->dbg_numImagesSinceSeek)) // always pop if it is first frame after seek
-		{
-			delete result;
-			result = queue.front();
-			queue.pop();
-		}
-		if (result)
-			cond.notify_one();
-		return result;
-	}
-
 	void clear()
 	{
 		std::lock_guard<std::mutex> lock(mutex);
@@ -176,7 +207,7 @@ public:
 			delete queue.front();
 			queue.pop();
 		}
-		cond.notify_one(); // wake up [#50], [#61], [#62]
+		cond.notify_one(); // wake up [#61], [#62]
 	}
 	size_t size()
 	{
@@ -200,32 +231,80 @@ private:
 
 struct VideoPicture
 {
-	//AVFrame* avFrame;
-	RRBuffer* buffer;
+	RRBuffer* buffer; // allocated for first frame, reused for next frames
 	double pts;
+	unsigned seekGeneration; // frames decoded before the most recent seek are not shown
 	// debugging info
 	double dbg_seekSeconds;
 	unsigned dbg_numImagesSinceStart;
 	unsigned dbg_numImagesSinceSeek;
 
-	// _format can be calculated from _avFrame, but caller already knows it
-	VideoPicture(AVFrame*& _avFrame, double _pts, rr::RRBufferFormat _format)
+	VideoPicture()
 	{
-		//avFrame = _avFrame;
-		//_avFrame = NULL;
-		buffer = RRBuffer::create(BT_2D_TEXTURE, _avFrame->width, _avFrame->height, 1, _format, true, nullptr);
-//		buffer = RRBuffer::create(BT_2D_TEXTURE, _avFrame->width, _avFrame->height, 1, BF_LUMINANCE, true, _avFrame->data[0]); // SDL_YV12_OVERLAY, screen
-//		sws_scale(video_swsContext, (uint8_t const * const *)avFrame->data, avFrame->linesize, 0, video_avCodecContext->height, avFrameRGB->data, avFrameRGB->linesize);
-		pts = _pts;
+		buffer = nullptr;
+		pts = 0;
+		seekGeneration = 0;
+		dbg_seekSeconds = -1;
+		dbg_numImagesSinceStart = 0;
+		dbg_numImagesSinceSeek = 0;
 	}
 	~VideoPicture()
 	{
-		//av_frame_free(&avFrame);
 		delete buffer;
 	}
 };
 
 
+//////////////////////////////////////////////////////////////////////////////
+//
+// FrameRing
+
+//! Ring of converted frames, with lock-free handoff from single producer (video_proc) to single consumer (update()).
+//! Slots are never reallocated, consumer swaps buffer of the frame it shows with its previously visible one.
+class FrameRing
+{
+public:
+	FrameRing()
+	{
+		written = 0;
+		read = 0;
+	}
+
+	// producer: returns slot for next frame, nullptr if ring is full
+	VideoPicture* beginWrite()
+	{
+		unsigned w = written.load(std::memory_order_relaxed);
+		return (w-read.load(std::memory_order_acquire)<FRAME_RING_SIZE) ? &slots[w%FRAME_RING_SIZE] : nullptr;
+	}
+	// producer: publishes slot filled after beginWrite()
+	void endWrite()
+	{
+		written.store(written.load(std::memory_order_relaxed)+1,std::memory_order_release);
+	}
+
+	// consumer: number of frames ready
+	unsigned size() const
+	{
+		return written.load(std::memory_order_acquire)-read.load(std::memory_order_relaxed);
+	}
+	// consumer: i-th oldest ready frame, i<size()
+	VideoPicture& peek(unsigned i)
+	{
+		return slots[(read.load(std::memory_order_relaxed)+i)%FRAME_RING_SIZE];
+	}
+	// consumer: returns n oldest frames to producer
+	void pop(unsigned n)
+	{
+		read.store(read.load(std::memory_order_relaxed)+n,std::memory_order_release);
+	}
+
+private:
+	VideoPicture slots[FRAME_RING_SIZE];
+	std::atomic<unsigned> written; // number of frames ever written, changed by producer
+	std::atomic<unsigned> read;    // number of frames ever popped, changed by consumer
+};
+
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // Player
@@ -244,7 +323,8 @@ public:
 		format = rr::BF_RGB;
 		duration = -1; // unknown
 		stoppedSecondsFromStart = 0;
-		seekSecondsFromStart = -1; // no seek
+		seekSecondsFromStart = 0;
+		seekGeneration = 0;
 		aborting = false;
 
 		demux_working = false;
@@ -253,16 +333,25 @@ public:
 		audio_streamIndex = -1;
 		audio_avStream = nullptr;
 		audio_avCodecContext = nullptr;
+		audio_numChannels = 0;
 
 		video_streamIndex = -1;
 		video_avStream = nullptr;
 		video_avCodecContext = nullptr;
-		video_swsContext = nullptr;
+		video_bandHeight = 0;
+		video_chromaShift = 0;
+		video_frameSeconds = 1/30.;
+		video_drainedGeneration = ~0u;
 
-		image_visible = nullptr;
+		stats_decoded = 0;
+		stats_shown = 0;
+		stats_dropped = 0;
+		stats_late = 0;
 
 		// open file and start decoding first frame on background
-		av_register_all();		
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58,9,100)
+		av_register_all(); // not needed since FFmpeg 4.0
+#endif
 		open_file(_filename); // we can call this from demux_thread, but we prefer blocking until width/height/duration are known
 		if (hasAudio() || hasVideo()) // hasXxx works only after open_file()
 			demux_thread = std::thread(&FFmpegPlayer::demux_proc, this);
@@ -281,21 +370,22 @@ public:
 		}
 		if (video_thread.joinable())
 		{
-			image_queue.clear(); // wake up video_proc if blocked in [#50]
 			video_packetQueue.clear(); // wake up video_proc if blocked in [#61]
 			video_thread.join();
 		}
 
 		// ffmpeg audio (producer)
 		audio_avStream = nullptr;
-		audio_avCodecContext = nullptr;
+		avcodec_free_context(&audio_avCodecContext);
 
 		// ffmpeg video (producer)
 		video_avStream = nullptr;
-		video_avCodecContext = nullptr;
+		avcodec_free_context(&video_avCodecContext);
+		for (unsigned i=0;i<video_swsContexts.size();i++)
+			sws_freeContext(video_swsContexts[i]);
 
-		// yuv images (consumer)
-		RR_SAFE_DELETE(image_visible);
+		// demux
+		avformat_close_input(&avFormatContext);
 	}
 
 	bool hasAudio()
@@ -343,10 +433,10 @@ public:
 		unsigned bufBytes = 0;
 
 		PaSampleFormat pa_sampleFormat = convert(audio_avCodecContext->sample_fmt);
-		err = Pa_OpenDefaultStream(&pa_stream, 0, audio_avCodecContext->channels, pa_sampleFormat, audio_avCodecContext->sample_rate, paFramesPerBufferUnspecified, nullptr, nullptr );
+		err = Pa_OpenDefaultStream(&pa_stream, 0, audio_numChannels, pa_sampleFormat, audio_avCodecContext->sample_rate, paFramesPerBufferUnspecified, nullptr, nullptr );
 		if (err!=paNoError)
 		{
-			err = Pa_OpenDefaultStream(&pa_stream, 0, audio_avCodecContext->channels, pa_sampleFormat^paNonInterleaved, audio_avCodecContext->sample_rate, paFramesPerBufferUnspecified, nullptr, nullptr );
+			err = Pa_OpenDefaultStream(&pa_stream, 0, audio_numChannels, pa_sampleFormat^paNonInterleaved, audio_avCodecContext->sample_rate, paFramesPerBufferUnspecified, nullptr, nullptr );
 			if (err==paNoError)
 			{
 				//unsigned sampleBytes = Pa_GetSampleSize(pa_sampleFormat); // in one channel
@@ -363,7 +453,7 @@ public:
 			}
 			else
 			{
-				rr::RRReporter::report(rr::WARN,"Pa_OpenDefaultStream()=%d, channels=%d, format=%d->0x%x, rate=%d\n",(int)err,(int)audio_avCodecContext->channels,(int)audio_avCodecContext->sample_fmt,(int)pa_sampleFormat,(int)audio_avCodecContext->sample_rate);
+				rr::RRReporter::report(rr::WARN,"Pa_OpenDefaultStream()=%d, channels=%d, format=%d->0x%x, rate=%d\n",(int)err,(int)audio_numChannels,(int)audio_avCodecContext->sample_fmt,(int)pa_sampleFormat,(int)audio_avCodecContext->sample_rate);
 				return -1;
 			}
 		}
@@ -388,13 +478,13 @@ public:
 				AVPacketWrapper* avPacket = audio_packetQueue.blocking_pop(aborting); // blocking [#62]
 				if (avPacket)
 				{
-					int got_frame = 0;
-					avcodec_decode_audio4(audio_avCodecContext, avFrame, &got_frame, avPacket);
-					if (got_frame && avFrame->nb_samples)
+					for (bool first=true; decodeFrame(audio_avCodecContext, avPacket, first, avFrame); first=false)
 					{
+						if (!avFrame->nb_samples)
+							continue;
 						unsigned sampleBytes = Pa_GetSampleSize(pa_sampleFormat); // in one channel
 						unsigned channelBytes = sampleBytes*avFrame->nb_samples;
-						unsigned allBytes = channelBytes*audio_avCodecContext->channels;
+						unsigned allBytes = channelBytes*audio_numChannels;
 						if (buf && allBytes>bufBytes)
 							RR_SAFE_DELETE_ARRAY(buf);
 						if (convert_to_interleaved)
@@ -403,7 +493,7 @@ public:
 								buf = new char[bufBytes=allBytes];
 							char* dst = buf;
 							for (unsigned s=0;s<avFrame->nb_samples;s++)
-								for (unsigned c=0;c<audio_avCodecContext->channels;c++)
+								for (unsigned c=0;c<audio_numChannels;c++)
 								{
 									memcpy(dst,&avFrame->data[c][s*sampleBytes],sampleBytes);
 									dst += sampleBytes;
@@ -417,7 +507,7 @@ public:
 							char* bufPtrs[8] = {buf,buf+channelBytes,buf+2*channelBytes,buf+3*channelBytes,buf+4*channelBytes,buf+5*channelBytes,buf+6*channelBytes,buf+7*channelBytes};
 							uint8_t* src = avFrame->data[0];
 							for (unsigned s=0;s<avFrame->nb_samples;s++)
-								for (unsigned c=0;c<audio_avCodecContext->channels;c++)
+								for (unsigned c=0;c<audio_numChannels;c++)
 								{
 									memcpy(&bufPtrs[c][s*sampleBytes],src,sampleBytes);
 									src += sampleBytes;
@@ -460,7 +550,7 @@ public:
 	// video_proc
 	/////////////////////////////////////////////////////////////////////////
 
-#ifdef SUPPORT_LIBAV
+#ifdef RR_LIBAV_PTS_CORRECTION
 	// libav
 	struct PtsCorrectionContext
 	{
@@ -503,6 +593,7 @@ public:
 		double dbg_seekSeconds = -1;
 		unsigned dbg_numImagesSinceStart = 0;
 		unsigned imagesPushedSinceSeek = 0;
+		unsigned generation = 0; // seekGeneration of frames being decoded
 		while (!aborting)
 		{
 			AVPacketWrapper* avPacket = video_packetQueue.blocking_pop(aborting); // blocking [#61]
@@ -516,57 +607,100 @@ public:
 			{
 				// empty packet = new data after seek are coming, we should clean up old data
 				avcodec_flush_buffers(video_avCodecContext);
-				image_queue.clear(); // remove old images, step 2 (something possibly pushed since step 1)
 				imagesPushedSinceSeek = 0;
 				dbg_seekSeconds = seekPacket ? seekPacket->seekSeconds : -1;
+				if (seekPacket)
+					generation = seekPacket->seekGeneration; // frames of older generation are skipped by update()
 				delete seekPacket;
 				continue;
 			}
-			int got_frame = 0;
 			if (!avFrame)
 				avFrame = av_frame_alloc();
-			avcodec_decode_video2(video_avCodecContext, avFrame, &got_frame, avPacket);
-#ifdef SUPPORT_LIBAV
-			int64_t pts = guess_correct_pts(&ptsCorrectionContext,avFrame->pkt_pts,avFrame->pkt_dts);
+			// with frame threading, frames come several packets later, DrainPacket takes all frames that decoder still holds
+			for (bool first=true; !aborting && decodeFrame(video_avCodecContext, avPacket, first, avFrame); first=false)
+			{
+#if defined(RR_LIBAV_PTS_CORRECTION)
+				int64_t pts = guess_correct_pts(&ptsCorrectionContext,avFrame->pkt_pts,avFrame->pkt_dts);
+#elif defined(RR_AV_SEND_RECEIVE)
+				int64_t pts = avFrame->best_effort_timestamp;
 #else
-			int64_t pts = av_frame_get_best_effort_timestamp(avFrame);
+				int64_t pts = av_frame_get_best_effort_timestamp(avFrame);
 #endif
-			if (pts==AV_NOPTS_VALUE)
-			{
-				pts = 0;
-			}
-			if (got_frame)
-			{
-				VideoPicture* image_inProgress = new VideoPicture(avFrame, pts * av_q2d(video_avStream->time_base), format);
-				RRBuffer* buffer = image_inProgress->buffer;
-				if (buffer)
+				if (pts==AV_NOPTS_VALUE)
 				{
-					unsigned bypp = (format==rr::BF_RGB)?3:((format==rr::BF_RGBA)?4:1);
-					unsigned char* data = buffer->lock(rr::BL_DISCARD_AND_WRITE);
-					uint8_t* dst[] = {data+buffer->getWidth()*(buffer->getHeight()-1)*bypp, nullptr};
-					int dstStride[] = {(int)bypp*-(int)buffer->getWidth(), 0};
-					sws_scale(video_swsContext, (uint8_t const * const *)avFrame->data, avFrame->linesize, 0, video_avCodecContext->height, dst, dstStride);
-					buffer->unlock();
-					image_inProgress->dbg_seekSeconds = dbg_seekSeconds;
-					image_inProgress->dbg_numImagesSinceStart = dbg_numImagesSinceStart;
-					image_inProgress->dbg_numImagesSinceSeek = imagesPushedSinceSeek;
-					dbg_numImagesSinceStart++;
-					imagesPushedSinceSeek++;
-					image_queue.blocking_push(image_inProgress,aborting); // blocking [#50]
+					pts = 0;
 				}
-				else
+				stats_decoded++;
+				VideoPicture* image_inProgress = video_waitForSlot(generation); // blocking [#50]
+				if (image_inProgress)
 				{
-					// when something goes terribly wrong and we run out of memory, this is the most likely allocation failure
-					delete image_inProgress;
-					RR_LIMITED_TIMES(1,RRReporter::report(ERRO,"Video playback run out of address space.\n"));
+					if (video_convert(avFrame,image_inProgress))
+					{
+						image_inProgress->pts = pts * av_q2d(video_avStream->time_base);
+						image_inProgress->seekGeneration = generation;
+						image_inProgress->dbg_seekSeconds = dbg_seekSeconds;
+						image_inProgress->dbg_numImagesSinceStart = dbg_numImagesSinceStart;
+						image_inProgress->dbg_numImagesSinceSeek = imagesPushedSinceSeek;
+						dbg_numImagesSinceStart++;
+						imagesPushedSinceSeek++;
+						video_ring.endWrite();
+					}
+					else
+					{
+						// when something goes terribly wrong and we run out of memory, this is the most likely allocation failure
+						RR_LIMITED_TIMES(1,RRReporter::report(ERRO,"Video playback run out of address space.\n"));
+					}
 				}
 			}
+			if (dynamic_cast<DrainPacket*>(avPacket))
+				video_drainedGeneration = generation; // all frames of this generation are in video_ring, update() can loop
 			delete avPacket;
 		}
 		av_frame_free(&avFrame);
 		return 0;
 	}
 
+	// Returns free slot in video_ring, waits while ring is full.
+	// Returns nullptr if frame is not needed because of abort or seek.
+	VideoPicture* video_waitForSlot(unsigned generation)
+	{
+		while (!aborting && seekGeneration==generation)
+		{
+			VideoPicture* image = video_ring.beginWrite();
+			if (image)
+				return image;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1)); // blocking [#50], update() frees slots
+		}
+		return nullptr;
+	}
+
+	// Converts frame to image->buffer, in horizontal bands in parallel.
+	bool video_convert(AVFrame* avFrame, VideoPicture* image)
+	{
+		if (!image->buffer)
+			image->buffer = RRBuffer::create(BT_2D_TEXTURE, width, height, 1, format, true, nullptr);
+		unsigned char* data = image->buffer ? image->buffer->lock(rr::BL_DISCARD_AND_WRITE) : nullptr;
+		if (!data)
+			return false;
+		unsigned bypp = (format==rr::BF_RGB)?3:((format==rr::BF_RGBA)?4:1);
+		int numBands = (int)video_swsContexts.size();
+		#pragma omp parallel for schedule(static) if(numBands>1)
+		for (int b=0;b<numBands;b++)
+		{
+			unsigned y = b*video_bandHeight;
+			unsigned bandHeight = RR_MIN(video_bandHeight,height-y);
+			const uint8_t* src[4];
+			for (unsigned p=0;p<4;p++)
+				src[p] = avFrame->data[p] ? avFrame->data[p] + (ptrdiff_t)((p==1 || p==2) ? (y>>video_chromaShift) : y)*avFrame->linesize[p] : nullptr;
+			// buffer is upside down
+			uint8_t* dst[] = {data+(size_t)width*(height-1-y)*bypp, nullptr};
+			int dstStride[] = {(int)bypp*-(int)width, 0};
+			sws_scale(video_swsContexts[b], src, avFrame->linesize, 0, bandHeight, dst, dstStride);
+		}
+		image->buffer->unlock();
+		return true;
+	}
+
 
 	/////////////////////////////////////////////////////////////////////////
 	// demux_proc
@@ -577,22 +711,25 @@ public:
 		AVFrame* avFrame = av_frame_alloc();
 		//open_file();
 		demux_working = true;
+		unsigned demux_seekGeneration = 0;
 		while (!aborting)
 		{
 			// seek
-			if (seekSecondsFromStart>=0)
+			unsigned generation = seekGeneration;
+			if (generation!=demux_seekGeneration)
 			{
+				// seekSecondsFromStart was written before seekGeneration, it is at least as new as generation
+				float seconds = seekSecondsFromStart;
+				demux_seekGeneration = generation;
 				demux_working = true;
 				audio_packetQueue.clear();
 				video_packetQueue.clear();
-				image_queue.clear(); // remove old images, step 1 (if video_proc is blocked in blocking_push, this unblocks it)
 				if (hasAudio())
 					audio_packetQueue.push(nullptr); // avcodec_flush_buffers()
 				if (hasVideo())
-					video_packetQueue.push(new SeekPacket(seekSecondsFromStart)); // avcodec_flush_buffers() + proper clearing of image_ready and image_inProgress
-				RR_DEBUG(int err =) av_seek_frame(avFormatContext, -1, (int64_t)(RR_MAX(0,seekSecondsFromStart-SEEK_SECONDS_BACK) * AV_TIME_BASE), AVSEEK_FLAG_BACKWARD); //|AVSEEK_FLAG_ANY
+					video_packetQueue.push(new SeekPacket(seconds,generation)); // avcodec_flush_buffers() + new generation of frames (video_proc drops old frames itself, update() skips old frames in video_ring)
+				RR_DEBUG(int err =) av_seek_frame(avFormatContext, -1, (int64_t)(RR_MAX(0,seconds-SEEK_SECONDS_BACK) * AV_TIME_BASE), AVSEEK_FLAG_BACKWARD); //|AVSEEK_FLAG_ANY
 				RR_ASSERT(err >= 0); // seek failed
-				seekSecondsFromStart = -1;
 			}
 
 			if (std::min(hasVideo()?video_packetQueue.size():1000,hasAudio()?audio_packetQueue.size():1000)>MAX_PACKET_QUEUE_LENGTH || !demux_working)
@@ -610,6 +747,9 @@ public:
 					delete avPacket;
 					if (err==AVERROR_EOF) // ffplay tests also avio_feof(avFormatContext->pb), but notes that it's hack
 					{
+						// let video_proc take frames that decoder still holds
+						if (hasVideo())
+							video_packetQueue.push(new DrainPacket);
 						// this makes demux_proc sleep until main thread requests seek
 						demux_working = false;
 					}
@@ -653,34 +793,67 @@ public:
 		}
 	}
 
-	AVCodecContext* open_stream(int stream_index)
+	static AVMediaType getMediaType(const AVStream* avStream)
+	{
+#ifdef RR_AV_SEND_RECEIVE
+		return avStream->codecpar->codec_type;
+#else
+		return avStream->codec->codec_type;
+#endif
+	}
+
+	#define AV_ERROR_MAX_STRING_SIZE 64
+	//#define REPORT(func) RRReporter::report(WARN,LIB_NAME ": " func "()=%c%c%c%c\n",char(-err),char((-err)>>8),char((-err)>>16),char((-err)>>24))
+	#define REPORT(func,err) { \
+		char tmp[AV_ERROR_MAX_STRING_SIZE]; \
+		av_strerror(err,tmp,AV_ERROR_MAX_STRING_SIZE); \
+		RRReporter::report(WARN,LIB_NAME ": " func "()=%s\n",tmp); \
+	}
+
+	AVCodecContext* open_stream(int stream_index, bool threaded)
 	{
 		if (stream_index < 0 || stream_index >= (int)avFormatContext->nb_streams)
 			return nullptr;
-		AVCodec* avCodec = avcodec_find_decoder(avFormatContext->streams[stream_index]->codec->codec_id);
+#ifdef RR_AV_SEND_RECEIVE
+		const AVCodecParameters* avCodecParameters = avFormatContext->streams[stream_index]->codecpar;
+		const AVCodec* avCodec = avcodec_find_decoder(avCodecParameters->codec_id);
+#else
+		const AVCodec* avCodec = avcodec_find_decoder(avFormatContext->streams[stream_index]->codec->codec_id);
+#endif
 		if (!avCodec)
 		{
 			RRReporter::report(WARN,LIB_NAME ": unsupported codec\n");
 			return nullptr;
 		}
 		AVCodecContext* avCodecContext = avcodec_alloc_context3(avCodec);
+#ifdef RR_AV_SEND_RECEIVE
+		int err = avcodec_parameters_to_context(avCodecContext, avCodecParameters);
+		if (err<0)
+		{
+			REPORT("avcodec_parameters_to_context",err);
+			avcodec_free_context(&avCodecContext);
+			return nullptr;
+		}
+#else
 		int err = avcodec_copy_context(avCodecContext, avFormatContext->streams[stream_index]->codec);
 		if (err)
 		{
-			#define AV_ERROR_MAX_STRING_SIZE 64
-			//#define REPORT(func) RRReporter::report(WARN,LIB_NAME ": " func "()=%c%c%c%c\n",char(-err),char((-err)>>8),char((-err)>>16),char((-err)>>24))
-			#define REPORT(func,err) { \
-				char tmp[AV_ERROR_MAX_STRING_SIZE]; \
-				av_strerror(err,tmp,AV_ERROR_MAX_STRING_SIZE); \
-				RRReporter::report(WARN,LIB_NAME ": " func "()=%s\n",tmp); \
-			}			
 			REPORT("avcodec_copy_context",err);
+			avcodec_free_context(&avCodecContext);
 			return nullptr;
 		}
+#endif
+		if (threaded)
+		{
+			// decode several frames in parallel, it delays output by several frames, see DrainPacket
+			avCodecContext->thread_count = 0; // auto
+			avCodecContext->thread_type = FF_THREAD_FRAME|FF_THREAD_SLICE;
+		}
 		err = avcodec_open2(avCodecContext, avCodec, NULL);
 		if (err)
 		{
 			REPORT("avcodec_open2",err);
+			avcodec_free_context(&avCodecContext);
 			return nullptr;
 		}
 		return avCodecContext;
@@ -689,7 +862,7 @@ public:
 	// fills width,height,duration etc, but not image_xxx
 	bool open_file(const RRString& filename)
 	{
-#ifdef SUPPORT_LIBAV
+#ifdef RR_LIBAV_PTS_CORRECTION
 		init_pts_correction(&ptsCorrectionContext);
 #endif
 
@@ -720,23 +893,28 @@ public:
 		// Open streams
 		for (unsigned i=0; i<avFormatContext->nb_streams; i++)
 		{
-			if (audio_streamIndex==-1 && avFormatContext->streams[i]->codec->codec_type==AVMEDIA_TYPE_AUDIO)
+			if (audio_streamIndex==-1 && getMediaType(avFormatContext->streams[i])==AVMEDIA_TYPE_AUDIO)
 			{
 				audio_streamIndex = i;
 				audio_avStream = avFormatContext->streams[audio_streamIndex];
 				if (audio_avStream)
-					audio_avCodecContext = open_stream(audio_streamIndex);
+					audio_avCodecContext = open_stream(audio_streamIndex,false);
 				if (audio_avCodecContext)
 				{
+#ifdef RR_AV_CH_LAYOUT
+					audio_numChannels = audio_avCodecContext->ch_layout.nb_channels;
+#else
+					audio_numChannels = audio_avCodecContext->channels;
+#endif
 					audio_thread = std::thread(&FFmpegPlayer::audio_proc,this);
 				}
 			}
-			if (video_streamIndex==-1 && avFormatContext->streams[i]->codec->codec_type==AVMEDIA_TYPE_VIDEO)
+			if (video_streamIndex==-1 && getMediaType(avFormatContext->streams[i])==AVMEDIA_TYPE_VIDEO)
 			{
 				video_streamIndex = i;
 				video_avStream = avFormatContext->streams[video_streamIndex];
 				if (video_avStream)
-					video_avCodecContext = open_stream(video_streamIndex);
+					video_avCodecContext = open_stream(video_streamIndex,true);
 				if (video_avCodecContext)
 				{
 					const AVPixFmtDescriptor* fmt_desc = av_pix_fmt_desc_get(video_avCodecContext->pix_fmt);
@@ -744,10 +922,24 @@ public:
 					rr::RRBufferFormat rrFormats[5] = {rr::BF_LUMINANCE,rr::BF_LUMINANCE,rr::BF_RGB,rr::BF_RGB,rr::BF_RGBA};
 					AVPixelFormat avFormats[5] = {AV_PIX_FMT_GRAY8,AV_PIX_FMT_GRAY8,AV_PIX_FMT_RGB24,AV_PIX_FMT_RGB24,AV_PIX_FMT_RGBA};
 					AVPixelFormat avFormat = avFormats[idx];
-					video_swsContext = sws_getContext(video_avCodecContext->width, video_avCodecContext->height, video_avCodecContext->pix_fmt, video_avCodecContext->width, video_avCodecContext->height, avFormat, SWS_BILINEAR, NULL, NULL, NULL );
 					width = video_avCodecContext->width;
 					height = video_avCodecContext->height;
 					format = rrFormats[idx];
+					if (video_avStream->avg_frame_rate.num && video_avStream->avg_frame_rate.den)
+						video_frameSeconds = av_q2d(av_inv_q(video_avStream->avg_frame_rate));
+					// each band gets its own context, bands start at rows divisible by chroma subsampling
+					// (chroma is not interpolated across bands, it makes no visible difference)
+					unsigned numBands = 1;
+#ifdef _OPENMP
+					numBands = RR_CLAMPED(height/MIN_SWS_BAND_HEIGHT,1,(unsigned)omp_get_max_threads());
+#endif
+					video_chromaShift = fmt_desc->log2_chroma_h;
+					video_bandHeight = ((height+numBands-1)/numBands+15)&~15u;
+					for (unsigned y=0;y<height;y+=video_bandHeight)
+					{
+						unsigned bandHeight = RR_MIN(video_bandHeight,height-y);
+						video_swsContexts.push_back(sws_getContext(width, bandHeight, video_avCodecContext->pix_fmt, width, bandHeight, avFormat, SWS_BILINEAR, NULL, NULL, NULL));
+					}
 					video_thread = std::thread(&FFmpegPlayer::video_proc,this);
 				}
 			}
@@ -766,20 +958,62 @@ public:
 		// loop
 		//  a) play until both audio and video end
 		//     "falling snow" looks wrong, it has 1s longer audio than video, video stops for 1s before looping
-		//     if (playing && !demux_working && !audio_packetQueue.size() && !video_packetQueue.size() && !image_queue.size())
+		//     if (playing && !demux_working && !audio_packetQueue.size() && !video_packetQueue.size() && !video_ring.size())
 		//  b) play until video ends (or audio, in audio only files)
-		if (looping && playing && !demux_working && ((!hasVideo() && !audio_packetQueue.size()) || (!video_packetQueue.size() && !image_queue.size())))
+		//     video ends when video_proc drains decoder, empty queue is not enough, decoder with frame threading still holds last frames
+		if (looping && playing && !demux_working && ((!hasVideo() && !audio_packetQueue.size()) || (video_drainedGeneration==seekGeneration && !video_ring.size())))
 		{
 			seek(0);
 		}
-		VideoPicture* image = image_queue.pop_older(playing ? startTime.secondsPassed() : stoppedSecondsFromStart);
-		if (image)
+
+		// skip frames decoded before seek
+		double seconds = playing ? startTime.secondsPassed() : stoppedSecondsFromStart;
+		unsigned generation = seekGeneration;
+		unsigned numReady = video_ring.size();
+		unsigned numOld = 0;
+		while (numOld<numReady && video_ring.peek(numOld).seekGeneration!=generation)
+			numOld++;
+
+		// pop all older frames, show the newest one of them
+		unsigned numPopped = numOld;
+		while (numPopped<numReady && (video_ring.peek(numPopped).pts<seconds || !video_ring.peek(numPopped).dbg_numImagesSinceSeek)) // always pop if it is first frame after seek
+			numPopped++;
+		if (numPopped>numOld)
 		{
-			delete image_visible;
-			image_visible = image;
+			VideoPicture& image = video_ring.peek(numPopped-1);
+			std::swap(image_visible.buffer,image.buffer); // previously visible buffer goes back to ring, to be reused by video_proc
+			image_visible.pts = image.pts;
+			image_visible.seekGeneration = image.seekGeneration;
+			image_visible.dbg_seekSeconds = image.dbg_seekSeconds;
+			image_visible.dbg_numImagesSinceStart = image.dbg_numImagesSinceStart;
+			image_visible.dbg_numImagesSinceSeek = image.dbg_numImagesSinceSeek;
+			stats_shown++;
+			stats_dropped += numPopped-1-numOld;
+			if (playing && image.dbg_numImagesSinceSeek && image.pts+video_frameSeconds<seconds)
+				stats_late++; // next frame should be visible already, but it is not decoded yet
 		}
+		video_ring.pop(numPopped);
 		return true;
 	}
+
+	// True if frame for given time is already in video_ring, so that update() can skip to it without seeking in file.
+	bool isDecoded(double seconds)
+	{
+		unsigned generation = seekGeneration;
+		bool earlierFrame = image_visible.buffer && image_visible.seekGeneration==generation && image_visible.pts<=seconds;
+		unsigned numReady = video_ring.size();
+		for (unsigned i=0;i<numReady;i++)
+		{
+			const VideoPicture& image = video_ring.peek(i);
+			if (image.seekGeneration==generation)
+			{
+				if (image.pts>seconds)
+					return earlierFrame;
+				earlierFrame = true;
+			}
+		}
+		return false;
+	}
 	void play()
 	{
 		if (!playing)
@@ -814,7 +1048,11 @@ public:
 			stoppedSecondsFromStart = secondsFromStart;
 			if (jump>=0 && jump<=SKIP_SEEK_SECONDS_FORWARD) return; // do nothing when stopped and seeking little bit forward (heavily used by RL anim capture)
 		}
+		// keep decoded frames when seeking among them (audio would not follow, so only when it's not playing)
+		if (hasVideo() && (!hasAudio() || !playing) && isDecoded(secondsFromStart))
+			return;
 		seekSecondsFromStart = secondsFromStart;
+		seekGeneration++; // starts seek in demux_thread, frames decoded so far are not shown
 	}
 
 	unsigned          width;                  // set once by ctor
@@ -825,7 +1063,8 @@ public:
 	bool              playing;                // changed by main thread, signal to audio_thread
 	RRTime            startTime;              // changed by main thread, only valid when playing. also changed by demux_proc when looping (risky)
 	float             stoppedSecondsFromStart;// changed by main thread, only valid when !playing
-	float             seekSecondsFromStart;   // changed by main thread, signal to demux_thread
+	float             seekSecondsFromStart;   // changed by main thread, read by demux_thread after seekGeneration changes
+	std::atomic<unsigned> seekGeneration;     // changed by main thread, signal to demux_thread, incremented on each seek
 	bool              aborting;               // changed by main thread, signal to all background threads
 
 	// demux
@@ -838,23 +1077,34 @@ public:
 	int               audio_streamIndex;      // set once by ctor
 	AVStream*         audio_avStream;         // set once by ctor
 	AVCodecContext*   audio_avCodecContext;   // set once by ctor
+	unsigned          audio_numChannels;      // set once by ctor
 	Queue<AVPacketWrapper*> audio_packetQueue;// changed by demux_thread and audio_thread
 
 	// ffmpeg video (producer)
-	std::thread       video_thread;           // set once by ctor, decodes video packets and feeds image_ready
+	std::thread       video_thread;           // set once by ctor, decodes video packets and feeds video_ring
 	int               video_streamIndex;      // set once by ctor
 	AVStream*         video_avStream;         // set once by ctor
 	AVCodecContext*   video_avCodecContext;   // set once by ctor
 	Queue<AVPacketWrapper*> video_packetQueue;// changed by demux_thread and video_thread
-	struct SwsContext*video_swsContext;
+	std::vector<struct SwsContext*> video_swsContexts; // set once by ctor, one per horizontal band of frame
+	unsigned          video_bandHeight;       // set once by ctor
+	unsigned          video_chromaShift;      // set once by ctor, log2 of vertical chroma subsampling
+	double            video_frameSeconds;     // set once by ctor, nominal frame duration
+	std::atomic<unsigned> video_drainedGeneration; // changed by video_thread, seekGeneration of frames that reached end of stream
 
-#ifdef SUPPORT_LIBAV
+#ifdef RR_LIBAV_PTS_CORRECTION
 	PtsCorrectionContext ptsCorrectionContext;
 #endif
 
-	// yuv images (consumer)
-	Queue<VideoPicture*> image_queue;
-	VideoPicture*     image_visible;          // filled by update(), visible from outside
+	// rgb images
+	FrameRing         video_ring;             // changed by video_thread (producer) and main thread (consumer)
+	VideoPicture      image_visible;          // filled by update(), visible from outside
+
+	// statistics
+	std::atomic<unsigned> stats_decoded;      // changed by video_thread
+	unsigned          stats_shown;            // changed by main thread
+	unsigned          stats_dropped;          // changed by main thread, frames skipped because newer frame was due
+	unsigned          stats_late;             // changed by main thread, frames shown when next frame was due
 };
 
 
@@ -1026,7 +1276,7 @@ public:
 		if (result)
 		{
 			version++;
-			buffer = player->image_visible ? player->image_visible->buffer : nullptr;
+			buffer = player->image_visible.buffer;
 		}
 		return result;
 	}
@@ -1051,6 +1301,16 @@ public:
 	{
 		return player->duration;
 	}
+
+	// --------- statistics ---------
+
+	void getStatistics(rr_io::VideoStatistics& statistics) const
+	{
+		statistics.framesDecoded = player->stats_decoded;
+		statistics.framesShown = player->stats_shown;
+		statistics.framesDropped = player->stats_dropped;
+		statistics.framesLate = player->stats_late;
+	}
  
 private:
 	std::atomic<unsigned> refCount;
@@ -1072,4 +1332,13 @@ void registerLoaderFFmpegLibav()
 	RRBuffer::registerLoader("*.avi;*.mkv;*.mov;*.wmv;*.mpg;*.mpeg;*.mp4;*.mp3;*.wav",RRBufferFFmpeg::load);
 }
 
+bool getVideoStatisticsFFmpegLibav(const rr::RRBuffer* video, rr_io::VideoStatistics& statistics)
+{
+	const RRBufferFFmpeg* ffmpeg = dynamic_cast<const RRBufferFFmpeg*>(video);
+	if (!ffmpeg)
+		return false;
+	ffmpeg->getStatistics(statistics);
+	return true;
+}
+
 #endif // SUPPORT_FFMPEG || SUPPORT_LIBAV
@@ -10,6 +10,8 @@
 #ifndef RRBUFFERFFMPEG_H
 #define RRBUFFERFFMPEG_H
 
+#include "Lightsprint/IO/IO.h"
+
 //! Makes it possible to play videos in texture.
 //
 //! Video is like static image
@@ -22,4 +24,7 @@
 //! - video can't be reset() and reload()
 void registerLoaderFFmpegLibav();
 
+//! Implements rr_io::getVideoStatistics() for videos played by FFmpeg/libav.
+bool getVideoStatisticsFFmpegLibav(const rr::RRBuffer* video, rr_io::VideoStatistics& statistics);
+
 #endif
@@ -101,9 +101,9 @@ static unsigned char* loadFreeImage(const RRString& filename,bool flipV,bool fli
 				width = FreeImage_GetWidth(dib1);
 				height = FreeImage_GetHeight(dib1);
 				outFormat = BF_RGBAF;
-				pixels = new unsigned char[16*width*height];
+				pixels = new unsigned char[(size_t)16*width*height];
 				float* fipixels = (float*)FreeImage_GetBits(dib1);
-				memcpy(pixels,fipixels,width*height*16);
+				memcpy(pixels,fipixels,(size_t)width*height*16);
 			}
 			else
 			if (bpp1==96)
@@ -113,9 +113,9 @@ static unsigned char* loadFreeImage(const RRString& filename,bool flipV,bool fli
 				width = FreeImage_GetWidth(dib1);
 				height = FreeImage_GetHeight(dib1);
 				outFormat = BF_RGBF;
-				pixels = new unsigned char[12*width*height];
+				pixels = new unsigned char[(size_t)12*width*height];
 				float* fipixels = (float*)FreeImage_GetBits(dib1);
-				memcpy(pixels,fipixels,width*height*12);
+				memcpy(pixels,fipixels,(size_t)width*height*12);
 			}
 			else
 			if (colorType==FIC_MINISBLACK || colorType==FIC_MINISWHITE)
@@ -131,20 +131,20 @@ static unsigned char* loadFreeImage(const RRString& filename,bool flipV,bool fli
 					if (bpp1>8)
 					{
 						outFormat = BF_LUMINANCEF;
-						pixels = new unsigned char[4*width*height];
+						pixels = new unsigned char[(size_t)4*width*height];
 						float* fipixels = (float*)FreeImage_GetBits(dib2);
-						memcpy(pixels,fipixels,width*height*4);
+						memcpy(pixels,fipixels,(size_t)width*height*4);
 					}
 					else
 					{
 						outFormat = BF_LUMINANCE;
-						pixels = new unsigned char[width*height];
+						pixels = new unsigned char[(size_t)width*height];
 						BYTE* fipixels = (BYTE*)FreeImage_GetBits(dib2);
 						unsigned pitch = FreeImage_GetPitch(dib2);
 						for (unsigned j=0;j<height;j++)
 						{
 							for (unsigned i=0;i<width;i++)
-								pixels[j*width+i] = (colorType==FIC_MINISBLACK) ? fipixels[j*pitch+i] : 255-fipixels[j*pitch+i];
+								pixels[(size_t)j*width+i] = (colorType==FIC_MINISBLACK) ? fipixels[(size_t)j*pitch+i] : 255-fipixels[(size_t)j*pitch+i];
 						}
 					}
 					// cleanup
@@ -163,7 +163,7 @@ static unsigned char* loadFreeImage(const RRString& filename,bool flipV,bool fli
 					height = FreeImage_GetHeight(dib2);
 					outFormat = BF_RGBA;
 					// convert BGRA to RGBA
-					pixels = new unsigned char[4*width*height];
+					pixels = new unsigned char[(size_t)4*width*height];
 					BYTE* fipixels = (BYTE*)FreeImage_GetBits(dib2);
 					unsigned pitch = FreeImage_GetPitch(dib2);
 					for (unsigned j=0;j<height;j++)
@@ -171,15 +171,15 @@ static unsigned char* loadFreeImage(const RRString& filename,bool flipV,bool fli
 						for (unsigned i=0;i<width;i++)
 						{
 #ifdef RR_BIG_ENDIAN
-							pixels[j*4*width+4*i+0] = fipixels[j*pitch+4*i+0];
-							pixels[j*4*width+4*i+1] = fipixels[j*pitch+4*i+1];
-							pixels[j*4*width+4*i+2] = fipixels[j*pitch+4*i+2];
-							pixels[j*4*width+4*i+3] = fipixels[j*pitch+4*i+3];
+							pixels[(size_t)j*4*width+4*i+0] = fipixels[(size_t)j*pitch+4*i+0];
+							pixels[(size_t)j*4*width+4*i+1] = fipixels[(size_t)j*pitch+4*i+1];
+							pixels[(size_t)j*4*width+4*i+2] = fipixels[(size_t)j*pitch+4*i+2];
+							pixels[(size_t)j*4*width+4*i+3] = fipixels[(size_t)j*pitch+4*i+3];
 #else
-							pixels[j*4*width+4*i+0] = fipixels[j*pitch+4*i+2];
-							pixels[j*4*width+4*i+1] = fipixels[j*pitch+4*i+1];
-							pixels[j*4*width+4*i+2] = fipixels[j*pitch+4*i+0];
-							pixels[j*4*width+4*i+3] = fipixels[j*pitch+4*i+3];
+							pixels[(size_t)j*4*width+4*i+0] = fipixels[(size_t)j*pitch+4*i+2];
+							pixels[(size_t)j*4*width+4*i+1] = fipixels[(size_t)j*pitch+4*i+1];
+							pixels[(size_t)j*4*width+4*i+2] = fipixels[(size_t)j*pitch+4*i+0];
+							pixels[(size_t)j*4*width+4*i+3] = fipixels[(size_t)j*pitch+4*i+3];
 #endif
 						}
 					}
@@ -198,7 +198,7 @@ static unsigned char* loadFreeImage(const RRString& filename,bool flipV,bool fli
 					height = FreeImage_GetHeight(dib2);
 					outFormat = BF_RGB;
 					// convert BGR to RGB
-					pixels = new unsigned char[3*width*height];
+					pixels = new unsigned char[(size_t)3*width*height];
 					BYTE* fipixels = (BYTE*)FreeImage_GetBits(dib2);
 					unsigned pitch = FreeImage_GetPitch(dib2);
 					for (unsigned j=0;j<height;j++)
@@ -206,13 +206,13 @@ static unsigned char* loadFreeImage(const RRString& filename,bool flipV,bool fli
 						for (unsigned i=0;i<width;i++)
 						{
 #ifdef RR_BIG_ENDIAN
-							pixels[j*3*width+3*i+0] = fipixels[j*pitch+3*i+0];
-							pixels[j*3*width+3*i+1] = fipixels[j*pitch+3*i+1];
-							pixels[j*3*width+3*i+2] = fipixels[j*pitch+3*i+2];
+							pixels[(size_t)j*3*width+3*i+0] = fipixels[(size_t)j*pitch+3*i+0];
+							pixels[(size_t)j*3*width+3*i+1] = fipixels[(size_t)j*pitch+3*i+1];
+							pixels[(size_t)j*3*width+3*i+2] = fipixels[(size_t)j*pitch+3*i+2];
 #else
-							pixels[j*3*width+3*i+0] = fipixels[j*pitch+3*i+2];
-							pixels[j*3*width+3*i+1] = fipixels[j*pitch+3*i+1];
-							pixels[j*3*width+3*i+2] = fipixels[j*pitch+3*i+0];
+							pixels[(size_t)j*3*width+3*i+0] = fipixels[(size_t)j*pitch+3*i+2];
+							pixels[(size_t)j*3*width+3*i+1] = fipixels[(size_t)j*pitch+3*i+1];
+							pixels[(size_t)j*3*width+3*i+2] = fipixels[(size_t)j*pitch+3*i+0];
 #endif
 						}
 					}
@@ -246,9 +246,9 @@ struct VBUHeader
 			numVertices = buffer->getWidth();
 		}
 	}
-	unsigned getDataSize()
+	size_t getDataSize()
 	{
-		return getBytesPerPixel(format) * numVertices;
+		return (size_t)getBytesPerPixel(format) * numVertices;
 	}
 };
 
@@ -264,7 +264,7 @@ static bool reloadVertexBuffer(RRBuffer* texture, const RRString& filename)
 	if (!f) return false;
 	// get filesize
 	fseek(f,0,SEEK_END);
-	unsigned datasize = ftell(f)-sizeof(VBUHeader);
+	size_t datasize = ftell(f)-sizeof(VBUHeader);
 	fseek(f,0,SEEK_SET);
 	// read header
 	VBUHeader header(nullptr);
@@ -113,3 +113,28 @@ void rr_io::isolateIO(int argc, char** argv)
 #endif
 }
 
+void rr_io::setIsolation(unsigned maxProcesses, float timeoutSeconds, const rr::RRString& cacheDirectory)
+{
+#ifdef SUPPORT_ISOLATION
+	setIsolationParameters(maxProcesses,timeoutSeconds,cacheDirectory);
+#endif
+}
+
+unsigned rr_io::convertIsolated(const rr::RRString* filenames, unsigned numFilenames, bool* aborting)
+{
+#ifdef SUPPORT_ISOLATION
+	return ::convertIsolated(filenames,numFilenames,aborting);
+#else
+	return 0;
+#endif
+}
+
+bool rr_io::getVideoStatistics(const rr::RRBuffer* video, VideoStatistics& statistics)
+{
+#if defined(SUPPORT_FFMPEG) || defined(SUPPORT_LIBAV)
+	if (getVideoStatisticsFFmpegLibav(video,statistics))
+		return true;
+#endif
+	return false;
+}
+
@@ -12,95 +12,547 @@
 
 #include "RRSceneIsolation.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cwctype>
+#include <fstream>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <filesystem>
 namespace bf = std::filesystem;
 
 #ifdef _WIN32
 	#include <windows.h>
-	#include <process.h> // _spawnl
+	#include <process.h> // _spawnl, _getpid
 #else
+	#include <dlfcn.h> // dladdr
+	#include <signal.h> // kill
 	#include <sys/types.h>
 	#include <sys/wait.h> // waitpid
-	#include <unistd.h> // execl
+	#include <unistd.h> // execl, getpid
 #endif
 
 using namespace rr;
 
+enum
+{
+	CACHE_VERSION = 2, // increase when format of cached files or cache key changes
+	POLL_MILLISECONDS = 10,
+	MAX_REFERENCED_FILES = 1000, // stops scanning of pathological inputs
+};
 
 static bool s_isolationEnabled = false;
+static unsigned s_maxProcesses = 0; // 0 = number of cores
+static float s_timeoutSeconds = 0; // 0 = no limit
+static bf::path s_cacheDirectory; // empty = no cache
+static unsigned long long s_converterVersion = 0; // 0 = unknown, cache is not used
 #ifndef _WIN32
 	static const char* s_thisProgramFilename = nullptr;
 #endif
 
-static bool callSelf(bf::path input, bf::path output)
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// isolated processes
+
+// One file converted by isolated process.
+struct Conversion
+{
+	enum State
+	{
+		WAITING,
+		RUNNING,
+		SUCCEEDED, // process converted file
+		FAILED,    // process exited with error, it was not able to convert file
+		CRASHED,   // process crashed or could not be started
+		TIMED_OUT, // process was killed after timeout
+		ABORTED,   // process was killed or not started because user aborted
+	};
+	bf::path input;
+	bf::path output;
+	State state;
+	int exitCode; // or signal that killed process
+	RRTime start;
+#ifdef _WIN32
+	intptr_t process;
+#else
+	pid_t process;
+#endif
+
+	Conversion(const bf::path& _input, const bf::path& _output) : input(_input), output(_output), start(false)
+	{
+		state = WAITING;
+		exitCode = 0;
+		process = 0;
+	}
+};
+
+static bool startProcess(Conversion& c)
 {
-	RRReportInterval report(INF2,"Isolated process converts it to .rr3...\n");
 #ifdef _WIN32
 	wchar_t thisProgramFilename[MAX_PATH];
 	GetModuleFileNameW(nullptr,thisProgramFilename,MAX_PATH);
-	intptr_t exitCode = _wspawnl(_P_WAIT,
+	c.process = _wspawnl(_P_NOWAIT,
 		thisProgramFilename,
 		(std::wstring(L"\"")+thisProgramFilename+L"\"").c_str(), // add "", filenames with spaces need it
 		L"-isolated-conversion",
-		(std::wstring(L"\"")+input.wstring()+L"\"").c_str(),
-		(std::wstring(L"\"")+output.wstring()+L"\"").c_str(),
+		(std::wstring(L"\"")+c.input.wstring()+L"\"").c_str(),
+		(std::wstring(L"\"")+c.output.wstring()+L"\"").c_str(),
 		nullptr);
-	bool success = exitCode==0;
-	if (!success)
-	{
-		RRReporter::report(WARN,"Isolated conversion failed with exit code %d.\n",exitCode);
-		return false;
-	}
+	return c.process!=-1;
 #else
-	pid_t child_pid = fork();
-	if (!child_pid)
+	// prepare arguments before fork, child of multithreaded process should not allocate
+	std::string input = c.input.string();
+	std::string output = c.output.string();
+	c.process = fork();
+	if (!c.process)
 	{
 		// other option is to convert scene here, instead of execl. would it work?
-    	execl(s_thisProgramFilename,
+		execl(s_thisProgramFilename,
 			s_thisProgramFilename, // don't add "", filenames with spaces already work fine
 			"-isolated-conversion",
-			input.string().c_str(),
-			output.string().c_str(),
+			input.c_str(),
+			output.c_str(),
 			nullptr);
 		// child only gets here if exec fails
-		RRReporter::report(WARN,"Isolated conversion failed execl().\n");
-		exit(0);
+		_exit(127);
 	}
+	return c.process>0;
+#endif
+}
+
+// Returns true when process ended, c.state is updated.
+// Kill=true kills running process and sets killedState.
+static bool finishProcess(Conversion& c, bool kill, Conversion::State killedState)
+{
+#ifdef _WIN32
+	HANDLE process = (HANDLE)c.process;
+	if (kill)
+	{
+		TerminateProcess(process,1);
+		WaitForSingleObject(process,INFINITE);
+		CloseHandle(process);
+		c.state = killedState;
+		return true;
+	}
+	if (WaitForSingleObject(process,0)!=WAIT_OBJECT_0)
+		return false;
+	DWORD exitCode = 1;
+	GetExitCodeProcess(process,&exitCode);
+	CloseHandle(process);
+	c.exitCode = (int)exitCode;
+	// unhandled exceptions end process with NTSTATUS error code, e.g. 0xC0000005
+	c.state = !exitCode ? Conversion::SUCCEEDED : (((exitCode&0xC0000000)==0xC0000000) ? Conversion::CRASHED : Conversion::FAILED);
+#else
 	int status = 0;
-	pid_t waitResult = waitpid(child_pid,&status,0);
-	int exitCode = WEXITSTATUS(status);
-	bool success = waitResult>0 && WIFEXITED(status) && exitCode==0;
-	if (!success)
+	if (kill)
 	{
-		RRReporter::report(WARN,"Isolated conversion failed with waitResult=%d exited=%d exitcode=%d.\n",(int)waitResult,WIFEXITED(status)?1:0,exitCode);
+		::kill(c.process,SIGKILL);
+		waitpid(c.process,&status,0);
+		c.state = killedState;
+		return true;
+	}
+	pid_t waitResult = waitpid(c.process,&status,WNOHANG);
+	if (!waitResult)
 		return false;
+	if (waitResult<0)
+	{
+		c.exitCode = 0;
+		c.state = Conversion::CRASHED;
+	}
+	else if (WIFEXITED(status))
+	{
+		c.exitCode = WEXITSTATUS(status);
+		c.state = c.exitCode ? Conversion::FAILED : Conversion::SUCCEEDED;
+	}
+	else
+	{
+		c.exitCode = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+		c.state = Conversion::CRASHED;
+	}
+#endif
+	// process that claims success without writing output failed too
+	std::error_code ec;
+	if (c.state==Conversion::SUCCEEDED && !bf::exists(c.output,ec))
+		c.state = Conversion::FAILED;
+	return true;
+}
+
+static void reportResult(const Conversion& c, size_t numFinished, size_t numConversions)
+{
+	switch (c.state)
+	{
+		case Conversion::SUCCEEDED:
+			RRReporter::report(INF2,"Isolated conversion %d/%d: %ls converted in %.1fs.\n",(int)numFinished,(int)numConversions,c.input.wstring().c_str(),c.start.secondsPassed());
+			break;
+		case Conversion::FAILED:
+			RRReporter::report(WARN,"Isolated conversion %d/%d: %ls failed with exit code %d.\n",(int)numFinished,(int)numConversions,c.input.wstring().c_str(),c.exitCode);
+			break;
+		case Conversion::CRASHED:
+			RRReporter::report(WARN,"Isolated conversion %d/%d: %ls crashed (%d).\n",(int)numFinished,(int)numConversions,c.input.wstring().c_str(),c.exitCode);
+			break;
+		case Conversion::TIMED_OUT:
+			RRReporter::report(WARN,"Isolated conversion %d/%d: %ls killed after %.0fs timeout.\n",(int)numFinished,(int)numConversions,c.input.wstring().c_str(),s_timeoutSeconds);
+			break;
+		case Conversion::ABORTED:
+			RRReporter::report(INF2,"Isolated conversion %d/%d: %ls aborted.\n",(int)numFinished,(int)numConversions,c.input.wstring().c_str());
+			break;
+		default:
+			break;
+	}
+}
+
+// Runs conversions in up to s_maxProcesses isolated processes at once, returns when all of them end.
+static void runConversions(std::vector<Conversion>& conversions, bool* aborting)
+{
+	unsigned maxProcesses = s_maxProcesses ? s_maxProcesses : RR_MAX(std::thread::hardware_concurrency(),1u);
+	RRReportInterval report(INF2,"Isolated processes convert %d files to .rr3...\n",(int)conversions.size());
+	size_t numStarted = 0;
+	size_t numFinished = 0;
+	unsigned numRunning = 0;
+	while (numFinished<conversions.size())
+	{
+		bool aborted = aborting && *aborting;
+
+		// start processes
+		while (numRunning<maxProcesses && numStarted<conversions.size())
+		{
+			Conversion& c = conversions[numStarted++];
+			c.start.setNow();
+			if (!aborted && startProcess(c))
+			{
+				c.state = Conversion::RUNNING;
+				numRunning++;
+			}
+			else
+			{
+				c.state = aborted ? Conversion::ABORTED : Conversion::CRASHED;
+				reportResult(c,++numFinished,conversions.size());
+			}
+		}
+
+		// check running processes
+		for (size_t i=0;i<numStarted;i++)
+		{
+			Conversion& c = conversions[i];
+			if (c.state==Conversion::RUNNING)
+			{
+				bool timedOut = s_timeoutSeconds>0 && c.start.secondsPassed()>s_timeoutSeconds;
+				if (finishProcess(c,aborted||timedOut,aborted?Conversion::ABORTED:Conversion::TIMED_OUT))
+				{
+					numRunning--;
+					reportResult(c,++numFinished,conversions.size());
+				}
+			}
+		}
+		if (numRunning)
+			std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MILLISECONDS));
 	}
+}
+
+// Returns unique filename of temporary .rr3 in directory of given file.
+// temp.rr3 must be in the same directory, otherwise relative texture paths would fail.
+static bf::path getTempFilename(const bf::path& nextTo)
+{
+	static std::atomic<unsigned> s_counter(0);
+	char name[40];
+#ifdef _WIN32
+	sprintf(name,"temp%u_%u.rr3",(unsigned)_getpid(),(unsigned)s_counter++);
+#else
+	sprintf(name,"temp%u_%u.rr3",(unsigned)getpid(),(unsigned)s_counter++);
 #endif
+	return nextTo.parent_path() / name;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// cache of converted files
+//
+// Files are named by hash of input content, content of files it references, extension, directory and converter version.
+// Extension selects loader, directory is part of the key because .rr3 stores absolute paths to textures.
+// References are found only in text formats (.obj, .gltf, .dae), see getReferencedFiles().
+
+static unsigned long long hashBytes(const void* data, size_t size, unsigned long long hash)
+{
+	// FNV-1a
+	for (size_t i=0;i<size;i++)
+		hash = (hash^((const unsigned char*)data)[i])*1099511628211ull;
+	return hash;
+}
+
+static bool hashFile(const bf::path& filename, unsigned long long& hash)
+{
+	std::ifstream ifs(filename,std::ios::in|std::ios::binary);
+	if (!ifs)
+		return false;
+	std::vector<char> chunk(1024*1024);
+	while (ifs)
+	{
+		ifs.read(chunk.data(),chunk.size());
+		hash = hashBytes(chunk.data(),(size_t)ifs.gcount(),hash);
+	}
+	return !ifs.bad();
+}
+
+// Hashes size and modification time of executable or library, they change when it is rebuilt.
+static bool hashModule(const bf::path& module, unsigned long long& hash)
+{
+	std::error_code ec;
+	unsigned long long size = bf::file_size(module,ec);
+	if (ec)
+		return false;
+	long long time = bf::last_write_time(module,ec).time_since_epoch().count();
+	if (ec)
+		return false;
+	hash = hashBytes(&size,sizeof(size),hash);
+	hash = hashBytes(&time,sizeof(time),hash);
 	return true;
 }
 
+// Converter is our own executable with LightsprintIO (linked statically or as dll/so),
+// rebuilding either of them invalidates cache.
+static unsigned long long getConverterVersion()
+{
+#ifdef _WIN32
+	wchar_t thisProgramFilename[MAX_PATH];
+	GetModuleFileNameW(nullptr,thisProgramFilename,MAX_PATH);
+	bf::path program(thisProgramFilename);
+	HMODULE thisModule = nullptr;
+	wchar_t thisModuleFilename[MAX_PATH];
+	if (!GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS|GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,(LPCWSTR)&getConverterVersion,&thisModule)
+		|| !GetModuleFileNameW(thisModule,thisModuleFilename,MAX_PATH))
+		return 0;
+	bf::path module(thisModuleFilename);
+#else
+	if (!s_thisProgramFilename)
+		return 0;
+	bf::path program(s_thisProgramFilename);
+	Dl_info info;
+	if (!dladdr((void*)&getConverterVersion,&info) || !info.dli_fname)
+		return 0;
+	bf::path module(info.dli_fname);
+#endif
+	unsigned version = CACHE_VERSION;
+	unsigned long long hash = 14695981039346656037ull;
+	hash = hashBytes(&version,sizeof(version),hash);
+	if (!hashModule(program,hash) || !hashModule(module,hash))
+		return 0;
+	return hash;
+}
+
+static std::wstring toLower(const std::wstring& s)
+{
+	std::wstring result = s;
+	std::transform(result.begin(),result.end(),result.begin(),[](wchar_t c){return (wchar_t)std::towlower(c);});
+	return result;
+}
+
+static std::string trim(const std::string& s)
+{
+	size_t first = s.find_first_not_of(" \t\r\n");
+	if (first==std::string::npos)
+		return std::string();
+	return s.substr(first,s.find_last_not_of(" \t\r\n")+1-first);
+}
+
+// Returns value of attribute that starts at line[pos], e.g. "uri" : "value" or url="value", empty if there is no value.
+static std::string getQuotedValue(const std::string& line, size_t pos)
+{
+	size_t begin = line.find('"',line.find_first_of(":=",pos));
+	if (begin==std::string::npos)
+		return std::string();
+	size_t end = line.find('"',begin+1);
+	if (end==std::string::npos)
+		return std::string();
+	return line.substr(begin+1,end-begin-1);
+}
+
+// Adds names of files referenced from given file.
+// Only references read by loaders are needed (textures are loaded later, from paths stored in .rr3):
+//  .obj mtllib, .gltf buffers and images (images may affect material conversion), .dae external documents.
+// References from binary formats are not found.
+static void addReferencedNames(const bf::path& filename, std::vector<std::string>& names)
+{
+	std::wstring extension = toLower(filename.extension().wstring());
+	bool obj = extension==L".obj";
+	bool gltf = extension==L".gltf";
+	bool dae = extension==L".dae";
+	if (!obj && !gltf && !dae)
+		return;
+	std::ifstream ifs(filename);
+	std::string line;
+	while (std::getline(ifs,line) && names.size()<MAX_REFERENCED_FILES)
+	{
+		if (obj)
+		{
+			std::string s = trim(line);
+			if (s.compare(0,6,"mtllib")==0 && s.size()>7 && (s[6]==' ' || s[6]=='\t'))
+				names.push_back(trim(s.substr(7)));
+		}
+		else
+		{
+			for (size_t pos=line.find(gltf?"\"uri\"":"url=\"");pos!=std::string::npos;pos=line.find(gltf?"\"uri\"":"url=\"",pos+1))
+			{
+				std::string name = getQuotedValue(line,pos);
+				if (dae)
+				{
+					name = name.substr(0,name.find('#')); // url="#id" is local, url="other.dae#id" is external
+					if (name.compare(0,7,"file://")==0)
+						name = name.substr((name.size()>10 && name[9]==':') ? 8 : 7); // file:///C:/x.dae or file:///x.dae
+				}
+				if (!name.empty() && name.compare(0,5,"data:")!=0)
+					names.push_back(name);
+			}
+		}
+	}
+}
+
+// Returns files referenced from input, recursively, sorted.
+static std::vector<bf::path> getReferencedFiles(const bf::path& input)
+{
+	std::set<bf::path> referenced;
+	std::vector<bf::path> unscanned(1,input);
+	while (!unscanned.empty() && referenced.size()<MAX_REFERENCED_FILES)
+	{
+		bf::path filename = unscanned.back();
+		unscanned.pop_back();
+		std::vector<std::string> names;
+		addReferencedNames(filename,names);
+		for (size_t i=0;i<names.size();i++)
+		{
+			bf::path name = bf::u8path(names[i]);
+			bf::path reference = (name.is_absolute() ? name : filename.parent_path() / name).lexically_normal();
+			if (reference!=input && referenced.insert(reference).second)
+				unscanned.push_back(reference);
+		}
+	}
+	return std::vector<bf::path>(referenced.begin(),referenced.end());
+}
+
+// Returns empty path when cache is disabled or input can't be read.
+static bf::path getCacheFilename(const bf::path& input)
+{
+	if (s_cacheDirectory.empty() || !s_converterVersion)
+		return bf::path();
+	std::error_code ec;
+	std::wstring directory = bf::absolute(input,ec).parent_path().wstring();
+	std::wstring extension = input.extension().wstring();
+	unsigned long long hash = hashBytes(&s_converterVersion,sizeof(s_converterVersion),14695981039346656037ull);
+	hash = hashBytes(directory.c_str(),directory.size()*sizeof(wchar_t),hash);
+	hash = hashBytes(extension.c_str(),extension.size()*sizeof(wchar_t),hash);
+	if (!hashFile(input,hash))
+		return bf::path();
+	std::vector<bf::path> referenced = getReferencedFiles(input);
+	for (size_t i=0;i<referenced.size();i++)
+	{
+		// missing file is part of the key too, conversion without it differs
+		std::wstring name = referenced[i].wstring();
+		hash = hashBytes(name.c_str(),name.size()*sizeof(wchar_t),hash);
+		unsigned char found = hashFile(referenced[i],hash) ? 1 : 0;
+		hash = hashBytes(&found,sizeof(found),hash);
+	}
+	char name[30];
+	sprintf(name,"%016llx.rr3",hash);
+	return s_cacheDirectory / name;
+}
+
+// Copies converted file to cache. Other processes may use the same cache, so file appears there atomically.
+static bool storeInCache(const bf::path& converted, const bf::path& cached)
+{
+	std::error_code ec;
+	bf::create_directories(cached.parent_path(),ec);
+	bf::path temp = getTempFilename(cached);
+	if (bf::copy_file(converted,temp,bf::copy_options::overwrite_existing,ec))
+	{
+		bf::rename(temp,cached,ec);
+		if (!ec)
+			return true;
+	}
+	RRReporter::report(WARN,"Failed to store %ls in cache: %s\n",cached.wstring().c_str(),ec.message().c_str());
+	bf::remove(temp,ec);
+	return false;
+}
+
+// Inputs that crashed or timed out are not converted again in this session, unless they change.
+static std::mutex s_failedMutex;
+static std::set<bf::path> s_failed; // cache filenames
+
+static bool hasFailed(const bf::path& cached)
+{
+	std::lock_guard<std::mutex> lock(s_failedMutex);
+	return !cached.empty() && s_failed.find(cached)!=s_failed.end();
+}
+
+static void setFailed(const bf::path& cached, const Conversion& c)
+{
+	if (!cached.empty() && (c.state==Conversion::CRASHED || c.state==Conversion::TIMED_OUT))
+	{
+		std::lock_guard<std::mutex> lock(s_failedMutex);
+		s_failed.insert(cached);
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// loader, saver
+
 RRScene* loadIsolated(const RRString& filename, RRFileLocator* textureLocator, bool* aborting)
 {
 	if (!s_isolationEnabled)
 		return nullptr;
 
 	// prepare filenames
-	// temp.rr3 must be in the same directory, otherwise relative texture paths would fail
 	bf::path input = RR_RR2PATH(filename);
-	char name[15];
-	sprintf(name,"temp%04d.rr3",rand()%10000);
-	bf::path temp = input.parent_path() / name;
+	bf::path temp = getTempFilename(input);
+	bf::path cached = getCacheFilename(input);
 
-	// convert filename to temp.rr3 (call self to do the dirty job)
-	callSelf(input,temp);
+	// get temp.rr3 from cache
+	std::error_code ec;
+	if (hasFailed(cached))
+	{
+		RRReporter::report(WARN,"%ls not imported, isolated conversion crashed or timed out before.\n",input.wstring().c_str());
+		return new RRScene;
+	}
+	if (!cached.empty() && bf::exists(cached,ec) && bf::copy_file(cached,temp,bf::copy_options::overwrite_existing,ec))
+	{
+		RRReporter::report(INF2,"Using cached conversion %ls.\n",cached.wstring().c_str());
+	}
+	else
+	{
+		// convert filename to temp.rr3 (call self to do the dirty job)
+		std::vector<Conversion> conversions;
+		conversions.push_back(Conversion(input,temp));
+		runConversions(conversions,aborting);
+		setFailed(cached,conversions[0]);
+		switch (conversions[0].state)
+		{
+			case Conversion::SUCCEEDED:
+				if (!cached.empty())
+					storeInCache(temp,cached);
+				break;
+			case Conversion::FAILED:
+				// caller tries to import scene without isolation
+				bf::remove(temp,ec);
+				return nullptr;
+			default:
+				// importing the same file in this process would likely crash or hang it too
+				bf::remove(temp,ec);
+				return new RRScene;
+		}
+	}
 
 	// load temp.rr3
 	RRScene* scene = new RRScene(RR_PATH2RR(temp),textureLocator,aborting);
 
 	// delete temp.rr3
-	std::error_code ec;
 	bf::remove(temp,ec);
 
 	// done
@@ -110,11 +562,8 @@ RRScene* loadIsolated(const RRString& filename, RRFileLocator* textureLocator, b
 bool saveIsolated(const RRScene* scene, const RRString& filename)
 {
 	// prepare filenames
-	// temp.rr3 must be in the same directory, otherwise relative texture paths would fail
 	bf::path output = RR_RR2PATH(filename);
-	char name[15];
-	sprintf(name,"temp%04d.rr3",rand()%10000);
-	bf::path temp = output.parent_path() / name;
+	bf::path temp = getTempFilename(output);
 
 	if (!scene || !s_isolationEnabled || (output.extension().string()==".rr3" || output.extension().string()==".RR3"))
 	{
@@ -128,16 +577,73 @@ bool saveIsolated(const RRScene* scene, const RRString& filename)
 	scene->save(RR_PATH2RR(temp));
 
 	// convert temp.rr3 to filename (call self to do the dirty job)
-	callSelf(temp,output);
+	std::vector<Conversion> conversions;
+	conversions.push_back(Conversion(temp,output));
+	runConversions(conversions,nullptr);
 
 	// delete temp.rr3
 	std::error_code ec;
 	bf::remove(temp,ec);
 
 	// done
-	return scene;
+	return conversions[0].state==Conversion::SUCCEEDED;
+}
+
+void setIsolationParameters(unsigned maxProcesses, float timeoutSeconds, const RRString& cacheDirectory)
+{
+	s_maxProcesses = maxProcesses;
+	s_timeoutSeconds = timeoutSeconds;
+	s_cacheDirectory = RR_RR2PATH(cacheDirectory);
+}
+
+unsigned convertIsolated(const RRString* filenames, unsigned numFilenames, bool* aborting)
+{
+	if (!s_isolationEnabled || s_cacheDirectory.empty() || !s_converterVersion || !filenames)
+		return 0;
+
+	// plan conversions of files not yet in cache
+	std::vector<bf::path> cached(numFilenames);
+	std::vector<Conversion> conversions;
+	std::vector<bf::path> conversionsCached;
+	std::set<bf::path> planned;
+	std::error_code ec;
+	for (unsigned i=0;i<numFilenames;i++)
+	{
+		bf::path input = RR_RR2PATH(filenames[i]);
+		if (input.extension().string()==".rr3" || input.extension().string()==".RR3")
+			continue; // .rr3 is never isolated
+		cached[i] = getCacheFilename(input);
+		if (!cached[i].empty() && !bf::exists(cached[i],ec) && !hasFailed(cached[i]) && planned.insert(cached[i]).second)
+		{
+			conversions.push_back(Conversion(input,getTempFilename(input)));
+			conversionsCached.push_back(cached[i]);
+		}
+	}
+
+	// convert
+	if (!conversions.empty())
+		runConversions(conversions,aborting);
+	for (size_t i=0;i<conversions.size();i++)
+	{
+		if (conversions[i].state==Conversion::SUCCEEDED)
+			storeInCache(conversions[i].output,conversionsCached[i]);
+		setFailed(conversionsCached[i],conversions[i]);
+		bf::remove(conversions[i].output,ec);
+	}
+
+	// count files available in cache
+	unsigned numCached = 0;
+	for (unsigned i=0;i<numFilenames;i++)
+		if (!cached[i].empty() && bf::exists(cached[i],ec))
+			numCached++;
+	return numCached;
 }
 
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// registration
+
 // to be called after non-isolated loaders, before isolated ones
 void registerIsolationStep1(int argc, char** argv)
 {
@@ -211,6 +717,7 @@ void registerIsolationStep2(int argc, char** argv)
 	LocalFree(argvw);
 #endif
 	s_isolationEnabled = true;
+	s_converterVersion = getConverterVersion();
 }
 
 #endif
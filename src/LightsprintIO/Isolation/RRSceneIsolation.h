@@ -16,4 +16,9 @@
 void registerIsolationStep1(int argc, char** argv);
 void registerIsolationStep2(int argc, char** argv);
 
+//! See rr_io::setIsolation().
+void setIsolationParameters(unsigned maxProcesses, float timeoutSeconds, const rr::RRString& cacheDirectory);
+//! See rr_io::convertIsolated().
+unsigned convertIsolated(const rr::RRString* filenames, unsigned numFilenames, bool* aborting);
+
 #endif
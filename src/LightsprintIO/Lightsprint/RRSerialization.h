@@ -28,7 +28,7 @@ namespace bf = std::filesystem;
 
 //------------------------- runtime declaration --------------------------------
 
-RR_API extern class SerializationRuntime* g_serializationRuntime;
+RR_API class SerializationRuntime*& getSerializationRuntime();
 
 namespace boost {
 namespace serialization {
@@ -39,13 +39,14 @@ namespace serialization {
 }
 }
 
-// Global serialization state, single instance must exist during serialization.
+// Serialization state of current thread, single instance must exist during serialization.
 //
 // Q: How do I use it?
 // A: Add "SerializationRuntime sr(nullptr);" at the beginning of your serialization code.
 //
 // Q: Is it thread safe?
-// A: No, serialization state is stored in single global variable, multiple threads serializing at the same time would break it.
+// A: Yes, each thread has its own serialization state, so threads may serialize different data at the same time
+//    (e.g. RRObjects::loadLayer() loading .rrbuffers in parallel). One serialization must not be split between threads.
 
 // Q: Global variable is ugly, is it necessary?
 // A: No. Proper solution is to make serialization state part of Archive class.
@@ -58,8 +59,7 @@ namespace serialization {
 //    while serialization reads from one variable, so there is a mess, some textures are not located etc.
 //    No such problem exists with Visual C++.
 //
-// Q: If it has to be global, can we at least make it thread safe by storing pointer to state in TLS?
-// A: Maybe. So far we serialize serially, so it's low priority.
+//    Pointer lives in core as thread_local variable behind getSerializationRuntime(), because variables can't be exported with thread_local.
 //
 // Q: What happens when multiple SerializationRuntime exist?
 // A: The newest one is visible. When it destructs, older one becomes visible again.
@@ -320,7 +320,7 @@ rr::RRBuffer* loadBufferContents(Archive & ar, const unsigned int version)
 //  - no custom allocation (http://lists.boost.org/boost-users/2005/05/11773.php)
 //  - all derived classes must be registered
 // If two pointers point to the same buffer, only one proxy is created.
-// We store set of proxy instances in g_serializationRuntime, they must be alive during load, we free them afterwards.
+// We store set of proxy instances in getSerializationRuntime(), they must be alive during load, we free them afterwards.
 
 class RRBufferProxy
 {
@@ -329,17 +329,17 @@ public:
 
 	RRBufferProxy()
 	{
-		RR_ASSERT(g_serializationRuntime);
+		RR_ASSERT(getSerializationRuntime());
 		buffer = nullptr;
-		if (g_serializationRuntime)
-			g_serializationRuntime->bufferProxyInstances.insert(this);
+		if (getSerializationRuntime())
+			getSerializationRuntime()->bufferProxyInstances.insert(this);
 	}
 	~RRBufferProxy()
 	{
-		RR_ASSERT(g_serializationRuntime);
+		RR_ASSERT(getSerializationRuntime());
 		delete buffer; // all unique buffers are created and deleted once
-		if (g_serializationRuntime)
-			g_serializationRuntime->bufferProxyInstances.erase(this);
+		if (getSerializationRuntime())
+			getSerializationRuntime()->bufferProxyInstances.erase(this);
 	}
 };
 
@@ -380,13 +380,13 @@ void load(Archive & ar, RRBufferProxy& a, const unsigned int version)
 	else
 	{
 		fixPath(filename);
-		RR_ASSERT(g_serializationRuntime);
-		if (g_serializationRuntime)
+		RR_ASSERT(getSerializationRuntime());
+		if (getSerializationRuntime())
 		{
-			if (g_serializationRuntime->nextBufferIsCube)
-				a.buffer = rr::RRBuffer::loadCube(filename,g_serializationRuntime->textureLocator);
+			if (getSerializationRuntime()->nextBufferIsCube)
+				a.buffer = rr::RRBuffer::loadCube(filename,getSerializationRuntime()->textureLocator);
 			else
-				a.buffer = rr::RRBuffer::load(filename,nullptr,g_serializationRuntime->textureLocator);
+				a.buffer = rr::RRBuffer::load(filename,nullptr,getSerializationRuntime()->textureLocator);
 		}
 		else
 			a.buffer = nullptr;
@@ -685,6 +685,12 @@ void serialize(Archive & ar, rr::RRLight& a, const unsigned int version)
 	{
 		ar & make_nvp("directLambertScaled",a.directLambertScaled);
 	}
+	if (version>6)
+	{
+		ar & make_nvp("areaType",a.areaType);
+		ar & make_nvp("areaSize",a.areaSize);
+		ar & make_nvp("angularDiameterRad",a.angularDiameterRad);
+	}
 	// skip customData;
 }
 
@@ -803,7 +809,7 @@ void load(Archive & ar, rr::RRMeshArrays& a, const unsigned int version)
 // It's necessary to circumvent boost limitations:
 //  - no custom allocation (http://lists.boost.org/boost-users/2005/05/11773.php)
 //  - all derived classes must be registered
-// We store set of proxy instances in g_serializationRuntime, they must be alive during load, we free them afterwards.
+// We store set of proxy instances in getSerializationRuntime(), they must be alive during load, we free them afterwards.
 
 class RRMeshProxy
 {
@@ -812,15 +818,15 @@ public:
 
 	RRMeshProxy()
 	{
-		RR_ASSERT(g_serializationRuntime);
-		if (g_serializationRuntime)
-			g_serializationRuntime->meshProxyInstances.insert(this);
+		RR_ASSERT(getSerializationRuntime());
+		if (getSerializationRuntime())
+			getSerializationRuntime()->meshProxyInstances.insert(this);
 	}
 	~RRMeshProxy()
 	{
-		RR_ASSERT(g_serializationRuntime);
-		if (g_serializationRuntime)
-			g_serializationRuntime->meshProxyInstances.erase(this);
+		RR_ASSERT(getSerializationRuntime());
+		if (getSerializationRuntime())
+			getSerializationRuntime()->meshProxyInstances.erase(this);
 	}
 };
 
@@ -1078,16 +1084,16 @@ void serialize(Archive & ar, rr_gl::DateTime& a, const unsigned int version)
 template<class Archive>
 void serialize(Archive & ar, rr::RRScene& a, const unsigned int version)
 {
-	RR_ASSERT(g_serializationRuntime);
-	if (g_serializationRuntime)
-		g_serializationRuntime->nextBufferIsCube = false;
+	RR_ASSERT(getSerializationRuntime());
+	if (getSerializationRuntime())
+		getSerializationRuntime()->nextBufferIsCube = false;
 	ar & make_nvp("objects",a.objects);
 	ar & make_nvp("lights",a.lights);
-	if (g_serializationRuntime)
-		g_serializationRuntime->nextBufferIsCube = true; // global is not thread safe, don't load two .rr3 at once
+	if (getSerializationRuntime())
+		getSerializationRuntime()->nextBufferIsCube = true;
 	ar & make_nvp("environment",prefix_buffer(a.environment)); postfix_buffer(Archive,a.environment);
-	if (g_serializationRuntime)
-		g_serializationRuntime->nextBufferIsCube = false;
+	if (getSerializationRuntime())
+		getSerializationRuntime()->nextBufferIsCube = false;
 	if (version>0)
 	{
 		ar & make_nvp("cameras",a.cameras);
@@ -1106,13 +1112,13 @@ SerializationRuntime::SerializationRuntime(rr::RRFileLocator* _fileLocator, cons
 	textureLocator = _fileLocator;
 	nextBufferIsCube = false;
 	origin = _origin;
-	if (g_serializationRuntime)
+	if (getSerializationRuntime())
 	{
 		// this is potentially dangerous: it relies on boost.serialization being fully reentrant. maybe it is, but testing it is not easy
-		rr::RRReporter::report(rr::INF2,"SerializationRuntime %s inside %s.\n",origin,g_serializationRuntime->origin);
+		rr::RRReporter::report(rr::INF2,"SerializationRuntime %s inside %s.\n",origin,getSerializationRuntime()->origin);
 	}
-	backup = g_serializationRuntime;
-	g_serializationRuntime = this;
+	backup = getSerializationRuntime();
+	getSerializationRuntime() = this;
 }
 
 SerializationRuntime::~SerializationRuntime()
@@ -1121,15 +1127,15 @@ SerializationRuntime::~SerializationRuntime()
 		delete *bufferProxyInstances.begin();
 	while (!meshProxyInstances.empty())
 		delete *meshProxyInstances.begin();
-	if (g_serializationRuntime!=this)
+	if (getSerializationRuntime()!=this)
 		// Scopes of runtimes must not overlap (new A, new B, delete A, delete B. <- this is wrong).
 		rr::RRReporter::report(rr::ERRO,"SerializationRuntime %s scope overlaps.\n",origin);
-	g_serializationRuntime = backup;
+	getSerializationRuntime() = backup;
 }
 
 bool SerializationRuntime::exists()
 {
-	return g_serializationRuntime!=nullptr;
+	return getSerializationRuntime()!=nullptr;
 }
 
 //---------------------------------------------------------------------------
@@ -1149,7 +1155,7 @@ BOOST_SERIALIZATION_SPLIT_FREE(rr::RRCamera)
 BOOST_CLASS_VERSION(rr::RRString,1)
 BOOST_CLASS_VERSION(rr::RRMaterial,7)
 #ifndef DONT_SERIALIZE_RRLIGHT
-BOOST_CLASS_VERSION(rr::RRLight,6)
+BOOST_CLASS_VERSION(rr::RRLight,7)
 #endif
 BOOST_CLASS_VERSION(RRMeshProxy,1) // this is actually RRMeshArrays version, load of RRMeshProxy only send it to load of RRMeshArrays
 BOOST_CLASS_VERSION(rr::RRObject,2)
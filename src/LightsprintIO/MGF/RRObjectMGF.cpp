@@ -171,7 +171,10 @@ void add_polygon(unsigned vertices,void** vertex,void* material)
 	}
 	// append to facegroups
 	if (g_scene->faceGroups.size() && g_scene->faceGroups[g_scene->faceGroups.size()-1].material==material)
+	{
 		g_scene->faceGroups[g_scene->faceGroups.size()-1].numTriangles += vertices-2;
+		g_scene->faceGroupsVersion++;
+	}
 	else
 		g_scene->faceGroups.push_back(RRObject::FaceGroup((RRMaterial*)material,vertices-2));
 }